@@ -0,0 +1,88 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import logging
+import pytest
+import os
+import ldap
+from lib389._constants import DEFAULT_SUFFIX, PASSWORD
+from lib389.topologies import topology_st as topo
+from lib389.plugins import ACLPlugin
+from lib389.idm.organizationalunit import OrganizationalUnits
+from lib389.idm.user import UserAccounts
+from lib389.idm.group import Groups
+
+pytestmark = pytest.mark.tier1
+
+log = logging.getLogger(__name__)
+
+
+def _search(conn, base):
+    entries = conn.search_s(base, ldap.SCOPE_SUBTREE, '(uid=*)', ['cn', 'sn'])
+    return {e.dn.lower(): sorted(k.lower() for k in e.getAttrs()) for e in entries}
+
+
+def test_decision_cache_invalidation(topo):
+    """Check cached read/search decisions follow group and aci changes
+
+    :id: 2c8e1f6a-7b4d-4f0e-a3c9-5d1b6e8f9a20
+    :setup: Standalone Instance
+    :steps:
+        1. Enable the decision cache of the ACL plugin
+        2. Allow a group to read some attributes of an organizational unit
+        3. Search twice as a member and as a non member of the group
+        4. Move the membership from one user to the other
+        5. Restrict the aci to a single attribute
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Only the member gets the entries, the same way both times
+        4. The decisions follow the new membership
+        5. The decisions follow the new aci
+    """
+
+    inst = topo.standalone
+    ACLPlugin(inst).replace('nsslapd-acl-decision-cache-size', '10000')
+    inst.restart()
+
+    ou = OrganizationalUnits(inst, DEFAULT_SUFFIX).create(properties={'ou': 'decision_cache'})
+    users = UserAccounts(inst, ou.dn, rdn=None)
+    user1 = users.create_test_user(uid=2001)
+    user2 = users.create_test_user(uid=2002)
+    user1.replace('userPassword', PASSWORD)
+    user2.replace('userPassword', PASSWORD)
+    group = Groups(inst, DEFAULT_SUFFIX).create(properties={'cn': 'decision_cache_readers',
+                                                            'member': user1.dn})
+    aci = ('(targetattr="cn || sn || uid")(version 3.0; acl "decision cache readers"; '
+           'allow (read, search) groupdn="ldap:///%s";)' % group.dn)
+    ou.add('aci', aci)
+
+    conn1 = user1.bind(PASSWORD)
+    conn2 = user2.bind(PASSWORD)
+    expected = {user1.dn.lower(): ['cn', 'sn'], user2.dn.lower(): ['cn', 'sn']}
+    for _ in range(2):
+        assert _search(conn1, ou.dn) == expected
+        assert _search(conn2, ou.dn) == {}
+
+    group.remove('member', user1.dn)
+    group.add('member', user2.dn)
+    assert _search(conn1, ou.dn) == {}
+    assert _search(conn2, ou.dn) == expected
+
+    ou.replace('aci', aci.replace('cn || sn || uid', 'cn || uid'))
+    assert _search(conn2, ou.dn) == {user1.dn.lower(): ['cn'], user2.dn.lower(): ['cn']}
+
+    ACLPlugin(inst).remove_all('nsslapd-acl-decision-cache-size')
+    inst.restart()
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main("-s %s" % CURRENT_FILE)
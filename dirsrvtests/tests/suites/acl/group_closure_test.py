@@ -0,0 +1,72 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import logging
+import pytest
+import os
+import ldap
+from lib389._constants import DEFAULT_SUFFIX, PASSWORD
+from lib389.topologies import topology_st as topo
+from lib389.idm.organizationalunit import OrganizationalUnits
+from lib389.idm.user import UserAccounts
+from lib389.idm.group import Groups
+
+pytestmark = pytest.mark.tier1
+
+log = logging.getLogger(__name__)
+
+
+def _can_read(conn, dn):
+    return len(conn.search_s(dn, ldap.SCOPE_BASE, '(objectclass=*)', ['ou'])) == 1
+
+
+def test_group_closure_nested_invalidation(topo):
+    """Check nested group memberships follow the changes of the inner groups
+
+    :id: 8d3b5e21-4a6f-4c9e-b7d0-1f2a3c4e5d68
+    :setup: Standalone Instance
+    :steps:
+        1. Allow an outer group, containing an inner group, to read an entry
+        2. Read the entry as a member of the inner group and as a non member
+        3. Move the membership of the inner group from one user to the other
+    :expectedresults:
+        1. Success
+        2. Only the member of the inner group reads the entry
+        3. The access follows the new membership
+    """
+
+    inst = topo.standalone
+    ou = OrganizationalUnits(inst, DEFAULT_SUFFIX).create(properties={'ou': 'group_closure'})
+    users = UserAccounts(inst, ou.dn, rdn=None)
+    user1 = users.create_test_user(uid=3001)
+    user2 = users.create_test_user(uid=3002)
+    user1.replace('userPassword', PASSWORD)
+    user2.replace('userPassword', PASSWORD)
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    inner = groups.create(properties={'cn': 'group_closure_inner', 'member': user1.dn})
+    outer = groups.create(properties={'cn': 'group_closure_outer', 'member': inner.dn})
+    ou.add('aci', '(targetattr="ou")(version 3.0; acl "group closure readers"; '
+                  'allow (read, search) groupdn="ldap:///%s";)' % outer.dn)
+
+    conn1 = user1.bind(PASSWORD)
+    conn2 = user2.bind(PASSWORD)
+    for _ in range(2):
+        assert _can_read(conn1, ou.dn)
+        assert not _can_read(conn2, ou.dn)
+
+    inner.remove('member', user1.dn)
+    inner.add('member', user2.dn)
+    assert not _can_read(conn1, ou.dn)
+    assert _can_read(conn2, ou.dn)
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main("-s %s" % CURRENT_FILE)
@@ -0,0 +1,74 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import logging
+import pytest
+import os
+import ldap
+from lib389._constants import DEFAULT_SUFFIX, PASSWORD
+from lib389.topologies import topology_st as topo
+from lib389.idm.organizationalunit import OrganizationalUnits
+from lib389.idm.user import UserAccounts
+
+pytestmark = pytest.mark.tier1
+
+log = logging.getLogger(__name__)
+
+
+def _uids(conn, base):
+    entries = conn.search_s(base, ldap.SCOPE_ONELEVEL, '(uid=*)', ['uid'])
+    return sorted(e.getValue('uid').decode() for e in entries)
+
+
+def test_search_batch_content_rules(topo):
+    """Check the entries of a search still get their own decision when
+    the acis depend on their content
+
+    :id: 4a7c2d90-5e13-4b6f-8f2a-9c0d1e3b7a54
+    :setup: Standalone Instance
+    :steps:
+        1. Create users with the same parent and objectclasses
+        2. Allow a user to read them all
+        3. Restrict the aci with a targetfilter on another attribute
+        4. Replace the aci with a userattr rule
+    :expectedresults:
+        1. Success
+        2. All the users are returned
+        3. Only the users matching the targetfilter are returned
+        4. Only the users managed by the client are returned
+    """
+
+    inst = topo.standalone
+    ou = OrganizationalUnits(inst, DEFAULT_SUFFIX).create(properties={'ou': 'search_batch'})
+    users = UserAccounts(inst, ou.dn, rdn=None)
+    client = UserAccounts(inst, DEFAULT_SUFFIX).create_test_user(uid=4000)
+    client.replace('userPassword', PASSWORD)
+    for i in range(1, 11):
+        user = users.create_test_user(uid=4000 + i)
+        user.replace('departmentNumber', str(i % 2))
+        if i % 3 == 0:
+            user.replace('manager', client.dn)
+
+    aci = '(targetattr="uid || departmentNumber")(version 3.0; acl "search batch"; allow (read, search) userdn="ldap:///%s";)'
+    ou.add('aci', aci % client.dn)
+    conn = client.bind(PASSWORD)
+    assert _uids(conn, ou.dn) == sorted('test_user_%d' % (4000 + i) for i in range(1, 11))
+
+    ou.replace('aci', '(targetfilter="(departmentNumber=1)")' + aci % client.dn)
+    assert _uids(conn, ou.dn) == sorted('test_user_%d' % (4000 + i) for i in range(1, 11, 2))
+
+    ou.replace('aci', '(targetattr="uid || departmentNumber")(version 3.0; acl "search batch"; '
+                      'allow (read, search) userattr="manager#USERDN";)')
+    assert _uids(conn, ou.dn) == sorted('test_user_%d' % (4000 + i) for i in (3, 6, 9))
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main("-s %s" % CURRENT_FILE)
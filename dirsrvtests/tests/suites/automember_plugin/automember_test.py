@@ -17,6 +17,7 @@ from lib389._mapped_object import DSLdapObjects, DSLdapObject
 from lib389 import agreement
 from lib389.idm.user import UserAccount, UserAccounts, TEST_USER_PROPERTIES
 from lib389.idm.group import Groups, Group
+from lib389.idm.organizationalunit import OrganizationalUnits
 from lib389.topologies import topology_st as topo
 from lib389._constants import DEFAULT_SUFFIX
 
@@ -306,3 +307,90 @@ def test_delete_target_group(automember_fixture, topo):
     finally:
         user_1.delete()
         topo.standalone.setLogLevel(0)
+
+
+def test_rebuild_batched_groups(automember_fixture, topo):
+    """Check the rebuild task with several threads and batched group updates
+
+    :id: 3b8e1f52-6c0d-4a7e-9d25-51f0e2c9a6b4
+    :setup: Standalone instance, enabled Auto Membership Plugin
+    :steps:
+        1. Create a definition with anchored, exclusive and literal regex rules
+        2. Add users matching the different rules
+        3. Check the memberships
+        4. Remove the members of the groups and add a member not matching a rule
+        5. Run the rebuild task with 4 threads and a batch size of 2
+        6. Check the memberships again
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Each user is a member of the groups of its matching rules
+        4. Success
+        5. Success
+        6. The memberships are the same as in step 3
+    """
+
+    inst = topo.standalone
+    (group, automembers, automember) = automember_fixture
+
+    ou = OrganizationalUnits(inst, DEFAULT_SUFFIX).create(properties={'ou': 'rebuild'})
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    default_group = groups.create(properties={'cn': 'rebuild_default'})
+    prefix_group = groups.create(properties={'cn': 'rebuild_prefix'})
+    literal_group = groups.create(properties={'cn': 'rebuild_literal'})
+
+    definition = automembers.create(properties={
+        'cn': 'rebuild_definition',
+        'autoMemberScope': ou.dn,
+        'autoMemberFilter': 'objectclass=posixAccount',
+        'autoMemberDefaultGroup': default_group.dn,
+        'autoMemberGroupingAttr': 'member:dn',
+    })
+    AutoMembershipRegexRule(inst, 'cn=prefix,%s' % definition.dn).create(properties={
+        'cn': 'prefix',
+        'autoMemberTargetGroup': prefix_group.dn,
+        'autoMemberInclusiveRegex': 'uid=^rbuser1',
+        'autoMemberExclusiveRegex': 'uid=^rbuser10$',
+    })
+    AutoMembershipRegexRule(inst, 'cn=literal,%s' % definition.dn).create(properties={
+        'cn': 'literal',
+        'autoMemberTargetGroup': literal_group.dn,
+        'autoMemberInclusiveRegex': 'description=engineering',
+    })
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX, rdn='ou=rebuild')
+    dns = {}
+    for i in range(1, 13):
+        user = users.create(properties={
+            'uid': 'rbuser%d' % i,
+            'cn': 'rbuser%d' % i,
+            'sn': 'rbuser%d' % i,
+            'uidNumber': str(3000 + i),
+            'gidNumber': str(3000 + i),
+            'homeDirectory': '/home/rbuser%d' % i,
+            'description': 'dept engineering' if i % 2 == 0 else 'dept sales',
+        })
+        dns[i] = user.dn.lower()
+
+    expected = [
+        (prefix_group, sorted(dns[i] for i in (1, 11, 12))),
+        (literal_group, sorted(dns[i] for i in (2, 4, 6, 8, 10, 12))),
+        (default_group, sorted(dns[i] for i in (3, 5, 7, 9))),
+    ]
+
+    def _members(g):
+        return sorted(v.lower() for v in g.get_attr_vals_utf8('member'))
+
+    for g, members in expected:
+        assert _members(g) == members
+
+    for g, members in expected:
+        g.remove_all('member')
+    prefix_group.add('member', dns[2])
+
+    task = AutoMembershipPlugin(inst).fixup(ou.dn, 'objectclass=posixAccount', threads=4, batchsize=2)
+    task.wait()
+    assert task.get_exit_code() == 0
+
+    for g, members in expected:
+        assert _members(g) == members
@@ -15,6 +15,7 @@ from lib389.topologies import topology_st as topo
 from lib389.idm.role import FilteredRoles
 from lib389.idm.nscontainer import nsContainer
 from lib389.idm.user import UserAccount
+from lib389.plugins import ClassOfServicePlugin
 
 logging.getLogger(__name__).setLevel(logging.INFO)
 log = logging.getLogger(__name__)
@@ -144,6 +145,149 @@ def test_vattr_on_cos_definition(topo, reset_ignore_vattr):
     topo.standalone.restart()
     assert topo.standalone.config.get_attr_val_utf8('nsslapd-ignore-virtual-attrs') == "on"
 
+def test_classic_resolution_cache(topo):
+    """Check classic CoS values are served from the specifier resolution cache
+
+    :id: 2c51a7f0-8d3e-4b6a-9e41-6f0c2b9d7a18
+    :setup: Standalone instance
+    :steps:
+        1. Add two templates and a classic definition using employeeType as specifier
+        2. Add users with each specifier value and one without template
+        3. Read the CoS attribute of the users
+        4. Modify a template
+        5. Read the CoS attribute of the users again
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Each user gets the value of its template and the statistics count hits and misses
+        4. The cache is updated
+        5. The new template value is returned
+    """
+    inst = topo.standalone
+    cos = ClassOfServicePlugin(inst)
+    templates_dn = 'cn=resolutionTemplates,{}'.format(DEFAULT_SUFFIX)
+    nsContainer(inst, templates_dn).create(properties={'cn': 'resolutionTemplates'})
+    gold = CosTemplate(inst, 'cn=gold,{}'.format(templates_dn))
+    gold.create(properties={'cn': 'gold', 'postalCode': '1000'})
+    CosTemplate(inst, 'cn=silver,{}'.format(templates_dn)).create(properties={'cn': 'silver', 'postalCode': '2000'})
+    cosdef = CosClassicDefinition(inst, 'cn=resolutionDefinition,{}'.format(DEFAULT_SUFFIX))
+    cosdef.create(properties={'cn': 'resolutionDefinition',
+                              'cosTemplateDn': templates_dn,
+                              'cosAttribute': 'postalCode',
+                              'cosSpecifier': 'employeeType'})
+    time.sleep(2)
+
+    users = {}
+    for grade in ('gold', 'silver', 'bronze'):
+        user = UserAccount(inst, 'uid=resolution_{},{}'.format(grade, DEFAULT_SUFFIX))
+        user.create(properties={'uid': 'resolution_{}'.format(grade),
+                                'cn': grade,
+                                'sn': grade,
+                                'uidNumber': '3000',
+                                'gidNumber': '3000',
+                                'homeDirectory': '/home/resolution_{}'.format(grade),
+                                'employeeType': grade})
+        users[grade] = user
+
+    before = cos.get_cache_stats()
+    assert before['resolved'] >= 2
+    for _ in range(5):
+        assert users['gold'].get_attr_val_utf8('postalCode') == '1000'
+        assert users['silver'].get_attr_val_utf8('postalCode') == '2000'
+        assert users['bronze'].get_attr_val_utf8('postalCode') is None
+    after = cos.get_cache_stats()
+    log.info('CoS cache statistics: {}'.format(after))
+    assert after['hits'] >= before['hits'] + 2
+    assert after['misses'] > before['misses']
+
+    gold.replace('postalCode', '1001')
+    time.sleep(2)
+    stats = cos.get_cache_stats()
+    assert stats['rebuilds'] + stats['updates'] > after['rebuilds'] + after['updates']
+    assert users['gold'].get_attr_val_utf8('postalCode') == '1001'
+
+    for user in users.values():
+        user.delete()
+    cosdef.delete()
+
+
+def test_incremental_cache_update(topo):
+    """Check template and definition changes are patched into the CoS cache
+
+    :id: 8e4b1f63-2a7d-4c59-b0e8-5d3a9c1f6e27
+    :setup: Standalone instance
+    :steps:
+        1. Add a template and a classic definition using employeeType as specifier
+        2. Add a user using the template
+        3. Add a template for a second grade and a user using it
+        4. Modify then delete the first template
+        5. Change the attribute provided by the definition
+        6. Delete the definition
+    :expectedresults:
+        1. Success
+        2. The user gets the template value
+        3. The cache is updated without a full rebuild and the user gets the new template value
+        4. The user gets the new value, then no value
+        5. The users get the new attribute
+        6. The users have no CoS value anymore
+    """
+    inst = topo.standalone
+    cos = ClassOfServicePlugin(inst)
+    templates_dn = 'cn=incrementalTemplates,{}'.format(DEFAULT_SUFFIX)
+    nsContainer(inst, templates_dn).create(properties={'cn': 'incrementalTemplates'})
+    first = CosTemplate(inst, 'cn=first,{}'.format(templates_dn))
+    first.create(properties={'cn': 'first', 'postalCode': '3000', 'l': 'first'})
+    cosdef = CosClassicDefinition(inst, 'cn=incrementalDefinition,{}'.format(DEFAULT_SUFFIX))
+    cosdef.create(properties={'cn': 'incrementalDefinition',
+                              'cosTemplateDn': templates_dn,
+                              'cosAttribute': 'postalCode',
+                              'cosSpecifier': 'employeeType'})
+    time.sleep(2)
+
+    users = {}
+    for grade in ('first', 'second'):
+        user = UserAccount(inst, 'uid=incremental_{},{}'.format(grade, DEFAULT_SUFFIX))
+        user.create(properties={'uid': 'incremental_{}'.format(grade),
+                                'cn': grade,
+                                'sn': grade,
+                                'uidNumber': '3100',
+                                'gidNumber': '3100',
+                                'homeDirectory': '/home/incremental_{}'.format(grade),
+                                'employeeType': grade})
+        users[grade] = user
+    assert users['first'].get_attr_val_utf8('postalCode') == '3000'
+    assert users['second'].get_attr_val_utf8('postalCode') is None
+
+    before = cos.get_cache_stats()
+    CosTemplate(inst, 'cn=second,{}'.format(templates_dn)).create(properties={'cn': 'second', 'postalCode': '3001',
+                                                                           'l': 'second'})
+    time.sleep(2)
+    after = cos.get_cache_stats()
+    log.info('CoS cache statistics: {}'.format(after))
+    assert after['updates'] > before['updates']
+    assert after['rebuilds'] == before['rebuilds']
+    assert users['second'].get_attr_val_utf8('postalCode') == '3001'
+
+    first.replace('postalCode', '3002')
+    time.sleep(2)
+    assert users['first'].get_attr_val_utf8('postalCode') == '3002'
+    first.delete()
+    time.sleep(2)
+    assert users['first'].get_attr_val_utf8('postalCode') is None
+    assert users['second'].get_attr_val_utf8('postalCode') == '3001'
+
+    cosdef.replace('cosAttribute', 'l')
+    time.sleep(2)
+    assert users['second'].get_attr_val_utf8('l') == 'second'
+    assert users['second'].get_attr_val_utf8('postalCode') is None
+
+    cosdef.delete()
+    time.sleep(2)
+    assert users['second'].get_attr_val_utf8('l') is None
+    for user in users.values():
+        user.delete()
+
+
 if __name__ == "__main__":
     CURRENT_FILE = os.path.realpath(__file__)
     pytest.main("-s -v %s" % CURRENT_FILE)
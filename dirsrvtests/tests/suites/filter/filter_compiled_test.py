@@ -0,0 +1,77 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import logging
+import pytest
+import os
+import ldap
+from lib389._constants import DEFAULT_SUFFIX
+from lib389.topologies import topology_st as topo
+from lib389.idm.organizationalunit import OrganizationalUnits
+from lib389.idm.user import UserAccounts
+
+pytestmark = pytest.mark.tier1
+
+log = logging.getLogger(__name__)
+
+
+def _uids(inst, base, fstr):
+    entries = inst.search_s(base, ldap.SCOPE_ONELEVEL, fstr, ['uid'])
+    uids = sorted(e.getValue('uid').decode() for e in entries)
+    log.info('%s: %s' % (fstr, uids))
+    return uids
+
+
+def test_filter_compiled_components(topo):
+    """Check the filter components tested with the functions resolved
+    once per search match like the other ones
+
+    :id: 2c8e5f41-7a3d-4b96-9e0f-d6b1a4c3e872
+    :setup: Standalone Instance
+    :steps:
+        1. Create users with unindexed values, some with language subtypes
+        2. Search with equality, ordering, approximate and substring filters
+        3. Search with the same filters on the subtypes
+    :expectedresults:
+        1. Success
+        2. The entries are matched with the matching rules of their attributes
+        3. The filters without options also match the subtypes, the filters
+           with options only match them
+    """
+
+    inst = topo.standalone
+    ou = OrganizationalUnits(inst, DEFAULT_SUFFIX).create(properties={'ou': 'filter_compiled'})
+    users = UserAccounts(inst, ou.dn, rdn=None)
+    for i in range(1, 7):
+        user = users.create_test_user(uid=6000 + i)
+        user.replace('roomNumber', str(i))
+        user.replace('description', 'Blue Sky %d' % i)
+        if i % 2 == 0:
+            user.add('description;lang-fr', 'Ciel %d' % i)
+
+    def uids(*numbers):
+        return sorted('test_user_%d' % (6000 + i) for i in numbers)
+
+    assert _uids(inst, ou.dn, '(description=blue SKY 3)') == uids(3)
+    assert _uids(inst, ou.dn, '(uidNumber>=6005)') == uids(5, 6)
+    assert _uids(inst, ou.dn, '(uidNumber<=6002)') == uids(1, 2)
+    assert _uids(inst, ou.dn, '(description~=blue sky)') == uids(1, 2, 3, 4, 5, 6)
+    assert _uids(inst, ou.dn, '(description=*SKY*)') == uids(1, 2, 3, 4, 5, 6)
+    assert _uids(inst, ou.dn, '(&(description=blue*)(!(roomNumber=1)))') == uids(2, 3, 4, 5, 6)
+
+    assert _uids(inst, ou.dn, '(description=ciel 2)') == uids(2)
+    assert _uids(inst, ou.dn, '(description=*ciel*)') == uids(2, 4, 6)
+    assert _uids(inst, ou.dn, '(description;lang-fr=*ciel*)') == uids(2, 4, 6)
+    assert _uids(inst, ou.dn, '(description;lang-fr=*sky*)') == []
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main("-s %s" % CURRENT_FILE)
@@ -77,6 +77,62 @@ def test_fixup_task_limit(topo):
     memberof.fixup(DEFAULT_SUFFIX)
 
 
+def test_fixup_task_parallel(topo):
+    """Test the fixup task with several threads and small batches
+
+    :id: 9d3c2f61-7b4e-4d0a-a5f8-5e61c0b2d7a4
+    :setup: Standalone Instance
+    :steps:
+        1. Add users and a group with the memberOf plugin disabled
+        2. Enable memberOf Plugin
+        3. Run a fixup task with 4 threads and batches of 50 entries
+        4. Check the memberOf values and the task checkpoint
+        5. Run the same task again
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. Every user is a member of the group, the checkpoint covers every user
+        5. Success, every entry is reported as already up to date
+    """
+
+    inst = topo.standalone
+    memberof = MemberOfPlugin(inst)
+    memberof.disable()
+    inst.restart()
+
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    group = groups.create(properties={'cn': 'parallel'})
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    members = []
+    for idx in range(300):
+        user = users.create(properties={
+            'uid': 'parallel%s' % idx,
+            'cn' : 'parallel%s' % idx,
+            'sn' : 'parallel%s' % idx,
+            'uidNumber' : '%s' % (5000 + idx),
+            'gidNumber' : '%s' % (5000 + idx),
+            'homeDirectory' : '/home/parallel%s' % idx
+        })
+        members.append(user)
+    group.replace('member', [user.dn for user in members])
+
+    memberof.enable()
+    inst.restart()
+
+    task = memberof.fixup(DEFAULT_SUFFIX, '(uid=parallel*)', threads=4, batchsize=50)
+    task.wait()
+    assert task.get_exit_code() == 0
+    assert task.get_attr_val_utf8('checkpoint') == str(len(members))
+    for user in members:
+        assert user.get_attr_vals_utf8_l('memberOf') == [group.dn.lower()]
+
+    task = memberof.fixup(DEFAULT_SUFFIX, '(uid=parallel*)', threads=4, batchsize=50)
+    task.wait()
+    assert task.get_exit_code() == 0
+    assert '%s already up to date' % len(members) in task.get_attr_val_utf8('nsTaskStatus')
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
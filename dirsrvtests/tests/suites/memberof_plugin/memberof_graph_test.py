@@ -0,0 +1,122 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import logging
+import pytest
+import os
+from lib389._constants import DEFAULT_SUFFIX
+from lib389.topologies import topology_st as topo
+from lib389.plugins import MemberOfPlugin
+from lib389.idm.user import UserAccounts
+from lib389.idm.group import Groups
+
+pytestmark = pytest.mark.tier1
+
+log = logging.getLogger(__name__)
+
+
+def _memberof(user):
+    return sorted(v.lower() for v in user.get_attr_vals_utf8('memberOf'))
+
+
+def test_memberof_graph_nested(topo):
+    """Check nested memberships are computed from the group graph
+
+    :id: 6f0d7a43-3c52-4b8e-9a1c-0b7f3e2d5a11
+    :setup: Standalone Instance
+    :steps:
+        1. Enable the memberOf plugin with memberOfGraph on
+        2. Create three nested groups and a user in the innermost one
+        3. Rename the middle group
+        4. Remove the middle group from the outer group
+        5. Run the graph check task
+    :expectedresults:
+        1. Success
+        2. The user is a member of the three groups
+        3. The user memberOf follows the new DN
+        4. The user is no longer a member of the outer group
+        5. The task finds no difference between the graph and the database
+    """
+
+    inst = topo.standalone
+    memberof = MemberOfPlugin(inst)
+    memberof.enable()
+    memberof.enable_graph()
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user = users.create_test_user(uid=1000)
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    inner = groups.create(properties={'cn': 'graph_inner', 'member': user.dn})
+    middle = groups.create(properties={'cn': 'graph_middle', 'member': inner.dn})
+    outer = groups.create(properties={'cn': 'graph_outer', 'member': middle.dn})
+    assert _memberof(user) == sorted([inner.dn.lower(), middle.dn.lower(), outer.dn.lower()])
+
+    middle.rename('cn=graph_middle2')
+    assert middle.dn.lower() in _memberof(user)
+    assert outer.present('member', middle.dn)
+
+    outer.remove('member', middle.dn)
+    assert _memberof(user) == sorted([inner.dn.lower(), middle.dn.lower()])
+
+    task = memberof.check_graph()
+    task.wait()
+    assert task.get_exit_code() == 0
+
+    memberof.disable_graph()
+
+
+def test_memberof_graph_nested_mixed_case(topo):
+    """Check the nested membership test finds memberOf values not in normalized case
+
+    :id: b84e1f27-9a06-4d3c-8e51-5c2a7f0d6e93
+    :setup: Standalone Instance
+    :steps:
+        1. Enable the memberOf plugin with memberOfGraph on
+        2. Create two nested groups and a user in the inner one
+        3. Store the user memberOf values in upper case, with one for a missing group
+        4. Remove the missing group from a group holding it, so the user memberships are tested
+    :expectedresults:
+        1. Success
+        2. The user is a member of the two groups
+        3. Success
+        4. Only the memberOf value of the missing group is removed
+    """
+
+    inst = topo.standalone
+    memberof = MemberOfPlugin(inst)
+    memberof.enable()
+    memberof.enable_graph()
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user = users.create_test_user(uid=1001)
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    inner = groups.create(properties={'cn': 'graph_case_inner', 'member': user.dn})
+    outer = groups.create(properties={'cn': 'graph_case_outer', 'member': inner.dn})
+    assert _memberof(user) == sorted([inner.dn.lower(), outer.dn.lower()])
+
+    missing_dn = 'cn=graph_case_missing,ou=groups,%s' % DEFAULT_SUFFIX
+    holder = groups.create(properties={'cn': 'graph_case_holder', 'member': missing_dn})
+    user.replace('memberOf', [inner.dn.upper(), outer.dn.upper(), missing_dn.upper()])
+
+    # the outer membership is verified through the inner group memberOf value
+    holder.remove('member', missing_dn)
+    assert _memberof(user) == sorted([inner.dn.lower(), outer.dn.lower()])
+
+    for group in (holder, outer, inner):
+        group.delete()
+    user.delete()
+    memberof.disable_graph()
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main("-s %s" % CURRENT_FILE)
@@ -9,11 +9,13 @@
 import logging
 import pytest
 import os
+import ldap
 from lib389.monitor import *
 from lib389.backend import Backends, DatabaseConfig
 from lib389._constants import *
 from lib389.topologies import topology_st as topo
 from lib389._mapped_object import DSLdapObjects
+from lib389.idm.user import UserAccounts
 
 pytestmark = pytest.mark.tier1
 
@@ -182,6 +184,38 @@ def test_num_subordinates_with_monitor_suffix(topo):
     assert len(filter2) == num_subordinates_val
 
 
+def test_monitor_ndn_cache(topo):
+    """Check the normalized dn cache statistics are shared by all the threads
+
+    :id: 3e9b7c15-6d2a-4f80-b1c4-8a5e0f2d6b93
+    :setup: Single instance
+    :steps:
+        1. Create some users
+        2. Read each user several times
+        3. Get the normalized dn cache statistics
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The reads hit the cache, the size is below the configured maximum
+    """
+
+    inst = topo.standalone
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    dns = [users.create_test_user(uid=6000 + i).dn for i in range(20)]
+    before = MonitorLDBM(inst).get_status()
+
+    for _ in range(3):
+        for dn in dns:
+            inst.search_s(dn, ldap.SCOPE_BASE, '(objectclass=*)', ['uid'])
+
+    after = MonitorLDBM(inst).get_status()
+    log.info('ndn cache: %s' % {k: v for k, v in after.items() if 'normalizeddn' in k})
+    assert int(after['normalizeddncachehits'][0]) >= int(before['normalizeddncachehits'][0]) + len(dns)
+    configured = int(inst.config.get_attr_val_utf8('nsslapd-ndn-cache-max-size'))
+    assert int(after['maxnormalizeddncachesize'][0]) == max(configured, 1048576)
+    assert 0 < int(after['currentnormalizeddncachesize'][0]) <= int(after['maxnormalizeddncachesize'][0])
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
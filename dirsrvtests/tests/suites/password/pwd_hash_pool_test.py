@@ -0,0 +1,142 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import logging
+import pytest
+import os
+import re
+import time
+import threading
+import ldap
+from lib389._constants import DEFAULT_SUFFIX, PASSWORD
+from lib389.topologies import topology_st as topo
+from lib389.monitor import Monitor
+from lib389.idm.user import UserAccounts
+
+pytestmark = pytest.mark.tier1
+
+log = logging.getLogger(__name__)
+
+
+def test_pwd_hash_pool_bind(topo):
+    """Check binds verified by the password hashing pool
+
+    :id: 6f1d9c42-83b7-4e2a-a5c0-3b8e7d14f926
+    :setup: Standalone Instance
+    :steps:
+        1. Start the server with two password hashing threads
+        2. Bind as a user with the right password
+        3. Bind as a user with a wrong password
+        4. Read the pool statistics in cn=monitor
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Invalid credentials
+        4. The pool threads and the timings of the storage scheme are reported
+    """
+
+    inst = topo.standalone
+    inst.config.replace('nsslapd-pwhash-threads', '2')
+    inst.restart()
+
+    user = UserAccounts(inst, DEFAULT_SUFFIX).create_test_user(uid=5001)
+    user.replace('userPassword', PASSWORD)
+    user.bind(PASSWORD)
+    with pytest.raises(ldap.INVALID_CREDENTIALS):
+        user.bind('not' + PASSWORD)
+
+    monitor = Monitor(inst)
+    pool = monitor.get_attr_val_utf8('pwhashpool')
+    log.info('pwhashpool: %s' % pool)
+    assert 'threads="2"' in pool
+    assert 'refused="0"' in pool
+    schemes = monitor.get_attr_vals_utf8('pwhashscheme')
+    log.info('pwhashscheme: %s' % schemes)
+    assert any('count="' in s for s in schemes)
+
+    inst.config.replace('nsslapd-pwhash-threads', '0')
+    inst.restart()
+
+
+def test_pwd_hash_pool_saturated(topo):
+    """Check that a login storm leaves worker threads to the searches
+
+    :id: 0b5e8a7d-2c61-4f93-9e4d-71a6c3f2d8b5
+    :setup: Standalone Instance
+    :steps:
+        1. Start the server with 8 worker threads, one password hashing
+           thread and no explicit limit of the hashing queue
+        2. Bind concurrently from 16 connections in a loop
+        3. Search while the binds run
+        4. Read the pool statistics in cn=monitor
+    :expectedresults:
+        1. Success
+        2. Binds succeed or are refused with LDAP_BUSY
+        3. The searches are answered while the binds run
+        4. No more verifications waited than half of the worker threads
+           minus the hashing thread
+    """
+
+    inst = topo.standalone
+    inst.config.replace('nsslapd-threadnumber', '8')
+    inst.config.replace('nsslapd-pwhash-threads', '1')
+    inst.config.replace('nsslapd-pwhash-queue-max', '0')
+    inst.restart()
+
+    user = UserAccounts(inst, DEFAULT_SUFFIX).create_test_user(uid=5002)
+    user.replace('userPassword', PASSWORD)
+    stop = threading.Event()
+    results = {'ok': 0, 'busy': 0}
+    lock = threading.Lock()
+
+    def bind_loop():
+        while not stop.is_set():
+            conn = ldap.initialize(inst.toLDAPURL())
+            try:
+                conn.simple_bind_s(user.dn, PASSWORD)
+                key = 'ok'
+            except ldap.BUSY:
+                key = 'busy'
+            finally:
+                conn.unbind_s()
+            with lock:
+                results[key] += 1
+
+    binders = [threading.Thread(target=bind_loop) for _ in range(16)]
+    for t in binders:
+        t.start()
+    try:
+        time.sleep(1)
+        for _ in range(10):
+            start = time.monotonic()
+            inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, '(uid=test_user_5002)', ['uid'])
+            elapsed = time.monotonic() - start
+            log.info('search answered in %.3fs' % elapsed)
+            assert elapsed < 2
+    finally:
+        stop.set()
+        for t in binders:
+            t.join()
+    log.info('binds: %s' % results)
+    assert results['ok'] > 0
+
+    pool = Monitor(inst).get_attr_val_utf8('pwhashpool')
+    log.info('pwhashpool: %s' % pool)
+    assert int(re.search(r'maxqueued="(\d+)"', pool).group(1)) <= 8 // 2 - 1
+
+    inst.config.replace('nsslapd-pwhash-threads', '0')
+    inst.config.replace('nsslapd-pwhash-queue-max', '256')
+    inst.config.replace('nsslapd-threadnumber', '-1')
+    inst.restart()
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main("-s %s" % CURRENT_FILE)
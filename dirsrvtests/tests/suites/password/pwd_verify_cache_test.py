@@ -0,0 +1,74 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import logging
+import re
+import pytest
+import os
+import ldap
+from lib389._constants import DEFAULT_SUFFIX, PASSWORD
+from lib389.topologies import topology_st as topo
+from lib389.monitor import Monitor
+from lib389.idm.user import UserAccounts
+
+pytestmark = pytest.mark.tier1
+
+log = logging.getLogger(__name__)
+
+
+def _hits(inst):
+    stats = Monitor(inst).get_attr_val_utf8('pwverifycache')
+    log.info('pwverifycache: %s' % stats)
+    return int(re.search(r'hits="(\d+)"', stats).group(1))
+
+
+def test_pwd_verify_cache(topo):
+    """Check successful bind verifications are reused until the password changes
+
+    :id: 0b7e4a3c-2d95-4f18-9c6a-e51f3d82a7b0
+    :setup: Standalone Instance
+    :steps:
+        1. Enable the bind verification cache
+        2. Bind twice as a user
+        3. Bind with a wrong password
+        4. Change the password of the user
+        5. Bind with the old and with the new password
+    :expectedresults:
+        1. Success
+        2. Success, the second bind is served by the cache
+        3. Invalid credentials
+        4. Success
+        5. The old password is refused, the new one is accepted
+    """
+
+    inst = topo.standalone
+    inst.config.replace('nsslapd-pwverify-cache-ttl', '300')
+
+    user = UserAccounts(inst, DEFAULT_SUFFIX).create_test_user(uid=5101)
+    user.replace('userPassword', PASSWORD)
+    hits = _hits(inst)
+    user.bind(PASSWORD)
+    user.bind(PASSWORD)
+    assert _hits(inst) == hits + 1
+
+    with pytest.raises(ldap.INVALID_CREDENTIALS):
+        user.bind('not' + PASSWORD)
+
+    user.replace('userPassword', 'new' + PASSWORD)
+    with pytest.raises(ldap.INVALID_CREDENTIALS):
+        user.bind(PASSWORD)
+    user.bind('new' + PASSWORD)
+
+    inst.config.replace('nsslapd-pwverify-cache-ttl', '0')
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main("-s %s" % CURRENT_FILE)
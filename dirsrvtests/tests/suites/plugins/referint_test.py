@@ -12,6 +12,8 @@ Created on Dec 12, 2019
 @author: tbordaz
 '''
 import logging
+import os
+import time
 import pytest
 from lib389 import Entry
 from lib389.plugins import ReferentialIntegrityPlugin
@@ -142,6 +144,58 @@ def test_invalid_referint_log(topo):
     assert inst.status()
 
 
+def test_delayed_batched_updates(topo):
+    """Check the delayed updates of many deletes and a rename
+
+    :id: 5c8a2d17-46e1-4f7b-b0a9-3d6e9f1c2b85
+    :setup: Standalone Instance
+    :steps:
+        1. Set the referint log delay
+        2. Create users in two groups
+        3. Delete most of the users, more than a batch, and rename another one
+        4. Wait for the delayed updates
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. The groups only refer to the remaining and renamed users, the
+           integrity log is consumed
+    """
+
+    inst = topo.standalone
+    plugin = ReferentialIntegrityPlugin(inst)
+    plugin.enable()
+    plugin.set_update_delay('2')
+    logfile = plugin.get_log_file()
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    members = []
+    for idx in range(300):
+        members.append(users.create_test_user(uid=3000 + idx))
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    group1 = groups.create(properties={'cn': 'batched1', 'member': [u.dn for u in members]})
+    group2 = groups.create(properties={'cn': 'batched2', 'member': [u.dn for u in members[::2]]})
+
+    for user in members[:280]:
+        user.delete()
+    renamed = members[290]
+    renamed.rename('uid=batched_renamed')
+    expected = sorted([u.dn.lower() for u in members[280:]])
+
+    for _ in range(30):
+        if sorted(group1.get_attr_vals_utf8_l('member')) == expected:
+            break
+        time.sleep(1)
+    assert sorted(group1.get_attr_vals_utf8_l('member')) == expected
+    assert sorted(group2.get_attr_vals_utf8_l('member')) == \
+        sorted([u.dn.lower() for u in members[280:] if u in members[::2]])
+    assert not os.path.exists(logfile + '.processing')
+
+    plugin.set_update_delay('0')
+    inst.restart()
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
@@ -9,17 +9,19 @@
 import ldap
 import os
 import pytest
-from lib389._constants import DEFAULT_SUFFIX
+from lib389._constants import DEFAULT_SUFFIX, DN_DM, PW_DM
 from lib389.topologies import topology_st
 from lib389.idm.group import Groups
+from lib389.idm.user import UserAccounts
 from ldap.controls.psearch import PersistentSearchControl,EntryChangeNotificationControl
 
 pytestmark = pytest.mark.tier1
 
-def _run_psearch(inst, msg_id):
+def _run_psearch(inst, msg_id, log=None):
     """Run a search with EntryChangeNotificationControl"""
 
     results = []
+    log = log or inst.log
     while True:
         try:
             _, data, _, _, _, _ = inst.result4(msgid=msg_id, all=0, timeout=1.0, add_ctrls=1, add_intermediates=1,
@@ -28,11 +30,11 @@ def _run_psearch(inst, msg_id):
             for dn, entry, srv_ctrls in data:
                 ecn_ctrls = filter(lambda c: c.controlType == EntryChangeNotificationControl.controlType, srv_ctrls)
                 if ecn_ctrls:
-                    inst.log.info('%s has changed!' % dn)
+                    log.info('%s has changed!' % dn)
                     results.append(dn)
         except ldap.TIMEOUT:
             # There are no more results, so we timeout.
-            inst.log.info('No more results')
+            log.info('No more results')
             return results
 
 
@@ -68,6 +70,56 @@ def test_psearch(topology_st):
     assert(group.dn == results[0])
 
 
+def test_psearch_many_clients(topology_st):
+    """Check persistent searches sharing the same subscription
+
+    :id: 9c1e5d2a-7b3f-4e60-8a4d-3f2b6c0e1d97
+    :setup: Standalone instance
+    :steps:
+        1. Open more persistent searches than sender threads, most of them with the same filter
+        2. Create groups and a user
+        3. Check the changes received by each persistent search
+        4. Abandon a persistent search and create another group
+        5. Check the changes received by the remaining persistent searches
+    :expectedresults:
+        1. Operation should be successful
+        2. Entries should be successfully created
+        3. Every search received, in order, the changes matching its filter
+        4. Operation should be successful
+        5. The new group is received by the remaining searches
+    """
+
+    inst = topology_st.standalone
+    psc = PersistentSearchControl()
+    searches = []
+    for idx in range(12):
+        conn = ldap.initialize(inst.toLDAPURL())
+        conn.simple_bind_s(DN_DM, PW_DM)
+        filterstr = '(objectClass=groupOfNames)' if idx % 4 else '(objectClass=*)'
+        msg_id = conn.search_ext(base=DEFAULT_SUFFIX, scope=ldap.SCOPE_SUBTREE, filterstr=filterstr,
+                                 attrlist=['cn'], serverctrls=[psc])
+        _run_psearch(conn, msg_id, inst.log)
+        searches.append((conn, msg_id, filterstr))
+
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    created = [groups.create(properties={'cn': 'ps_group%d' % idx}).dn for idx in range(5)]
+    user = UserAccounts(inst, DEFAULT_SUFFIX).create_test_user(uid=2000)
+
+    for conn, msg_id, filterstr in searches:
+        results = _run_psearch(conn, msg_id, inst.log)
+        if filterstr == '(objectClass=*)':
+            assert results == created + [user.dn]
+        else:
+            assert results == created
+
+    conn, msg_id, _ = searches.pop()
+    conn.abandon(msg_id)
+    group = groups.create(properties={'cn': 'ps_group_last'})
+    for conn, msg_id, _ in searches:
+        assert _run_psearch(conn, msg_id, inst.log) == [group.dn]
+        conn.unbind_s()
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
@@ -0,0 +1,112 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import os
+import logging
+import ldap
+import pytest
+from lib389._constants import DEFAULT_SUFFIX
+from lib389.idm.user import UserAccounts
+from lib389.idm.organizationalunit import OrganizationalUnits
+from lib389.replica import ReplicationManager
+from lib389.topologies import topology_m2 as topo_m2
+
+pytestmark = pytest.mark.tier1
+
+log = logging.getLogger(__name__)
+
+APPLY_CONCURRENCY = 'nsslapd-repl-apply-concurrency'
+
+
+@pytest.fixture
+def parallel_apply(topo_m2, request):
+    """Let supplier2 apply the updates received from supplier1 concurrently"""
+
+    s2 = topo_m2.ms["supplier2"]
+    s2.config.set(APPLY_CONCURRENCY, '4')
+
+    def fin():
+        s2.config.set(APPLY_CONCURRENCY, '1')
+
+    request.addfinalizer(fin)
+
+
+def test_apply_concurrency_value(topo_m2):
+    """Check the range of nsslapd-repl-apply-concurrency
+
+    :id: b0337eec-fe1c-409c-937e-7c814fd31997
+    :setup: Two suppliers replication
+    :steps:
+        1. Check the default value
+        2. Set a valid value
+        3. Set invalid values
+    :expectedresults:
+        1. Updates are applied serially by default
+        2. Success
+        3. Unwilling to perform is raised
+    """
+
+    s2 = topo_m2.ms["supplier2"]
+    assert s2.config.get_attr_val_int(APPLY_CONCURRENCY) == 1
+    s2.config.set(APPLY_CONCURRENCY, '8')
+    for value in ['0', '-1', '65536', 'abc']:
+        with pytest.raises(ldap.LDAPError):
+            s2.config.set(APPLY_CONCURRENCY, value)
+    s2.config.set(APPLY_CONCURRENCY, '1')
+
+
+def test_parallel_apply(topo_m2, parallel_apply):
+    """Check that updates applied concurrently by the consumer converge
+
+    :id: 12603991-4ffa-47fe-83a3-acadcc5737e5
+    :setup: Two suppliers replication, supplier2 applies updates concurrently
+    :steps:
+        1. On supplier1 add a container and users below it, interleaved with
+           modifies of the same entries, renames and deletes
+        2. Wait for replication to supplier2
+        3. Compare the entries on both suppliers
+        4. Check replication still works both ways
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Both suppliers have the same entries and values
+        4. Success
+    """
+
+    s1 = topo_m2.ms["supplier1"]
+    s2 = topo_m2.ms["supplier2"]
+    repl = ReplicationManager(DEFAULT_SUFFIX)
+
+    ou = OrganizationalUnits(s1, DEFAULT_SUFFIX).create(properties={'ou': 'parallel_apply'})
+    users = UserAccounts(s1, ou.dn, rdn=None)
+    created = []
+    for i in range(200):
+        user = users.create_test_user(uid=10000 + i)
+        user.replace('description', 'first %d' % i)
+        user.replace('description', 'second %d' % i)
+        created.append(user)
+    for user in created[:20]:
+        user.delete()
+    for user in created[20:40]:
+        user.rename('uid=renamed_%s' % user.get_attr_val_utf8('uid'))
+
+    repl.wait_for_replication(s1, s2)
+
+    s1_users = {u.dn.lower(): u.get_attr_val_utf8('description') for u in UserAccounts(s1, ou.dn, rdn=None).list()}
+    s2_users = {u.dn.lower(): u.get_attr_val_utf8('description') for u in UserAccounts(s2, ou.dn, rdn=None).list()}
+    assert len(s1_users) == 180
+    assert s1_users == s2_users
+
+    repl.test_replication_topology(topo_m2)
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main(["-s", CURRENT_FILE])
@@ -0,0 +1,107 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import os
+import logging
+import pytest
+from lib389._constants import DEFAULT_SUFFIX
+from lib389.idm.user import UserAccounts
+from lib389.replica import Replicas, ReplicationManager
+from lib389.topologies import topology_m2 as topo_m2
+
+pytestmark = pytest.mark.tier1
+
+log = logging.getLogger(__name__)
+
+NUM_USERS = 50
+
+
+def test_update_latency_status(topo_m2):
+    """Check the replication lag statistics published by the agreement
+
+    :id: 3fd998fe-4a7b-4915-b1a2-d4672774736e
+    :setup: Two suppliers replication
+    :steps:
+        1. Read the latency statistics of the agreement to supplier2
+        2. Add users on supplier1 and wait for replication
+        3. Read the latency statistics again
+        4. Check the percentiles are ordered and bounded by the maximum
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The sample count grew by at least the number of users added
+        4. Success
+    """
+
+    s1 = topo_m2.ms["supplier1"]
+    s2 = topo_m2.ms["supplier2"]
+    agmt = Replicas(s1).get(DEFAULT_SUFFIX).get_agreements().list()[0]
+
+    before = agmt.get_update_latency()
+    assert before is not None
+
+    users = UserAccounts(s1, DEFAULT_SUFFIX)
+    for idx in range(NUM_USERS):
+        users.create_test_user(uid=5000 + idx)
+    ReplicationManager(DEFAULT_SUFFIX).wait_for_replication(s1, s2)
+
+    after = agmt.get_update_latency()
+    log.info('Update latency: {}'.format(after))
+    assert after['samples'] >= before['samples'] + NUM_USERS
+    assert after['updates_last_minute'] > 0
+    for dist in ('lag_ms', 'ack_us'):
+        values = after[dist]
+        assert values['p50'] <= values['p90'] <= values['p99'] <= values['p999'] <= values['max']
+    assert agmt.present('nsds5replicaUpdateLagP99')
+
+
+def test_adaptive_flow_control(topo_m2):
+    """Check the adaptive flow control keeps its window within bounds
+
+    :id: 0b6f0d0e-9a0c-4a51-8d6e-2f3f6a8f1c47
+    :setup: Two suppliers replication
+    :steps:
+        1. Enable the adaptive flow control on the agreement to supplier2
+        2. Add users on supplier1 and wait for replication
+        3. Read the flow control state of the agreement
+        4. Disable the adaptive flow control
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The mode is adaptive and the window is bounded by the configured window
+        4. The mode is static again
+    """
+
+    s1 = topo_m2.ms["supplier1"]
+    s2 = topo_m2.ms["supplier2"]
+    agmt = Replicas(s1).get(DEFAULT_SUFFIX).get_agreements().list()[0]
+    max_window = 50
+    agmt.replace_many(('nsds5ReplicaFlowControlWindow', str(max_window)),
+                      ('nsds5ReplicaFlowControlAdaptive', 'on'))
+
+    users = UserAccounts(s1, DEFAULT_SUFFIX)
+    for idx in range(NUM_USERS):
+        users.create_test_user(uid=6000 + idx)
+    ReplicationManager(DEFAULT_SUFFIX).wait_for_replication(s1, s2)
+
+    state = agmt.get_flow_control_state()
+    log.info('Flow control state: {}'.format(state))
+    assert state['mode'] == 'adaptive'
+    assert state['max_window'] == max_window
+    assert 2 <= state['window'] <= max_window
+    assert state['phase'] in ('slow-start', 'congestion-avoidance')
+
+    agmt.replace('nsds5ReplicaFlowControlAdaptive', 'off')
+    assert agmt.get_flow_control_state()['mode'] == 'static'
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main("-s %s" % CURRENT_FILE)
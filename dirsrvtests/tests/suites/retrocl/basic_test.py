@@ -20,6 +20,7 @@ from lib389.cli_conf.plugins.retrochangelog import retrochangelog_add
 from lib389.idm.user import UserAccount, UserAccounts
 from lib389.idm.domain import Domain
 from lib389._mapped_object import DSLdapObjects
+from ldap.controls.psearch import PersistentSearchControl
 
 pytestmark = pytest.mark.tier1
 
@@ -419,6 +420,138 @@ def test_retrocl_trimming_interval(topology_st, request):
 
     request.addfinalizer(fin)
 
+
+def test_retrocl_compact_storage(topology_st, request):
+    """Test the changes stored in the compact changelog are served under cn=changelog
+
+    :id: 5e2b8f1c-7d4a-4c3e-9b6f-1a0d3c8e7f52
+    :setup: Standalone Instance
+    :steps:
+        1. Enable Retro changelog with the compact storage
+        2. Add a user and modify it a few times
+        3. Search the changelog
+        4. Search a range of change numbers, and a single change record
+        5. Restart the instance and do another update
+        6. Search the changelog again
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The changes are returned with the changelog entry attributes
+        4. Only the requested changes are returned
+        5. Success
+        6. The changes survived the restart and the numbering carries on
+    """
+
+    inst = topology_st.standalone
+    rcl = RetroChangelogPlugin(inst)
+    rcl.enable()
+    rcl.replace('nsslapd-changelog-storage', 'compact')
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user = users.create_test_user(uid=7000)
+    for idx in range(5):
+        user.replace('description', 'compact %d' % idx)
+
+    changelog = DSLdapObjects(inst, basedn=RETROCL_SUFFIX)
+    changes = changelog.filter('(targetDn=%s)' % user.dn, scope=ldap.SCOPE_ONELEVEL)
+    assert len(changes) == 6
+    numbers = sorted(int(c.get_attr_val_utf8('changeNumber')) for c in changes)
+    assert numbers == list(range(numbers[0], numbers[0] + 6))
+    for change in changes:
+        assert change.present('objectclass', 'changelogentry')
+        assert change.present('changeTime')
+    add = [c for c in changes if c.get_attr_val_utf8('changeType') == 'add']
+    assert len(add) == 1
+    assert 'uid: test_user_7000' in add[0].get_attr_val_utf8('changes')
+
+    first = numbers[1]
+    ranged = changelog.filter('(&(changeNumber>=%d)(changeNumber<=%d))' % (first, first + 1))
+    assert sorted(int(c.get_attr_val_utf8('changeNumber')) for c in ranged) == [first, first + 1]
+    record = DSLdapObjects(inst, basedn='changenumber=%d,%s' % (first, RETROCL_SUFFIX))
+    record = record.filter('(objectclass=*)', scope=ldap.SCOPE_BASE)
+    assert len(record) == 1
+    assert record[0].get_attr_val_utf8('changeType') == 'modify'
+    assert 'replace: description' in record[0].get_attr_val_utf8('changes')
+
+    assert inst.rootdse.get_attr_val_int('lastchangenumber') == numbers[-1]
+
+    inst.restart()
+    user.replace('description', 'after restart')
+    changes = changelog.filter('(targetDn=%s)' % user.dn, scope=ldap.SCOPE_ONELEVEL)
+    assert sorted(int(c.get_attr_val_utf8('changeNumber')) for c in changes) == numbers + [numbers[-1] + 1]
+
+    def fin():
+        rcl.remove_all('nsslapd-changelog-storage')
+        inst.restart()
+
+    request.addfinalizer(fin)
+
+
+def _psearch_results(inst, msg_id):
+    """Collect the entries of a persistent search until it goes quiet"""
+
+    dns = []
+    while True:
+        try:
+            rtype, data, _, _, _, _ = inst.result4(msgid=msg_id, all=0, timeout=1.0)
+        except ldap.TIMEOUT:
+            return dns
+        # the search must stay open, a search result done ends the psearch
+        assert rtype == ldap.RES_SEARCH_ENTRY
+        dns.extend(dn.lower() for dn, _ in data)
+
+
+def test_retrocl_compact_storage_psearch(topology_st, request):
+    """Test a persistent search of cn=changelog with the compact storage
+
+    :id: 0c7a9e34-2f61-4b8d-a5e3-6d1f8b2c9a07
+    :setup: Standalone Instance
+    :steps:
+        1. Enable Retro changelog with the compact storage
+        2. Add a user
+        3. Start a persistent search of cn=changelog, and one with changesOnly
+        4. Modify the user
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The stored changes are returned, none with changesOnly, and both searches stay open
+        4. Both searches return the new change
+    """
+
+    inst = topology_st.standalone
+    rcl = RetroChangelogPlugin(inst)
+    rcl.enable()
+    rcl.replace('nsslapd-changelog-storage', 'compact')
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user = users.create_test_user(uid=7001)
+    last = inst.rootdse.get_attr_val_int('lastchangenumber')
+    last_dn = 'changenumber=%d,%s' % (last, RETROCL_SUFFIX)
+
+    all_id = inst.search_ext(RETROCL_SUFFIX, ldap.SCOPE_ONELEVEL, '(objectclass=changelogentry)',
+                             serverctrls=[PersistentSearchControl(changesOnly=False)])
+    only_id = inst.search_ext(RETROCL_SUFFIX, ldap.SCOPE_ONELEVEL, '(objectclass=changelogentry)',
+                              serverctrls=[PersistentSearchControl(changesOnly=True)])
+    assert last_dn.lower() in _psearch_results(inst, all_id)
+    assert _psearch_results(inst, only_id) == []
+
+    user.replace('description', 'compact psearch')
+    new_dn = 'changenumber=%d,%s' % (last + 1, RETROCL_SUFFIX)
+    assert _psearch_results(inst, all_id) == [new_dn.lower()]
+    assert _psearch_results(inst, only_id) == [new_dn.lower()]
+
+    def fin():
+        inst.abandon(all_id)
+        inst.abandon(only_id)
+        user.delete()
+        rcl.remove_all('nsslapd-changelog-storage')
+        inst.restart()
+
+    request.addfinalizer(fin)
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
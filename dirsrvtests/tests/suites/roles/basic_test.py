@@ -11,6 +11,7 @@
 Importing necessary Modules.
 """
 
+import ldap
 import logging
 import time
 import os
@@ -23,6 +24,7 @@ from lib389.idm.organizationalunit import OrganizationalUnit
 from lib389.topologies import topology_st as topo
 from lib389.idm.role import FilteredRoles, ManagedRoles, NestedRoles
 from lib389.idm.domain import Domain
+from lib389.plugins import RolesPlugin
 
 logging.getLogger(__name__).setLevel(logging.INFO)
 log = logging.getLogger(__name__)
@@ -504,6 +506,75 @@ def test_vattr_on_managed_role(topo, request):
 
     request.addfinalizer(fin)
 
+def test_membership_index(topo, request):
+    """Check nsRole is served by the role membership index
+
+    :id: 5b0e8c6d-2a47-4f19-b3e1-7c9d4a6f0e25
+    :setup: Standalone instance
+    :steps:
+        1. Enable nsRoleMembershipIndex and restart
+        2. Add a managed, a filtered and a nested role and users
+        3. Read nsRole of the users twice and search with an nsrole filter
+        4. Remove the managed role of a user
+        5. Change the filter of the filtered role
+        6. Disable nsRoleMembershipIndex and restart
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The roles are correct and the second reads are index hits
+        4. nsRole of the user no longer contains the managed and nested roles
+        5. nsRole of the users follows the new filter
+        6. Success
+    """
+    inst = topo.standalone
+    plugin = RolesPlugin(inst)
+    plugin.enable_membership_index()
+    inst.restart()
+
+    managed = ManagedRoles(inst, DEFAULT_SUFFIX).create(properties={'cn': 'index_managed'})
+    filtered = FilteredRoles(inst, DEFAULT_SUFFIX).create(properties={'cn': 'index_filtered',
+                                                                     'nsRoleFilter': '(employeeType=eng)'})
+    nested = NestedRoles(inst, DEFAULT_SUFFIX).create(properties={'cn': 'index_nested',
+                                                                 'nsRoleDN': [managed.dn]})
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user1 = users.create_test_user(uid=4001)
+    user1.replace_many(('nsRoleDN', managed.dn), ('employeeType', 'eng'))
+    user2 = users.create_test_user(uid=4002)
+    user2.replace('employeeType', 'sales')
+
+    def _nsrole(user):
+        return sorted(v.lower() for v in user.get_attr_vals_utf8('nsRole'))
+
+    expected = sorted([managed.dn.lower(), filtered.dn.lower(), nested.dn.lower()])
+    assert _nsrole(user1) == expected
+    assert _nsrole(user2) == []
+    before = plugin.get_index_stats()
+    assert _nsrole(user1) == expected
+    found = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, '(nsrole={})'.format(nested.dn), ['uid'])
+    assert [e.dn.lower() for e in found] == [user1.dn.lower()]
+    after = plugin.get_index_stats()
+    log.info('Role index statistics: {}'.format(after))
+    assert after['hits'] > before['hits']
+    assert after['entries'] > 0
+
+    user1.remove('nsRoleDN', managed.dn)
+    assert _nsrole(user1) == [filtered.dn.lower()]
+
+    filtered.replace('nsRoleFilter', '(employeeType=sales)')
+    time.sleep(1)
+    assert _nsrole(user1) == []
+    assert _nsrole(user2) == [filtered.dn.lower()]
+
+    def fin():
+        for entry in (user1, user2, nested, filtered, managed):
+            if entry.exists():
+                entry.delete()
+        plugin.disable_membership_index()
+        inst.restart()
+
+    request.addfinalizer(fin)
+
+
 if __name__ == "__main__":
     CURRENT_FILE = os.path.realpath(__file__)
     pytest.main("-s -v %s" % CURRENT_FILE)
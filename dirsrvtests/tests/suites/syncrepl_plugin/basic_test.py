@@ -735,3 +735,191 @@ def test_sync_repl_invalid_cookie(topology, request):
             pass
 
     request.addfinalizer(fin)
+
+
+class CountingSyncRepl(ISyncRepl):
+    """ISyncRepl counting the entries sent during a refresh, including duplicates"""
+    def syncrepl_search(self, *args, **kwargs):
+        self.entry_count = 0
+        super().syncrepl_search(*args, **kwargs)
+
+    def syncrepl_entry(self, dn, attrs, uuid):
+        self.entry_count += 1
+        super().syncrepl_entry(dn, attrs, uuid)
+
+
+def test_sync_repl_chunked_refresh(topology, request):
+    """Test a cookie based refresh spanning several changelog chunks
+
+    :id: 2d8c6b0e-5f7a-4c3e-9b61-7a4e0d9f1c58
+    :setup: Standalone instance
+    :steps:
+        1. Enable retroCL/content_sync with a small refresh memory budget
+        2. Establish a sync_repl connection and save the cookie
+        3. Add, modify twice and delete users
+        4. Refresh with the saved cookie
+    :expectedresults:
+        1. Should succeeds
+        2. Should succeeds
+        3. Should succeeds
+        4. Every remaining user is sent once and no deleted user is sent
+    """
+    num_users = 80
+    num_deleted = 10
+    st = topology.standalone
+    rcl = RetroChangelogPlugin(st)
+    rcl.enable()
+    rcl.replace('nsslapd-attribute', 'nsuniqueid:targetUniqueId')
+    csp = ContentSyncPlugin(st)
+    csp.enable()
+    # 16KB of budget gives chunks of 32 changes
+    csp.replace('syncrepl-refresh-memory-budget', '16384')
+    st.restart()
+
+    sync = CountingSyncRepl(st)
+    sync.syncrepl_search(base=DEFAULT_SUFFIX)
+    sync.syncrepl_complete()
+
+    users = UserAccounts(st, DEFAULT_SUFFIX)
+    created = [users.create_test_user(uid=7000 + idx) for idx in range(num_users)]
+    for user in created:
+        user.replace('description', 'first')
+    for user in created:
+        user.replace('description', 'second')
+    for user in created[:num_deleted]:
+        user.delete()
+
+    sync.syncrepl_search(base=DEFAULT_SUFFIX)
+    sync.syncrepl_complete()
+    received = [dn.lower() for dn in sync.entries]
+    for user in created[num_deleted:]:
+        assert user.dn.lower() in received
+    for user in created[:num_deleted]:
+        assert user.dn.lower() not in received
+    # An entry changed in several chunks is sent only once
+    assert sync.entry_count == len(sync.entries)
+
+    def fin():
+        csp.remove_all('syncrepl-refresh-memory-budget')
+        for user in created[num_deleted:]:
+            user.delete()
+        st.restart()
+
+    request.addfinalizer(fin)
+
+
+def test_sync_repl_chunked_refresh_readd(topology, request):
+    """Test a refresh where entries are added, deleted and added again in different chunks
+
+    :id: 8a3f1e62-0d4b-4c97-b5e8-2f6c9a7d1b03
+    :setup: Standalone instance
+    :steps:
+        1. Enable retroCL/content_sync with a small refresh memory budget
+        2. Establish a sync_repl connection and save the cookie
+        3. Add users, then enough changes to fill a chunk
+        4. Delete the users, then enough changes to fill a chunk
+        5. Add the users again
+        6. Refresh with the saved cookie
+    :expectedresults:
+        1. Should succeeds
+        2. Should succeeds
+        3. Should succeeds
+        4. Should succeeds
+        5. Should succeeds
+        6. The users added again are sent
+    """
+    num_users = 10
+    st = topology.standalone
+    rcl = RetroChangelogPlugin(st)
+    rcl.enable()
+    rcl.replace('nsslapd-attribute', 'nsuniqueid:targetUniqueId')
+    csp = ContentSyncPlugin(st)
+    csp.enable()
+    # 16KB of budget gives chunks of 32 changes
+    csp.replace('syncrepl-refresh-memory-budget', '16384')
+    st.restart()
+
+    sync = CountingSyncRepl(st)
+    sync.syncrepl_search(base=DEFAULT_SUFFIX)
+    sync.syncrepl_complete()
+
+    users = UserAccounts(st, DEFAULT_SUFFIX)
+    filler = users.create_test_user(uid=7900)
+    created = [users.create_test_user(uid=7800 + idx) for idx in range(num_users)]
+    for idx in range(40):
+        filler.replace('description', 'first %d' % idx)
+    for user in created:
+        user.delete()
+    for idx in range(40):
+        filler.replace('description', 'second %d' % idx)
+    readded = [users.create_test_user(uid=7800 + idx) for idx in range(num_users)]
+
+    sync.syncrepl_search(base=DEFAULT_SUFFIX)
+    sync.syncrepl_complete()
+    received = [dn.lower() for dn in sync.entries]
+    for user in readded:
+        assert user.dn.lower() in received
+    assert filler.dn.lower() in received
+
+    def fin():
+        csp.remove_all('syncrepl-refresh-memory-budget')
+        for user in readded + [filler]:
+            user.delete()
+        st.restart()
+
+    request.addfinalizer(fin)
+
+
+def test_sync_repl_compact_changelog(topology, request):
+    """Test the cookies carry the change numbers of the compact changelog
+
+    :id: 4e9b2c7a-1d63-4f08-8a5c-b3e7f0d2a916
+    :setup: Standalone instance
+    :steps:
+        1. Enable retroCL with the compact storage and content_sync
+        2. Add a user and establish a sync_repl connection
+        3. Add and modify other users
+        4. Refresh with the saved cookie
+    :expectedresults:
+        1. Should succeeds
+        2. The cookie carries the last change number of the changelog
+        3. Should succeeds
+        4. Only the changed users are sent and the cookie carries the new last change number
+    """
+    st = topology.standalone
+    rcl = RetroChangelogPlugin(st)
+    rcl.enable()
+    rcl.replace('nsslapd-attribute', 'nsuniqueid:targetUniqueId')
+    rcl.replace('nsslapd-changelog-storage', 'compact')
+    csp = ContentSyncPlugin(st)
+    csp.enable()
+    st.restart()
+
+    users = UserAccounts(st, DEFAULT_SUFFIX)
+    unchanged = users.create_test_user(uid=7950)
+    sync = ISyncRepl(st)
+    sync.syncrepl_search(base=DEFAULT_SUFFIX)
+    sync.syncrepl_complete()
+    last = st.rootdse.get_attr_val_int('lastchangenumber')
+    assert last > 0
+    assert int(sync.cookie.split('#')[-1]) == last
+
+    created = [users.create_test_user(uid=7960 + idx) for idx in range(3)]
+    for user in created:
+        user.replace('description', 'compact')
+
+    sync.syncrepl_search(base=DEFAULT_SUFFIX)
+    sync.syncrepl_complete()
+    received = [dn.lower() for dn in sync.entries]
+    for user in created:
+        assert user.dn.lower() in received
+    assert unchanged.dn.lower() not in received
+    assert int(sync.cookie.split('#')[-1]) == st.rootdse.get_attr_val_int('lastchangenumber')
+
+    def fin():
+        for user in created + [unchanged]:
+            user.delete()
+        rcl.remove_all('nsslapd-changelog-storage')
+        st.restart()
+
+    request.addfinalizer(fin)
@@ -67,6 +67,8 @@ static void print_access_control_summary(char *source,
                                          const char *edn,
                                          aclResultReason_t *acl_reason);
 static int check_rdn_access(Slapi_PBlock *pb, Slapi_Entry *e, const char *newrdn, int access);
+static int acl__is_group_objectclass(const char *oc);
+static int acl__entry_is_group(Slapi_Entry *e);
 static struct targetfilter_cached_result *targetfilter_cache_lookup(struct acl_pblock *aclpb, char *filter, PRBool filter_valid);
 static void targetfilter_cache_add(struct acl_pblock *aclpb, char *filter, int result, PRBool filter_valid);
 
@@ -295,6 +297,11 @@ acl_access_allowed(
     int loglevel;
     PRUint64 o_connid = 0xffffffffffffffff; /* no op */
     int o_opid = -1;                        /* no op */
+    char *dc_key = NULL;                    /* decision cache key */
+    char *db_key = NULL;                    /* decision key within the operation */
+    uint64_t dc_epoch = 0;
+    int dc_state = 0;
+    int dc_evaluated = 0;
 
     loglevel = slapi_is_loglevel_set(SLAPI_LOG_ACL) ? SLAPI_LOG_ACL : SLAPI_LOG_ACLSUMMARY;
     slapi_pblock_get(pb, SLAPI_OPERATION, &op); /* for logging */
@@ -498,6 +505,26 @@ acl_access_allowed(
     aclpb->aclpb_access = 0;
     aclpb->aclpb_access |= access;
 
+    /*
+     * Has the same decision been taken for a similar entry, earlier in
+     * this search or by another operation ? Then we don't even need to
+     * look at the entry. Its evaluation context is left untouched, so the
+     * context of the previous entry can not be trusted for it.
+     */
+    db_key = acl_decision_batch_key(pb, aclpb, e, clientDn, attr, access);
+    dc_key = acl_decision_cache_key(pb, aclpb, e, clientDn, attr, val, access, &dc_epoch);
+    if ((db_key && acl_decision_batch_lookup(aclpb, db_key, &ret_val, &dc_state)) ||
+        (dc_key && acl_decision_cache_lookup(dc_key, &ret_val, &dc_state))) {
+        aclpb->aclpb_state &= ~(ACLPB_DECISION_STATE_MASK | ACLPB_MATCHES_ALL_ACLS);
+        aclpb->aclpb_state |= dc_state;
+        if (ret_val == LDAP_SUCCESS) {
+            decision_reason.reason = ACL_REASON_DECISION_CACHED_ALLOW;
+        } else {
+            decision_reason.reason = ACL_REASON_DECISION_CACHED_DENY;
+        }
+        goto cleanup_and_ret;
+    }
+
     /*
      * stub the Slapi_Entry info  first time and only it has changed
      * or if the pblock is a psearch pblock--in this case the lifetime
@@ -644,6 +671,7 @@ acl_access_allowed(
         else {
             ret_val = LDAP_INSUFFICIENT_ACCESS;
             decision_reason.reason = ACL_REASON_NO_MATCHED_RESOURCE_ALLOWS;
+            dc_evaluated = 1;
         }
         goto cleanup_and_ret;
     }
@@ -675,11 +703,26 @@ acl_access_allowed(
     } else {
         ret_val = LDAP_INSUFFICIENT_ACCESS;
     }
+    dc_evaluated = 1;
 
 cleanup_and_ret:
 
     TNF_PROBE_0_DEBUG(acl_cleanup_start, "ACL", "");
 
+    /* Remember the decision if it holds for all the entries of the key */
+    if (dc_key) {
+        if (dc_evaluated && acl_decision_cache_acis_eligible(aclpb, e)) {
+            acl_decision_cache_insert(dc_key, dc_epoch, ret_val, aclpb->aclpb_state);
+        }
+        slapi_ch_free_string(&dc_key);
+    }
+    if (db_key) {
+        if (dc_evaluated) {
+            acl_decision_batch_insert(aclpb, e, db_key, ret_val, aclpb->aclpb_state);
+        }
+        slapi_ch_free_string(&db_key);
+    }
+
     /* I am ready to get out. */
     if (got_reader_locked)
         acllist_acicache_READ_UNLOCK();
@@ -746,6 +789,8 @@ print_access_control_summary(char *source, int ret_val, char *clientDn, struct a
         {ACL_REASON_EVALCONTEXT_CACHED_ALLOW, "cached context/parent allow"},
         {ACL_REASON_EVALCONTEXT_CACHED_NOT_ALLOWED, "cached context/parent deny"},
         {ACL_REASON_EVALCONTEXT_CACHED_ATTR_STAR_ALLOW, "cached context/parent allow any attr"},
+        {ACL_REASON_DECISION_CACHED_ALLOW, "cached decision allow"},
+        {ACL_REASON_DECISION_CACHED_DENY, "cached decision deny"},
         {ACL_REASON_NONE, "error occurred"},
     };
 
@@ -1716,10 +1761,7 @@ acl_modified(Slapi_PBlock *pb, int optype, Slapi_DN *e_sdn, void *change)
         i = slapi_attr_first_value(attr, &sval);
         while (i != -1) {
             attrVal = slapi_value_get_berval(sval);
-            if ((strcasecmp(attrVal->bv_val, "groupOfNames") == 0) ||
-                (strcasecmp(attrVal->bv_val, "groupOfUniqueNames") == 0) ||
-                (strcasecmp(attrVal->bv_val, "groupOfCertificates") == 0) ||
-                (strcasecmp(attrVal->bv_val, "groupOfURLs") == 0)) {
+            if (acl__is_group_objectclass(attrVal->bv_val)) {
                 group_change = 1;
                 if (optype == SLAPI_OPERATION_MODIFY) {
                     Slapi_Attr *a = NULL;
@@ -1758,11 +1800,29 @@ acl_modified(Slapi_PBlock *pb, int optype, Slapi_DN *e_sdn, void *change)
             aclg_regen_group_signature();
             if ((optype == SLAPI_OPERATION_MODIFY) || (optype == SLAPI_OPERATION_DELETE)) {
                 /* Then we need to invalidate the acl signature also */
-                acl_signature = aclutil_gen_signature(acl_signature);
+                acl_regen_aclsignature();
             }
         }
     }
 
+    /*
+    ** The group closures going through that entry are stale if it was, or
+    ** just became, a group. A rename may move nested groups around, and
+    ** the closures only know their dn: drop them all.
+    */
+    if (optype == SLAPI_OPERATION_MODRDN) {
+        acl_group_closure_invalidate(NULL);
+    } else {
+        Slapi_Entry *post_e = NULL;
+
+        if (optype == SLAPI_OPERATION_MODIFY) {
+            slapi_pblock_get(pb, SLAPI_ENTRY_POST_OP, (void *)&post_e);
+        }
+        if (acl__entry_is_group(e) || acl__entry_is_group(post_e)) {
+            acl_group_closure_invalidate(n_dn);
+        }
+    }
+
     /*
      * Here if the target entry is in the group cache
      * as a user then, as it's being changed it may move out of any dynamic
@@ -1792,6 +1852,8 @@ acl_modified(Slapi_PBlock *pb, int optype, Slapi_DN *e_sdn, void *change)
                       "acl_modified - Marking entry %s for removal from ACL user Group Cache\n",
                       n_dn);
         aclg_markUgroupForRemoval(ugroup);
+        /* The dynamic groups of that user may be different now */
+        acl_decision_cache_invalidate();
     }
 
     /*
@@ -1980,6 +2042,39 @@ acl_modified(Slapi_PBlock *pb, int optype, Slapi_DN *e_sdn, void *change)
     } /*optype switch */
 }
 
+/* The objectclasses of the groups the ACIs can refer to */
+static int
+acl__is_group_objectclass(const char *oc)
+{
+    static const char *const group_ocs[] = {"groupOfNames", "groupOfUniqueNames",
+                                            "groupOfCertificates", "groupOfURLs", NULL};
+
+    for (size_t i = 0; oc && group_ocs[i]; i++) {
+        if (strcasecmp(oc, group_ocs[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+acl__entry_is_group(Slapi_Entry *e)
+{
+    Slapi_Attr *attr = NULL;
+    Slapi_Value *sval = NULL;
+    int i;
+
+    if (NULL == e || slapi_entry_attr_find(e, "objectclass", &attr) != 0) {
+        return 0;
+    }
+    for (i = slapi_attr_first_value(attr, &sval); i != -1; i = slapi_attr_next_value(attr, i, &sval)) {
+        if (acl__is_group_objectclass(slapi_value_get_string(sval))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 /***************************************************************************
 *
 * acl__scan_for_acis
@@ -4225,6 +4320,7 @@ void
 acl_regen_aclsignature()
 {
     acl_signature = aclutil_gen_signature(acl_signature);
+    acl_decision_cache_invalidate();
 }
 
 
@@ -260,6 +260,7 @@ typedef struct aci
  */
 #define ACI_PARAM_DNRULE    (short)0x0400
 #define ACI_PARAM_ATTRRULE  (short)0x0800
+#define ACI_USERDN_URLRULE  (short)0x0100 /* userdn = "ldap:///base??scope?(filter)" */
 #define ACI_USERDN_SELFRULE (short)0x1000
 #define ACI_ROLEDN_RULE     (short)0x2000
 #define ACI_SSF_RULE        (short)0x4000
@@ -314,6 +315,15 @@ typedef struct aci
 extern int aclpb_max_selected_acls; /* initialized from plugin config entry */
 extern int aclpb_max_cache_results; /* initialized from plugin config entry */
 
+/*
+ * Number of read/search decisions kept across operations by the
+ * decision cache (acldecision.c). 0 disables the cache.
+ */
+#define ATTR_ACL_DECISION_CACHE_SIZE    "nsslapd-acl-decision-cache-size"
+#define DEFAULT_ACL_DECISION_CACHE_SIZE 0
+
+extern int acl_decision_cache_size; /* initialized from plugin config entry */
+
 typedef struct result_cache
 {
     int aci_index;
@@ -454,6 +464,10 @@ struct acl_pblock
                           ACLPB_ACCESS_ALLOWED_ON_ENTRY | ACLPB_ATTR_STAR_MATCHED |           \
                           ACLPB_FOUND_ATTR_RULE | ACLPB_EVALUATING_FIRST_ATTR |               \
                           ACLPB_FOUND_A_ENTRY_TEST_RULE)
+/* state read and left by an evaluation, replayed by the decision cache */
+#define ACLPB_DECISION_STATE_MASK (ACLPB_ATTR_STAR_MATCHED | ACLPB_FOUND_ATTR_RULE |             \
+                                   ACLPB_EXECUTING_DENY_HANDLES | ACLPB_EXECUTING_ALLOW_HANDLES | \
+                                   ACLPB_EVALUATING_FIRST_ATTR | ACLPB_FOUND_A_ENTRY_TEST_RULE)
 #define ACLPB_STATE_ALL 0xffffff
 
     int aclpb_res_type;
@@ -563,6 +577,7 @@ struct acl_pblock
     AciContainer *aclpb_aclContainer;
     struct acl_pblock *aclpb_proxy; /* Child proxy block */
     acl_ht_t *aclpb_macro_ht;       /* ht for partial macro strs */
+    PLHashTable *aclpb_decisions;   /* read/search decisions of the operation */
 
     struct acl_pblock *aclpb_prev; /* Previpous in the chain */
     struct acl_pblock *aclpb_next; /* Next in the chain */
@@ -665,7 +680,9 @@ typedef enum {
     ACL_REASON_NO_MATCHED_SUBJECT_ALLOWS,
     ACL_REASON_EVALCONTEXT_CACHED_ALLOW,
     ACL_REASON_EVALCONTEXT_CACHED_NOT_ALLOWED,
-    ACL_REASON_EVALCONTEXT_CACHED_ATTR_STAR_ALLOW
+    ACL_REASON_EVALCONTEXT_CACHED_ATTR_STAR_ALLOW,
+    ACL_REASON_DECISION_CACHED_ALLOW,
+    ACL_REASON_DECISION_CACHED_DENY
 } aclReasonCode_t;
 
 typedef struct
@@ -823,6 +840,33 @@ void aclanom_get_suffix_info(Slapi_Entry *e, struct acl_pblock *aclpb);
 void aclanom_invalidateProfile(void);
 void aclanom__del_profile(int closing);
 
+int acl_decision_cache_init(void);
+void acl_decision_cache_free(void);
+void acl_decision_cache_invalidate(void);
+char *acl_decision_cache_key(Slapi_PBlock *pb, struct acl_pblock *aclpb, Slapi_Entry *e, const char *clientDn, const char *attr, struct berval *val, int access, uint64_t *epoch);
+int acl_decision_cache_lookup(const char *key, int *result, int *state);
+int acl_decision_cache_acis_eligible(struct acl_pblock *aclpb, Slapi_Entry *e);
+void acl_decision_cache_insert(const char *key, uint64_t epoch, int result, int state);
+char *acl_decision_batch_key(Slapi_PBlock *pb, struct acl_pblock *aclpb, Slapi_Entry *e, const char *clientDn, const char *attr, int access);
+int acl_decision_batch_lookup(struct acl_pblock *aclpb, const char *key, int *result, int *state);
+void acl_decision_batch_insert(struct acl_pblock *aclpb, Slapi_Entry *e, const char *key, int result, int state);
+void acl_decision_batch_done(struct acl_pblock *aclpb);
+
+typedef struct acl_group_closure aclGroupClosure;
+#define ACL_GROUP_CLOSURE_DYNAMIC   0x1 /* has memberURL groups */
+#define ACL_GROUP_CLOSURE_CERT      0x2 /* has memberCert groups */
+#define ACL_GROUP_CLOSURE_TRUNCATED 0x4 /* too many members to hold */
+int acl_group_closure_init(void);
+void acl_group_closure_free(void);
+uint64_t acl_group_closure_generation(void);
+aclGroupClosure *acl_group_closure_new(const char *group_dn, int max_nestlevel);
+void acl_group_closure_destroy(aclGroupClosure *closure);
+int acl_group_closure_add_member(aclGroupClosure *closure, const char *member_dn, int level);
+void acl_group_closure_set_flags(aclGroupClosure *closure, int flags);
+void acl_group_closure_insert(aclGroupClosure *closure, uint64_t generation);
+int acl_group_closure_ismember(const char *group_dn, const char *client_dn, int max_nestlevel, PRBool *cached);
+void acl_group_closure_invalidate(const char *dn);
+
 typedef enum {
     DONT_TAKE_ACLCACHE_READLOCK,
     DO_TAKE_ACLCACHE_READLOCK,
@@ -25,6 +25,7 @@ static void acl__free_aclpb(Acl_PBlock **aclpb_ptr);
 
 int aclpb_max_selected_acls = DEFAULT_ACLPB_MAX_SELECTED_ACLS;
 int aclpb_max_cache_results = DEFAULT_ACLPB_MAX_SELECTED_ACLS;
+int acl_decision_cache_size = DEFAULT_ACL_DECISION_CACHE_SIZE;
 
 struct acl_pbqueue
 {
@@ -380,6 +381,13 @@ acl__handle_plugin_config_entry(Slapi_Entry *e, void *callback_data __attribute_
         aclpb_max_cache_results = DEFAULT_ACLPB_MAX_SELECTED_ACLS;
     }
 
+    value = slapi_entry_attr_get_int(e, ATTR_ACL_DECISION_CACHE_SIZE);
+    if (value > 0) {
+        acl_decision_cache_size = value;
+    } else {
+        acl_decision_cache_size = DEFAULT_ACL_DECISION_CACHE_SIZE;
+    }
+
     return 0;
 }
 
@@ -727,6 +735,7 @@ acl__free_aclpb(Acl_PBlock **aclpb_ptr)
         PR_HashTableDestroy(aclpb->aclpb_macro_ht);
         aclpb->aclpb_macro_ht = NULL;
     }
+    acl_decision_batch_done(aclpb);
     slapi_ch_free((void **)&(aclpb->aclpb_allow_handles));
     slapi_ch_free((void **)&(aclpb->aclpb_deny_handles));
     acllist_free_aciContainer(&aclpb->aclpb_aclContainer);
@@ -1071,6 +1080,9 @@ acl__done_aclpb(struct acl_pblock *aclpb)
      * the entries.*/
     acl_ht_free_all_entries_and_values(aclpb->aclpb_macro_ht);
 
+    /* Forget the decisions of the operation */
+    acl_decision_batch_done(aclpb);
+
     /* Finally, set it to the no use state */
     aclpb->aclpb_state = 0;
 }
@@ -0,0 +1,375 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "acl.h"
+
+/***************************************************************************
+ *
+ * This module deals with the global group closure cache.
+ *
+ * The user group cache (aclgroup.c) remembers, per client, the groups the
+ * client is or is not a member of. It is flushed as a whole on any group
+ * change, after which every client expands the groups again with one
+ * internal search per nested member.
+ *
+ * The closure of a group is the flattened set of the static members
+ * (member, uniquemember) of the group and of its nested groups, each with
+ * the nesting level it was found at. It does not depend on the client, so
+ * it is shared by all the connections:
+ *    - group ndn  -> closure
+ *    - member ndn -> the closures the member is part of
+ * The second table is what makes the invalidation fine grained: when a
+ * group changes, only the closures going through that group are dropped.
+ *
+ * A closure only answers "not a member" when it is complete, i.e. it was
+ * expanded within the nesting limit and has no dynamic (memberURL) or
+ * certificate (memberCert) group in it. Otherwise the caller falls back
+ * to the regular evaluation.
+ **************************************************************************/
+
+#define ACL_GROUP_CLOSURE_MAX_MEMBERS 100000   /* per closure */
+#define ACL_GROUP_CLOSURE_MAX_TOTAL   1000000  /* in the whole cache */
+
+struct acl_group_closure
+{
+    char *agc_group;          /* normalized group dn */
+    PLHashTable *agc_members; /* normalized member dn -> nesting level + 1 */
+    int agc_nmembers;
+    int agc_height;        /* deepest nesting level a member was found at */
+    int agc_max_nestlevel; /* the nesting limit it was expanded with */
+    int agc_flags;
+};
+
+typedef struct acl_group_closure_ref
+{
+    aclGroupClosure *agr_closure;
+    struct acl_group_closure_ref *agr_next;
+} aclGroupClosureRef;
+
+static Slapi_RWLock *acl_group_closure_lock = NULL;
+static PLHashTable *acl_group_closures = NULL; /* group ndn -> closure */
+static PLHashTable *acl_group_owners = NULL;   /* member ndn -> closure refs */
+static int acl_group_closure_total = 0;
+static uint64_t acl_group_closure_gen = 1;
+
+static char *
+acl__group_closure_ndn(const char *dn)
+{
+    Slapi_DN *sdn = slapi_sdn_new_dn_byref(dn);
+    char *ndn = slapi_ch_strdup(slapi_sdn_get_ndn(sdn));
+
+    slapi_sdn_free(&sdn);
+    return ndn;
+}
+
+static PRIntn
+acl__group_closure_free_member(PLHashEntry *he, PRIntn i __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    slapi_ch_free((void **)&he->key);
+    return HT_ENUMERATE_REMOVE;
+}
+
+int
+acl_group_closure_init()
+{
+    acl_group_closure_lock = slapi_new_rwlock();
+    acl_group_closures = PL_NewHashTable(64, PL_HashString, PL_CompareStrings,
+                                         PL_CompareValues, NULL, NULL);
+    acl_group_owners = PL_NewHashTable(256, PL_HashString, PL_CompareStrings,
+                                       PL_CompareValues, NULL, NULL);
+    if (NULL == acl_group_closure_lock || NULL == acl_group_closures || NULL == acl_group_owners) {
+        slapi_log_err(SLAPI_LOG_ERR, plugin_name,
+                      "acl_group_closure_init - Unable to allocate the group closure cache\n");
+        acl_group_closure_free();
+        return 1;
+    }
+    return 0;
+}
+
+void
+acl_group_closure_free()
+{
+    if (acl_group_closures && acl_group_owners) {
+        acl_group_closure_invalidate(NULL);
+    }
+    if (acl_group_closures) {
+        PL_HashTableDestroy(acl_group_closures);
+        acl_group_closures = NULL;
+    }
+    if (acl_group_owners) {
+        PL_HashTableDestroy(acl_group_owners);
+        acl_group_owners = NULL;
+    }
+    if (acl_group_closure_lock) {
+        slapi_destroy_rwlock(acl_group_closure_lock);
+        acl_group_closure_lock = NULL;
+    }
+}
+
+/*
+ * The generation moves on every invalidation. A closure expanded while it
+ * moved may have missed the change and is not inserted.
+ */
+uint64_t
+acl_group_closure_generation()
+{
+    return slapi_atomic_load_64(&acl_group_closure_gen, __ATOMIC_ACQUIRE);
+}
+
+aclGroupClosure *
+acl_group_closure_new(const char *group_dn, int max_nestlevel)
+{
+    aclGroupClosure *closure = (aclGroupClosure *)slapi_ch_calloc(1, sizeof(aclGroupClosure));
+
+    closure->agc_group = acl__group_closure_ndn(group_dn);
+    closure->agc_members = PL_NewHashTable(16, PL_HashString, PL_CompareStrings,
+                                           PL_CompareValues, NULL, NULL);
+    closure->agc_height = -1;
+    closure->agc_max_nestlevel = max_nestlevel;
+    return closure;
+}
+
+void
+acl_group_closure_destroy(aclGroupClosure *closure)
+{
+    if (NULL == closure) {
+        return;
+    }
+    if (closure->agc_members) {
+        PL_HashTableEnumerateEntries(closure->agc_members, acl__group_closure_free_member, NULL);
+        PL_HashTableDestroy(closure->agc_members);
+    }
+    slapi_ch_free_string(&closure->agc_group);
+    slapi_ch_free((void **)&closure);
+}
+
+/*
+ * Add a member found at that nesting level (0 for the members of the group
+ * itself). Returns 1 if it is a new member, which then has to be expanded,
+ * 0 if it was already known, and -1 if the closure is full.
+ */
+int
+acl_group_closure_add_member(aclGroupClosure *closure, const char *member_dn, int level)
+{
+    char *ndn;
+
+    if (closure->agc_nmembers >= ACL_GROUP_CLOSURE_MAX_MEMBERS) {
+        closure->agc_flags |= ACL_GROUP_CLOSURE_TRUNCATED;
+        return -1;
+    }
+    ndn = acl__group_closure_ndn(member_dn);
+    if (PL_HashTableLookupConst(closure->agc_members, ndn) ||
+        strcmp(ndn, closure->agc_group) == 0) {
+        slapi_ch_free_string(&ndn);
+        return 0;
+    }
+    PL_HashTableAdd(closure->agc_members, ndn, (void *)(intptr_t)(level + 1));
+    closure->agc_nmembers++;
+    if (level > closure->agc_height) {
+        closure->agc_height = level;
+    }
+    return 1;
+}
+
+void
+acl_group_closure_set_flags(aclGroupClosure *closure, int flags)
+{
+    closure->agc_flags |= flags;
+}
+
+/* Must hold the write lock */
+static void
+acl__group_closure_add_owner(const char *ndn, aclGroupClosure *closure)
+{
+    PLHashEntry **hep;
+    aclGroupClosureRef *ref;
+
+    ref = (aclGroupClosureRef *)slapi_ch_malloc(sizeof(aclGroupClosureRef));
+    ref->agr_closure = closure;
+    hep = PL_HashTableRawLookup(acl_group_owners, PL_HashString(ndn), ndn);
+    if (*hep) {
+        ref->agr_next = (aclGroupClosureRef *)(*hep)->value;
+        (*hep)->value = ref;
+    } else {
+        ref->agr_next = NULL;
+        PL_HashTableRawAdd(acl_group_owners, hep, PL_HashString(ndn),
+                           slapi_ch_strdup(ndn), ref);
+    }
+}
+
+/* Must hold the write lock */
+static void
+acl__group_closure_remove_owner(const char *ndn, aclGroupClosure *closure)
+{
+    PLHashEntry **hep;
+    PLHashEntry *he;
+    aclGroupClosureRef **refp;
+    aclGroupClosureRef *ref;
+    void *key;
+
+    hep = PL_HashTableRawLookup(acl_group_owners, PL_HashString(ndn), ndn);
+    if (NULL == (he = *hep)) {
+        return;
+    }
+    for (refp = (aclGroupClosureRef **)&he->value; (ref = *refp) != NULL; refp = &ref->agr_next) {
+        if (ref->agr_closure == closure) {
+            *refp = ref->agr_next;
+            slapi_ch_free((void **)&ref);
+            break;
+        }
+    }
+    if (NULL == he->value) {
+        key = (void *)he->key;
+        PL_HashTableRawRemove(acl_group_owners, hep, he);
+        slapi_ch_free(&key);
+    }
+}
+
+static PRIntn
+acl__group_closure_add_owners(PLHashEntry *he, PRIntn i __attribute__((unused)), void *arg)
+{
+    acl__group_closure_add_owner((const char *)he->key, (aclGroupClosure *)arg);
+    return HT_ENUMERATE_NEXT;
+}
+
+static PRIntn
+acl__group_closure_remove_owners(PLHashEntry *he, PRIntn i __attribute__((unused)), void *arg)
+{
+    acl__group_closure_remove_owner((const char *)he->key, (aclGroupClosure *)arg);
+    return HT_ENUMERATE_NEXT;
+}
+
+/* Must hold the write lock */
+static void
+acl__group_closure_remove(aclGroupClosure *closure)
+{
+    PL_HashTableRemove(acl_group_closures, closure->agc_group);
+    acl__group_closure_remove_owner(closure->agc_group, closure);
+    PL_HashTableEnumerateEntries(closure->agc_members, acl__group_closure_remove_owners, closure);
+    acl_group_closure_total -= closure->agc_nmembers;
+    acl_group_closure_destroy(closure);
+}
+
+static PRIntn
+acl__group_closure_remove_entry(PLHashEntry *he, PRIntn i __attribute__((unused)), void *arg)
+{
+    aclGroupClosure ***closures = (aclGroupClosure ***)arg;
+
+    **closures = (aclGroupClosure *)he->value;
+    (*closures)++;
+    return HT_ENUMERATE_NEXT;
+}
+
+/*
+ * Hand the closure over to the cache. It is dropped if the generation
+ * moved since the expansion started, or if another thread was faster.
+ */
+void
+acl_group_closure_insert(aclGroupClosure *closure, uint64_t generation)
+{
+    slapi_rwlock_wrlock(acl_group_closure_lock);
+    if (generation != acl_group_closure_gen ||
+        PL_HashTableLookupConst(acl_group_closures, closure->agc_group)) {
+        slapi_rwlock_unlock(acl_group_closure_lock);
+        acl_group_closure_destroy(closure);
+        return;
+    }
+    if (acl_group_closure_total + closure->agc_nmembers > ACL_GROUP_CLOSURE_MAX_TOTAL) {
+        slapi_rwlock_unlock(acl_group_closure_lock);
+        slapi_log_err(SLAPI_LOG_ACL, plugin_name,
+                      "acl_group_closure_insert - Cache is full, flushing it\n");
+        acl_group_closure_invalidate(NULL);
+        acl_group_closure_destroy(closure);
+        return;
+    }
+    PL_HashTableAdd(acl_group_closures, closure->agc_group, closure);
+    acl__group_closure_add_owner(closure->agc_group, closure);
+    PL_HashTableEnumerateEntries(closure->agc_members, acl__group_closure_add_owners, closure);
+    acl_group_closure_total += closure->agc_nmembers;
+    slapi_rwlock_unlock(acl_group_closure_lock);
+}
+
+/*
+ * Is the client a member of the group, nested groups included?
+ *
+ * Returns ACL_TRUE or ACL_FALSE when the cached closure answers it, and
+ * ACL_DONT_KNOW otherwise. *cached tells whether the closure was there at
+ * all, i.e. whether it is worth expanding it.
+ */
+int
+acl_group_closure_ismember(const char *group_dn, const char *client_dn, int max_nestlevel, PRBool *cached)
+{
+    aclGroupClosure *closure;
+    char *group_ndn = acl__group_closure_ndn(group_dn);
+    char *client_ndn = acl__group_closure_ndn(client_dn);
+    int result = ACL_DONT_KNOW;
+
+    *cached = PR_FALSE;
+    slapi_rwlock_rdlock(acl_group_closure_lock);
+    closure = (aclGroupClosure *)PL_HashTableLookupConst(acl_group_closures, group_ndn);
+    if (closure && closure->agc_max_nestlevel == max_nestlevel) {
+        *cached = PR_TRUE;
+        if (PL_HashTableLookupConst(closure->agc_members, client_ndn)) {
+            result = ACL_TRUE;
+        } else if (0 == closure->agc_flags &&
+                   closure->agc_height + 1 < closure->agc_max_nestlevel) {
+            result = ACL_FALSE;
+        }
+    }
+    slapi_rwlock_unlock(acl_group_closure_lock);
+    slapi_ch_free_string(&group_ndn);
+    slapi_ch_free_string(&client_ndn);
+    return result;
+}
+
+/*
+ * Called when the entry with that dn changed in a way that can change
+ * the groups: drop the closures it is part of, whether as their group
+ * or as one of their members. A NULL dn drops everything.
+ */
+void
+acl_group_closure_invalidate(const char *dn)
+{
+    aclGroupClosure **closures = NULL;
+    aclGroupClosure **end;
+    aclGroupClosureRef *ref;
+    char *ndn = NULL;
+    int count = 0;
+
+    slapi_rwlock_wrlock(acl_group_closure_lock);
+    slapi_atomic_incr_64(&acl_group_closure_gen, __ATOMIC_RELEASE);
+    if (NULL == dn) {
+        count = acl_group_closures->nentries;
+        if (count) {
+            end = closures = (aclGroupClosure **)slapi_ch_malloc(count * sizeof(aclGroupClosure *));
+            PL_HashTableEnumerateEntries(acl_group_closures, acl__group_closure_remove_entry, &end);
+        }
+    } else {
+        ndn = acl__group_closure_ndn(dn);
+        ref = (aclGroupClosureRef *)PL_HashTableLookupConst(acl_group_owners, ndn);
+        for (; ref; ref = ref->agr_next) {
+            closures = (aclGroupClosure **)slapi_ch_realloc((char *)closures,
+                                                            (count + 1) * sizeof(aclGroupClosure *));
+            closures[count++] = ref->agr_closure;
+        }
+    }
+    /* Removing a closure edits the lists we walked, so it comes after */
+    for (int i = 0; i < count; i++) {
+        slapi_log_err(SLAPI_LOG_ACL, plugin_name,
+                      "acl_group_closure_invalidate - Dropping the closure of %s (%s changed)\n",
+                      closures[i]->agc_group, ndn ? ndn : "all");
+        acl__group_closure_remove(closures[i]);
+    }
+    slapi_rwlock_unlock(acl_group_closure_lock);
+    slapi_ch_free((void **)&closures);
+    slapi_ch_free_string(&ndn);
+}
@@ -0,0 +1,448 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "acl.h"
+
+/***************************************************************************
+ *
+ * This module deals with the global read/search decision cache.
+ *
+ * The evaluation contexts of the aclpb only live for one operation. Most
+ * search loads however are the same clients reading the same kind of
+ * entries over and over. A decision is remembered across operations when
+ * it only depends on:
+ *    - the client (its dn, and through groupdn its static groups)
+ *    - the parent of the entry and the objectclasses of the entry
+ *    - the right and the attribute evaluated
+ *    - the aclpb state used and left by the evaluation
+ * That is when none of the acis in scope depends on anything else (macros,
+ * userattr, ip/dns, time of day, ssf, roles, filters on other attributes,
+ * ...) and the entry itself has no aci.
+ *
+ * The whole cache is invalidated by bumping an epoch when the acis or the
+ * groups change (acl_regen_aclsignature(), aclg_regen_group_signature()).
+ * A decision computed while the epoch moved is never inserted.
+ *
+ * Within one search, the backend flags the operation (OP_FLAG_ACL_BATCH)
+ * while it goes through its candidates, and the decisions are also grouped
+ * in the aclpb of the operation, whatever the cache size. The client, its
+ * groups and roles, and its connection do not change during the operation,
+ * so only the rules depending on the entry content (userattr, userdnattr,
+ * groupdnattr, parameterized bind rules, targetfilters on other attributes)
+ * make an entry fall back to its own evaluation.
+ **************************************************************************/
+
+#define ACL_DECISION_CACHE_SHARDS 16
+#define ACL_DECISION_BATCH_MAX    1024 /* decisions kept per operation */
+
+/* bind rules a decision may depend on, across operations or within one */
+#define ACL_DECISION_CACHE_RULES (ACI_USERDN_RULE | ACI_GROUPDN_RULE | ACI_USERDN_SELFRULE)
+#define ACL_DECISION_BATCH_RULES (~ACI_CACHE_RESULT_PER_ENTRY | ACI_USERDN_SELFRULE)
+
+typedef struct acl_decision
+{
+    uint64_t dec_epoch;
+    int dec_result;
+    int dec_state;
+} aclDecision;
+
+typedef struct acl_decision_shard
+{
+    PRLock *ads_lock;
+    PLHashTable *ads_ht;
+    int ads_count;
+} aclDecisionShard;
+
+static aclDecisionShard *aclDecisionCache = NULL;
+static int acl_decision_shard_max = 0;
+static uint64_t acl_decision_epoch = 1;
+
+static PRIntn
+acl__decision_free_entry(PLHashEntry *he, PRIntn i __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    slapi_ch_free((void **)&he->key);
+    slapi_ch_free((void **)&he->value);
+    return HT_ENUMERATE_REMOVE;
+}
+
+static aclDecisionShard *
+acl__decision_get_shard(const char *key)
+{
+    return &aclDecisionCache[PL_HashString(key) % ACL_DECISION_CACHE_SHARDS];
+}
+
+int
+acl_decision_cache_init()
+{
+    int i;
+
+    if (acl_decision_cache_size <= 0) {
+        return 0;
+    }
+
+    aclDecisionCache = (aclDecisionShard *)slapi_ch_calloc(ACL_DECISION_CACHE_SHARDS,
+                                                          sizeof(aclDecisionShard));
+    for (i = 0; i < ACL_DECISION_CACHE_SHARDS; i++) {
+        aclDecisionCache[i].ads_lock = PR_NewLock();
+        aclDecisionCache[i].ads_ht = PL_NewHashTable(64, PL_HashString, PL_CompareStrings,
+                                                     PL_CompareValues, NULL, NULL);
+        if (NULL == aclDecisionCache[i].ads_lock || NULL == aclDecisionCache[i].ads_ht) {
+            slapi_log_err(SLAPI_LOG_ERR, plugin_name,
+                          "acl_decision_cache_init - Unable to allocate the decision cache\n");
+            acl_decision_cache_free();
+            return 1;
+        }
+    }
+    acl_decision_shard_max = acl_decision_cache_size / ACL_DECISION_CACHE_SHARDS;
+    if (acl_decision_shard_max < 1) {
+        acl_decision_shard_max = 1;
+    }
+    slapi_log_err(SLAPI_LOG_PLUGIN, plugin_name,
+                  "acl_decision_cache_init - Caching up to %d decisions\n",
+                  acl_decision_cache_size);
+    return 0;
+}
+
+void
+acl_decision_cache_free()
+{
+    int i;
+
+    if (NULL == aclDecisionCache) {
+        return;
+    }
+    for (i = 0; i < ACL_DECISION_CACHE_SHARDS; i++) {
+        if (aclDecisionCache[i].ads_ht) {
+            PL_HashTableEnumerateEntries(aclDecisionCache[i].ads_ht, acl__decision_free_entry, NULL);
+            PL_HashTableDestroy(aclDecisionCache[i].ads_ht);
+        }
+        if (aclDecisionCache[i].ads_lock) {
+            PR_DestroyLock(aclDecisionCache[i].ads_lock);
+        }
+    }
+    slapi_ch_free((void **)&aclDecisionCache);
+}
+
+/*
+ * Called when the acis or the groups change. The stale decisions are
+ * dropped lazily, on lookup or when their shard is full.
+ */
+void
+acl_decision_cache_invalidate()
+{
+    slapi_atomic_incr_64(&acl_decision_epoch, __ATOMIC_RELEASE);
+}
+
+static int
+acl__decision_strcmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static char *
+acl__decision_key(struct acl_pblock *aclpb, Slapi_Entry *e, const char *clientDn, const char *attr, int access)
+{
+    const char *n_edn;
+    const char *parent;
+    Slapi_Attr *a = NULL;
+    Slapi_Value *sval = NULL;
+    char **ocs = NULL;
+    char *ocstr = NULL;
+    char *key = NULL;
+    int nocs = 0;
+    int i;
+
+    /* the acis of the entry itself are not part of the key */
+    n_edn = slapi_entry_get_ndn(e);
+    if (NULL == n_edn || NULL == (parent = slapi_dn_find_parent(n_edn)) ||
+        slapi_entry_attr_find(e, aci_attr_type, &a) == 0) {
+        return NULL;
+    }
+
+    if (slapi_entry_attr_find(e, SLAPI_ATTR_OBJECTCLASS, &a) == 0 &&
+        slapi_attr_get_numvalues(a, &nocs) == 0) {
+        ocs = (char **)slapi_ch_calloc(nocs + 1, sizeof(char *));
+        nocs = 0;
+        for (i = slapi_attr_first_value(a, &sval); i != -1; i = slapi_attr_next_value(a, i, &sval)) {
+            ocs[nocs] = slapi_ch_strdup(slapi_value_get_string(sval));
+            slapi_dn_ignore_case(ocs[nocs++]);
+        }
+        qsort(ocs, nocs, sizeof(char *), acl__decision_strcmp);
+        for (i = 0; i < nocs; i++) {
+            aclutil_str_append(&ocstr, ocs[i]);
+            aclutil_str_append(&ocstr, ",");
+        }
+        slapi_ch_array_free(ocs);
+    }
+
+    /* the dns may contain the separator, length prefix the parent */
+    key = slapi_ch_smprintf("%d|%x|%d|%s|%lu:%s|%s|%s", access,
+                            aclpb->aclpb_state & ACLPB_DECISION_STATE_MASK,
+                            clientDn && strcasecmp(clientDn, n_edn) == 0,
+                            attr ? attr : "", (unsigned long)strlen(parent), parent,
+                            clientDn ? clientDn : "", ocstr ? ocstr : "");
+    slapi_dn_ignore_case(key);
+    slapi_ch_free_string(&ocstr);
+
+    return key;
+}
+
+/*
+ * Build the key of the decision for that resource, or return NULL if
+ * the request can not be answered by the cache. The epoch is the one
+ * the decision has to be inserted with.
+ */
+char *
+acl_decision_cache_key(Slapi_PBlock *pb, struct acl_pblock *aclpb, Slapi_Entry *e, const char *clientDn, const char *attr, struct berval *val, int access, uint64_t *epoch)
+{
+    if (NULL == aclDecisionCache || NULL == aclpb) {
+        return NULL;
+    }
+
+    /* only a plain read/search by an authenticated client */
+    if ((access != SLAPI_ACL_READ && access != SLAPI_ACL_SEARCH) || val ||
+        NULL == clientDn || '\0' == *clientDn ||
+        (aclpb->aclpb_res_type & ACLPB_EFFECTIVE_RIGHTS) ||
+        acl_get_aclpb(pb, ACLPB_PROXYDN_PBLOCK)) {
+        return NULL;
+    }
+
+    *epoch = slapi_atomic_load_64(&acl_decision_epoch, __ATOMIC_ACQUIRE);
+    return acl__decision_key(aclpb, e, clientDn, attr, access);
+}
+
+/*
+ * Returns 1 and the decision with the aclpb state to set if the key
+ * is cached, 0 otherwise.
+ */
+int
+acl_decision_cache_lookup(const char *key, int *result, int *state)
+{
+    aclDecisionShard *shard = acl__decision_get_shard(key);
+    uint64_t epoch = slapi_atomic_load_64(&acl_decision_epoch, __ATOMIC_ACQUIRE);
+    PLHashEntry **hep;
+    aclDecision *dec;
+    int found = 0;
+
+    PR_Lock(shard->ads_lock);
+    hep = PL_HashTableRawLookup(shard->ads_ht, PL_HashString(key), key);
+    if (*hep) {
+        dec = (aclDecision *)(*hep)->value;
+        if (dec->dec_epoch == epoch) {
+            *result = dec->dec_result;
+            *state = dec->dec_state;
+            found = 1;
+        } else {
+            char *old_key = (char *)(*hep)->key;
+            PL_HashTableRawRemove(shard->ads_ht, hep, *hep);
+            slapi_ch_free_string(&old_key);
+            slapi_ch_free((void **)&dec);
+            shard->ads_count--;
+        }
+    }
+    PR_Unlock(shard->ads_lock);
+
+    return found;
+}
+
+static int
+acl__decision_filter_oc_only(Slapi_Filter *f, void *arg)
+{
+    char *type = NULL;
+
+    if (slapi_filter_get_attribute_type(f, &type) != 0 || NULL == type ||
+        strcasecmp(type, SLAPI_ATTR_OBJECTCLASS) != 0) {
+        *(int *)arg = 0;
+        return SLAPI_FILTER_SCAN_STOP;
+    }
+    return SLAPI_FILTER_SCAN_CONTINUE;
+}
+
+static int
+acl__decision_same_parent(const char *dn, const char *parent)
+{
+    const char *p = slapi_dn_find_parent(dn);
+
+    return (p && strcasecmp(p, parent) == 0);
+}
+
+/*
+ * Check that the read/search decisions of the acis in scope of the
+ * current resource are the same for all the entries of the key, given
+ * the bind rules allowed.
+ *
+ * ASSUMPTIONS: A reader lock has been obtained for the acl list.
+ */
+static int
+acl__decision_acis_eligible(struct acl_pblock *aclpb, Slapi_Entry *e, int rules)
+{
+    const char *parent = slapi_dn_find_parent(slapi_entry_get_ndn(e));
+    aci_t *aci;
+    PRUint32 cookie;
+
+    if (NULL == parent) {
+        return 0;
+    }
+
+    for (aci = acllist_get_first_aci(aclpb, &cookie); aci;
+         aci = acllist_get_next_aci(aclpb, aci, &cookie)) {
+        if (!(aci->aci_access & (SLAPI_ACL_READ | SLAPI_ACL_SEARCH))) {
+            continue;
+        }
+        if (aci->aci_macro ||
+            (aci->aci_type & (ACI_TARGET_MACRO_DN | ACI_TARGET_FILTER_MACRO_DN |
+                              ACI_TARGET_PATTERN | ACI_TARGET_MODDN |
+                              ACI_TARGET_ATTR_ADD_FILTERS | ACI_TARGET_ATTR_DEL_FILTERS)) ||
+            (aci->aci_ruleType & ~rules)) {
+            return 0;
+        }
+        /* An aci on, or targeting, a sibling applies to that entry only */
+        if (acl__decision_same_parent(slapi_sdn_get_ndn(aci->aci_sdn), parent)) {
+            return 0;
+        }
+        if ((aci->aci_type & ACI_TARGET_DN) && aci->target) {
+            char *avaType;
+            struct berval *avaValue;
+
+            slapi_filter_get_ava(aci->target, &avaType, &avaValue);
+            if (acl__decision_same_parent(avaValue->bv_val, parent)) {
+                return 0;
+            }
+        }
+        if ((aci->aci_type & ACI_TARGET_FILTER) && aci->targetFilter) {
+            int oc_only = 1;
+            int error = 0;
+
+            slapi_filter_apply(aci->targetFilter, acl__decision_filter_oc_only, &oc_only, &error);
+            if (!oc_only) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int
+acl_decision_cache_acis_eligible(struct acl_pblock *aclpb, Slapi_Entry *e)
+{
+    return acl__decision_acis_eligible(aclpb, e, ACL_DECISION_CACHE_RULES);
+}
+
+void
+acl_decision_cache_insert(const char *key, uint64_t epoch, int result, int state)
+{
+    aclDecisionShard *shard = acl__decision_get_shard(key);
+    PLHashEntry **hep;
+    aclDecision *dec;
+
+    if (result != LDAP_SUCCESS && result != LDAP_INSUFFICIENT_ACCESS) {
+        return;
+    }
+
+    PR_Lock(shard->ads_lock);
+    if (epoch != slapi_atomic_load_64(&acl_decision_epoch, __ATOMIC_ACQUIRE)) {
+        /* the acis or the groups changed during the evaluation */
+        PR_Unlock(shard->ads_lock);
+        return;
+    }
+    hep = PL_HashTableRawLookup(shard->ads_ht, PL_HashString(key), key);
+    if (*hep) {
+        dec = (aclDecision *)(*hep)->value;
+    } else {
+        if (shard->ads_count >= acl_decision_shard_max) {
+            PL_HashTableEnumerateEntries(shard->ads_ht, acl__decision_free_entry, NULL);
+            shard->ads_count = 0;
+            hep = PL_HashTableRawLookup(shard->ads_ht, PL_HashString(key), key);
+        }
+        dec = (aclDecision *)slapi_ch_malloc(sizeof(aclDecision));
+        PL_HashTableRawAdd(shard->ads_ht, hep, PL_HashString(key), slapi_ch_strdup(key), dec);
+        shard->ads_count++;
+    }
+    dec->dec_epoch = epoch;
+    dec->dec_result = result;
+    dec->dec_state = state & ACLPB_DECISION_STATE_MASK;
+    PR_Unlock(shard->ads_lock);
+}
+
+/*
+ * Build the key of the decision within the current operation, or return
+ * NULL if the backend is not going through a batch of search candidates.
+ */
+char *
+acl_decision_batch_key(Slapi_PBlock *pb, struct acl_pblock *aclpb, Slapi_Entry *e, const char *clientDn, const char *attr, int access)
+{
+    Slapi_Operation *op = NULL;
+
+    slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    if (NULL == op || NULL == aclpb ||
+        !operation_is_flag_set(op, OP_FLAG_ACL_BATCH) ||
+        operation_is_flag_set(op, OP_FLAG_PS) ||
+        (access != SLAPI_ACL_READ && access != SLAPI_ACL_SEARCH) ||
+        (aclpb->aclpb_res_type & ACLPB_EFFECTIVE_RIGHTS) ||
+        acl_get_aclpb(pb, ACLPB_PROXYDN_PBLOCK)) {
+        return NULL;
+    }
+    return acl__decision_key(aclpb, e, clientDn, attr, access);
+}
+
+int
+acl_decision_batch_lookup(struct acl_pblock *aclpb, const char *key, int *result, int *state)
+{
+    aclDecision *dec;
+
+    if (NULL == aclpb->aclpb_decisions ||
+        NULL == (dec = (aclDecision *)PL_HashTableLookupConst(aclpb->aclpb_decisions, key))) {
+        return 0;
+    }
+    *result = dec->dec_result;
+    *state = dec->dec_state;
+    return 1;
+}
+
+/*
+ * ASSUMPTIONS: A reader lock has been obtained for the acl list.
+ */
+void
+acl_decision_batch_insert(struct acl_pblock *aclpb, Slapi_Entry *e, const char *key, int result, int state)
+{
+    aclDecision *dec;
+
+    if ((result != LDAP_SUCCESS && result != LDAP_INSUFFICIENT_ACCESS) ||
+        !acl__decision_acis_eligible(aclpb, e, ACL_DECISION_BATCH_RULES)) {
+        return;
+    }
+    if (NULL == aclpb->aclpb_decisions) {
+        aclpb->aclpb_decisions = PL_NewHashTable(64, PL_HashString, PL_CompareStrings,
+                                                 PL_CompareValues, NULL, NULL);
+    } else if (aclpb->aclpb_decisions->nentries >= ACL_DECISION_BATCH_MAX) {
+        PL_HashTableEnumerateEntries(aclpb->aclpb_decisions, acl__decision_free_entry, NULL);
+    }
+    if (PL_HashTableLookupConst(aclpb->aclpb_decisions, key)) {
+        return;
+    }
+    dec = (aclDecision *)slapi_ch_malloc(sizeof(aclDecision));
+    dec->dec_epoch = 0;
+    dec->dec_result = result;
+    dec->dec_state = state & ACLPB_DECISION_STATE_MASK;
+    PL_HashTableAdd(aclpb->aclpb_decisions, slapi_ch_strdup(key), dec);
+}
+
+/* Called when the operation is done with the aclpb */
+void
+acl_decision_batch_done(struct acl_pblock *aclpb)
+{
+    if (aclpb->aclpb_decisions) {
+        PL_HashTableEnumerateEntries(aclpb->aclpb_decisions, acl__decision_free_entry, NULL);
+        PL_HashTableDestroy(aclpb->aclpb_decisions);
+        aclpb->aclpb_decisions = NULL;
+    }
+}
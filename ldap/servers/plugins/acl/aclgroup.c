@@ -415,6 +415,7 @@ void
 aclg_regen_group_signature()
 {
     aclUserGroups->aclg_signature = aclutil_gen_signature(aclUserGroups->aclg_signature);
+    acl_decision_cache_invalidate();
 }
 
 void
@@ -152,6 +152,18 @@ aclinit_main()
     /* Initialize the user-group cache */
     rv = aclgroup_init();
 
+    /* Initialize the read/search decision cache */
+    if (0 != acl_decision_cache_init()) {
+        slapi_log_err(SLAPI_LOG_ERR, plugin_name,
+                      "aclinit_main - Unable to create the acl decision cache\n");
+        return 1;
+    }
+
+    /* Initialize the group closure cache */
+    if (0 != acl_group_closure_init()) {
+        return 1;
+    }
+
     aclanom_gen_anomProfile(DO_TAKE_ACLCACHE_READLOCK);
 
     /* Register both of the proxied authorization controls (version 1 and 2) */
@@ -205,6 +205,8 @@ static char *const type_memberCert = "memberCertificateDescription";
 /* prototypes                                                               */
 /****************************************************************************/
 static int acllas__handle_group_entry(Slapi_Entry *, void *);
+static int acllas__handle_closure_entry(Slapi_Entry *, void *);
+static void acllas__expand_group_closure(char *groupDN, int max_nestlevel);
 static int acllas__user_ismember_of_group(struct acl_pblock *aclpb,
                                           char *groupDN,
                                           char *clientDN,
@@ -1888,6 +1890,18 @@ struct eval_info
     struct acl_pblock *aclpb;        /*aclpblock */
 };
 
+/* Used to expand the closure of a group, breadth first */
+struct closure_info
+{
+    aclGroupClosure *closure;
+    char **queue;  /* members still to be searched */
+    int *levels;   /* nesting level each of them was found at */
+    int q_len;
+    int q_size;
+    int level;     /* level of the group being searched */
+    int max_nestlevel;
+};
+
 #ifdef FOR_DEBUGGING
 static void
 dump_member_info(struct eval_info *info, struct member_info *minfo, char *buf)
@@ -2035,6 +2049,28 @@ acllas__user_ismember_of_group(struct acl_pblock *aclpb,
     */
     aclg_unlock_groupCache(1 /* reader */);
 
+    /*
+    ** Then ask the closure cache shared by all the connections. It is
+    ** expanded the first time, and is only good for static groups.
+    */
+    if (clientDN && *clientDN != '\0') {
+        PRBool cached = PR_FALSE;
+
+        max_nestlevel = aclpb->aclpb_max_nesting_level;
+        result = acl_group_closure_ismember(groupDN, clientDN, max_nestlevel, &cached);
+        if (!cached) {
+            acllas__expand_group_closure(groupDN, max_nestlevel);
+            result = acl_group_closure_ismember(groupDN, clientDN, max_nestlevel, &cached);
+        }
+        if (result != ACL_DONT_KNOW) {
+            slapi_log_err(SLAPI_LOG_ACL, plugin_name,
+                          "acllas__user_ismember_of_group - Evaluated %s from the group closure\n",
+                          result == ACL_TRUE ? "ACL_TRUE" : "ACL_FALSE");
+            return result;
+        }
+        result = ACL_FALSE;
+    }
+
     /* Indicate the initialization handler  -- this module will be
     ** called by the backend to evaluate the entry.
     */
@@ -2351,6 +2387,158 @@ free_and_return:
     return result;
 }
 
+/***************************************************************************
+*
+* acllas__expand_group_closure
+*
+*    Expand the static members of the group and of its nested groups,
+*    breadth first and within the nesting limit, and hand the result
+*    over to the group closure cache.
+*
+* Input:
+*    char *groupDN        - the group
+*    int max_nestlevel    - the nesting limit
+*
+* Returns:
+*    None.
+*
+* Error Handling:
+*    The closure is not cached if it can not be expanded.
+*
+**************************************************************************/
+static void
+acllas__expand_group_closure(char *groupDN, int max_nestlevel)
+{
+    struct closure_info info = {0};
+    char *attrs[5];
+    uint64_t generation;
+    int i;
+
+    generation = acl_group_closure_generation();
+    info.closure = acl_group_closure_new(groupDN, max_nestlevel);
+    info.max_nestlevel = max_nestlevel;
+    info.q_size = ACLLAS_MAX_GRP_MEMBER;
+    info.queue = (char **)slapi_ch_malloc(info.q_size * sizeof(char *));
+    info.levels = (int *)slapi_ch_malloc(info.q_size * sizeof(int));
+    info.queue[0] = slapi_ch_strdup(groupDN);
+    info.levels[0] = -1;
+    info.q_len = 1;
+
+    attrs[0] = type_member;
+    attrs[1] = type_uniquemember;
+    attrs[2] = type_memberURL;
+    attrs[3] = type_memberCert;
+    attrs[4] = NULL;
+
+    for (i = 0; i < info.q_len; i++) {
+        Slapi_PBlock *aPb = slapi_pblock_new();
+
+        /* The members of the group itself are at level 0 */
+        info.level = info.levels[i] + 1;
+        /* This search may NOT be chained, as in acllas__user_ismember_of_group */
+        slapi_search_internal_set_pb(aPb,
+                                     info.queue[i],
+                                     LDAP_SCOPE_BASE,
+                                     filter_groups,
+                                     &attrs[0],
+                                     0,
+                                     NULL /* controls */,
+                                     NULL /* uniqueid */,
+                                     aclplugin_get_identity(ACL_PLUGIN_IDENTITY),
+                                     SLAPI_OP_FLAG_NEVER_CHAIN /* actions */);
+        slapi_search_internal_callback_pb(aPb,
+                                          &info /* callback_data */,
+                                          NULL /* result_callback */,
+                                          acllas__handle_closure_entry,
+                                          NULL /* referral_callback */);
+        slapi_pblock_destroy(aPb);
+        slapi_ch_free_string(&info.queue[i]);
+    }
+    slapi_ch_free((void **)&info.queue);
+    slapi_ch_free((void **)&info.levels);
+
+    slapi_log_err(SLAPI_LOG_ACL, plugin_name,
+                  "acllas__expand_group_closure - Expanded %s (%d searches)\n", groupDN, i);
+    acl_group_closure_insert(info.closure, generation);
+}
+
+/***************************************************************************
+*
+* acllas__handle_closure_entry
+*
+*    handler called for each group met while expanding a closure. Adds
+*    its static members to the closure and queues the new ones so that
+*    they are searched in turn, if the nesting limit allows it.
+*
+* Input:
+*
+*
+* Returns:
+*
+* Error Handling:
+*
+**************************************************************************/
+static int
+acllas__handle_closure_entry(Slapi_Entry *e, void *callback_data)
+{
+    struct closure_info *info = (struct closure_info *)callback_data;
+    char *types[] = {type_member, type_uniquemember, NULL};
+    Slapi_Attr *attr = NULL;
+    Slapi_Value *sval = NULL;
+    char *n_dn;
+    int rc;
+    int i;
+
+    if (e == NULL) {
+        return 0;
+    }
+    if (slapi_entry_attr_find(e, type_memberURL, &attr) == 0) {
+        acl_group_closure_set_flags(info->closure, ACL_GROUP_CLOSURE_DYNAMIC);
+    }
+    if (slapi_entry_attr_find(e, type_memberCert, &attr) == 0) {
+        acl_group_closure_set_flags(info->closure, ACL_GROUP_CLOSURE_CERT);
+    }
+
+    for (int t = 0; types[t]; t++) {
+        if (slapi_entry_attr_find(e, types[t], &attr) != 0) {
+            continue;
+        }
+        for (i = slapi_attr_first_value(attr, &sval); i != -1;
+             i = slapi_attr_next_value(attr, i, &sval)) {
+            const struct berval *attrVal = slapi_value_get_berval(sval);
+
+            n_dn = slapi_create_dn_string("%s", attrVal->bv_val);
+            if (NULL == n_dn) {
+                slapi_log_err(SLAPI_LOG_ERR, plugin_name,
+                              "acllas__handle_closure_entry - Invalid syntax: %s\n",
+                              attrVal->bv_val);
+                continue;
+            }
+            rc = acl_group_closure_add_member(info->closure, n_dn, info->level);
+            if (rc < 0) {
+                slapi_ch_free_string(&n_dn);
+                return 0;
+            }
+            if (rc == 0 || info->level + 1 > info->max_nestlevel) {
+                /* already known, or too deep to be searched */
+                slapi_ch_free_string(&n_dn);
+                continue;
+            }
+            if (info->q_len == info->q_size) {
+                info->q_size += ACLLAS_MAX_GRP_MEMBER;
+                info->queue = (char **)slapi_ch_realloc((char *)info->queue,
+                                                        info->q_size * sizeof(char *));
+                info->levels = (int *)slapi_ch_realloc((char *)info->levels,
+                                                       info->q_size * sizeof(int));
+            }
+            info->queue[info->q_len] = n_dn;
+            info->levels[info->q_len] = info->level;
+            info->q_len++;
+        }
+    }
+    return 0;
+}
+
 /***************************************************************************
 *
 * acllas__handle_group_entry
@@ -60,10 +60,42 @@ static PRUint32 currContainerIndex = 0;
 static PRUint32 maxContainerIndex = 0;
 static int curAciIndex = 1;
 
+/*
+ * The containers are also indexed by DN in a trie of the reversed RDNs:
+ * the container of "ou=tenant1,dc=example,dc=com" hangs under
+ * dc=com -> dc=example -> ou=tenant1. The containers applying to an entry
+ * are then collected in one walk of its RDNs, instead of one AVL lookup
+ * (and one parent DN allocation) per ancestor. The AVL tree still owns
+ * the containers.
+ */
+typedef struct acl_rdn_key
+{
+    const char *ark_rdn; /* not NUL terminated */
+    size_t ark_len;
+} AclRdnKey;
+
+typedef struct acl_dn_node
+{
+    AclRdnKey adn_key; /* points to adn_rdn */
+    char *adn_rdn;
+    int adn_index; /* container index, -1 if none */
+    struct acl_dn_node *adn_parent;
+    PLHashTable *adn_children; /* AclRdnKey -> AclDnNode */
+} AclDnNode;
+
+#define ACL_DN_MAX_RDNS 128
+
+/* Root of the trie, it stands for the root DSE */
+static AclDnNode *acllistTrie = NULL;
+
 /* PROTOTYPES */
 static int __acllist_add_aci(aci_t *aci);
 static int __acllist_aciContainer_node_cmp(caddr_t d1, caddr_t d2);
 static int __acllist_aciContainer_node_dup(caddr_t d1, caddr_t d2);
+static void __acllist_trie_set(const char *ndn, int index);
+static void __acllist_trie_free(AclDnNode *node);
+static int __acllist_trie_collect(const char *ndn, size_t min_depth, int *indexes, int max);
+static int __acllist_dn_split(const char *ndn, AclRdnKey *rdns);
 
 void my_print(Avlnode *root);
 
@@ -293,6 +325,7 @@ __acllist_add_aci(aci_t *aci)
             currContainerIndex++;
 
         aciContainerArray[aciListHead->acic_index] = aciListHead;
+        __acllist_trie_set(slapi_sdn_get_ndn(aciListHead->acic_sdn), aciListHead->acic_index);
 
         slapi_log_err(SLAPI_LOG_ACL, plugin_name, "__acllist_add_aci - Added %s to container:%d\n",
                       slapi_sdn_get_ndn(aciListHead->acic_sdn), aciListHead->acic_index);
@@ -385,6 +418,7 @@ acllist_remove_aci_needsLock(const Slapi_DN *sdn, const struct berval *attr)
 
     /* remove the container from the slot */
     aciContainerArray[root->acic_index] = NULL;
+    __acllist_trie_set(slapi_sdn_get_ndn(root->acic_sdn), -1);
 
     slapi_log_err(SLAPI_LOG_ACL, plugin_name,
                   "acllist_remove_aci_needsLock - Removing container[%d]=%s\n", root->acic_index,
@@ -494,6 +528,8 @@ free_acl_avl_list(void)
 {
     avl_free(acllistRoot, free_aci_avl_container);
     acllistRoot = NULL;
+    __acllist_trie_free(acllistTrie);
+    acllistTrie = NULL;
 }
 
 aci_t *
@@ -613,7 +649,6 @@ void
 acllist_init_scan(Slapi_PBlock *pb, int scope __attribute__((unused)), const char *base)
 {
     Acl_PBlock *aclpb;
-    AciContainer *root;
     char *basedn = NULL;
     int index;
 
@@ -647,38 +682,24 @@ acllist_init_scan(Slapi_PBlock *pb, int scope __attribute__((unused)), const cha
     acllist_acicache_READ_LOCK();
 
     basedn = slapi_ch_strdup(base);
-    index = 0;
+    slapi_dn_ignore_case(basedn);
     slapi_ch_free_string(&aclpb->aclpb_search_base);
     aclpb->aclpb_search_base = slapi_ch_strdup(base);
 
-    while (basedn) {
-        char *tmp = NULL;
-
-        slapi_sdn_set_normdn_byref(aclpb->aclpb_aclContainer->acic_sdn, basedn);
-
-        root = (AciContainer *)avl_find(acllistRoot,
-                                        (caddr_t)aclpb->aclpb_aclContainer,
-                                        (IFP)__acllist_aciContainer_node_cmp);
-        if (index >= aclpb_max_selected_acls - 2) {
-            aclpb->aclpb_handles_index[0] = -1;
-            slapi_ch_free_string(&basedn);
-            break;
-        } else if (NULL != root) {
-            aclpb->aclpb_base_handles_index[index++] = root->acic_index;
-            aclpb->aclpb_base_handles_index[index] = -1;
-        } else if (NULL == root) {
-            /* slapi_dn_parent returns the "parent" dn syntactically.
-             * Most likely, basedn is above suffix (e.g., dn=com).
-             * Thus, no need to make it FATAL. */
-            slapi_log_err(SLAPI_LOG_ACL, plugin_name,
-                          "acllist_init_scan - Failed to find root for base: %s \n", basedn);
-        }
-        tmp = slapi_dn_parent(basedn);
-        slapi_ch_free_string(&basedn);
-        basedn = tmp;
+    index = __acllist_trie_collect(basedn, 0, aclpb->aclpb_base_handles_index,
+                                   aclpb_max_selected_acls - 2);
+    if (index < 0) {
+        /* Too many containers above the base, every entry will
+         * collect its own from the root.
+         */
+        slapi_ch_free_string(&aclpb->aclpb_search_base);
+        aclpb->aclpb_handles_index[0] = -1;
+        index = 0;
     }
-
-    acllist_done_aciContainer(aclpb->aclpb_aclContainer);
+    aclpb->aclpb_base_handles_index[index] = -1;
+    slapi_log_err(SLAPI_LOG_ACL, plugin_name,
+                  "acllist_init_scan - Found %d containers for base: %s\n", index, basedn);
+    slapi_ch_free_string(&basedn);
 
     if (aclpb->aclpb_base_handles_index[0] == -1)
         aclpb->aclpb_state &= ~ACLPB_SEARCH_BASED_ON_LIST;
@@ -699,8 +720,6 @@ acllist_aciscan_update_scan(Acl_PBlock *aclpb, char *edn)
 {
 
     int index = 0;
-    char *basedn = NULL;
-    AciContainer *root;
     int is_not_search_base = 1;
 
     if (!aclpb) {
@@ -731,8 +750,8 @@ acllist_aciscan_update_scan(Acl_PBlock *aclpb, char *edn)
      * Here, make a list of all the aci's that will apply
      * to edn ie. all aci's at and above edn in the DIT tree.
      *
-     * Do this by walking up edn, looking at corresponding
-     * points in the acllistRoot aci tree.
+     * Do this by walking down the RDNs of edn in the acllistTrie
+     * and picking the containers met on the way.
      *
      * If is_not_search_base is true, then we need to iterate on edn, otherwise
      * we've already got all the base handles above.
@@ -740,41 +759,33 @@ acllist_aciscan_update_scan(Acl_PBlock *aclpb, char *edn)
     */
 
     if (is_not_search_base) {
+        size_t min_depth = 0;
+        int found;
 
-        basedn = slapi_ch_strdup(edn);
-
-        while (basedn) {
-            char *tmp = NULL;
+        /* Stop below the search base, its containers are already there */
+        if (aclpb->aclpb_search_base && slapi_dn_issuffix(edn, aclpb->aclpb_search_base)) {
+            AclRdnKey rdns[ACL_DN_MAX_RDNS];
+            int depth = __acllist_dn_split(aclpb->aclpb_search_base, rdns);
 
-            slapi_sdn_set_ndn_byref(aclpb->aclpb_aclContainer->acic_sdn, basedn);
-
-            root = (AciContainer *)avl_find(acllistRoot,
-                                            (caddr_t)aclpb->aclpb_aclContainer,
-                                            (IFP)__acllist_aciContainer_node_cmp);
-
-            slapi_log_err(SLAPI_LOG_ACL, plugin_name,
-                          "acllist_aciscan_update_scan - Searching AVL tree for update:%s: container:%d\n",
-                          basedn, root ? root->acic_index : -1);
-            if (index >= aclpb_max_selected_acls - 2) {
-                aclpb->aclpb_handles_index[0] = -1;
-                slapi_ch_free((void **)&basedn);
-                break;
-            } else if (NULL != root) {
-                aclpb->aclpb_handles_index[index++] = root->acic_index;
-                aclpb->aclpb_handles_index[index] = -1;
+            if (depth >= 0) {
+                min_depth = depth + 1;
             }
-            tmp = slapi_dn_parent(basedn);
-            slapi_ch_free((void **)&basedn);
-            basedn = tmp;
-            if (aclpb->aclpb_search_base && tmp &&
-                (0 == strcasecmp(tmp, aclpb->aclpb_search_base))) {
-                slapi_ch_free((void **)&basedn);
-                tmp = NULL;
-            }
-        } /* while */
-    }
+        }
 
-    acllist_done_aciContainer(aclpb->aclpb_aclContainer);
+        ACILIST_LOCK_READ();
+        found = __acllist_trie_collect(edn, min_depth, &aclpb->aclpb_handles_index[index],
+                                       aclpb_max_selected_acls - 2 - index);
+        ACILIST_UNLOCK_READ();
+        if (found < 0) {
+            aclpb->aclpb_handles_index[0] = -1;
+        } else {
+            index += found;
+            aclpb->aclpb_handles_index[index] = -1;
+        }
+        slapi_log_err(SLAPI_LOG_ACL, plugin_name,
+                      "acllist_aciscan_update_scan - Found %d containers for update:%s\n",
+                      found, edn);
+    }
 }
 
 aci_t *
@@ -922,7 +933,9 @@ acllist_moddn_aci_needsLock(Slapi_DN *oldsdn, char *newdn)
     }
 
     /* Now set the new DN */
+    __acllist_trie_set(slapi_sdn_get_ndn(head->acic_sdn), -1);
     slapi_sdn_set_normdn_byval(head->acic_sdn, newdn);
+    __acllist_trie_set(slapi_sdn_get_ndn(head->acic_sdn), head->acic_index);
 
     /* If necessary, reset the target DNs, as well. */
     oldndn = slapi_sdn_get_ndn(oldsdn);
@@ -949,6 +962,219 @@ acllist_moddn_aci_needsLock(Slapi_DN *oldsdn, char *newdn)
     return 0;
 }
 
+static PLHashNumber
+__acllist_rdn_hash(const void *key)
+{
+    const AclRdnKey *k = (const AclRdnKey *)key;
+    PLHashNumber h = 0;
+    size_t i;
+
+    for (i = 0; i < k->ark_len; i++) {
+        h = (h >> 28) ^ (h << 4) ^ (unsigned char)k->ark_rdn[i];
+    }
+    return h;
+}
+
+static PRIntn
+__acllist_rdn_cmp(const void *v1, const void *v2)
+{
+    const AclRdnKey *k1 = (const AclRdnKey *)v1;
+    const AclRdnKey *k2 = (const AclRdnKey *)v2;
+
+    return (k1->ark_len == k2->ark_len && memcmp(k1->ark_rdn, k2->ark_rdn, k1->ark_len) == 0);
+}
+
+/*
+ * Split a normalized dn into its RDNs, the rightmost one first.
+ * Returns the number of RDNs, or -1 if there are more than ACL_DN_MAX_RDNS.
+ */
+static int
+__acllist_dn_split(const char *ndn, AclRdnKey *rdns)
+{
+    const char *start = ndn;
+    const char *p;
+    int n = 0;
+    int i;
+
+    if (NULL == ndn || '\0' == *ndn) {
+        return 0;
+    }
+    for (p = ndn;; p++) {
+        if ('\\' == *p && p[1]) {
+            p++;
+        } else if (',' == *p || '\0' == *p) {
+            if (n == ACL_DN_MAX_RDNS) {
+                return -1;
+            }
+            rdns[n].ark_rdn = start;
+            rdns[n].ark_len = p - start;
+            n++;
+            if ('\0' == *p) {
+                break;
+            }
+            start = p + 1;
+        }
+    }
+    /* reverse them, the suffix first */
+    for (i = 0; i < n / 2; i++) {
+        AclRdnKey tmp = rdns[i];
+        rdns[i] = rdns[n - 1 - i];
+        rdns[n - 1 - i] = tmp;
+    }
+    return n;
+}
+
+static AclDnNode *
+__acllist_trie_node_new(AclDnNode *parent, const AclRdnKey *key)
+{
+    AclDnNode *node = (AclDnNode *)slapi_ch_calloc(1, sizeof(AclDnNode));
+
+    node->adn_index = -1;
+    node->adn_parent = parent;
+    if (key) {
+        node->adn_rdn = slapi_ch_malloc(key->ark_len + 1);
+        memcpy(node->adn_rdn, key->ark_rdn, key->ark_len);
+        node->adn_rdn[key->ark_len] = '\0';
+        node->adn_key.ark_rdn = node->adn_rdn;
+        node->adn_key.ark_len = key->ark_len;
+        PL_HashTableAdd(parent->adn_children, &node->adn_key, node);
+    }
+    return node;
+}
+
+static AclDnNode *
+__acllist_trie_child(AclDnNode *node, const AclRdnKey *key)
+{
+    if (NULL == node->adn_children) {
+        return NULL;
+    }
+    return (AclDnNode *)PL_HashTableLookupConst(node->adn_children, key);
+}
+
+/*
+ * Set (or clear with -1) the container index of a dn in the trie.
+ * This routine must be called with the acicache write lock taken.
+ */
+static void
+__acllist_trie_set(const char *ndn, int index)
+{
+    AclRdnKey rdns[ACL_DN_MAX_RDNS];
+    AclDnNode *node;
+    AclDnNode *child;
+    int n;
+    int i;
+
+    if ((n = __acllist_dn_split(ndn, rdns)) < 0) {
+        /* such a container is only found by a full scan */
+        slapi_log_err(SLAPI_LOG_ACL, plugin_name,
+                      "__acllist_trie_set - Too many RDNs to index: %s\n", ndn);
+        return;
+    }
+    if (NULL == acllistTrie) {
+        if (index < 0) {
+            return;
+        }
+        acllistTrie = __acllist_trie_node_new(NULL, NULL);
+    }
+
+    node = acllistTrie;
+    for (i = 0; i < n; i++) {
+        if (NULL == (child = __acllist_trie_child(node, &rdns[i]))) {
+            if (index < 0) {
+                return;
+            }
+            if (NULL == node->adn_children) {
+                node->adn_children = PL_NewHashTable(0, __acllist_rdn_hash, __acllist_rdn_cmp,
+                                                     PL_CompareValues, NULL, NULL);
+            }
+            child = __acllist_trie_node_new(node, &rdns[i]);
+        }
+        node = child;
+    }
+    node->adn_index = index;
+
+    /* prune the branch that does not lead to a container anymore */
+    while (index < 0 && node->adn_parent && node->adn_index < 0 &&
+           (NULL == node->adn_children || 0 == node->adn_children->nentries)) {
+        AclDnNode *parent = node->adn_parent;
+
+        PL_HashTableRemove(parent->adn_children, &node->adn_key);
+        __acllist_trie_free(node);
+        node = parent;
+    }
+}
+
+static PRIntn
+__acllist_trie_free_child(PLHashEntry *he, PRIntn i __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    __acllist_trie_free((AclDnNode *)he->value);
+    return HT_ENUMERATE_NEXT;
+}
+
+static void
+__acllist_trie_free(AclDnNode *node)
+{
+    if (NULL == node) {
+        return;
+    }
+    if (node->adn_children) {
+        PL_HashTableEnumerateEntries(node->adn_children, __acllist_trie_free_child, NULL);
+        PL_HashTableDestroy(node->adn_children);
+    }
+    slapi_ch_free_string(&node->adn_rdn);
+    slapi_ch_free((void **)&node);
+}
+
+/*
+ * Collect the indexes of the containers at and above ndn, the closest one
+ * first, skipping the ones less than min_depth RDNs deep. The root DSE
+ * container only applies to the root DSE.
+ * Returns the number of indexes, or -1 if there are more than max.
+ */
+static int
+__acllist_trie_collect(const char *ndn, size_t min_depth, int *indexes, int max)
+{
+    AclRdnKey rdns[ACL_DN_MAX_RDNS];
+    AclDnNode *node = acllistTrie;
+    int found = 0;
+    int n;
+    int i;
+
+    if ((n = __acllist_dn_split(ndn, rdns)) < 0) {
+        return -1;
+    }
+    if (NULL == node) {
+        return 0;
+    }
+    if (0 == n) {
+        if (node->adn_index >= 0 && 0 == min_depth) {
+            if (max < 1) {
+                return -1;
+            }
+            indexes[found++] = node->adn_index;
+        }
+        return found;
+    }
+    for (i = 0; i < n; i++) {
+        if (NULL == (node = __acllist_trie_child(node, &rdns[i]))) {
+            break;
+        }
+        if (node->adn_index >= 0 && (size_t)(i + 1) >= min_depth) {
+            if (found >= max) {
+                return -1;
+            }
+            indexes[found++] = node->adn_index;
+        }
+    }
+    /* the closest container first */
+    for (i = 0; i < found / 2; i++) {
+        int tmp = indexes[i];
+        indexes[i] = indexes[found - 1 - i];
+        indexes[found - 1 - i] = tmp;
+    }
+    return found;
+}
+
 void
 acllist_print_tree(Avlnode *root, int *depth, char *start, char *side)
 {
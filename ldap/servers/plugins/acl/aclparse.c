@@ -1027,6 +1027,13 @@ normalize_nextACERule:
             }
             p = prefix;
 
+            /* A URL with a filter is tested against the client entry,
+            ** see acllas__client_match_URL().
+            */
+            if (PL_strnchr(p, '?', end - p)) {
+                aci_item->aci_ruleType |= ACI_USERDN_URLRULE;
+            }
+
 
             /* we have a rule like userdn = "ldap:///blah". s points to blah now.
             ** let's find if we have a SELF rule like userdn = "ldap:///self".
@@ -276,6 +276,8 @@ aclplugin_stop(Slapi_PBlock *pb __attribute__((unused)))
     ACL_DestroyPools();
     aclanom__del_profile(1);
     aclgroup_free();
+    acl_decision_cache_free();
+    acl_group_closure_free();
     acllist_free();
 
     return rc;
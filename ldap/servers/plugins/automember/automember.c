@@ -72,8 +72,12 @@ static int automember_isrepl(Slapi_PBlock *pb);
 static void automember_parse_regex_entry(struct configEntry *config, Slapi_Entry *e);
 static struct automemberRegexRule *automember_parse_regex_rule(char *rule_string);
 static void automember_free_regex_rule(struct automemberRegexRule *rule);
+static void automember_regex_literal(struct automemberRegexRule *rule);
+static struct automemberMatcher *automember_compile_rules(struct configEntry *config);
+static void automember_free_matcher(struct automemberMatcher **matcher);
 static int automember_parse_grouping_attr(char *value, char **grouping_attr, char **grouping_value);
 static int automember_update_membership(struct configEntry *config, Slapi_Entry *e, PRFileDesc *ldif_fd);
+static const char *automember_get_member_value(Slapi_Entry *member_e, const char *grouping_value);
 static int automember_update_member_value(Slapi_Entry *member_e, const char *group_dn, char *grouping_attr,
                                           char *grouping_value, PRFileDesc *ldif_fd, int add);
 
@@ -700,6 +704,8 @@ automember_parse_config_entry(Slapi_Entry *e, int apply)
         automember_parse_regex_entry(entry, rule_entries[i]);
     }
 
+    /* Group the rules for evaluation */
+    entry->matcher = automember_compile_rules(entry);
 
     /* If we were only called to validate config, we can
      * just bail out before applying the config changes */
@@ -794,6 +800,9 @@ automember_free_config_entry(struct configEntry **entry)
         slapi_filter_free(e->filter, 1);
     }
 
+    /* The matcher references the rules, free it first */
+    automember_free_matcher(&e->matcher);
+
     if (e->exclusive_rules) {
         PRCList *list;
 
@@ -1234,6 +1243,7 @@ automember_parse_regex_rule(char *rule_string)
     rule->attr = attr;
     rule->regex_str = slapi_ch_strdup(p);
     rule->regex = regex;
+    automember_regex_literal(rule);
 
 bail:
     /* Cleanup if we didn't successfully create a rule. */
@@ -1269,11 +1279,254 @@ automember_free_regex_rule(struct automemberRegexRule *rule)
         if (rule->regex) {
             slapi_re_free(rule->regex);
         }
+
+        slapi_ch_free_string(&(rule->literal));
     }
 
     slapi_ch_free((void **)&rule);
 }
 
+/*
+ * automember_regex_literal()
+ *
+ * Extracts the literal text a value has to contain to match the
+ * regex of a rule, so most values can be rejected without running
+ * the regex.  The literal is either the start of an anchored regex,
+ * or the whole regex when it has no special character at all.
+ * Anything we are not sure about (escapes, alternatives) leaves the
+ * rule without a literal.
+ */
+static void
+automember_regex_literal(struct automemberRegexRule *rule)
+{
+    const char *p = rule->regex_str;
+    size_t len = 0;
+    int anchored = 0;
+
+    if (*p == '^') {
+        anchored = 1;
+        p++;
+    }
+    if (strchr(p, '|')) {
+        return;
+    }
+    while (p[len] && !strchr("\\^$.[]()?*+{}", p[len])) {
+        len++;
+    }
+    if (p[len] == '?' || p[len] == '*' || p[len] == '{') {
+        /* The last character is optional */
+        if (len) {
+            len--;
+        }
+    }
+    if (len == 0 || (!anchored && p[len] != '\0')) {
+        return;
+    }
+
+    rule->literal = slapi_ch_malloc(len + 1);
+    memcpy(rule->literal, p, len);
+    rule->literal[len] = '\0';
+    rule->literal_len = len;
+    rule->anchored = anchored;
+    rule->exact = (p[len] == '\0');
+}
+
+static int
+automember_sdn_cmp(const void *a, const void *b)
+{
+    return slapi_sdn_compare(*(Slapi_DN **)a, *(Slapi_DN **)b);
+}
+
+/*
+ * Groups the rules of a list by comparison attribute, numbering
+ * their target group from the matcher.
+ */
+static struct automemberAttrRules *
+automember_group_rules(struct automemberMatcher *matcher, struct automemberRegexRule *rules, size_t *nattrs)
+{
+    struct automemberAttrRules *attrs = NULL;
+    PRCList *list;
+    size_t i;
+
+    *nattrs = 0;
+    if (rules == NULL) {
+        return NULL;
+    }
+
+    for (list = PR_LIST_HEAD((PRCList *)rules); list != (PRCList *)rules; list = PR_NEXT_LINK(list)) {
+        struct automemberRegexRule *rule = (struct automemberRegexRule *)list;
+        Slapi_DN **target;
+
+        target = (Slapi_DN **)bsearch(&rule->target_group_dn, matcher->targets, matcher->ntargets,
+                                      sizeof(Slapi_DN *), automember_sdn_cmp);
+        rule->target = target - matcher->targets;
+
+        for (i = 0; i < *nattrs; i++) {
+            if (slapi_attr_type_cmp(attrs[i].attr, rule->attr, SLAPI_TYPE_CMP_EXACT) == 0) {
+                break;
+            }
+        }
+        if (i == *nattrs) {
+            attrs = (struct automemberAttrRules *)slapi_ch_realloc((char *)attrs,
+                                                                    (*nattrs + 1) * sizeof(struct automemberAttrRules));
+            attrs[i].attr = rule->attr;
+            attrs[i].nrules = 0;
+            attrs[i].rules = NULL;
+            (*nattrs)++;
+        }
+        /* Keep the rules ordered by target group DN */
+        attrs[i].rules = (struct automemberRegexRule **)slapi_ch_realloc((char *)attrs[i].rules,
+                                                                          (attrs[i].nrules + 1) * sizeof(struct automemberRegexRule *));
+        attrs[i].rules[attrs[i].nrules++] = rule;
+    }
+
+    return attrs;
+}
+
+/*
+ * automember_compile_rules()
+ *
+ * Builds the matcher of a definition from its inclusive and
+ * exclusive rule lists.  The matcher only references the rules,
+ * it must be freed before them.
+ */
+static struct automemberMatcher *
+automember_compile_rules(struct configEntry *config)
+{
+    struct automemberMatcher *matcher;
+    struct automemberRegexRule *lists[2] = {config->inclusive_rules, config->exclusive_rules};
+    PRCList *list;
+    size_t count = 0;
+    size_t i, j;
+
+    matcher = (struct automemberMatcher *)slapi_ch_calloc(1, sizeof(struct automemberMatcher));
+
+    /* Number the distinct target groups in DN order */
+    for (i = 0; i < 2; i++) {
+        if (lists[i] == NULL) {
+            continue;
+        }
+        for (list = PR_LIST_HEAD((PRCList *)lists[i]); list != (PRCList *)lists[i]; list = PR_NEXT_LINK(list)) {
+            count++;
+        }
+    }
+    if (count == 0) {
+        return matcher;
+    }
+    matcher->targets = (Slapi_DN **)slapi_ch_calloc(count, sizeof(Slapi_DN *));
+    for (i = 0; i < 2; i++) {
+        if (lists[i] == NULL) {
+            continue;
+        }
+        for (list = PR_LIST_HEAD((PRCList *)lists[i]); list != (PRCList *)lists[i]; list = PR_NEXT_LINK(list)) {
+            matcher->targets[matcher->ntargets++] = ((struct automemberRegexRule *)list)->target_group_dn;
+        }
+    }
+    qsort(matcher->targets, matcher->ntargets, sizeof(Slapi_DN *), automember_sdn_cmp);
+    for (i = 1, j = 0; i < matcher->ntargets; i++) {
+        if (slapi_sdn_compare(matcher->targets[i], matcher->targets[j]) != 0) {
+            matcher->targets[++j] = matcher->targets[i];
+        }
+    }
+    matcher->ntargets = j + 1;
+
+    matcher->inclusive = automember_group_rules(matcher, config->inclusive_rules, &matcher->ninclusive);
+    matcher->exclusive = automember_group_rules(matcher, config->exclusive_rules, &matcher->nexclusive);
+
+    matcher->has_inclusive = (char *)slapi_ch_calloc(matcher->ntargets, sizeof(char));
+    for (i = 0; i < matcher->ninclusive; i++) {
+        for (j = 0; j < matcher->inclusive[i].nrules; j++) {
+            matcher->has_inclusive[matcher->inclusive[i].rules[j]->target] = 1;
+        }
+    }
+
+    return matcher;
+}
+
+static void
+automember_free_attr_rules(struct automemberAttrRules **attrs, size_t nattrs)
+{
+    size_t i;
+
+    for (i = 0; *attrs && i < nattrs; i++) {
+        slapi_ch_free((void **)&((*attrs)[i].rules));
+    }
+    slapi_ch_free((void **)attrs);
+}
+
+static void
+automember_free_matcher(struct automemberMatcher **matcher)
+{
+    struct automemberMatcher *m = *matcher;
+
+    if (m == NULL) {
+        return;
+    }
+    automember_free_attr_rules(&m->inclusive, m->ninclusive);
+    automember_free_attr_rules(&m->exclusive, m->nexclusive);
+    slapi_ch_free((void **)&m->targets);
+    slapi_ch_free((void **)&m->has_inclusive);
+    slapi_ch_free((void **)matcher);
+}
+
+/*
+ * automember_match_rules()
+ *
+ * Sets matched[n] for each target group n with a rule matching a
+ * value of the entry.  Targets already matched or set in skip are
+ * not evaluated again.
+ */
+static void
+automember_match_rules(struct automemberAttrRules *attrs, size_t nattrs, Slapi_Entry *e,
+                       char *matched, const char *skip, const char *kind)
+{
+    size_t i, j;
+
+    for (i = 0; i < nattrs; i++) {
+        Slapi_Attr *attr = NULL;
+
+        if (slapi_entry_attr_find(e, attrs[i].attr, &attr) != 0) {
+            continue;
+        }
+        for (j = 0; j < attrs[i].nrules; j++) {
+            struct automemberRegexRule *rule = attrs[i].rules[j];
+            Slapi_Value *v = NULL;
+            int hint;
+
+            if (matched[rule->target] || (skip && skip[rule->target])) {
+                continue;
+            }
+            for (hint = slapi_attr_first_value(attr, &v); hint != -1; hint = slapi_attr_next_value(attr, hint, &v)) {
+                const char *val = slapi_value_get_string(v);
+                int match;
+
+                if (val == NULL) {
+                    continue;
+                }
+                if (rule->literal == NULL) {
+                    match = (slapi_re_exec_nt(rule->regex, val) == 1);
+                } else if (rule->anchored) {
+                    match = (strncmp(val, rule->literal, rule->literal_len) == 0) &&
+                            (rule->exact || slapi_re_exec_nt(rule->regex, val) == 1);
+                } else {
+                    match = (strstr(val, rule->literal) != NULL);
+                }
+                if (match) {
+                    slapi_log_err(SLAPI_LOG_PLUGIN, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                                  "automember_get_membership_lists - Adding \"%s\" "
+                                  "to list of %s groups for \"%s\" "
+                                  "(matched: \"%s=%s\").\n",
+                                  slapi_sdn_get_dn(rule->target_group_dn), kind,
+                                  slapi_entry_get_dn(e), rule->attr,
+                                  rule->regex_str);
+                    matched[rule->target] = 1;
+                    break;
+                }
+            }
+        }
+    }
+}
+
 /*
  * automember_parse_grouping_attr()
  *
@@ -1414,136 +1667,46 @@ automember_free_membership_lists(PRCList *exclusions, PRCList *targets)
 static void
 automember_get_membership_lists(struct configEntry *config, PRCList *exclusions, PRCList *targets, Slapi_Entry *e)
 {
-    PRCList *rule = NULL;
-    struct automemberRegexRule *curr_rule = NULL;
+    struct automemberMatcher *matcher = config->matcher;
     struct automemberDNListItem *dnitem = NULL;
-    Slapi_DN *last = NULL;
-    PRCList *curr_exclusion = NULL;
-    char **vals = NULL;
-    int i = 0;
+    char flags_buf[128];
+    char *flags = flags_buf;
+    char *excluded;
+    char *included;
+    size_t i;
 
     PR_INIT_CLIST(exclusions);
     PR_INIT_CLIST(targets);
 
-    /* Go through exclusive rules and build an exclusion list. */
-    if (config->exclusive_rules) {
-        if (!PR_CLIST_IS_EMPTY((PRCList *)config->exclusive_rules)) {
-            rule = PR_LIST_HEAD((PRCList *)config->exclusive_rules);
-            while (rule != (PRCList *)config->exclusive_rules) {
-                curr_rule = (struct automemberRegexRule *)rule;
-
-                /* Regex rules are sorted by the target group DN.  This means
-                 * we can skip all rules for the last target group DN that we
-                 * added to the exclusions list. */
-                if ((last == NULL) || slapi_sdn_compare(last, curr_rule->target_group_dn) != 0) {
-                    /* Get comparison attr and loop through values. */
-                    vals = slapi_entry_attr_get_charray(e, curr_rule->attr);
-                    for (i = 0; vals && vals[i]; ++i) {
-                        /* Evaluate the regex. */
-                        if (slapi_re_exec_nt(curr_rule->regex, vals[i]) == 1) {
-                            /* Found a match.  Add to end of the exclusion list
-                             * and set last as a hint to ourselves. */
-                            slapi_log_err(SLAPI_LOG_PLUGIN, AUTOMEMBER_PLUGIN_SUBSYSTEM,
-                                          "automember_get_membership_lists - Adding \"%s\" "
-                                          "to list of excluded groups for \"%s\" "
-                                          "(matched: \"%s=%s\").\n",
-                                          slapi_sdn_get_dn(curr_rule->target_group_dn),
-                                          slapi_entry_get_dn(e), curr_rule->attr,
-                                          curr_rule->regex_str);
-                            dnitem = (struct automemberDNListItem *)slapi_ch_calloc(1, sizeof(struct automemberDNListItem));
-                            /* We are just referencing the dn from the regex rule.  We
-                             * will not free it when we clean up this list.  This list
-                             * is more short-lived than the regex rule list, so we can
-                             * get away with this optimization. */
-                            dnitem->dn = curr_rule->target_group_dn;
-                            PR_APPEND_LINK(&(dnitem->list), exclusions);
-                            last = curr_rule->target_group_dn;
-                        }
-                    }
-
-                    slapi_ch_array_free(vals);
-                    vals = NULL;
-                }
-
-                rule = PR_NEXT_LINK(rule);
-            }
+    if (matcher == NULL || matcher->ntargets == 0) {
+        return;
+    }
+    if (matcher->ntargets * 2 > sizeof(flags_buf)) {
+        flags = (char *)slapi_ch_malloc(matcher->ntargets * 2);
+    }
+    memset(flags, 0, matcher->ntargets * 2);
+    excluded = flags;
+    included = flags + matcher->ntargets;
+
+    /* Evaluate the exclusive rules first, the inclusive rules of the
+     * excluded targets don't need to be evaluated at all. */
+    automember_match_rules(matcher->exclusive, matcher->nexclusive, e, excluded, NULL, "excluded");
+    automember_match_rules(matcher->inclusive, matcher->ninclusive, e, included, excluded, "target");
+
+    /* Both lists are built in target group DN order.  We are just
+     * referencing the dn from the regex rule.  We will not free it when
+     * we clean up these lists.  They are more short-lived than the regex
+     * rules, so we can get away with this optimization. */
+    for (i = 0; i < matcher->ntargets; i++) {
+        if (excluded[i] || included[i]) {
+            dnitem = (struct automemberDNListItem *)slapi_ch_calloc(1, sizeof(struct automemberDNListItem));
+            dnitem->dn = matcher->targets[i];
+            PR_APPEND_LINK(&(dnitem->list), excluded[i] ? exclusions : targets);
         }
     }
 
-    /* Go through inclusive rules and build the target list. */
-    if (config->inclusive_rules) {
-        if (!PR_CLIST_IS_EMPTY((PRCList *)config->inclusive_rules)) {
-            /* Clear out our last hint from processing exclusions. */
-            last = NULL;
-
-            /* Get the first excluded target for exclusion checking. */
-            if (!PR_CLIST_IS_EMPTY(exclusions)) {
-                curr_exclusion = PR_LIST_HEAD(exclusions);
-            }
-
-            rule = PR_LIST_HEAD((PRCList *)config->inclusive_rules);
-            while (rule != (PRCList *)config->inclusive_rules) {
-                curr_rule = (struct automemberRegexRule *)rule;
-
-                /* The excluded targets are stored in alphabetical order.  Instead
-                 * of going through the entire exclusion list for each inclusive
-                 * rule, we can simply go through the exclusion list once and keep
-                 * track of our position.  If the curent exclusion comes after
-                 * the target DN used in the current inclusive rule, it can't be
-                 * excluded.  If the current exclusion comes before the target
-                 * in the current rule, we need to go through the exclusion list
-                 * until we find a target that is the same or comes after the
-                 * current rule. */
-                if (curr_exclusion) {
-                    while ((curr_exclusion != exclusions) && (slapi_sdn_compare(
-                                                                   ((struct automemberDNListItem *)curr_exclusion)->dn,
-                                                                   curr_rule->target_group_dn) < 0)) {
-                        curr_exclusion = PR_NEXT_LINK(curr_exclusion);
-                    }
-                }
-
-                /* Regex rules are sorted by the target group DN.  This means
-                 * we can skip all rules for the last target group DN that we
-                 * added to the targets list.  We also skip any rules for
-                 * target groups that have been excluded by an exclusion rule. */
-                if (((curr_exclusion == NULL) || (curr_exclusion == exclusions) ||
-                     slapi_sdn_compare(((struct automemberDNListItem *)curr_exclusion)->dn,
-                                       curr_rule->target_group_dn) != 0) &&
-                    ((last == NULL) ||
-                     (slapi_sdn_compare(last, curr_rule->target_group_dn) != 0))) {
-                    /* Get comparison attr and loop through values. */
-                    vals = slapi_entry_attr_get_charray(e, curr_rule->attr);
-                    for (i = 0; vals && vals[i]; ++i) {
-                        /* Evaluate the regex. */
-                        if (slapi_re_exec_nt(curr_rule->regex, vals[i]) == 1) {
-                            /* Found a match.  Add to the end of the targets list
-                             * and set last as a hint to ourselves. */
-                            slapi_log_err(SLAPI_LOG_PLUGIN, AUTOMEMBER_PLUGIN_SUBSYSTEM,
-                                          "automember_get_membership_lists - Adding \"%s\" "
-                                          "to list of target groups for \"%s\" "
-                                          "(matched: \"%s=%s\").\n",
-                                          slapi_sdn_get_dn(curr_rule->target_group_dn),
-                                          slapi_entry_get_dn(e), curr_rule->attr,
-                                          curr_rule->regex_str);
-                            dnitem = (struct automemberDNListItem *)slapi_ch_calloc(1,
-                                                                                    sizeof(struct automemberDNListItem));
-                            /* We are just referencing the dn from the regex rule.  We
-                             * will not free it when we clean up this list.  This list
-                             * is more short-lived than the regex rule list, so we can
-                             * get away with this optimization. */
-                            dnitem->dn = curr_rule->target_group_dn;
-                            PR_APPEND_LINK(&(dnitem->list), targets);
-                            last = curr_rule->target_group_dn;
-                        }
-                    }
-
-                    slapi_ch_array_free(vals);
-                    vals = NULL;
-                }
-
-                rule = PR_NEXT_LINK(rule);
-            }
-        }
+    if (flags != flags_buf) {
+        slapi_ch_free((void **)&flags);
     }
 }
 
@@ -1621,6 +1784,22 @@ out:
 }
 
 
+/*
+ * automember_get_member_value()
+ *
+ * Returns the value representing an entry in the grouping attribute
+ * of its groups.
+ */
+static const char *
+automember_get_member_value(Slapi_Entry *member_e, const char *grouping_value)
+{
+    /* If grouping_value is dn, we need to fetch the dn instead. */
+    if (slapi_attr_type_cmp(grouping_value, "dn", SLAPI_TYPE_CMP_EXACT) == 0) {
+        return slapi_entry_get_ndn(member_e);
+    }
+    return slapi_entry_attr_get_ref(member_e, grouping_value);
+}
+
 /*
  * automember_update_member_value()
  *
@@ -1657,12 +1836,7 @@ automember_update_member_value(Slapi_Entry *member_e, const char *group_dn, char
         return rc;
     }
 
-    /* If grouping_value is dn, we need to fetch the dn instead. */
-    if (slapi_attr_type_cmp(grouping_value, "dn", SLAPI_TYPE_CMP_EXACT) == 0) {
-        member_value = slapi_entry_get_ndn(member_e);
-    } else {
-        member_value = (char *)slapi_entry_attr_get_ref(member_e, grouping_value);
-    }
+    member_value = (char *)automember_get_member_value(member_e, grouping_value);
 
     /*
      *  If ldif_fd is set, we are performing an export task.  Write the changes to the
@@ -2139,6 +2313,8 @@ typedef struct _task_data
     Slapi_DN *base_dn;
     char *bind_dn;
     int scope;
+    int32_t threads;
+    int32_t batch_size;
 } task_data;
 
 static void
@@ -2271,8 +2447,13 @@ automember_task_abort_thread(void *arg)
  *    basedn: dc=example,dc=com
  *    filter: (uid=*)
  *    scope: sub
+ *    threads: 4
+ *    batchsize: 1000
  *
- *    basedn and filter are required. If scope is omitted, the default is sub
+ *    basedn and filter are required. If scope is omitted, the default is sub.
+ *    threads is the number of threads updating the groups (default 1), and
+ *    batchsize the number of members added to or deleted from a group in
+ *    a single modify (default 1000).
  */
 static int
 automember_task_add(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *eAfter __attribute__((unused)), int *returncode, char *returntext __attribute__((unused)), void *arg)
@@ -2285,6 +2466,8 @@ automember_task_add(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *eAfter __attr
     const char *base_dn;
     const char *filter;
     const char *scope;
+    int32_t threads = 1;
+    int32_t batch_size = AUTOMEMBER_REBUILD_BATCH_SIZE;
 
     *returncode = LDAP_SUCCESS;
 
@@ -2302,6 +2485,32 @@ automember_task_add(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *eAfter __attr
         goto out;
     }
     scope = slapi_fetch_attr(e, "scope", "sub");
+
+    /* number of threads updating the groups */
+    if (slapi_entry_attr_exists(e, "threads")) {
+        threads = slapi_entry_attr_get_int(e, "threads");
+        if (threads < 1 || threads > AUTOMEMBER_REBUILD_THREADS_MAX) {
+            slapi_log_err(SLAPI_LOG_ERR, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                          "automember_task_add - threads must be between 1 and %d\n",
+                          AUTOMEMBER_REBUILD_THREADS_MAX);
+            *returncode = LDAP_UNWILLING_TO_PERFORM;
+            rv = SLAPI_DSE_CALLBACK_ERROR;
+            goto out;
+        }
+    }
+
+    /* number of member values added to or deleted from a group per modify */
+    if (slapi_entry_attr_exists(e, "batchsize")) {
+        batch_size = slapi_entry_attr_get_int(e, "batchsize");
+        if (batch_size < 1 || batch_size > AUTOMEMBER_REBUILD_BATCH_MAX) {
+            slapi_log_err(SLAPI_LOG_ERR, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                          "automember_task_add - batchsize must be between 1 and %d\n",
+                          AUTOMEMBER_REBUILD_BATCH_MAX);
+            *returncode = LDAP_UNWILLING_TO_PERFORM;
+            rv = SLAPI_DSE_CALLBACK_ERROR;
+            goto out;
+        }
+    }
     /*
      *  setup our task data
      */
@@ -2316,6 +2525,8 @@ automember_task_add(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *eAfter __attr
     mytaskdata->bind_dn = slapi_ch_strdup(bind_dn);
     mytaskdata->base_dn = slapi_sdn_new_dn_byval(base_dn);
     mytaskdata->filter_str = slapi_ch_strdup(filter);
+    mytaskdata->threads = threads;
+    mytaskdata->batch_size = batch_size;
 
     if (scope) {
         if (strcasecmp(scope, "sub") == 0) {
@@ -2356,11 +2567,359 @@ out:
     return rv;
 }
 
+/*
+ * Membership changes of a group collected by the rebuild task.  Only
+ * the last change of a member value is kept, it is the one the
+ * modifies would have left if they had been done one at a time.
+ */
+typedef struct _rebuild_batch
+{
+    struct _rebuild_batch *next;
+    char *key;           /* grouping attr and group ndn */
+    char *group_dn;
+    char *grouping_attr;
+    PLHashTable *values; /* member value -> ADD_MEMBER or DEL_MEMBER, plus one */
+    size_t count;
+    int32_t worker;
+} rebuild_batch;
+
+struct _rebuild_run;
+
+typedef struct _rebuild_worker
+{
+    struct _rebuild_run *run;
+    PRThread *thread;
+    rebuild_batch *head; /* batches to apply, in order */
+    rebuild_batch *tail;
+} rebuild_worker;
+
+typedef struct _rebuild_run
+{
+    Slapi_Task *task;
+    task_data *td;
+    PRLock *lock;
+    PRCondVar *cv;
+    rebuild_worker *workers;
+    int32_t nworkers;
+    PLHashTable *batches; /* key -> batch being filled, search thread only */
+    uint64_t queued;      /* batches waiting for a worker */
+    int searching;
+    int rc;
+} rebuild_run;
+
+static PRIntn
+automember_rebuild_free_value(PLHashEntry *he, PRIntn index __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    slapi_ch_free((void **)&he->key);
+    return HT_ENUMERATE_NEXT;
+}
+
+static void
+automember_rebuild_batch_free(rebuild_batch **batch)
+{
+    if (*batch == NULL) {
+        return;
+    }
+    if ((*batch)->values) {
+        PL_HashTableEnumerateEntries((*batch)->values, automember_rebuild_free_value, NULL);
+        PL_HashTableDestroy((*batch)->values);
+    }
+    slapi_ch_free_string(&(*batch)->key);
+    slapi_ch_free_string(&(*batch)->group_dn);
+    slapi_ch_free_string(&(*batch)->grouping_attr);
+    slapi_ch_free((void **)batch);
+}
+
+/*
+ * Hands a batch to the worker of its group.  All the batches of a
+ * group go to the same worker, so they are applied in order.
+ */
+static void
+automember_rebuild_queue(rebuild_run *run, rebuild_batch *batch)
+{
+    rebuild_worker *worker = &run->workers[batch->worker];
+
+    PR_Lock(run->lock);
+    /* Bound the memory held by the batches in flight */
+    while (run->queued >= (uint64_t)run->nworkers * 4 && run->rc == 0) {
+        PR_WaitCondVar(run->cv, PR_SecondsToInterval(1));
+    }
+    batch->next = NULL;
+    if (worker->tail) {
+        worker->tail->next = batch;
+    } else {
+        worker->head = batch;
+    }
+    worker->tail = batch;
+    run->queued++;
+    PR_NotifyAllCondVar(run->cv);
+    PR_Unlock(run->lock);
+}
+
+static PRIntn
+automember_rebuild_queue_batch(PLHashEntry *he, PRIntn index __attribute__((unused)), void *arg)
+{
+    automember_rebuild_queue((rebuild_run *)arg, (rebuild_batch *)he->value);
+    return HT_ENUMERATE_REMOVE;
+}
+
+static PRIntn
+automember_rebuild_drop_batch(PLHashEntry *he, PRIntn index __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    rebuild_batch *batch = (rebuild_batch *)he->value;
+
+    automember_rebuild_batch_free(&batch);
+    return HT_ENUMERATE_REMOVE;
+}
+
+/*
+ * Records a membership change of a group, and queues the batch of
+ * the group once it is full.
+ */
+static void
+automember_rebuild_record(rebuild_run *run, const char *group_dn, const char *grouping_attr, const char *value, int add)
+{
+    Slapi_DN *sdn = slapi_sdn_new_dn_byval(group_dn);
+    rebuild_batch *batch;
+    PLHashEntry **hep;
+    PLHashNumber hash;
+    char *key;
+    char *p;
+
+    key = slapi_ch_smprintf("%s:%s", grouping_attr, slapi_sdn_get_ndn(sdn));
+    for (p = key; *p != ':'; p++) {
+        *p = tolower(*p);
+    }
+    slapi_sdn_free(&sdn);
+
+    batch = (rebuild_batch *)PL_HashTableLookup(run->batches, key);
+    if (batch == NULL) {
+        batch = (rebuild_batch *)slapi_ch_calloc(1, sizeof(rebuild_batch));
+        batch->key = key;
+        batch->group_dn = slapi_ch_strdup(group_dn);
+        batch->grouping_attr = slapi_ch_strdup(grouping_attr);
+        batch->values = PL_NewHashTable(0, PL_HashString, PL_CompareStrings, PL_CompareValues, NULL, NULL);
+        batch->worker = PL_HashString(key) % run->nworkers;
+        PL_HashTableAdd(run->batches, batch->key, batch);
+    } else {
+        slapi_ch_free_string(&key);
+    }
+
+    hash = PL_HashString(value);
+    hep = PL_HashTableRawLookup(batch->values, hash, value);
+    if (*hep) {
+        (*hep)->value = (void *)(intptr_t)(add + 1);
+    } else {
+        PL_HashTableRawAdd(batch->values, hep, hash, slapi_ch_strdup(value), (void *)(intptr_t)(add + 1));
+        batch->count++;
+    }
+
+    if (batch->count >= (size_t)run->td->batch_size) {
+        PL_HashTableRemove(run->batches, batch->key);
+        automember_rebuild_queue(run, batch);
+    }
+}
+
+typedef struct _rebuild_apply
+{
+    Slapi_Entry *group_e;
+    char *grouping_attr;
+    char **adds;
+    size_t nadds;
+    char **dels;
+    size_t ndels;
+} rebuild_apply;
+
+static PRIntn
+automember_rebuild_sort_value(PLHashEntry *he, PRIntn index __attribute__((unused)), void *arg)
+{
+    rebuild_apply *apply = (rebuild_apply *)arg;
+    Slapi_Value *sval = slapi_value_new_string((const char *)he->key);
+    int present = slapi_entry_attr_has_syntax_value(apply->group_e, apply->grouping_attr, sval);
+
+    slapi_value_free(&sval);
+    if ((intptr_t)he->value == ADD_MEMBER + 1) {
+        if (!present) {
+            apply->adds[apply->nadds++] = (char *)he->key;
+        }
+    } else if (present) {
+        apply->dels[apply->ndels++] = (char *)he->key;
+    }
+    return HT_ENUMERATE_NEXT;
+}
+
+static int
+automember_rebuild_modify(const char *group_dn, LDAPMod **mods)
+{
+    Slapi_PBlock *mod_pb = slapi_pblock_new();
+    int result = LDAP_SUCCESS;
+
+    slapi_modify_internal_set_pb(mod_pb, group_dn, mods, 0, 0, automember_get_plugin_id(), 0);
+    slapi_modify_internal_pb(mod_pb);
+    slapi_pblock_get(mod_pb, SLAPI_PLUGIN_INTOP_RESULT, &result);
+    slapi_pblock_destroy(mod_pb);
+
+    return result;
+}
+
+/*
+ * Applies a batch with a single modify of the group: the values to
+ * delete and to add are checked against the group first, as a modify
+ * deleting a missing value or adding an existing one fails as a whole.
+ * If the group was updated meanwhile, fall back to one value at a time.
+ */
+static int
+automember_rebuild_apply(rebuild_batch *batch)
+{
+    rebuild_apply apply = {0};
+    Slapi_DN *sdn = slapi_sdn_new_dn_byval(batch->group_dn);
+    char *attrs[2] = {batch->grouping_attr, NULL};
+    LDAPMod del_mod;
+    LDAPMod add_mod;
+    LDAPMod *mods[3];
+    int result;
+    int rc = 0;
+    size_t i;
+
+    result = slapi_search_internal_get_entry(sdn, attrs, &apply.group_e, automember_get_plugin_id());
+    slapi_sdn_free(&sdn);
+    if (result != LDAP_SUCCESS) {
+        if (result == LDAP_NO_SUCH_OBJECT) {
+            /* the automember group (default or target) does not exist, just skip it */
+            slapi_log_err(SLAPI_LOG_INFO, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                          "automember_rebuild_apply - group (default or target) does not exist (%s)\n",
+                          batch->group_dn);
+            return 0;
+        }
+        slapi_log_err(SLAPI_LOG_ERR, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                      "automember_rebuild_apply - group (default or target) can not be retrieved (%s) err=%d\n",
+                      batch->group_dn, result);
+        return result;
+    }
+
+    apply.grouping_attr = batch->grouping_attr;
+    apply.adds = (char **)slapi_ch_calloc(batch->count + 1, sizeof(char *));
+    apply.dels = (char **)slapi_ch_calloc(batch->count + 1, sizeof(char *));
+    PL_HashTableEnumerateEntries(batch->values, automember_rebuild_sort_value, &apply);
+    slapi_entry_free(apply.group_e);
+
+    if (apply.nadds == 0 && apply.ndels == 0) {
+        goto done;
+    }
+
+    slapi_log_err(SLAPI_LOG_PLUGIN, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                  "automember_rebuild_apply - Adding %lu and deleting %lu \"%s\" values of group \"%s\".\n",
+                  (unsigned long)apply.nadds, (unsigned long)apply.ndels, batch->grouping_attr, batch->group_dn);
+    i = 0;
+    if (apply.ndels) {
+        del_mod.mod_op = LDAP_MOD_DELETE;
+        del_mod.mod_type = batch->grouping_attr;
+        del_mod.mod_values = apply.dels;
+        mods[i++] = &del_mod;
+    }
+    if (apply.nadds) {
+        add_mod.mod_op = LDAP_MOD_ADD;
+        add_mod.mod_type = batch->grouping_attr;
+        add_mod.mod_values = apply.adds;
+        mods[i++] = &add_mod;
+    }
+    mods[i] = NULL;
+    result = automember_rebuild_modify(batch->group_dn, mods);
+
+    if (result == LDAP_TYPE_OR_VALUE_EXISTS || result == LDAP_NO_SUCH_ATTRIBUTE) {
+        char *vals[2] = {NULL, NULL};
+
+        mods[0] = &del_mod;
+        mods[1] = NULL;
+        del_mod.mod_type = batch->grouping_attr;
+        del_mod.mod_values = vals;
+        result = LDAP_SUCCESS;
+        for (i = 0; i < apply.ndels + apply.nadds && result == LDAP_SUCCESS; i++) {
+            if (i < apply.ndels) {
+                del_mod.mod_op = LDAP_MOD_DELETE;
+                vals[0] = apply.dels[i];
+            } else {
+                del_mod.mod_op = LDAP_MOD_ADD;
+                vals[0] = apply.adds[i - apply.ndels];
+            }
+            result = automember_rebuild_modify(batch->group_dn, mods);
+            if (result == LDAP_TYPE_OR_VALUE_EXISTS || result == LDAP_NO_SUCH_ATTRIBUTE) {
+                result = LDAP_SUCCESS;
+            }
+        }
+    }
+    if (result != LDAP_SUCCESS) {
+        slapi_log_err(SLAPI_LOG_ERR, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                      "automember_rebuild_apply - Unable to update the \"%s\" values "
+                      "of group \"%s\" (%s).\n",
+                      batch->grouping_attr, batch->group_dn, ldap_err2string(result));
+        rc = result;
+    }
+
+done:
+    slapi_ch_free((void **)&apply.adds);
+    slapi_ch_free((void **)&apply.dels);
+
+    return rc;
+}
+
+static void
+automember_rebuild_worker_thread(void *arg)
+{
+    rebuild_worker *worker = (rebuild_worker *)arg;
+    rebuild_run *run = worker->run;
+    rebuild_batch *batch;
+    int rc;
+
+    /* The modifies are done on behalf of the task requestor */
+    slapi_td_set_dn(slapi_ch_strdup(run->td->bind_dn));
+
+    PR_Lock(run->lock);
+    while (1) {
+        if (run->rc == 0 && slapi_atomic_load_64(&abort_rebuild_task, __ATOMIC_ACQUIRE) == 1) {
+            run->rc = -1;
+            PR_NotifyAllCondVar(run->cv);
+        }
+        if ((batch = worker->head) == NULL) {
+            if (!run->searching) {
+                break;
+            }
+            PR_WaitCondVar(run->cv, PR_SecondsToInterval(1));
+            continue;
+        }
+        worker->head = batch->next;
+        if (worker->head == NULL) {
+            worker->tail = NULL;
+        }
+        rc = run->rc;
+        PR_Unlock(run->lock);
+
+        /* After a failure the remaining batches are only discarded */
+        if (rc == 0) {
+            rc = slapi_is_shutting_down() ? -1 : automember_rebuild_apply(batch);
+        } else {
+            rc = 0;
+        }
+        automember_rebuild_batch_free(&batch);
+
+        PR_Lock(run->lock);
+        run->queued--;
+        if (rc && run->rc == 0) {
+            run->rc = rc;
+        }
+        PR_NotifyAllCondVar(run->cv);
+    }
+    PR_Unlock(run->lock);
+}
+
 /*
  *  automember_rebuild_task_thread()
  *
  *  Search using the basedn, filter, and scope provided from the task data.
  *  Then loop of each entry, and apply the membership if applicable.
+ *
+ *  The membership changes are collected per group, and applied by the
+ *  worker threads with one modify of the group per batch of members.
  */
 void
 automember_rebuild_task_thread(void *arg)
@@ -2370,8 +2929,9 @@ automember_rebuild_task_thread(void *arg)
     Slapi_PBlock *search_pb = NULL;
     Slapi_Entry **entries = NULL;
     task_data *td = NULL;
+    rebuild_run run = {0};
     PRCList *list = NULL;
-    PRCList *include_list = NULL;
+    int32_t started = 0;
     int result = 0;
     size_t i = 0;
 
@@ -2389,14 +2949,44 @@ automember_rebuild_task_thread(void *arg)
      */
     td = (task_data *)slapi_task_get_data(task);
     slapi_task_begin(task, 1);
-    slapi_task_log_notice(task, "Automember rebuild task starting (base dn: (%s) filter (%s)...",
-                          slapi_sdn_get_dn(td->base_dn), td->filter_str);
-    slapi_task_log_status(task, "Automember rebuild task starting (base dn: (%s) filter (%s)...",
-                          slapi_sdn_get_dn(td->base_dn), td->filter_str);
+    slapi_task_log_notice(task, "Automember rebuild task starting (base dn: (%s) filter (%s) threads (%d) batch size (%d)...",
+                          slapi_sdn_get_dn(td->base_dn), td->filter_str, td->threads, td->batch_size);
+    slapi_task_log_status(task, "Automember rebuild task starting (base dn: (%s) filter (%s) threads (%d) batch size (%d)...",
+                          slapi_sdn_get_dn(td->base_dn), td->filter_str, td->threads, td->batch_size);
     /*
      *  Set the bind dn in the local thread data
      */
     slapi_td_set_dn(slapi_ch_strdup(td->bind_dn));
+
+    /*
+     *  Start the workers applying the membership changes
+     */
+    run.task = task;
+    run.td = td;
+    run.searching = 1;
+    run.nworkers = td->threads;
+    run.batches = PL_NewHashTable(0, PL_HashString, PL_CompareStrings, PL_CompareValues, NULL, NULL);
+    run.workers = (rebuild_worker *)slapi_ch_calloc(run.nworkers, sizeof(rebuild_worker));
+    if ((run.lock = PR_NewLock()) == NULL || (run.cv = PR_NewCondVar(run.lock)) == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                      "automember_rebuild_task_thread - Failed to create the task lock\n");
+        result = -1;
+        goto done;
+    }
+    for (started = 0; started < run.nworkers; started++) {
+        run.workers[started].run = &run;
+        run.workers[started].thread = PR_CreateThread(PR_USER_THREAD, automember_rebuild_worker_thread,
+                                                      (void *)&run.workers[started], PR_PRIORITY_NORMAL,
+                                                      PR_GLOBAL_THREAD, PR_JOINABLE_THREAD,
+                                                      SLAPD_DEFAULT_THREAD_STACKSIZE);
+        if (run.workers[started].thread == NULL) {
+            slapi_log_err(SLAPI_LOG_ERR, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                          "automember_rebuild_task_thread - Unable to create the task threads\n");
+            result = -1;
+            goto stop;
+        }
+    }
+
     /*
      *  Take the config lock now and search the database
      */
@@ -2428,14 +3018,19 @@ automember_rebuild_task_thread(void *arg)
      */
     for (i = 0; entries && (entries[i] != NULL); i++) {
         if (slapi_atomic_load_64(&abort_rebuild_task, __ATOMIC_ACQUIRE) == 1) {
-            /* The task was aborted */
-            slapi_task_log_notice(task, "Automember rebuild task was intentionally aborted");
-            slapi_task_log_status(task, "Automember rebuild task was intentionally aborted");
-            slapi_log_err(SLAPI_LOG_NOTICE, AUTOMEMBER_PLUGIN_SUBSYSTEM,
-                          "automember_rebuild_task_thread - task was intentionally aborted\n");
             result = -1;
             goto out;
         }
+        PR_Lock(run.lock);
+        result = run.rc;
+        PR_Unlock(run.lock);
+        if (result) {
+            goto out;
+        }
+        if (slapi_is_shutting_down()) {
+            result = SLAPI_PLUGIN_FAILURE;
+            goto out;
+        }
         if (!PR_CLIST_IS_EMPTY(g_automember_config)) {
             list = PR_LIST_HEAD(g_automember_config);
             while (list != g_automember_config) {
@@ -2444,66 +3039,107 @@ automember_rebuild_task_thread(void *arg)
                 if (slapi_dn_issuffix(slapi_entry_get_dn(entries[i]), config->scope) &&
                     (slapi_filter_test_simple(entries[i], config->filter) == 0))
                 {
+                    const char *member_value = automember_get_member_value(entries[i], config->grouping_value);
+                    PRCList exclusions;
+                    PRCList targets;
+                    size_t ii;
+
+                    if (member_value == NULL) {
+                        slapi_log_err(SLAPI_LOG_ERR, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                                      "automember_rebuild_task_thread - Unable to find grouping "
+                                      "value attribute \"%s\" in entry \"%s\".\n",
+                                      config->grouping_value, slapi_entry_get_dn(entries[i]));
+                        list = PR_NEXT_LINK(list);
+                        continue;
+                    }
+
                     /* First clear out all the defaults groups */
-                    for (size_t ii = 0; config->default_groups && config->default_groups[ii]; ii++) {
-                        if ((result = automember_update_member_value(entries[i], config->default_groups[ii],
-                                config->grouping_attr, config->grouping_value, NULL, DEL_MEMBER)))
-                        {
-                            slapi_task_log_notice(task, "Automember rebuild membership task unable to delete "
-                                                        "member from default group (%s) error (%d)",
-                                                        config->default_groups[ii], result);
-                            slapi_task_log_status(task, "Automember rebuild membership task unable to delete "
-                                                        "member from default group (%s) error (%d)",
-                                                        config->default_groups[ii], result);
-                            slapi_log_err(SLAPI_LOG_ERR, AUTOMEMBER_PLUGIN_SUBSYSTEM,
-                                          "automember_rebuild_task_thread - Unable to unable to delete from (%s) error (%d)\n",
-                                          config->default_groups[ii], result);
-                            goto out;
-                        }
+                    for (ii = 0; config->default_groups && config->default_groups[ii]; ii++) {
+                        automember_rebuild_record(&run, config->default_groups[ii], config->grouping_attr,
+                                                  member_value, DEL_MEMBER);
                     }
 
                     /* Then clear out the non-default group */
-                    if (config->inclusive_rules && !PR_CLIST_IS_EMPTY((PRCList *)config->inclusive_rules)) {
-                        include_list = PR_LIST_HEAD((PRCList *)config->inclusive_rules);
-                        while (include_list != (PRCList *)config->inclusive_rules) {
-                            struct automemberRegexRule *curr_rule = (struct automemberRegexRule *)include_list;
-                            if ((result = automember_update_member_value(entries[i], slapi_sdn_get_dn(curr_rule->target_group_dn),
-                                    config->grouping_attr, config->grouping_value, NULL, DEL_MEMBER)))
-                            {
-                                slapi_task_log_notice(task, "Automember rebuild membership task unable to delete "
-                                                            "member from group (%s) error (%d)",
-                                                            slapi_sdn_get_dn(curr_rule->target_group_dn), result);
-                                slapi_task_log_status(task, "Automember rebuild membership task unable to delete "
-                                                            "member from group (%s) error (%d)",
-                                                            slapi_sdn_get_dn(curr_rule->target_group_dn), result);
-                                slapi_log_err(SLAPI_LOG_ERR, AUTOMEMBER_PLUGIN_SUBSYSTEM,
-                                              "automember_rebuild_task_thread - Unable to unable to delete from (%s) error (%d)\n",
-                                              slapi_sdn_get_dn(curr_rule->target_group_dn), result);
-                                goto out;
-                            }
-                            include_list = PR_NEXT_LINK(include_list);
+                    for (ii = 0; config->matcher && ii < config->matcher->ntargets; ii++) {
+                        if (config->matcher->has_inclusive[ii]) {
+                            automember_rebuild_record(&run, slapi_sdn_get_dn(config->matcher->targets[ii]),
+                                                      config->grouping_attr, member_value, DEL_MEMBER);
                         }
                     }
 
                     /* Update the memberships for this entries */
-                    if (slapi_is_shutting_down() ||
-                        automember_update_membership(config, entries[i], NULL) == SLAPI_PLUGIN_FAILURE)
-                    {
-                        result = SLAPI_PLUGIN_FAILURE;
-                        goto out;
+                    automember_get_membership_lists(config, &exclusions, &targets, entries[i]);
+                    if (PR_CLIST_IS_EMPTY(&targets)) {
+                        for (ii = 0; config->default_groups && config->default_groups[ii]; ii++) {
+                            automember_rebuild_record(&run, config->default_groups[ii], config->grouping_attr,
+                                                      member_value, ADD_MEMBER);
+                        }
+                    } else {
+                        struct automemberDNListItem *dnitem = (struct automemberDNListItem *)PR_LIST_HEAD(&targets);
+                        while ((PRCList *)dnitem != &targets) {
+                            automember_rebuild_record(&run, slapi_sdn_get_dn(dnitem->dn), config->grouping_attr,
+                                                      member_value, ADD_MEMBER);
+                            dnitem = (struct automemberDNListItem *)PR_NEXT_LINK((PRCList *)dnitem);
+                        }
                     }
+                    automember_free_membership_lists(&exclusions, &targets);
                 }
                 list = PR_NEXT_LINK(list);
             }
         }
     }
 
+    /* Hand the partial batches to the workers */
+    PL_HashTableEnumerateEntries(run.batches, automember_rebuild_queue_batch, &run);
+
 out:
     automember_config_unlock();
 
     slapi_free_search_results_internal(search_pb);
     slapi_pblock_destroy(search_pb);
 
+stop:
+    /* Wait for the workers to apply or discard the queued batches */
+    PR_Lock(run.lock);
+    if (result && run.rc == 0) {
+        run.rc = result;
+    }
+    run.searching = 0;
+    PR_NotifyAllCondVar(run.cv);
+    PR_Unlock(run.lock);
+    for (int32_t w = 0; w < started; w++) {
+        PR_JoinThread(run.workers[w].thread);
+    }
+    result = run.rc;
+
+done:
+    if (result == -1 && slapi_atomic_load_64(&abort_rebuild_task, __ATOMIC_ACQUIRE) == 1) {
+        /* The task was aborted */
+        slapi_task_log_notice(task, "Automember rebuild task was intentionally aborted");
+        slapi_task_log_status(task, "Automember rebuild task was intentionally aborted");
+        slapi_log_err(SLAPI_LOG_NOTICE, AUTOMEMBER_PLUGIN_SUBSYSTEM,
+                      "automember_rebuild_task_thread - task was intentionally aborted\n");
+    }
+    if (run.batches) {
+        /* Batches left over after a failure */
+        PL_HashTableEnumerateEntries(run.batches, automember_rebuild_drop_batch, NULL);
+        PL_HashTableDestroy(run.batches);
+    }
+    for (int32_t w = 0; w < run.nworkers; w++) {
+        while (run.workers[w].head) {
+            rebuild_batch *batch = run.workers[w].head;
+            run.workers[w].head = batch->next;
+            automember_rebuild_batch_free(&batch);
+        }
+    }
+    slapi_ch_free((void **)&run.workers);
+    if (run.cv) {
+        PR_DestroyCondVar(run.cv);
+    }
+    if (run.lock) {
+        PR_DestroyLock(run.lock);
+    }
+
     if (result) {
         /* error */
         slapi_task_log_notice(task, "Automember rebuild task aborted.  Error (%d)", result);
@@ -22,6 +22,7 @@
 #include "slapi-plugin.h"
 #include "slapi-private.h"
 #include "prclist.h"
+#include "plhash.h"
 #include "ldif.h"
 
 /*
@@ -60,6 +61,13 @@
 #define ADD_MEMBER 1
 #define DEL_MEMBER 0
 
+/*
+ * Rebuild task defaults and limits
+ */
+#define AUTOMEMBER_REBUILD_THREADS_MAX 64
+#define AUTOMEMBER_REBUILD_BATCH_SIZE 1000
+#define AUTOMEMBER_REBUILD_BATCH_MAX 100000
+
 
 struct automemberRegexRule
 {
@@ -68,6 +76,38 @@ struct automemberRegexRule
     char *attr;
     char *regex_str;
     Slapi_Regex *regex;
+    char *literal;      /* literal text any matching value contains */
+    size_t literal_len;
+    int anchored;       /* the literal starts the value */
+    int exact;          /* the literal is the whole regex */
+    size_t target;      /* index of the target group in the matcher */
+};
+
+/*
+ * Rules of a definition comparing the same attribute.
+ */
+struct automemberAttrRules
+{
+    char *attr;
+    size_t nrules;
+    struct automemberRegexRule **rules;
+};
+
+/*
+ * The regex rules of a definition compiled for evaluation.  Rules are
+ * grouped by comparison attribute, so each attribute of a candidate
+ * entry is looked up once, and the target groups are numbered in DN
+ * order so the matches are tracked in flag arrays.
+ */
+struct automemberMatcher
+{
+    size_t ntargets;
+    Slapi_DN **targets;   /* referenced from the rules */
+    char *has_inclusive;  /* targets of at least one inclusive rule */
+    size_t nexclusive;
+    struct automemberAttrRules *exclusive;
+    size_t ninclusive;
+    struct automemberAttrRules *inclusive;
 };
 
 struct automemberDNListItem
@@ -90,6 +130,7 @@ struct configEntry
     char **default_groups;
     char *grouping_attr;
     char *grouping_value;
+    struct automemberMatcher *matcher;
 };
 
 /*
@@ -191,13 +191,15 @@ bailout:
     It is called after cos_init.
 */
 int
-cos_start(Slapi_PBlock *pb __attribute__((unused)))
+cos_start(Slapi_PBlock *pb)
 {
     int ret = 0;
+    Slapi_DN *plugin_sdn = NULL;
 
     slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "--> cos_start\n");
 
-    if (!cos_cache_init()) {
+    slapi_pblock_get(pb, SLAPI_TARGET_SDN, &plugin_sdn);
+    if (!cos_cache_init(slapi_sdn_get_dn(plugin_sdn))) {
         slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM, "cos_start - Ready for service\n");
     } else {
 
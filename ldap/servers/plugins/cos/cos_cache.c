@@ -54,6 +54,7 @@
 #include "prerror.h"
 #include "prcvar.h"
 #include "prio.h"
+#include "plhash.h"
 #include "vattr_spi.h"
 
 #include "cos_cache.h"
@@ -109,9 +110,34 @@ void *cos_get_plugin_identity(void);
 #define COSTYPE_INDIRECT 3
 #define COS_DEF_ERROR_NO_TEMPLATES -2
 
-/* both variables are protected by change_lock */
+/* kinds of change to cos significant entries */
+#define COS_CHANGE_DEFINITION 0x1
+#define COS_CHANGE_TEMPLATE 0x2
+#define COS_CHANGE_UNKNOWN 0x4
+
+/* past this many pending changes the cache is rebuilt from scratch */
+#define COS_CHANGES_MAX 1024
+
+/*
+    cosChange: a change to a definition or a template entry
+    waiting to be patched into the next cache generation.
+    newdn is only set by modrdn.
+*/
+struct _cosChange
+{
+    struct _cosChange *pNext;
+    int kind;
+    char *dn;
+    char *newdn;
+};
+typedef struct _cosChange cosChange;
+
+/* all these variables are protected by change_lock */
 static int cos_cache_notify_flag = 0;
 static PRBool cos_cache_at_work = PR_FALSE;
+static cosChange *cos_cache_changes = NULL;
+static int cos_cache_change_count = 0;
+static int cos_cache_full_rebuild = 0;
 
 /* service definition cache structs */
 
@@ -183,6 +209,19 @@ struct _cosDefinition
 };
 typedef struct _cosDefinition cosDefinitions;
 
+/*
+    cosResolved: the template a classic definition resolves
+    to for one specifier value.  Keyed by definition, attribute
+    and specifier value, built with the cache and read only
+    afterwards so no locking is needed.
+*/
+struct _cosResolved
+{
+    int attr_index;          /* first matching attribute in ppAttrIndex */
+    Slapi_ValueSet *pValues; /* the values of that attribute */
+};
+typedef struct _cosResolved cosResolved;
+
 struct _cos_cache
 {
     cosDefinitions *pDefs;
@@ -192,15 +231,42 @@ struct _cos_cache
     int templateCount;
     int refCount;
     int vattr_cacheable;
+    PLHashTable *pResolved;
+    int resolvedCount;
 };
 typedef struct _cos_cache cosCache;
 
+/*
+    cosQueryDef: a classic definition as seen by the entry
+    being queried, so the target trees and the specifier are
+    only evaluated once per query instead of once per template.
+*/
+#define COS_QUERY_DEFS 16
+
+struct _cosQueryDef
+{
+    cosDefinitions *pDef;
+    int in_scope;       /* the entry is below one of the target trees */
+    int resolved_index; /* attribute the specifier resolves to, -1 if none */
+    cosResolved *pResolved;
+};
+typedef struct _cosQueryDef cosQueryDef;
+
 /* cache manipulation function prototypes*/
 static cosCache *pCache; /* always the current global cache, only use getref to get */
 
 /* the place to start if you want a new cache */
 static int cos_cache_create_unlock(void);
 static int cos_cache_creation_lock(void);
+static void cos_cache_swap(cosCache *pNewCache);
+
+/* patching the current cache into a new generation */
+static int cos_cache_update_lock(cosChange *pChanges);
+static int cos_cache_update_unlock(cosChange *pChanges);
+static int cos_cache_apply_change(cosDefinitions **pDefs, const char *dn, int kind);
+static void cos_cache_del_changes(cosChange **pChanges);
+static cosDefinitions *cos_cache_dup_defs(cosDefinitions *pDefs);
+static void cos_cache_del_defn(cosDefinitions *pDef);
 
 /* cache index related functions */
 static int cos_cache_index_all(cosCache *pCache);
@@ -228,13 +294,14 @@ static int cos_cache_cmp_attr(cosAttributes *pAttr, Slapi_Value *test_this, int
 
 /* cosTemplates manipulation */
 static int cos_cache_add_dn_tmpls(char *dn, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls);
+static int cos_cache_search_tmpls(const char *dn, int scope, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls);
 static int cos_cache_add_tmpl(cosTemplates **pTemplates, cosAttrValue *dn, cosAttrValue *objclasses, cosAttrValue *pCosSpecifier, cosAttributes *pAttrs, cosAttrValue *cosPriority);
 
 /* cosDefinitions manipulation */
 static int cos_cache_build_definition_list(cosDefinitions **pDefs, int *vattr_cacheable);
-static int cos_cache_add_dn_defs(char *dn, cosDefinitions **pDefs);
+static int cos_cache_add_dn_defs(char *dn, int scope, cosDefinitions **pDefs);
 static int cos_cache_add_defn(cosDefinitions **pDefs, cosAttrValue **dn, int cosType, cosAttrValue **tree, cosAttrValue **tmpDn, cosAttrValue **spec, cosAttrValue **pAttrs, cosAttrValue **pOverrides, cosAttrValue **pOperational, cosAttrValue **pCosMerge, cosAttrValue **pCosOpDefault);
-static int cos_cache_entry_is_cos_related(Slapi_Entry *e);
+static int cos_cache_entry_cos_kind(Slapi_Entry *e);
 
 /* schema checking */
 static int cos_cache_schema_check(cosCache *pCache, int cache_attr_index, Slapi_Attr *pObjclasses);
@@ -244,6 +311,13 @@ static void cos_cache_del_schema(cosCache *pCache);
 /* special cos scheme implimentations (special = other than cos classic) */
 static int cos_cache_follow_pointer(vattr_context *context, const char *dn, char *type, Slapi_ValueSet **out_vs, Slapi_Value *test_this, int *result, int flags);
 
+/* classic resolution memo */
+static char *cos_cache_resolved_key(cosDefinitions *pDef, const char *type, const char *grade);
+static int cos_cache_resolved_build(cosCache *pCache);
+static void cos_cache_resolved_free(cosCache *pCache);
+static cosQueryDef *cos_cache_query_def(cosCache *pCache, cosQueryDef *pQueryDefs, int *queryDefCount, cosDefinitions *pDef, vattr_context *context, Slapi_Entry *e, const char *pDn, const char *type);
+static int cos_cache_stats_search(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *entryAfter, int *returncode, char *returntext, void *arg);
+
 
 /* this dude is the thread function which performs dynamic config of the cache */
 static void cos_cache_wait_on_change(void *arg);
@@ -277,15 +351,23 @@ static Slapi_CondVar *something_changed = NULL;
 static Slapi_CondVar *start_cond = NULL;
 static vattr_sp_handle *vattr_handle = NULL;
 
+/* resolution statistics, published on the plugin entry */
+static char *stats_dn = NULL;
+static Slapi_Counter *resolve_hits = NULL;
+static Slapi_Counter *resolve_misses = NULL;
+static Slapi_Counter *cache_rebuilds = NULL;
+static Slapi_Counter *cache_updates = NULL;
+
 /*
     cos_cache_init
     --------------
     starts up the thread which waits for changes and
     fires off the cache re-creation when one is detected
-    also registers vattr callbacks
+    also registers vattr callbacks and the statistics
+    callback on the plugin entry
 */
 int
-cos_cache_init(void)
+cos_cache_init(const char *plugin_dn)
 {
     int ret = 0;
 
@@ -300,6 +382,12 @@ cos_cache_init(void)
     start_lock = slapi_new_mutex();
     start_cond = slapi_new_condvar(start_lock);
     started = 0;
+    if (resolve_hits == NULL) {
+        resolve_hits = slapi_counter_new();
+        resolve_misses = slapi_counter_new();
+        cache_rebuilds = slapi_counter_new();
+        cache_updates = slapi_counter_new();
+    }
 
     if (stop_lock == NULL ||
         change_lock == NULL ||
@@ -352,6 +440,11 @@ cos_cache_init(void)
         slapi_unlock_mutex(start_lock);
     }
 
+    if (plugin_dn) {
+        stats_dn = slapi_ch_strdup(plugin_dn);
+        slapi_config_register_callback(SLAPI_OPERATION_SEARCH, DSE_FLAG_PREOP, stats_dn,
+                                       LDAP_SCOPE_BASE, "(objectclass=*)", cos_cache_stats_search, NULL);
+    }
 
 out:
     slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "<-- cos_cache_init\n");
@@ -416,9 +509,20 @@ cos_cache_wait_on_change(void *arg __attribute__((unused)))
          * before we go running off doing lots of stuff lets check if we should stop
         */
         if (keeprunning) {
-            cos_cache_creation_lock();
+            cosChange *pChanges = cos_cache_changes;
+            int full_rebuild = cos_cache_full_rebuild || pChanges == NULL;
+
+            cos_cache_changes = NULL;
+            cos_cache_change_count = 0;
+            cos_cache_full_rebuild = 0;
+
+            if (full_rebuild || cos_cache_update_lock(pChanges)) {
+                cos_cache_creation_lock();
+            }
+            cos_cache_del_changes(&pChanges);
         }
-        cos_cache_notify_flag = 0; /* Dealt with it */
+        /* Dealt with it, unless more changes came in meanwhile */
+        cos_cache_notify_flag = (cos_cache_changes != NULL || cos_cache_full_rebuild);
     }                              /* while */
 
     /* shut down the cache */
@@ -454,6 +558,8 @@ cos_cache_create_unlock(void)
         pNewCache->pDefs = 0;
         pNewCache->refCount = 1;        /* 1 is for us */
         pNewCache->vattr_cacheable = 0; /* default is not cacheable */
+        pNewCache->pResolved = NULL;
+        pNewCache->resolvedCount = 0;
 
         ret = cos_cache_build_definition_list(&(pNewCache->pDefs), &(pNewCache->vattr_cacheable));
         if (!ret) {
@@ -467,35 +573,12 @@ cos_cache_create_unlock(void)
                 ret = cos_cache_schema_build(pNewCache);
                 if (ret == 0) {
                     /* now to swap the new cache for the old cache */
-                    cosCache *pOldCache;
-
-                    slapi_lock_mutex(cache_lock);
-
-                    /* turn off caching until the old cache is done */
-                    if (pCache) {
-                        slapi_vattrcache_cache_none();
-
-                        /*
-                         * be sure not to uncache other stuff
-                         * like roles if there is no change in
-                         * state
-                         */
-                        if (pCache->vattr_cacheable)
-                            slapi_entrycache_vattrcache_watermark_invalidate();
-                    } else {
-                        if (pNewCache && pNewCache->vattr_cacheable) {
-                            slapi_vattrcache_cache_all();
-                        }
-                    }
-
-                    pOldCache = pCache;
-                    pCache = pNewCache;
-
-                    slapi_unlock_mutex(cache_lock);
-
-                    if (pOldCache)
-                        cos_cache_release(pOldCache);
+                    cos_cache_swap(pNewCache);
 
+                    slapi_counter_increment(cache_rebuilds);
+                    slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM,
+                                  "cos_cache_create_unlock - Cache rebuilt, %d specifier values resolved\n",
+                                  pNewCache->resolvedCount);
                     cache_built = 1;
                 } else {
                     /* we should not go on without proper schema checking */
@@ -550,6 +633,418 @@ cos_cache_create_unlock(void)
     return ret;
 }
 
+/*
+    cos_cache_swap
+    --------------
+    makes a fully built and indexed cache the current one,
+    releasing the reference of the module to the old one
+*/
+static void
+cos_cache_swap(cosCache *pNewCache)
+{
+    cosCache *pOldCache;
+
+    /* without the memo queries fall back to walking the templates */
+    if (cos_cache_resolved_build(pNewCache)) {
+        slapi_log_err(SLAPI_LOG_ERR, COS_PLUGIN_SUBSYSTEM,
+                      "cos_cache_swap - Failed to build the specifier resolution cache\n");
+        cos_cache_resolved_free(pNewCache);
+    }
+
+    slapi_lock_mutex(cache_lock);
+
+    /* turn off caching until the old cache is done */
+    if (pCache) {
+        slapi_vattrcache_cache_none();
+
+        /*
+         * be sure not to uncache other stuff
+         * like roles if there is no change in
+         * state
+         */
+        if (pCache->vattr_cacheable)
+            slapi_entrycache_vattrcache_watermark_invalidate();
+    } else {
+        if (pNewCache && pNewCache->vattr_cacheable) {
+            slapi_vattrcache_cache_all();
+        }
+    }
+
+    pOldCache = pCache;
+    pCache = pNewCache;
+
+    slapi_unlock_mutex(cache_lock);
+
+    if (pOldCache)
+        cos_cache_release(pOldCache);
+}
+
+/*
+    cos_cache_update_unlock
+    -----------------------
+    Builds the next cache generation from the current one,
+    re-reading only the definitions and templates named by
+    the pending changes.  Everything else is copied from
+    memory, readers keep using the current generation until
+    the swap.
+
+    returns non-zero when the changes cannot be patched in
+    and the cache must be rebuilt from the DIT instead.
+
+        called while change_lock is NOT held
+*/
+static int
+cos_cache_update_unlock(cosChange *pChanges)
+{
+    cosCache *pNewCache;
+    cosCache *pOldCache;
+    cosChange *pChange;
+    int vattr_cacheable;
+    int ret = 0;
+
+    slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "--> cos_cache_update_unlock\n");
+
+    slapi_lock_mutex(cache_lock);
+    pOldCache = pCache;
+    if (pOldCache)
+        pOldCache->refCount++;
+    slapi_unlock_mutex(cache_lock);
+
+    if (pOldCache == NULL) {
+        slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "<-- cos_cache_update_unlock\n");
+        return -1;
+    }
+
+    pNewCache = (cosCache *)slapi_ch_calloc(1, sizeof(cosCache));
+    pNewCache->refCount = 1; /* 1 is for us */
+    pNewCache->pDefs = cos_cache_dup_defs(pOldCache->pDefs);
+    vattr_cacheable = pOldCache->vattr_cacheable;
+    cos_cache_release(pOldCache);
+
+    for (pChange = pChanges; pChange && ret == 0; pChange = pChange->pNext) {
+        ret = cos_cache_apply_change(&pNewCache->pDefs, pChange->dn, pChange->kind);
+        if (ret == 0 && pChange->newdn) {
+            ret = cos_cache_apply_change(&pNewCache->pDefs, pChange->newdn, pChange->kind);
+        }
+    }
+
+    /* no definition left, let the full rebuild disable cos */
+    if (ret == 0 && pNewCache->pDefs == NULL) {
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        pNewCache->vattr_cacheable = vattr_cacheable;
+        if (cos_cache_index_all(pNewCache) || cos_cache_schema_build(pNewCache)) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        cos_cache_swap(pNewCache);
+        slapi_counter_increment(cache_updates);
+        slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM,
+                      "cos_cache_update_unlock - Cache updated, %d specifier values resolved\n",
+                      pNewCache->resolvedCount);
+    } else {
+        cos_cache_release(pNewCache);
+        slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM,
+                      "cos_cache_update_unlock - Changes cannot be applied, rebuilding the cache\n");
+    }
+
+    slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "<-- cos_cache_update_unlock\n");
+    return ret;
+}
+
+/*
+    cos_cache_update_lock
+    ---------------------
+    same locking dance as cos_cache_creation_lock, for patching
+    the cache with the pending changes
+*/
+static int
+cos_cache_update_lock(cosChange *pChanges)
+{
+    int ret = -1;
+
+    if (cos_cache_at_work) {
+        /* let the full rebuild wait for the other builder */
+        return ret;
+    }
+    cos_cache_at_work = PR_TRUE;
+    slapi_unlock_mutex(change_lock);
+    ret = cos_cache_update_unlock(pChanges);
+    slapi_lock_mutex(change_lock);
+    cos_cache_at_work = PR_FALSE;
+
+    return ret;
+}
+
+/*
+    cos_cache_dn_is
+    ---------------
+    dn comparison regardless of case and spacing
+*/
+static int
+cos_cache_dn_is(const char *dn1, const char *dn2)
+{
+    Slapi_DN *sdn1 = slapi_sdn_new_dn_byref(dn1);
+    Slapi_DN *sdn2 = slapi_sdn_new_dn_byref(dn2);
+    int ret = (slapi_sdn_compare(sdn1, sdn2) == 0);
+
+    slapi_sdn_free(&sdn1);
+    slapi_sdn_free(&sdn2);
+
+    return ret;
+}
+
+/*
+    cos_cache_tmpl_belongs
+    ----------------------
+    returns 1 if an entry at dn would be a template of the
+    definition: a child of a cosTemplateDn for classic schemes,
+    the cosTemplateDn itself for pointer schemes
+*/
+static int
+cos_cache_tmpl_belongs(cosDefinitions *pDef, const char *dn)
+{
+    Slapi_DN *sdn;
+    cosAttrValue *pTmplDn;
+    int ret = 0;
+
+    if (pDef->cosType == COSTYPE_INDIRECT)
+        return 0;
+
+    sdn = slapi_sdn_new_dn_byref(dn);
+    for (pTmplDn = pDef->pCosTemplateDn; pTmplDn && !ret; pTmplDn = pTmplDn->list.pNext) {
+        Slapi_DN *tmpl_sdn = slapi_sdn_new_dn_byref(pTmplDn->val);
+
+        if (pDef->cosType == COSTYPE_CLASSIC)
+            ret = slapi_sdn_isparent(tmpl_sdn, sdn);
+        else
+            ret = (slapi_sdn_compare(tmpl_sdn, sdn) == 0);
+        slapi_sdn_free(&tmpl_sdn);
+    }
+    slapi_sdn_free(&sdn);
+
+    return ret;
+}
+
+/*
+    cos_cache_apply_change
+    ----------------------
+    patches one changed entry into the definition list: the
+    cached copy is dropped and the entry, if it still exists at
+    dn, is read back from the DIT.
+
+    returns non-zero when the change needs a full rebuild
+*/
+static int
+cos_cache_apply_change(cosDefinitions **pDefs, const char *dn, int kind)
+{
+    cosDefinitions **ppDef;
+    int found = 0;
+
+    if (kind == COS_CHANGE_DEFINITION) {
+        ppDef = pDefs;
+        while (*ppDef) {
+            cosDefinitions *pDef = *ppDef;
+
+            if (cos_cache_dn_is(pDef->pDn->val, dn)) {
+                *ppDef = pDef->list.pNext;
+                cos_cache_del_defn(pDef);
+            } else {
+                ppDef = (cosDefinitions **)&(pDef->list.pNext);
+            }
+        }
+        /* reads the definition and all its templates */
+        cos_cache_add_dn_defs((char *)dn, LDAP_SCOPE_BASE, pDefs);
+        return 0;
+    }
+
+    if (kind != COS_CHANGE_TEMPLATE)
+        return -1;
+
+    ppDef = pDefs;
+    while (*ppDef) {
+        cosDefinitions *pDef = *ppDef;
+        cosTemplates **ppTmpl = &(pDef->pCosTmps);
+
+        if (!cos_cache_tmpl_belongs(pDef, dn)) {
+            ppDef = (cosDefinitions **)&(pDef->list.pNext);
+            continue;
+        }
+        found = 1;
+
+        while (*ppTmpl) {
+            cosTemplates *pTmpl = *ppTmpl;
+
+            if (cos_cache_dn_is(pTmpl->pDn->val, dn)) {
+                *ppTmpl = pTmpl->list.pNext;
+                cos_cache_del_attr_list(&(pTmpl->pAttrs));
+                cos_cache_del_attrval_list(&(pTmpl->pObjectclasses));
+                cos_cache_del_attrval_list(&(pTmpl->pDn));
+                slapi_ch_free((void **)&(pTmpl->cosGrade));
+                slapi_ch_free((void **)&pTmpl);
+            } else {
+                ppTmpl = (cosTemplates **)&(pTmpl->list.pNext);
+            }
+        }
+        cos_cache_search_tmpls(dn, LDAP_SCOPE_BASE, pDef->pCosSpecifier, pDef->pCosAttrs, &(pDef->pCosTmps));
+
+        if (pDef->pCosTmps == NULL) {
+            /* like a full rebuild, a definition without templates is skipped */
+            slapi_log_err(SLAPI_LOG_ERR, COS_PLUGIN_SUBSYSTEM, "cos_cache_apply_change - "
+                                                               "Skipping CoS Definition %s--no CoS Templates left.\n",
+                          pDef->pDn->val);
+            *ppDef = pDef->list.pNext;
+            cos_cache_del_defn(pDef);
+        } else {
+            ppDef = (cosDefinitions **)&(pDef->list.pNext);
+        }
+    }
+
+    /*
+     * A template nobody uses may be the first one of a definition
+     * that was skipped for having none, only a rebuild can tell.
+     */
+    return found ? 0 : -1;
+}
+
+/*
+    cos_cache_del_changes
+    ---------------------
+    frees a list of pending changes
+*/
+static void
+cos_cache_del_changes(cosChange **pChanges)
+{
+    while (*pChanges) {
+        cosChange *pChange = *pChanges;
+
+        *pChanges = pChange->pNext;
+        slapi_ch_free_string(&pChange->dn);
+        slapi_ch_free_string(&pChange->newdn);
+        slapi_ch_free((void **)&pChange);
+    }
+}
+
+/*
+    cos_cache_dup_attrval_list
+    --------------------------
+    copies a value list, keeping the order
+*/
+static cosAttrValue *
+cos_cache_dup_attrval_list(cosAttrValue *pVal)
+{
+    cosAttrValue *pHead = NULL;
+    void **ppTail = (void **)&pHead;
+
+    for (; pVal; pVal = pVal->list.pNext) {
+        cosAttrValue *pNew = (cosAttrValue *)slapi_ch_calloc(1, sizeof(cosAttrValue));
+
+        pNew->val = slapi_ch_strdup(pVal->val);
+        *ppTail = pNew;
+        ppTail = &(pNew->list.pNext);
+    }
+
+    return pHead;
+}
+
+/*
+    cos_cache_dup_defs
+    ------------------
+    deep copy of the definitions, their templates and attributes.
+    Parent pointers, attribute flags and schema are set again
+    when the copy is indexed.
+*/
+static cosDefinitions *
+cos_cache_dup_defs(cosDefinitions *pDefs)
+{
+    cosDefinitions *pHead = NULL;
+    void **ppDefTail = (void **)&pHead;
+
+    for (; pDefs; pDefs = pDefs->list.pNext) {
+        cosDefinitions *pDef = (cosDefinitions *)slapi_ch_calloc(1, sizeof(cosDefinitions));
+        void **ppTmplTail = (void **)&(pDef->pCosTmps);
+        cosTemplates *pTmpl;
+
+        pDef->cosType = pDefs->cosType;
+        pDef->pDn = cos_cache_dup_attrval_list(pDefs->pDn);
+        pDef->pCosTargetTree = cos_cache_dup_attrval_list(pDefs->pCosTargetTree);
+        pDef->pCosTemplateDn = cos_cache_dup_attrval_list(pDefs->pCosTemplateDn);
+        pDef->pCosSpecifier = cos_cache_dup_attrval_list(pDefs->pCosSpecifier);
+        pDef->pCosAttrs = cos_cache_dup_attrval_list(pDefs->pCosAttrs);
+        pDef->pCosOverrides = cos_cache_dup_attrval_list(pDefs->pCosOverrides);
+        pDef->pCosOperational = cos_cache_dup_attrval_list(pDefs->pCosOperational);
+        pDef->pCosOpDefault = cos_cache_dup_attrval_list(pDefs->pCosOpDefault);
+        pDef->pCosMerge = cos_cache_dup_attrval_list(pDefs->pCosMerge);
+
+        for (pTmpl = pDefs->pCosTmps; pTmpl; pTmpl = pTmpl->list.pNext) {
+            cosTemplates *pNewTmpl = (cosTemplates *)slapi_ch_calloc(1, sizeof(cosTemplates));
+            void **ppAttrTail = (void **)&(pNewTmpl->pAttrs);
+            cosAttributes *pAttr;
+
+            pNewTmpl->pDn = cos_cache_dup_attrval_list(pTmpl->pDn);
+            pNewTmpl->pObjectclasses = cos_cache_dup_attrval_list(pTmpl->pObjectclasses);
+            pNewTmpl->cosGrade = slapi_ch_strdup(pTmpl->cosGrade);
+            pNewTmpl->template_default = pTmpl->template_default;
+            pNewTmpl->cosPriority = pTmpl->cosPriority;
+
+            for (pAttr = pTmpl->pAttrs; pAttr; pAttr = pAttr->list.pNext) {
+                cosAttributes *pNewAttr = (cosAttributes *)slapi_ch_calloc(1, sizeof(cosAttributes));
+
+                pNewAttr->pAttrName = slapi_ch_strdup(pAttr->pAttrName);
+                pNewAttr->pAttrValue = cos_cache_dup_attrval_list(pAttr->pAttrValue);
+                *ppAttrTail = pNewAttr;
+                ppAttrTail = &(pNewAttr->list.pNext);
+            }
+
+            *ppTmplTail = pNewTmpl;
+            ppTmplTail = &(pNewTmpl->list.pNext);
+        }
+
+        *ppDefTail = pDef;
+        ppDefTail = &(pDef->list.pNext);
+    }
+
+    return pHead;
+}
+
+/*
+    cos_cache_del_defn
+    ------------------
+    frees a definition and its templates
+*/
+static void
+cos_cache_del_defn(cosDefinitions *pDef)
+{
+    cosTemplates *pCosTmps = pDef->pCosTmps;
+
+    while (pCosTmps) {
+        cosTemplates *pTmpT = pCosTmps;
+
+        pCosTmps = pCosTmps->list.pNext;
+
+        cos_cache_del_attr_list(&(pTmpT->pAttrs));
+        cos_cache_del_attrval_list(&(pTmpT->pObjectclasses));
+        cos_cache_del_attrval_list(&(pTmpT->pDn));
+        slapi_ch_free((void **)&(pTmpT->cosGrade));
+        slapi_ch_free((void **)&pTmpT);
+    }
+
+    cos_cache_del_attrval_list(&(pDef->pDn));
+    cos_cache_del_attrval_list(&(pDef->pCosTargetTree));
+    cos_cache_del_attrval_list(&(pDef->pCosTemplateDn));
+    cos_cache_del_attrval_list(&(pDef->pCosSpecifier));
+    cos_cache_del_attrval_list(&(pDef->pCosAttrs));
+    cos_cache_del_attrval_list(&(pDef->pCosOverrides));
+    cos_cache_del_attrval_list(&(pDef->pCosOperational));
+    cos_cache_del_attrval_list(&(pDef->pCosMerge));
+    cos_cache_del_attrval_list(&(pDef->pCosOpDefault));
+    slapi_ch_free((void **)&pDef);
+}
+
 /* cos_cache_creation_lock is called with change_lock being hold:
  *    slapi_lock_mutex(change_lock)
  *
@@ -663,7 +1158,7 @@ cos_cache_build_definition_list(cosDefinitions **pDefs, int *vattr_cacheable)
                             while (suffixVals[valIndex]) {
                                 /* here's a suffix, lets search it... */
                                 if (suffixVals[valIndex]->bv_val) {
-                                    if (!cos_cache_add_dn_defs(suffixVals[valIndex]->bv_val, pDefs)) {
+                                    if (!cos_cache_add_dn_defs(suffixVals[valIndex]->bv_val, LDAP_SCOPE_SUBTREE, pDefs)) {
                                         *vattr_cacheable = -1;
                                         cos_def_available = 1;
                                     }
@@ -1026,7 +1521,7 @@ bail:
 /*
     cos_cache_add_dn_defs
     -------------------------
-    takes a dn as argument and searches the dn for cos definitions,
+    takes a dn and a scope as argument and searches the dn for cos definitions,
     adding any found to the definition list. Change to use search callback API.
 
     Returns: 0: found at least one definition entry that got added to the
@@ -1037,7 +1532,7 @@ bail:
 #define DN_DEF_FILTER "(&(|(objectclass=cosSuperDefinition)(objectclass=cosDefinition))(objectclass=ldapsubentry))"
 
 static int
-cos_cache_add_dn_defs(char *dn, cosDefinitions **pDefs)
+cos_cache_add_dn_defs(char *dn, int scope, cosDefinitions **pDefs)
 {
     Slapi_PBlock *pDnSearch = 0;
     struct dn_defs_info info = {NULL, 0, 0};
@@ -1045,7 +1540,7 @@ cos_cache_add_dn_defs(char *dn, cosDefinitions **pDefs)
     if (pDnSearch) {
         info.ret = -1; /* assume no good defs */
         info.pDefs = pDefs;
-        slapi_search_internal_set_pb(pDnSearch, dn, LDAP_SCOPE_SUBTREE,
+        slapi_search_internal_set_pb(pDnSearch, dn, scope,
                                      DN_DEF_FILTER, NULL, 0,
                                      NULL, NULL, cos_get_plugin_identity(), 0);
         slapi_search_internal_callback_pb(pDnSearch,
@@ -1239,10 +1734,7 @@ cos_dn_tmpl_entries_cb(Slapi_Entry *e, void *callback_data)
 static int
 cos_cache_add_dn_tmpls(char *dn, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls)
 {
-    void *plugin_id;
     int scope;
-    struct tmpl_info info = {NULL, 0, 0, 0};
-    Slapi_PBlock *pDnSearch = 0;
 
     slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "--> cos_cache_add_dn_tmpls\n");
 
@@ -1252,6 +1744,25 @@ cos_cache_add_dn_tmpls(char *dn, cosAttrValue *pCosSpecifier, cosAttrValue *pAtt
     else
         scope = LDAP_SCOPE_BASE;
 
+    return cos_cache_search_tmpls(dn, scope, pCosSpecifier, pAttrs, pTmpls);
+}
+
+/*
+    cos_cache_search_tmpls
+    ----------------------
+    searches dn with the given scope for cos templates,
+    adding any found to the template list
+
+    Returns: zero for success--found at least one good tmpl.
+            non-zero: failed to add any templs.
+*/
+static int
+cos_cache_search_tmpls(const char *dn, int scope, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls)
+{
+    void *plugin_id;
+    struct tmpl_info info = {NULL, 0, 0, 0};
+    Slapi_PBlock *pDnSearch = 0;
+
     /* Use new internal operation API */
     pDnSearch = slapi_pblock_new();
     plugin_id = cos_get_plugin_identity();
@@ -1693,34 +2204,13 @@ cos_cache_release(cos_cache *ptheCache)
         if (pDef)
             cos_cache_del_schema(pOldCache);
 
+        cos_cache_resolved_free(pOldCache);
+
         while (pDef) {
             cosDefinitions *pTmpD = pDef;
-            cosTemplates *pCosTmps = pDef->pCosTmps;
-
-            while (pCosTmps) {
-                cosTemplates *pTmpT = pCosTmps;
-
-                pCosTmps = pCosTmps->list.pNext;
-
-                cos_cache_del_attr_list(&(pTmpT->pAttrs));
-                cos_cache_del_attrval_list(&(pTmpT->pObjectclasses));
-                cos_cache_del_attrval_list(&(pTmpT->pDn));
-                slapi_ch_free((void **)&(pTmpT->cosGrade));
-                slapi_ch_free((void **)&pTmpT);
-            }
 
             pDef = pDef->list.pNext;
-
-            cos_cache_del_attrval_list(&(pTmpD->pDn));
-            cos_cache_del_attrval_list(&(pTmpD->pCosTargetTree));
-            cos_cache_del_attrval_list(&(pTmpD->pCosTemplateDn));
-            cos_cache_del_attrval_list(&(pTmpD->pCosSpecifier));
-            cos_cache_del_attrval_list(&(pTmpD->pCosAttrs));
-            cos_cache_del_attrval_list(&(pTmpD->pCosOverrides));
-            cos_cache_del_attrval_list(&(pTmpD->pCosOperational));
-            cos_cache_del_attrval_list(&(pTmpD->pCosMerge));
-            cos_cache_del_attrval_list(&(pTmpD->pCosOpDefault));
-            slapi_ch_free((void **)&pTmpD);
+            cos_cache_del_defn(pTmpD);
         }
 
         if (pOldCache->ppAttrIndex)
@@ -2177,6 +2667,8 @@ cos_cache_query_attr(cos_cache *ptheCache, vattr_context *context, Slapi_Entry *
     int using_default = 0;
     int entry_has_value = 0;
     int merge_mode = 0;
+    cosQueryDef queryDefs[COS_QUERY_DEFS];
+    int queryDefCount = 0;
 
     slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "--> cos_cache_query_attr\n");
 
@@ -2292,6 +2784,34 @@ cos_cache_query_attr(cos_cache *ptheCache, vattr_context *context, Slapi_Entry *
             continue;
         }
 
+        /*
+            classic definitions: the specifier of the entry was resolved
+            once for this definition, only the template it resolved to
+            can be a hit.  Compare and merge keep walking the templates.
+        */
+        if (pDef->cosType == COSTYPE_CLASSIC && test_this == NULL &&
+            !merge_mode && !pAttr->attr_cos_merge) {
+            cosQueryDef *pQuery = cos_cache_query_def(pCache, queryDefs, &queryDefCount, pDef, context, e, pDn, type);
+
+            if (pQuery) {
+                if (pQuery->in_scope) {
+                    if (attr_index == pQuery->resolved_index) {
+                        /* we have a hit */
+                        if (out_attr) {
+                            *out_attr = slapi_valueset_new();
+                            slapi_valueset_set_valueset(*out_attr, pQuery->pResolved->pValues);
+                        }
+                        hit = 1;
+                    } else if (pTemplate->template_default && !pDefAttr) {
+                        pDefAttr = pAttr;
+                    }
+                }
+                if (hit == 0)
+                    attr_index++;
+                continue;
+            }
+        }
+
         /* If we haven't found a hit yet, or if we are in merge mode, look for
          * hits.  We only check if this entry is a child of the target tree(s). */
         while ((hit == 0 || merge_mode) && pTargetTree) {
@@ -2522,6 +3042,210 @@ bail:
     return ret;
 }
 
+/*
+    cos_cache_resolved_key
+    ----------------------
+    the memo key for a definition, an attribute and a specifier
+    value, case folded the way the templates are matched
+*/
+static char *
+cos_cache_resolved_key(cosDefinitions *pDef, const char *type, const char *grade)
+{
+    char *key = slapi_ch_smprintf("%p:%s:%s", (void *)pDef, type, grade);
+    char *lower = (char *)slapi_utf8StrToLower((unsigned char *)key);
+
+    if (lower == NULL) {
+        /* not utf8, use it as is */
+        return key;
+    }
+    if (lower != key)
+        slapi_ch_free_string(&key);
+
+    return lower;
+}
+
+/*
+    cos_cache_resolved_build
+    ------------------------
+    memoizes, for every classic definition, attribute and
+    template grade, the first template attribute a query would
+    match and its values.  The index is sorted by priority so
+    the first one seen wins.
+*/
+static int
+cos_cache_resolved_build(cosCache *pCache)
+{
+    int index;
+
+    pCache->resolvedCount = 0;
+    pCache->pResolved = PL_NewHashTable(pCache->attrCount, PL_HashString, PL_CompareStrings,
+                                        PL_CompareValues, NULL, NULL);
+    if (pCache->pResolved == NULL)
+        return -1;
+
+    for (index = 0; index < pCache->attrCount; index++) {
+        cosAttributes *pAttr = pCache->ppAttrIndex[index];
+        cosTemplates *pTemplate = (cosTemplates *)pAttr->pParent;
+        cosDefinitions *pDef = (cosDefinitions *)pTemplate->pParent;
+        cosResolved *pResolved;
+        char *key;
+
+        if (pDef->cosType != COSTYPE_CLASSIC || pTemplate->cosGrade == NULL)
+            continue;
+
+        key = cos_cache_resolved_key(pDef, pAttr->pAttrName, pTemplate->cosGrade);
+        if (PL_HashTableLookupConst(pCache->pResolved, key)) {
+            /* a template with a better priority resolves it already */
+            slapi_ch_free_string(&key);
+            continue;
+        }
+
+        pResolved = (cosResolved *)slapi_ch_calloc(1, sizeof(cosResolved));
+        pResolved->attr_index = index;
+        if (cos_cache_cos_2_slapi_valueset(pAttr, &pResolved->pValues) ||
+            PL_HashTableAdd(pCache->pResolved, key, pResolved) == NULL) {
+            slapi_valueset_free(pResolved->pValues);
+            slapi_ch_free((void **)&pResolved);
+            slapi_ch_free_string(&key);
+            return -1;
+        }
+        pCache->resolvedCount++;
+    }
+
+    return 0;
+}
+
+static PRIntn
+cos_cache_resolved_free_entry(PLHashEntry *he, PRIntn i __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    cosResolved *pResolved = (cosResolved *)he->value;
+    char *key = (char *)he->key;
+
+    slapi_valueset_free(pResolved->pValues);
+    slapi_ch_free((void **)&pResolved);
+    slapi_ch_free_string(&key);
+
+    return HT_ENUMERATE_REMOVE;
+}
+
+static void
+cos_cache_resolved_free(cosCache *pCache)
+{
+    if (pCache->pResolved) {
+        PL_HashTableEnumerateEntries(pCache->pResolved, cos_cache_resolved_free_entry, NULL);
+        PL_HashTableDestroy(pCache->pResolved);
+        pCache->pResolved = NULL;
+    }
+    pCache->resolvedCount = 0;
+}
+
+/*
+    cos_cache_query_def
+    -------------------
+    returns the resolution of a classic definition for the entry,
+    evaluating it the first time the definition is met during the
+    query.  NULL means the caller must walk the templates itself.
+*/
+static cosQueryDef *
+cos_cache_query_def(cosCache *pCache, cosQueryDef *pQueryDefs, int *queryDefCount, cosDefinitions *pDef, vattr_context *context, Slapi_Entry *e, const char *pDn, const char *type)
+{
+    cosQueryDef *pQuery;
+    cosAttrValue *pTargetTree;
+    cosAttrValue *pSpec;
+    int i;
+
+    for (i = 0; i < *queryDefCount; i++) {
+        if (pQueryDefs[i].pDef == pDef)
+            return &pQueryDefs[i];
+    }
+
+    if (pCache->pResolved == NULL || *queryDefCount == COS_QUERY_DEFS)
+        return NULL;
+
+    pQuery = &pQueryDefs[(*queryDefCount)++];
+    pQuery->pDef = pDef;
+    pQuery->in_scope = 0;
+    pQuery->resolved_index = -1;
+    pQuery->pResolved = NULL;
+
+    for (pTargetTree = pDef->pCosTargetTree; pTargetTree && !pQuery->in_scope; pTargetTree = pTargetTree->list.pNext) {
+        if (pTargetTree->val == 0 ||
+            slapi_dn_issuffix(pDn, pTargetTree->val) != 0 ||
+            (views_api && views_entry_exists(views_api, pTargetTree->val, e))) {
+            pQuery->in_scope = 1;
+        }
+    }
+    if (!pQuery->in_scope)
+        return pQuery;
+
+    for (pSpec = pDef->pCosSpecifier; pSpec; pSpec = pSpec->list.pNext) {
+        Slapi_ValueSet *pAttrSpecs = NULL;
+        Slapi_Value *val = NULL;
+        int type_name_disposition = 0;
+        char *actual_type_name = NULL;
+        int free_flags = 0;
+        int index;
+
+        if (pSpec->val == NULL)
+            continue;
+
+        if (slapi_vattr_values_get_sp(context, e, pSpec->val, &pAttrSpecs, &type_name_disposition,
+                                      &actual_type_name, 0, &free_flags) == 0) {
+            for (index = slapi_valueset_first_value(pAttrSpecs, &val);
+                 val && index != -1;
+                 index = slapi_valueset_next_value(pAttrSpecs, index, &val)) {
+                char *key = cos_cache_resolved_key(pDef, type, slapi_value_get_string(val));
+                cosResolved *pResolved = (cosResolved *)PL_HashTableLookupConst(pCache->pResolved, key);
+
+                slapi_ch_free_string(&key);
+                if (pResolved && (pQuery->resolved_index == -1 || pResolved->attr_index < pQuery->resolved_index)) {
+                    pQuery->resolved_index = pResolved->attr_index;
+                    pQuery->pResolved = pResolved;
+                }
+            }
+            slapi_vattr_values_free(&pAttrSpecs, &actual_type_name, free_flags);
+        }
+    }
+
+    if (pQuery->pResolved)
+        slapi_counter_increment(resolve_hits);
+    else
+        slapi_counter_increment(resolve_misses);
+
+    return pQuery;
+}
+
+/*
+    cos_cache_stats_search
+    ----------------------
+    adds the resolution statistics to the plugin entry
+*/
+static int
+cos_cache_stats_search(Slapi_PBlock *pb __attribute__((unused)),
+                       Slapi_Entry *e,
+                       Slapi_Entry *entryAfter __attribute__((unused)),
+                       int *returncode,
+                       char *returntext __attribute__((unused)),
+                       void *arg __attribute__((unused)))
+{
+    cosCache *pStatsCache = NULL;
+    int resolved = 0;
+
+    if (cos_cache_getref((cos_cache **)&pStatsCache) > 0) {
+        resolved = pStatsCache->resolvedCount;
+        cos_cache_release(pStatsCache);
+    }
+
+    slapi_entry_attr_set_ulong(e, "cosResolveHits", slapi_counter_get_value(resolve_hits));
+    slapi_entry_attr_set_ulong(e, "cosResolveMisses", slapi_counter_get_value(resolve_misses));
+    slapi_entry_attr_set_ulong(e, "cosCacheRebuilds", slapi_counter_get_value(cache_rebuilds));
+    slapi_entry_attr_set_ulong(e, "cosCacheUpdates", slapi_counter_get_value(cache_updates));
+    slapi_entry_attr_set_int(e, "cosResolvedSpecifiers", resolved);
+
+    *returncode = LDAP_SUCCESS;
+    return SLAPI_DSE_CALLBACK_OK;
+}
+
 /*
     cos_cache_find_attr
     -------------------
@@ -3165,8 +3889,10 @@ void
 cos_cache_change_notify(Slapi_PBlock *pb)
 {
     const char *dn;
+    const char *newdn = NULL;
     Slapi_DN *sdn = NULL;
     int do_update = 0;
+    int kind = 0;
     struct slapi_entry *e;
     Slapi_Backend *be = NULL;
     int rc = 0;
@@ -3198,8 +3924,9 @@ cos_cache_change_notify(Slapi_PBlock *pb)
     /*
      * For DELETE, MODIFY, MODRDN: see if the pre-op entry was cos significant.
      * For ADD, MODIFY, MODRDN: see if the post-op was cos significant.
-     * Touching a cos significant entry triggers the update
-     * of the whole cache.
+     * Touching a cos significant entry triggers the update of the
+     * cache, definitions and templates are patched into a new cache
+     * generation, anything else rebuilds the whole cache.
     */
     slapi_pblock_get(pb, SLAPI_OPERATION_TYPE, &optype);
     if (optype == SLAPI_OPERATION_DELETE ||
@@ -3207,21 +3934,22 @@ cos_cache_change_notify(Slapi_PBlock *pb)
         optype == SLAPI_OPERATION_MODRDN) {
 
         slapi_pblock_get(pb, SLAPI_ENTRY_PRE_OP, &e);
-        if (cos_cache_entry_is_cos_related(e)) {
-            do_update = 1;
-        }
+        kind |= cos_cache_entry_cos_kind(e);
     }
-    if (!do_update &&
-        (optype == SLAPI_OPERATION_ADD ||
-         optype == SLAPI_OPERATION_MODIFY ||
-         optype == SLAPI_OPERATION_MODRDN)) {
+    if (optype == SLAPI_OPERATION_ADD ||
+        optype == SLAPI_OPERATION_MODIFY ||
+        optype == SLAPI_OPERATION_MODRDN) {
 
         /* Adds have null pre-op entries */
         slapi_pblock_get(pb, SLAPI_ENTRY_POST_OP, &e);
-        if (cos_cache_entry_is_cos_related(e)) {
-            do_update = 1;
+        kind |= cos_cache_entry_cos_kind(e);
+        if (optype == SLAPI_OPERATION_MODRDN && e) {
+            newdn = slapi_entry_get_dn_const(e);
         }
     }
+    if (kind) {
+        do_update = 1;
+    }
 
     /*
      * Check if this was an entry in a template tree (dn contains
@@ -3242,11 +3970,33 @@ cos_cache_change_notify(Slapi_PBlock *pb)
                                                               "Updating due to indirect template change(%s)\n",
                       dn);
         do_update = 1;
+        kind = COS_CHANGE_UNKNOWN;
     }
 
     /* Do the update if required */
     if (do_update) {
         slapi_lock_mutex(change_lock);
+        if (kind != COS_CHANGE_DEFINITION && kind != COS_CHANGE_TEMPLATE) {
+            cos_cache_full_rebuild = 1;
+        } else if (!cos_cache_full_rebuild) {
+            if (cos_cache_change_count < COS_CHANGES_MAX) {
+                cosChange *pChange = (cosChange *)slapi_ch_calloc(1, sizeof(cosChange));
+                cosChange **ppTail = &cos_cache_changes;
+
+                pChange->kind = kind;
+                pChange->dn = slapi_ch_strdup(dn);
+                pChange->newdn = slapi_ch_strdup(newdn);
+                /* keep the order of the operations */
+                while (*ppTail)
+                    ppTail = &((*ppTail)->pNext);
+                *ppTail = pChange;
+                cos_cache_change_count++;
+            } else {
+                cos_cache_full_rebuild = 1;
+                cos_cache_del_changes(&cos_cache_changes);
+                cos_cache_change_count = 0;
+            }
+        }
         slapi_notify_condvar(something_changed, 1);
         cos_cache_notify_flag = 1;
         slapi_unlock_mutex(change_lock);
@@ -3269,6 +4019,12 @@ cos_cache_stop(void)
     /* first deregister our state change func */
     slapi_unregister_backend_state_change((void *)cos_cache_backend_state_change);
 
+    if (stats_dn) {
+        slapi_config_remove_callback(SLAPI_OPERATION_SEARCH, DSE_FLAG_PREOP, stats_dn,
+                                     LDAP_SCOPE_BASE, "(objectclass=*)", cos_cache_stats_search);
+        slapi_ch_free_string(&stats_dn);
+    }
+
     slapi_lock_mutex(change_lock);
     keeprunning = 0;
     slapi_notify_condvar(something_changed, 1);
@@ -3433,30 +4189,33 @@ cos_cache_backend_state_change(void *handle __attribute__((unused)),
                                int new_be_state __attribute__((unused)))
 {
     slapi_lock_mutex(change_lock);
+    cos_cache_full_rebuild = 1;
     slapi_notify_condvar(something_changed, 1);
     slapi_unlock_mutex(change_lock);
 }
 
 /*
- * returns non-zero: entry is cos significant (note does not detect indirect
- *                    template entries).
+ * returns the kind of cos significant entry (note does not detect indirect
+ *                    template entries): COS_CHANGE_DEFINITION,
+ *                    COS_CHANGE_TEMPLATE, or COS_CHANGE_UNKNOWN when
+ *                    there is no entry to look at.
  *             0       : entry is not cos significant.
  */
 static int
-cos_cache_entry_is_cos_related(Slapi_Entry *e)
+cos_cache_entry_cos_kind(Slapi_Entry *e)
 {
 
     int rc = 0;
     Slapi_Attr *pObjclasses = NULL;
 
     if (e == NULL) {
-        slapi_log_err(SLAPI_LOG_ERR, COS_PLUGIN_SUBSYSTEM, "cos_cache_entry_is_cos_related - "
+        slapi_log_err(SLAPI_LOG_ERR, COS_PLUGIN_SUBSYSTEM, "cos_cache_entry_cos_kind - "
                                                            "Modified entry is NULL--updating cache just in case\n");
-        rc = 1;
+        rc = COS_CHANGE_UNKNOWN;
     } else {
 
         if (slapi_entry_attr_find(e, "objectclass", &pObjclasses)) {
-            slapi_log_err(SLAPI_LOG_ERR, COS_PLUGIN_SUBSYSTEM, "cos_cache_entry_is_cos_related - "
+            slapi_log_err(SLAPI_LOG_ERR, COS_PLUGIN_SUBSYSTEM, "cos_cache_entry_cos_kind - "
                                                                "Failed to get objectclass from %s\n",
                           slapi_entry_get_dn(e));
             rc = 0;
@@ -3469,13 +4228,14 @@ cos_cache_entry_is_cos_related(Slapi_Entry *e)
             /* check out the object classes to see if this was a cosDefinition */
 
             index = slapi_attr_first_value(pObjclasses, &val);
-            while (!rc && val) {
+            while (val) {
                 pObj = (char *)slapi_value_get_string(val);
 
                 if (!strcasecmp(pObj, "cosdefinition") ||
-                    !strcasecmp(pObj, "cossuperdefinition") ||
-                    !strcasecmp(pObj, "costemplate")) {
-                    rc = 1;
+                    !strcasecmp(pObj, "cossuperdefinition")) {
+                    rc |= COS_CHANGE_DEFINITION;
+                } else if (!strcasecmp(pObj, "costemplate")) {
+                    rc |= COS_CHANGE_TEMPLATE;
                 }
 
                 index = slapi_attr_next_value(pObjclasses, index, &val);
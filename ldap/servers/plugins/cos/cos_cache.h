@@ -16,7 +16,7 @@
 
 typedef void cos_cache;
 
-int cos_cache_init(void);
+int cos_cache_init(const char *plugin_dn);
 void cos_cache_stop(void);
 int cos_cache_getref(cos_cache **ppCache);
 int cos_cache_addref(cos_cache *pCache);
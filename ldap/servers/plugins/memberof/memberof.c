@@ -53,10 +53,13 @@ MemberOfConfig *qsortConfig = 0;
 static int usetxn = 0;
 static int premodfn = 0;
 static PRLock *fixup_lock = NULL;
-static int32_t fixup_progress_count = 0;
-static int64_t fixup_progress_elapsed = 0;
-static int64_t fixup_start_time = 0;
 #define FIXUP_PROGRESS_LIMIT 1000
+#define FIXUP_THREADS_MAX 64
+#define FIXUP_BATCH_SIZE 1000
+#define FIXUP_BATCH_MAX 100000
+#define FIXUP_CHECKPOINT_INTERVAL 30 /* seconds */
+#define FIXUP_CHECKPOINT_ATTR "checkpoint"
+#define FIXUP_CHECKPOINT_DN_ATTR "checkpointdn"
 
 typedef struct _memberofstringll
 {
@@ -103,14 +106,77 @@ typedef struct _task_data
     char *dn;
     char *bind_dn;
     char *filter_str;
+    char *task_dn;
+    int32_t threads;
+    int32_t batch_size;
+    int32_t resume;
 } task_data;
 
+/*
+ * A fixup task runs as a pipeline: the task thread searches the candidate
+ * entries and queues them, the workers compute their memberOf values and
+ * the writer applies the resulting modifies, batch_size per transaction.
+ *
+ * Candidates are numbered in the order the search returns them (entry id
+ * order).  The watermark is the number of leading candidates that are
+ * committed, it is saved with the first candidate not committed yet as
+ * the task checkpoint.
+ */
+typedef struct _fixup_item
+{
+    uint64_t seq;
+    Slapi_Entry *e;
+    LDAPMod **mods; /* set by the worker, NULL if the entry is up to date */
+    struct _fixup_item *next;
+} fixup_item;
+
+typedef struct _fixup_queue
+{
+    fixup_item *head;
+    fixup_item *tail;
+} fixup_queue;
+
+typedef struct _fixup_run
+{
+    Slapi_Task *task;
+    task_data *td;
+    Slapi_Backend *be;
+    PRLock *lock;
+    PRCondVar *cv;      /* signaled on every state change */
+    fixup_queue todo;   /* candidates waiting for a worker */
+    fixup_queue done;   /* candidates waiting for the writer */
+    int32_t searching;  /* the task thread is still queuing candidates */
+    int32_t busy;       /* workers computing a candidate */
+    int32_t abort;
+    int rc;
+    uint64_t next_seq;  /* number of candidates seen */
+    uint64_t watermark; /* candidates below are committed */
+    uint64_t window;    /* max candidates between the watermark and next_seq */
+    char *committed;    /* ring of window flags */
+    char **ndns;        /* ring of window ndns */
+    uint64_t skip;      /* on resume, candidates to skip at most... */
+    char *skip_ndn;     /* ...until this one */
+    uint64_t processed; /* candidates committed by this run */
+    uint64_t unchanged; /* of which were already up to date */
+    time_t start_time;
+    time_t last_checkpoint;
+    char *checkpoint_dn;
+} fixup_run;
+
+typedef struct _fixup_worker
+{
+    fixup_run *run;
+    MemberOfConfig config;
+    PRThread *thread;
+} fixup_worker;
+
 /*** function prototypes ***/
 
 /* exported functions */
 int memberof_postop_init(Slapi_PBlock *pb);
 static int memberof_internal_postop_init(Slapi_PBlock *pb);
 static int memberof_preop_init(Slapi_PBlock *pb);
+static int memberof_bepostop_init(Slapi_PBlock *pb);
 
 /* plugin callbacks */
 static int memberof_postop_del(Slapi_PBlock *pb);
@@ -119,6 +185,7 @@ static int memberof_postop_modify(Slapi_PBlock *pb);
 static int memberof_postop_add(Slapi_PBlock *pb);
 static int memberof_postop_start(Slapi_PBlock *pb);
 static int memberof_postop_close(Slapi_PBlock *pb);
+static int memberof_preop_modify(Slapi_PBlock *pb);
 
 /* supporting cast */
 static int memberof_oktodo(Slapi_PBlock *pb);
@@ -147,6 +214,8 @@ static int memberof_is_grouping_attr(char *type, MemberOfConfig *config);
 static Slapi_ValueSet *memberof_get_groups(MemberOfConfig *config, Slapi_DN *member_sdn);
 static int memberof_get_groups_r(MemberOfConfig *config, Slapi_DN *member_sdn, memberof_get_groups_data *data);
 static int memberof_get_groups_callback(Slapi_Entry *e, void *callback_data);
+static int memberof_get_groups_visit(Slapi_DN *group_sdn, const char *group_ndn, const char *group_dn, void *callback_data);
+static int memberof_graph_foreach_group(MemberOfConfig *config, Slapi_DN *member_sdn, memberof_get_groups_data *data);
 static int memberof_test_membership(Slapi_PBlock *pb, MemberOfConfig *config, Slapi_DN *group_sdn);
 static int memberof_test_membership_callback(Slapi_Entry *e, void *callback_data);
 static int memberof_del_dn_type_callback(Slapi_Entry *e, void *callback_data);
@@ -156,8 +225,15 @@ static int memberof_modop_one_replace_r(Slapi_PBlock *pb, MemberOfConfig *config
 static int memberof_task_add(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *eAfter, int *returncode, char *returntext, void *arg);
 static void memberof_task_destructor(Slapi_Task *task);
 static void memberof_fixup_task_thread(void *arg);
-static int memberof_fix_memberof(MemberOfConfig *config, Slapi_Task *task, task_data *td);
+static int memberof_fix_memberof(Slapi_Task *task, task_data *td);
 static int memberof_fix_memberof_callback(Slapi_Entry *e, void *callback_data);
+static LDAPMod **memberof_fix_memberof_mods(MemberOfConfig *config, Slapi_Entry *e);
+static int memberof_fix_memberof_apply(MemberOfConfig *config, Slapi_Entry *e, LDAPMod **mods);
+static int memberof_fixup_queue_callback(Slapi_Entry *e, void *callback_data);
+static void memberof_fixup_worker_thread(void *arg);
+static void memberof_fixup_writer_thread(void *arg);
+static void memberof_fixup_checkpoint_load(fixup_run *run);
+static void memberof_fixup_checkpoint_save(fixup_run *run);
 static int memberof_entry_in_scope(MemberOfConfig *config, Slapi_DN *sdn);
 static int memberof_add_objectclass(char *auto_add_oc, const char *dn);
 static int memberof_add_memberof_attr(LDAPMod **mods, const char *dn, char *add_oc);
@@ -268,6 +344,21 @@ memberof_postop_init(Slapi_PBlock *pb)
                       "memberof_preop_init - Failed\n");
         ret = -1;
     }
+    /*
+     * The bepostop tells the group graph when a backend transaction is over
+     */
+    if (!ret && usetxn &&
+        slapi_register_plugin("bepostoperation",        /* op type */
+                              1,                        /* Enabled */
+                              "memberof_bepostop_init", /* this function desc */
+                              memberof_bepostop_init,   /* init func */
+                              MEMBEROF_BEPOSTOP_DESC,   /* plugin desc */
+                              NULL,                     /* ? */
+                              memberof_plugin_identity /* access control */)) {
+        slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "memberof_bepostop_init - Failed\n");
+        ret = -1;
+    }
 
     slapi_log_err(SLAPI_LOG_TRACE, MEMBEROF_PLUGIN_SUBSYSTEM,
                   "<-- memberof_postop_init\n");
@@ -282,7 +373,15 @@ memberof_preop_init(Slapi_PBlock *pb)
 
     if (slapi_pblock_set(pb, SLAPI_PLUGIN_VERSION, SLAPI_PLUGIN_VERSION_01) != 0 ||
         slapi_pblock_set(pb, SLAPI_PLUGIN_DESCRIPTION, (void *)&pdesc) != 0 ||
-        slapi_pblock_set(pb, premodfn, (void *)memberof_shared_config_validate) != 0) {
+        slapi_pblock_set(pb, premodfn, (void *)memberof_preop_modify) != 0) {
+        slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "memberof_preop_init: Failed to register plugin\n");
+        status = -1;
+    }
+    if (status == 0 && usetxn &&
+        (slapi_pblock_set(pb, SLAPI_PLUGIN_BE_TXN_PRE_ADD_FN, (void *)memberof_graph_txn_begin) != 0 ||
+         slapi_pblock_set(pb, SLAPI_PLUGIN_BE_TXN_PRE_DELETE_FN, (void *)memberof_graph_txn_begin) != 0 ||
+         slapi_pblock_set(pb, SLAPI_PLUGIN_BE_TXN_PRE_MODRDN_FN, (void *)memberof_graph_txn_begin) != 0)) {
         slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
                       "memberof_preop_init: Failed to register plugin\n");
         status = -1;
@@ -291,6 +390,34 @@ memberof_preop_init(Slapi_PBlock *pb)
     return status;
 }
 
+static int
+memberof_preop_modify(Slapi_PBlock *pb)
+{
+    if (usetxn) {
+        memberof_graph_txn_begin(pb);
+    }
+    return memberof_shared_config_validate(pb);
+}
+
+static int
+memberof_bepostop_init(Slapi_PBlock *pb)
+{
+    int status = 0;
+
+    if (slapi_pblock_set(pb, SLAPI_PLUGIN_VERSION, SLAPI_PLUGIN_VERSION_01) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_DESCRIPTION, (void *)&pdesc) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_BE_POST_ADD_FN, (void *)memberof_graph_txn_end) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_BE_POST_DELETE_FN, (void *)memberof_graph_txn_end) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_BE_POST_MODIFY_FN, (void *)memberof_graph_txn_end) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_BE_POST_MODRDN_FN, (void *)memberof_graph_txn_end) != 0) {
+        slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "memberof_bepostop_init: Failed to register plugin\n");
+        status = -1;
+    }
+
+    return status;
+}
+
 static int
 memberof_internal_postop_init(Slapi_PBlock *pb)
 {
@@ -392,6 +519,13 @@ memberof_postop_start(Slapi_PBlock *pb)
         }
     }
 
+    if (memberof_graph_init(pb)) {
+        slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "memberof_postop_start - Failed to initialize the group graph\n");
+        rc = -1;
+        goto bail;
+    }
+
     memberof_set_config_area(slapi_entry_get_sdn(config_e));
     if ((rc = memberof_config(config_e, pb)) != LDAP_SUCCESS) {
         slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
@@ -438,6 +572,7 @@ memberof_postop_close(Slapi_PBlock *pb __attribute__((unused)))
                   "--> memberof_postop_close\n");
 
     slapi_plugin_task_unregister_handler("memberof task", memberof_task_add);
+    memberof_graph_close();
     memberof_release_config();
     slapi_sdn_free(&_ConfigAreaDN);
     slapi_sdn_free(&_pluginDN);
@@ -523,6 +658,9 @@ memberof_postop_del(Slapi_PBlock *pb)
     slapi_log_err(SLAPI_LOG_TRACE, MEMBEROF_PLUGIN_SUBSYSTEM,
                   "--> memberof_postop_del\n");
 
+    /* The graph follows every update, including the ones done by this plugin */
+    memberof_graph_update(pb);
+
     /* We don't want to process internal modify
      * operations that originate from this plugin. */
     slapi_pblock_get(pb, SLAPI_PLUGIN_IDENTITY, &caller_id);
@@ -872,6 +1010,8 @@ memberof_postop_modrdn(Slapi_PBlock *pb)
     slapi_log_err(SLAPI_LOG_TRACE, MEMBEROF_PLUGIN_SUBSYSTEM,
                   "--> memberof_postop_modrdn\n");
 
+    memberof_graph_update(pb);
+
     /* We don't want to process internal modify
      * operations that originate from this plugin. */
     slapi_pblock_get(pb, SLAPI_PLUGIN_IDENTITY, &caller_id);
@@ -1113,6 +1253,8 @@ memberof_postop_modify(Slapi_PBlock *pb)
     slapi_log_err(SLAPI_LOG_TRACE, MEMBEROF_PLUGIN_SUBSYSTEM,
                   "--> memberof_postop_modify\n");
 
+    memberof_graph_update(pb);
+
     /* We don't want to process internal modify
      * operations that originate from this plugin. */
     slapi_pblock_get(pb, SLAPI_PLUGIN_IDENTITY, &caller_id);
@@ -1299,6 +1441,8 @@ memberof_postop_add(Slapi_PBlock *pb)
     slapi_log_err(SLAPI_LOG_TRACE, MEMBEROF_PLUGIN_SUBSYSTEM,
                   "--> memberof_postop_add\n");
 
+    memberof_graph_update(pb);
+
     /* We don't want to process internal modify
      * operations that originate from this plugin. */
     slapi_pblock_get(pb, SLAPI_PLUGIN_IDENTITY, &caller_id);
@@ -2274,8 +2418,11 @@ memberof_get_groups_r(MemberOfConfig *config, Slapi_DN *member_sdn, memberof_get
 #if MEMBEROF_CACHE_DEBUG
     slapi_log_err(SLAPI_LOG_PLUGIN, MEMBEROF_PLUGIN_SUBSYSTEM, "memberof_get_groups_r: Ancestors of %s\n", slapi_sdn_get_dn(member_sdn));
 #endif
-    rc = memberof_call_foreach_dn(NULL, member_sdn, config, config->groupattrs,
-                                  memberof_get_groups_callback, &member_data, &cached, member_data.use_cache);
+    if (!config->use_graph ||
+        (rc = memberof_graph_foreach_group(config, member_sdn, &member_data)) < 0) {
+        rc = memberof_call_foreach_dn(NULL, member_sdn, config, config->groupattrs,
+                                      memberof_get_groups_callback, &member_data, &cached, member_data.use_cache);
+    }
 
     merge_ancestors(&member_ndn_val, &member_data, data);
     if (!cached && member_data.use_cache)
@@ -2288,6 +2435,78 @@ memberof_get_groups_r(MemberOfConfig *config, Slapi_DN *member_sdn, memberof_get
     return rc;
 }
 
+/*
+ * Returns 1 if memberof_call_foreach_dn() on member_sdn would search
+ * the subtree holding group_sdn.
+ */
+static int
+memberof_graph_group_searched(MemberOfConfig *config, Slapi_DN *member_sdn, Slapi_DN *group_sdn)
+{
+    Slapi_Backend *be = NULL;
+    Slapi_DN *base_sdn = NULL;
+    int scoped = 0;
+
+    be = slapi_be_select(config->allBackends ? group_sdn : member_sdn);
+    if (be == NULL || (base_sdn = (Slapi_DN *)slapi_be_getsuffix(be, 0)) == NULL ||
+        !slapi_sdn_issuffix(group_sdn, base_sdn)) {
+        return 0;
+    }
+    if (!config->entryScopes && !config->entryScopeExcludeSubtrees) {
+        return 1;
+    }
+    if (memberof_entry_in_scope(config, base_sdn)) {
+        return 1;
+    }
+    if (config->entryScopes == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; config->entryScopes[i]; i++) {
+        if (slapi_sdn_issuffix(config->entryScopes[i], base_sdn)) {
+            if (slapi_sdn_issuffix(group_sdn, config->entryScopes[i])) {
+                return 1;
+            }
+            scoped = 1;
+        }
+    }
+    /* no include scope below the suffix, the whole suffix is searched */
+    return !scoped;
+}
+
+/*
+ * memberof_graph_foreach_group()
+ *
+ * Same as memberof_call_foreach_dn() with memberof_get_groups_callback()
+ * but the groups come from the in-memory graph.  Returns -1 if the graph
+ * is not available.
+ */
+static int
+memberof_graph_foreach_group(MemberOfConfig *config, Slapi_DN *member_sdn, memberof_get_groups_data *data)
+{
+    char **group_dns = NULL;
+    char **group_ndns = NULL;
+    int count;
+    int rc = 0;
+
+    if (!memberof_entry_in_scope(config, member_sdn)) {
+        return 0;
+    }
+    if ((count = memberof_graph_get_groups(slapi_sdn_get_ndn(member_sdn), &group_dns, &group_ndns)) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < count && rc == 0; i++) {
+        Slapi_DN *group_sdn = slapi_sdn_new_dn_byref(group_dns[i]);
+
+        if (memberof_graph_group_searched(config, member_sdn, group_sdn)) {
+            rc = memberof_get_groups_visit(group_sdn, group_ndns[i], group_dns[i], data);
+        }
+        slapi_sdn_free(&group_sdn);
+    }
+    slapi_ch_array_free(group_dns);
+    slapi_ch_array_free(group_ndns);
+    /* a negative value would mean the graph is not available */
+    return rc ? LDAP_OPERATIONS_ERROR : 0;
+}
+
 /* memberof_get_groups_callback()
  *
  * Callback to perform work of memberof_get_groups()
@@ -2295,9 +2514,13 @@ memberof_get_groups_r(MemberOfConfig *config, Slapi_DN *member_sdn, memberof_get
 int
 memberof_get_groups_callback(Slapi_Entry *e, void *callback_data)
 {
-    Slapi_DN *group_sdn = slapi_entry_get_sdn(e);
-    char *group_ndn = slapi_entry_get_ndn(e);
-    char *group_dn = slapi_entry_get_dn(e);
+    return memberof_get_groups_visit(slapi_entry_get_sdn(e), slapi_entry_get_ndn(e),
+                                     slapi_entry_get_dn(e), callback_data);
+}
+
+static int
+memberof_get_groups_visit(Slapi_DN *group_sdn, const char *group_ndn, const char *group_dn, void *callback_data)
+{
     Slapi_Value *group_ndn_val = 0;
     Slapi_Value *group_dn_val = 0;
     Slapi_Value *already_seen_ndn_val = 0;
@@ -2397,6 +2620,19 @@ memberof_is_direct_member(MemberOfConfig *config, Slapi_Value *groupdn, Slapi_Va
 
     sdn = slapi_sdn_new_normdn_byref(slapi_value_get_string(groupdn));
 
+    if (config->use_graph) {
+        /* the graph is keyed by ndn, memberdn may be a memberOf value as stored */
+        Slapi_DN *member_sdn = slapi_sdn_new_dn_byref(slapi_value_get_string(memberdn));
+
+        rc = memberof_graph_is_direct_member(slapi_sdn_get_ndn(sdn), slapi_sdn_get_ndn(member_sdn));
+        slapi_sdn_free(&member_sdn);
+        if (rc >= 0) {
+            slapi_sdn_free(&sdn);
+            return rc;
+        }
+    }
+    rc = 0;
+
     slapi_search_get_entry(&pb, sdn, config->groupattrs,
                            &group_e, memberof_get_plugin_id());
 
@@ -2823,22 +3059,14 @@ memberof_qsort_compare(const void *a, const void *b)
 void
 memberof_fixup_task_thread(void *arg)
 {
-    MemberOfConfig configCopy = {0};
     Slapi_Task *task = (Slapi_Task *)arg;
     task_data *td = NULL;
     int rc = 0;
-    Slapi_PBlock *fixup_pb = NULL;
 
     if (!task) {
         return; /* no task */
     }
 
-    PR_Lock(fixup_lock);
-    fixup_progress_count = 0;
-    fixup_progress_elapsed = slapi_current_rel_time_t();
-    fixup_start_time = slapi_current_rel_time_t();
-    PR_Unlock(fixup_lock);
-
     slapi_task_inc_refcount(task);
 
     /* Fetch our task data from the task */
@@ -2848,68 +3076,17 @@ memberof_fixup_task_thread(void *arg)
     slapi_td_set_dn(slapi_ch_strdup(td->bind_dn));
 
     slapi_task_begin(task, 1);
-    slapi_task_log_notice(task, "Memberof task starts (arg: %s) ...",
-                          td->filter_str);
+    slapi_task_log_notice(task, "Memberof task starts (arg: %s, threads: %d, batch size: %d) ...",
+                          td->filter_str, td->threads, td->batch_size);
     slapi_log_err(SLAPI_LOG_INFO, MEMBEROF_PLUGIN_SUBSYSTEM,
-                  "memberof_fixup_task_thread - Memberof task starts (filter: \"%s\") ...\n",
-                  td->filter_str);
-
-    /* We need to get the config lock first.  Trying to get the
-     * config lock after we already hold the op lock can cause
-     * a deadlock. */
-    memberof_rlock_config();
-    /* copy config so it doesn't change out from under us */
-    memberof_copy_config(&configCopy, memberof_get_config());
-    memberof_unlock_config();
-
-    /* Mark this as a task operation */
-    configCopy.fixup_task = 1;
-    configCopy.task = task;
-    Slapi_DN *sdn = slapi_sdn_new_dn_byref(td->dn);
-    if (usetxn) {
-        Slapi_Backend *be = slapi_be_select_exact(sdn);
-
-        if (be) {
-            fixup_pb = slapi_pblock_new();
-            slapi_pblock_set(fixup_pb, SLAPI_BACKEND, be);
-            rc = slapi_back_transaction_begin(fixup_pb);
-            if (rc) {
-                slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
-                              "memberof_fixup_task_thread - Failed to start transaction\n");
-                goto done;
-            }
-        } else {
-            slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
-                          "memberof_fixup_task_thread - Failed to get be backend from (%s)\n",
-                          td->dn);
-            slapi_task_log_notice(task, "Memberof task - Failed to get be backend from (%s)",
-                                  td->dn);
-            rc = -1;
-            goto done;
-        }
-    }
+                  "memberof_fixup_task_thread - Memberof task starts (filter: \"%s\", threads: %d, batch size: %d) ...\n",
+                  td->filter_str, td->threads, td->batch_size);
 
     /* do real work */
-    rc = memberof_fix_memberof(&configCopy, task, td);
-
-done:
-    if (usetxn && fixup_pb) {
-        if (rc) { /* failed */
-            slapi_back_transaction_abort(fixup_pb);
-        } else {
-            slapi_back_transaction_commit(fixup_pb);
-        }
-        slapi_pblock_destroy(fixup_pb);
-    }
-    memberof_free_config(&configCopy);
-
-    slapi_task_log_notice(task, "Memberof task finished (processed %d entries in %ld seconds)",
-                          fixup_progress_count, slapi_current_rel_time_t() - fixup_start_time);
-    slapi_task_log_status(task, "Memberof task finished (processed %d entries in %ld seconds)",
-                          fixup_progress_count, slapi_current_rel_time_t() - fixup_start_time);
-    slapi_task_inc_progress(task);
+    rc = memberof_fix_memberof(task, td);
 
     /* Cleanup task linked list */
+    Slapi_DN *sdn = slapi_sdn_new_dn_byref(td->dn);
     PR_Lock(fixup_lock);
     mo_fixup_ll *prev = NULL;
     for (mo_fixup_ll *curr = fixup_list; curr; curr = curr->next) {
@@ -2939,10 +3116,6 @@ done:
     /* this will queue the destruction of the task */
     slapi_task_finish(task, rc);
     slapi_task_dec_refcount(task);
-
-    slapi_log_err(SLAPI_LOG_INFO, MEMBEROF_PLUGIN_SUBSYSTEM,
-                  "memberof_fixup_task_thread - Memberof task finished (processed %d entries in %ld seconds)\n",
-                  fixup_progress_count, slapi_current_rel_time_t() - fixup_start_time);
 }
 
 int
@@ -2961,6 +3134,9 @@ memberof_task_add(Slapi_PBlock *pb,
     char *bind_dn;
     const char *filter;
     const char *dn = 0;
+    const char *resume;
+    int32_t threads = 1;
+    int32_t batch_size = FIXUP_BATCH_SIZE;
 
     *returncode = LDAP_SUCCESS;
 
@@ -2977,6 +3153,40 @@ memberof_task_add(Slapi_PBlock *pb,
         goto out;
     }
 
+    /* number of threads computing the memberOf values */
+    if (slapi_entry_attr_exists(e, "threads")) {
+        threads = slapi_entry_attr_get_int(e, "threads");
+        if (threads < 1 || threads > FIXUP_THREADS_MAX) {
+            slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                          "memberof_task_add - threads must be between 1 and %d\n", FIXUP_THREADS_MAX);
+            *returncode = LDAP_UNWILLING_TO_PERFORM;
+            rv = SLAPI_DSE_CALLBACK_ERROR;
+            goto out;
+        }
+    }
+
+    /* number of modifies per transaction, also the checkpoint granularity */
+    if (slapi_entry_attr_exists(e, "batchsize")) {
+        batch_size = slapi_entry_attr_get_int(e, "batchsize");
+        if (batch_size < 1 || batch_size > FIXUP_BATCH_MAX) {
+            slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                          "memberof_task_add - batchsize must be between 1 and %d\n", FIXUP_BATCH_MAX);
+            *returncode = LDAP_UNWILLING_TO_PERFORM;
+            rv = SLAPI_DSE_CALLBACK_ERROR;
+            goto out;
+        }
+    }
+
+    /* resume from the checkpoint of an interrupted identical task */
+    resume = slapi_fetch_attr(e, "resume", "yes");
+    if (strcasecmp(resume, "yes") && strcasecmp(resume, "no")) {
+        slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "memberof_task_add - resume must be \"yes\" or \"no\"\n");
+        *returncode = LDAP_UNWILLING_TO_PERFORM;
+        rv = SLAPI_DSE_CALLBACK_ERROR;
+        goto out;
+    }
+
     PR_Lock(fixup_lock);
     sdn = slapi_sdn_new_dn_byval(dn);
     if (fixup_list == NULL) {
@@ -3021,6 +3231,10 @@ memberof_task_add(Slapi_PBlock *pb,
     mytaskdata->dn = slapi_ch_strdup(dn);
     mytaskdata->filter_str = slapi_ch_strdup(filter);
     mytaskdata->bind_dn = slapi_ch_strdup(bind_dn);
+    mytaskdata->task_dn = slapi_ch_strdup(slapi_entry_get_ndn(e));
+    mytaskdata->threads = threads;
+    mytaskdata->batch_size = batch_size;
+    mytaskdata->resume = strcasecmp(resume, "yes") == 0;
 
     /* allocate new task now */
     task = slapi_plugin_new_task(slapi_entry_get_ndn(e), arg);
@@ -3064,6 +3278,7 @@ memberof_task_destructor(Slapi_Task *task)
             slapi_ch_free_string(&mydata->dn);
             slapi_ch_free_string(&mydata->bind_dn);
             slapi_ch_free_string(&mydata->filter_str);
+            slapi_ch_free_string(&mydata->task_dn);
             /* Need to cast to avoid a compiler warning */
             slapi_ch_free((void **)&mydata);
         }
@@ -3072,38 +3287,632 @@ memberof_task_destructor(Slapi_Task *task)
                   "memberof_task_destructor <--\n");
 }
 
+static void
+fixup_queue_push(fixup_queue *q, fixup_item *item)
+{
+    item->next = NULL;
+    if (q->tail) {
+        q->tail->next = item;
+    } else {
+        q->head = item;
+    }
+    q->tail = item;
+}
+
+static fixup_item *
+fixup_queue_pop(fixup_queue *q)
+{
+    fixup_item *item = q->head;
+
+    if (item) {
+        q->head = item->next;
+        if (q->head == NULL) {
+            q->tail = NULL;
+        }
+        item->next = NULL;
+    }
+    return item;
+}
+
+static void
+fixup_item_free(fixup_item *item)
+{
+    if (item) {
+        slapi_entry_free(item->e);
+        if (item->mods) {
+            ldap_mods_free(item->mods, 1);
+        }
+        slapi_ch_free((void **)&item);
+    }
+}
+
+/*
+ * Stop the pipeline, the caller holds the run lock
+ */
+static void
+fixup_abort(fixup_run *run, int rc)
+{
+    if (!run->abort) {
+        run->abort = 1;
+        run->rc = rc;
+    }
+    PR_NotifyAllCondVar(run->cv);
+}
+
+/*
+ * Wait for a state change, waking up regularly to notice a shutdown.
+ * The caller holds the run lock.
+ */
+static void
+fixup_wait(fixup_run *run)
+{
+    PR_WaitCondVar(run->cv, PR_SecondsToInterval(1));
+    if (slapi_is_shutting_down()) {
+        fixup_abort(run, -1);
+    }
+}
+
 int
-memberof_fix_memberof(MemberOfConfig *config, Slapi_Task *task, task_data *td)
+memberof_fix_memberof(Slapi_Task *task, task_data *td)
 {
+    fixup_run run = {0};
+    fixup_worker *workers = NULL;
+    PRThread *writer = NULL;
+    Slapi_PBlock *search_pb = NULL;
+    Slapi_DN *sdn = NULL;
+    int32_t started = 0;
+    time_t elapsed;
     int rc = 0;
-    Slapi_PBlock *search_pb = slapi_pblock_new();
-
-    slapi_search_internal_set_pb(search_pb, td->dn,
-                                 LDAP_SCOPE_SUBTREE, td->filter_str, 0, 0,
-                                 0, 0,
-                                 memberof_get_plugin_id(),
-                                 0);
-
-    rc = slapi_search_internal_callback_pb(search_pb,
-                                           config,
-                                           0, memberof_fix_memberof_callback,
-                                           0);
-    if (rc) {
-        char *errmsg;
-        int result;
+    int i;
 
-        slapi_pblock_get(search_pb, SLAPI_PLUGIN_INTOP_RESULT, &result);
-        errmsg = ldap_err2string(result);
+    run.task = task;
+    run.td = td;
+    run.start_time = run.last_checkpoint = slapi_current_rel_time_t();
+    /* Enough candidates in flight to keep every worker and the writer busy */
+    run.window = (uint64_t)td->batch_size * 2 + (uint64_t)td->threads * 64;
+    run.committed = (char *)slapi_ch_calloc(run.window, sizeof(char));
+    run.ndns = (char **)slapi_ch_calloc(run.window, sizeof(char *));
+    run.searching = 1;
+
+    if ((run.lock = PR_NewLock()) == NULL || (run.cv = PR_NewCondVar(run.lock)) == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
-                      "memberof_fix_memberof - Failed (%s)\n", errmsg);
-        slapi_task_log_notice(task, "Memberof task failed (%s)", errmsg);
+                      "memberof_fix_memberof - Failed to create the task lock\n");
+        rc = -1;
+        goto done;
     }
 
-    slapi_pblock_destroy(search_pb);
+    if (usetxn) {
+        sdn = slapi_sdn_new_dn_byref(td->dn);
+        run.be = slapi_be_select_exact(sdn);
+        slapi_sdn_free(&sdn);
+        if (run.be == NULL) {
+            slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                          "memberof_fix_memberof - Failed to get be backend from (%s)\n",
+                          td->dn);
+            slapi_task_log_notice(task, "Memberof task - Failed to get be backend from (%s)",
+                                  td->dn);
+            rc = -1;
+            goto done;
+        }
+    }
+
+    memberof_fixup_checkpoint_load(&run);
+
+    /* Each worker has its own copy of the config, and so its own caches.
+     * We need to get the config lock first.  Trying to get the
+     * config lock after we already hold the op lock can cause
+     * a deadlock. */
+    workers = (fixup_worker *)slapi_ch_calloc(td->threads, sizeof(fixup_worker));
+    memberof_rlock_config();
+    for (i = 0; i < td->threads; i++) {
+        memberof_copy_config(&workers[i].config, memberof_get_config());
+        /* Mark this as a task operation */
+        workers[i].config.fixup_task = 1;
+        workers[i].config.task = task;
+        workers[i].run = &run;
+    }
+    memberof_unlock_config();
+
+    for (i = 0; i < td->threads; i++) {
+        workers[i].thread = PR_CreateThread(PR_USER_THREAD, memberof_fixup_worker_thread,
+                                            (void *)&workers[i], PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                            PR_JOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+        if (workers[i].thread == NULL) {
+            break;
+        }
+        started++;
+    }
+    if (started) {
+        writer = PR_CreateThread(PR_USER_THREAD, memberof_fixup_writer_thread,
+                                 (void *)&run, PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                 PR_JOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+    }
+    if (writer == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "memberof_fix_memberof - Unable to create the task threads\n");
+        PR_Lock(run.lock);
+        fixup_abort(&run, -1);
+        PR_Unlock(run.lock);
+    } else {
+        search_pb = slapi_pblock_new();
+        slapi_search_internal_set_pb(search_pb, td->dn,
+                                     LDAP_SCOPE_SUBTREE, td->filter_str, 0, 0,
+                                     0, 0,
+                                     memberof_get_plugin_id(),
+                                     0);
+
+        rc = slapi_search_internal_callback_pb(search_pb,
+                                               &run,
+                                               0, memberof_fixup_queue_callback,
+                                               0);
+        if (rc == 0) {
+            slapi_pblock_get(search_pb, SLAPI_PLUGIN_INTOP_RESULT, &rc);
+        }
+        if (rc) {
+            PR_Lock(run.lock);
+            if (!run.abort) {
+                char *errmsg = ldap_err2string(rc);
+
+                slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                              "memberof_fix_memberof - Failed (%s)\n", errmsg);
+                slapi_task_log_notice(task, "Memberof task failed (%s)", errmsg);
+            }
+            fixup_abort(&run, rc);
+            PR_Unlock(run.lock);
+        }
+        slapi_pblock_destroy(search_pb);
+    }
+
+    PR_Lock(run.lock);
+    run.searching = 0;
+    PR_NotifyAllCondVar(run.cv);
+    PR_Unlock(run.lock);
 
+    for (i = 0; i < started; i++) {
+        PR_JoinThread(workers[i].thread);
+    }
+    if (writer) {
+        PR_JoinThread(writer);
+    }
+    rc = run.rc;
+
+    if (rc == 0) {
+        /* Everything is committed, forget the checkpoint */
+        memberof_fixup_checkpoint_save(&run);
+        if (run.checkpoint_dn) {
+            Slapi_PBlock *del_pb = slapi_pblock_new();
+
+            slapi_delete_internal_set_pb(del_pb, run.checkpoint_dn, NULL, NULL,
+                                         memberof_get_plugin_id(), 0);
+            slapi_delete_internal_pb(del_pb);
+            slapi_pblock_destroy(del_pb);
+        }
+    } else if (run.checkpoint_dn && run.watermark) {
+        memberof_fixup_checkpoint_save(&run);
+        slapi_task_log_notice(task, "Memberof task interrupted at checkpoint %" PRIu64
+                                    ", an identical task will resume from there",
+                              run.watermark);
+    }
+
+done:
+    elapsed = slapi_current_rel_time_t() - run.start_time;
+    slapi_task_log_notice(task, "Memberof task finished (processed %" PRIu64 " entries in %ld seconds, "
+                                "%" PRIu64 " entries/s, %" PRIu64 " already up to date)",
+                          run.processed, elapsed, run.processed / (elapsed ? elapsed : 1), run.unchanged);
+    slapi_task_log_status(task, "Memberof task finished (processed %" PRIu64 " entries in %ld seconds, "
+                                "%" PRIu64 " entries/s, %" PRIu64 " already up to date)",
+                          run.processed, elapsed, run.processed / (elapsed ? elapsed : 1), run.unchanged);
+    slapi_task_inc_progress(task);
+    slapi_log_err(SLAPI_LOG_INFO, MEMBEROF_PLUGIN_SUBSYSTEM,
+                  "memberof_fix_memberof - Memberof task finished (processed %" PRIu64 " entries in %ld seconds, "
+                  "%" PRIu64 " entries/s)\n",
+                  run.processed, elapsed, run.processed / (elapsed ? elapsed : 1));
+
+    if (workers) {
+        for (i = 0; i < td->threads; i++) {
+            memberof_free_config(&workers[i].config);
+        }
+        slapi_ch_free((void **)&workers);
+    }
+    while (run.todo.head) {
+        fixup_item_free(fixup_queue_pop(&run.todo));
+    }
+    while (run.done.head) {
+        fixup_item_free(fixup_queue_pop(&run.done));
+    }
+    for (uint64_t n = 0; n < run.window; n++) {
+        slapi_ch_free_string(&run.ndns[n]);
+    }
+    slapi_ch_free((void **)&run.ndns);
+    slapi_ch_free_string(&run.committed);
+    slapi_ch_free_string(&run.skip_ndn);
+    slapi_ch_free_string(&run.checkpoint_dn);
+    if (run.cv) {
+        PR_DestroyCondVar(run.cv);
+    }
+    if (run.lock) {
+        PR_DestroyLock(run.lock);
+    }
+
+    return rc;
+}
+
+/*
+ * Search callback of the fixup task: number the candidate and queue it for
+ * the workers, or skip it if an earlier run already committed it.
+ */
+static int
+memberof_fixup_queue_callback(Slapi_Entry *e, void *callback_data)
+{
+    fixup_run *run = (fixup_run *)callback_data;
+    const char *ndn = slapi_entry_get_ndn(e);
+    fixup_item *item;
+    int rc = 0;
+
+    PR_Lock(run->lock);
+    if (run->skip) {
+        if (run->next_seq < run->skip && (run->skip_ndn == NULL || strcmp(ndn, run->skip_ndn))) {
+            run->next_seq++;
+            run->watermark = run->next_seq;
+            goto bail;
+        }
+        slapi_task_log_notice(run->task, "Memberof task resumes at entry %" PRIu64 " (%s)",
+                              run->next_seq, ndn);
+        run->skip = 0;
+    }
+
+    while (!run->abort && run->next_seq - run->watermark >= run->window) {
+        fixup_wait(run);
+    }
+    if (run->abort) {
+        rc = -1;
+        goto bail;
+    }
+
+    item = (fixup_item *)slapi_ch_calloc(1, sizeof(fixup_item));
+    item->seq = run->next_seq++;
+    item->e = slapi_entry_dup(e);
+    run->committed[item->seq % run->window] = 0;
+    slapi_ch_free_string(&run->ndns[item->seq % run->window]);
+    run->ndns[item->seq % run->window] = slapi_ch_strdup(ndn);
+    fixup_queue_push(&run->todo, item);
+    PR_NotifyAllCondVar(run->cv);
+
+bail:
+    PR_Unlock(run->lock);
     return rc;
 }
 
+/*
+ * Compute the memberOf values of the queued candidates
+ */
+static void
+memberof_fixup_worker_thread(void *arg)
+{
+    fixup_worker *worker = (fixup_worker *)arg;
+    fixup_run *run = worker->run;
+    fixup_item *item;
+
+    slapi_td_set_dn(slapi_ch_strdup(run->td->bind_dn));
+
+    PR_Lock(run->lock);
+    while (1) {
+        while (!run->abort && run->todo.head == NULL && run->searching) {
+            fixup_wait(run);
+        }
+        if (run->abort || (item = fixup_queue_pop(&run->todo)) == NULL) {
+            break;
+        }
+        run->busy++;
+        PR_Unlock(run->lock);
+
+        item->mods = memberof_fix_memberof_mods(&worker->config, item->e);
+
+        PR_Lock(run->lock);
+        run->busy--;
+        fixup_queue_push(&run->done, item);
+        PR_NotifyAllCondVar(run->cv);
+    }
+    PR_NotifyAllCondVar(run->cv);
+    PR_Unlock(run->lock);
+}
+
+/*
+ * Commit the current batch, advance the watermark and report progress
+ */
+static int
+memberof_fixup_commit(fixup_run *run, Slapi_PBlock **txn_pb, uint64_t *seqs, int32_t *count, uint64_t *unchanged)
+{
+    uint64_t processed;
+    time_t now;
+    time_t elapsed;
+    int checkpoint = 0;
+    int rc = 0;
+
+    if (*txn_pb) {
+        rc = slapi_back_transaction_commit(*txn_pb);
+        slapi_pblock_destroy(*txn_pb);
+        *txn_pb = NULL;
+        if (rc) {
+            slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                          "memberof_fixup_commit - Failed to commit transaction (%d)\n", rc);
+            return rc;
+        }
+    }
+
+    PR_Lock(run->lock);
+    for (int32_t i = 0; i < *count; i++) {
+        run->committed[seqs[i] % run->window] = 1;
+    }
+    while (run->watermark < run->next_seq && run->committed[run->watermark % run->window]) {
+        run->committed[run->watermark % run->window] = 0;
+        run->watermark++;
+    }
+    processed = run->processed;
+    run->processed += *count;
+    run->unchanged += *unchanged;
+    now = slapi_current_rel_time_t();
+    if (now - run->last_checkpoint >= FIXUP_CHECKPOINT_INTERVAL) {
+        run->last_checkpoint = now;
+        checkpoint = 1;
+    }
+    PR_NotifyAllCondVar(run->cv);
+    PR_Unlock(run->lock);
+
+    if (processed / FIXUP_PROGRESS_LIMIT != (processed + *count) / FIXUP_PROGRESS_LIMIT) {
+        processed += *count;
+        elapsed = now - run->start_time;
+        slapi_task_log_notice(run->task, "Processed %" PRIu64 " entries in %ld seconds (%" PRIu64 " entries/s)",
+                              processed, elapsed, processed / (elapsed ? elapsed : 1));
+        slapi_task_log_status(run->task, "Processed %" PRIu64 " entries in %ld seconds (%" PRIu64 " entries/s)",
+                              processed, elapsed, processed / (elapsed ? elapsed : 1));
+        slapi_task_inc_progress(run->task);
+    }
+    if (checkpoint) {
+        memberof_fixup_checkpoint_save(run);
+    }
+    *count = 0;
+    *unchanged = 0;
+
+    return rc;
+}
+
+/*
+ * Apply the computed modifies, at most batch_size per backend transaction.
+ * The transaction is committed as soon as there is nothing left to apply,
+ * never wait for the workers while holding it: they and the search could
+ * need the pages it locks.
+ */
+static void
+memberof_fixup_writer_thread(void *arg)
+{
+    fixup_run *run = (fixup_run *)arg;
+    MemberOfConfig configCopy = {0};
+    Slapi_PBlock *txn_pb = NULL;
+    uint64_t *seqs = (uint64_t *)slapi_ch_calloc(run->td->batch_size, sizeof(uint64_t));
+    uint64_t unchanged = 0;
+    int32_t count = 0;
+    fixup_item *items;
+    fixup_item *item;
+    int finished = 0;
+    int rc = 0;
+
+    slapi_td_set_dn(slapi_ch_strdup(run->td->bind_dn));
+
+    memberof_rlock_config();
+    memberof_copy_config(&configCopy, memberof_get_config());
+    memberof_unlock_config();
+
+    while (rc == 0) {
+        PR_Lock(run->lock);
+        while (!run->abort && run->done.head == NULL &&
+               (run->searching || run->todo.head || run->busy)) {
+            fixup_wait(run);
+        }
+        if (run->abort) {
+            PR_Unlock(run->lock);
+            break;
+        }
+        items = run->done.head;
+        run->done.head = run->done.tail = NULL;
+        PR_Unlock(run->lock);
+        if (items == NULL) {
+            finished = 1;
+            break;
+        }
+
+        while ((item = items) != NULL && rc == 0) {
+            items = item->next;
+            if (run->be && txn_pb == NULL) {
+                txn_pb = slapi_pblock_new();
+                slapi_pblock_set(txn_pb, SLAPI_BACKEND, run->be);
+                if ((rc = slapi_back_transaction_begin(txn_pb))) {
+                    slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                                  "memberof_fixup_writer_thread - Failed to start transaction\n");
+                    slapi_pblock_destroy(txn_pb);
+                    txn_pb = NULL;
+                }
+            }
+            if (rc == 0 && item->mods) {
+                rc = memberof_fix_memberof_apply(&configCopy, item->e, item->mods);
+                if (rc) {
+                    slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                                  "memberof_fixup_writer_thread - Failed to fix up %s (%d)\n",
+                                  slapi_entry_get_dn_const(item->e), rc);
+                    slapi_task_log_notice(run->task, "Memberof task - Failed to fix up %s (%d)",
+                                          slapi_entry_get_dn_const(item->e), rc);
+                }
+            } else if (rc == 0) {
+                unchanged++;
+            }
+            if (rc == 0) {
+                seqs[count++] = item->seq;
+                if (count == run->td->batch_size) {
+                    rc = memberof_fixup_commit(run, &txn_pb, seqs, &count, &unchanged);
+                }
+            }
+            fixup_item_free(item);
+        }
+        /* free what is left after a failure */
+        while ((item = items) != NULL) {
+            items = item->next;
+            fixup_item_free(item);
+        }
+        if (rc == 0 && count) {
+            rc = memberof_fixup_commit(run, &txn_pb, seqs, &count, &unchanged);
+        }
+    }
+
+    if (txn_pb) {
+        slapi_back_transaction_abort(txn_pb);
+        slapi_pblock_destroy(txn_pb);
+    }
+
+    PR_Lock(run->lock);
+    if (rc) {
+        fixup_abort(run, rc);
+    } else if (!finished) {
+        /* aborted by a shutdown or a search failure */
+        fixup_abort(run, -1);
+    }
+    PR_Unlock(run->lock);
+
+    memberof_free_config(&configCopy);
+    slapi_ch_free((void **)&seqs);
+}
+
+/*
+ * The checkpoint of a task is kept in the task entry, and in an entry under
+ * the plugin entry since the task entries do not survive a restart.  It is
+ * named after the task base dn and filter, so that an identical task can
+ * resume from there.
+ */
+static void
+memberof_fixup_checkpoint_load(fixup_run *run)
+{
+    task_data *td = run->td;
+    Slapi_Entry *e = NULL;
+    Slapi_DN *sdn = NULL;
+    char *ndn;
+    char *key;
+    int rc;
+
+    ndn = slapi_dn_normalize_case(slapi_ch_strdup(td->dn));
+    key = slapi_ch_smprintf("%s|%s", ndn, td->filter_str);
+    slapi_ch_free_string(&ndn);
+    run->checkpoint_dn = slapi_ch_smprintf("cn=fixup %08x,%s", PL_HashString(key),
+                                           slapi_sdn_get_dn(memberof_get_plugin_area()));
+    slapi_ch_free_string(&key);
+
+    sdn = slapi_sdn_new_dn_byref(run->checkpoint_dn);
+    rc = slapi_search_internal_get_entry(sdn, NULL, &e, memberof_get_plugin_id());
+    slapi_sdn_free(&sdn);
+
+    if (rc == LDAP_SUCCESS && e) {
+        Slapi_DN *base = slapi_sdn_new_dn_byref(td->dn);
+        Slapi_DN *ckpt_base = slapi_sdn_new_dn_byval(slapi_entry_attr_get_ref(e, "basedn"));
+        const char *filter = slapi_entry_attr_get_ref(e, "filter");
+
+        if (td->resume && slapi_sdn_compare(base, ckpt_base) == 0 &&
+            filter && strcasecmp(filter, td->filter_str) == 0)
+        {
+            run->skip = (uint64_t)slapi_entry_attr_get_ulonglong(e, FIXUP_CHECKPOINT_ATTR);
+            run->skip_ndn = slapi_entry_attr_get_charptr(e, FIXUP_CHECKPOINT_DN_ATTR);
+            if (run->skip) {
+                slapi_task_log_notice(run->task, "Memberof task resumes from checkpoint %" PRIu64 " (%s)",
+                                      run->skip, run->skip_ndn ? run->skip_ndn : "end");
+                slapi_log_err(SLAPI_LOG_INFO, MEMBEROF_PLUGIN_SUBSYSTEM,
+                              "memberof_fixup_checkpoint_load - Resuming %s from checkpoint %" PRIu64 "\n",
+                              run->checkpoint_dn, run->skip);
+            }
+        }
+        slapi_sdn_free(&base);
+        slapi_sdn_free(&ckpt_base);
+        slapi_entry_free(e);
+        /* reset the checkpoint, or make it ours */
+        memberof_fixup_checkpoint_save(run);
+    } else {
+        Slapi_PBlock *add_pb = slapi_pblock_new();
+
+        e = slapi_entry_alloc();
+        slapi_entry_init(e, slapi_ch_strdup(run->checkpoint_dn), NULL);
+        slapi_entry_add_string(e, SLAPI_ATTR_OBJECTCLASS, "top");
+        slapi_entry_add_string(e, SLAPI_ATTR_OBJECTCLASS, "extensibleObject");
+        slapi_entry_add_string(e, "basedn", td->dn);
+        slapi_entry_add_string(e, "filter", td->filter_str);
+        slapi_entry_add_string(e, FIXUP_CHECKPOINT_ATTR, "0");
+        slapi_add_entry_internal_set_pb(add_pb, e, NULL, memberof_get_plugin_id(), 0);
+        slapi_add_internal_pb(add_pb);
+        slapi_pblock_get(add_pb, SLAPI_PLUGIN_INTOP_RESULT, &rc);
+        slapi_pblock_destroy(add_pb);
+        if (rc != LDAP_SUCCESS) {
+            slapi_log_err(SLAPI_LOG_WARNING, MEMBEROF_PLUGIN_SUBSYSTEM,
+                          "memberof_fixup_checkpoint_load - Failed to add %s (%d), the task will not be resumable\n",
+                          run->checkpoint_dn, rc);
+            slapi_ch_free_string(&run->checkpoint_dn);
+        }
+    }
+}
+
+static void
+memberof_fixup_checkpoint_save(fixup_run *run)
+{
+    Slapi_PBlock *mod_pb = NULL;
+    LDAPMod mod_ckpt;
+    LDAPMod mod_dn;
+    LDAPMod *mods[3];
+    char *ckpt_val[2];
+    char *dn_val[2];
+    char ckpt_str[32];
+    char *ndn = NULL;
+    const char *targets[2];
+    int rc;
+
+    PR_Lock(run->lock);
+    /* before the first candidate is queued, the watermark is the skipped count */
+    PR_snprintf(ckpt_str, sizeof(ckpt_str), "%" PRIu64, run->skip ? run->skip : run->watermark);
+    if (run->skip) {
+        ndn = slapi_ch_strdup(run->skip_ndn);
+    } else if (run->watermark < run->next_seq) {
+        ndn = slapi_ch_strdup(run->ndns[run->watermark % run->window]);
+    }
+    PR_Unlock(run->lock);
+
+    ckpt_val[0] = ckpt_str;
+    ckpt_val[1] = NULL;
+    mod_ckpt.mod_op = LDAP_MOD_REPLACE;
+    mod_ckpt.mod_type = FIXUP_CHECKPOINT_ATTR;
+    mod_ckpt.mod_values = ckpt_val;
+    dn_val[0] = ndn;
+    dn_val[1] = NULL;
+    mod_dn.mod_op = LDAP_MOD_REPLACE;
+    mod_dn.mod_type = FIXUP_CHECKPOINT_DN_ATTR;
+    mod_dn.mod_values = ndn ? dn_val : NULL;
+    mods[0] = &mod_ckpt;
+    mods[1] = &mod_dn;
+    mods[2] = NULL;
+
+    targets[0] = run->td->task_dn;
+    targets[1] = run->checkpoint_dn;
+    for (size_t i = 0; i < 2; i++) {
+        if (targets[i] == NULL) {
+            continue;
+        }
+        mod_pb = slapi_pblock_new();
+        slapi_modify_internal_set_pb(mod_pb, targets[i], mods, NULL, NULL,
+                                     memberof_get_plugin_id(), 0);
+        slapi_modify_internal_pb(mod_pb);
+        slapi_pblock_get(mod_pb, SLAPI_PLUGIN_INTOP_RESULT, &rc);
+        slapi_pblock_destroy(mod_pb);
+        if (rc != LDAP_SUCCESS) {
+            slapi_log_err(SLAPI_LOG_PLUGIN, MEMBEROF_PLUGIN_SUBSYSTEM,
+                          "memberof_fixup_checkpoint_save - Failed to save the checkpoint in %s (%d)\n",
+                          targets[i], rc);
+        }
+    }
+    slapi_ch_free_string(&ndn);
+}
+
 static memberof_cached_value *
 ancestors_cache_lookup(MemberOfConfig *config, const char *ndn)
 {
@@ -3210,27 +4019,45 @@ int
 memberof_fix_memberof_callback(Slapi_Entry *e, void *callback_data)
 {
     int rc = 0;
-    Slapi_DN *sdn = slapi_entry_get_sdn(e);
     MemberOfConfig *config = (MemberOfConfig *)callback_data;
-    memberof_del_dn_data del_data = {0, config->memberof_attr};
-    Slapi_ValueSet *groups = 0;
-    const char *ndn;
-    char *dn_copy;
+    LDAPMod **mods;
 
     /*
      * If the server is ordered to shutdown, stop the fixup and return an error.
      */
     if (slapi_is_shutting_down()) {
-        rc = -1;
-        goto bail;
+        return -1;
+    }
+
+    if ((mods = memberof_fix_memberof_mods(config, e))) {
+        rc = memberof_fix_memberof_apply(config, e, mods);
+        ldap_mods_free(mods, 1);
     }
 
+    return rc;
+}
+
+/* memberof_fix_memberof_mods()
+ * Compute the memberOf values of an entry and return the modify that sets
+ * them, or NULL if the entry was already fixed up.  For a fixup task, NULL
+ * is also returned if the entry memberOf values are already correct.
+ */
+static LDAPMod **
+memberof_fix_memberof_mods(MemberOfConfig *config, Slapi_Entry *e)
+{
+    Slapi_DN *sdn = slapi_entry_get_sdn(e);
+    Slapi_ValueSet *groups = 0;
+    Slapi_Mod *smod;
+    LDAPMod **mods = NULL;
+    const char *ndn;
+    char *dn_copy;
+
     /* Check if the entry has not already been fixed */
     ndn = slapi_sdn_get_ndn(sdn);
     if (ndn && config->fixup_cache && PL_HashTableLookupConst(config->fixup_cache, (void *)ndn)) {
-        slapi_log_err(SLAPI_LOG_PLUGIN, MEMBEROF_PLUGIN_SUBSYSTEM, "memberof_fix_memberof_callback - "
+        slapi_log_err(SLAPI_LOG_PLUGIN, MEMBEROF_PLUGIN_SUBSYSTEM, "memberof_fix_memberof_mods - "
                 "Entry %s already fixed up\n", ndn);
-        goto bail;
+        return NULL;
     }
 
     /* get a list of all of the groups this user belongs to */
@@ -3246,40 +4073,69 @@ memberof_fix_memberof_callback(Slapi_Entry *e, void *callback_data)
              */
 #if MEMBEROF_CACHE_DEBUG
             slapi_log_err(SLAPI_LOG_PLUGIN, MEMBEROF_PLUGIN_SUBSYSTEM,
-                    "memberof_fix_memberof_callback: This is NOT a group %s\n", ndn);
+                    "memberof_fix_memberof_mods: This is NOT a group %s\n", ndn);
 #endif
             ht_grp = ancestors_cache_lookup(config, (const void *)ndn);
             if (ht_grp) {
                 if (ancestors_cache_remove(config, (const void *)ndn)) {
                     slapi_log_err(SLAPI_LOG_PLUGIN, MEMBEROF_PLUGIN_SUBSYSTEM,
-                            "memberof_fix_memberof_callback - free cached values for %s\n", ndn);
+                            "memberof_fix_memberof_mods - free cached values for %s\n", ndn);
                     ancestor_hashtable_entry_free(ht_grp);
                     slapi_ch_free((void **)&ht_grp);
                 } else {
                     slapi_log_err(SLAPI_LOG_FATAL, MEMBEROF_PLUGIN_SUBSYSTEM,
-                            "memberof_fix_memberof_callback - Fail to remove that leaf node %s\n", ndn);
+                            "memberof_fix_memberof_mods - Fail to remove that leaf node %s\n", ndn);
                 }
             } else {
                 /* This is quite unexpected, after a call to memberof_get_groups
                  * ndn ancestors should be in the cache
                  */
                 slapi_log_err(SLAPI_LOG_PLUGIN, MEMBEROF_PLUGIN_SUBSYSTEM,
-                        "memberof_fix_memberof_callback - Weird, %s is not in the cache\n", ndn);
+                        "memberof_fix_memberof_mods - Weird, %s is not in the cache\n", ndn);
+            }
+        }
+    }
+
+    if (config->fixup_task) {
+        /* Rewriting an entry that is already correct is the bulk of the
+         * work when the task is run again, skip it */
+        Slapi_Attr *attr = NULL;
+        int count = groups ? slapi_valueset_count(groups) : 0;
+        int uptodate = 0;
+
+        if (slapi_entry_attr_find(e, config->memberof_attr, &attr) || attr == NULL) {
+            uptodate = count == 0;
+        } else {
+            int attr_count = 0;
+
+            slapi_attr_get_numvalues(attr, &attr_count);
+            if (attr_count == count) {
+                Slapi_Value *val = 0;
+                int hint;
+
+                uptodate = 1;
+                for (hint = slapi_valueset_first_value(groups, &val);
+                     val && uptodate;
+                     hint = slapi_valueset_next_value(groups, hint, &val)) {
+                    uptodate = slapi_attr_value_find(attr, slapi_value_get_berval(val)) == 0;
+                }
             }
         }
+        if (uptodate) {
+            goto done;
+        }
     }
+
+    smod = slapi_mod_new();
+    slapi_mod_init(smod, 0);
+    slapi_mod_set_type(smod, config->memberof_attr);
     /* If we found some groups, replace the existing memberOf attribute
      * with the found values.  */
     if (groups && slapi_valueset_count(groups)) {
         Slapi_Value *val = 0;
-        Slapi_Mod *smod;
-        LDAPMod **mods = (LDAPMod **)slapi_ch_malloc(2 * sizeof(LDAPMod *));
         int hint = 0;
 
-        smod = slapi_mod_new();
-        slapi_mod_init(smod, 0);
         slapi_mod_set_operation(smod, LDAP_MOD_REPLACE | LDAP_MOD_BVALUES);
-        slapi_mod_set_type(smod, config->memberof_attr);
 
         /* Loop through all of our values and add them to smod */
         hint = slapi_valueset_first_value(groups, &val);
@@ -3288,27 +4144,24 @@ memberof_fix_memberof_callback(Slapi_Entry *e, void *callback_data)
             slapi_mod_add_value(smod, slapi_value_get_berval(val));
             hint = slapi_valueset_next_value(groups, hint, &val);
         }
-
-        mods[0] = slapi_mod_get_ldapmod_passout(smod);
-        mods[1] = 0;
-
-        rc = memberof_add_memberof_attr(mods, slapi_sdn_get_dn(sdn), config->auto_add_oc);
-
-        ldap_mods_free(mods, 1);
-        slapi_mod_free(&smod);
     } else {
         /* No groups were found, so remove the memberOf attribute
          * from this entry. */
-        memberof_del_dn_type_callback(e, &del_data);
+        slapi_mod_set_operation(smod, LDAP_MOD_DELETE | LDAP_MOD_BVALUES);
     }
+    mods = (LDAPMod **)slapi_ch_malloc(2 * sizeof(LDAPMod *));
+    mods[0] = slapi_mod_get_ldapmod_passout(smod);
+    mods[1] = 0;
+    slapi_mod_free(&smod);
 
+done:
     slapi_valueset_free(groups);
 
     /* records that this entry has been fixed up */
     if (config->fixup_cache) {
         dn_copy = slapi_ch_strdup(ndn);
         if (PL_HashTableAdd(config->fixup_cache, dn_copy, dn_copy) == NULL) {
-            slapi_log_err(SLAPI_LOG_FATAL, MEMBEROF_PLUGIN_SUBSYSTEM, "memberof_fix_memberof_callback - "
+            slapi_log_err(SLAPI_LOG_FATAL, MEMBEROF_PLUGIN_SUBSYSTEM, "memberof_fix_memberof_mods - "
                           "failed to add dn (%s) in the fixup hashtable; NSPR error - %d\n",
                           dn_copy, PR_GetError());
             slapi_ch_free((void **)&dn_copy);
@@ -3316,25 +4169,27 @@ memberof_fix_memberof_callback(Slapi_Entry *e, void *callback_data)
         }
     }
 
-    if (config->task) {
-        fixup_progress_count++;
-        if (fixup_progress_count % FIXUP_PROGRESS_LIMIT == 0 ) {
-            slapi_task_log_notice(config->task,
-                    "Processed %d entries in %ld seconds (+%ld seconds)",
-                    fixup_progress_count,
-                    slapi_current_rel_time_t() - fixup_start_time,
-                    slapi_current_rel_time_t() - fixup_progress_elapsed);
-            slapi_task_log_status(config->task,
-                    "Processed %d entries in %ld seconds (+%ld seconds)",
-                    fixup_progress_count,
-                    slapi_current_rel_time_t() - fixup_start_time,
-                    slapi_current_rel_time_t() - fixup_progress_elapsed);
-            slapi_task_inc_progress(config->task);
-            fixup_progress_elapsed = slapi_current_rel_time_t();
-        }
+    return mods;
+}
+
+/* memberof_fix_memberof_apply()
+ * Apply the modify computed by memberof_fix_memberof_mods()
+ */
+static int
+memberof_fix_memberof_apply(MemberOfConfig *config, Slapi_Entry *e, LDAPMod **mods)
+{
+    int rc;
+
+    if ((mods[0]->mod_op & ~LDAP_MOD_BVALUES) == LDAP_MOD_DELETE) {
+        memberof_del_dn_data del_data = {0, config->memberof_attr};
+
+        /* failing to remove memberOf does not stop the fixup */
+        memberof_del_dn_type_callback(e, &del_data);
+        return 0;
     }
 
-bail:
+    rc = memberof_add_memberof_attr(mods, slapi_entry_get_dn_const(e), config->auto_add_oc);
+
     return rc;
 }
 
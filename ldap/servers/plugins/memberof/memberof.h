@@ -35,11 +35,13 @@
 #define MEMBEROF_PLUGIN_SUBSYSTEM "memberof-plugin" /* used for logging */
 #define MEMBEROF_INT_PREOP_DESC   "memberOf internal postop plugin"
 #define MEMBEROF_PREOP_DESC       "memberof preop plugin"
+#define MEMBEROF_BEPOSTOP_DESC    "memberof bepostop plugin"
 #define MEMBEROF_GROUP_ATTR       "memberOfGroupAttr"
 #define MEMBEROF_ATTR             "memberOfAttr"
 #define MEMBEROF_BACKEND_ATTR     "memberOfAllBackends"
 #define MEMBEROF_ENTRY_SCOPE_ATTR "memberOfEntryScope"
 #define MEMBEROF_SKIP_NESTED_ATTR "memberOfSkipNested"
+#define MEMBEROF_GRAPH_ATTR       "memberOfGraph"
 #define MEMBEROF_AUTO_ADD_OC      "memberOfAutoAddOC"
 #define NSMEMBEROF                "nsMemberOf"
 #define MEMBEROF_ENTRY_SCOPE_EXCLUDE_SUBTREE "memberOfEntryScopeExcludeSubtree"
@@ -62,6 +64,7 @@ typedef struct memberofconfig
     Slapi_Filter *group_filter;
     Slapi_Attr **group_slapiattrs;
     int skip_nested;
+    int use_graph;
     int fixup_task;
     char *auto_add_oc;
     PLHashTable *ancestors_cache;
@@ -106,4 +109,15 @@ void ancestor_hashtable_entry_free(memberof_cached_value *entry);
 PLHashTable *hashtable_new(int usetxn);
 int memberof_use_txn(void);
 
+/* memberof_graph.c */
+int memberof_graph_init(Slapi_PBlock *pb);
+void memberof_graph_close(void);
+void memberof_graph_configure(char **attrs, int enabled);
+void memberof_graph_rebuild(void);
+int memberof_graph_get_groups(const char *member_ndn, char ***group_dns, char ***group_ndns);
+int memberof_graph_is_direct_member(const char *group_ndn, const char *member_ndn);
+void memberof_graph_update(Slapi_PBlock *pb);
+int memberof_graph_txn_begin(Slapi_PBlock *pb);
+int memberof_graph_txn_end(Slapi_PBlock *pb);
+
 #endif /* _MEMBEROF_H_ */
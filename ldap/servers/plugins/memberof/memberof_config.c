@@ -194,6 +194,7 @@ memberof_validate_config(Slapi_PBlock *pb,
     char *syntaxoid = NULL;
     char *config_dn = NULL;
     const char *skip_nested = NULL;
+    const char *use_graph = NULL;
     const char *auto_add_oc = NULL;
     char **entry_scopes = NULL;
     char **entry_exclude_scopes = NULL;
@@ -278,6 +279,16 @@ memberof_validate_config(Slapi_PBlock *pb,
         }
     }
 
+    if ((use_graph = slapi_entry_attr_get_ref(e, MEMBEROF_GRAPH_ATTR))) {
+        if (strcasecmp(use_graph, "on") != 0 && strcasecmp(use_graph, "off") != 0) {
+            PR_snprintf(returntext, SLAPI_DSE_RETURNTEXT_SIZE,
+                        "The %s configuration attribute must be set to "
+                        "\"on\" or \"off\".  (illegal value: %s)",
+                        MEMBEROF_GRAPH_ATTR, use_graph);
+            goto done;
+        }
+    }
+
     /* Setup a default auto add OC */
     auto_add_oc = slapi_entry_attr_get_ref(e, MEMBEROF_AUTO_ADD_OC);
     if (auto_add_oc == NULL) {
@@ -469,6 +480,9 @@ memberof_apply_config(Slapi_PBlock *pb __attribute__((unused)),
     char **entryScopeExcludeSubtrees = NULL;
     char *sharedcfg = NULL;
     const char *skip_nested = NULL;
+    const char *use_graph = NULL;
+    char **graph_attrs = NULL;
+    int graph_enabled = 0;
     char *auto_add_oc = NULL;
     int num_vals = 0;
 
@@ -503,6 +517,7 @@ memberof_apply_config(Slapi_PBlock *pb __attribute__((unused)),
     memberof_attr = slapi_entry_attr_get_charptr(e, MEMBEROF_ATTR);
     allBackends = slapi_entry_attr_get_ref(e, MEMBEROF_BACKEND_ATTR);
     skip_nested = slapi_entry_attr_get_ref(e, MEMBEROF_SKIP_NESTED_ATTR);
+    use_graph = slapi_entry_attr_get_ref(e, MEMBEROF_GRAPH_ATTR);
     auto_add_oc = slapi_entry_attr_get_charptr(e, MEMBEROF_AUTO_ADD_OC);
 
     if (auto_add_oc == NULL) {
@@ -615,6 +630,13 @@ memberof_apply_config(Slapi_PBlock *pb __attribute__((unused)),
         }
     }
 
+    /* The graph is off by default, it holds every membership in memory */
+    if (use_graph && strcasecmp(use_graph, "on") == 0) {
+        theConfig.use_graph = 1;
+    } else {
+        theConfig.use_graph = 0;
+    }
+
     if (allBackends) {
         if (strcasecmp(allBackends, "on") == 0) {
             theConfig.allBackends = 1;
@@ -663,13 +685,20 @@ memberof_apply_config(Slapi_PBlock *pb __attribute__((unused)),
         theConfig.entryExcludeScopeCount = num_vals; /* shortcut for config copy */
     }
 
+    graph_attrs = slapi_ch_array_dup(theConfig.groupattrs);
+    graph_enabled = theConfig.use_graph;
+
     /* release the lock */
     memberof_unlock_config();
 
+    /* drops and rebuilds the graph if the grouping attributes changed */
+    memberof_graph_configure(graph_attrs, graph_enabled);
+
 done:
     slapi_sdn_free(&config_sdn);
     slapi_entry_free(config_entry);
     slapi_ch_array_free(groupattrs);
+    slapi_ch_array_free(graph_attrs);
     slapi_ch_free_string(&memberof_attr);
     slapi_ch_free((void **)&entryScopes);
     slapi_ch_free((void **)&entryScopeExcludeSubtrees);
@@ -748,6 +777,10 @@ memberof_copy_config(MemberOfConfig *dest, MemberOfConfig *src)
             dest->skip_nested = src->skip_nested;
         }
 
+        if (src->use_graph) {
+            dest->use_graph = src->use_graph;
+        }
+
         if (src->allBackends) {
             dest->allBackends = src->allBackends;
         }
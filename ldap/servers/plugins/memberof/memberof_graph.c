@@ -0,0 +1,1163 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/*
+ * memberof_graph.c - in-memory group membership graph
+ *
+ * Every entry holding one of the grouping attributes is a group node
+ * whose members are the DNs listed in those attributes.  Each node also
+ * records the groups listing it, so the ancestors of an entry are found
+ * by walking the graph instead of searching the grouping attributes one
+ * nesting level at a time.
+ *
+ * The graph is enabled with memberOfGraph.  It is built by a background
+ * thread when the plugin starts (or when the grouping attributes change)
+ * and is then maintained by the post-op callbacks.  Until it is built,
+ * lookups return -1 and the callers fall back to the internal searches.
+ *
+ * With betxn enabled the post-ops see uncommitted changes.  The groups
+ * touched by a transaction are recorded in a thread private context and,
+ * if the transaction is aborted or retried, re-read from the database
+ * once the backend operation is over.
+ */
+
+#include "plhash.h"
+#include "memberof.h"
+
+#define MEMBEROF_GRAPH_TABLE_SIZE 1024
+#define MEMBEROF_GRAPH_TASK       "memberof graph check"
+
+typedef struct memberof_graph_node
+{
+    char *ndn;
+    char *dn;                             /* DN of the group entry, NULL if it has no members */
+    struct memberof_graph_node **groups;  /* groups listing this DN */
+    uint32_t ngroups;
+    uint32_t maxgroups;
+    struct memberof_graph_node **members; /* DNs listed by this group */
+    uint32_t nmembers;
+    uint32_t maxmembers;
+} memberof_graph_node;
+
+typedef struct memberof_graph_table
+{
+    PLHashTable *nodes; /* ndn -> memberof_graph_node */
+    uint64_t node_count;
+    uint64_t edge_count;
+} memberof_graph_table;
+
+/* Groups touched by the backend transaction running in this thread */
+typedef struct memberof_graph_txn
+{
+    Slapi_Operation *owner; /* outermost operation of the transaction */
+    int retried;
+    char **touched;
+} memberof_graph_txn;
+
+typedef struct memberof_graph_task_data
+{
+    char *bind_dn;
+    int repair;
+} memberof_graph_task_data;
+
+static struct
+{
+    Slapi_RWLock *lock;
+    uint64_t builders; /* running build threads */
+    memberof_graph_table *table; /* NULL until built */
+    char **attrs;
+    int32_t enabled;
+    int building;
+    uint64_t generation;
+    char **dirty; /* groups updated while building */
+} graph;
+
+static PRUintn graph_txn_index;
+static int graph_txn_index_set = 0;
+
+static void graph_build_thread(void *arg);
+static int graph_task_add(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *eAfter, int *returncode, char *returntext, void *arg);
+
+/*
+ * Table and node handling, the caller holds the graph lock or owns the table
+ */
+
+static memberof_graph_table *
+graph_table_new(void)
+{
+    memberof_graph_table *table = (memberof_graph_table *)slapi_ch_calloc(1, sizeof(memberof_graph_table));
+
+    table->nodes = PL_NewHashTable(MEMBEROF_GRAPH_TABLE_SIZE, PL_HashString,
+                                   PL_CompareStrings, PL_CompareValues, NULL, NULL);
+    return table;
+}
+
+static PRIntn
+graph_node_free_cb(PLHashEntry *he, PRIntn index __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    memberof_graph_node *node = (memberof_graph_node *)he->value;
+
+    slapi_ch_free_string(&node->ndn);
+    slapi_ch_free_string(&node->dn);
+    slapi_ch_free((void **)&node->groups);
+    slapi_ch_free((void **)&node->members);
+    slapi_ch_free((void **)&node);
+    return HT_ENUMERATE_NEXT;
+}
+
+static void
+graph_table_free(memberof_graph_table **table)
+{
+    if (table && *table) {
+        PL_HashTableEnumerateEntries((*table)->nodes, graph_node_free_cb, NULL);
+        PL_HashTableDestroy((*table)->nodes);
+        slapi_ch_free((void **)table);
+    }
+}
+
+static memberof_graph_node *
+graph_node_get(memberof_graph_table *table, const char *ndn, int create)
+{
+    memberof_graph_node *node = (memberof_graph_node *)PL_HashTableLookup(table->nodes, ndn);
+
+    if (node == NULL && create) {
+        node = (memberof_graph_node *)slapi_ch_calloc(1, sizeof(memberof_graph_node));
+        node->ndn = slapi_ch_strdup(ndn);
+        PL_HashTableAdd(table->nodes, node->ndn, node);
+        table->node_count++;
+    }
+    return node;
+}
+
+/* Drop a node that no longer takes part in any membership */
+static void
+graph_node_release(memberof_graph_table *table, memberof_graph_node *node)
+{
+    if (node->ngroups == 0 && node->nmembers == 0) {
+        PL_HashTableRemove(table->nodes, node->ndn);
+        table->node_count--;
+        slapi_ch_free_string(&node->ndn);
+        slapi_ch_free_string(&node->dn);
+        slapi_ch_free((void **)&node->groups);
+        slapi_ch_free((void **)&node->members);
+        slapi_ch_free((void **)&node);
+    }
+}
+
+static void
+graph_node_append(memberof_graph_node ***array, uint32_t *count, uint32_t *max, memberof_graph_node *node)
+{
+    if (*count == *max) {
+        *max = *max ? *max * 2 : 4;
+        *array = (memberof_graph_node **)slapi_ch_realloc((char *)*array, sizeof(memberof_graph_node *) * *max);
+    }
+    (*array)[(*count)++] = node;
+}
+
+static int
+graph_node_remove(memberof_graph_node **array, uint32_t *count, memberof_graph_node *node)
+{
+    for (uint32_t i = 0; i < *count; i++) {
+        if (array[i] == node) {
+            array[i] = array[--(*count)];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+graph_edge_exists(memberof_graph_node *group, memberof_graph_node *member)
+{
+    /* members usually belong to far fewer groups than groups have members */
+    for (uint32_t i = 0; i < member->ngroups; i++) {
+        if (member->groups[i] == group) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void
+graph_edge_add(memberof_graph_table *table, memberof_graph_node *group, memberof_graph_node *member)
+{
+    if (!graph_edge_exists(group, member)) {
+        graph_node_append(&member->groups, &member->ngroups, &member->maxgroups, group);
+        graph_node_append(&group->members, &group->nmembers, &group->maxmembers, member);
+        table->edge_count++;
+    }
+}
+
+static void
+graph_edge_remove(memberof_graph_table *table, memberof_graph_node *group, memberof_graph_node *member)
+{
+    if (graph_node_remove(member->groups, &member->ngroups, group)) {
+        graph_node_remove(group->members, &group->nmembers, member);
+        table->edge_count--;
+    }
+}
+
+/* Remove all the members of a group, the group node itself is kept */
+static void
+graph_group_clear(memberof_graph_table *table, memberof_graph_node *group)
+{
+    uint32_t nmembers = group->nmembers;
+
+    for (uint32_t i = 0; i < nmembers; i++) {
+        graph_node_remove(group->members[i]->groups, &group->members[i]->ngroups, group);
+    }
+    table->edge_count -= nmembers;
+    group->nmembers = 0;
+    for (uint32_t i = 0; i < nmembers; i++) {
+        if (group->members[i] != group) {
+            graph_node_release(table, group->members[i]);
+        }
+    }
+    slapi_ch_free_string(&group->dn);
+}
+
+static int
+graph_is_group_attr(char **attrs, const char *type)
+{
+    for (size_t i = 0; attrs && attrs[i]; i++) {
+        if (slapi_attr_types_equivalent(type, attrs[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Entries the internal searches would not return are not groups */
+static int
+graph_entry_is_group(char **attrs, Slapi_Entry *e)
+{
+    Slapi_Attr *attr = NULL;
+
+    if (e == NULL || slapi_entry_flag_is_set(e, SLAPI_ENTRY_FLAG_TOMBSTONE) ||
+        slapi_entry_attr_hasvalue(e, SLAPI_ATTR_OBJECTCLASS, "ldapsubentry")) {
+        return 0;
+    }
+    for (size_t i = 0; attrs && attrs[i]; i++) {
+        if (slapi_entry_attr_find(e, attrs[i], &attr) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+graph_entry_has_member(char **attrs, Slapi_Entry *e, const struct berval *bv)
+{
+    Slapi_Attr *attr = NULL;
+
+    for (size_t i = 0; attrs && attrs[i]; i++) {
+        if (slapi_entry_attr_find(e, attrs[i], &attr) == 0 &&
+            slapi_attr_value_find(attr, bv) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void
+graph_group_add_value(memberof_graph_table *table, memberof_graph_node *group, Slapi_DN *sdn, const char *value)
+{
+    const char *member_ndn;
+
+    slapi_sdn_set_dn_byref(sdn, value);
+    if ((member_ndn = slapi_sdn_get_ndn(sdn))) {
+        graph_edge_add(table, group, graph_node_get(table, member_ndn, 1));
+    }
+}
+
+/* Replace the members of the group ndn by the values held in e, e may be NULL */
+static void
+graph_group_set(memberof_graph_table *table, char **attrs, const char *ndn, Slapi_Entry *e)
+{
+    memberof_graph_node *group = graph_node_get(table, ndn, 1);
+    Slapi_DN *sdn = NULL;
+
+    graph_group_clear(table, group);
+    if (graph_entry_is_group(attrs, e)) {
+        sdn = slapi_sdn_new();
+        group->dn = slapi_ch_strdup(slapi_entry_get_dn_const(e));
+        for (size_t i = 0; attrs[i]; i++) {
+            Slapi_Attr *attr = NULL;
+            Slapi_Value *v = NULL;
+            int hint;
+
+            if (slapi_entry_attr_find(e, attrs[i], &attr) != 0) {
+                continue;
+            }
+            for (hint = slapi_attr_first_value(attr, &v); v; hint = slapi_attr_next_value(attr, hint, &v)) {
+                graph_group_add_value(table, group, sdn, slapi_value_get_string(v));
+            }
+        }
+        slapi_sdn_free(&sdn);
+    }
+    graph_node_release(table, group);
+}
+
+typedef struct graph_usage
+{
+    uint64_t groups;
+    uint64_t bytes;
+} graph_usage;
+
+static PRIntn
+graph_usage_cb(PLHashEntry *he, PRIntn index __attribute__((unused)), void *arg)
+{
+    memberof_graph_node *node = (memberof_graph_node *)he->value;
+    graph_usage *usage = (graph_usage *)arg;
+
+    if (node->nmembers) {
+        usage->groups++;
+    }
+    usage->bytes += sizeof(PLHashEntry) + sizeof(memberof_graph_node) + strlen(node->ndn) + 1 +
+                    (node->dn ? strlen(node->dn) + 1 : 0) +
+                    sizeof(memberof_graph_node *) * (node->maxgroups + node->maxmembers);
+    return HT_ENUMERATE_NEXT;
+}
+
+static void
+graph_table_usage(memberof_graph_table *table, graph_usage *usage)
+{
+    usage->groups = 0;
+    usage->bytes = sizeof(memberof_graph_table) + sizeof(PLHashTable) +
+                   sizeof(PLHashEntry *) * (1 << (PL_HASH_BITS - table->nodes->shift));
+    PL_HashTableEnumerateEntries(table->nodes, graph_usage_cb, usage);
+}
+
+/*
+ * Building
+ */
+
+typedef struct graph_build_data
+{
+    memberof_graph_table *table;
+    char **attrs;
+    uint64_t generation; /* 0 for the check task */
+} graph_build_data;
+
+static int
+graph_build_cb(Slapi_Entry *e, void *callback_data)
+{
+    graph_build_data *data = (graph_build_data *)callback_data;
+
+    if (slapi_is_shutting_down() ||
+        (data->generation && data->generation != slapi_atomic_load_64(&graph.generation, __ATOMIC_ACQUIRE))) {
+        return -1;
+    }
+    graph_group_set(data->table, data->attrs, slapi_entry_get_ndn(e), e);
+    return 0;
+}
+
+/*
+ * Load every group of the public backends in a new table.
+ * Returns NULL if the build was interrupted.
+ */
+static memberof_graph_table *
+graph_table_build(char **attrs, uint64_t generation)
+{
+    graph_build_data data = {graph_table_new(), attrs, generation};
+    Slapi_Backend *be = NULL;
+    char *filter_str = NULL;
+    char *cookie = NULL;
+    int rc = LDAP_SUCCESS;
+
+    filter_str = slapi_ch_strdup("(|");
+    for (size_t i = 0; attrs[i]; i++) {
+        char *tmp = slapi_ch_smprintf("%s(%s=*)", filter_str, attrs[i]);
+        slapi_ch_free_string(&filter_str);
+        filter_str = tmp;
+    }
+    {
+        char *tmp = slapi_ch_smprintf("%s)", filter_str);
+        slapi_ch_free_string(&filter_str);
+        filter_str = tmp;
+    }
+
+    for (be = slapi_get_first_backend(&cookie); be && rc == LDAP_SUCCESS; be = slapi_get_next_backend(cookie)) {
+        const Slapi_DN *base_sdn = NULL;
+        Slapi_PBlock *search_pb = NULL;
+
+        if (slapi_be_private(be) || (base_sdn = slapi_be_getsuffix(be, 0)) == NULL) {
+            continue;
+        }
+        search_pb = slapi_pblock_new();
+        slapi_search_internal_set_pb(search_pb, slapi_sdn_get_dn(base_sdn), LDAP_SCOPE_SUBTREE,
+                                     filter_str, attrs, 0, NULL, NULL, memberof_get_plugin_id(), 0);
+        slapi_search_internal_callback_pb(search_pb, &data, NULL, graph_build_cb, NULL);
+        slapi_pblock_get(search_pb, SLAPI_PLUGIN_INTOP_RESULT, &rc);
+        slapi_pblock_destroy(search_pb);
+        if (rc == LDAP_NO_SUCH_OBJECT) {
+            /* empty backend */
+            rc = LDAP_SUCCESS;
+        }
+    }
+    slapi_ch_free((void **)&cookie);
+    slapi_ch_free_string(&filter_str);
+
+    if (rc != LDAP_SUCCESS || slapi_is_shutting_down() ||
+        (generation && generation != slapi_atomic_load_64(&graph.generation, __ATOMIC_ACQUIRE))) {
+        if (rc != LDAP_SUCCESS) {
+            slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                          "graph_table_build - Failed to load the groups (%d)\n", rc);
+        }
+        graph_table_free(&data.table);
+    }
+    return data.table;
+}
+
+/* Read the groups from the database, e is NULL if the entry is gone */
+static Slapi_Entry **
+graph_read_entries(char **ndns, char **attrs)
+{
+    size_t count = 0;
+    Slapi_Entry **entries;
+
+    while (ndns[count]) {
+        count++;
+    }
+    entries = (Slapi_Entry **)slapi_ch_calloc(count + 1, sizeof(Slapi_Entry *));
+    for (size_t i = 0; i < count; i++) {
+        Slapi_DN *sdn = slapi_sdn_new_ndn_byref(ndns[i]);
+
+        slapi_search_internal_get_entry(sdn, attrs, &entries[i], memberof_get_plugin_id());
+        slapi_sdn_free(&sdn);
+    }
+    return entries;
+}
+
+static void
+graph_free_entries(Slapi_Entry ***entries, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        slapi_entry_free((*entries)[i]);
+    }
+    slapi_ch_free((void **)entries);
+}
+
+static void
+graph_build_thread(void *arg)
+{
+    memberof_graph_table *table = NULL;
+    time_t start = slapi_current_rel_time_t();
+    uint64_t generation = *(uint64_t *)arg;
+    char **attrs = NULL;
+    graph_usage usage;
+    uint64_t nodes;
+    uint64_t edges;
+
+    slapi_ch_free(&arg);
+    slapi_rwlock_rdlock(graph.lock);
+    if (generation == graph.generation) {
+        attrs = slapi_ch_array_dup(graph.attrs);
+    }
+    slapi_rwlock_unlock(graph.lock);
+    if (attrs == NULL) {
+        goto done;
+    }
+
+    slapi_log_err(SLAPI_LOG_INFO, MEMBEROF_PLUGIN_SUBSYSTEM,
+                  "graph_build_thread - Building the group graph\n");
+    if ((table = graph_table_build(attrs, generation)) == NULL) {
+        slapi_rwlock_wrlock(graph.lock);
+        if (generation == graph.generation) {
+            /* stay on the internal searches until the next rebuild */
+            graph.building = 0;
+            slapi_ch_array_free(graph.dirty);
+            graph.dirty = NULL;
+        }
+        slapi_rwlock_unlock(graph.lock);
+        goto done;
+    }
+
+    /* Groups updated during the build are read again until none is left */
+    while (1) {
+        Slapi_Entry **entries = NULL;
+        char **dirty = NULL;
+        size_t i;
+
+        slapi_rwlock_wrlock(graph.lock);
+        if (generation != graph.generation) {
+            slapi_rwlock_unlock(graph.lock);
+            graph_table_free(&table);
+            goto done;
+        }
+        if (graph.dirty == NULL) {
+            graph.table = table;
+            graph.building = 0;
+            graph_table_usage(table, &usage);
+            nodes = table->node_count;
+            edges = table->edge_count;
+            slapi_rwlock_unlock(graph.lock);
+            break;
+        }
+        dirty = graph.dirty;
+        graph.dirty = NULL;
+        slapi_rwlock_unlock(graph.lock);
+
+        entries = graph_read_entries(dirty, attrs);
+        for (i = 0; dirty[i]; i++) {
+            graph_group_set(table, attrs, dirty[i], entries[i]);
+        }
+        graph_free_entries(&entries, i);
+        slapi_ch_array_free(dirty);
+    }
+
+    slapi_log_err(SLAPI_LOG_INFO, MEMBEROF_PLUGIN_SUBSYSTEM,
+                  "graph_build_thread - Group graph built in %ld seconds: %" PRIu64 " groups, %" PRIu64
+                  " nodes, %" PRIu64 " edges, %" PRIu64 " KB\n",
+                  slapi_current_rel_time_t() - start, usage.groups, nodes, edges,
+                  usage.bytes / 1024);
+
+done:
+    slapi_ch_array_free(attrs);
+    slapi_atomic_decr_64(&graph.builders, __ATOMIC_RELEASE);
+}
+
+/* Re-read groups whose in-memory state may not match the database */
+static void
+graph_resync(char **ndns)
+{
+    Slapi_Entry **entries = NULL;
+    uint64_t generation;
+    char **attrs = NULL;
+    size_t i;
+
+    slapi_rwlock_rdlock(graph.lock);
+    generation = graph.generation;
+    attrs = slapi_ch_array_dup(graph.attrs);
+    slapi_rwlock_unlock(graph.lock);
+    if (attrs == NULL) {
+        return;
+    }
+
+    entries = graph_read_entries(ndns, attrs);
+    slapi_rwlock_wrlock(graph.lock);
+    for (i = 0; ndns[i]; i++) {
+        if (generation != graph.generation) {
+            continue;
+        }
+        if (graph.table) {
+            graph_group_set(graph.table, attrs, ndns[i], entries[i]);
+        } else if (graph.building) {
+            slapi_ch_array_add(&graph.dirty, slapi_ch_strdup(ndns[i]));
+        }
+    }
+    slapi_rwlock_unlock(graph.lock);
+    graph_free_entries(&entries, i);
+    slapi_ch_array_free(attrs);
+}
+
+static int
+graph_attrs_equal(char **a, char **b)
+{
+    size_t i;
+
+    for (i = 0; a && b && a[i] && b[i]; i++) {
+        if (!slapi_attr_types_equivalent(a[i], b[i])) {
+            return 0;
+        }
+    }
+    return (a == NULL || a[i] == NULL) && (b == NULL || b[i] == NULL);
+}
+
+static void
+graph_be_state_change(void *handle __attribute__((unused)), char *be_name, int old_be_state, int new_be_state)
+{
+    /* An import or a restore replaced the content of the backend */
+    if (old_be_state == SLAPI_BE_STATE_OFFLINE && new_be_state == SLAPI_BE_STATE_ON) {
+        slapi_log_err(SLAPI_LOG_INFO, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "graph_be_state_change - Backend %s is back online, rebuilding the group graph\n",
+                      be_name);
+        memberof_graph_rebuild();
+    }
+}
+
+static void
+graph_txn_free(void *arg)
+{
+    memberof_graph_txn *ctx = (memberof_graph_txn *)arg;
+
+    if (ctx) {
+        slapi_ch_array_free(ctx->touched);
+        slapi_ch_free((void **)&ctx);
+    }
+}
+
+static memberof_graph_txn *
+graph_txn_get(int create)
+{
+    memberof_graph_txn *ctx = (memberof_graph_txn *)PR_GetThreadPrivate(graph_txn_index);
+
+    if (ctx == NULL && create) {
+        ctx = (memberof_graph_txn *)slapi_ch_calloc(1, sizeof(memberof_graph_txn));
+        PR_SetThreadPrivate(graph_txn_index, ctx);
+    }
+    return ctx;
+}
+
+/*
+ * Public API
+ */
+
+int
+memberof_graph_init(Slapi_PBlock *pb)
+{
+    if (!graph_txn_index_set) {
+        if (PR_NewThreadPrivateIndex(&graph_txn_index, graph_txn_free) != PR_SUCCESS) {
+            return -1;
+        }
+        graph_txn_index_set = 1;
+    }
+    if ((graph.lock = slapi_new_rwlock()) == NULL) {
+        return -1;
+    }
+    slapi_register_backend_state_change((void *)graph_be_state_change, graph_be_state_change);
+    return slapi_plugin_task_register_handler(MEMBEROF_GRAPH_TASK, graph_task_add, pb);
+}
+
+void
+memberof_graph_close(void)
+{
+    if (graph.lock == NULL) {
+        return;
+    }
+    slapi_plugin_task_unregister_handler(MEMBEROF_GRAPH_TASK, graph_task_add);
+    slapi_unregister_backend_state_change((void *)graph_be_state_change);
+    memberof_graph_configure(NULL, 0);
+    while (slapi_atomic_load_64(&graph.builders, __ATOMIC_ACQUIRE) > 0) {
+        /* Yield to wait for the build threads to give up */
+        DS_Sleep(PR_MillisecondsToInterval(100));
+    }
+    slapi_destroy_rwlock(graph.lock);
+    graph.lock = NULL;
+}
+
+/*
+ * Apply the memberOfGraph and memberOfGroupAttr settings.  The graph is
+ * dropped and rebuilt in the background when either of them changes.
+ * This may run inside a backend transaction, so a running build is not
+ * waited for: it notices the new generation and gives up by itself.
+ */
+void
+memberof_graph_configure(char **attrs, int enabled)
+{
+    uint64_t *generation = NULL;
+    PRThread *thread = NULL;
+
+    if (graph.lock == NULL) {
+        return;
+    }
+    slapi_rwlock_wrlock(graph.lock);
+    if (enabled == graph.enabled && (!enabled || graph_attrs_equal(attrs, graph.attrs))) {
+        slapi_rwlock_unlock(graph.lock);
+        return;
+    }
+    slapi_atomic_incr_64(&graph.generation, __ATOMIC_RELEASE);
+    graph_table_free(&graph.table);
+    slapi_ch_array_free(graph.dirty);
+    graph.dirty = NULL;
+    slapi_ch_array_free(graph.attrs);
+    graph.attrs = slapi_ch_array_dup(attrs);
+    slapi_atomic_store_32(&graph.enabled, enabled, __ATOMIC_RELEASE);
+    graph.building = enabled && attrs;
+    if (graph.building) {
+        generation = (uint64_t *)slapi_ch_malloc(sizeof(uint64_t));
+        *generation = graph.generation;
+        slapi_atomic_incr_64(&graph.builders, __ATOMIC_RELEASE);
+        thread = PR_CreateThread(PR_USER_THREAD, graph_build_thread, (void *)generation,
+                                 PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                 PR_UNJOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+        if (thread == NULL) {
+            slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                          "memberof_graph_configure - Unable to create the graph build thread, "
+                          "falling back to internal searches\n");
+            slapi_atomic_decr_64(&graph.builders, __ATOMIC_RELEASE);
+            slapi_ch_free((void **)&generation);
+            graph.building = 0;
+        }
+    }
+    slapi_rwlock_unlock(graph.lock);
+}
+
+/* Drop the graph and build it again with the current settings */
+void
+memberof_graph_rebuild(void)
+{
+    char **attrs = NULL;
+    int enabled;
+
+    if (graph.lock == NULL) {
+        return;
+    }
+    slapi_rwlock_rdlock(graph.lock);
+    attrs = slapi_ch_array_dup(graph.attrs);
+    enabled = graph.enabled;
+    slapi_rwlock_unlock(graph.lock);
+
+    if (enabled) {
+        memberof_graph_configure(NULL, 0);
+        memberof_graph_configure(attrs, enabled);
+    }
+    slapi_ch_array_free(attrs);
+}
+
+/*
+ * Copy the DNs of the groups listing member_ndn.
+ * Returns the number of groups, or -1 if the graph is not available.
+ */
+int
+memberof_graph_get_groups(const char *member_ndn, char ***group_dns, char ***group_ndns)
+{
+    memberof_graph_node *member = NULL;
+    int count = -1;
+
+    if (graph.lock == NULL || !slapi_atomic_load_32(&graph.enabled, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    slapi_rwlock_rdlock(graph.lock);
+    if (graph.table) {
+        member = graph_node_get(graph.table, member_ndn, 0);
+        count = member ? member->ngroups : 0;
+        *group_dns = (char **)slapi_ch_calloc(count + 1, sizeof(char *));
+        *group_ndns = (char **)slapi_ch_calloc(count + 1, sizeof(char *));
+        for (int i = 0; i < count; i++) {
+            (*group_dns)[i] = slapi_ch_strdup(member->groups[i]->dn ? member->groups[i]->dn : member->groups[i]->ndn);
+            (*group_ndns)[i] = slapi_ch_strdup(member->groups[i]->ndn);
+        }
+    }
+    slapi_rwlock_unlock(graph.lock);
+    return count;
+}
+
+/* Returns 1 if group_ndn lists member_ndn, 0 if not, -1 if the graph is not available */
+int
+memberof_graph_is_direct_member(const char *group_ndn, const char *member_ndn)
+{
+    memberof_graph_node *group = NULL;
+    memberof_graph_node *member = NULL;
+    int rc = -1;
+
+    if (graph.lock == NULL || !slapi_atomic_load_32(&graph.enabled, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    slapi_rwlock_rdlock(graph.lock);
+    if (graph.table) {
+        group = graph_node_get(graph.table, group_ndn, 0);
+        member = graph_node_get(graph.table, member_ndn, 0);
+        rc = (group && member) ? graph_edge_exists(group, member) : 0;
+    }
+    slapi_rwlock_unlock(graph.lock);
+    return rc;
+}
+
+static void
+graph_record(memberof_graph_txn *ctx, const char *ndn)
+{
+    if (ctx) {
+        slapi_ch_array_add(&ctx->touched, slapi_ch_strdup(ndn));
+    } else if (graph.building) {
+        slapi_ch_array_add(&graph.dirty, slapi_ch_strdup(ndn));
+    }
+}
+
+static void
+graph_apply_modify(memberof_graph_table *table, char **attrs, Slapi_Entry *e, LDAPMod **mods)
+{
+    const char *ndn = slapi_entry_get_ndn(e);
+    memberof_graph_node *group = NULL;
+    Slapi_DN *sdn = NULL;
+
+    /* deleting all the values or replacing them: start over from the entry */
+    for (size_t i = 0; mods[i]; i++) {
+        int op = mods[i]->mod_op & ~LDAP_MOD_BVALUES;
+
+        if (graph_is_group_attr(attrs, mods[i]->mod_type) &&
+            (op == LDAP_MOD_REPLACE || (op == LDAP_MOD_DELETE &&
+                                        (mods[i]->mod_bvalues == NULL || mods[i]->mod_bvalues[0] == NULL)))) {
+            graph_group_set(table, attrs, ndn, e);
+            return;
+        }
+    }
+
+    sdn = slapi_sdn_new();
+    group = graph_node_get(table, ndn, 1);
+    if (group->dn == NULL) {
+        group->dn = slapi_ch_strdup(slapi_entry_get_dn_const(e));
+    }
+    for (size_t i = 0; mods[i]; i++) {
+        int op = mods[i]->mod_op & ~LDAP_MOD_BVALUES;
+
+        if (!graph_is_group_attr(attrs, mods[i]->mod_type) || mods[i]->mod_bvalues == NULL) {
+            continue;
+        }
+        for (size_t j = 0; mods[i]->mod_bvalues[j]; j++) {
+            struct berval *bv = mods[i]->mod_bvalues[j];
+            memberof_graph_node *member = NULL;
+            char *value = slapi_ch_malloc(bv->bv_len + 1);
+
+            memcpy(value, bv->bv_val, bv->bv_len);
+            value[bv->bv_len] = '\0';
+            if (op == LDAP_MOD_ADD) {
+                graph_group_add_value(table, group, sdn, value);
+            } else if (op == LDAP_MOD_DELETE && !graph_entry_has_member(attrs, e, bv)) {
+                /* the value may still be listed by another grouping attribute */
+                slapi_sdn_set_dn_byref(sdn, value);
+                if (slapi_sdn_get_ndn(sdn) &&
+                    (member = graph_node_get(table, slapi_sdn_get_ndn(sdn), 0))) {
+                    graph_edge_remove(table, group, member);
+                    if (member != group) {
+                        graph_node_release(table, member);
+                    }
+                }
+            }
+            slapi_sdn_done(sdn);
+            slapi_ch_free_string(&value);
+        }
+    }
+    slapi_sdn_free(&sdn);
+    if (group->nmembers == 0) {
+        slapi_ch_free_string(&group->dn);
+    }
+    graph_node_release(table, group);
+}
+
+/*
+ * Called from the post-op callbacks, before any filtering on the caller,
+ * so the changes done by the plugin itself are also applied.
+ */
+void
+memberof_graph_update(Slapi_PBlock *pb)
+{
+    memberof_graph_txn *ctx = NULL;
+    Slapi_Entry *pre_e = NULL;
+    Slapi_Entry *post_e = NULL;
+    LDAPMod **mods = NULL;
+    int optype = 0;
+    int oprc = 0;
+    int involved = 0;
+
+    if (graph.lock == NULL || !slapi_atomic_load_32(&graph.enabled, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    slapi_pblock_get(pb, SLAPI_PLUGIN_OPRETURN, &oprc);
+    if (oprc != 0) {
+        return;
+    }
+    slapi_pblock_get(pb, SLAPI_OPERATION_TYPE, &optype);
+    slapi_pblock_get(pb, SLAPI_ENTRY_PRE_OP, &pre_e);
+    slapi_pblock_get(pb, SLAPI_ENTRY_POST_OP, &post_e);
+
+    /* most updates do not touch a grouping attribute */
+    slapi_rwlock_rdlock(graph.lock);
+    switch (optype) {
+    case SLAPI_OPERATION_ADD:
+        involved = graph_entry_is_group(graph.attrs, post_e);
+        break;
+    case SLAPI_OPERATION_DELETE:
+        involved = graph_entry_is_group(graph.attrs, pre_e);
+        break;
+    case SLAPI_OPERATION_MODRDN:
+        involved = pre_e && post_e &&
+                   (graph_entry_is_group(graph.attrs, pre_e) || graph_entry_is_group(graph.attrs, post_e));
+        break;
+    case SLAPI_OPERATION_MODIFY:
+        slapi_pblock_get(pb, SLAPI_MODIFY_MODS, &mods);
+        for (size_t i = 0; post_e && mods && mods[i] && !involved; i++) {
+            involved = graph_is_group_attr(graph.attrs, mods[i]->mod_type);
+        }
+        break;
+    default:
+        break;
+    }
+    slapi_rwlock_unlock(graph.lock);
+    if (!involved) {
+        return;
+    }
+
+    if (memberof_use_txn() && (ctx = graph_txn_get(0)) && ctx->owner == NULL) {
+        ctx = NULL;
+    }
+
+    slapi_rwlock_wrlock(graph.lock);
+    switch (optype) {
+    case SLAPI_OPERATION_ADD:
+        if (graph.table) {
+            graph_group_set(graph.table, graph.attrs, slapi_entry_get_ndn(post_e), post_e);
+        }
+        graph_record(ctx, slapi_entry_get_ndn(post_e));
+        break;
+    case SLAPI_OPERATION_DELETE:
+        if (graph.table) {
+            graph_group_set(graph.table, graph.attrs, slapi_entry_get_ndn(pre_e), NULL);
+        }
+        graph_record(ctx, slapi_entry_get_ndn(pre_e));
+        break;
+    case SLAPI_OPERATION_MODRDN:
+        /* the groups listing the old DN keep it until they are updated */
+        if (graph.table) {
+            graph_group_set(graph.table, graph.attrs, slapi_entry_get_ndn(pre_e), NULL);
+            graph_group_set(graph.table, graph.attrs, slapi_entry_get_ndn(post_e), post_e);
+        }
+        graph_record(ctx, slapi_entry_get_ndn(pre_e));
+        graph_record(ctx, slapi_entry_get_ndn(post_e));
+        break;
+    case SLAPI_OPERATION_MODIFY:
+        if (graph.table) {
+            graph_apply_modify(graph.table, graph.attrs, post_e, mods);
+        }
+        graph_record(ctx, slapi_entry_get_ndn(post_e));
+        break;
+    }
+    slapi_rwlock_unlock(graph.lock);
+}
+
+/* betxn pre-op: remember the outermost operation of the transaction */
+int
+memberof_graph_txn_begin(Slapi_PBlock *pb)
+{
+    memberof_graph_txn *ctx = NULL;
+    Slapi_Operation *op = NULL;
+
+    if (graph.lock == NULL || !slapi_atomic_load_32(&graph.enabled, __ATOMIC_ACQUIRE)) {
+        return SLAPI_PLUGIN_SUCCESS;
+    }
+    slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    ctx = graph_txn_get(1);
+    if (ctx->owner == NULL) {
+        ctx->owner = op;
+        ctx->retried = 0;
+    } else if (ctx->owner == op) {
+        /* the transaction was aborted and is being retried */
+        ctx->retried = 1;
+    }
+    return SLAPI_PLUGIN_SUCCESS;
+}
+
+/* be post-op: the transaction is over, committed or not */
+int
+memberof_graph_txn_end(Slapi_PBlock *pb)
+{
+    memberof_graph_txn *ctx = graph_txn_get(0);
+    Slapi_Operation *op = NULL;
+    char **touched = NULL;
+    int result = LDAP_SUCCESS;
+    int oprc = 0;
+
+    slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    if (ctx == NULL || ctx->owner == NULL || ctx->owner != op) {
+        return SLAPI_PLUGIN_SUCCESS;
+    }
+    touched = ctx->touched;
+    ctx->touched = NULL;
+    ctx->owner = NULL;
+    if (touched == NULL) {
+        return SLAPI_PLUGIN_SUCCESS;
+    }
+
+    slapi_pblock_get(pb, SLAPI_RESULT_CODE, &result);
+    slapi_pblock_get(pb, SLAPI_PLUGIN_OPRETURN, &oprc);
+    slapi_rwlock_wrlock(graph.lock);
+    if (graph.building) {
+        /* the builder may have read these groups before the commit */
+        for (size_t i = 0; touched[i]; i++) {
+            slapi_ch_array_add(&graph.dirty, slapi_ch_strdup(touched[i]));
+        }
+    }
+    slapi_rwlock_unlock(graph.lock);
+    if (result != LDAP_SUCCESS || oprc != 0 || ctx->retried) {
+        graph_resync(touched);
+    }
+    slapi_ch_array_free(touched);
+    return SLAPI_PLUGIN_SUCCESS;
+}
+
+/*
+ * Consistency check task
+ *
+ * dn: cn=check, cn=memberof graph check, cn=tasks, cn=config
+ * objectClass: extensibleObject
+ * cn: check
+ * repair: yes
+ *
+ * Loads the groups from the database and compares them with the graph,
+ * updates happening during the check may show up as differences.
+ */
+
+typedef struct graph_diff
+{
+    memberof_graph_table *other;
+    uint64_t missing;
+    Slapi_Task *task;
+} graph_diff;
+
+/* Count the edges of he that do not exist in data->other */
+static PRIntn
+graph_diff_cb(PLHashEntry *he, PRIntn index __attribute__((unused)), void *arg)
+{
+    memberof_graph_node *group = (memberof_graph_node *)he->value;
+    graph_diff *diff = (graph_diff *)arg;
+    memberof_graph_node *other_group = NULL;
+
+    if (group->nmembers == 0) {
+        return HT_ENUMERATE_NEXT;
+    }
+    other_group = graph_node_get(diff->other, group->ndn, 0);
+    for (uint32_t i = 0; i < group->nmembers; i++) {
+        memberof_graph_node *other_member = graph_node_get(diff->other, group->members[i]->ndn, 0);
+
+        if (other_group == NULL || other_member == NULL || !graph_edge_exists(other_group, other_member)) {
+            if (diff->missing++ < 10) {
+                slapi_task_log_notice(diff->task, "%s -> %s", group->ndn, group->members[i]->ndn);
+            }
+        }
+    }
+    return HT_ENUMERATE_NEXT;
+}
+
+static void
+graph_task_thread(void *arg)
+{
+    Slapi_Task *task = (Slapi_Task *)arg;
+    memberof_graph_task_data *td = (memberof_graph_task_data *)slapi_task_get_data(task);
+    memberof_graph_table *fresh = NULL;
+    graph_diff stale = {0};
+    graph_diff missing = {0};
+    graph_usage usage = {0};
+    uint64_t nodes = 0;
+    uint64_t edges = 0;
+    char **attrs = NULL;
+    int rc = 0;
+
+    slapi_task_inc_refcount(task);
+    slapi_td_set_dn(slapi_ch_strdup(td->bind_dn));
+    slapi_task_begin(task, 1);
+
+    slapi_rwlock_rdlock(graph.lock);
+    attrs = slapi_ch_array_dup(graph.attrs);
+    slapi_rwlock_unlock(graph.lock);
+
+    if (attrs == NULL || (fresh = graph_table_build(attrs, 0)) == NULL) {
+        slapi_task_log_notice(task, "Memberof graph check failed to load the groups");
+        rc = -1;
+        goto done;
+    }
+
+    slapi_rwlock_rdlock(graph.lock);
+    if (graph.table == NULL) {
+        slapi_rwlock_unlock(graph.lock);
+        slapi_task_log_notice(task, "Memberof graph is not available (%s)",
+                              graph.enabled ? "building" : "disabled");
+        goto done;
+    }
+    stale.other = fresh;
+    stale.task = task;
+    slapi_task_log_notice(task, "Edges in the graph but not in the database:");
+    PL_HashTableEnumerateEntries(graph.table->nodes, graph_diff_cb, &stale);
+    missing.other = graph.table;
+    missing.task = task;
+    slapi_task_log_notice(task, "Edges in the database but not in the graph:");
+    PL_HashTableEnumerateEntries(fresh->nodes, graph_diff_cb, &missing);
+    graph_table_usage(graph.table, &usage);
+    nodes = graph.table->node_count;
+    edges = graph.table->edge_count;
+    slapi_rwlock_unlock(graph.lock);
+
+    slapi_task_log_notice(task, "Memberof graph: %" PRIu64 " groups, %" PRIu64 " nodes, %" PRIu64
+                          " edges, %" PRIu64 " KB, %" PRIu64 " stale edges, %" PRIu64 " missing edges",
+                          usage.groups, nodes, edges, usage.bytes / 1024, stale.missing, missing.missing);
+    slapi_log_err(SLAPI_LOG_INFO, MEMBEROF_PLUGIN_SUBSYSTEM,
+                  "graph_task_thread - %" PRIu64 " groups, %" PRIu64 " nodes, %" PRIu64 " edges, %" PRIu64
+                  " KB, %" PRIu64 " stale edges, %" PRIu64 " missing edges\n",
+                  usage.groups, nodes, edges, usage.bytes / 1024, stale.missing, missing.missing);
+
+    if (stale.missing || missing.missing) {
+        rc = td->repair ? 0 : LDAP_COMPARE_FALSE;
+        if (td->repair) {
+            slapi_task_log_notice(task, "Rebuilding the memberof graph");
+            memberof_graph_rebuild();
+        }
+    }
+
+done:
+    graph_table_free(&fresh);
+    slapi_ch_array_free(attrs);
+    slapi_task_log_status(task, "Memberof graph check finished (%" PRIu64 " stale, %" PRIu64 " missing edges)",
+                          stale.missing, missing.missing);
+    slapi_task_inc_progress(task);
+    slapi_task_finish(task, rc);
+    slapi_task_dec_refcount(task);
+}
+
+static void
+graph_task_destructor(Slapi_Task *task)
+{
+    if (task) {
+        memberof_graph_task_data *td = (memberof_graph_task_data *)slapi_task_get_data(task);
+
+        while (slapi_task_get_refcount(task) > 0) {
+            /* Yield to wait for the check to finish */
+            DS_Sleep(PR_MillisecondsToInterval(100));
+        }
+        if (td) {
+            slapi_ch_free_string(&td->bind_dn);
+            slapi_ch_free((void **)&td);
+        }
+    }
+}
+
+static int
+graph_task_add(Slapi_PBlock *pb,
+               Slapi_Entry *e,
+               Slapi_Entry *eAfter __attribute__((unused)),
+               int *returncode,
+               char *returntext,
+               void *arg)
+{
+    memberof_graph_task_data *td = NULL;
+    Slapi_Task *task = NULL;
+    PRThread *thread = NULL;
+    const char *repair = NULL;
+    char *bind_dn = NULL;
+
+    *returncode = LDAP_SUCCESS;
+    if (!slapi_atomic_load_32(&graph.enabled, __ATOMIC_ACQUIRE)) {
+        PR_snprintf(returntext, SLAPI_DSE_RETURNTEXT_SIZE, "%s is not enabled", MEMBEROF_GRAPH_ATTR);
+        *returncode = LDAP_UNWILLING_TO_PERFORM;
+        return SLAPI_DSE_CALLBACK_ERROR;
+    }
+
+    repair = slapi_entry_attr_get_ref(e, "repair");
+    slapi_pblock_get(pb, SLAPI_REQUESTOR_DN, &bind_dn);
+    td = (memberof_graph_task_data *)slapi_ch_calloc(1, sizeof(memberof_graph_task_data));
+    td->bind_dn = slapi_ch_strdup(bind_dn);
+    td->repair = repair && (strcasecmp(repair, "yes") == 0 || strcasecmp(repair, "on") == 0);
+
+    task = slapi_plugin_new_task(slapi_entry_get_ndn(e), arg);
+    slapi_task_set_destructor_fn(task, graph_task_destructor);
+    slapi_task_set_data(task, td);
+
+    thread = PR_CreateThread(PR_USER_THREAD, graph_task_thread, (void *)task,
+                             PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                             PR_UNJOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+    if (thread == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "graph_task_add - Unable to create task thread!\n");
+        *returncode = LDAP_OPERATIONS_ERROR;
+        slapi_task_finish(task, *returncode);
+        return SLAPI_DSE_CALLBACK_ERROR;
+    }
+    return SLAPI_DSE_CALLBACK_OK;
+}
@@ -183,6 +183,279 @@ pbkdf2_sha256_hash(char *hash_out, size_t hash_out_len, SECItem *pwd, SECItem *s
     return SECSuccess;
 }
 
+/*
+ * Internal PBKDF2-HMAC-SHA256.
+ *
+ * The 256 bytes of our hash are 8 independent PBKDF2 blocks of 32 bytes, each
+ * one iterating HMAC-SHA256 on its own. Rather than computing them one after
+ * the other, we compute the 8 blocks side by side: every SHA-256 word is a
+ * vector holding that word for the 8 blocks, so one compression function run
+ * advances the 8 blocks at once. On x86_64 a vector fits an AVX2 register and
+ * an AVX2 clone of the kernel is picked at load time when the cpu has it.
+ *
+ * In FIPS mode we keep going through the NSS module.
+ */
+
+#define PBKDF2_LANES 8
+#define PBKDF2_BLOCK_LENGTH 32 /* SHA-256 digest */
+
+typedef uint32_t pbkdf2_lanes_t __attribute__((vector_size(PBKDF2_LANES * sizeof(uint32_t))));
+
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define PBKDF2_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#endif
+#endif
+#ifndef PBKDF2_TARGET_CLONES
+#define PBKDF2_TARGET_CLONES
+#endif
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+#define pbkdf2_splat(x) ((pbkdf2_lanes_t){(x), (x), (x), (x), (x), (x), (x), (x)})
+
+#define PBKDF2_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static inline __attribute__((always_inline)) void
+pbkdf2_sha256_compress(pbkdf2_lanes_t state[8], const pbkdf2_lanes_t block[16])
+{
+    pbkdf2_lanes_t w[64];
+    pbkdf2_lanes_t a = state[0], b = state[1], c = state[2], d = state[3];
+    pbkdf2_lanes_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (size_t t = 0; t < 16; t++) {
+        w[t] = block[t];
+    }
+    for (size_t t = 16; t < 64; t++) {
+        pbkdf2_lanes_t s0 = PBKDF2_ROTR(w[t - 15], 7) ^ PBKDF2_ROTR(w[t - 15], 18) ^ (w[t - 15] >> 3);
+        pbkdf2_lanes_t s1 = PBKDF2_ROTR(w[t - 2], 17) ^ PBKDF2_ROTR(w[t - 2], 19) ^ (w[t - 2] >> 10);
+        w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+    }
+    for (size_t t = 0; t < 64; t++) {
+        pbkdf2_lanes_t t1 = h + (PBKDF2_ROTR(e, 6) ^ PBKDF2_ROTR(e, 11) ^ PBKDF2_ROTR(e, 25)) +
+                            ((e & f) ^ (~e & g)) + pbkdf2_splat(sha256_k[t]) + w[t];
+        pbkdf2_lanes_t t2 = (PBKDF2_ROTR(a, 2) ^ PBKDF2_ROTR(a, 13) ^ PBKDF2_ROTR(a, 22)) +
+                            ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+/*
+ * One HMAC-SHA256 of a 32 bytes message (the previous digest, in place in
+ * u) from the precomputed inner and outer pad states.
+ */
+static inline __attribute__((always_inline)) void
+pbkdf2_sha256_hmac32(pbkdf2_lanes_t u[8], const pbkdf2_lanes_t istate[8], const pbkdf2_lanes_t ostate[8])
+{
+    pbkdf2_lanes_t block[16];
+    pbkdf2_lanes_t state[8];
+
+    for (size_t round = 0; round < 2; round++) {
+        for (size_t j = 0; j < 8; j++) {
+            block[j] = u[j];
+            state[j] = round ? ostate[j] : istate[j];
+        }
+        block[8] = pbkdf2_splat(0x80000000);
+        for (size_t j = 9; j < 15; j++) {
+            block[j] = pbkdf2_splat(0);
+        }
+        block[15] = pbkdf2_splat((64 + PBKDF2_BLOCK_LENGTH) * 8);
+        pbkdf2_sha256_compress(state, block);
+        for (size_t j = 0; j < 8; j++) {
+            u[j] = state[j];
+        }
+    }
+}
+
+/* Byte pos of the padded salt || INT(block) message of the inner first HMAC */
+static inline unsigned char
+pbkdf2_first_msg_byte(const unsigned char *salt, size_t salt_len, uint32_t block, size_t padded_len, size_t pos)
+{
+    uint64_t bits = (64 + salt_len + 4) * 8;
+
+    if (pos < salt_len) {
+        return salt[pos];
+    }
+    if (pos < salt_len + 4) {
+        return (unsigned char)(block >> (8 * (3 - (pos - salt_len))));
+    }
+    if (pos == salt_len + 4) {
+        return 0x80;
+    }
+    if (pos >= padded_len - 8) {
+        return (unsigned char)(bits >> (8 * (padded_len - 1 - pos)));
+    }
+    return 0;
+}
+
+/*
+ * Computes the PBKDF2 blocks first_block to first_block + PBKDF2_LANES - 1
+ * into out (PBKDF2_LANES * PBKDF2_BLOCK_LENGTH bytes).
+ */
+PBKDF2_TARGET_CLONES static void
+pbkdf2_sha256_lanes(unsigned char *out, const uint32_t ipad[8], const uint32_t opad[8], const unsigned char *salt, size_t salt_len, uint32_t first_block, uint32_t iterations)
+{
+    size_t padded_len = (salt_len + 4 + 1 + 8 + 63) & ~(size_t)63;
+    pbkdf2_lanes_t istate[8];
+    pbkdf2_lanes_t ostate[8];
+    pbkdf2_lanes_t state[8];
+    pbkdf2_lanes_t block[16];
+    pbkdf2_lanes_t u[8];
+    pbkdf2_lanes_t t[8];
+
+    for (size_t j = 0; j < 8; j++) {
+        istate[j] = pbkdf2_splat(ipad[j]);
+        ostate[j] = pbkdf2_splat(opad[j]);
+        state[j] = istate[j];
+    }
+
+    /* U1 = HMAC(P, S || INT(i)), its inner hash first */
+    for (size_t offset = 0; offset < padded_len; offset += 64) {
+        for (size_t j = 0; j < 16; j++) {
+            for (size_t l = 0; l < PBKDF2_LANES; l++) {
+                uint32_t word = 0;
+                for (size_t k = 0; k < 4; k++) {
+                    word = (word << 8) | pbkdf2_first_msg_byte(salt, salt_len, first_block + l, padded_len, offset + j * 4 + k);
+                }
+                block[j][l] = word;
+            }
+        }
+        pbkdf2_sha256_compress(state, block);
+    }
+    for (size_t j = 0; j < 8; j++) {
+        block[j] = state[j];
+        state[j] = ostate[j];
+    }
+    block[8] = pbkdf2_splat(0x80000000);
+    for (size_t j = 9; j < 15; j++) {
+        block[j] = pbkdf2_splat(0);
+    }
+    block[15] = pbkdf2_splat((64 + PBKDF2_BLOCK_LENGTH) * 8);
+    pbkdf2_sha256_compress(state, block);
+    for (size_t j = 0; j < 8; j++) {
+        u[j] = state[j];
+        t[j] = state[j];
+    }
+
+    /* T = U1 ^ U2 ^ ... ^ Uc */
+    for (uint32_t i = 1; i < iterations; i++) {
+        pbkdf2_sha256_hmac32(u, istate, ostate);
+        for (size_t j = 0; j < 8; j++) {
+            t[j] ^= u[j];
+        }
+    }
+
+    for (size_t l = 0; l < PBKDF2_LANES; l++) {
+        for (size_t j = 0; j < 8; j++) {
+            uint32_t word = htonl(t[j][l]);
+            memcpy(out + l * PBKDF2_BLOCK_LENGTH + j * 4, &word, 4);
+        }
+    }
+}
+
+/* The state of SHA-256 after the key ^ pad block, the same for all the blocks */
+static void
+pbkdf2_sha256_pad_state(uint32_t pad_state[8], const unsigned char *key, size_t key_len, unsigned char pad)
+{
+    pbkdf2_lanes_t state[8];
+    pbkdf2_lanes_t block[16];
+
+    for (size_t j = 0; j < 8; j++) {
+        state[j] = pbkdf2_splat(sha256_iv[j]);
+    }
+    for (size_t j = 0; j < 16; j++) {
+        uint32_t word = 0;
+        for (size_t k = 0; k < 4; k++) {
+            size_t pos = j * 4 + k;
+            word = (word << 8) | ((pos < key_len ? key[pos] : 0) ^ pad);
+        }
+        block[j] = pbkdf2_splat(word);
+    }
+    pbkdf2_sha256_compress(state, block);
+    for (size_t j = 0; j < 8; j++) {
+        pad_state[j] = state[j][0];
+    }
+}
+
+/*
+ * Same result as pbkdf2_sha256_hash, computed by the internal multi lanes
+ * implementation.
+ */
+SECStatus
+pbkdf2_sha256_hash_lanes(char *hash_out, size_t hash_out_len, SECItem *pwd, SECItem *salt, uint32_t iterations)
+{
+    unsigned char out[PBKDF2_LANES * PBKDF2_BLOCK_LENGTH];
+    unsigned char keyhash[PBKDF2_BLOCK_LENGTH];
+    const unsigned char *key = pwd->data;
+    size_t key_len = pwd->len;
+    uint32_t ipad[8];
+    uint32_t opad[8];
+    uint32_t block = 1;
+
+    if (iterations == 0 || hash_out_len == 0) {
+        return SECFailure;
+    }
+    /* HMAC keys longer than the SHA-256 block are hashed first */
+    if (key_len > 64) {
+        if (PK11_HashBuf(SEC_OID_SHA256, keyhash, pwd->data, pwd->len) != SECSuccess) {
+            slapi_log_err(SLAPI_LOG_ERR, "pbkdf2_sha256_hash_lanes", "Unable to hash the password.\n");
+            return SECFailure;
+        }
+        key = keyhash;
+        key_len = sizeof(keyhash);
+    }
+    pbkdf2_sha256_pad_state(ipad, key, key_len, 0x36);
+    pbkdf2_sha256_pad_state(opad, key, key_len, 0x5c);
+
+    for (size_t offset = 0; offset < hash_out_len; offset += sizeof(out), block += PBKDF2_LANES) {
+        size_t len = hash_out_len - offset < sizeof(out) ? hash_out_len - offset : sizeof(out);
+
+        pbkdf2_sha256_lanes(out, ipad, opad, salt->data, salt->len, block, iterations);
+        memcpy(hash_out + offset, out, len);
+    }
+    memset(out, 0, sizeof(out));
+    memset(keyhash, 0, sizeof(keyhash));
+    memset(ipad, 0, sizeof(ipad));
+    memset(opad, 0, sizeof(opad));
+
+    return SECSuccess;
+}
+
+static SECStatus
+pbkdf2_sha256_derive(char *hash_out, size_t hash_out_len, SECItem *pwd, SECItem *salt, uint32_t iterations)
+{
+    if (PK11_IsFIPS()) {
+        return pbkdf2_sha256_hash(hash_out, hash_out_len, pwd, salt, iterations);
+    }
+    return pbkdf2_sha256_hash_lanes(hash_out, hash_out_len, pwd, salt, iterations);
+}
+
 char *
 pbkdf2_sha256_pw_enc_rounds(const char *pwd, uint32_t iterations)
 {
@@ -218,7 +491,7 @@ pbkdf2_sha256_pw_enc_rounds(const char *pwd, uint32_t iterations)
      *                      This offset is to make the hash function put the values
      *                      In the correct part of the memory.
      */
-    if (pbkdf2_sha256_hash(hash + PBKDF2_ITERATIONS_LENGTH + PBKDF2_SALT_LENGTH, PBKDF2_HASH_LENGTH, &passItem, &saltItem, PBKDF2_ITERATIONS) != SECSuccess) {
+    if (pbkdf2_sha256_derive(hash + PBKDF2_ITERATIONS_LENGTH + PBKDF2_SALT_LENGTH, PBKDF2_HASH_LENGTH, &passItem, &saltItem, PBKDF2_ITERATIONS) != SECSuccess) {
         slapi_log_err(SLAPI_LOG_ERR, (char *)schemeName, "Could not generate pbkdf2_sha256_hash!\n");
         slapi_ch_free_string(&enc);
         return NULL;
@@ -264,7 +537,7 @@ pbkdf2_sha256_pw_cmp(const char *userpwd, const char *dbpwd)
     pbkdf2_sha256_extract(dbhash, &saltItem, &iterations);
 
     /* Now send the userpw to the hash function, with the salt + iter. */
-    if (pbkdf2_sha256_hash(userhash, PBKDF2_HASH_LENGTH, &passItem, &saltItem, iterations) != SECSuccess) {
+    if (pbkdf2_sha256_derive(userhash, PBKDF2_HASH_LENGTH, &passItem, &saltItem, iterations) != SECSuccess) {
         slapi_log_err(SLAPI_LOG_ERR, (char *)schemeName, "Unable to hash userpwd value\n");
         return result;
     }
@@ -21,6 +21,7 @@
 #include "prerror.h"
 #include "prcvar.h"
 #include "prio.h"
+#include "plhash.h"
 #include <sys/stat.h>
 
 #define REFERINT_DEFAULT_FILE_MODE S_IRUSR | S_IWUSR
@@ -30,9 +31,19 @@
 #define REFERINT_ATTR_LOGFILE     "referint-logfile"
 #define REFERINT_ATTR_MEMBERSHIP  "referint-membership-attr"
 #define MAX_LINE     2048
-#define READ_BUFSIZE 4096
-#define MY_EOF  0
+#define READ_BUFSIZE 65536
 #define STARTUP 2
+#define REFERINT_BATCH_SIZE 256 /* deleted DNs processed together */
+#define REFERINT_PROCESSING_SUFFIX ".processing"
+
+/* buffered reader of the integrity log */
+typedef struct referint_reader
+{
+    PRFileDesc *fd;
+    int pos;
+    int len;
+    char buf[READ_BUFSIZE];
+} referint_reader;
 
 typedef struct referint_config
 {
@@ -50,8 +61,8 @@ int referint_postop_modrdn(Slapi_PBlock *pb);
 int referint_postop_start(Slapi_PBlock *pb);
 int referint_postop_close(Slapi_PBlock *pb);
 int update_integrity(Slapi_DN *sDN, char *newrDN, Slapi_DN *newsuperior, Slapi_PBlock *pb);
-int GetNextLine(char *dest, int size_dest, PRFileDesc *stream);
-int my_fgetc(PRFileDesc *stream);
+static int update_integrity_batch(Slapi_DN **sdns, int count);
+int GetNextLine(char *dest, int size_dest, referint_reader *reader);
 void referint_thread_func(void *arg);
 void writeintegritylog(Slapi_PBlock *pb, char *logfilename, Slapi_DN *sdn, char *newrdn, Slapi_DN *newsuperior, Slapi_DN *requestorsdn);
 int load_config(Slapi_PBlock *pb, Slapi_Entry *config_entry, int apply);
@@ -89,15 +100,14 @@ static int use_txn = 0;
 static int premodfn = SLAPI_PLUGIN_PRE_MODIFY_FN;
 
 
+/*
+ * Protects the integrity log file.  It is only held while a record is
+ * appended or while the log is renamed for processing, never across
+ * internal operations, so it is also safe with betxn.
+ */
 static void
 referint_lock(void)
 {
-    if (use_txn) { /* no lock if betxn is enabled */
-        return;
-    }
-    if (NULL == referint_mutex) {
-        referint_mutex = PR_NewLock();
-    }
     if (referint_mutex) {
         PR_Lock(referint_mutex);
     }
@@ -106,9 +116,6 @@ referint_lock(void)
 static void
 referint_unlock(void)
 {
-    if (use_txn) { /* no lock if betxn is enabled */
-        return;
-    }
     if (referint_mutex) {
         PR_Unlock(referint_mutex);
     }
@@ -1232,6 +1239,171 @@ free_and_return:
     return (rc);
 }
 
+/*
+ * Remove the references to a batch of deleted entries.  Instead of one
+ * search per membership attribute and per deleted DN, a single search per
+ * suffix matches every membership attribute against every DN of the batch,
+ * and each referring entry gets one modify removing all its stale values.
+ */
+static int
+update_integrity_batch(Slapi_DN **sdns, int count)
+{
+    Slapi_PBlock *search_result_pb = NULL;
+    Slapi_PBlock *mod_pb = NULL;
+    Slapi_Entry **search_entries = NULL;
+    PLHashTable *deleted = NULL;
+    Slapi_DN *sdn = NULL;
+    void *node = NULL;
+    const char *search_base = NULL;
+    char **membership_attrs = NULL;
+    char **terms = NULL;
+    char *filter = NULL;
+    char *p;
+    size_t len = 4; /* "(|", ")" and '\0' */
+    int nterms = 0;
+    int search_result;
+    int i, j;
+    int rc = SLAPI_PLUGIN_SUCCESS;
+
+    membership_attrs = referint_get_attrs();
+    if (membership_attrs == NULL || count == 0) {
+        goto free_and_return;
+    }
+    deleted = PL_NewHashTable(count * 2, PL_HashString, PL_CompareStrings,
+                              PL_CompareValues, NULL, NULL);
+    for (j = 0; j < count; j++) {
+        PL_HashTableAdd(deleted, slapi_sdn_get_ndn(sdns[j]), sdns[j]);
+    }
+
+    /* (|(attr1=dn1)(attr2=dn1)...(attr1=dnN)(attr2=dnN)) */
+    for (i = 0; membership_attrs[i] != NULL; i++)
+        ;
+    terms = (char **)slapi_ch_calloc(i * count + 1, sizeof(char *));
+    for (i = 0; membership_attrs[i] != NULL; i++) {
+        for (j = 0; j < count; j++) {
+            terms[nterms] = slapi_filter_sprintf("(%s=%s%s)", membership_attrs[i], ESC_NEXT_VAL,
+                                                 slapi_sdn_get_dn(sdns[j]));
+            if (terms[nterms]) {
+                len += strlen(terms[nterms]);
+                nterms++;
+            }
+        }
+    }
+    filter = p = (char *)slapi_ch_malloc(len);
+    p = stpcpy(p, "(|");
+    for (i = 0; i < nterms; i++) {
+        p = stpcpy(p, terms[i]);
+    }
+    strcpy(p, ")");
+
+    search_result_pb = slapi_pblock_new();
+    mod_pb = slapi_pblock_new();
+
+    /* Search each namingContext in turn
+     * or use the defined scope(s)
+     */
+    if (plugin_ContainerScope) {
+        sdn = plugin_ContainerScope;
+    } else {
+        sdn = slapi_get_first_suffix(&node, 0);
+    }
+    while (sdn) {
+        Slapi_Backend *be = slapi_be_select(sdn);
+        search_base = slapi_sdn_get_dn(sdn);
+
+        slapi_pblock_init(search_result_pb);
+        slapi_pblock_set(search_result_pb, SLAPI_BACKEND, be);
+        slapi_search_internal_set_pb(search_result_pb, search_base,
+                                     LDAP_SCOPE_SUBTREE, filter, membership_attrs, 0 /* attrs only */,
+                                     NULL, NULL, referint_plugin_identity, 0);
+        slapi_search_internal_pb(search_result_pb);
+        slapi_pblock_get(search_result_pb, SLAPI_PLUGIN_INTOP_RESULT, &search_result);
+
+        if (search_result == LDAP_SUCCESS) {
+            slapi_pblock_get(search_result_pb, SLAPI_PLUGIN_INTOP_SEARCH_ENTRIES,
+                             &search_entries);
+
+            for (j = 0; search_entries[j] != NULL; j++) {
+                Slapi_Mods *smods = slapi_mods_new();
+                Slapi_Attr *attr = NULL;
+                char *attrName = NULL;
+
+                for (slapi_entry_first_attr(search_entries[j], &attr); attr;
+                     slapi_entry_next_attr(search_entries[j], attr, &attr)) {
+                    Slapi_Value *v = NULL;
+                    int hint;
+
+                    slapi_attr_get_type(attr, &attrName);
+                    for (i = 0; membership_attrs[i] != NULL; i++) {
+                        if (slapi_attr_type_cmp(membership_attrs[i], attrName,
+                                                SLAPI_TYPE_CMP_SUBTYPE) == 0) {
+                            break;
+                        }
+                    }
+                    if (membership_attrs[i] == NULL) {
+                        continue;
+                    }
+                    for (hint = slapi_attr_first_value(attr, &v); hint != -1;
+                         hint = slapi_attr_next_value(attr, hint, &v)) {
+                        const char *sval = slapi_value_get_string(v);
+                        Slapi_DN *vsdn = slapi_sdn_new_dn_byref(sval);
+
+                        if (PL_HashTableLookupConst(deleted, slapi_sdn_get_ndn(vsdn))) {
+                            slapi_mods_add_string(smods, LDAP_MOD_DELETE, attrName, sval);
+                        }
+                        slapi_sdn_free(&vsdn);
+                    }
+                }
+                if (slapi_mods_get_num_mods(smods) > 0) {
+                    rc = _do_modify(mod_pb, slapi_entry_get_sdn(search_entries[j]),
+                                    slapi_mods_get_ldapmods_byref(smods));
+                    if (rc) {
+                        slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
+                                      "update_integrity_batch - Entry %s: deleting %d references failed (%d)\n",
+                                      slapi_entry_get_dn_const(search_entries[j]),
+                                      slapi_mods_get_num_mods(smods), rc);
+                        rc = SLAPI_PLUGIN_FAILURE;
+                    }
+                }
+                slapi_mods_free(&smods);
+            }
+        } else if (isFatalSearchError(search_result)) {
+            slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
+                          "update_integrity_batch - Search (base=%s, %d entries) returned "
+                          "error %d\n",
+                          search_base, count, search_result);
+            rc = SLAPI_PLUGIN_FAILURE;
+        }
+        slapi_free_search_results_internal(search_result_pb);
+
+        if (plugin_ContainerScope) {
+            /* at the moment only a single scope is supported
+             * so the loop ends after the first iteration
+             */
+            sdn = NULL;
+        } else {
+            sdn = slapi_get_next_suffix(&node, 0);
+        }
+    }
+
+free_and_return:
+    if (deleted) {
+        PL_HashTableDestroy(deleted);
+    }
+    if (terms) {
+        for (i = 0; i < nterms; i++) {
+            slapi_ch_free_string(&terms[i]);
+        }
+        slapi_ch_free((void **)&terms);
+    }
+    slapi_ch_free_string(&filter);
+    slapi_ch_array_free(membership_attrs);
+    slapi_pblock_destroy(mod_pb);
+    slapi_pblock_destroy(search_result_pb);
+
+    return rc;
+}
+
 int
 referint_postop_start(Slapi_PBlock *pb)
 {
@@ -1303,7 +1475,7 @@ referint_postop_start(Slapi_PBlock *pb)
         pthread_condattr_t condAttr;
 
         /* initialize the cv and lock */
-        if (!use_txn && (NULL == referint_mutex)) {
+        if (NULL == referint_mutex) {
             referint_mutex = PR_NewLock();
         }
         if ((rc = pthread_mutex_init(&keeprunning_mutex, NULL)) != 0) {
@@ -1379,43 +1551,99 @@ referint_postop_close(Slapi_PBlock *pb __attribute__((unused)))
     return (0);
 }
 
+/*
+ * Process the batched deletes, under the identity that requested them
+ */
+static void
+referint_flush_batch(Slapi_DN **batch, int *nbatch, char **requestor)
+{
+    int i;
+
+    if (*nbatch == 0) {
+        return;
+    }
+    if (*requestor && strcasecmp(*requestor, "NULL") != 0) {
+        /* Set the bind DN in the thread data */
+        if (slapi_td_set_dn(slapi_ch_strdup(*requestor))) {
+            slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM, "referint_flush_batch - "
+                                                                    "Failed to set thread data\n");
+        }
+    }
+    update_integrity_batch(batch, *nbatch);
+
+    for (i = 0; i < *nbatch; i++) {
+        slapi_sdn_free(&batch[i]);
+    }
+    *nbatch = 0;
+    slapi_ch_free_string(requestor);
+}
+
+static int
+referint_keeprunning(void)
+{
+    int rc;
+
+    pthread_mutex_lock(&keeprunning_mutex);
+    rc = keeprunning;
+    pthread_mutex_unlock(&keeprunning_mutex);
+
+    return rc;
+}
+
 void
 referint_thread_func(void *arg __attribute__((unused)))
 {
+    referint_reader *reader = NULL;
     PRFileDesc *prfd = NULL;
     char *logfilename = NULL;
+    char *procfilename = NULL;
     char thisline[MAX_LINE];
     char delimiter[] = "\t\n";
     char *ptoken;
     char *tmprdn;
+    char *requestor;
     char *iter = NULL;
     Slapi_DN *sdn = NULL;
     Slapi_DN *tmpsuperior = NULL;
+    Slapi_DN *batch[REFERINT_BATCH_SIZE];
+    char *batch_requestor = NULL;
     struct timespec current_time = {0};
+    int nbatch = 0;
+    int stopped = 0;
     int delay;
     int no_changes;
 
+    reader = (referint_reader *)slapi_ch_calloc(1, sizeof(referint_reader));
+
     /*
      * keep running this thread until plugin is signaled to close
      */
     while (1) {
         /* refresh the config */
         slapi_ch_free_string(&logfilename);
+        slapi_ch_free_string(&procfilename);
         referint_get_config(&delay, &logfilename);
+        procfilename = slapi_ch_smprintf("%s%s", logfilename, REFERINT_PROCESSING_SUFFIX);
 
         no_changes = 1;
         while (no_changes) {
-
-            pthread_mutex_lock(&keeprunning_mutex);
-            if (keeprunning == 0) {
-                pthread_mutex_unlock(&keeprunning_mutex);
+            if (!referint_keeprunning()) {
                 break;
             }
-            pthread_mutex_unlock(&keeprunning_mutex);
 
+            /*
+             * A log left by an interrupted run is processed first.  Otherwise
+             * the current log is renamed, the new records go to a fresh file
+             * while it is processed.
+             */
             referint_lock();
-            if ((prfd = PR_Open(logfilename, PR_RDONLY, REFERINT_DEFAULT_FILE_MODE)) == NULL) {
-                referint_unlock();
+            if (PR_Access(procfilename, PR_ACCESS_EXISTS) == PR_SUCCESS ||
+                PR_Rename(logfilename, procfilename) == PR_SUCCESS) {
+                prfd = PR_Open(procfilename, PR_RDONLY, REFERINT_DEFAULT_FILE_MODE);
+            }
+            referint_unlock();
+
+            if (prfd == NULL) {
                 /* go back to sleep and wait for this file */
                 pthread_mutex_lock(&keeprunning_mutex);
                 clock_gettime(CLOCK_MONOTONIC, &current_time);
@@ -1432,16 +1660,22 @@ referint_thread_func(void *arg __attribute__((unused)))
          *  loop before trying to do the changes. The server
          *  will pick them up on next startup as file still exists
          */
-        pthread_mutex_lock(&keeprunning_mutex);
-        if (keeprunning == 0) {
-            pthread_mutex_unlock(&keeprunning_mutex);
+        if (!referint_keeprunning()) {
+            if (prfd) {
+                PR_Close(prfd);
+            }
             break;
         }
-        pthread_mutex_unlock(&keeprunning_mutex);
 
-        while (GetNextLine(thisline, MAX_LINE, prfd)) {
+        /*
+         * Consecutive deletes are batched, a modrdn flushes the batch so
+         * that the updates are applied in the log order.
+         */
+        reader->fd = prfd;
+        reader->pos = reader->len = 0;
+        while (GetNextLine(thisline, MAX_LINE, reader)) {
             ptoken = ldap_utf8strtok_r(thisline, delimiter, &iter);
-            sdn = slapi_sdn_new_normdn_byref(ptoken);
+            sdn = slapi_sdn_new_normdn_byval(ptoken);
             ptoken = ldap_utf8strtok_r(NULL, delimiter, &iter);
 
             if (ptoken == NULL) {
@@ -1458,38 +1692,64 @@ referint_thread_func(void *arg __attribute__((unused)))
             }
 
             ptoken = ldap_utf8strtok_r(NULL, delimiter, &iter);
-            if (!strcasecmp(ptoken, "NULL")) {
+            if (ptoken == NULL || !strcasecmp(ptoken, "NULL")) {
                 tmpsuperior = NULL;
             } else {
-                tmpsuperior = slapi_sdn_new_normdn_byref(ptoken);
+                tmpsuperior = slapi_sdn_new_normdn_byval(ptoken);
             }
-            ptoken = ldap_utf8strtok_r(NULL, delimiter, &iter);
-            if (strcasecmp(ptoken, "NULL") != 0) {
-                /* Set the bind DN in the thread data */
-                if (slapi_td_set_dn(slapi_ch_strdup(ptoken))) {
-                    slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM, "referint_thread_func - "
-                                                                            "Failed to set thread data\n");
-                }
+            requestor = ldap_utf8strtok_r(NULL, delimiter, &iter);
+            if (requestor == NULL) {
+                requestor = "NULL";
             }
 
-            update_integrity(sdn, tmprdn, tmpsuperior, NULL);
+            if (tmprdn == NULL && tmpsuperior == NULL) {
+                if (nbatch && strcmp(requestor, batch_requestor) != 0) {
+                    referint_flush_batch(batch, &nbatch, &batch_requestor);
+                }
+                if (nbatch == 0) {
+                    batch_requestor = slapi_ch_strdup(requestor);
+                }
+                batch[nbatch++] = sdn;
+                sdn = NULL;
+                if (nbatch == REFERINT_BATCH_SIZE) {
+                    referint_flush_batch(batch, &nbatch, &batch_requestor);
+                }
+            } else {
+                referint_flush_batch(batch, &nbatch, &batch_requestor);
+                if (strcasecmp(requestor, "NULL") != 0) {
+                    /* Set the bind DN in the thread data */
+                    if (slapi_td_set_dn(slapi_ch_strdup(requestor))) {
+                        slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM, "referint_thread_func - "
+                                                                                "Failed to set thread data\n");
+                    }
+                }
+                update_integrity(sdn, tmprdn, tmpsuperior, NULL);
+            }
 
             slapi_sdn_free(&sdn);
             slapi_ch_free_string(&tmprdn);
             slapi_sdn_free(&tmpsuperior);
+
+            if (nbatch == 0 && !referint_keeprunning()) {
+                /* the rest of the log is processed on next startup */
+                stopped = 1;
+                break;
+            }
         }
+        referint_flush_batch(batch, &nbatch, &batch_requestor);
 
         PR_Close(prfd);
+        prfd = NULL;
+        if (stopped) {
+            break;
+        }
 
-        /* remove the original file */
-        if (PR_SUCCESS != PR_Delete(logfilename)) {
+        /* the log is processed, remove it */
+        if (PR_SUCCESS != PR_Delete(procfilename)) {
             slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                          "referint_thread_func - Could not delete \"%s\"\n", logfilename);
+                          "referint_thread_func - Could not delete \"%s\"\n", procfilename);
         }
 
-        /* unlock and let other writers back at the file */
-        referint_unlock();
-
         /* wait on condition here */
         pthread_mutex_lock(&keeprunning_mutex);
         clock_gettime(CLOCK_MONOTONIC, &current_time);
@@ -1502,65 +1762,48 @@ referint_thread_func(void *arg __attribute__((unused)))
     pthread_mutex_destroy(&keeprunning_mutex);
     pthread_cond_destroy(&keeprunning_cv);
     slapi_ch_free_string(&logfilename);
+    slapi_ch_free_string(&procfilename);
+    slapi_ch_free((void **)&reader);
 }
 
+/*
+ * Read the next line of the integrity log, with its newline.  A line
+ * longer than the destination is truncated.  Returns the length read,
+ * 0 at the end of the log.
+ */
 int
-my_fgetc(PRFileDesc *stream)
-{
-    /* This is equivalent to memset of 0, but statically defined. */
-    static char buf[READ_BUFSIZE] = {0};
-    static int position = READ_BUFSIZE;
-    int retval;
-    int err;
-
-    /* check if we need to load the buffer */
-    if (READ_BUFSIZE == position) {
-        if ((err = PR_Read(stream, buf, READ_BUFSIZE)) >= 0) {
-            /* it read some data */;
-            position = 0;
-        } else {
-            /* an error occurred */
-            return err;
-        }
-    }
-
-    /* try to read some data */
-    if ('\0' == buf[position]) {
-        /* out of data, return eof */
-        retval = MY_EOF;
-        position = READ_BUFSIZE;
-    } else {
-        retval = buf[position];
-        position++;
-    }
-
-    return retval;
-}
-
-int
-GetNextLine(char *dest, int size_dest, PRFileDesc *stream)
+GetNextLine(char *dest, int size_dest, referint_reader *reader)
 {
-
-    char nextchar = '\0';
-    int done = 0;
     int i = 0;
 
-    while (!done) {
-        if ((nextchar = my_fgetc(stream)) != 0) {
-            if (i < (size_dest - 1)) {
-                dest[i] = nextchar;
-                i++;
-                if (nextchar == '\n') {
-                    /* end of line reached */
-                    done = 1;
-                }
-            } else {
-                /* no more room in buffer */
-                done = 1;
+    while (1) {
+        char *start;
+        char *eol;
+        int avail;
+        int n;
+
+        if (reader->pos == reader->len) {
+            reader->pos = 0;
+            reader->len = PR_Read(reader->fd, reader->buf, READ_BUFSIZE);
+            if (reader->len <= 0) {
+                /* error or end of file */
+                reader->len = 0;
+                break;
             }
-        } else {
-            /* error or end of file */
-            done = 1;
+        }
+        start = reader->buf + reader->pos;
+        avail = reader->len - reader->pos;
+        eol = memchr(start, '\n', avail);
+        n = eol ? (int)(eol - start) + 1 : avail;
+        reader->pos += n;
+        if (n > size_dest - 1 - i) {
+            n = size_dest - 1 - i;
+        }
+        memcpy(dest + i, start, n);
+        i += n;
+        if (eol) {
+            /* end of line reached */
+            break;
         }
     }
     dest[i] = '\0';
@@ -1588,9 +1831,9 @@ writeintegritylog(Slapi_PBlock *pb, char *logfilename, Slapi_DN *sdn, char *newr
         return;
     }
     /*
-     * Use this lock to protect file data when update integrity is occuring.
-     * If betxn is enabled, this mutex is ignored; transaction itself takes
-     * the role.
+     * Serialize the appends with the delayed update thread, which renames
+     * the log file under the same lock before it processes the batch. The
+     * lock is taken whether or not the plugin runs as a betxn plugin.
      */
     referint_lock();
     if ((prfd = PR_Open(logfilename, PR_WRONLY | PR_CREATE_FILE | PR_APPEND,
@@ -1599,7 +1842,6 @@ writeintegritylog(Slapi_PBlock *pb, char *logfilename, Slapi_DN *sdn, char *newr
                       "writeintegritylog - Could not write integrity log \"%s\" " SLAPI_COMPONENT_NAME_NSPR " %d (%s)\n",
                       logfilename, PR_GetError(), slapd_pr_strerror(PR_GetError()));
 
-        PR_Unlock(referint_mutex);
         referint_unlock();
         return;
     }
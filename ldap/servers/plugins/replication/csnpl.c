@@ -13,23 +13,53 @@
 
 
 #include "csnpl.h"
-#include "llist.h"
 
-struct csnpl
-{
-    LList *csnList;        /* pending list */
-    Slapi_RWLock *csnLock; /* lock to serialize access to PL */
-};
+/*
+ * The pending list is a log of the CSNs in progress, in CSN order.  The
+ * entries are appended to a chain of fixed size segments and addressed by
+ * their sequence number, the list holding the sequences [head, tail).
+ *
+ * Commits and cancellations only change the state of their entry with an
+ * atomic operation: they run concurrently under the read side of csnLock and
+ * find the entry with a binary search.  Insertions are serialized by
+ * insertLock (they come in CSN order anyway, from the CSN generator or from
+ * the replication session) and publish the new entry by moving the tail.
+ * Only the roll up, which frees the entries at the head, takes csnLock for
+ * writing, and csnplRollUpReady lets the callers skip it while the head is
+ * not committed.  A cancelled entry stays in place until it is rolled up so
+ * that the log remains sorted for the searches.
+ */
+#define CSNPL_SEGMENT_SIZE 128
 
+#define CSNPL_PENDING 0
+#define CSNPL_COMMITTED 1
+#define CSNPL_CANCELLED 2
 
 typedef struct _csnpldata
 {
-    PRBool committed;      /* True if CSN committed */
+    uint64_t state;        /* CSNPL_PENDING, CSNPL_COMMITTED or CSNPL_CANCELLED */
     CSN *csn;              /* The actual CSN */
     Replica *prim_replica; /* The replica where the prom csn was generated */
     const CSN *prim_csn;   /* The primary CSN of an operation consising of multiple sub ops*/
 } csnpldata;
 
+typedef struct _csnplsegment
+{
+    struct _csnplsegment *next;
+    uint64_t base; /* sequence of entries[0] */
+    csnpldata entries[CSNPL_SEGMENT_SIZE];
+} csnplsegment;
+
+struct csnpl
+{
+    csnplsegment *first;   /* segment holding the head */
+    csnplsegment *last;    /* segment holding the tail, only used by the insertions */
+    uint64_t head;         /* first entry of the list */
+    uint64_t tail;         /* next entry to insert */
+    Slapi_RWLock *csnLock; /* write locked to remove entries from the list */
+    PRLock *insertLock;    /* serializes the insertions */
+};
+
 static PRBool csn_primary_or_nested(csnpldata *csn_data, const CSNPL_CTX *csn_ctx);
 
 /* forward declarations */
@@ -42,151 +72,257 @@ csnplNew()
 {
     CSNPL *csnpl;
 
-    csnpl = (CSNPL *)slapi_ch_malloc(sizeof(CSNPL));
+    csnpl = (CSNPL *)slapi_ch_calloc(1, sizeof(CSNPL));
     if (csnpl == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
                       "csnplNew - Failed to allocate pending list\n");
         return NULL;
     }
 
-    csnpl->csnList = llistNew();
-    if (csnpl->csnList == NULL) {
-        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
-                      "csnplNew - Failed to allocate pending list\n");
-        slapi_ch_free((void **)&csnpl);
-        return NULL;
-    }
+    csnpl->first = csnpl->last = (csnplsegment *)slapi_ch_calloc(1, sizeof(csnplsegment));
 
     /* ONREPL: do locks need different names */
     csnpl->csnLock = slapi_new_rwlock();
+    csnpl->insertLock = PR_NewLock();
 
-    if (csnpl->csnLock == NULL) {
+    if (csnpl->csnLock == NULL || csnpl->insertLock == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
                       "csnplNew - Failed to create lock; NSPR error - %d\n",
                       PR_GetError());
-        slapi_ch_free((void **)&(csnpl->csnList));
-        slapi_ch_free((void **)&csnpl);
+        csnplFree(&csnpl);
         return NULL;
     }
 
     return csnpl;
 }
 
-
-void
-csnpldata_free(csnpldata **data_to_free)
-{
-    if (NULL != data_to_free) {
-        if (NULL != (*data_to_free)->csn) {
-            csn_free(&(*data_to_free)->csn);
-        }
-        slapi_ch_free((void **)data_to_free);
-    }
-}
-
 void
 csnplFree(CSNPL **csnpl)
 {
+    csnplsegment *seg;
+    uint64_t seq;
+
     if ((csnpl == NULL) || (*csnpl == NULL))
         return;
 
     /* free all remaining nodes */
-    llistDestroy(&((*csnpl)->csnList), (FNFree)csnpldata_free);
+    seg = (*csnpl)->first;
+    for (seq = (*csnpl)->head; seq < (*csnpl)->tail; seq++) {
+        if (seq == seg->base + CSNPL_SEGMENT_SIZE) {
+            seg = seg->next;
+        }
+        csn_free(&seg->entries[seq - seg->base].csn);
+    }
+    while ((seg = (*csnpl)->first) != NULL) {
+        (*csnpl)->first = seg->next;
+        slapi_ch_free((void **)&seg);
+    }
 
     if ((*csnpl)->csnLock)
         slapi_destroy_rwlock((*csnpl)->csnLock);
+    if ((*csnpl)->insertLock)
+        PR_DestroyLock((*csnpl)->insertLock);
 
     slapi_ch_free((void **)csnpl);
 }
 
-/* This function isnerts a CSN into the pending list
- * Returns: 0 if the csn was successfully inserted
- *          1 if the csn has already been seen
- *         -1 for any other kind of errors
+/* Entry of a sequence in [head, tail), with csnLock held */
+static csnpldata *
+csnplEntry(CSNPL *csnpl, uint64_t seq)
+{
+    csnplsegment *seg = csnpl->first;
+
+    while (seq >= seg->base + CSNPL_SEGMENT_SIZE) {
+        seg = __atomic_load_n(&seg->next, __ATOMIC_ACQUIRE);
+    }
+    return &seg->entries[seq - seg->base];
+}
+
+/* Sequence of the first entry whose CSN is not smaller than csn */
+static uint64_t
+csnplLowerBound(CSNPL *csnpl, uint64_t tail, const CSN *csn)
+{
+    csnplsegment *seg;
+
+    for (seg = csnpl->first; seg && seg->base < tail; seg = __atomic_load_n(&seg->next, __ATOMIC_ACQUIRE)) {
+        uint64_t lo = csnpl->head > seg->base ? csnpl->head : seg->base;
+        uint64_t hi = tail < seg->base + CSNPL_SEGMENT_SIZE ? tail : seg->base + CSNPL_SEGMENT_SIZE;
+
+        if (lo >= hi || csn_compare(seg->entries[hi - 1 - seg->base].csn, csn) < 0) {
+            continue;
+        }
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (csn_compare(seg->entries[mid - seg->base].csn, csn) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+    return tail;
+}
+
+/*
+ * Move the entry of csn from one of the from states to the to state.
+ * A cancelled csn may have been inserted again, so the entries equal
+ * to csn are all looked at.
  */
-int
-csnplInsert(CSNPL *csnpl, const CSN *csn, const CSNPL_CTX *prim_csn)
+static int
+csnplSetState(CSNPL *csnpl, const CSN *csn, uint64_t from_mask, uint64_t to)
 {
-    int rc;
-    csnpldata *csnplnode;
-    char csn_str[CSN_STRSIZE];
+    uint64_t tail = __atomic_load_n(&csnpl->tail, __ATOMIC_ACQUIRE);
+    uint64_t seq;
 
-    if (csnpl == NULL || csn == NULL) {
-        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
-                      "csnplInsert - Invalid argument\n");
-        return -1;
+    for (seq = csnplLowerBound(csnpl, tail, csn); seq < tail; seq++) {
+        csnpldata *data = csnplEntry(csnpl, seq);
+        uint64_t state;
+
+        if (!csn_is_equal(data->csn, csn)) {
+            break;
+        }
+        state = __atomic_load_n(&data->state, __ATOMIC_ACQUIRE);
+        while ((1 << state) & from_mask) {
+            if (state == to ||
+                __atomic_compare_exchange_n(&data->state, &state, to, PR_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return 0;
+            }
+        }
     }
+    return -1;
+}
 
-    slapi_rwlock_wrlock(csnpl->csnLock);
+/* First entry of the list that is not cancelled, with csnLock held */
+static csnpldata *
+csnplGetFirst(CSNPL *csnpl)
+{
+    uint64_t tail = __atomic_load_n(&csnpl->tail, __ATOMIC_ACQUIRE);
+    uint64_t seq;
+
+    for (seq = csnpl->head; seq < tail; seq++) {
+        csnpldata *data = csnplEntry(csnpl, seq);
+        if (__atomic_load_n(&data->state, __ATOMIC_ACQUIRE) != CSNPL_CANCELLED) {
+            return data;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Append csn to the list, with insertLock held.  When trim is set, the
+ * caller holds csnLock for writing and the cancelled entries ending the
+ * list that are not smaller than csn are dropped first.
+ */
+static int
+csnplAppend(CSNPL *csnpl, const CSN *csn, const CSNPL_CTX *prim_csn, PRBool trim)
+{
+    uint64_t tail = csnpl->tail;
+    csnpldata *csnplnode;
+
+    if (trim) {
+        while (tail > csnpl->head) {
+            csnplnode = csnplEntry(csnpl, tail - 1);
+            if (csnplnode->state != CSNPL_CANCELLED || csn_compare(csnplnode->csn, csn) < 0) {
+                break;
+            }
+            csn_free(&csnplnode->csn);
+            tail--;
+        }
+        csnpl->tail = tail;
+        for (csnpl->last = csnpl->first; tail > csnpl->last->base + CSNPL_SEGMENT_SIZE;) {
+            csnpl->last = csnpl->last->next;
+        }
+    }
 
     /* check to see if this csn is larger than the last csn in the
        pending list. It has to be if we have not seen it since
        the csns are always added in the accending order. */
-    csnplnode = llistGetTail(csnpl->csnList);
-    if (csnplnode && csn_compare(csnplnode->csn, csn) >= 0) {
-        slapi_rwlock_unlock(csnpl->csnLock);
-        return 1;
+    if (tail > csnpl->head) {
+        csnplnode = csnplEntry(csnpl, tail - 1);
+        if (csn_compare(csnplnode->csn, csn) >= 0) {
+            /* a cancelled csn may be inserted again */
+            return __atomic_load_n(&csnplnode->state, __ATOMIC_ACQUIRE) == CSNPL_CANCELLED ? -2 : 1;
+        }
     }
 
-    csnplnode = (csnpldata *)slapi_ch_calloc(1, sizeof(csnpldata));
-    csnplnode->committed = PR_FALSE;
+    if (tail == csnpl->last->base + CSNPL_SEGMENT_SIZE) {
+        if (csnpl->last->next == NULL) {
+            csnplsegment *seg = (csnplsegment *)slapi_ch_calloc(1, sizeof(csnplsegment));
+            seg->base = tail;
+            __atomic_store_n(&csnpl->last->next, seg, __ATOMIC_RELEASE);
+        }
+        csnpl->last = csnpl->last->next;
+    }
+    csnplnode = &csnpl->last->entries[tail - csnpl->last->base];
+    csnplnode->state = CSNPL_PENDING;
     csnplnode->csn = csn_dup(csn);
+    csnplnode->prim_csn = NULL;
+    csnplnode->prim_replica = NULL;
     if (prim_csn) {
         csnplnode->prim_csn = prim_csn->prim_csn;
         csnplnode->prim_replica = prim_csn->prim_repl;
     }
-    csn_as_string(csn, PR_FALSE, csn_str);
-    rc = llistInsertTail(csnpl->csnList, csn_str, csnplnode);
-
-#ifdef DEBUG
-    _csnplDumpContentNoLock(csnpl, "csnplInsert");
-#endif
-
-    slapi_rwlock_unlock(csnpl->csnLock);
-    if (rc != 0) {
-        char s[CSN_STRSIZE];
-        if (slapi_is_loglevel_set(SLAPI_LOG_REPL)) {
-            slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
-                          "csnplInsert - Failed to insert csn (%s) into pending list\n", csn_as_string(csn, PR_FALSE, s));
-        }
-        return -1;
-    }
-
+    /* publish the entry */
+    __atomic_store_n(&csnpl->tail, tail + 1, __ATOMIC_RELEASE);
     return 0;
 }
 
+/* This function isnerts a CSN into the pending list
+ * Returns: 0 if the csn was successfully inserted
+ *          1 if the csn has already been seen
+ *         -1 for any other kind of errors
+ */
 int
-csnplRemove(CSNPL *csnpl, const CSN *csn)
+csnplInsert(CSNPL *csnpl, const CSN *csn, const CSNPL_CTX *prim_csn)
 {
-    csnpldata *data;
-    char csn_str[CSN_STRSIZE];
+    int rc;
 
     if (csnpl == NULL || csn == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
-                      "csnplRemove: invalid argument\n");
+                      "csnplInsert - Invalid argument\n");
         return -1;
     }
 
-    csn_as_string(csn, PR_FALSE, csn_str);
-    slapi_rwlock_wrlock(csnpl->csnLock);
+    slapi_rwlock_rdlock(csnpl->csnLock);
+    PR_Lock(csnpl->insertLock);
+    rc = csnplAppend(csnpl, csn, prim_csn, PR_FALSE);
+    PR_Unlock(csnpl->insertLock);
+    slapi_rwlock_unlock(csnpl->csnLock);
 
-    data = (csnpldata *)llistRemove(csnpl->csnList, csn_str);
-    if (data == NULL) {
+    if (rc == -2) {
+        /* the csn goes before cancelled entries, they have to be removed first */
+        slapi_rwlock_wrlock(csnpl->csnLock);
+        PR_Lock(csnpl->insertLock);
+        rc = csnplAppend(csnpl, csn, prim_csn, PR_TRUE);
+        PR_Unlock(csnpl->insertLock);
+#ifdef DEBUG
+        _csnplDumpContentNoLock(csnpl, "csnplInsert");
+#endif
         slapi_rwlock_unlock(csnpl->csnLock);
-        return -1;
     }
 
-#ifdef DEBUG
-    _csnplDumpContentNoLock(csnpl, "csnplRemove");
-#endif
+    return rc;
+}
 
-    csn_free(&data->csn);
-    slapi_ch_free((void **)&data);
+int
+csnplRemove(CSNPL *csnpl, const CSN *csn)
+{
+    int rc;
 
+    if (csnpl == NULL || csn == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
+                      "csnplRemove: invalid argument\n");
+        return -1;
+    }
+
+    slapi_rwlock_rdlock(csnpl->csnLock);
+    rc = csnplSetState(csnpl, csn, (1 << CSNPL_PENDING) | (1 << CSNPL_COMMITTED), CSNPL_CANCELLED);
     slapi_rwlock_unlock(csnpl->csnLock);
 
-    return 0;
+    return rc;
 }
+
 PRBool
 csn_primary(Replica *replica, const CSN *csn, const CSNPL_CTX *csn_ctx)
 {
@@ -240,25 +376,40 @@ csn_primary_or_nested(csnpldata *csn_data, const CSNPL_CTX *csn_ctx)
     return PR_FALSE;
 }
 
-int
-csnplRemoveAll(CSNPL *csnpl, const CSNPL_CTX *csn_ctx)
+/*
+ * Set the state of the entries of an operation, with csnLock held.
+ * Like csnplSetState, the entries already moved to the state are ignored.
+ */
+static void
+csnplSetStateAll(CSNPL *csnpl, const CSNPL_CTX *csn_ctx, uint64_t from_mask, uint64_t to)
 {
-    csnpldata *data;
-    void *iterator;
+    uint64_t tail = __atomic_load_n(&csnpl->tail, __ATOMIC_ACQUIRE);
+    csnplsegment *seg = csnpl->first;
+    uint64_t seq;
 
-    slapi_rwlock_wrlock(csnpl->csnLock);
-    data = (csnpldata *)llistGetFirst(csnpl->csnList, &iterator);
-    while (NULL != data) {
-        if (csn_primary_or_nested(data, csn_ctx)) {
-            csnpldata_free(&data);
-            data = (csnpldata *)llistRemoveCurrentAndGetNext(csnpl->csnList, &iterator);
-        } else {
-            data = (csnpldata *)llistGetNext(csnpl->csnList, &iterator);
+    for (seq = csnpl->head; seq < tail; seq++) {
+        csnpldata *data;
+        uint64_t state;
+
+        if (seq == seg->base + CSNPL_SEGMENT_SIZE) {
+            seg = __atomic_load_n(&seg->next, __ATOMIC_ACQUIRE);
         }
+        data = &seg->entries[seq - seg->base];
+        if (!csn_primary_or_nested(data, csn_ctx)) {
+            continue;
+        }
+        state = __atomic_load_n(&data->state, __ATOMIC_ACQUIRE);
+        while (state != to && ((1 << state) & from_mask) &&
+               !__atomic_compare_exchange_n(&data->state, &state, to, PR_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            ;
     }
-#ifdef DEBUG
-    _csnplDumpContentNoLock(csnpl, "csnplRemoveAll");
-#endif
+}
+
+int
+csnplRemoveAll(CSNPL *csnpl, const CSNPL_CTX *csn_ctx)
+{
+    slapi_rwlock_rdlock(csnpl->csnLock);
+    csnplSetStateAll(csnpl, csn_ctx, (1 << CSNPL_PENDING) | (1 << CSNPL_COMMITTED), CSNPL_CANCELLED);
     slapi_rwlock_unlock(csnpl->csnLock);
     return 0;
 }
@@ -267,24 +418,15 @@ csnplRemoveAll(CSNPL *csnpl, const CSNPL_CTX *csn_ctx)
 int
 csnplCommitAll(CSNPL *csnpl, const CSNPL_CTX *csn_ctx)
 {
-    csnpldata *data;
-    void *iterator;
     char csn_str[CSN_STRSIZE];
 
-    csn_as_string(csn_ctx->prim_csn, PR_FALSE, csn_str);
-    slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
-                  "csnplCommitALL: committing all csns for csn %s\n", csn_str);
-    slapi_rwlock_wrlock(csnpl->csnLock);
-    data = (csnpldata *)llistGetFirst(csnpl->csnList, &iterator);
-    while (NULL != data) {
-        csn_as_string(data->csn, PR_FALSE, csn_str);
+    if (slapi_is_loglevel_set(SLAPI_LOG_REPL)) {
+        csn_as_string(csn_ctx->prim_csn, PR_FALSE, csn_str);
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
-                      "csnplCommitALL: processing data csn %s\n", csn_str);
-        if (csn_primary_or_nested(data, csn_ctx)) {
-            data->committed = PR_TRUE;
-        }
-        data = (csnpldata *)llistGetNext(csnpl->csnList, &iterator);
+                      "csnplCommitALL: committing all csns for csn %s\n", csn_str);
     }
+    slapi_rwlock_rdlock(csnpl->csnLock);
+    csnplSetStateAll(csnpl, csn_ctx, 1 << CSNPL_PENDING, CSNPL_COMMITTED);
     slapi_rwlock_unlock(csnpl->csnLock);
     return 0;
 }
@@ -292,24 +434,20 @@ csnplCommitAll(CSNPL *csnpl, const CSNPL_CTX *csn_ctx)
 int
 csnplCommit(CSNPL *csnpl, const CSN *csn)
 {
-    csnpldata *data;
     char csn_str[CSN_STRSIZE];
+    int rc;
 
     if (csnpl == NULL || csn == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
                       "csnplCommit: invalid argument\n");
         return -1;
     }
-    csn_as_string(csn, PR_FALSE, csn_str);
-
-    slapi_rwlock_wrlock(csnpl->csnLock);
 
-#ifdef DEBUG
-    _csnplDumpContentNoLock(csnpl, "csnplCommit");
-#endif
+    slapi_rwlock_rdlock(csnpl->csnLock);
+    rc = csnplSetState(csnpl, csn, (1 << CSNPL_PENDING) | (1 << CSNPL_COMMITTED), CSNPL_COMMITTED);
+    slapi_rwlock_unlock(csnpl->csnLock);
 
-    data = (csnpldata *)llistGet(csnpl->csnList, csn_str);
-    if (data == NULL) {
+    if (rc != 0) {
         /*
          * In the scenario "4.x supplier -> 6.x legacy-consumer -> 6.x consumer"
          * csn will have rid=65535. Hence 6.x consumer will get here trying
@@ -320,16 +458,11 @@ csnplCommit(CSNPL *csnpl, const CSN *csn)
         ReplicaId rid = csn_get_replicaid(csn);
         if (rid < MAX_REPLICA_ID) {
             slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
-                          "csnplCommit: can't find csn %s\n", csn_str);
+                          "csnplCommit: can't find csn %s\n", csn_as_string(csn, PR_FALSE, csn_str));
         }
-        slapi_rwlock_unlock(csnpl->csnLock);
         return -1;
-    } else {
-        data->committed = PR_TRUE;
     }
 
-    slapi_rwlock_unlock(csnpl->csnLock);
-
     return 0;
 }
 
@@ -340,10 +473,10 @@ csnplGetMinCSN(CSNPL *csnpl, PRBool *committed)
     csnpldata *data;
     CSN *csn = NULL;
     slapi_rwlock_rdlock(csnpl->csnLock);
-    if ((data = (csnpldata *)llistGetHead(csnpl->csnList)) != NULL) {
+    if ((data = csnplGetFirst(csnpl)) != NULL) {
         csn = csn_dup(data->csn);
         if (NULL != committed) {
-            *committed = data->committed;
+            *committed = __atomic_load_n(&data->state, __ATOMIC_ACQUIRE) == CSNPL_COMMITTED;
         }
     }
     slapi_rwlock_unlock(csnpl->csnLock);
@@ -351,6 +484,27 @@ csnplGetMinCSN(CSNPL *csnpl, PRBool *committed)
     return csn;
 }
 
+/*
+ * Tell whether csnplRollUp would advance: the first CSN that was not
+ * cancelled is committed.  Any commit done before the call is seen by the
+ * next roll up, so a caller that committed a CSN and finds the list not
+ * ready can leave the roll up to the committer of the first CSN.
+ */
+PRBool
+csnplRollUpReady(CSNPL *csnpl)
+{
+    csnpldata *data;
+    PRBool ready = PR_FALSE;
+
+    slapi_rwlock_rdlock(csnpl->csnLock);
+    if ((data = csnplGetFirst(csnpl)) != NULL) {
+        ready = __atomic_load_n(&data->state, __ATOMIC_ACQUIRE) == CSNPL_COMMITTED;
+    }
+    slapi_rwlock_unlock(csnpl->csnLock);
+
+    return ready;
+}
+
 
 /*
  * Roll up the list of pending CSNs, removing all of the CSNs at the
@@ -364,16 +518,26 @@ csnplRollUp(CSNPL *csnpl, CSN **first_commited)
 {
     CSN *largest_committed_csn = NULL;
     csnpldata *data;
+    csnplsegment *seg;
     PRBool freeit = PR_TRUE;
-    void *iterator;
 
     slapi_rwlock_wrlock(csnpl->csnLock);
     if (first_commited) {
         /* Avoid non-initialization issues due to careless callers */
         *first_commited = NULL;
     }
-    data = (csnpldata *)llistGetFirst(csnpl->csnList, &iterator);
-    while (NULL != data && data->committed) {
+    for (seg = csnpl->first; csnpl->head < csnpl->tail; csnpl->head++) {
+        if (csnpl->head == seg->base + CSNPL_SEGMENT_SIZE) {
+            seg = seg->next;
+        }
+        data = &seg->entries[csnpl->head - seg->base];
+        if (data->state == CSNPL_CANCELLED) {
+            csn_free(&data->csn);
+            continue;
+        }
+        if (data->state != CSNPL_COMMITTED) {
+            break;
+        }
         if (NULL != largest_committed_csn && freeit) {
             csn_free(&largest_committed_csn);
         }
@@ -383,11 +547,21 @@ csnplRollUp(CSNPL *csnpl, CSN **first_commited)
             *first_commited = data->csn;
             freeit = PR_FALSE;
         }
-        /* llistRemoveCurrentAndGetNext will detach the current node
-               so we have to free the data associated with it, but not the csn */
+        /* the csn now belongs to the caller */
         data->csn = NULL;
-        csnpldata_free(&data);
-        data = (csnpldata *)llistRemoveCurrentAndGetNext(csnpl->csnList, &iterator);
+    }
+    /*
+     * Release the segments behind the head, keeping one for the insertions.
+     * A trim may have left the last segment behind segments that are still
+     * chained, so last can be one of them: it moves to the new first.
+     */
+    while (csnpl->first->next && csnpl->head >= csnpl->first->base + CSNPL_SEGMENT_SIZE) {
+        seg = csnpl->first;
+        csnpl->first = seg->next;
+        if (csnpl->last == seg) {
+            csnpl->last = csnpl->first;
+        }
+        slapi_ch_free((void **)&seg);
     }
 
 #ifdef DEBUG
@@ -414,22 +588,22 @@ csnplDumpContent(CSNPL *csnpl, const char *caller)
 static void
 _csnplDumpContentNoLock(CSNPL *csnpl, const char *caller)
 {
-    csnpldata *data;
-    void *iterator;
+    static const char *const states[] = {"not committed", "committed", "cancelled"};
+    uint64_t tail = __atomic_load_n(&csnpl->tail, __ATOMIC_ACQUIRE);
     char csn_str[CSN_STRSIZE];
     char primcsn_str[CSN_STRSIZE];
+    uint64_t seq;
 
-    data = (csnpldata *)llistGetFirst(csnpl->csnList, &iterator);
-    if (data) {
+    if (csnpl->head < tail) {
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name, "%s: CSN Pending list content:\n",
                       caller ? caller : "");
     }
-    while (data) {
+    for (seq = csnpl->head; seq < tail; seq++) {
+        csnpldata *data = csnplEntry(csnpl, seq);
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name, "%s,(prim %s), %s\n",
                       csn_as_string(data->csn, PR_FALSE, csn_str),
                       data->prim_csn ? csn_as_string(data->prim_csn, PR_FALSE, primcsn_str) : " ",
-                      data->committed ? "committed" : "not committed");
-        data = (csnpldata *)llistGetNext(csnpl->csnList, &iterator);
+                      states[__atomic_load_n(&data->state, __ATOMIC_ACQUIRE)]);
     }
 }
 #endif
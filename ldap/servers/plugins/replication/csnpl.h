@@ -30,6 +30,7 @@ int csnplCommitAll(CSNPL *csnpl, const CSNPL_CTX *csn_ctx);
 PRBool csn_primary(Replica *replica, const CSN *csn, const CSNPL_CTX *csn_ctx);
 CSN *csnplGetMinCSN(CSNPL *csnpl, PRBool *committed);
 int csnplCommit(CSNPL *csnpl, const CSN *csn);
+PRBool csnplRollUpReady(CSNPL *csnpl);
 CSN *csnplRollUp(CSNPL *csnpl, CSN **first);
 void csnplDumpContent(CSNPL *csnpl, const char *caller);
 
@@ -158,6 +158,7 @@ extern const char *type_nsds5ReplicaEnabled;
 extern const char *type_nsds5ReplicaStripAttrs;
 extern const char *type_nsds5ReplicaFlowControlWindow;
 extern const char *type_nsds5ReplicaFlowControlPause;
+extern const char *type_nsds5ReplicaFlowControlAdaptive;
 extern const char *type_replicaProtocolTimeout;
 extern const char *type_replicaReleaseTimeout;
 extern const char *type_replicaBackoffMin;
@@ -390,6 +391,10 @@ long agmt_get_busywaittime(const Repl_Agmt *ra);
 long agmt_get_pausetime(const Repl_Agmt *ra);
 long agmt_get_flowcontrolwindow(const Repl_Agmt *ra);
 long agmt_get_flowcontrolpause(const Repl_Agmt *ra);
+PRBool agmt_get_flowcontroladaptive(const Repl_Agmt *ra);
+long agmt_flowcontrol_get_window(Repl_Agmt *ra);
+void agmt_flowcontrol_window_full(Repl_Agmt *ra);
+void agmt_flowcontrol_congestion(Repl_Agmt *ra);
 long agmt_get_ignoremissing(const Repl_Agmt *ra);
 int agmt_start(Repl_Agmt *ra);
 int windows_agmt_start(Repl_Agmt *ra);
@@ -417,6 +422,7 @@ int agmt_set_schedule_from_entry(Repl_Agmt *ra, const Slapi_Entry *e);
 int agmt_set_timeout_from_entry(Repl_Agmt *ra, const Slapi_Entry *e);
 int agmt_set_flowcontrolwindow_from_entry(Repl_Agmt *ra, const Slapi_Entry *e);
 int agmt_set_flowcontrolpause_from_entry(Repl_Agmt *ra, const Slapi_Entry *e);
+int agmt_set_flowcontroladaptive_from_entry(Repl_Agmt *ra, const Slapi_Entry *e);
 int agmt_set_ignoremissing_from_entry(Repl_Agmt *ra, const Slapi_Entry *e);
 int agmt_set_busywaittime_from_entry(Repl_Agmt *ra, const Slapi_Entry *e);
 int agmt_set_pausetime_from_entry(Repl_Agmt *ra, const Slapi_Entry *e);
@@ -449,6 +455,7 @@ void agmt_set_last_init_end(Repl_Agmt *ra, time_t end_time);
 void agmt_set_last_init_status(Repl_Agmt *ra, int ldaprc, int replrc, int connrc, const char *msg);
 void agmt_inc_last_update_changecount(Repl_Agmt *ra, ReplicaId rid, int skipped);
 void agmt_get_changecount_string(Repl_Agmt *ra, char *buf, int bufsize);
+void agmt_record_update_ack(Repl_Agmt *ra, time_t csn_time, struct timespec *sent_time);
 int agmt_set_replicated_attributes_from_entry(Repl_Agmt *ra, const Slapi_Entry *e);
 int agmt_set_replicated_attributes_total_from_entry(Repl_Agmt *ra, const Slapi_Entry *e);
 int agmt_set_replicated_attributes_from_attr(Repl_Agmt *ra, Slapi_Attr *sattr);
@@ -73,6 +73,70 @@ struct changecounter
     uint32_t num_skipped;
 };
 
+/*
+ * Log-linear latency histogram, in the spirit of HdrHistogram: values below
+ * 2 * AGMT_HIST_SUB_BUCKETS have a bucket each, larger values are grouped by
+ * power of two and every power is split in AGMT_HIST_SUB_BUCKETS linear
+ * sub-buckets, so a value is reported with at most 12.5% relative error.
+ * Values are in microseconds and clamped below 2^AGMT_HIST_MAX_BITS (~12 days).
+ * There is a single writer per agreement (the thread reading the consumer
+ * results), the status callback reads the counters without locking.
+ */
+#define AGMT_HIST_SUB_BITS 3
+#define AGMT_HIST_SUB_BUCKETS (1 << AGMT_HIST_SUB_BITS)
+#define AGMT_HIST_MAX_BITS 40
+#define AGMT_HIST_BUCKETS (2 * AGMT_HIST_SUB_BUCKETS + (AGMT_HIST_MAX_BITS - AGMT_HIST_SUB_BITS - 1) * AGMT_HIST_SUB_BUCKETS)
+#define AGMT_RATE_SLOTS 60 /* seconds of history used for the update rate */
+
+/*
+ * Adaptive flow control (nsds5ReplicaFlowControlAdaptive).  The number of
+ * updates sent without acknowledgment is a congestion window driven by the
+ * measured round trip time, in the manner of TCP Vegas: it doubles every
+ * round (slow start) until updates start to queue on the consumer, then
+ * grows by one update per round while fewer than AGMT_FC_ALPHA updates are
+ * queued, and shrinks by one when more than AGMT_FC_BETA are.  The queue is
+ * estimated as window * (1 - min_rtt / srtt).  A timeout halves the window.
+ * nsds5ReplicaFlowControlWindow remains the upper bound.  Like the latency
+ * counters, the state is only updated by the thread reading the results.
+ */
+#define AGMT_FC_MIN_WINDOW 2
+#define AGMT_FC_INIT_WINDOW 16
+#define AGMT_FC_ALPHA 2
+#define AGMT_FC_BETA 6
+#define AGMT_FC_MIN_RTT_LIFETIME 10 /* seconds before the base rtt is measured again */
+
+struct latency_histogram
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[AGMT_HIST_BUCKETS];
+};
+
+struct flowcontrol_state
+{
+    uint64_t window;        /* updates sent without acknowledgment, 0 until the first round */
+    uint64_t ssthresh;      /* slow start threshold, 0 until updates first queued */
+    uint64_t srtt;          /* smoothed round trip time (us) */
+    uint64_t min_rtt;       /* base round trip time (us) */
+    uint64_t min_rtt_stamp; /* when min_rtt was measured (s) */
+    uint64_t round_acks;    /* acknowledgments in the current round */
+    uint64_t round_start;   /* start of the current round (us) */
+    uint64_t window_full;   /* the sender waited on the window during the round */
+    uint64_t ack_rate;      /* acknowledgments per second during the last round */
+    uint64_t queued;        /* updates estimated queued on the consumer */
+    uint64_t increases;
+    uint64_t decreases;
+};
+
+struct update_latency
+{
+    struct latency_histogram lag;     /* CSN time to consumer acknowledgment */
+    struct latency_histogram ack;     /* update sent to consumer acknowledgment */
+    uint64_t rate_time[AGMT_RATE_SLOTS];  /* second a rate slot accounts for */
+    uint64_t rate_count[AGMT_RATE_SLOTS]; /* updates acknowledged during that second */
+};
+
 typedef struct repl5agmt
 {
     char *hostname;                        /* remote hostname */
@@ -133,6 +197,8 @@ typedef struct repl5agmt
     int64_t flowControlWindow;         /* This is the maximum number of entries sent without acknowledgment */
     int64_t flowControlPause;          /* When nb of not acknowledged entries overpass totalUpdateWindow
                                         * This is the duration (in msec) that the RA will pause before sending the next entry */
+    int64_t flowControlAdaptive;       /* adapt the incremental update window to the measured round trip time */
+    struct flowcontrol_state flowControl;
     int64_t ignoreMissingChange;       /* if set replication will try to continue even if change cannot be found in changelog */
     Slapi_RWLock *attr_lock;           /* RW lock for all the stripped attrs */
     int64_t WaitForAsyncResults;       /* Pass to DS_Sleep(PR_MillisecondsToInterval(WaitForAsyncResults))
@@ -141,6 +207,7 @@ typedef struct repl5agmt
     struct berval *bootstrapCreds;     /* Bootstrap credentials */
     int64_t bootstrapBindmethod;       /* Bootstrap Bind Method: simple, TLS, client auth, etc */
     uint32_t bootstrapTransportFlags;  /* Bootstrap Transport Info: LDAPS, StartTLS, etc. */
+    struct update_latency latency;     /* replication lag of the updates acknowledged since startup */
 
 } repl5agmt;
 
@@ -378,6 +445,13 @@ agmt_new_from_entry(Slapi_Entry *e)
         ra->flowControlPause = pause;
     }
 
+    /* adaptive flow control window */
+    ra->flowControlAdaptive = 0;
+    tmpstr = (char *)slapi_entry_attr_get_ref(e, type_nsds5ReplicaFlowControlAdaptive);
+    if (NULL != tmpstr && strcasecmp(tmpstr, "on") == 0) {
+        ra->flowControlAdaptive = 1;
+    }
+
     /* continue on missing change ? */
     ra->ignoreMissingChange = 0;
     tmpstr = (char *)slapi_entry_attr_get_ref(e, type_replicaIgnoreMissingChange);
@@ -1228,6 +1302,16 @@ agmt_get_flowcontrolpause(const Repl_Agmt *ra)
     PR_Unlock(ra->lock);
     return return_value;
 }
+PRBool
+agmt_get_flowcontroladaptive(const Repl_Agmt *ra)
+{
+    PRBool return_value;
+    PR_ASSERT(NULL != ra);
+    PR_Lock(ra->lock);
+    return_value = ra->flowControlAdaptive ? PR_TRUE : PR_FALSE;
+    PR_Unlock(ra->lock);
+    return return_value;
+}
 long
 agmt_get_ignoremissing(const Repl_Agmt *ra)
 {
@@ -2135,6 +2219,50 @@ agmt_set_flowcontrolpause_from_entry(Repl_Agmt *ra, const Slapi_Entry *e)
     }
     return return_value;
 }
+/*
+ * Enable or disable the adaptive incremental update window
+ *
+ * Returns 0 if set, or -1 if an error occurred.
+ */
+int
+agmt_set_flowcontroladaptive_from_entry(Repl_Agmt *ra, const Slapi_Entry *e)
+{
+    Slapi_Attr *sattr = NULL;
+    int return_value = -1;
+
+    PR_ASSERT(NULL != ra);
+    PR_Lock(ra->lock);
+    if (ra->stop_in_progress) {
+        PR_Unlock(ra->lock);
+        return return_value;
+    }
+
+    slapi_entry_attr_find(e, type_nsds5ReplicaFlowControlAdaptive, &sattr);
+    if (NULL != sattr) {
+        Slapi_Value *sval = NULL;
+        slapi_attr_first_value(sattr, &sval);
+        if (NULL != sval) {
+            const char *tmpval = slapi_value_get_string(sval);
+            if (strcasecmp(tmpval, "on") == 0) {
+                ra->flowControlAdaptive = 1;
+                return_value = 0;
+            } else if (strcasecmp(tmpval, "off") == 0) {
+                ra->flowControlAdaptive = 0;
+                return_value = 0;
+            }
+        }
+    } else {
+        /* attribute removed */
+        ra->flowControlAdaptive = 0;
+        return_value = 0;
+    }
+    PR_Unlock(ra->lock);
+    if (return_value == 0) {
+        prot_notify_agmt_changed(ra->protocol, ra->long_name);
+    }
+    return return_value;
+}
+
 /* add comment here */
 int
 agmt_set_ignoremissing_from_entry(Repl_Agmt *ra, const Slapi_Entry *e)
@@ -2878,6 +3006,299 @@ agmt_get_changecount_string(Repl_Agmt *ra, char *buf, int bufsize)
     }
 }
 
+static size_t
+latency_histogram_index(uint64_t value)
+{
+    uint64_t shift;
+
+    if (value < 2 * AGMT_HIST_SUB_BUCKETS) {
+        return (size_t)value;
+    }
+    if (value >= (1ULL << AGMT_HIST_MAX_BITS)) {
+        value = (1ULL << AGMT_HIST_MAX_BITS) - 1;
+    }
+    shift = (63 - __builtin_clzll(value)) - AGMT_HIST_SUB_BITS;
+    return 2 * AGMT_HIST_SUB_BUCKETS + (shift - 1) * AGMT_HIST_SUB_BUCKETS +
+           ((value >> shift) - AGMT_HIST_SUB_BUCKETS);
+}
+
+/* Highest value accounted in a histogram bucket */
+static uint64_t
+latency_histogram_value(size_t index)
+{
+    uint64_t shift;
+    uint64_t sub;
+
+    if (index < 2 * AGMT_HIST_SUB_BUCKETS) {
+        return (uint64_t)index;
+    }
+    index -= 2 * AGMT_HIST_SUB_BUCKETS;
+    shift = index / AGMT_HIST_SUB_BUCKETS + 1;
+    sub = index % AGMT_HIST_SUB_BUCKETS + AGMT_HIST_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+static void
+latency_histogram_record(struct latency_histogram *h, uint64_t value)
+{
+    slapi_atomic_incr_64(&h->buckets[latency_histogram_index(value)], __ATOMIC_RELAXED);
+    slapi_atomic_store_64(&h->sum, slapi_atomic_load_64(&h->sum, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+    if (value > slapi_atomic_load_64(&h->max, __ATOMIC_RELAXED)) {
+        slapi_atomic_store_64(&h->max, value, __ATOMIC_RELAXED);
+    }
+    slapi_atomic_incr_64(&h->count, __ATOMIC_RELEASE);
+}
+
+/* Value below which permille/1000 of the recorded values are */
+static uint64_t
+latency_histogram_percentile(struct latency_histogram *h, uint64_t count, uint32_t permille)
+{
+    uint64_t max = slapi_atomic_load_64(&h->max, __ATOMIC_RELAXED);
+    uint64_t seen = 0;
+
+    for (size_t i = 0; count > 0 && i < AGMT_HIST_BUCKETS; i++) {
+        seen += slapi_atomic_load_64(&h->buckets[i], __ATOMIC_RELAXED);
+        if (seen * 1000 >= count * permille) {
+            uint64_t value = latency_histogram_value(i);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
+static int
+latency_histogram_to_json(struct latency_histogram *h, uint64_t unit, char *buf, size_t bufsize)
+{
+    uint64_t count = slapi_atomic_load_64(&h->count, __ATOMIC_ACQUIRE);
+    uint64_t sum = slapi_atomic_load_64(&h->sum, __ATOMIC_RELAXED);
+
+    return PR_snprintf(buf, bufsize,
+                       "{\"mean\": %" PRIu64 ", \"p50\": %" PRIu64 ", \"p90\": %" PRIu64 ", "
+                       "\"p99\": %" PRIu64 ", \"p999\": %" PRIu64 ", \"max\": %" PRIu64 "}",
+                       count ? sum / count / unit : 0,
+                       latency_histogram_percentile(h, count, 500) / unit,
+                       latency_histogram_percentile(h, count, 900) / unit,
+                       latency_histogram_percentile(h, count, 990) / unit,
+                       latency_histogram_percentile(h, count, 999) / unit,
+                       slapi_atomic_load_64(&h->max, __ATOMIC_RELAXED) / unit);
+}
+
+/* Number of updates that may be sent to the consumer without acknowledgment */
+long
+agmt_flowcontrol_get_window(Repl_Agmt *ra)
+{
+    long max_window = agmt_get_flowcontrolwindow(ra);
+    uint64_t window;
+
+    if (!agmt_get_flowcontroladaptive(ra)) {
+        return max_window;
+    }
+    window = slapi_atomic_load_64(&ra->flowControl.window, __ATOMIC_RELAXED);
+    if (window == 0) {
+        window = AGMT_FC_INIT_WINDOW;
+    }
+    return (long)window < max_window ? (long)window : max_window;
+}
+
+/* The sender had to wait for acknowledgments, the window is what limits it */
+void
+agmt_flowcontrol_window_full(Repl_Agmt *ra)
+{
+    slapi_atomic_store_64(&ra->flowControl.window_full, 1, __ATOMIC_RELAXED);
+}
+
+/* The consumer timed out, halve the window */
+void
+agmt_flowcontrol_congestion(Repl_Agmt *ra)
+{
+    struct flowcontrol_state *fc = &ra->flowControl;
+    uint64_t window = slapi_atomic_load_64(&fc->window, __ATOMIC_RELAXED);
+
+    if (window == 0) {
+        window = AGMT_FC_INIT_WINDOW;
+    }
+    window = window / 2 > AGMT_FC_MIN_WINDOW ? window / 2 : AGMT_FC_MIN_WINDOW;
+    slapi_atomic_store_64(&fc->ssthresh, window, __ATOMIC_RELAXED);
+    slapi_atomic_store_64(&fc->window, window, __ATOMIC_RELAXED);
+    slapi_atomic_store_64(&fc->round_acks, 0, __ATOMIC_RELAXED);
+    slapi_atomic_store_64(&fc->round_start, 0, __ATOMIC_RELAXED);
+    slapi_atomic_incr_64(&fc->decreases, __ATOMIC_RELAXED);
+}
+
+static void
+agmt_flowcontrol_ack(Repl_Agmt *ra, uint64_t rtt, uint64_t now)
+{
+    struct flowcontrol_state *fc = &ra->flowControl;
+    uint64_t srtt = slapi_atomic_load_64(&fc->srtt, __ATOMIC_RELAXED);
+    uint64_t min_rtt = slapi_atomic_load_64(&fc->min_rtt, __ATOMIC_RELAXED);
+    uint64_t round_start = slapi_atomic_load_64(&fc->round_start, __ATOMIC_RELAXED);
+    uint64_t window = slapi_atomic_load_64(&fc->window, __ATOMIC_RELAXED);
+    uint64_t max_window;
+    uint64_t ssthresh;
+    uint64_t queued;
+    uint64_t acks;
+
+    srtt = srtt ? srtt - srtt / 8 + rtt / 8 : rtt;
+    slapi_atomic_store_64(&fc->srtt, srtt, __ATOMIC_RELAXED);
+    if (min_rtt == 0 || rtt < min_rtt ||
+        now / 1000000 > slapi_atomic_load_64(&fc->min_rtt_stamp, __ATOMIC_RELAXED) + AGMT_FC_MIN_RTT_LIFETIME) {
+        min_rtt = rtt;
+        slapi_atomic_store_64(&fc->min_rtt, min_rtt, __ATOMIC_RELAXED);
+        slapi_atomic_store_64(&fc->min_rtt_stamp, now / 1000000, __ATOMIC_RELAXED);
+    }
+    if (round_start == 0) {
+        round_start = now;
+        slapi_atomic_store_64(&fc->round_start, now, __ATOMIC_RELAXED);
+    }
+    if (window == 0) {
+        window = AGMT_FC_INIT_WINDOW;
+    }
+    acks = slapi_atomic_incr_64(&fc->round_acks, __ATOMIC_RELAXED);
+    if (acks < window) {
+        return;
+    }
+
+    /* A window worth of updates was acknowledged: end of the round */
+    if (now > round_start) {
+        slapi_atomic_store_64(&fc->ack_rate, acks * 1000000 / (now - round_start), __ATOMIC_RELAXED);
+    }
+    queued = srtt > min_rtt ? window * (srtt - min_rtt) / srtt : 0;
+    slapi_atomic_store_64(&fc->queued, queued, __ATOMIC_RELAXED);
+    /* Only adapt when the window limited the sender */
+    if (slapi_atomic_load_64(&fc->window_full, __ATOMIC_RELAXED)) {
+        slapi_atomic_store_64(&fc->window_full, 0, __ATOMIC_RELAXED);
+        ssthresh = slapi_atomic_load_64(&fc->ssthresh, __ATOMIC_RELAXED);
+        if (ssthresh == 0 || window < ssthresh) {
+            if (queued > AGMT_FC_ALPHA) {
+                /* end of slow start, drain what got queued */
+                window = window > queued + AGMT_FC_MIN_WINDOW ? window - queued : AGMT_FC_MIN_WINDOW;
+                slapi_atomic_store_64(&fc->ssthresh, window, __ATOMIC_RELAXED);
+                slapi_atomic_incr_64(&fc->decreases, __ATOMIC_RELAXED);
+            } else {
+                window *= 2;
+                slapi_atomic_incr_64(&fc->increases, __ATOMIC_RELAXED);
+            }
+        } else if (queued < AGMT_FC_ALPHA) {
+            window++;
+            slapi_atomic_incr_64(&fc->increases, __ATOMIC_RELAXED);
+        } else if (queued > AGMT_FC_BETA) {
+            window--;
+            slapi_atomic_incr_64(&fc->decreases, __ATOMIC_RELAXED);
+        }
+    }
+    max_window = (uint64_t)agmt_get_flowcontrolwindow(ra);
+    if (window > max_window) {
+        window = max_window;
+    }
+    if (window < AGMT_FC_MIN_WINDOW) {
+        window = AGMT_FC_MIN_WINDOW;
+    }
+    slapi_atomic_store_64(&fc->window, window, __ATOMIC_RELAXED);
+    slapi_atomic_store_64(&fc->round_acks, 0, __ATOMIC_RELAXED);
+    slapi_atomic_store_64(&fc->round_start, now, __ATOMIC_RELAXED);
+}
+
+static void
+agmt_get_flowcontrol_string(Repl_Agmt *ra, char *buf, size_t bufsize)
+{
+    struct flowcontrol_state *fc = &ra->flowControl;
+    uint64_t window = slapi_atomic_load_64(&fc->window, __ATOMIC_RELAXED);
+    uint64_t ssthresh = slapi_atomic_load_64(&fc->ssthresh, __ATOMIC_RELAXED);
+    PRBool adaptive = agmt_get_flowcontroladaptive(ra);
+
+    PR_snprintf(buf, bufsize,
+                "{\"mode\": \"%s\", \"window\": %ld, \"max_window\": %ld, \"phase\": \"%s\", "
+                "\"ssthresh\": %" PRIu64 ", \"srtt_us\": %" PRIu64 ", \"min_rtt_us\": %" PRIu64 ", "
+                "\"ack_rate\": %" PRIu64 ", \"queued\": %" PRIu64 ", "
+                "\"increases\": %" PRIu64 ", \"decreases\": %" PRIu64 "}",
+                adaptive ? "adaptive" : "static",
+                agmt_flowcontrol_get_window(ra),
+                agmt_get_flowcontrolwindow(ra),
+                (ssthresh == 0 || (window ? window : AGMT_FC_INIT_WINDOW) < ssthresh) ? "slow-start" : "congestion-avoidance",
+                ssthresh,
+                slapi_atomic_load_64(&fc->srtt, __ATOMIC_RELAXED),
+                slapi_atomic_load_64(&fc->min_rtt, __ATOMIC_RELAXED),
+                slapi_atomic_load_64(&fc->ack_rate, __ATOMIC_RELAXED),
+                slapi_atomic_load_64(&fc->queued, __ATOMIC_RELAXED),
+                slapi_atomic_load_64(&fc->increases, __ATOMIC_RELAXED),
+                slapi_atomic_load_64(&fc->decreases, __ATOMIC_RELAXED));
+}
+
+/*
+ * Account for an update the consumer acknowledged.  csn_time is the time the
+ * change was originally made, as recorded in its CSN (one second resolution,
+ * and subject to clock skew when the change was made on another supplier),
+ * sent_time is the monotonic time at which the update was sent.
+ */
+void
+agmt_record_update_ack(Repl_Agmt *ra, time_t csn_time, struct timespec *sent_time)
+{
+    struct timespec now_utc = slapi_current_utc_time_hr();
+    struct timespec now_rel = slapi_current_rel_time_hr();
+    struct timespec elapsed = {0};
+    uint64_t lag = 0;
+    uint64_t slot;
+
+    if (NULL == ra) {
+        return;
+    }
+    if (now_utc.tv_sec >= csn_time) {
+        lag = (uint64_t)(now_utc.tv_sec - csn_time) * 1000000 + now_utc.tv_nsec / 1000;
+    }
+    latency_histogram_record(&ra->latency.lag, lag);
+    slapi_timespec_diff(&now_rel, sent_time, &elapsed);
+    if (elapsed.tv_sec >= 0) {
+        uint64_t rtt = (uint64_t)elapsed.tv_sec * 1000000 + elapsed.tv_nsec / 1000;
+        latency_histogram_record(&ra->latency.ack, rtt);
+        agmt_flowcontrol_ack(ra, rtt, (uint64_t)now_rel.tv_sec * 1000000 + now_rel.tv_nsec / 1000);
+    }
+
+    slot = (uint64_t)now_rel.tv_sec % AGMT_RATE_SLOTS;
+    if (slapi_atomic_load_64(&ra->latency.rate_time[slot], __ATOMIC_RELAXED) != (uint64_t)now_rel.tv_sec) {
+        slapi_atomic_store_64(&ra->latency.rate_count[slot], 0, __ATOMIC_RELAXED);
+        slapi_atomic_store_64(&ra->latency.rate_time[slot], (uint64_t)now_rel.tv_sec, __ATOMIC_RELEASE);
+    }
+    slapi_atomic_incr_64(&ra->latency.rate_count[slot], __ATOMIC_RELAXED);
+}
+
+/* Updates acknowledged during the last AGMT_RATE_SLOTS seconds */
+static uint64_t
+agmt_get_update_rate_count(Repl_Agmt *ra)
+{
+    uint64_t now = (uint64_t)slapi_current_rel_time_t();
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < AGMT_RATE_SLOTS; i++) {
+        uint64_t when = slapi_atomic_load_64(&ra->latency.rate_time[i], __ATOMIC_ACQUIRE);
+        if (when && when + AGMT_RATE_SLOTS > now) {
+            total += slapi_atomic_load_64(&ra->latency.rate_count[i], __ATOMIC_RELAXED);
+        }
+    }
+    return total;
+}
+
+/*
+ * Summary of the replication lag of this agreement:
+ * lag_ms - time between the change and its acknowledgment by the consumer
+ * ack_us - time between sending the update and its acknowledgment
+ */
+static void
+agmt_get_update_latency_string(Repl_Agmt *ra, char *buf, size_t bufsize)
+{
+    char lag_buf[256];
+    char ack_buf[256];
+    uint64_t last_minute = agmt_get_update_rate_count(ra);
+
+    latency_histogram_to_json(&ra->latency.lag, 1000, lag_buf, sizeof(lag_buf));
+    latency_histogram_to_json(&ra->latency.ack, 1, ack_buf, sizeof(ack_buf));
+    PR_snprintf(buf, bufsize,
+                "{\"samples\": %" PRIu64 ", \"updates_last_minute\": %" PRIu64 ", "
+                "\"updates_per_sec\": %.2f, \"lag_ms\": %s, \"ack_us\": %s}",
+                slapi_atomic_load_64(&ra->latency.lag.count, __ATOMIC_ACQUIRE),
+                last_minute, (double)last_minute / AGMT_RATE_SLOTS,
+                lag_buf, ack_buf);
+}
+
 static int
 get_agmt_status(Slapi_PBlock *pb __attribute__((unused)),
                 Slapi_Entry *e,
@@ -2888,6 +3309,7 @@ get_agmt_status(Slapi_PBlock *pb __attribute__((unused)),
 {
     char *time_tmp = NULL;
     char changecount_string[BUFSIZ];
+    char latency_string[STATUS_LEN];
     Repl_Agmt *ra = (Repl_Agmt *)arg;
 
     PR_ASSERT(NULL != ra);
@@ -2930,6 +3352,14 @@ get_agmt_status(Slapi_PBlock *pb __attribute__((unused)),
 
         agmt_get_changecount_string(ra, changecount_string, sizeof(changecount_string));
         slapi_entry_add_string(e, "nsds5replicaChangesSentSinceStartup", changecount_string);
+        agmt_get_update_latency_string(ra, latency_string, sizeof(latency_string));
+        slapi_entry_attr_set_charptr(e, "nsds5replicaUpdateLatencyJSON", latency_string);
+        agmt_get_flowcontrol_string(ra, latency_string, sizeof(latency_string));
+        slapi_entry_attr_set_charptr(e, "nsds5replicaFlowControlStateJSON", latency_string);
+        slapi_entry_attr_set_ulong(e, "nsds5replicaUpdateLagP99",
+                                   latency_histogram_percentile(&ra->latency.lag,
+                                                                slapi_atomic_load_64(&ra->latency.lag.count, __ATOMIC_ACQUIRE),
+                                                                990) / 1000);
         if (ra->last_update_status[0] == '\0') {
             char status_msg[STATUS_LEN];
             char ts[SLAPI_TIMESTAMP_BUFSIZE];
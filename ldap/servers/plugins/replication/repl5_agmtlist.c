@@ -381,6 +381,15 @@ agmtlist_modify_callback(Slapi_PBlock *pb,
                 *returncode = LDAP_OPERATIONS_ERROR;
                 rc = SLAPI_DSE_CALLBACK_ERROR;
             }
+        } else if (slapi_attr_types_equivalent(mods[i]->mod_type,
+                                               type_nsds5ReplicaFlowControlAdaptive)) {
+            if (agmt_set_flowcontroladaptive_from_entry(agmt, e) != 0) {
+                slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name, "agmtlist_modify_callback - "
+                                                               "Failed to update the adaptive flow control for agreement %s\n",
+                              agmt_get_long_name(agmt));
+                *returncode = LDAP_UNWILLING_TO_PERFORM;
+                rc = SLAPI_DSE_CALLBACK_ERROR;
+            }
         } else if (slapi_attr_types_equivalent(mods[i]->mod_type,
                                                type_replicaIgnoreMissingChange)) {
             /* New replica timeout */
@@ -64,6 +64,8 @@ typedef struct repl5_inc_operation
     char csn_str[CSN_STRSIZE];
     char uniqueid[UIDSTR_SIZE + 1];
     ReplicaId replica_id;
+    time_t csn_time;            /* time of the change, to measure the replication lag */
+    struct timespec sent_time;  /* when the update was sent to the consumer */
     struct repl5_inc_operation *next;
 } repl5_inc_operation;
 
@@ -72,6 +74,7 @@ typedef struct result_data
     Private_Repl_Protocol *prp;
     int rc;
     PRLock *lock;                             /* Lock to protect access to this structure, the message id list and to force memory barriers */
+    PRCondVar *ack_cvar;                      /* Signaled when a result is read, for the adaptive flow control */
     PRThread *result_tid;                     /* The async result thread */
     repl5_inc_operation *operation_list_head; /* List of IDs for outstanding operations */
     repl5_inc_operation *operation_list_tail; /* List of IDs for outstanding operations */
@@ -171,22 +174,43 @@ repl5_int_push_operation(result_data *rd, repl5_inc_operation *it)
     PR_Unlock(rd->lock);
 }
 
-/* Pop the next operation in line to respond from the list */
-/* The caller is expected to free the operation item */
+/* Pop the operation the result of message_id responds to from the list.
+ * A consumer applying the updates concurrently may return the results out
+ * of order, fall back to the head of the list if the id is unknown.
+ * The caller is expected to free the operation item */
 static repl5_inc_operation *
-repl5_inc_pop_operation(result_data *rd)
+repl5_inc_pop_operation(result_data *rd, int message_id)
 {
-    repl5_inc_operation *head = NULL;
+    repl5_inc_operation *prev = NULL;
     repl5_inc_operation *ret = NULL;
     PR_Lock(rd->lock);
-    head = rd->operation_list_head;
-    if (head) {
-        ret = head;
-        rd->operation_list_head = head->next;
-        if (rd->operation_list_tail == head) {
-            rd->operation_list_tail = NULL;
+    for (ret = rd->operation_list_head; ret && ret->ldap_message_id != message_id; ret = ret->next) {
+        prev = ret;
+    }
+    if (NULL == ret) {
+        prev = NULL;
+        ret = rd->operation_list_head;
+    }
+    if (ret) {
+        if (prev) {
+            prev->next = ret->next;
+        } else {
+            rd->operation_list_head = ret->next;
+        }
+        if (rd->operation_list_tail == ret) {
+            rd->operation_list_tail = prev;
+        }
+        ret->next = NULL;
+    }
+    /* Every operation sent before the oldest outstanding one got its result */
+    if (rd->operation_list_head) {
+        if (rd->operation_list_head->ldap_message_id - 1 > rd->last_message_id_received) {
+            rd->last_message_id_received = rd->operation_list_head->ldap_message_id - 1;
         }
+    } else if (message_id > rd->last_message_id_received) {
+        rd->last_message_id_received = message_id;
     }
+    PR_NotifyCondVar(rd->ack_cvar);
     PR_Unlock(rd->lock);
     return ret;
 }
@@ -310,13 +334,11 @@ repl5_inc_result_threadmain(void *param)
         if (conres != CONN_TIMEOUT) {
             int return_value;
             int should_finish = 0;
-            if (message_id) {
-                rd->last_message_id_received = message_id;
-            }
             /* Handle any error etc */
 
-            /* Get the stored operation details from the queue, unless we timed out... */
-            op = repl5_inc_pop_operation(rd);
+            /* Get the stored operation details from the queue, unless we timed out...
+             * This also moves last_message_id_received forward */
+            op = repl5_inc_pop_operation(rd, message_id);
             if (op) {
                 csn_str = op->csn_str;
                 replica_id = op->replica_id;
@@ -330,6 +352,9 @@ repl5_inc_result_threadmain(void *param)
             return_value = repl5_inc_update_from_op_result(rd->prp, conres, connection_error,
                                                            csn_str, uniqueid, replica_id, &should_finish,
                                                            &(rd->num_changes_sent));
+            if (op && CONN_OPERATION_SUCCESS == conres) {
+                agmt_record_update_ack(rd->prp->agmt, op->csn_time, &op->sent_time);
+            }
             if (return_value || should_finish) {
                 slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
                               "repl5_inc_result_threadmain - Got op result %d should finish %d\n",
@@ -338,6 +363,7 @@ repl5_inc_result_threadmain(void *param)
                 PR_Lock(rd->lock);
                 rd->result = return_value;
                 rd->abort = ABORT_SESSION;
+                PR_NotifyCondVar(rd->ack_cvar);
                 PR_Unlock(rd->lock);
                 /*
                  * We also need to log the error, including details stored from
@@ -353,6 +379,13 @@ repl5_inc_result_threadmain(void *param)
                 /* old semantics had result set outside of lock */
                 rd->result = return_value;
             }
+        } else if (!finished) {
+            /* The consumer did not answer in time, back off if updates were pending */
+            PR_Lock(rd->lock);
+            if (rd->operation_list_head) {
+                agmt_flowcontrol_congestion(rd->prp->agmt);
+            }
+            PR_Unlock(rd->lock);
         }
 
         /* Should we stop ? */
@@ -386,6 +419,10 @@ repl5_inc_rd_new(Private_Repl_Protocol *prp)
         if (NULL == res->lock) {
             slapi_ch_free((void **)&res);
             res = NULL;
+        } else if (NULL == (res->ack_cvar = PR_NewCondVar(res->lock))) {
+            PR_DestroyLock(res->lock);
+            slapi_ch_free((void **)&res);
+            res = NULL;
         }
     }
     return res;
@@ -405,6 +442,9 @@ static void
 repl5_inc_rd_destroy(result_data **pres)
 {
     result_data *res = *pres;
+    if (res->ack_cvar) {
+        PR_DestroyCondVar(res->ack_cvar);
+    }
     if (res->lock) {
         PR_DestroyLock(res->lock);
     }
@@ -453,10 +493,31 @@ repl5_inc_destroy_async_result_thread(result_data *rd)
  * to apply the sent updates and return the acks.
  * So the caller should not hold the replication connection lock
  * to let the RA.reader receives the acks.
+ * With the adaptive flow control, the sender resumes as soon as the
+ * window opens again instead of sleeping the whole pause.
  */
 static void
 repl5_inc_flow_control_results(Repl_Agmt *agmt, result_data *rd)
 {
+    if (agmt_get_flowcontroladaptive(agmt)) {
+        long window = agmt_flowcontrol_get_window(agmt);
+        PRIntervalTime pause = PR_MillisecondsToInterval(agmt_get_flowcontrolpause(agmt));
+        PRIntervalTime start = PR_IntervalNow();
+
+        PR_Lock(rd->lock);
+        if ((rd->last_message_id_received <= rd->last_message_id_sent) &&
+            ((rd->last_message_id_sent - rd->last_message_id_received) >= window)) {
+            rd->flowcontrol_detection++;
+            agmt_flowcontrol_window_full(agmt);
+            while (!rd->abort && !rd->stop_result_thread &&
+                   (rd->last_message_id_sent - rd->last_message_id_received) >= window &&
+                   (PRIntervalTime)(PR_IntervalNow() - start) < pause) {
+                PR_WaitCondVar(rd->ack_cvar, pause - (PRIntervalTime)(PR_IntervalNow() - start));
+            }
+        }
+        PR_Unlock(rd->lock);
+        return;
+    }
     PR_Lock(rd->lock);
     if ((rd->last_message_id_received <= rd->last_message_id_sent) &&
         ((rd->last_message_id_sent - rd->last_message_id_received) >= agmt_get_flowcontrolwindow(agmt))) {
@@ -1547,6 +1608,7 @@ send_updates(Private_Repl_Protocol *prp, RUV *remote_update_vector, PRUint32 *nu
     int rc;
     CL5ReplayIterator *changelog_iterator;
     int message_id = 0;
+    struct timespec sent_time;
     result_data *rd = NULL;
 
     *num_changes_sent = 0;
@@ -1707,6 +1769,7 @@ send_updates(Private_Repl_Protocol *prp, RUV *remote_update_vector, PRUint32 *nu
                     continue;
                 }
                 replay_crc = replay_update(prp, entry.op, &message_id);
+                sent_time = slapi_current_rel_time_hr();
                 if (message_id) {
                     rd->last_message_id_sent = message_id;
                 }
@@ -1782,6 +1845,9 @@ send_updates(Private_Repl_Protocol *prp, RUV *remote_update_vector, PRUint32 *nu
                         conn_get_error(prp->conn, &operation, &error);
                         csn_as_string(entry.op->csn, PR_FALSE, csn_str);
                         return_value = repl5_inc_update_from_op_result(prp, replay_crc, error, csn_str, uniqueid, replica_id, &finished, num_changes_sent);
+                        if (CONN_OPERATION_SUCCESS == replay_crc) {
+                            agmt_record_update_ack(prp->agmt, csn_get_time(entry.op->csn), &sent_time);
+                        }
                     } else if (message_id) {
                         /* Queue the details for pickup later in the response thread */
                         repl5_inc_operation *sop = NULL;
@@ -1790,6 +1856,8 @@ send_updates(Private_Repl_Protocol *prp, RUV *remote_update_vector, PRUint32 *nu
                         sop->ldap_message_id = message_id;
                         sop->operation_type = entry.op->operation_type;
                         sop->replica_id = replica_id;
+                        sop->csn_time = csn_get_time(entry.op->csn);
+                        sop->sent_time = sent_time;
                         PL_strncpyz(sop->uniqueid, uniqueid, sizeof(sop->uniqueid));
                         repl5_int_push_operation(rd, sop);
                         repl5_inc_flow_control_results(prp->agmt, rd);
@@ -1376,7 +1376,11 @@ process_operation(Slapi_PBlock *pb, const CSN *csn)
     ruv = (RUV *)object_get_data(ruv_obj);
     PR_ASSERT(ruv);
 
+    /* When the consumer applies the updates of the session concurrently,
+     * their CSNs must still enter the pending list in the order they were sent */
+    slapi_repl_apply_csn_turn_wait(pb);
     rc = ruv_add_csn_inprogress(r, ruv, csn);
+    slapi_repl_apply_csn_turn_done(pb);
 
     object_release(ruv_obj);
 
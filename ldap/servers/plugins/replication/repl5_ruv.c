@@ -37,6 +37,7 @@
 #include "repl5_ruv.h"
 #include "repl_shared.h"
 #include "repl5.h"
+#include "slap.h" /* struct csn, for the RUV index snapshots */
 
 #define RIDSTR_SIZE 16  /* string large enough to hold replicaid*/
 #define RUVSTR_SIZE 256 /* string large enough to hold ruv and lastmodifiedtime */
@@ -54,12 +55,61 @@ typedef struct ruvElement
     time_t last_modified; /* timestamp the modification of csn */
 } RUVElement;
 
+/*
+ * Replica id index of the RUV elements.
+ *
+ * The elements stay in the DataList, whose order is significant when the RUV
+ * is written out, and the index gives constant time lookups by replica id.
+ * Each slot also holds a copy of the element min and max CSNs guarded by a
+ * sequence counter (seqlock), so the hot read paths (ruv_covers_csn,
+ * ruv_get_largest_csn_for_replica, ...) get a consistent snapshot without
+ * taking the RUV lock: a reader retries if a writer updated the slot while
+ * it was copying it.  Writers hold the RUV write lock, as before.
+ * The table uses open addressing and never forgets a replica id (a deleted
+ * replica just loses RUV_SLOT_PRESENT), so probe sequences are stable.  When
+ * it grows the previous table is kept until the RUV is destroyed, a lock free
+ * reader still walking it sees the state at the time of the switch.
+ */
+#define RUV_INDEX_MIN_SIZE 8 /* power of two */
+#define RUV_CSN_WORDS ((sizeof(CSN) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+#define RUV_SLOT_PRESENT 0x1 /* the replica is in the RUV */
+#define RUV_SLOT_HAS_CSN 0x2
+#define RUV_SLOT_HAS_MIN_CSN 0x4
+
+typedef struct ruvSlot
+{
+    uint32_t key;                     /* replica id + 1, 0 if the slot is free */
+    uint32_t flags;                   /* RUV_SLOT_* */
+    uint64_t seq;                     /* odd while a writer updates the slot */
+    uint64_t csn[RUV_CSN_WORDS];      /* copy of the element max csn */
+    uint64_t min_csn[RUV_CSN_WORDS];  /* copy of the element min csn */
+    RUVElement *replica;              /* only valid with the RUV lock held */
+} RUVSlot;
+
+typedef struct ruvIndex
+{
+    size_t size;              /* number of slots, power of two */
+    size_t used;              /* slots assigned to a replica id */
+    struct ruvIndex *retired; /* tables replaced when this one was allocated */
+    RUVSlot slots[];
+} RUVIndex;
+
+/* consistent copy of an index slot */
+typedef struct ruvSnapshot
+{
+    uint32_t flags;
+    CSN csn;
+    CSN min_csn;
+} RUVSnapshot;
+
 /* replica update vector */
 struct _ruv
 {
     char *replGen;      /* replicated area generation: identifies replica
                                in space and in time */
     DataList *elements; /* replicas */
+    RUVIndex *index;    /* replicas by replica id */
     Slapi_RWLock *lock; /* concurrency control */
 };
 
@@ -67,6 +117,13 @@ struct _ruv
 static int ruvInit(RUV **ruv, int initCount);
 static void ruvFreeReplica(void **data);
 static RUVElement *ruvGetReplica(const RUV *ruv, ReplicaId rid);
+static RUVIndex *ruvIndexNew(size_t count);
+static void ruvIndexFree(RUVIndex **index);
+static void ruvIndexInsert(RUV *ruv, RUVElement *replica);
+static void ruvIndexPublish(RUV *ruv, const RUVElement *replica);
+static void ruvIndexRefresh(RUV *ruv, ReplicaId rid);
+static void ruvIndexRebuild(RUV *ruv);
+static PRBool ruvSnapshotGet(const RUV *ruv, ReplicaId rid, RUVSnapshot *snap);
 static RUVElement *ruvAddReplica(RUV *ruv, const CSN *csn, const char *replica_purl);
 static RUVElement *ruvAddReplicaNoCSN(RUV *ruv, ReplicaId rid, const char *replica_purl);
 static RUVElement *ruvAddIndexReplicaNoCSN(RUV *ruv, ReplicaId rid, const char *replica_purl, int index);
@@ -77,7 +134,8 @@ static PRInt32 ruv_replica_count_nolock(const RUV *ruv, int lock);
 static const char *const prefix_replicageneration = "{replicageneration}";
 static const char *const prefix_ruvcsn = "{replica "; /* intentionally missing '}' */
 
-static int ruv_update_ruv_element(RUV *ruv, RUVElement *replica, const CSNPL_CTX *prim_csn, const char *replica_purl, PRBool isLocal);
+static int ruv_commit_ruv_element(RUVElement *replica, const CSNPL_CTX *prim_csn, PRBool *rollup);
+static int ruv_update_ruv_element(RUV *ruv, RUVElement *replica, const char *replica_purl, PRBool isLocal);
 
 /* API implementation */
 
@@ -215,6 +273,7 @@ ruv_init_from_slapi_attr_and_check_purl(Slapi_Attr *attr, RUV **ruv, ReplicaId *
                                 *contain_purl = ruve->rid;
                             }
                             dl_add((*ruv)->elements, ruve);
+                            ruvIndexInsert(*ruv, ruve);
                         }
                     }
                 }
@@ -267,6 +326,7 @@ ruv_init_from_bervals(struct berval **vals, RUV **ruv)
                         RUVElement *ruve = get_ruvelement_from_berval(vals[i]);
                         if (NULL != ruve) {
                             dl_add((*ruv)->elements, ruve);
+                            ruvIndexInsert(*ruv, ruve);
                         }
                     }
                 }
@@ -312,6 +372,7 @@ ruv_dup(const RUV *ruv)
            we don't need it. */
 
         dl_add(dupRUV->elements, dupReplica);
+        ruvIndexInsert(dupRUV, dupReplica);
     }
 
 done:
@@ -328,6 +389,7 @@ ruv_destroy(RUV **ruv)
             dl_cleanup((*ruv)->elements, ruvFreeReplica);
             dl_free(&(*ruv)->elements);
         }
+        ruvIndexFree(&(*ruv)->index);
         /* slapi_ch_free accepts NULL pointer */
         slapi_ch_free((void **)&((*ruv)->replGen));
 
@@ -366,6 +428,8 @@ ruv_copy_and_destroy(RUV **srcruv, RUV **destruv)
             dl_cleanup(elemp, ruvFreeReplica);
             dl_free(&elemp);
         }
+        ruvIndexRebuild(*destruv);
+        ruvIndexFree(&(*srcruv)->index);
 
         /* slapi_ch_free accepts NULL pointer */
         replgp = (*destruv)->replGen;
@@ -393,6 +457,7 @@ ruv_delete_replica(RUV *ruv, ReplicaId rid)
         /* check for duplicates */
         slapi_rwlock_wrlock(ruv->lock);
         dl_delete(ruv->elements, (const void *)&rid, ruvReplicaCompare, ruvFreeReplica);
+        ruvIndexRefresh(ruv, rid);
         slapi_rwlock_unlock(ruv->lock);
         return_value = RUV_SUCCESS;
     }
@@ -448,6 +513,7 @@ ruv_replace_replica_purl_nolock(RUV *ruv, ReplicaId rid, const char *replica_pur
             replica->replica_purl = slapi_ch_strdup(replica_purl);
             /* Also, reset csn and min_csn. */
             replica->csn = replica->min_csn = NULL;
+            ruvIndexPublish(ruv, replica);
         }
         rc = RUV_SUCCESS;
     }
@@ -483,16 +549,12 @@ ruv_add_index_replica(RUV *ruv, ReplicaId rid, const char *replica_purl, int ind
 PRBool
 ruv_contains_replica(const RUV *ruv, ReplicaId rid)
 {
-    RUVElement *replica;
+    RUVSnapshot snap;
 
     if (ruv == NULL)
         return PR_FALSE;
 
-    slapi_rwlock_rdlock(ruv->lock);
-    replica = ruvGetReplica(ruv, rid);
-    slapi_rwlock_unlock(ruv->lock);
-
-    return replica != NULL;
+    return ruvSnapshotGet(ruv, rid, &snap);
 }
 
 
@@ -501,7 +563,7 @@ ruv_contains_replica(const RUV *ruv, ReplicaId rid)
 static int
 get_csn_internal(const RUV *ruv, ReplicaId rid, CSN **csn, int whichone)
 {
-    RUVElement *replica;
+    RUVSnapshot snap;
     int return_value = RUV_SUCCESS;
 
     if (ruv == NULL || csn == NULL) {
@@ -509,26 +571,21 @@ get_csn_internal(const RUV *ruv, ReplicaId rid, CSN **csn, int whichone)
         return_value = RUV_BAD_DATA;
     } else {
         *csn = NULL;
-        /* prevent element from being destroyed while we get its data */
-        slapi_rwlock_rdlock(ruv->lock);
-
-        replica = ruvGetReplica(ruv, rid);
         /* replica without min csn is treated as a non-existent replica */
-        if (replica == NULL || replica->min_csn == NULL) {
+        if (!ruvSnapshotGet(ruv, rid, &snap) || !(snap.flags & RUV_SLOT_HAS_MIN_CSN)) {
             return_value = RUV_NOTFOUND;
         } else {
             switch (whichone) {
             case GET_LARGEST_CSN:
-                *csn = replica->csn ? csn_dup(replica->csn) : NULL;
+                *csn = (snap.flags & RUV_SLOT_HAS_CSN) ? csn_dup(&snap.csn) : NULL;
                 break;
             case GET_SMALLEST_CSN:
-                *csn = replica->min_csn ? csn_dup(replica->min_csn) : NULL;
+                *csn = csn_dup(&snap.min_csn);
                 break;
             default:
                 *csn = NULL;
             }
         }
-        slapi_rwlock_unlock(ruv->lock);
     }
     return return_value;
 }
@@ -581,6 +638,7 @@ set_min_csn_nolock(RUV *ruv, const CSN *min_csn, const char *replica_purl)
         if (replica->min_csn == NULL || csn_compare(min_csn, replica->min_csn) < 0) {
             csn_free(&replica->min_csn);
             replica->min_csn = csn_dup(min_csn);
+            ruvIndexPublish(ruv, replica);
         }
 
         return_value = RUV_SUCCESS;
@@ -608,6 +666,7 @@ set_max_csn_nolock_ext(RUV *ruv, const CSN *max_csn, const char *replica_purl, P
             csn_free(&replica->csn);
             replica->csn = csn_dup(max_csn);
             replica->last_modified = slapi_current_utc_time();
+            ruvIndexPublish(ruv, replica);
         } else {
             char csn1[CSN_STRSIZE + 1];
             char csn2[CSN_STRSIZE + 1];
@@ -694,6 +753,7 @@ ruv_set_csns(RUV *ruv, const CSN *csn, const char *replica_purl)
                 csn_free(&replica->min_csn);
                 replica->min_csn = csn_dup(csn);
             }
+            ruvIndexPublish(ruv, replica);
             return_value = RUV_SUCCESS;
         }
 
@@ -735,6 +795,7 @@ ruv_set_csns_keep_smallest(RUV *ruv, const CSN *csn)
                 csn_free(&replica->csn);
                 replica->csn = csn_dup(csn);
                 replica->last_modified = slapi_current_utc_time();
+                ruvIndexPublish(ruv, replica);
             }
 
             return_value = RUV_SUCCESS;
@@ -785,7 +846,8 @@ ruv_get_replica_generation(const RUV *ruv)
 static PRBool
 ruv_covers_csn_internal(const RUV *ruv, const CSN *csn, PRBool strict)
 {
-    RUVElement *replica;
+    RUVSnapshot snap;
+    const CSN *max_csn;
     ReplicaId rid;
     PRBool return_value;
 
@@ -794,8 +856,7 @@ ruv_covers_csn_internal(const RUV *ruv, const CSN *csn, PRBool strict)
         return_value = PR_FALSE;
     } else {
         rid = csn_get_replicaid(csn);
-        replica = ruvGetReplica(ruv, rid);
-        if (replica == NULL) {
+        if (!ruvSnapshotGet(ruv, rid, &snap)) {
             /*
              *  We don't know anything about this replica change in the cl, mark it to be zapped.
              *  This could of been a previously cleaned ruv, but the server was restarted before
@@ -812,38 +873,28 @@ ruv_covers_csn_internal(const RUV *ruv, const CSN *csn, PRBool strict)
                 return_value = PR_FALSE;
             }
         } else {
+            max_csn = (snap.flags & RUV_SLOT_HAS_CSN) ? &snap.csn : NULL;
             if (strict) {
-                return_value = (csn_compare(csn, replica->csn) < 0);
+                return_value = (csn_compare(csn, max_csn) < 0);
             } else {
-                return_value = (csn_compare(csn, replica->csn) <= 0);
+                return_value = (csn_compare(csn, max_csn) <= 0);
             }
         }
     }
     return return_value;
 }
 
+/* The coverage checks read the RUV index snapshots and do not take the RUV lock */
 PRBool
 ruv_covers_csn(const RUV *ruv, const CSN *csn)
 {
-    PRBool rc;
-
-    slapi_rwlock_rdlock(ruv->lock);
-    rc = ruv_covers_csn_internal(ruv, csn, PR_FALSE);
-    slapi_rwlock_unlock(ruv->lock);
-
-    return rc;
+    return ruv_covers_csn_internal(ruv, csn, PR_FALSE);
 }
 
 PRBool
 ruv_covers_csn_strict(const RUV *ruv, const CSN *csn)
 {
-    PRBool rc;
-
-    slapi_rwlock_rdlock(ruv->lock);
-    rc = ruv_covers_csn_internal(ruv, csn, PR_TRUE);
-    slapi_rwlock_unlock(ruv->lock);
-
-    return rc;
+    return ruv_covers_csn_internal(ruv, csn, PR_TRUE);
 }
 
 /*
@@ -888,6 +939,15 @@ ruv_get_min_or_max_csn(const RUV *ruv, CSN **csn, int get_the_max, ReplicaId rid
     if (ruv == NULL || csn == NULL) {
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name, "ruv_get_min_or_max_csn - NULL argument\n");
         return_value = RUV_BAD_DATA;
+    } else if (rid) {
+        /* we are only interested in this rid's maxcsn, no need to lock */
+        RUVSnapshot snap;
+
+        *csn = NULL;
+        if (rid != READ_ONLY_REPLICA_ID && !(ignore_cleaned_rid && is_cleaned_rid(rid)) &&
+            ruvSnapshotGet(ruv, rid, &snap) && (snap.flags & RUV_SLOT_HAS_CSN)) {
+            *csn = csn_dup(&snap.csn);
+        }
     } else {
         CSN *found = NULL;
         RUVElement *replica;
@@ -911,17 +971,10 @@ ruv_get_min_or_max_csn(const RUV *ruv, CSN **csn, int get_the_max, ReplicaId rid
                 continue;
             }
 
-            if (rid) { /* we are only interested in this rid's maxcsn */
-                if (replica->rid == rid) {
-                    found = replica->csn;
-                    break;
-                }
-            } else {
-                if (found == NULL ||
-                    (!get_the_max && csn_compare(found, replica->csn) > 0) ||
-                    (get_the_max && csn_compare(found, replica->csn) < 0)) {
-                    found = replica->csn;
-                }
+            if (found == NULL ||
+                (!get_the_max && csn_compare(found, replica->csn) > 0) ||
+                (get_the_max && csn_compare(found, replica->csn) < 0)) {
+                found = replica->csn;
             }
         }
 
@@ -1507,7 +1560,11 @@ ruv_add_csn_inprogress(void *repl, RUV *ruv, const CSN *csn)
 
     PR_ASSERT(ruv && csn);
 
-    /* locate ruvElement */
+    /*
+     * locate ruvElement: the covers check and the insertion are done under
+     * the write lock, a roll up cannot move the element csn past this csn
+     * before it is in the pending list
+     */
     slapi_rwlock_wrlock(ruv->lock);
 
     if (is_cleaned_rid(rid)) {
@@ -1594,7 +1651,7 @@ ruv_cancel_csn_inprogress(void *repl, RUV *ruv, const CSN *csn, ReplicaId local_
 
     prim_csn = get_thread_primary_csn();
     /* locate ruvElement */
-    slapi_rwlock_wrlock(ruv->lock);
+    slapi_rwlock_rdlock(ruv->lock);
     repl_ruv = ruvGetReplica(ruv, csn_get_replicaid(csn));
     if (repl_ruv == NULL) {
         /* ONREPL - log error */
@@ -1661,6 +1718,7 @@ ruv_update_ruv(RUV *ruv, const CSN *csn, const char *replica_purl, void *replica
     ReplicaId prim_rid;
     Replica *repl_it = NULL;
     size_t it = 0;
+    PRBool rollup = PR_FALSE;
 
     CSNPL_CTX *prim_csn = get_thread_primary_csn();
 
@@ -1671,12 +1729,15 @@ ruv_update_ruv(RUV *ruv, const CSN *csn, const char *replica_purl, void *replica
 
     /* first handle primary replica
      * there can be two ruv elements affected
+     * The csns are committed with the RUV read locked, concurrently with the
+     * other operations, the write lock is only needed to roll up the pending
+     * lists and that is left to whoever commits the oldest pending csn.
      */
     prim_rid = csn_get_replicaid(csn);
-    slapi_rwlock_wrlock(ruv->lock);
+    slapi_rwlock_rdlock(ruv->lock);
     if (local_rid != prim_rid) {
         repl_ruv = ruvGetReplica(ruv, prim_rid);
-        if ((rc = ruv_update_ruv_element(ruv, repl_ruv, prim_csn, replica_purl, PR_FALSE))) {
+        if ((rc = ruv_commit_ruv_element(repl_ruv, prim_csn, &rollup))) {
             slapi_rwlock_unlock(ruv->lock);
             slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
                           "ruv_update_ruv - failed to update primary ruv, error (%d)", rc);
@@ -1684,21 +1745,46 @@ ruv_update_ruv(RUV *ruv, const CSN *csn, const char *replica_purl, void *replica
         }
     }
     repl_ruv = ruvGetReplica(ruv, local_rid);
-    rc = ruv_update_ruv_element(ruv, repl_ruv, prim_csn, replica_purl, PR_TRUE);
+    rc = ruv_commit_ruv_element(repl_ruv, prim_csn, &rollup);
     slapi_rwlock_unlock(ruv->lock);
     if (rc)
         return rc;
 
+    if (rollup) {
+        slapi_rwlock_wrlock(ruv->lock);
+        if (local_rid != prim_rid) {
+            repl_ruv = ruvGetReplica(ruv, prim_rid);
+            if ((rc = ruv_update_ruv_element(ruv, repl_ruv, replica_purl, PR_FALSE))) {
+                slapi_rwlock_unlock(ruv->lock);
+                slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
+                              "ruv_update_ruv - failed to update primary ruv, error (%d)", rc);
+                return rc;
+            }
+        }
+        repl_ruv = ruvGetReplica(ruv, local_rid);
+        rc = ruv_update_ruv_element(ruv, repl_ruv, replica_purl, PR_TRUE);
+        slapi_rwlock_unlock(ruv->lock);
+        if (rc)
+            return rc;
+    }
+
     /* now handle secondary replicas */
     for (it = 0; it < prim_csn->repl_cnt; it++) {
         repl_it = prim_csn->sec_repl[it];
         replica_lock_replica(repl_it);
         Object *ruv_obj = replica_get_ruv(repl_it);
         RUV *ruv_it = object_get_data(ruv_obj);
-        slapi_rwlock_wrlock(ruv_it->lock);
+        rollup = PR_FALSE;
+        slapi_rwlock_rdlock(ruv_it->lock);
         repl_ruv = ruvGetReplica(ruv_it, replica_get_rid(repl_it));
-        rc = ruv_update_ruv_element(ruv_it, repl_ruv, prim_csn, replica_purl, PR_TRUE);
+        rc = ruv_commit_ruv_element(repl_ruv, prim_csn, &rollup);
         slapi_rwlock_unlock(ruv_it->lock);
+        if (rc == RUV_SUCCESS && rollup) {
+            slapi_rwlock_wrlock(ruv_it->lock);
+            repl_ruv = ruvGetReplica(ruv_it, replica_get_rid(repl_it));
+            rc = ruv_update_ruv_element(ruv_it, repl_ruv, replica_purl, PR_TRUE);
+            slapi_rwlock_unlock(ruv_it->lock);
+        }
         replica_unlock_replica(repl_it);
         if (rc)
             break;
@@ -1706,13 +1792,16 @@ ruv_update_ruv(RUV *ruv, const CSN *csn, const char *replica_purl, void *replica
     return rc;
 }
 
+/*
+ * Commit the csns of an operation in the pending list of a RUV element,
+ * with the RUV locked at least for reading.  rollup is set when the list
+ * can be rolled up.
+ */
 static int
-ruv_update_ruv_element(RUV *ruv, RUVElement *replica, const CSNPL_CTX *prim_csn, const char *replica_purl, PRBool isLocal)
+ruv_commit_ruv_element(RUVElement *replica, const CSNPL_CTX *prim_csn, PRBool *rollup)
 {
     int rc = RUV_SUCCESS;
     char csn_str[CSN_STRSIZE];
-    CSN *max_csn;
-    CSN *first_csn = NULL;
 
     if (replica == NULL) {
         /* we should have a ruv element at this point because it would have
@@ -1735,6 +1824,26 @@ ruv_update_ruv_element(RUV *ruv, RUVElement *replica, const CSNPL_CTX *prim_csn,
                           csn_as_string(prim_csn->prim_csn, PR_FALSE, csn_str));
         }
     }
+    if (csnplRollUpReady(replica->csnpl)) {
+        *rollup = PR_TRUE;
+    }
+done:
+
+    return rc;
+}
+
+/* Roll up the pending list of a RUV element into its csns, with the RUV write locked */
+static int
+ruv_update_ruv_element(RUV *ruv, RUVElement *replica, const char *replica_purl, PRBool isLocal)
+{
+    int rc = RUV_SUCCESS;
+    char csn_str[CSN_STRSIZE];
+    CSN *max_csn;
+    CSN *first_csn = NULL;
+
+    if (replica == NULL) {
+        return rc;
+    }
 
     if ((max_csn = csnplRollUp(replica->csnpl, &first_csn)) != NULL) {
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name, "ruv_update_ruv - Rolled up to csn %s\n",
@@ -1757,7 +1866,6 @@ ruv_update_ruv_element(RUV *ruv, RUVElement *replica, const CSNPL_CTX *prim_csn,
         }
         csn_free(&max_csn);
     }
-done:
 
     return rc;
 }
@@ -1780,6 +1888,7 @@ ruvInit(RUV **ruv, int initCount)
     (*ruv)->elements = dl_new(); /* never returns NULL */
 
     dl_init((*ruv)->elements, initCount);
+    (*ruv)->index = ruvIndexNew(initCount);
 
     /* create lock */
     (*ruv)->lock = slapi_new_rwlock();
@@ -1787,6 +1896,7 @@ ruvInit(RUV **ruv, int initCount)
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
                       "ruvInit - Failed to create lock\n");
         dl_free(&(*ruv)->elements);
+        ruvIndexFree(&(*ruv)->index);
         slapi_ch_free((void **)ruv);
         return RUV_NSPR_ERROR;
     }
@@ -1842,6 +1952,7 @@ ruvAddReplica(RUV *ruv, const CSN *csn, const char *replica_purl)
     replica->csnpl = csnplNew();
 
     dl_add(ruv->elements, replica);
+    ruvIndexInsert(ruv, replica);
 
     return replica;
 }
@@ -1866,6 +1977,7 @@ ruvAddReplicaNoCSN(RUV *ruv, ReplicaId rid, const char *replica_purl)
     replica->csnpl = csnplNew();
 
     dl_add(ruv->elements, replica);
+    ruvIndexInsert(ruv, replica);
 
     return replica;
 }
@@ -1890,16 +2002,229 @@ ruvAddIndexReplicaNoCSN(RUV *ruv, ReplicaId rid, const char *replica_purl, int i
     replica->csnpl = csnplNew();
 
     dl_add_index(ruv->elements, replica, index);
+    ruvIndexInsert(ruv, replica);
 
     return replica;
 }
 
+/* Lookup a slot of the index, returns NULL if the replica id never was in the RUV */
+static RUVSlot *
+ruvIndexFind(RUVIndex *index, ReplicaId rid)
+{
+    size_t mask = index->size - 1;
+    uint32_t key = (uint32_t)rid + 1;
+
+    /* the table is never full, there is always a free slot ending the probe */
+    for (size_t i = rid & mask;; i = (i + 1) & mask) {
+        uint32_t slot_key = __atomic_load_n(&index->slots[i].key, __ATOMIC_ACQUIRE);
+        if (slot_key == key) {
+            return &index->slots[i];
+        }
+        if (slot_key == 0) {
+            return NULL;
+        }
+    }
+}
+
+static RUVIndex *
+ruvIndexNew(size_t count)
+{
+    RUVIndex *index;
+    size_t size = RUV_INDEX_MIN_SIZE;
+
+    /* keep the load factor under 3/4 */
+    while (size * 3 <= count * 4) {
+        size <<= 1;
+    }
+    index = (RUVIndex *)slapi_ch_calloc(1, sizeof(RUVIndex) + size * sizeof(RUVSlot));
+    index->size = size;
+    return index;
+}
+
+static void
+ruvIndexFree(RUVIndex **index)
+{
+    while (*index) {
+        RUVIndex *retired = (*index)->retired;
+        slapi_ch_free((void **)index);
+        *index = retired;
+    }
+}
+
+/* Copy the element csns into its slot - RUV write lock must be held */
+static void
+ruvSlotPublish(RUVSlot *slot, const RUVElement *replica)
+{
+    uint64_t csn[RUV_CSN_WORDS] = {0};
+    uint64_t min_csn[RUV_CSN_WORDS] = {0};
+    uint32_t flags = 0;
+    uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+
+    if (replica) {
+        flags |= RUV_SLOT_PRESENT;
+        if (replica->csn) {
+            flags |= RUV_SLOT_HAS_CSN;
+            memcpy(csn, replica->csn, sizeof(CSN));
+        }
+        if (replica->min_csn) {
+            flags |= RUV_SLOT_HAS_MIN_CSN;
+            memcpy(min_csn, replica->min_csn, sizeof(CSN));
+        }
+    }
+    slot->replica = (RUVElement *)replica;
+
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&slot->flags, flags, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < RUV_CSN_WORDS; i++) {
+        __atomic_store_n(&slot->csn[i], csn[i], __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->min_csn[i], min_csn[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* Find or assign the slot of a replica id, growing the table if needed */
+static RUVSlot *
+ruvIndexGetSlot(RUV *ruv, ReplicaId rid)
+{
+    RUVIndex *index = ruv->index;
+    RUVSlot *slot = ruvIndexFind(index, rid);
+    size_t mask;
+    size_t i;
+
+    if (slot) {
+        return slot;
+    }
+    if ((index->used + 1) * 4 >= index->size * 3) {
+        /* copy the slots to a larger table, readers may still walk the old one */
+        RUVIndex *bigger = ruvIndexNew(index->size);
+
+        for (i = 0; i < index->size; i++) {
+            RUVSlot *old = &index->slots[i];
+            if (old->key) {
+                size_t j = (old->key - 1) & (bigger->size - 1);
+                while (bigger->slots[j].key) {
+                    j = (j + 1) & (bigger->size - 1);
+                }
+                bigger->slots[j] = *old;
+                bigger->slots[j].seq = 0;
+                bigger->used++;
+            }
+        }
+        bigger->retired = index;
+        __atomic_store_n(&ruv->index, bigger, __ATOMIC_RELEASE);
+        index = bigger;
+    }
+    mask = index->size - 1;
+    for (i = rid & mask; index->slots[i].key; i = (i + 1) & mask)
+        ;
+    slot = &index->slots[i];
+    index->used++;
+    /* the slot content must be visible before its key */
+    __atomic_store_n(&slot->key, (uint32_t)rid + 1, __ATOMIC_RELEASE);
+    return slot;
+}
+
+/* A new element was added to the RUV */
+static void
+ruvIndexInsert(RUV *ruv, RUVElement *replica)
+{
+    RUVSlot *slot = ruvIndexGetSlot(ruv, replica->rid);
+
+    /* in case of duplicates the first element of the list is the one looked up */
+    if (slot->replica == NULL) {
+        ruvSlotPublish(slot, replica);
+    }
+}
+
+/* The csns of an element were updated */
+static void
+ruvIndexPublish(RUV *ruv, const RUVElement *replica)
+{
+    RUVSlot *slot = ruvIndexFind(ruv->index, replica->rid);
+
+    if (slot && slot->replica == replica) {
+        ruvSlotPublish(slot, replica);
+    }
+}
+
+/* An element of the RUV was removed */
+static void
+ruvIndexRefresh(RUV *ruv, ReplicaId rid)
+{
+    RUVSlot *slot = ruvIndexFind(ruv->index, rid);
+
+    if (slot) {
+        ruvSlotPublish(slot, (RUVElement *)dl_get(ruv->elements, (const void *)&rid, ruvReplicaCompare));
+    }
+}
+
+/* The elements of the RUV were replaced */
+static void
+ruvIndexRebuild(RUV *ruv)
+{
+    RUVIndex *index = ruv->index;
+    RUVElement *replica;
+    int cookie;
+
+    for (size_t i = 0; i < index->size; i++) {
+        index->slots[i].replica = NULL;
+    }
+    for (replica = dl_get_first(ruv->elements, &cookie); replica;
+         replica = dl_get_next(ruv->elements, &cookie)) {
+        ruvIndexInsert(ruv, replica);
+    }
+    /* the index may have grown */
+    index = ruv->index;
+    for (size_t i = 0; i < index->size; i++) {
+        if (index->slots[i].key && index->slots[i].replica == NULL) {
+            ruvSlotPublish(&index->slots[i], NULL);
+        }
+    }
+}
+
+/*
+ * Lock free read of the csns of a replica.
+ * Returns PR_FALSE if the replica is not in the RUV.
+ */
+static PRBool
+ruvSnapshotGet(const RUV *ruv, ReplicaId rid, RUVSnapshot *snap)
+{
+    RUVIndex *index = __atomic_load_n(&ruv->index, __ATOMIC_ACQUIRE);
+    RUVSlot *slot = ruvIndexFind(index, rid);
+    uint64_t csn[RUV_CSN_WORDS];
+    uint64_t min_csn[RUV_CSN_WORDS];
+    uint64_t seq;
+
+    if (slot == NULL) {
+        return PR_FALSE;
+    }
+    do {
+        while ((seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE)) & 1) {
+            /* a writer is updating the slot */
+        }
+        snap->flags = __atomic_load_n(&slot->flags, __ATOMIC_RELAXED);
+        for (size_t i = 0; i < RUV_CSN_WORDS; i++) {
+            csn[i] = __atomic_load_n(&slot->csn[i], __ATOMIC_RELAXED);
+            min_csn[i] = __atomic_load_n(&slot->min_csn[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq);
+
+    memcpy(&snap->csn, csn, sizeof(CSN));
+    memcpy(&snap->min_csn, min_csn, sizeof(CSN));
+    return (snap->flags & RUV_SLOT_PRESENT) ? PR_TRUE : PR_FALSE;
+}
+
 static RUVElement *
 ruvGetReplica(const RUV *ruv, ReplicaId rid)
 {
+    RUVSlot *slot;
+
     PR_ASSERT(ruv /* && rid >= 0 -- rid can't be negative */);
 
-    return (RUVElement *)dl_get(ruv->elements, (const void *)&rid, ruvReplicaCompare);
+    slot = ruvIndexFind(ruv->index, rid);
+    return slot ? slot->replica : NULL;
 }
 
 static int
@@ -2291,6 +2616,7 @@ ruv_insert_dummy_min_csn(RUV *ruv)
             csn_init(dummycsn);
             csn_set_replicaid(dummycsn, csn_get_replicaid(r->csn));
             r->min_csn = dummycsn;
+            ruvIndexPublish(ruv, r);
         }
     }
 }
@@ -112,6 +112,7 @@ const char *type_nsds5ReplicaEnabled = "nsds5ReplicaEnabled";
 const char *type_nsds5ReplicaStripAttrs = "nsds5ReplicaStripAttrs";
 const char *type_nsds5ReplicaFlowControlWindow = "nsds5ReplicaFlowControlWindow";
 const char *type_nsds5ReplicaFlowControlPause = "nsds5ReplicaFlowControlPause";
+const char *type_nsds5ReplicaFlowControlAdaptive = "nsds5ReplicaFlowControlAdaptive";
 const char *type_nsds5WaitForAsyncResults = "nsds5ReplicaWaitForAsyncResults";
 const char *type_replicaIgnoreMissingChange = "nsds5ReplicaIgnoreMissingChange";
 const char *type_nsds5ReplicaBootstrapBindDN = "nsds5ReplicaBootstrapBindDN";
@@ -55,6 +55,7 @@ static char **retrocl_exclude_attrs = NULL;
 static Slapi_PluginDesc retrocldesc = {"retrocl", VENDOR, DS_PACKAGE_VERSION, "Retrocl Plugin"};
 static Slapi_PluginDesc retroclpostopdesc = {"retrocl-postop", VENDOR, DS_PACKAGE_VERSION, "retrocl post-operation plugin"};
 static Slapi_PluginDesc retroclinternalpostopdesc = {"retrocl-internalpostop", VENDOR, DS_PACKAGE_VERSION, "retrocl internal post-operation plugin"};
+static Slapi_PluginDesc retroclpreopdesc = {"retrocl-preop", VENDOR, DS_PACKAGE_VERSION, "retrocl pre-operation plugin"};
 static int legacy_initialised = 0;
 
 /*
@@ -163,6 +164,33 @@ retrocl_internalpostop_init(Slapi_PBlock *pb)
     return rc;
 }
 
+/*
+ * Function: retrocl_preop_init
+ *
+ * Returns: 0/-1
+ *
+ * Arguments: Pb
+ *
+ * Description: callback function, serves the searches of the compact
+ * changelog
+ *
+ */
+
+int
+retrocl_preop_init(Slapi_PBlock *pb)
+{
+    int rc = 0; /* OK */
+
+    if (slapi_pblock_set(pb, SLAPI_PLUGIN_VERSION, SLAPI_PLUGIN_VERSION_01) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_DESCRIPTION, (void *)&retroclpreopdesc) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_PRE_SEARCH_FN, (void *)retrocl_compact_search) != 0) {
+        slapi_log_err(SLAPI_LOG_PLUGIN, RETROCL_PLUGIN_NAME, "retrocl_preop_init failed\n");
+        rc = -1;
+    }
+
+    return rc;
+}
+
 /*
  * Function: retrocl_rootdse_init
  *
@@ -241,6 +269,12 @@ retrocl_select_backend(void)
     if (be)
         slapi_be_Unlock(be);
 
+    if (retrocl_compact_enabled() && retrocl_compact_open() != 0) {
+        slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                      "retrocl_select_backend - Failed to open the compact changelog.\n");
+        return -1;
+    }
+
     return retrocl_get_changenumbers();
 }
 
@@ -635,6 +669,7 @@ retrocl_stop(Slapi_PBlock *pb __attribute__((unused)))
     slapi_ch_free((void **)&retrocl_includes);
 
     retrocl_stop_trimming();
+    retrocl_compact_close();
     retrocl_be_changelog = NULL;
     retrocl_forget_changenumbers();
     PR_DestroyLock(retrocl_internal_lock);
@@ -680,6 +715,12 @@ retrocl_plugin_init(Slapi_PBlock *pb)
         plugin_entry) {
         is_betxn = slapi_entry_attr_get_bool(plugin_entry, "nsslapd-pluginbetxn");
     }
+    retrocl_compact_configure(plugin_entry);
+    if (retrocl_compact_enabled()) {
+        /* The compact store is not transactional, changes are logged
+         * once the operation is done */
+        is_betxn = 0;
+    }
 
     if (!legacy_initialised) {
         (void) slapi_pblock_set(pb, SLAPI_PLUGIN_VERSION, SLAPI_PLUGIN_VERSION_01);
@@ -694,6 +735,9 @@ retrocl_plugin_init(Slapi_PBlock *pb)
         if (!is_betxn) {
             rc = slapi_register_plugin_ext("internalpostoperation", 1 /* Enabled */, "retrocl_internalpostop_init", retrocl_internalpostop_init, "Retrocl internal postoperation plugin", NULL, identity, precedence);
         }
+        if (retrocl_compact_enabled()) {
+            rc = slapi_register_plugin_ext("preoperation", 1 /* Enabled */, "retrocl_preop_init", retrocl_preop_init, "Retrocl preoperation plugin", NULL, identity, precedence);
+        }
         retrocl_cn_lock = slapi_new_rwlock();
         if (retrocl_cn_lock == NULL)
             return -1;
@@ -55,6 +55,21 @@ typedef struct _cnumRet
 
 #define CONFIG_CHANGELOG_TRIM_INTERVAL "nsslapd-changelog-trim-interval"
 
+/*
+ * Storage of the change records: "entry" adds them to the changelog backend,
+ * "compact" appends them to the compact store (retrocl_compact.c).
+ */
+#define CONFIG_CHANGELOG_STORAGE "nsslapd-changelog-storage"
+#define RETROCL_STORAGE_ENTRY    "entry"
+#define RETROCL_STORAGE_COMPACT  "compact"
+
+/*
+ * How often the compact store is flushed to disk, 0 flushes every change.
+ */
+#define DEFAULT_CHANGELOG_COMPACT_SYNC_INTERVAL 1000 /* in milliseconds */
+
+#define CONFIG_CHANGELOG_COMPACT_SYNC_INTERVAL "nsslapd-changelog-compact-sync-interval"
+
 #if defined(__hpux) && defined(__ia64)
 #define RETROCL_DLL_DEFAULT_THREAD_STACKSIZE 524288L
 #else
@@ -144,6 +159,16 @@ extern void retrocl_init_trimming(void);
 extern void retrocl_stop_trimming(void);
 extern char *retrocl_get_config_str(const char *attrt);
 
+extern void retrocl_compact_configure(Slapi_Entry *plugin_entry);
+extern int retrocl_compact_enabled(void);
+extern int retrocl_compact_open(void);
+extern void retrocl_compact_close(void);
+extern int retrocl_compact_append(Slapi_Entry *e, changeNumber cn, time_t changetime);
+extern void retrocl_compact_get_bounds(changeNumber *first, changeNumber *last, time_t *first_time, time_t *last_time);
+extern int retrocl_compact_trimmable(time_t cutoff);
+extern int retrocl_compact_trim(time_t cutoff, changeNumber *first);
+extern int retrocl_compact_search(Slapi_PBlock *pb);
+
 int retrocl_entry_in_scope(Slapi_Entry *e);
 int retrocl_attr_in_exclude_attrs(char *attr, int attrlen);
 
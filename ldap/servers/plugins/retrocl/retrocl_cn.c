@@ -133,6 +133,31 @@ retrocl_get_changenumbers(void)
     cr.cr_cnum = 0;
     cr.cr_time = 0;
 
+    if (retrocl_compact_enabled()) {
+        changeNumber first, last;
+
+        retrocl_compact_get_bounds(&first, &last, NULL, NULL);
+        if (last == 0UL) {
+            /* Empty store: carry on after the changes logged in the
+             * backend before the switch to the compact storage */
+            slapi_seq_callback(RETROCL_CHANGELOG_DN, SLAPI_SEQ_LAST,
+                               (char *)retrocl_changenumber, /* cast away const */
+                               NULL, NULL, 0, &cr, NULL, handle_cnum_result,
+                               handle_cnum_entry, NULL);
+            last = cr.cr_cnum;
+            slapi_ch_free((void **)&cr.cr_time);
+        }
+
+        slapi_rwlock_wrlock(retrocl_cn_lock);
+        retrocl_first_cn = first;
+        retrocl_internal_cn = last;
+        slapi_log_err(SLAPI_LOG_PLUGIN, "retrocl", "Got changenumbers %lu and %lu\n",
+                      retrocl_first_cn,
+                      retrocl_internal_cn);
+        slapi_rwlock_unlock(retrocl_cn_lock);
+        return 0;
+    }
+
     slapi_seq_callback(RETROCL_CHANGELOG_DN, SLAPI_SEQ_FIRST,
                        (char *)retrocl_changenumber, /* cast away const */
                        NULL, NULL, 0, &cr, NULL, handle_cnum_result,
@@ -184,6 +209,16 @@ retrocl_getchangetime(int type, int *err)
         }
         return NO_TIME;
     }
+    if (retrocl_compact_enabled()) {
+        time_t first_time, last_time;
+
+        retrocl_compact_get_bounds(NULL, NULL, &first_time, &last_time);
+        if (err != NULL) {
+            *err = LDAP_SUCCESS;
+        }
+        ret = (type == SLAPI_SEQ_FIRST) ? first_time : last_time;
+        return ret ? ret : NO_TIME;
+    }
     slapi_seq_callback(RETROCL_CHANGELOG_DN, type,
                        (char *)retrocl_changenumber, /* cast away const */
                        NULL,
@@ -349,6 +384,16 @@ retrocl_update_lastchangenumber(void)
     if (retrocl_be_changelog == NULL)
         return -1;
 
+    if (retrocl_compact_enabled()) {
+        changeNumber last;
+
+        retrocl_compact_get_bounds(NULL, &last, NULL, NULL);
+        if (last != 0UL) {
+            retrocl_internal_cn = last;
+        }
+        return 0;
+    }
+
     slapi_rwlock_unlock(retrocl_cn_lock);
     cr.cr_cnum = 0;
     cr.cr_time = 0;
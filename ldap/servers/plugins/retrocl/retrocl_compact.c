@@ -0,0 +1,1399 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/*
+ * Compact storage of the retro changelog.
+ *
+ * With nsslapd-changelog-storage: compact the change records are not added
+ * as entries to the changelog ldbm backend.  They are appended to a set of
+ * segment files, and the changeNumber=N,cn=changelog entries are rebuilt from
+ * those records when cn=changelog is searched.  The cn=changelog container
+ * itself, with its aci, stays in the changelog backend.
+ *
+ * A segment is named after the first change number it holds and is a
+ * sequence of records:
+ *
+ *     uint32 magic | uint32 len | payload (len bytes) | uint32 len
+ *
+ *     payload: uint64 changenumber, int64 changetime, uint32 flags,
+ *              uint32 nattrs, then for each attribute
+ *              uint16 typelen, type, uint32 nvals, { uint32 len, value }*
+ *
+ * objectclass, changenumber and changetime are not stored, they are rebuilt
+ * from the header.  The trailing length lets the startup scan detect a torn
+ * record at the end of a segment, which is cut off.
+ *
+ * Records are gathered in a write buffer and written in batches.  The buffer
+ * is written out when it is full, before a search reads the segments, and by
+ * a periodic sync event that also flushes the segment to disk.  Trimming
+ * removes whole segments, so a segment is rolled when it grows over
+ * RETROCL_COMPACT_SEGMENT_SIZE or gets older than RETROCL_COMPACT_SEGMENT_AGE.
+ */
+
+#include "retrocl.h"
+#include "retrocl_api.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RETROCL_COMPACT_MAGIC        0x52434c31 /* "RCL1" */
+#define RETROCL_COMPACT_PREFIX       "changes."
+#define RETROCL_COMPACT_SUFFIX       ".rcl"
+#define RETROCL_COMPACT_SUBDIR       "compact"
+#define RETROCL_COMPACT_HDR_SIZE     8
+#define RETROCL_COMPACT_TRAILER_SIZE 4
+#define RETROCL_COMPACT_PAYLOAD_MIN  24
+#define RETROCL_COMPACT_MAX_RECORD   (256 * 1024 * 1024)
+#define RETROCL_COMPACT_WBUF_SIZE    (256 * 1024)
+#define RETROCL_COMPACT_READ_SIZE    (64 * 1024)
+#define RETROCL_COMPACT_SEGMENT_SIZE (16 * 1024 * 1024)
+#define RETROCL_COMPACT_SEGMENT_AGE  3600 /* in seconds */
+#define RETROCL_COMPACT_INDEX_STEP   64   /* records between two seek points */
+
+/* flags of a record */
+#define RETROCL_COMPACT_EXTENSIBLE 0x1
+
+typedef struct _compact_seek_point
+{
+    changeNumber sp_cn;
+    uint64_t sp_offset;
+} compact_seek_point;
+
+typedef struct _compact_segment
+{
+    char *rs_path;
+    int rs_fd;
+    changeNumber rs_first_cn;
+    changeNumber rs_last_cn;
+    time_t rs_first_time;
+    time_t rs_last_time;
+    uint64_t rs_size;           /* bytes appended, buffered ones included */
+    uint64_t rs_written;        /* bytes written to the file */
+    uint64_t rs_nrecords;
+    compact_seek_point *rs_index; /* sparse changenumber -> offset index */
+    size_t rs_nindex;
+    size_t rs_maxindex;
+    int rs_refcnt;  /* the store list and the readers, protected by cs_lock */
+    int rs_removed; /* trimmed, the file goes with the last reference */
+    struct _compact_segment *rs_next;
+} compact_segment;
+
+typedef struct _compact_buf
+{
+    char *cb_data;
+    size_t cb_len;
+    size_t cb_size;
+} compact_buf;
+
+typedef struct _compact_reader
+{
+    int rd_fd;
+    uint64_t rd_offset; /* file offset of rd_buf */
+    compact_buf rd_buf;
+} compact_reader;
+
+static struct
+{
+    PRLock *cs_lock;
+    char *cs_dir;
+    compact_segment *cs_head;
+    compact_segment *cs_tail;
+    compact_buf cs_wbuf;  /* records not yet written to cs_tail */
+    int cs_dirty;         /* written to cs_tail but not synced */
+    int cs_sync_interval; /* in milliseconds, 0 syncs every change */
+    Slapi_Eq_Context cs_sync_ctx;
+    int cs_open;
+} cs = {0};
+
+static int retrocl_compact = 0;
+
+/*
+ * Function: retrocl_compact_configure
+ *
+ * Arguments: the plugin config entry
+ *
+ * Description: reads the storage mode.  It is read once when the plugin is
+ * initialised, changing it needs a restart.
+ */
+void
+retrocl_compact_configure(Slapi_Entry *plugin_entry)
+{
+    const char *storage = NULL;
+
+    retrocl_compact = 0;
+    if (plugin_entry) {
+        storage = slapi_entry_attr_get_ref(plugin_entry, CONFIG_CHANGELOG_STORAGE);
+    }
+    if (storage && strcasecmp(storage, RETROCL_STORAGE_COMPACT) == 0) {
+        retrocl_compact = 1;
+    } else if (storage && strcasecmp(storage, RETROCL_STORAGE_ENTRY)) {
+        slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                      "retrocl_compact_configure - Invalid value (%s) for %s, using \"%s\"\n",
+                      storage, CONFIG_CHANGELOG_STORAGE, RETROCL_STORAGE_ENTRY);
+    }
+}
+
+int
+retrocl_compact_enabled(void)
+{
+    return retrocl_compact;
+}
+
+/* ----------------------------- buffers */
+
+static void
+compact_buf_reserve(compact_buf *b, size_t len)
+{
+    if (b->cb_len + len > b->cb_size) {
+        size_t size = b->cb_size ? b->cb_size : 1024;
+
+        while (size < b->cb_len + len) {
+            size *= 2;
+        }
+        b->cb_data = slapi_ch_realloc(b->cb_data, size);
+        b->cb_size = size;
+    }
+}
+
+static void
+compact_buf_put(compact_buf *b, const void *data, size_t len)
+{
+    compact_buf_reserve(b, len);
+    memcpy(b->cb_data + b->cb_len, data, len);
+    b->cb_len += len;
+}
+
+static void
+compact_buf_done(compact_buf *b)
+{
+    slapi_ch_free((void **)&b->cb_data);
+    b->cb_len = b->cb_size = 0;
+}
+
+/* ----------------------------- encoding */
+
+static int
+compact_skip_attr(const char *type)
+{
+    return strcasecmp(type, retrocl_objectclass) == 0 ||
+           strcasecmp(type, retrocl_changenumber) == 0 ||
+           strcasecmp(type, retrocl_changetime) == 0;
+}
+
+/*
+ * Encode the change record entry built by write_replog_db.  Returns 0, or -1
+ * if an attribute does not fit the record format.
+ */
+static int
+compact_encode(compact_buf *b, Slapi_Entry *e, changeNumber cn, time_t changetime)
+{
+    Slapi_Attr *attr = NULL;
+    Slapi_Value *extensible;
+    uint32_t magic = RETROCL_COMPACT_MAGIC;
+    uint32_t len = 0;
+    uint64_t cn64 = cn;
+    int64_t time64 = changetime;
+    uint32_t flags = 0;
+    uint32_t nattrs = 0;
+    size_t start;
+    size_t nattrs_at;
+
+    extensible = slapi_value_new_string("extensibleObject");
+    if (slapi_entry_attr_has_syntax_value(e, retrocl_objectclass, extensible)) {
+        flags |= RETROCL_COMPACT_EXTENSIBLE;
+    }
+    slapi_value_free(&extensible);
+
+    start = b->cb_len;
+    compact_buf_put(b, &magic, sizeof(magic));
+    compact_buf_put(b, &len, sizeof(len)); /* set below */
+    compact_buf_put(b, &cn64, sizeof(cn64));
+    compact_buf_put(b, &time64, sizeof(time64));
+    compact_buf_put(b, &flags, sizeof(flags));
+    nattrs_at = b->cb_len;
+    compact_buf_put(b, &nattrs, sizeof(nattrs)); /* set below */
+
+    for (slapi_entry_first_attr(e, &attr); attr; slapi_entry_next_attr(e, attr, &attr)) {
+        Slapi_Value *sval = NULL;
+        const char *type = NULL;
+        uint16_t typelen;
+        uint32_t nvals = 0;
+        size_t nvals_at;
+        int i;
+
+        slapi_attr_get_type(attr, (char **)&type);
+        if (compact_skip_attr(type)) {
+            continue;
+        }
+        if (strlen(type) > UINT16_MAX) {
+            return -1;
+        }
+        typelen = strlen(type);
+        compact_buf_put(b, &typelen, sizeof(typelen));
+        compact_buf_put(b, type, typelen);
+        nvals_at = b->cb_len;
+        compact_buf_put(b, &nvals, sizeof(nvals));
+        for (i = slapi_attr_first_value(attr, &sval); i != -1; i = slapi_attr_next_value(attr, i, &sval)) {
+            const struct berval *bv = slapi_value_get_berval(sval);
+            uint32_t vlen = bv->bv_len;
+
+            compact_buf_put(b, &vlen, sizeof(vlen));
+            compact_buf_put(b, bv->bv_val, vlen);
+            nvals++;
+        }
+        memcpy(b->cb_data + nvals_at, &nvals, sizeof(nvals));
+        nattrs++;
+    }
+    memcpy(b->cb_data + nattrs_at, &nattrs, sizeof(nattrs));
+
+    if (b->cb_len - start - RETROCL_COMPACT_HDR_SIZE > RETROCL_COMPACT_MAX_RECORD) {
+        return -1;
+    }
+    len = b->cb_len - start - RETROCL_COMPACT_HDR_SIZE;
+    memcpy(b->cb_data + start + sizeof(magic), &len, sizeof(len));
+    compact_buf_put(b, &len, sizeof(len));
+    return 0;
+}
+
+/* Read the change number and time of a payload */
+static void
+compact_payload_header(const char *p, changeNumber *cn, time_t *changetime)
+{
+    uint64_t cn64;
+    int64_t time64;
+
+    memcpy(&cn64, p, sizeof(cn64));
+    memcpy(&time64, p + sizeof(cn64), sizeof(time64));
+    *cn = (changeNumber)cn64;
+    *changetime = (time_t)time64;
+}
+
+/*
+ * Rebuild the changeNumber=N,cn=changelog entry of a payload.  Returns NULL
+ * if the payload is malformed.
+ */
+static Slapi_Entry *
+compact_decode(const char *p, uint32_t len)
+{
+    const char *end = p + len;
+    struct berval *vals[2];
+    struct berval val;
+    Slapi_Entry *e;
+    changeNumber cn;
+    time_t changetime;
+    uint32_t flags;
+    uint32_t nattrs;
+    char chnobuf[CNUMSTR_LEN] = {0};
+    uint32_t a;
+
+    compact_payload_header(p, &cn, &changetime);
+    memcpy(&flags, p + 16, sizeof(flags));
+    memcpy(&nattrs, p + 20, sizeof(nattrs));
+    p += RETROCL_COMPACT_PAYLOAD_MIN;
+
+    vals[0] = &val;
+    vals[1] = NULL;
+
+    e = slapi_entry_alloc();
+    slapi_entry_set_dn(e, slapi_ch_smprintf("%s=%lu,%s", retrocl_changenumber, cn, RETROCL_CHANGELOG_DN));
+
+    val.bv_val = "top";
+    val.bv_len = 3;
+    slapi_entry_add_values(e, retrocl_objectclass, vals);
+    val.bv_val = "changelogentry";
+    val.bv_len = 14;
+    slapi_entry_add_values(e, retrocl_objectclass, vals);
+    if (flags & RETROCL_COMPACT_EXTENSIBLE) {
+        val.bv_val = "extensibleObject";
+        val.bv_len = 16;
+        slapi_entry_add_values(e, retrocl_objectclass, vals);
+    }
+
+    sprintf(chnobuf, "%lu", cn);
+    val.bv_val = chnobuf;
+    val.bv_len = strlen(chnobuf);
+    slapi_entry_add_values(e, retrocl_changenumber, vals);
+
+    val.bv_val = format_genTime(changetime);
+    val.bv_len = strlen(val.bv_val);
+    slapi_entry_add_values(e, retrocl_changetime, vals);
+    slapi_ch_free((void **)&val.bv_val);
+
+    for (a = 0; a < nattrs; a++) {
+        struct berval **bvals;
+        struct berval *bvs;
+        char *type;
+        uint16_t typelen;
+        uint32_t nvals;
+        uint32_t v;
+
+        if (end - p < (ptrdiff_t)sizeof(typelen)) {
+            goto bad;
+        }
+        memcpy(&typelen, p, sizeof(typelen));
+        p += sizeof(typelen);
+        if (end - p < (ptrdiff_t)typelen + (ptrdiff_t)sizeof(nvals)) {
+            goto bad;
+        }
+        type = slapi_ch_malloc(typelen + 1);
+        memcpy(type, p, typelen);
+        type[typelen] = '\0';
+        p += typelen;
+        memcpy(&nvals, p, sizeof(nvals));
+        p += sizeof(nvals);
+        if (nvals > (uint32_t)(end - p) / sizeof(uint32_t)) {
+            slapi_ch_free_string(&type);
+            goto bad;
+        }
+
+        bvals = (struct berval **)slapi_ch_calloc(nvals + 1, sizeof(struct berval *));
+        bvs = (struct berval *)slapi_ch_calloc(nvals + 1, sizeof(struct berval));
+        for (v = 0; v < nvals; v++) {
+            uint32_t vlen;
+
+            if (end - p < (ptrdiff_t)sizeof(vlen)) {
+                break;
+            }
+            memcpy(&vlen, p, sizeof(vlen));
+            p += sizeof(vlen);
+            if ((uint32_t)(end - p) < vlen) {
+                break;
+            }
+            bvs[v].bv_val = (char *)p;
+            bvs[v].bv_len = vlen;
+            bvals[v] = &bvs[v];
+            p += vlen;
+        }
+        if (v == nvals) {
+            slapi_entry_add_values(e, type, bvals);
+        }
+        slapi_ch_free((void **)&bvals);
+        slapi_ch_free((void **)&bvs);
+        slapi_ch_free_string(&type);
+        if (v != nvals) {
+            goto bad;
+        }
+    }
+    return e;
+
+bad:
+    slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                  "compact_decode - Malformed change record %lu\n", cn);
+    slapi_entry_free(e);
+    return NULL;
+}
+
+/* ----------------------------- segments */
+
+static void
+compact_segment_free(compact_segment *seg)
+{
+    if (seg->rs_fd >= 0) {
+        close(seg->rs_fd);
+    }
+    if (seg->rs_removed) {
+        if (unlink(seg->rs_path) != 0) {
+            slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                          "compact_segment_free - Failed to remove %s (%d)\n", seg->rs_path, errno);
+        }
+    }
+    slapi_ch_free_string(&seg->rs_path);
+    slapi_ch_free((void **)&seg->rs_index);
+    slapi_ch_free((void **)&seg);
+}
+
+/* cs_lock must be held */
+static void
+compact_segment_release(compact_segment *seg)
+{
+    if (--seg->rs_refcnt == 0) {
+        compact_segment_free(seg);
+    }
+}
+
+static void
+compact_segment_account(compact_segment *seg, changeNumber cn, time_t changetime, uint64_t offset, uint64_t reclen)
+{
+    if (seg->rs_nrecords % RETROCL_COMPACT_INDEX_STEP == 0) {
+        if (seg->rs_nindex == seg->rs_maxindex) {
+            seg->rs_maxindex = seg->rs_maxindex ? seg->rs_maxindex * 2 : 16;
+            seg->rs_index = (compact_seek_point *)slapi_ch_realloc((char *)seg->rs_index,
+                                                                   seg->rs_maxindex * sizeof(compact_seek_point));
+        }
+        seg->rs_index[seg->rs_nindex].sp_cn = cn;
+        seg->rs_index[seg->rs_nindex].sp_offset = offset;
+        seg->rs_nindex++;
+    }
+    if (seg->rs_nrecords == 0) {
+        seg->rs_first_cn = cn;
+        seg->rs_first_time = changetime;
+    }
+    seg->rs_last_cn = cn;
+    seg->rs_last_time = changetime;
+    seg->rs_size = offset + reclen;
+    seg->rs_nrecords++;
+}
+
+/* Offset of the last seek point at or before cn */
+static uint64_t
+compact_segment_seek(compact_segment *seg, changeNumber cn)
+{
+    size_t lo = 0;
+    size_t hi = seg->rs_nindex;
+
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+
+        if (seg->rs_index[mid].sp_cn <= cn) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return seg->rs_nindex ? seg->rs_index[lo].sp_offset : 0;
+}
+
+/*
+ * Make [offset, offset + len) of the file available in the reader buffer.
+ * Returns NULL if the range goes past limit or cannot be read.
+ */
+static const char *
+compact_reader_get(compact_reader *rd, uint64_t offset, size_t len, uint64_t limit)
+{
+    size_t want;
+    size_t got = 0;
+
+    if (offset + len > limit) {
+        return NULL;
+    }
+    if (offset >= rd->rd_offset && offset + len <= rd->rd_offset + rd->rd_buf.cb_len) {
+        return rd->rd_buf.cb_data + (offset - rd->rd_offset);
+    }
+
+    want = len > RETROCL_COMPACT_READ_SIZE ? len : RETROCL_COMPACT_READ_SIZE;
+    if (offset + want > limit) {
+        want = limit - offset;
+    }
+    rd->rd_buf.cb_len = 0;
+    compact_buf_reserve(&rd->rd_buf, want);
+    while (got < want) {
+        ssize_t rc = pread(rd->rd_fd, rd->rd_buf.cb_data + got, want - got, offset + got);
+
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            break;
+        }
+        got += rc;
+    }
+    rd->rd_offset = offset;
+    rd->rd_buf.cb_len = got;
+    return got >= len ? rd->rd_buf.cb_data : NULL;
+}
+
+/*
+ * Read the record at offset.  Returns its payload and sets *len, or NULL at
+ * the end of the segment or on a torn or corrupted record.
+ */
+static const char *
+compact_reader_next(compact_reader *rd, uint64_t offset, uint64_t limit, uint32_t *len)
+{
+    const char *p;
+    uint32_t magic;
+    uint32_t trailer;
+
+    if ((p = compact_reader_get(rd, offset, RETROCL_COMPACT_HDR_SIZE, limit)) == NULL) {
+        return NULL;
+    }
+    memcpy(&magic, p, sizeof(magic));
+    memcpy(len, p + sizeof(magic), sizeof(*len));
+    if (magic != RETROCL_COMPACT_MAGIC ||
+        *len < RETROCL_COMPACT_PAYLOAD_MIN || *len > RETROCL_COMPACT_MAX_RECORD) {
+        return NULL;
+    }
+    p = compact_reader_get(rd, offset, RETROCL_COMPACT_HDR_SIZE + *len + RETROCL_COMPACT_TRAILER_SIZE, limit);
+    if (p == NULL) {
+        return NULL;
+    }
+    memcpy(&trailer, p + RETROCL_COMPACT_HDR_SIZE + *len, sizeof(trailer));
+    if (trailer != *len) {
+        return NULL;
+    }
+    return p + RETROCL_COMPACT_HDR_SIZE;
+}
+
+/*
+ * Build the index of an existing segment and cut off a torn record at its
+ * end.  Returns -1 if the segment cannot be used, which includes change
+ * numbers out of order: that is corruption, not a torn write, and the
+ * records after it are kept on disk for inspection.
+ */
+static int
+compact_segment_scan(compact_segment *seg, changeNumber prev_cn)
+{
+    compact_reader rd = {0};
+    struct stat st;
+    uint64_t offset = 0;
+
+    if (fstat(seg->rs_fd, &st) != 0) {
+        return -1;
+    }
+    rd.rd_fd = seg->rs_fd;
+    while (offset < (uint64_t)st.st_size) {
+        const char *p;
+        changeNumber cn;
+        time_t changetime;
+        uint32_t len;
+
+        p = compact_reader_next(&rd, offset, st.st_size, &len);
+        if (p == NULL) {
+            break;
+        }
+        compact_payload_header(p, &cn, &changetime);
+        if (cn <= prev_cn) {
+            slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                          "compact_segment_scan - Change number %lu at offset %" PRIu64 " of %s "
+                          "does not follow change number %lu, the segment is corrupted\n",
+                          cn, offset, seg->rs_path, prev_cn);
+            compact_buf_done(&rd.rd_buf);
+            return -1;
+        }
+        compact_segment_account(seg, cn, changetime, offset,
+                                RETROCL_COMPACT_HDR_SIZE + len + RETROCL_COMPACT_TRAILER_SIZE);
+        offset = seg->rs_size;
+        prev_cn = cn;
+    }
+    compact_buf_done(&rd.rd_buf);
+
+    if (offset < (uint64_t)st.st_size) {
+        slapi_log_err(SLAPI_LOG_WARNING, RETROCL_PLUGIN_NAME,
+                      "compact_segment_scan - Truncating %s from %" PRIu64 " to %" PRIu64 " bytes after an incomplete change record\n",
+                      seg->rs_path, (uint64_t)st.st_size, offset);
+        if (ftruncate(seg->rs_fd, offset) != 0) {
+            return -1;
+        }
+    }
+    seg->rs_size = seg->rs_written = offset;
+    return 0;
+}
+
+static compact_segment *
+compact_segment_open(const char *name, int create)
+{
+    compact_segment *seg = (compact_segment *)slapi_ch_calloc(1, sizeof(compact_segment));
+
+    seg->rs_path = slapi_ch_smprintf("%s/%s", cs.cs_dir, name);
+    seg->rs_fd = open(seg->rs_path, O_RDWR | O_APPEND | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0600);
+    if (seg->rs_fd < 0) {
+        slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                      "compact_segment_open - Failed to open %s (%d)\n", seg->rs_path, errno);
+        compact_segment_free(seg);
+        return NULL;
+    }
+    seg->rs_refcnt = 1;
+    return seg;
+}
+
+static int
+compact_sync_dir(void)
+{
+    int fd = open(cs.cs_dir, O_RDONLY | O_CLOEXEC);
+    int rc;
+
+    if (fd < 0) {
+        return -1;
+    }
+    rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+/* Write out the buffered records, cs_lock must be held */
+static int
+compact_flush(void)
+{
+    compact_segment *seg = cs.cs_tail;
+    size_t done = 0;
+    int rc = 0;
+
+    if (cs.cs_wbuf.cb_len == 0) {
+        return 0;
+    }
+    while (done < cs.cs_wbuf.cb_len) {
+        ssize_t n = write(seg->rs_fd, cs.cs_wbuf.cb_data + done, cs.cs_wbuf.cb_len - done);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                          "compact_flush - Failed to write %s (%d)\n", seg->rs_path, errno);
+            /* Drop a partial record, the buffer is written again later */
+            if (ftruncate(seg->rs_fd, seg->rs_written) != 0) {
+                slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                              "compact_flush - Failed to truncate %s (%d)\n", seg->rs_path, errno);
+            }
+            rc = -1;
+            break;
+        }
+        done += n;
+    }
+    if (rc == 0) {
+        seg->rs_written += cs.cs_wbuf.cb_len;
+        cs.cs_wbuf.cb_len = 0;
+        cs.cs_dirty = 1;
+    }
+    return rc;
+}
+
+/* Start the segment holding cn, cs_lock must be held */
+static int
+compact_roll(changeNumber cn)
+{
+    compact_segment *seg;
+    char name[64];
+
+    if (cs.cs_tail) {
+        if (compact_flush() != 0) {
+            return -1;
+        }
+        if (cs.cs_dirty) {
+            fdatasync(cs.cs_tail->rs_fd);
+            cs.cs_dirty = 0;
+        }
+    }
+    PR_snprintf(name, sizeof(name), RETROCL_COMPACT_PREFIX "%020lu" RETROCL_COMPACT_SUFFIX, cn);
+    if ((seg = compact_segment_open(name, 1)) == NULL) {
+        return -1;
+    }
+    compact_sync_dir();
+    if (cs.cs_tail) {
+        cs.cs_tail->rs_next = seg;
+    } else {
+        cs.cs_head = seg;
+    }
+    cs.cs_tail = seg;
+    slapi_log_err(SLAPI_LOG_PLUGIN, RETROCL_PLUGIN_NAME,
+                  "compact_roll - Started segment %s\n", seg->rs_path);
+    return 0;
+}
+
+/*
+ * Periodic event: write out the buffered records and flush the current
+ * segment to disk.  The sync runs without cs_lock so appends go on.
+ */
+static void
+compact_sync(time_t when __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    compact_segment *seg = NULL;
+
+    PR_Lock(cs.cs_lock);
+    if (cs.cs_open && cs.cs_tail) {
+        compact_flush();
+        if (cs.cs_dirty) {
+            seg = cs.cs_tail;
+            seg->rs_refcnt++;
+            cs.cs_dirty = 0;
+        }
+    }
+    PR_Unlock(cs.cs_lock);
+
+    if (seg) {
+        fdatasync(seg->rs_fd);
+        PR_Lock(cs.cs_lock);
+        compact_segment_release(seg);
+        PR_Unlock(cs.cs_lock);
+    }
+}
+
+static int
+compact_segment_cmp(const void *a, const void *b)
+{
+    const compact_segment *sa = *(const compact_segment **)a;
+    const compact_segment *sb = *(const compact_segment **)b;
+
+    return sa->rs_first_cn < sb->rs_first_cn ? -1 : sa->rs_first_cn > sb->rs_first_cn;
+}
+
+/* Open the segments found in the store directory, in change number order */
+static int
+compact_load(void)
+{
+    compact_segment **segs = NULL;
+    size_t nsegs = 0;
+    size_t maxsegs = 0;
+    changeNumber prev_cn = 0;
+    struct dirent *ent;
+    DIR *dir;
+    size_t i;
+    int rc = 0;
+
+    if ((dir = opendir(cs.cs_dir)) == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                      "compact_load - Failed to read %s (%d)\n", cs.cs_dir, errno);
+        return -1;
+    }
+    while ((ent = readdir(dir)) != NULL) {
+        size_t namelen = strlen(ent->d_name);
+        compact_segment *seg;
+        char *end = NULL;
+        changeNumber first;
+
+        if (strncmp(ent->d_name, RETROCL_COMPACT_PREFIX, strlen(RETROCL_COMPACT_PREFIX)) ||
+            namelen <= strlen(RETROCL_COMPACT_PREFIX) + strlen(RETROCL_COMPACT_SUFFIX)) {
+            continue;
+        }
+        first = strtoul(ent->d_name + strlen(RETROCL_COMPACT_PREFIX), &end, 10);
+        if (strcmp(end, RETROCL_COMPACT_SUFFIX)) {
+            continue;
+        }
+        if ((seg = compact_segment_open(ent->d_name, 0)) == NULL) {
+            rc = -1;
+            break;
+        }
+        seg->rs_first_cn = first; /* sort key until the scan */
+        if (nsegs == maxsegs) {
+            maxsegs = maxsegs ? maxsegs * 2 : 16;
+            segs = (compact_segment **)slapi_ch_realloc((char *)segs, maxsegs * sizeof(compact_segment *));
+        }
+        segs[nsegs++] = seg;
+    }
+    closedir(dir);
+
+    if (nsegs) {
+        qsort(segs, nsegs, sizeof(compact_segment *), compact_segment_cmp);
+    }
+    for (i = 0; i < nsegs; i++) {
+        compact_segment *seg = segs[i];
+
+        seg->rs_first_cn = 0;
+        if (rc || compact_segment_scan(seg, prev_cn) != 0) {
+            if (rc == 0) {
+                slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                              "compact_load - Failed to load %s (%d)\n", seg->rs_path, errno);
+            }
+            compact_segment_free(seg);
+            rc = -1;
+            continue;
+        }
+        if (seg->rs_nrecords == 0) {
+            /* rolled but never written, or a torn first record */
+            seg->rs_removed = 1;
+            compact_segment_free(seg);
+            continue;
+        }
+        prev_cn = seg->rs_last_cn;
+        if (cs.cs_tail) {
+            cs.cs_tail->rs_next = seg;
+        } else {
+            cs.cs_head = seg;
+        }
+        cs.cs_tail = seg;
+    }
+    slapi_ch_free((void **)&segs);
+    return rc;
+}
+
+static void
+compact_free_segments(void)
+{
+    while (cs.cs_head) {
+        compact_segment *seg = cs.cs_head;
+
+        cs.cs_head = seg->rs_next;
+        compact_segment_release(seg);
+    }
+    cs.cs_tail = NULL;
+}
+
+/* the compact store API, see retrocl_api.h */
+static void
+compact_api_get_bounds(unsigned long *first, unsigned long *last)
+{
+    retrocl_compact_get_bounds(first, last, NULL, NULL);
+}
+
+static void *compact_api[2] = {NULL, (void *)compact_api_get_bounds};
+
+/*
+ * Function: retrocl_compact_open
+ *
+ * Returns: 0 on success, -1 if the store cannot be opened
+ *
+ * Arguments: none
+ *
+ * Description: opens the segments of the compact store.  The store lives in
+ * the "compact" directory below nsslapd-changelogdir, or below the changelog
+ * database directory.  Called once at startup, before the change numbers are
+ * read.
+ */
+int
+retrocl_compact_open(void)
+{
+    char *cldir;
+    char *interval;
+    compact_segment *seg;
+
+    if (!retrocl_compact || cs.cs_open) {
+        return 0;
+    }
+
+    cldir = retrocl_get_config_str(CONFIG_CHANGELOG_DIRECTORY_ATTRIBUTE);
+    if (cldir) {
+        cs.cs_dir = slapi_ch_smprintf("%s/%s", cldir, RETROCL_COMPACT_SUBDIR);
+        slapi_ch_free_string(&cldir);
+    } else if (retrocl_be_changelog &&
+               slapi_back_get_info(retrocl_be_changelog, BACK_INFO_DIRECTORY, (void **)&cldir) == LDAP_SUCCESS &&
+               cldir) {
+        /* cldir belongs to the backend */
+        cs.cs_dir = slapi_ch_smprintf("%s/changelog-%s", cldir, RETROCL_COMPACT_SUBDIR);
+    } else {
+        slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                      "retrocl_compact_open - No directory for the compact changelog, set %s\n",
+                      CONFIG_CHANGELOG_DIRECTORY_ATTRIBUTE);
+        return -1;
+    }
+    if (mkdir_p(cs.cs_dir, 0700) != 0) {
+        slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                      "retrocl_compact_open - Failed to create %s (%d)\n", cs.cs_dir, errno);
+        slapi_ch_free_string(&cs.cs_dir);
+        return -1;
+    }
+
+    cs.cs_sync_interval = DEFAULT_CHANGELOG_COMPACT_SYNC_INTERVAL;
+    interval = retrocl_get_config_str(CONFIG_CHANGELOG_COMPACT_SYNC_INTERVAL);
+    if (interval) {
+        char *end = NULL;
+        long value = strtol(interval, &end, 10);
+
+        if (end == interval || *end != '\0' || value < 0 || value > INT_MAX) {
+            slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                          "retrocl_compact_open - Ignoring invalid %s value %s; using %d\n",
+                          CONFIG_CHANGELOG_COMPACT_SYNC_INTERVAL, interval,
+                          DEFAULT_CHANGELOG_COMPACT_SYNC_INTERVAL);
+        } else {
+            cs.cs_sync_interval = (int)value;
+        }
+        slapi_ch_free_string(&interval);
+    }
+
+    if ((cs.cs_lock = PR_NewLock()) == NULL) {
+        slapi_ch_free_string(&cs.cs_dir);
+        return -1;
+    }
+    if (compact_load() != 0) {
+        compact_free_segments();
+        PR_DestroyLock(cs.cs_lock);
+        cs.cs_lock = NULL;
+        slapi_ch_free_string(&cs.cs_dir);
+        return -1;
+    }
+
+    cs.cs_open = 1;
+    if (cs.cs_sync_interval > 0) {
+        cs.cs_sync_ctx = slapi_eq_repeat_rel(compact_sync, NULL, (time_t)0, cs.cs_sync_interval);
+    }
+    /* content sync reads the change numbers from here, the backend is empty */
+    if (slapi_apib_register(RetroCLCompact_v1_0_GUID, compact_api)) {
+        slapi_log_err(SLAPI_LOG_WARNING, RETROCL_PLUGIN_NAME,
+                      "retrocl_compact_open - Failed to publish the compact changelog interface\n");
+    }
+
+    for (seg = cs.cs_head; seg && seg->rs_next; seg = seg->rs_next)
+        ;
+    slapi_log_err(SLAPI_LOG_INFO, RETROCL_PLUGIN_NAME,
+                  "retrocl_compact_open - Compact changelog in %s, changes %lu to %lu\n",
+                  cs.cs_dir, cs.cs_head ? cs.cs_head->rs_first_cn : 0UL,
+                  seg ? seg->rs_last_cn : 0UL);
+    return 0;
+}
+
+/*
+ * Function: retrocl_compact_close
+ *
+ * Description: writes out the buffered records and closes the store.
+ * Called when the server is shutting down.
+ */
+void
+retrocl_compact_close(void)
+{
+    if (!cs.cs_open) {
+        return;
+    }
+    slapi_apib_unregister(RetroCLCompact_v1_0_GUID);
+    if (cs.cs_sync_ctx) {
+        slapi_eq_cancel_rel(cs.cs_sync_ctx);
+        cs.cs_sync_ctx = NULL;
+    }
+
+    PR_Lock(cs.cs_lock);
+    cs.cs_open = 0;
+    if (cs.cs_tail) {
+        compact_flush();
+        fdatasync(cs.cs_tail->rs_fd);
+    }
+    compact_free_segments();
+    compact_buf_done(&cs.cs_wbuf);
+    PR_Unlock(cs.cs_lock);
+
+    PR_DestroyLock(cs.cs_lock);
+    cs.cs_lock = NULL;
+    slapi_ch_free_string(&cs.cs_dir);
+}
+
+/*
+ * Function: retrocl_compact_append
+ *
+ * Returns: LDAP_SUCCESS, or LDAP_OPERATIONS_ERROR if the record is not logged
+ *
+ * Arguments: the change record entry, its change number and change time
+ *
+ * Description: appends a change record to the store.  Change numbers are
+ * appended in increasing order, the caller holds retrocl_internal_lock.
+ */
+int
+retrocl_compact_append(Slapi_Entry *e, changeNumber cn, time_t changetime)
+{
+    compact_buf rec = {0};
+    compact_segment *seg;
+    int rc = LDAP_SUCCESS;
+
+    if (compact_encode(&rec, e, cn, changetime) != 0) {
+        slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                      "retrocl_compact_append - Change record %lu is too large\n", cn);
+        compact_buf_done(&rec);
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    PR_Lock(cs.cs_lock);
+    if (!cs.cs_open) {
+        rc = LDAP_OPERATIONS_ERROR;
+        goto done;
+    }
+    seg = cs.cs_tail;
+    if (seg && seg->rs_nrecords && cn <= seg->rs_last_cn) {
+        slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                      "retrocl_compact_append - Change number %lu is not after %lu\n",
+                      cn, seg->rs_last_cn);
+        rc = LDAP_OPERATIONS_ERROR;
+        goto done;
+    }
+    if (seg == NULL || seg->rs_size >= RETROCL_COMPACT_SEGMENT_SIZE ||
+        seg->rs_first_time + RETROCL_COMPACT_SEGMENT_AGE <= changetime) {
+        if (compact_roll(cn) != 0) {
+            rc = LDAP_OPERATIONS_ERROR;
+            goto done;
+        }
+        seg = cs.cs_tail;
+    }
+
+    if (cs.cs_wbuf.cb_len + rec.cb_len > RETROCL_COMPACT_WBUF_SIZE && compact_flush() != 0) {
+        rc = LDAP_OPERATIONS_ERROR;
+        goto done;
+    }
+    compact_buf_put(&cs.cs_wbuf, rec.cb_data, rec.cb_len);
+    compact_segment_account(seg, cn, changetime, seg->rs_size, rec.cb_len);
+
+    if (cs.cs_sync_interval == 0) {
+        /* the record is durable before the operation returns */
+        if (compact_flush() == 0) {
+            fdatasync(seg->rs_fd);
+            cs.cs_dirty = 0;
+        }
+    }
+
+done:
+    PR_Unlock(cs.cs_lock);
+    compact_buf_done(&rec);
+    return rc;
+}
+
+/*
+ * Function: retrocl_compact_get_bounds
+ *
+ * Description: returns the first and last change numbers in the store and
+ * their change times, all 0 if the store is empty.
+ */
+void
+retrocl_compact_get_bounds(changeNumber *first, changeNumber *last, time_t *first_time, time_t *last_time)
+{
+    changeNumber f = 0, l = 0;
+    time_t ft = 0, lt = 0;
+
+    if (cs.cs_open) {
+        PR_Lock(cs.cs_lock);
+        if (cs.cs_head && cs.cs_tail->rs_nrecords) {
+            f = cs.cs_head->rs_first_cn;
+            ft = cs.cs_head->rs_first_time;
+            l = cs.cs_tail->rs_last_cn;
+            lt = cs.cs_tail->rs_last_time;
+        }
+        PR_Unlock(cs.cs_lock);
+    }
+    if (first) {
+        *first = f;
+    }
+    if (last) {
+        *last = l;
+    }
+    if (first_time) {
+        *first_time = ft;
+    }
+    if (last_time) {
+        *last_time = lt;
+    }
+}
+
+/*
+ * Function: retrocl_compact_trimmable
+ *
+ * Returns: 1 if a segment holds only changes older than cutoff
+ *
+ * Description: the current segment is never trimmed, so the changelog keeps
+ * at least its last change.
+ */
+int
+retrocl_compact_trimmable(time_t cutoff)
+{
+    int rc = 0;
+
+    if (cs.cs_open) {
+        PR_Lock(cs.cs_lock);
+        rc = cs.cs_head && cs.cs_head != cs.cs_tail && cs.cs_head->rs_last_time < cutoff;
+        PR_Unlock(cs.cs_lock);
+    }
+    return rc;
+}
+
+/*
+ * Function: retrocl_compact_trim
+ *
+ * Returns: the number of change records removed
+ *
+ * Arguments: cutoff - changes older than this can go
+ *            first  - set to the first change number left in the store
+ *
+ * Description: removes the segments holding only changes older than cutoff.
+ * A segment that is being read goes away with its last reader.
+ */
+int
+retrocl_compact_trim(time_t cutoff, changeNumber *first)
+{
+    int removed = 0;
+
+    *first = 0;
+    if (!cs.cs_open) {
+        return 0;
+    }
+    PR_Lock(cs.cs_lock);
+    while (cs.cs_head && cs.cs_head != cs.cs_tail && cs.cs_head->rs_last_time < cutoff) {
+        compact_segment *seg = cs.cs_head;
+
+        cs.cs_head = seg->rs_next;
+        removed += seg->rs_nrecords;
+        slapi_log_err(SLAPI_LOG_PLUGIN, RETROCL_PLUGIN_NAME,
+                      "retrocl_compact_trim - Removing %s, changes %lu to %lu\n",
+                      seg->rs_path, seg->rs_first_cn, seg->rs_last_cn);
+        seg->rs_removed = 1;
+        compact_segment_release(seg);
+    }
+    if (cs.cs_head) {
+        *first = cs.cs_head->rs_first_cn;
+    }
+    PR_Unlock(cs.cs_lock);
+    return removed;
+}
+
+/* ----------------------------- search */
+
+/*
+ * Narrow [*lo, *hi] with the changenumber assertions of the filter or of
+ * the components of its ANDs.
+ */
+static void
+compact_filter_range(Slapi_Filter *f, changeNumber *lo, changeNumber *hi)
+{
+    Slapi_Filter *sub;
+    struct berval *bval = NULL;
+    char *type = NULL;
+    char *end = NULL;
+    changeNumber cn;
+    int choice = slapi_filter_get_choice(f);
+
+    if (choice == LDAP_FILTER_AND) {
+        for (sub = slapi_filter_list_first(f); sub; sub = slapi_filter_list_next(f, sub)) {
+            compact_filter_range(sub, lo, hi);
+        }
+        return;
+    }
+    if ((choice != LDAP_FILTER_EQUALITY && choice != LDAP_FILTER_GE && choice != LDAP_FILTER_LE) ||
+        slapi_filter_get_ava(f, &type, &bval) != 0 ||
+        strcasecmp(type, retrocl_changenumber) != 0 ||
+        bval == NULL || bval->bv_val == NULL || bval->bv_len == 0 || bval->bv_len >= CNUMSTR_LEN) {
+        return;
+    }
+    {
+        char buf[CNUMSTR_LEN];
+
+        memcpy(buf, bval->bv_val, bval->bv_len);
+        buf[bval->bv_len] = '\0';
+        cn = strtoul(buf, &end, 10);
+        if (*end != '\0') {
+            return;
+        }
+    }
+    if (choice != LDAP_FILTER_LE && cn > *lo) {
+        *lo = cn;
+    }
+    if (choice != LDAP_FILTER_GE && cn < *hi) {
+        *hi = cn;
+    }
+}
+
+/*
+ * Send the entry if it matches the filter.  Returns the LDAP result that ends
+ * the search, or -1 to go on.
+ */
+static int
+compact_send_entry(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Filter *filter, char **attrs, int attrsonly, int sizelimit, int *nentries)
+{
+    if (slapi_vattr_filter_test(pb, e, filter, 1 /* verify access */) != 0) {
+        return -1;
+    }
+    if (sizelimit >= 0 && *nentries >= sizelimit) {
+        return LDAP_SIZELIMIT_EXCEEDED;
+    }
+    switch (slapi_send_ldap_search_entry(pb, e, NULL, attrs, attrsonly)) {
+    case 0:
+        (*nentries)++;
+        break;
+    case 1: /* not sent, access control */
+        break;
+    default: /* the connection is gone */
+        return LDAP_OPERATIONS_ERROR;
+    }
+    return -1;
+}
+
+/*
+ * Send the change records from lo to hi.  Returns the LDAP result of the
+ * search.
+ */
+static int
+compact_search_range(Slapi_PBlock *pb, changeNumber lo, changeNumber hi, Slapi_Filter *filter, char **attrs, int attrsonly, int sizelimit, int *nentries)
+{
+    compact_segment **segs = NULL;
+    uint64_t *limits = NULL;
+    size_t nsegs = 0;
+    size_t maxsegs = 0;
+    compact_segment *seg;
+    compact_reader rd = {0};
+    int rc = -1;
+    size_t i;
+
+    /* Take the segments holding the range, as they are now */
+    PR_Lock(cs.cs_lock);
+    if (cs.cs_tail) {
+        compact_flush();
+    }
+    for (seg = cs.cs_head; seg; seg = seg->rs_next) {
+        if (seg->rs_nrecords == 0 || seg->rs_last_cn < lo) {
+            continue;
+        }
+        if (seg->rs_first_cn > hi) {
+            break;
+        }
+        if (nsegs == maxsegs) {
+            maxsegs = maxsegs ? maxsegs * 2 : 8;
+            segs = (compact_segment **)slapi_ch_realloc((char *)segs, maxsegs * sizeof(compact_segment *));
+            limits = (uint64_t *)slapi_ch_realloc((char *)limits, maxsegs * sizeof(uint64_t));
+        }
+        seg->rs_refcnt++;
+        segs[nsegs] = seg;
+        limits[nsegs] = seg->rs_written;
+        nsegs++;
+    }
+    PR_Unlock(cs.cs_lock);
+
+    for (i = 0; i < nsegs && rc == -1; i++) {
+        uint64_t offset = compact_segment_seek(segs[i], lo);
+
+        rd.rd_fd = segs[i]->rs_fd;
+        rd.rd_offset = 0;
+        rd.rd_buf.cb_len = 0;
+        while (rc == -1) {
+            const char *p;
+            Slapi_Entry *e;
+            changeNumber cn;
+            time_t changetime;
+            uint32_t len;
+
+            if (slapi_op_abandoned(pb)) {
+                rc = LDAP_SUCCESS;
+                break;
+            }
+            if ((p = compact_reader_next(&rd, offset, limits[i], &len)) == NULL) {
+                break;
+            }
+            offset += RETROCL_COMPACT_HDR_SIZE + len + RETROCL_COMPACT_TRAILER_SIZE;
+            compact_payload_header(p, &cn, &changetime);
+            if (cn < lo) {
+                continue;
+            }
+            if (cn > hi) {
+                rc = LDAP_SUCCESS;
+                break;
+            }
+            if ((e = compact_decode(p, len)) != NULL) {
+                rc = compact_send_entry(pb, e, filter, attrs, attrsonly, sizelimit, nentries);
+                slapi_entry_free(e);
+            }
+        }
+    }
+    compact_buf_done(&rd.rd_buf);
+
+    PR_Lock(cs.cs_lock);
+    for (i = 0; i < nsegs; i++) {
+        compact_segment_release(segs[i]);
+    }
+    PR_Unlock(cs.cs_lock);
+    slapi_ch_free((void **)&segs);
+    slapi_ch_free((void **)&limits);
+
+    return rc == -1 ? LDAP_SUCCESS : rc;
+}
+
+/* Does the store hold the change cn */
+static int
+compact_has_change(changeNumber cn)
+{
+    changeNumber first, last;
+
+    retrocl_compact_get_bounds(&first, &last, NULL, NULL);
+    return first && cn >= first && cn <= last;
+}
+
+/*
+ * Function: retrocl_compact_search
+ *
+ * Returns: 0 if the search is left to the backend, 1 if it was served
+ *
+ * Arguments: Pb of the search
+ *
+ * Description: pre-search callback serving the change records below
+ * cn=changelog from the compact store.  Base searches of cn=changelog are
+ * left to the changelog backend, which holds the container entry.  Like the
+ * backend, a persistent search gets no result after the stored entries
+ * (none with changesOnly) and the operation stays open for the new changes.
+ */
+int
+retrocl_compact_search(Slapi_PBlock *pb)
+{
+    Slapi_DN *base = NULL;
+    Slapi_DN *cl_sdn = NULL;
+    Slapi_Filter *filter = NULL;
+    Slapi_Operation *op = NULL;
+    char **attrs = NULL;
+    const char *ndn;
+    const char *matched = NULL;
+    changeNumber lo = 0;
+    changeNumber hi = ULONG_MAX;
+    int attrsonly = 0;
+    int sizelimit = -1;
+    int scope = LDAP_SCOPE_BASE;
+    int nentries = 0;
+    int psearch = 0;
+    int changesonly = 0;
+    int rc = -1;
+
+    if (!cs.cs_open) {
+        return 0;
+    }
+    slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    if (op && operation_is_flag_set(op, OP_FLAG_PS)) {
+        psearch = 1;
+        changesonly = operation_is_flag_set(op, OP_FLAG_PS_CHANGESONLY);
+    }
+    slapi_pblock_get(pb, SLAPI_SEARCH_TARGET_SDN, &base);
+    slapi_pblock_get(pb, SLAPI_SEARCH_SCOPE, &scope);
+    if (base == NULL) {
+        return 0;
+    }
+
+    cl_sdn = slapi_sdn_new_ndn_byref(RETROCL_CHANGELOG_DN);
+    if (!slapi_sdn_issuffix(base, cl_sdn) ||
+        (scope == LDAP_SCOPE_BASE && slapi_sdn_compare(base, cl_sdn) == 0)) {
+        slapi_sdn_free(&cl_sdn);
+        return 0;
+    }
+
+    slapi_pblock_get(pb, SLAPI_SEARCH_FILTER, &filter);
+    slapi_pblock_get(pb, SLAPI_SEARCH_ATTRS, &attrs);
+    slapi_pblock_get(pb, SLAPI_SEARCH_ATTRSONLY, &attrsonly);
+    slapi_pblock_get(pb, SLAPI_SEARCH_SIZELIMIT, &sizelimit);
+
+    if (slapi_sdn_compare(base, cl_sdn) == 0) {
+        if (changesonly) {
+            rc = LDAP_SUCCESS;
+        } else if (scope == LDAP_SCOPE_SUBTREE) {
+            Slapi_Entry *container = NULL;
+
+            slapi_search_internal_get_entry(cl_sdn, NULL, &container, g_plg_identity[PLUGIN_RETROCL]);
+            if (container) {
+                rc = compact_send_entry(pb, container, filter, attrs, attrsonly, sizelimit, &nentries);
+                slapi_entry_free(container);
+            }
+        }
+    } else {
+        /* changenumber=N,cn=changelog */
+        const char *prefix = "changenumber=";
+        char *end = NULL;
+        changeNumber cn = 0;
+
+        ndn = slapi_sdn_get_ndn(base);
+        if (strncmp(ndn, prefix, strlen(prefix)) == 0) {
+            cn = strtoul(ndn + strlen(prefix), &end, 10);
+        }
+        if (cn == 0 || end == NULL || strcmp(end, "," RETROCL_CHANGELOG_DN) ||
+            !compact_has_change(cn)) {
+            matched = RETROCL_CHANGELOG_DN;
+            rc = LDAP_NO_SUCH_OBJECT;
+        } else if (scope == LDAP_SCOPE_ONELEVEL || changesonly) {
+            rc = LDAP_SUCCESS;
+        } else {
+            lo = hi = cn;
+        }
+    }
+
+    if (rc == -1) {
+        if (filter) {
+            compact_filter_range(filter, &lo, &hi);
+        }
+        if (lo <= hi) {
+            rc = compact_search_range(pb, lo, hi, filter, attrs, attrsonly, sizelimit, &nentries);
+        } else {
+            rc = LDAP_SUCCESS;
+        }
+    }
+
+    if (!psearch || rc != LDAP_SUCCESS) {
+        slapi_send_ldap_result(pb, rc, (char *)matched, NULL, nentries, NULL);
+    }
+    /* a failed persistent search is not added to the persistent searches */
+    rc = psearch ? rc : 0;
+    slapi_pblock_set(pb, SLAPI_PLUGIN_OPRETURN, &rc);
+    slapi_sdn_free(&cl_sdn);
+    return 1;
+}
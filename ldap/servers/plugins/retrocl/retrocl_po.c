@@ -359,8 +359,23 @@ write_replog_db(
         err = SLAPI_PLUGIN_FAILURE;
     }
 
-    /* Call the repl backend to add this entry */
-    if (0 == err) {
+    if (0 == err && retrocl_compact_enabled()) {
+        /* Append the change to the compact store, searches of
+         * cn=changelog rebuild the entry from it */
+        ret = retrocl_compact_append(e, changenum, curtime);
+        if (0 != ret) {
+            slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                          "write_replog_db - An error occured while logging change "
+                          "number %lu, dn = %s: %s. \n",
+                          changenum, edn, ldap_err2string(ret));
+            retrocl_release_changenumber();
+        } else {
+            retrocl_commit_changenumber();
+            do_ps_service(e, NULL, LDAP_CHANGETYPE_ADD, 0);
+        }
+        slapi_entry_free(e);
+    } else if (0 == err) {
+        /* Call the repl backend to add this entry */
         newPb = slapi_pblock_new();
         slapi_add_entry_internal_set_pb(newPb, e, NULL /* controls */,
                                         g_plg_identity[PLUGIN_RETROCL],
@@ -257,6 +257,16 @@ trim_changelog(void)
          */
         done = 0;
         now_maxage = slapi_current_utc_time(); /* real time for trim candidates */
+        if (retrocl_compact_enabled()) {
+            /* The compact store is trimmed by whole segments */
+            if (max_age > 0L) {
+                num_deleted = retrocl_compact_trim(now_maxage - max_age, &first_in_log);
+                if (num_deleted > 0) {
+                    retrocl_set_first_changenumber(first_in_log);
+                }
+            }
+            done = 1;
+        }
         while (!done && retrocl_trimming == 1) {
             int did_delete;
 
@@ -371,19 +381,25 @@ retrocl_housekeeping(time_t cur_time, void *noarg __attribute__((unused)))
             /* Is the first entry too old? */
             time_t first_time;
             time_t now_maxage = slapi_current_utc_time(); /* real time for trimming candidates */
-            /*
-             * good we could avoid going to the database to retrieve
-             * this time information if we cached the last value we'd read.
-             * But a client might have deleted it over protocol.
-             */
-            first_time = retrocl_getchangetime(SLAPI_SEQ_FIRST, &ldrc);
-            slapi_log_err(SLAPI_LOG_PLUGIN, RETROCL_PLUGIN_NAME,
-                          "cltrim: ldrc=%d, first_time=%ld, cur_time=%ld\n",
-                          ldrc, first_time, cur_time);
-            if (LDAP_SUCCESS == ldrc && first_time > (time_t)0L &&
-                first_time + ts.ts_c_max_age < now_maxage)
-            {
-                must_trim = 1;
+            if (retrocl_compact_enabled()) {
+                /* Only whole segments can go */
+                must_trim = ts.ts_c_max_age > 0 &&
+                            retrocl_compact_trimmable(now_maxage - ts.ts_c_max_age);
+            } else {
+                /*
+                 * good we could avoid going to the database to retrieve
+                 * this time information if we cached the last value we'd read.
+                 * But a client might have deleted it over protocol.
+                 */
+                first_time = retrocl_getchangetime(SLAPI_SEQ_FIRST, &ldrc);
+                slapi_log_err(SLAPI_LOG_PLUGIN, RETROCL_PLUGIN_NAME,
+                              "cltrim: ldrc=%d, first_time=%ld, cur_time=%ld\n",
+                              ldrc, first_time, cur_time);
+                if (LDAP_SUCCESS == ldrc && first_time > (time_t)0L &&
+                    first_time + ts.ts_c_max_age < now_maxage)
+                {
+                    must_trim = 1;
+                }
             }
         }
         if (must_trim) {
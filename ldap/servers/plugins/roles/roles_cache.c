@@ -28,6 +28,7 @@
 #include "prcvar.h"
 #include "prio.h"
 #include "avl.h"
+#include "plhash.h"
 #include "vattr_spi.h"
 #include "roles_cache.h"
 #include "views.h"
@@ -40,6 +41,11 @@
 
 #define MAX_NESTED_ROLES 30
 
+/* Number of 64 bits words of a role membership bitmap */
+#define ROLES_INDEX_WORDS(nroles) ((size_t)(nroles) / 64 + 1)
+/* Number of the generations of the entries of a membership index, power of two */
+#define ROLES_INDEX_GEN_BUCKETS 256
+
 static char *allUserAttributes[] = {
     LDAP_ALL_USER_ATTRS,
     NULL};
@@ -97,14 +103,48 @@ typedef struct _roles_cache_def
     Slapi_Entry *notified_entry;
     int notified_operation;
 
+    /* Role membership index (nsRoleMembershipIndex): entry ndn -> bitmap of
+       the roles of this suffix the entry is a member of. index_lock protects
+       the table and the numbering of the roles (index_roles), index_nroles
+       is -1 until the roles are numbered again after a definition change */
+    Slapi_Mutex *index_lock;
+    PLHashTable *member_index;
+    role_object **index_roles;
+    int index_nroles;
+    int index_count;
+    uint64_t index_gen; /* bumped every time the index is cleared */
+    /* bumped when an entry is invalidated, the entries are spread over the
+       buckets by the hash of their ndn */
+    uint64_t index_entry_gen[ROLES_INDEX_GEN_BUCKETS];
+
 } roles_cache_def;
 
+/* Role membership index entry, bit i is set when the entry is a member
+   of index_roles[i] */
+typedef struct _roles_index_entry
+{
+    char *ndn;           /* hash key */
+    int32_t watermark;   /* vattr cache watermark when it was computed */
+    uint64_t generation; /* roles_index_generation when it was computed */
+    uint64_t bits[];
+} roles_index_entry;
+
 
 /* Global list containing all the roles definitions per suffix */
 static roles_cache_def *roles_list = NULL;
 
 static Slapi_RWLock *global_lock = NULL;
 
+/* Role membership index configuration and statistics */
+static int roles_index_enabled = 0;
+static int roles_index_max_entries = ROLES_INDEX_MAX_ENTRIES;
+/* Bumped whenever role definitions change, in any suffix since a
+   nested role may contain the roles of another suffix */
+static uint64_t roles_index_generation = 1;
+static char *roles_stats_dn = NULL;
+static Slapi_Counter *roles_index_hits = NULL;
+static Slapi_Counter *roles_index_misses = NULL;
+
 /* Structure holding the nsrole values */
 typedef struct _roles_cache_build_result
 {
@@ -162,6 +202,12 @@ static int roles_cache_dump(caddr_t data, caddr_t arg);
 static int roles_cache_add_entry_cb(Slapi_Entry *e, void *callback_data);
 static void roles_cache_result_cb(int rc, void *callback_data);
 static Slapi_DN *roles_cache_get_top_suffix(Slapi_DN *suffix);
+static void roles_index_clear(roles_cache_def *suffix_def);
+static void roles_index_reset(roles_cache_def *suffix_def);
+static void roles_index_invalidate_entry(Slapi_PBlock *pb);
+static void roles_index_lookup(roles_cache_def *suffix_def, vattr_context *c, Slapi_Entry *entry, role_object ***roles, int *nroles, uint64_t **bits);
+static void roles_index_build_nsrole(roles_cache_def *suffix_def, roles_cache_build_result *result);
+static int roles_index_stats_search(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *entryAfter, int *returncode, char *returntext, void *arg);
 
 /*     ============== FUNCTIONS ================ */
 
@@ -175,7 +221,7 @@ static Slapi_DN *roles_cache_get_top_suffix(Slapi_DN *suffix);
     return -1 otherwise
 */
 int
-roles_cache_init()
+roles_cache_init(const char *plugin_dn)
 {
     int rc = 0;
     void *node = NULL;
@@ -188,6 +234,10 @@ roles_cache_init()
     if (global_lock == NULL) {
         global_lock = slapi_new_rwlock();
     }
+    if (roles_index_hits == NULL) {
+        roles_index_hits = slapi_counter_new();
+        roles_index_misses = slapi_counter_new();
+    }
 
     /* grab the views interface */
     if (slapi_apib_get_interface(Views_v1_0_GUID, &views_api)) {
@@ -244,6 +294,13 @@ roles_cache_init()
         return (-1);
     }
 
+    /* Publish the membership index statistics on the plugin entry */
+    if (roles_index_enabled && plugin_dn) {
+        roles_stats_dn = slapi_ch_strdup(plugin_dn);
+        slapi_config_register_callback(SLAPI_OPERATION_SEARCH, DSE_FLAG_PREOP, roles_stats_dn,
+                                       LDAP_SCOPE_BASE, "(objectclass=*)", roles_index_stats_search, NULL);
+    }
+
     slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM, "<-- roles_cache_init\n");
     return rc;
 }
@@ -275,10 +332,12 @@ roles_cache_create_suffix(Slapi_DN *sdn)
     new_suffix->change_lock = slapi_new_mutex();
     new_suffix->stop_lock = slapi_new_mutex();
     new_suffix->create_lock = slapi_new_mutex();
+    new_suffix->index_lock = slapi_new_mutex();
     if (new_suffix->stop_lock == NULL ||
         new_suffix->change_lock == NULL ||
         new_suffix->cache_lock == NULL ||
-        new_suffix->create_lock == NULL) {
+        new_suffix->create_lock == NULL ||
+        new_suffix->index_lock == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, ROLES_PLUGIN_SUBSYSTEM,
                       "roles_cache_create_suffix - Lock creation failed\n");
         roles_cache_role_def_free(new_suffix);
@@ -305,6 +364,12 @@ roles_cache_create_suffix(Slapi_DN *sdn)
 
     new_suffix->suffix_dn = slapi_sdn_dup(sdn);
 
+    new_suffix->index_nroles = -1;
+    if (roles_index_enabled) {
+        new_suffix->member_index = PL_NewHashTable(0, PL_HashString, PL_CompareStrings,
+                                                   PL_CompareValues, NULL, NULL);
+    }
+
     /* those 3 items are used to give back info to the thread when
     it is awakened */
     new_suffix->notified_dn = NULL;
@@ -594,6 +659,7 @@ roles_cache_update(roles_cache_def *suffix_to_update)
         }
         suffix_to_update->notified_entry = NULL;
     }
+    roles_index_reset(suffix_to_update);
 done:
     slapi_rwlock_unlock(suffix_to_update->cache_lock);
     if (dn != NULL) {
@@ -619,6 +685,12 @@ roles_cache_stop()
 
     slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM, "--> roles_cache_stop\n");
 
+    if (roles_stats_dn) {
+        slapi_config_remove_callback(SLAPI_OPERATION_SEARCH, DSE_FLAG_PREOP, roles_stats_dn,
+                                     LDAP_SCOPE_BASE, "(objectclass=*)", roles_index_stats_search);
+        slapi_ch_free_string(&roles_stats_dn);
+    }
+
     /* Go through all the roles list and trigger the associated structure */
     slapi_rwlock_wrlock(global_lock);
     current_role = roles_list;
@@ -740,6 +812,10 @@ roles_cache_change_notify(Slapi_PBlock *pb)
                   ROLES_PLUGIN_SUBSYSTEM,
                   "--> roles_cache_change_notify\n");
 
+    /* Done even if the operation failed: the entry may have been
+       evaluated in its new state during the operation */
+    roles_index_invalidate_entry(pb);
+
     /* if the current operation has failed, don't even try the post operation */
     slapi_pblock_get(pb, SLAPI_PLUGIN_OPRETURN, &rc);
     if (rc != LDAP_SUCCESS) {
@@ -945,6 +1021,8 @@ roles_cache_add_roles_from_suffix(Slapi_DN *suffix_dn, roles_cache_def *suffix_d
     if (info.rc == LDAP_SUCCESS) {
         rc = 0;
     }
+    /* The roles may have been numbered while the definitions were loaded */
+    roles_index_reset(suffix_def);
 
     slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM, "<-- roles_cache_add_roles_from_suffix\n");
 
@@ -1510,7 +1588,11 @@ roles_cache_listroles_ext(vattr_context *c, Slapi_Entry *entry, int return_value
             /* XXX really need a mutex for this read operation ? */
             slapi_rwlock_rdlock(roles_cache->cache_lock);
 
-            avl_apply(roles_cache->avl_tree, (IFP)roles_cache_build_nsrole, &arg, -1, AVL_INORDER);
+            if (roles_cache->member_index) {
+                roles_index_build_nsrole(roles_cache, &arg);
+            } else {
+                avl_apply(roles_cache->avl_tree, (IFP)roles_cache_build_nsrole, &arg, -1, AVL_INORDER);
+            }
 
             slapi_rwlock_unlock(roles_cache->cache_lock);
 
@@ -1627,6 +1709,32 @@ roles_check(Slapi_Entry *entry_to_check, Slapi_DN *role_dn, int *present)
     }
     slapi_rwlock_unlock(global_lock);
 
+    if (roles_cache->member_index) {
+        role_object **roles = NULL;
+        uint64_t *bits = NULL;
+        int nroles = 0;
+        int i;
+
+        slapi_rwlock_rdlock(roles_cache->cache_lock);
+        this_role = (role_object *)avl_find(roles_cache->avl_tree, role_dn, (IFP)roles_cache_find_node);
+        if (this_role) {
+            roles_index_lookup(roles_cache, NULL, entry_to_check, &roles, &nroles, &bits);
+            for (i = 0; i < nroles; i++) {
+                if (roles[i] == this_role) {
+                    *present = (bits[i / 64] >> (i % 64)) & 1;
+                    break;
+                }
+            }
+            slapi_ch_free((void **)&roles);
+            slapi_ch_free((void **)&bits);
+        }
+        slapi_rwlock_unlock(roles_cache->cache_lock);
+
+        slapi_log_err(SLAPI_LOG_PLUGIN,
+                      ROLES_PLUGIN_SUBSYSTEM, "<-- roles_check\n");
+        return rc;
+    }
+
     this_role = (role_object *)avl_find(roles_cache->avl_tree, role_dn, (IFP)roles_cache_find_node);
 
     /* MAB: For some reason the assumption made by this function (the role exists and is in scope)
@@ -2026,6 +2134,14 @@ roles_cache_role_def_free(roles_cache_def *role_def)
 
     slapi_lock_mutex(role_def->stop_lock);
 
+    if (role_def->member_index) {
+        roles_index_clear(role_def);
+        PL_HashTableDestroy(role_def->member_index);
+        role_def->member_index = NULL;
+    }
+    slapi_ch_free((void **)&role_def->index_roles);
+    slapi_destroy_mutex(role_def->index_lock);
+    role_def->index_lock = NULL;
     avl_free(role_def->avl_tree, (IFP)roles_cache_role_object_free);
     slapi_sdn_free(&(role_def->suffix_dn));
     slapi_destroy_rwlock(role_def->cache_lock);
@@ -2131,3 +2247,317 @@ roles_cache_dump(caddr_t data, caddr_t arg __attribute__((unused)))
 
     return 0;
 }
+
+/* roles_cache_index_config
+   ------------------------
+   Configure the role membership index from the plugin entry, before the
+   caches are created
+ */
+void
+roles_cache_index_config(Slapi_Entry *plugin_entry)
+{
+    int max_entries;
+
+    roles_index_enabled = slapi_entry_attr_get_bool(plugin_entry, ROLES_INDEX_ATTR);
+    max_entries = slapi_entry_attr_get_int(plugin_entry, ROLES_INDEX_MAX_ATTR);
+    roles_index_max_entries = (max_entries > 0) ? max_entries : ROLES_INDEX_MAX_ENTRIES;
+
+    slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM,
+                  "roles_cache_index_config - Role membership index %s (%d entries per suffix)\n",
+                  roles_index_enabled ? "enabled" : "disabled", roles_index_max_entries);
+}
+
+/* roles_index_free_entry
+   ----------------------
+   Hash enumerator freeing and removing every entry of the index
+ */
+static PRIntn
+roles_index_free_entry(PLHashEntry *he, PRIntn i __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    roles_index_entry *index_entry = (roles_index_entry *)he->value;
+
+    slapi_ch_free_string(&index_entry->ndn);
+    slapi_ch_free((void **)&index_entry);
+    return HT_ENUMERATE_REMOVE;
+}
+
+/* roles_index_clear
+   -----------------
+   Remove all the entries of the membership index, index_lock must be held
+ */
+static void
+roles_index_clear(roles_cache_def *suffix_def)
+{
+    PL_HashTableEnumerateEntries(suffix_def->member_index, roles_index_free_entry, NULL);
+    suffix_def->index_count = 0;
+    suffix_def->index_gen++;
+}
+
+/* roles_index_reset
+   -----------------
+   The roles definitions of the suffix have changed: clear the membership
+   index, the roles are numbered again on the next lookup
+ */
+static void
+roles_index_reset(roles_cache_def *suffix_def)
+{
+    if (suffix_def->member_index == NULL) {
+        return;
+    }
+    slapi_lock_mutex(suffix_def->index_lock);
+    roles_index_clear(suffix_def);
+    slapi_ch_free((void **)&suffix_def->index_roles);
+    suffix_def->index_nroles = -1;
+    slapi_unlock_mutex(suffix_def->index_lock);
+
+    slapi_atomic_incr_64(&roles_index_generation, __ATOMIC_RELEASE);
+}
+
+/* roles_index_entry_gen
+   ---------------------
+   Generation of the bucket of an entry, index_lock must be held
+ */
+static uint64_t *
+roles_index_entry_gen(roles_cache_def *suffix_def, const char *ndn)
+{
+    return &suffix_def->index_entry_gen[PL_HashString(ndn) & (ROLES_INDEX_GEN_BUCKETS - 1)];
+}
+
+/* roles_index_invalidate_entry
+   ----------------------------
+   Remove the target entry of an update from the membership index. A
+   renamed entry may have children, so the whole index of the suffix is
+   cleared in that case.
+   With the betxn plugin this is called in the transaction, and again by
+   roles_cache_index_post_op once it is committed: a lookup running in
+   between may have recorded the entry as it was before the update.
+ */
+static void
+roles_index_invalidate_entry(Slapi_PBlock *pb)
+{
+    Slapi_DN *sdn = NULL;
+    Slapi_Operation *op = NULL;
+    roles_cache_def *suffix_def = NULL;
+
+    if (!roles_index_enabled) {
+        return;
+    }
+    slapi_pblock_get(pb, SLAPI_TARGET_SDN, &sdn);
+    slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    if ((sdn == NULL) || (op == NULL)) {
+        return;
+    }
+
+    slapi_rwlock_rdlock(global_lock);
+    if ((roles_cache_find_roles_in_suffix(sdn, &suffix_def) == 0) &&
+        suffix_def->member_index) {
+        slapi_lock_mutex(suffix_def->index_lock);
+        if (operation_get_type(op) == SLAPI_OPERATION_MODRDN) {
+            roles_index_clear(suffix_def);
+        } else {
+            roles_index_entry *index_entry;
+
+            index_entry = (roles_index_entry *)PL_HashTableLookup(suffix_def->member_index,
+                                                                  slapi_sdn_get_ndn(sdn));
+            if (index_entry) {
+                PL_HashTableRemove(suffix_def->member_index, index_entry->ndn);
+                slapi_ch_free_string(&index_entry->ndn);
+                slapi_ch_free((void **)&index_entry);
+                suffix_def->index_count--;
+            }
+            (*roles_index_entry_gen(suffix_def, slapi_sdn_get_ndn(sdn)))++;
+        }
+        slapi_unlock_mutex(suffix_def->index_lock);
+    }
+    slapi_rwlock_unlock(global_lock);
+}
+
+/* roles_cache_index_post_op
+   -------------------------
+   Invalidate the target entry of an update in the membership index after
+   the transaction is committed, when the plugin runs as a betxn plugin
+ */
+void
+roles_cache_index_post_op(Slapi_PBlock *pb)
+{
+    if (!slapi_plugin_running(pb)) {
+        return;
+    }
+    roles_index_invalidate_entry(pb);
+}
+
+/* roles_index_number_role
+   -----------------------
+   avl callback giving the next bit of the membership bitmaps to a role
+ */
+static int
+roles_index_number_role(caddr_t data, caddr_t arg)
+{
+    roles_cache_def *suffix_def = (roles_cache_def *)arg;
+
+    suffix_def->index_roles[suffix_def->index_nroles++] = (role_object *)data;
+    return 0;
+}
+
+static int
+roles_index_count_role(caddr_t data __attribute__((unused)), caddr_t arg)
+{
+    (*(int *)arg)++;
+    return 0;
+}
+
+/* roles_index_lookup
+   ------------------
+   Get the roles of the suffix and the bitmap of the ones the entry is a
+   member of. The bitmap comes from the membership index, or it is computed
+   by evaluating every role and then recorded in the index.
+   cache_lock must be held, the roles are valid until it is released.
+   *roles and *bits must be freed by the caller.
+ */
+static void
+roles_index_lookup(roles_cache_def *suffix_def, vattr_context *c, Slapi_Entry *entry, role_object ***roles, int *nroles, uint64_t **bits)
+{
+    const char *ndn = slapi_entry_get_ndn(entry);
+    int32_t watermark = slapi_entrycache_vattrcache_watermark_get();
+    uint64_t generation = slapi_atomic_load_64(&roles_index_generation, __ATOMIC_ACQUIRE);
+    roles_index_entry *index_entry = NULL;
+    uint64_t index_gen;
+    uint64_t entry_gen;
+    size_t nwords;
+    int loop_detected = 0;
+    int i;
+
+    slapi_lock_mutex(suffix_def->index_lock);
+    if (suffix_def->index_nroles < 0) {
+        int count = 0;
+
+        avl_apply(suffix_def->avl_tree, (IFP)roles_index_count_role, &count, -1, AVL_INORDER);
+        suffix_def->index_roles = (role_object **)slapi_ch_calloc(count + 1, sizeof(role_object *));
+        suffix_def->index_nroles = 0;
+        avl_apply(suffix_def->avl_tree, (IFP)roles_index_number_role, suffix_def, -1, AVL_INORDER);
+    }
+    *nroles = suffix_def->index_nroles;
+    *roles = (role_object **)slapi_ch_calloc(*nroles + 1, sizeof(role_object *));
+    memcpy(*roles, suffix_def->index_roles, *nroles * sizeof(role_object *));
+    nwords = ROLES_INDEX_WORDS(*nroles);
+    *bits = (uint64_t *)slapi_ch_calloc(nwords, sizeof(uint64_t));
+
+    index_entry = (roles_index_entry *)PL_HashTableLookup(suffix_def->member_index, ndn);
+    if (index_entry && (index_entry->watermark == watermark) && (index_entry->generation == generation)) {
+        memcpy(*bits, index_entry->bits, nwords * sizeof(uint64_t));
+        slapi_unlock_mutex(suffix_def->index_lock);
+        slapi_counter_increment(roles_index_hits);
+        return;
+    }
+    index_gen = suffix_def->index_gen;
+    entry_gen = *roles_index_entry_gen(suffix_def, ndn);
+    slapi_unlock_mutex(suffix_def->index_lock);
+    slapi_counter_increment(roles_index_misses);
+
+    for (i = 0; i < *nroles; i++) {
+        roles_cache_search_in_nested get_nsrole;
+
+        get_nsrole.is_entry_member_of = entry;
+        get_nsrole.present = 0;
+        get_nsrole.hint = 0;
+        if (roles_is_entry_member_of_object_ext(c, (caddr_t)(*roles)[i], (caddr_t)&get_nsrole) ==
+            SLAPI_VIRTUALATTRS_LOOP_DETECTED) {
+            loop_detected = 1;
+            break;
+        }
+        if (get_nsrole.present) {
+            (*bits)[i / 64] |= (uint64_t)1 << (i % 64);
+        }
+    }
+    if (loop_detected) {
+        return;
+    }
+
+    /* Record it unless the entry or the roles changed in the meantime */
+    slapi_lock_mutex(suffix_def->index_lock);
+    if ((suffix_def->index_gen == index_gen) &&
+        (*roles_index_entry_gen(suffix_def, ndn) == entry_gen)) {
+        index_entry = (roles_index_entry *)PL_HashTableLookup(suffix_def->member_index, ndn);
+        if (index_entry) {
+            /* outdated */
+            PL_HashTableRemove(suffix_def->member_index, index_entry->ndn);
+            slapi_ch_free_string(&index_entry->ndn);
+            slapi_ch_free((void **)&index_entry);
+            suffix_def->index_count--;
+        } else if (suffix_def->index_count >= roles_index_max_entries) {
+            roles_index_clear(suffix_def);
+        }
+        index_entry = (roles_index_entry *)slapi_ch_calloc(1, sizeof(roles_index_entry) +
+                                                                  nwords * sizeof(uint64_t));
+        index_entry->ndn = slapi_ch_strdup(ndn);
+        index_entry->watermark = watermark;
+        index_entry->generation = generation;
+        memcpy(index_entry->bits, *bits, nwords * sizeof(uint64_t));
+        PL_HashTableAdd(suffix_def->member_index, index_entry->ndn, index_entry);
+        suffix_def->index_count++;
+    }
+    slapi_unlock_mutex(suffix_def->index_lock);
+}
+
+/* roles_index_build_nsrole
+   ------------------------
+   Same as roles_cache_build_nsrole for all the roles of a suffix, from the
+   membership index
+ */
+static void
+roles_index_build_nsrole(roles_cache_def *suffix_def, roles_cache_build_result *result)
+{
+    role_object **roles = NULL;
+    uint64_t *bits = NULL;
+    int nroles = 0;
+    int i;
+
+    roles_index_lookup(suffix_def, result->context, result->requested_entry, &roles, &nroles, &bits);
+    for (i = 0; i < nroles; i++) {
+        if (((bits[i / 64] >> (i % 64)) & 1) == 0) {
+            continue;
+        }
+        result->has_value = 1;
+        if (!result->need_value) {
+            break;
+        }
+        slapi_valueset_add_value_ext(*(result->nsrole_values),
+                                     slapi_value_new_string(slapi_sdn_get_ndn(roles[i]->dn)),
+                                     SLAPI_VALUE_FLAG_PASSIN);
+    }
+    slapi_ch_free((void **)&roles);
+    slapi_ch_free((void **)&bits);
+}
+
+/* roles_index_stats_search
+   ------------------------
+   Add the membership index statistics to the plugin entry
+ */
+static int
+roles_index_stats_search(Slapi_PBlock *pb __attribute__((unused)),
+                         Slapi_Entry *e,
+                         Slapi_Entry *entryAfter __attribute__((unused)),
+                         int *returncode,
+                         char *returntext __attribute__((unused)),
+                         void *arg __attribute__((unused)))
+{
+    roles_cache_def *current_role = NULL;
+    int entries = 0;
+
+    slapi_rwlock_rdlock(global_lock);
+    for (current_role = roles_list; current_role; current_role = current_role->next) {
+        if (current_role->member_index) {
+            slapi_lock_mutex(current_role->index_lock);
+            entries += current_role->index_count;
+            slapi_unlock_mutex(current_role->index_lock);
+        }
+    }
+    slapi_rwlock_unlock(global_lock);
+
+    slapi_entry_attr_set_ulong(e, "nsRoleIndexHits", slapi_counter_get_value(roles_index_hits));
+    slapi_entry_attr_set_ulong(e, "nsRoleIndexMisses", slapi_counter_get_value(roles_index_misses));
+    slapi_entry_attr_set_int(e, "nsRoleIndexEntries", entries);
+
+    *returncode = LDAP_SUCCESS;
+    return SLAPI_DSE_CALLBACK_OK;
+}
@@ -35,6 +35,11 @@
 
 #define ROLE_SCOPE_DN "nsRoleScopeDN"
 
+/* Role membership index configuration, in the plugin entry */
+#define ROLES_INDEX_ATTR "nsRoleMembershipIndex"
+#define ROLES_INDEX_MAX_ATTR "nsRoleMembershipIndexMaxEntries"
+#define ROLES_INDEX_MAX_ENTRIES 100000
+
 #define SLAPI_ROLE_ERROR_NO_FILTER_SPECIFIED -1
 #define SLAPI_ROLE_ERROR_FILTER_BAD -2
 #define SLAPI_ROLE_DEFINITION_DOESNT_EXIST -3
@@ -42,9 +47,11 @@
 #define SLAPI_ROLE_DEFINITION_ALREADY_EXIST -5
 
 /* From roles_cache.c */
-int roles_cache_init(void);
+int roles_cache_init(const char *plugin_dn);
+void roles_cache_index_config(Slapi_Entry *plugin_entry);
 void roles_cache_stop(void);
 void roles_cache_change_notify(Slapi_PBlock *pb);
+void roles_cache_index_post_op(Slapi_PBlock *pb);
 int roles_cache_listroles(Slapi_Entry *entry, int return_value, Slapi_ValueSet **valueset_out);
 int roles_cache_listroles_ext(vattr_context *c, Slapi_Entry *entry, int return_value, Slapi_ValueSet **valueset_out);
 
@@ -37,6 +37,7 @@ static Slapi_PluginDesc pdesc = {"roles",
 
 static int roles_start(Slapi_PBlock *pb);
 static int roles_post_op(Slapi_PBlock *pb);
+static int roles_index_post_op(Slapi_PBlock *pb);
 static int roles_close(Slapi_PBlock *pb);
 static void roles_set_plugin_identity(void *identity);
 
@@ -96,6 +97,56 @@ roles_internalpostop_init(Slapi_PBlock *pb)
     return rc;
 }
 
+/* roles_index_postop_init
+   -----------------------
+   With the betxn plugin, the post operations run in the transaction. These
+   run once it is committed, to invalidate the updated entries again in
+   the role membership index.
+ */
+int
+roles_index_postop_init(Slapi_PBlock *pb)
+{
+    int rc = 0;
+
+    if (slapi_pblock_set(pb, SLAPI_PLUGIN_VERSION,
+                         SLAPI_PLUGIN_VERSION_01) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_POST_MODIFY_FN,
+                         (void *)roles_index_post_op) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_POST_MODRDN_FN,
+                         (void *)roles_index_post_op) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_POST_ADD_FN,
+                         (void *)roles_index_post_op) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_POST_DELETE_FN,
+                         (void *)roles_index_post_op) != 0) {
+        slapi_log_err(SLAPI_LOG_ERR, ROLES_PLUGIN_SUBSYSTEM,
+                      "roles_index_postop_init - Failed to register plugin\n");
+        rc = -1;
+    }
+    return rc;
+}
+
+int
+roles_index_internalpostop_init(Slapi_PBlock *pb)
+{
+    int rc = 0;
+
+    if (slapi_pblock_set(pb, SLAPI_PLUGIN_VERSION,
+                         SLAPI_PLUGIN_VERSION_01) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_INTERNAL_POST_MODIFY_FN,
+                         (void *)roles_index_post_op) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_INTERNAL_POST_MODRDN_FN,
+                         (void *)roles_index_post_op) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_INTERNAL_POST_ADD_FN,
+                         (void *)roles_index_post_op) != 0 ||
+        slapi_pblock_set(pb, SLAPI_PLUGIN_INTERNAL_POST_DELETE_FN,
+                         (void *)roles_index_post_op) != 0) {
+        slapi_log_err(SLAPI_LOG_ERR, ROLES_PLUGIN_SUBSYSTEM,
+                      "roles_index_internalpostop_init - Failed to register plugin\n");
+        rc = -1;
+    }
+    return rc;
+}
+
 /* roles_init
    ----------
    Initialization of the plugin
@@ -119,6 +170,7 @@ roles_init(Slapi_PBlock *pb)
     if ((slapi_pblock_get(pb, SLAPI_PLUGIN_CONFIG_ENTRY, &plugin_entry) == 0) &&
         plugin_entry) {
         is_betxn = slapi_entry_attr_get_bool(plugin_entry, "nsslapd-pluginbetxn");
+        roles_cache_index_config(plugin_entry);
     }
 
     if (slapi_pblock_set(pb, SLAPI_PLUGIN_VERSION,
@@ -151,6 +203,18 @@ roles_init(Slapi_PBlock *pb)
                                    "roles_internalpostop_init", roles_internalpostop_init,
                                    "Roles internalpostoperation plugin", NULL,
                                    plugin_identity);
+    } else {
+        rc = slapi_register_plugin("postoperation", 1 /* Enabled */,
+                                   "roles_index_postop_init", roles_index_postop_init,
+                                   "Roles index postoperation plugin", NULL,
+                                   plugin_identity);
+        if (rc < 0) {
+            goto bailout;
+        }
+        rc = slapi_register_plugin("internalpostoperation", 1 /* Enabled */,
+                                   "roles_index_internalpostop_init", roles_index_internalpostop_init,
+                                   "Roles index internalpostoperation plugin", NULL,
+                                   plugin_identity);
     }
 bailout:
     slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM,
@@ -163,15 +227,17 @@ bailout:
    kexcoff: cache build at init or at startup ?
  */
 static int
-roles_start(Slapi_PBlock *pb __attribute__((unused)))
+roles_start(Slapi_PBlock *pb)
 {
     int rc = 0;
     void **statechange_api;
+    Slapi_DN *plugin_sdn = NULL;
 
     slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM,
                   "=> roles_start\n");
 
-    roles_cache_init();
+    slapi_pblock_get(pb, SLAPI_TARGET_SDN, &plugin_sdn);
+    roles_cache_init(plugin_sdn ? slapi_sdn_get_dn(plugin_sdn) : NULL);
 
     /* from Pete Rowley for vcache
      * PLUGIN DEPENDENCY ON STATECHANGE PLUGIN
@@ -344,6 +410,17 @@ roles_post_op(Slapi_PBlock *pb)
     return SLAPI_PLUGIN_SUCCESS; /* always succeed */
 }
 
+/* roles_index_post_op
+   -------------------
+   Post operation of the committed updates, with the betxn plugin
+*/
+static int
+roles_index_post_op(Slapi_PBlock *pb)
+{
+    roles_cache_index_post_op(pb);
+    return SLAPI_PLUGIN_SUCCESS; /* always succeed */
+}
+
 static void
 roles_set_plugin_identity(void *identity)
 {
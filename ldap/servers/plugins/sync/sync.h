@@ -19,6 +19,7 @@
 #include "slap.h"
 #include "slapi-plugin.h"
 #include "slapi-private.h"
+#include "plhash.h"
 
 #define PLUGIN_NAME "content-sync-plugin"
 
@@ -30,6 +31,16 @@
 #define SYNC_BE_POSTOP_DESC "content-sync-be-post-subplugin"
 
 #define SYNC_ALLOW_OPENLDAP_COMPAT "syncrepl-allow-openldap"
+#define SYNC_REFRESH_MEMORY_BUDGET "syncrepl-refresh-memory-budget"
+
+/* Memory the refresh phase of a request may use, in bytes. Half of it
+ * bounds the chunk of retro changelog changes read at once, the other
+ * half the set of uniqueids already sent.
+ */
+#define SYNC_REFRESH_DEFAULT_BUDGET (16 * 1024 * 1024)
+/* Estimated size of a Sync_UpdateNode with its strings and index entry */
+#define SYNC_REFRESH_NODE_COST 256
+#define SYNC_REFRESH_MIN_CHUNK 64
 
 #define OP_FLAG_SYNC_PERSIST 0x01
 
@@ -70,6 +81,8 @@ typedef struct sync_callback
     unsigned long change_start;
     int cb_err;
     Sync_UpdateNode *cb_updates;
+    int cb_count;                /* size of cb_updates */
+    PLHashTable *cb_uuid_index;  /* uniqueid -> index + 1 of its first node */
     PRBool openldap_compat;
 } Sync_CallBackData;
 
@@ -115,6 +128,7 @@ op_ext_ident_t * sync_persist_get_operation_extension(Slapi_PBlock *pb);
 void sync_persist_set_operation_extension(Slapi_PBlock *pb, op_ext_ident_t *op_ident);
 
 void sync_register_allow_openldap_compat(PRBool allow);
+void sync_register_refresh_budget(unsigned long budget);
 int sync_register_operation_extension(void);
 int sync_unregister_operation_entension(void);
 
@@ -144,6 +158,7 @@ char *sync_cookie2str(Sync_Cookie *cookie);
 int sync_number2int(char *nrstr);
 unsigned long sync_number2ulong(char *nrstr);
 char *sync_nsuniqueid2uuid(const char *nsuniqueid);
+int sync_nsuniqueid2bin(const char *nsuniqueid, unsigned char *uuid);
 char *sync_entryuuid2uuid(const char *nsuniqueid);
 
 int sync_is_active(Slapi_Entry *e, Slapi_PBlock *pb);
@@ -204,9 +219,26 @@ typedef struct sync_request
     SyncQueueNode *ps_eq_head;
     SyncQueueNode *ps_eq_tail;
     int req_active;
+    struct sync_request_group *req_group; /* subscription of the request */
+    struct sync_request *req_group_next;  /* next member of the subscription */
     struct sync_request *req_next;
 } SyncRequest;
 
+/*
+ * The sync searches sharing the same base, scope and filter.
+ * The scope and the filter of a change are evaluated once per
+ * group, the access control check is done per request.
+ */
+typedef struct sync_request_group
+{
+    char *grp_key;
+    Slapi_DN *grp_base;
+    int grp_scope;
+    Slapi_Filter *grp_filter;
+    SyncRequest *grp_members;
+    struct sync_request_group *grp_next;
+} SyncRequestGroup;
+
 /*
  * A list of established persistent synchronization searches.
  *
@@ -217,6 +249,7 @@ typedef struct sync_request_list
 {
     Slapi_RWLock *sync_req_rwlock; /* R/W lock struct to serialize access */
     SyncRequest *sync_req_head;    /* Head of list */
+    SyncRequestGroup *sync_req_groups; /* Subscriptions, protected by sync_req_rwlock */
     pthread_mutex_t sync_req_cvarlock;    /* Lock for cvar */
     pthread_cond_t sync_req_cvar;         /* ps threads sleep on this */
     int sync_req_max_persist;
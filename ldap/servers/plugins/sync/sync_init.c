@@ -172,6 +172,7 @@ sync_start(Slapi_PBlock *pb)
     char **argv;
     Slapi_Entry *e = NULL;
     PRBool allow_openldap_compat = PR_FALSE;
+    unsigned long refresh_budget = 0;
 
     slapi_register_supported_control(LDAP_CONTROL_SYNC,
                                      SLAPI_OPERATION_SEARCH);
@@ -196,9 +197,11 @@ sync_start(Slapi_PBlock *pb)
                 }
             }
         }
+        refresh_budget = slapi_entry_attr_get_ulong(e, SYNC_REFRESH_MEMORY_BUDGET);
     }
 
     sync_register_allow_openldap_compat(allow_openldap_compat);
+    sync_register_refresh_budget(refresh_budget ? refresh_budget : SYNC_REFRESH_DEFAULT_BUDGET);
 
     if (slapi_pblock_get(pb, SLAPI_PLUGIN_ARGC, &argc) != 0 ||
         slapi_pblock_get(pb, SLAPI_PLUGIN_ARGV, &argv) != 0) {
@@ -32,6 +32,9 @@ static int plugin_closing = 0;
 static PRUint64 thread_count = 0;
 static int sync_add_request(SyncRequest *req);
 static void sync_remove_request(SyncRequest *req);
+static void sync_group_add(SyncRequest *req);
+static void sync_group_remove(SyncRequest *req);
+static void sync_group_free(SyncRequestGroup **grp);
 static SyncRequest *sync_request_alloc(void);
 void sync_queue_change(OPERATION_PL_CTX_T *operation);
 static void sync_send_results(void *arg);
@@ -444,10 +447,9 @@ void
 sync_queue_change(OPERATION_PL_CTX_T *operation)
 {
     SyncRequest *req = NULL;
+    SyncRequestGroup *grp = NULL;
     SyncQueueNode *node = NULL;
     int matched = 0;
-    int prev_match = 0;
-    int cur_match = 0;
     Slapi_Entry *e = operation->entry;
     Slapi_Entry *eprev = operation->eprev;
     ber_int_t chgtype = operation->chgtype;
@@ -463,24 +465,12 @@ sync_queue_change(OPERATION_PL_CTX_T *operation)
 
     SYNC_LOCK_READ();
 
-    for (req = sync_request_list->sync_req_head; NULL != req; req = req->req_next) {
-        Slapi_DN *base = NULL;
-        int scope;
-        Slapi_Operation *op;
-
-        /* Skip the nodes that have no more active operation
-         */
-        slapi_pblock_get(req->req_pblock, SLAPI_OPERATION, &op);
-        if (op == NULL || slapi_op_abandoned(req->req_pblock)) {
-            continue;
-        }
-
-        slapi_pblock_get(req->req_pblock, SLAPI_SEARCH_TARGET_SDN, &base);
-        slapi_pblock_get(req->req_pblock, SLAPI_SEARCH_SCOPE, &scope);
-        if (NULL == base) {
-            base = slapi_sdn_new_dn_byref(req->req_orig_base);
-            slapi_pblock_set(req->req_pblock, SLAPI_SEARCH_TARGET_SDN, base);
-        }
+    for (grp = sync_request_list->sync_req_groups; NULL != grp; grp = grp->grp_next) {
+        Slapi_PBlock *grp_pb = grp->grp_members->req_pblock;
+        int prev_match = 0;
+        int cur_match = 0;
+        int sync_chgtype;
+        Slapi_Entry *sync_entry;
 
         /*
          * See if the entry meets the scope and filter criteria.
@@ -494,42 +484,58 @@ sync_queue_change(OPERATION_PL_CTX_T *operation)
          * to the same pblock" this kind of muti-threaded access
          * to the same pblock must be done carefully--there is currently no
          * generic satisfactory way to do this.
+         * The test is done once for all the requests of the group.
         */
 
         /* if the change is a modrdn then we need to check if the entry was
          * moved into scope, out of scope, or stays in scope
          */
         if (chgtype == LDAP_REQ_MODRDN || chgtype == LDAP_REQ_MODIFY)
-            prev_match = slapi_sdn_scope_test(slapi_entry_get_sdn_const(eprev), base, scope) &&
-                         (0 == slapi_vattr_filter_test(req->req_pblock, eprev, req->req_filter, 0 /* verify_access */));
+            prev_match = slapi_sdn_scope_test(slapi_entry_get_sdn_const(eprev), grp->grp_base, grp->grp_scope) &&
+                         (0 == slapi_vattr_filter_test(grp_pb, eprev, grp->grp_filter, 0 /* verify_access */));
 
-        cur_match = slapi_sdn_scope_test(slapi_entry_get_sdn_const(e), base, scope) &&
-                    (0 == slapi_vattr_filter_test(req->req_pblock, e, req->req_filter, 0 /* verify_access */));
+        cur_match = slapi_sdn_scope_test(slapi_entry_get_sdn_const(e), grp->grp_base, grp->grp_scope) &&
+                    (0 == slapi_vattr_filter_test(grp_pb, e, grp->grp_filter, 0 /* verify_access */));
 
-        if (prev_match || cur_match) {
+        if (!prev_match && !cur_match) {
+            continue;
+        }
+
+        if (chgtype == LDAP_REQ_MODRDN || chgtype == LDAP_REQ_MODIFY) {
+            if (prev_match && cur_match)
+                sync_chgtype = LDAP_REQ_MODIFY;
+            else if (prev_match)
+                sync_chgtype = LDAP_REQ_DELETE;
+            else
+                sync_chgtype = LDAP_REQ_ADD;
+        } else {
+            sync_chgtype = chgtype;
+        }
+        if (sync_chgtype == LDAP_REQ_DELETE && chgtype == LDAP_REQ_MODIFY) {
+            /* use previous entry to pass the filter test in sync_send_results */
+            sync_entry = eprev;
+        } else {
+            sync_entry = e;
+        }
+
+        for (req = grp->grp_members; NULL != req; req = req->req_group_next) {
+            Slapi_Operation *op;
             SyncQueueNode *pOldtail;
 
+            /* Skip the nodes that have no more active operation
+             */
+            slapi_pblock_get(req->req_pblock, SLAPI_OPERATION, &op);
+            if (op == NULL || slapi_op_abandoned(req->req_pblock)) {
+                continue;
+            }
+
             /* The scope and the filter match - enqueue it */
 
             matched++;
             node = (SyncQueueNode *)slapi_ch_calloc(1, sizeof(SyncQueueNode));
+            node->sync_chgtype = sync_chgtype;
+            node->sync_entry = slapi_entry_dup(sync_entry);
 
-            if (chgtype == LDAP_REQ_MODRDN || chgtype == LDAP_REQ_MODIFY) {
-                if (prev_match && cur_match)
-                    node->sync_chgtype = LDAP_REQ_MODIFY;
-                else if (prev_match)
-                    node->sync_chgtype = LDAP_REQ_DELETE;
-                else
-                    node->sync_chgtype = LDAP_REQ_ADD;
-            } else {
-                node->sync_chgtype = chgtype;
-            }
-            if (node->sync_chgtype == LDAP_REQ_DELETE && chgtype == LDAP_REQ_MODIFY) {
-                /* use previous entry to pass the filter test in sync_send_results */
-                node->sync_entry = slapi_entry_dup(eprev);
-            } else {
-                node->sync_entry = slapi_entry_dup(e);
-            }
             /* Put it on the end of the list for this sync search */
             PR_Lock(req->req_lock);
             pOldtail = req->ps_eq_tail;
@@ -540,8 +546,8 @@ sync_queue_change(OPERATION_PL_CTX_T *operation)
                 pOldtail->sync_next = req->ps_eq_tail;
             }
             slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_queue_change - entry "
-                                                              "\"%s\" \n",
-                      slapi_entry_get_dn_const(node->sync_entry));
+                                                                  "\"%s\" \n",
+                          slapi_entry_get_dn_const(node->sync_entry));
             PR_Unlock(req->req_lock);
         }
     }
@@ -760,6 +766,11 @@ sync_persist_terminate_all()
             req->req_lock = NULL;
             slapi_ch_free((void **)&req);
         }
+        while (sync_request_list->sync_req_groups) {
+            SyncRequestGroup *grp = sync_request_list->sync_req_groups;
+            sync_request_list->sync_req_groups = grp->grp_next;
+            sync_group_free(&grp);
+        }
         slapi_ch_free((void **)&sync_request_list);
     }
 
@@ -806,6 +817,7 @@ sync_add_request(SyncRequest *req)
             sync_request_list->sync_req_cur_persist++;
             req->req_next = sync_request_list->sync_req_head;
             sync_request_list->sync_req_head = req;
+            sync_group_add(req);
         } else {
             rc = 1;
         }
@@ -843,6 +855,7 @@ sync_remove_request(SyncRequest *req)
         }
         if (removed) {
             sync_request_list->sync_req_cur_persist--;
+            sync_group_remove(req);
         }
         SYNC_UNLOCK_WRITE();
         if (!removed) {
@@ -852,6 +865,98 @@ sync_remove_request(SyncRequest *req)
     }
 }
 
+/*
+ * Add the request to the group of requests with the same
+ * base, scope and filter, creating the group if needed.
+ * Called with the request list write locked.
+ */
+static void
+sync_group_add(SyncRequest *req)
+{
+    SyncRequestGroup *grp;
+    Slapi_DN *base;
+    char *fstr = NULL;
+    char *key;
+    int scope = 0;
+
+    slapi_pblock_get(req->req_pblock, SLAPI_SEARCH_SCOPE, &scope);
+    slapi_pblock_get(req->req_pblock, SLAPI_SEARCH_STRFILTER, &fstr);
+    base = slapi_sdn_new_dn_byval(req->req_orig_base);
+    if (fstr) {
+        key = slapi_ch_smprintf("%d:%s:%s", scope, slapi_sdn_get_ndn(base), fstr);
+    } else {
+        /* no string filter to compare, the request gets its own group */
+        key = slapi_ch_smprintf("%d:%s:%p", scope, slapi_sdn_get_ndn(base), req);
+    }
+
+    for (grp = sync_request_list->sync_req_groups; NULL != grp; grp = grp->grp_next) {
+        if (strcmp(grp->grp_key, key) == 0) {
+            break;
+        }
+    }
+    if (NULL == grp) {
+        grp = (SyncRequestGroup *)slapi_ch_calloc(1, sizeof(SyncRequestGroup));
+        grp->grp_key = key;
+        grp->grp_base = base;
+        grp->grp_scope = scope;
+        grp->grp_filter = slapi_filter_dup(req->req_filter);
+        grp->grp_next = sync_request_list->sync_req_groups;
+        sync_request_list->sync_req_groups = grp;
+    } else {
+        slapi_ch_free_string(&key);
+        slapi_sdn_free(&base);
+    }
+    req->req_group_next = grp->grp_members;
+    grp->grp_members = req;
+    req->req_group = grp;
+}
+
+/*
+ * Remove the request from its group, freeing the group
+ * when it was the last member.
+ * Called with the request list write locked.
+ */
+static void
+sync_group_remove(SyncRequest *req)
+{
+    SyncRequestGroup *grp = req->req_group;
+    SyncRequestGroup **grpp;
+    SyncRequest **reqp;
+
+    if (NULL == grp) {
+        return;
+    }
+    for (reqp = &grp->grp_members; NULL != *reqp; reqp = &(*reqp)->req_group_next) {
+        if (*reqp == req) {
+            *reqp = req->req_group_next;
+            break;
+        }
+    }
+    req->req_group = NULL;
+    req->req_group_next = NULL;
+
+    if (NULL == grp->grp_members) {
+        for (grpp = &sync_request_list->sync_req_groups; NULL != *grpp; grpp = &(*grpp)->grp_next) {
+            if (*grpp == grp) {
+                *grpp = grp->grp_next;
+                break;
+            }
+        }
+        sync_group_free(&grp);
+    }
+}
+
+static void
+sync_group_free(SyncRequestGroup **grp)
+{
+    if (grp != NULL && *grp != NULL) {
+        slapi_ch_free_string(&(*grp)->grp_key);
+        slapi_sdn_free(&(*grp)->grp_base);
+        slapi_filter_free((*grp)->grp_filter, 1);
+        slapi_ch_free((void **)grp);
+    }
+}
+
 static void
 sync_request_wakeup_all(void)
 {
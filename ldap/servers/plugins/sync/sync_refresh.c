@@ -13,10 +13,26 @@ static SyncOpInfo *new_SyncOpInfo(int flag, PRThread *tid, Sync_Cookie *cookie);
 static int sync_extension_type;
 static int sync_extension_handle;
 static PRBool allow_openldap_compat;
+static unsigned long refresh_budget = SYNC_REFRESH_DEFAULT_BUDGET;
+
+/* Compact set of the binary uniqueids of the entries sent during the
+ * refresh phase: open addressing with linear probing, an all zero
+ * uniqueid marks a free slot.
+ */
+typedef unsigned char Sync_Uuid[16];
+
+typedef struct sync_uuid_set
+{
+    Sync_Uuid *slots;
+    size_t size; /* number of slots, a power of 2 */
+    size_t count;
+    size_t max_size;
+} Sync_UuidSet;
 
 static SyncOpInfo *sync_get_operation_extension(Slapi_PBlock *pb);
 static void sync_set_operation_extension(Slapi_PBlock *pb, SyncOpInfo *spec);
-static int sync_find_ref_by_uuid(Sync_UpdateNode *updates, int stop, char *uniqueid);
+static int sync_find_ref_by_uuid(Sync_CallBackData *cb, char *uniqueid);
+static void sync_set_update_node(Sync_CallBackData *cb, int index, int chgtype, char *uniqueid, char *entryuuid);
 static void sync_free_update_nodes(Sync_UpdateNode **updates, int count);
 Slapi_Entry *sync_deleted_entry_from_changelog(Slapi_Entry *cl_entry);
 static int sync_feature_allowed(Slapi_PBlock *pb);
@@ -309,64 +325,174 @@ sync_free_update_nodes(Sync_UpdateNode **updates, int count)
     slapi_ch_free((void **)updates);
 }
 
-int
-sync_refresh_update_content(Slapi_PBlock *pb, Sync_Cookie *client_cookie, Sync_Cookie *server_cookie)
+static size_t
+sync_uuid_hash(const unsigned char *uuid)
 {
-    Slapi_PBlock *seq_pb;
-    char *filter;
-    Sync_CallBackData cb_data;
-    int rc = LDAP_SUCCESS;
-    PR_ASSERT(client_cookie);
+    uint64_t a, b;
+
+    memcpy(&a, uuid, sizeof(a));
+    memcpy(&b, uuid + 8, sizeof(b));
+    a ^= b * 0x9E3779B97F4A7C15ULL;
+    a ^= a >> 31;
+    a *= 0xBF58476D1CE4E5B9ULL;
+    a ^= a >> 29;
+    return (size_t)a;
+}
 
-    /*
-     * We have nothing to send, move along.
-     * Should be caught by cookie is valid though if the server < client, but if
-     * they are equal, we return.
-     */
-    PR_ASSERT(server_cookie->cookie_change_info >= client_cookie->cookie_change_info);
-    if (server_cookie->cookie_change_info == client_cookie->cookie_change_info) {
-        return rc;
+static int
+sync_uuid_is_free(const unsigned char *uuid)
+{
+    static const unsigned char free_slot[16] = {0};
+
+    return (memcmp(uuid, free_slot, sizeof(free_slot)) == 0);
+}
+
+static void
+sync_uuidset_init(Sync_UuidSet *set, unsigned long budget)
+{
+    set->max_size = 1024;
+    while (set->max_size * 2 * sizeof(Sync_Uuid) <= budget / 2) {
+        set->max_size *= 2;
     }
+    set->size = 1024;
+    set->count = 0;
+    set->slots = (Sync_Uuid *)slapi_ch_calloc(set->size, sizeof(Sync_Uuid));
+}
 
-    int chg_count = (server_cookie->cookie_change_info - client_cookie->cookie_change_info) + 1;
-    PR_ASSERT(chg_count > 0);
+static void
+sync_uuidset_done(Sync_UuidSet *set)
+{
+    slapi_ch_free((void **)&set->slots);
+    set->size = set->count = 0;
+}
 
-    cb_data.cb_updates = (Sync_UpdateNode *)slapi_ch_calloc(chg_count, sizeof(Sync_UpdateNode));
+static void
+sync_uuidset_insert(Sync_UuidSet *set, const unsigned char *uuid)
+{
+    size_t mask = set->size - 1;
+    size_t i;
 
-    seq_pb = slapi_pblock_new();
-    slapi_pblock_init(seq_pb);
+    for (i = sync_uuid_hash(uuid) & mask; !sync_uuid_is_free(set->slots[i]); i = (i + 1) & mask)
+        ;
+    memcpy(set->slots[i], uuid, sizeof(Sync_Uuid));
+    set->count++;
+}
+
+/*
+ * Add a uniqueid to the set, it is kept at most half full.
+ * When it cannot grow within the budget it is emptied, the
+ * entries sent before may then be sent again.
+ * return 1: the uniqueid was already in the set
+ * return 0: it has been added
+ */
+static int
+sync_uuidset_add(Sync_UuidSet *set, const unsigned char *uuid)
+{
+    size_t mask = set->size - 1;
+    size_t i;
 
+    if (sync_uuid_is_free(uuid)) {
+        return (0);
+    }
+    for (i = sync_uuid_hash(uuid) & mask; !sync_uuid_is_free(set->slots[i]); i = (i + 1) & mask) {
+        if (memcmp(set->slots[i], uuid, sizeof(Sync_Uuid)) == 0) {
+            return (1);
+        }
+    }
+    if ((set->count + 1) * 2 > set->size) {
+        if (set->size < set->max_size) {
+            Sync_Uuid *old_slots = set->slots;
+            size_t old_size = set->size;
+
+            set->size *= 2;
+            set->count = 0;
+            set->slots = (Sync_Uuid *)slapi_ch_calloc(set->size, sizeof(Sync_Uuid));
+            for (i = 0; i < old_size; i++) {
+                if (!sync_uuid_is_free(old_slots[i])) {
+                    sync_uuidset_insert(set, old_slots[i]);
+                }
+            }
+            slapi_ch_free((void **)&old_slots);
+        } else {
+            slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM,
+                          "sync_uuidset_add - %lu uniqueids sent, refresh memory budget reached\n",
+                          (unsigned long)set->count);
+            memset(set->slots, 0, set->size * sizeof(Sync_Uuid));
+            set->count = 0;
+        }
+        sync_uuidset_insert(set, uuid);
+        return (0);
+    }
+    memcpy(set->slots[i], uuid, sizeof(Sync_Uuid));
+    set->count++;
+    return (0);
+}
+
+/*
+ * Remove a uniqueid from the set. The slots following it in its probe
+ * sequence are moved back, so the lookups never stop on the hole.
+ */
+static void
+sync_uuidset_remove(Sync_UuidSet *set, const unsigned char *uuid)
+{
+    size_t mask = set->size - 1;
+    size_t i, j;
+
+    if (sync_uuid_is_free(uuid)) {
+        return;
+    }
+    for (i = sync_uuid_hash(uuid) & mask; memcmp(set->slots[i], uuid, sizeof(Sync_Uuid)) != 0; i = (i + 1) & mask) {
+        if (sync_uuid_is_free(set->slots[i])) {
+            return;
+        }
+    }
+    for (j = (i + 1) & mask; !sync_uuid_is_free(set->slots[j]); j = (j + 1) & mask) {
+        size_t home = sync_uuid_hash(set->slots[j]) & mask;
+
+        /* the slot j can move to i unless its home is in (i, j] */
+        if ((i < j) ? (home <= i || home > j) : (home <= i && home > j)) {
+            memcpy(set->slots[i], set->slots[j], sizeof(Sync_Uuid));
+            i = j;
+        }
+    }
+    memset(set->slots[i], 0, sizeof(Sync_Uuid));
+    set->count--;
+}
+
+/*
+ * Read the changes [first, last] of the retro changelog and send them.
+ * The entries sent for a previous chunk are not sent again, they were
+ * read from the database after these changes were applied. A deleted
+ * entry leaves the set: if its uniqueid comes back in a later chunk,
+ * the entry has to be sent again after the delete.
+ */
+static int
+sync_refresh_update_chunk(Slapi_PBlock *pb, Sync_Cookie *server_cookie, unsigned long first, unsigned long last, Sync_UuidSet *sent)
+{
+    Slapi_PBlock *seq_pb;
+    char *filter;
+    Sync_CallBackData cb_data = {0};
+    int chg_count = (int)(last - first + 1);
+    int rc;
+
+    cb_data.cb_updates = (Sync_UpdateNode *)slapi_ch_calloc(chg_count, sizeof(Sync_UpdateNode));
+    cb_data.cb_count = chg_count;
+    cb_data.cb_uuid_index = PL_NewHashTable(0, PL_HashString, PL_CompareStrings,
+                                            PL_CompareValues, NULL, NULL);
     cb_data.orig_pb = pb;
-    cb_data.change_start = client_cookie->cookie_change_info;
+    cb_data.change_start = first;
     cb_data.openldap_compat = server_cookie->openldap_compat;
 
-    /*
-     * The client has already seen up to AND including change_info, so this should
-     * should reflect that. originally was:
-     *
-     *  filter = slapi_ch_smprintf("(&(changenumber>=%lu)(changenumber<=%lu))",
-     *                             client_cookie->cookie_change_info,
-     *                             server_cookie->cookie_change_info);
-     *
-     * which would create a situation where if the previous cn was say 5, and the next
-     * is 6, we'd get both 5 and 6, even though the client has already seen 5. But worse
-     * if 5 was an "add" of the entry, and 6 was a "delete" of the same entry then sync
-     * would over-optimise and remove the sync value because it things the add/delete was
-     * in the same operation so we'd never send it. But the client HAD seen the add, and
-     * now we'd never send the delete so this would be a bug. This created some confusion
-     * for me in the tests, but the sync repl tests now correctly work and reflect the behaviour
-     * expected.
-     */
     if (server_cookie->openldap_compat) {
         /* In openldap compat we only want items that have an entryuuid, else we can't sync them */
         filter = slapi_ch_smprintf("(&(changenumber>=%lu)(changenumber<=%lu)(" CL_ATTR_ENTRYUUID "=*))",
-                                   client_cookie->cookie_change_info + 1,
-                                   server_cookie->cookie_change_info);
+                                   first, last);
     } else {
         filter = slapi_ch_smprintf("(&(changenumber>=%lu)(changenumber<=%lu))",
-                                   client_cookie->cookie_change_info + 1,
-                                   server_cookie->cookie_change_info);
+                                   first, last);
     }
+    seq_pb = slapi_pblock_new();
+    slapi_pblock_init(seq_pb);
     slapi_search_internal_set_pb(
         seq_pb,
         CL_SRCH_BASE,
@@ -381,6 +507,22 @@ sync_refresh_update_content(Slapi_PBlock *pb, Sync_Cookie *client_cookie, Sync_C
     rc = slapi_search_internal_callback_pb(
         seq_pb, &cb_data, NULL, sync_read_entry_from_changelog, NULL);
     slapi_pblock_destroy(seq_pb);
+    PL_HashTableDestroy(cb_data.cb_uuid_index);
+
+    for (int index = 0; index < chg_count; index++) {
+        Sync_UpdateNode *upd = &cb_data.cb_updates[index];
+        unsigned char uuid[16];
+
+        if ((upd->upd_uuid == NULL) || (sync_nsuniqueid2bin(upd->upd_uuid, uuid) != 0)) {
+            continue;
+        }
+        if (upd->upd_chgtype == LDAP_REQ_DELETE) {
+            sync_uuidset_remove(sent, uuid);
+        } else if (sync_uuidset_add(sent, uuid)) {
+            slapi_ch_free_string(&upd->upd_uuid);
+            slapi_ch_free_string(&upd->upd_euuid);
+        }
+    }
 
     /* Now send the deleted entries in a sync info message
      * and the modified entries as single entries
@@ -393,6 +535,70 @@ sync_refresh_update_content(Slapi_PBlock *pb, Sync_Cookie *client_cookie, Sync_C
     return (rc);
 }
 
+int
+sync_refresh_update_content(Slapi_PBlock *pb, Sync_Cookie *client_cookie, Sync_Cookie *server_cookie)
+{
+    Sync_UuidSet sent;
+    unsigned long chunk_size;
+    unsigned long first;
+    unsigned long last;
+    int rc = LDAP_SUCCESS;
+    PR_ASSERT(client_cookie);
+
+    /*
+     * We have nothing to send, move along.
+     * Should be caught by cookie is valid though if the server < client, but if
+     * they are equal, we return.
+     */
+    PR_ASSERT(server_cookie->cookie_change_info >= client_cookie->cookie_change_info);
+    if (server_cookie->cookie_change_info == client_cookie->cookie_change_info) {
+        return rc;
+    }
+
+    /*
+     * The changes are read and sent in chunks so that a client far behind
+     * does not need all of them in memory at once.
+     */
+    chunk_size = (refresh_budget / 2) / SYNC_REFRESH_NODE_COST;
+    if (chunk_size < SYNC_REFRESH_MIN_CHUNK) {
+        chunk_size = SYNC_REFRESH_MIN_CHUNK;
+    }
+    sync_uuidset_init(&sent, refresh_budget);
+
+    /*
+     * The client has already seen up to AND including change_info, so this should
+     * should reflect that. originally was:
+     *
+     *  filter = slapi_ch_smprintf("(&(changenumber>=%lu)(changenumber<=%lu))",
+     *                             client_cookie->cookie_change_info,
+     *                             server_cookie->cookie_change_info);
+     *
+     * which would create a situation where if the previous cn was say 5, and the next
+     * is 6, we'd get both 5 and 6, even though the client has already seen 5. But worse
+     * if 5 was an "add" of the entry, and 6 was a "delete" of the same entry then sync
+     * would over-optimise and remove the sync value because it things the add/delete was
+     * in the same operation so we'd never send it. But the client HAD seen the add, and
+     * now we'd never send the delete so this would be a bug. This created some confusion
+     * for me in the tests, but the sync repl tests now correctly work and reflect the behaviour
+     * expected.
+     */
+    for (first = client_cookie->cookie_change_info + 1;
+         (rc == LDAP_SUCCESS) && (first <= server_cookie->cookie_change_info);
+         first = last + 1) {
+        last = server_cookie->cookie_change_info;
+        if (last - first >= chunk_size) {
+            last = first + chunk_size - 1;
+        }
+        if (slapi_op_abandoned(pb)) {
+            break;
+        }
+        rc = sync_refresh_update_chunk(pb, server_cookie, first, last, &sent);
+    }
+
+    sync_uuidset_done(&sent);
+    return (rc);
+}
+
 int
 sync_refresh_initial_content(Slapi_PBlock *pb, int sync_persist, PRThread *tid, Sync_Cookie *sc)
 {
@@ -492,18 +698,24 @@ sync_get_attr_value_from_entry(Slapi_Entry *cl_entry, char *attrtype)
     return (strvalue);
 }
 
+/* Index of the first update node of the chunk for that uniqueid, -1 if none */
 static int
-sync_find_ref_by_uuid(Sync_UpdateNode *updates, int stop, char *uniqueid)
+sync_find_ref_by_uuid(Sync_CallBackData *cb, char *uniqueid)
 {
-    int rc = -1;
-    int i;
-    for (i = 0; i < stop; i++) {
-        if (updates[i].upd_uuid && (0 == strcmp(uniqueid, updates[i].upd_uuid))) {
-            rc = i;
-            break;
-        }
+    intptr_t ref = (intptr_t)PL_HashTableLookup(cb->cb_uuid_index, uniqueid);
+
+    return ((int)ref - 1);
+}
+
+static void
+sync_set_update_node(Sync_CallBackData *cb, int index, int chgtype, char *uniqueid, char *entryuuid)
+{
+    cb->cb_updates[index].upd_chgtype = chgtype;
+    cb->cb_updates[index].upd_uuid = uniqueid;
+    cb->cb_updates[index].upd_euuid = entryuuid;
+    if (PL_HashTableLookup(cb->cb_uuid_index, uniqueid) == NULL) {
+        PL_HashTableAdd(cb->cb_uuid_index, uniqueid, (void *)(intptr_t)(index + 1));
     }
-    return (rc);
 }
 
 static int
@@ -588,10 +800,10 @@ sync_read_entry_from_changelog(Slapi_Entry *cl_entry, void *cb_data)
         slapi_ch_free_string(&entryuuid);
         return (1);
     }
-    if (chgnum < cb->change_start) {
+    if ((chgnum < cb->change_start) || (chgnum - cb->change_start >= (unsigned long)cb->cb_count)) {
         slapi_log_err(SLAPI_LOG_ERR, SYNC_PLUGIN_SUBSYSTEM,
                       "sync_read_entry_from_changelog - "
-                      "Change number provided by Retro Changelog %s is less than the initial number %lu\n",
+                      "Change number provided by Retro Changelog %s is out of the range starting at %lu\n",
                       chgnr, cb->change_start);
         slapi_ch_free_string(&chgnr);
         slapi_ch_free_string(&uniqueid);
@@ -605,18 +817,14 @@ sync_read_entry_from_changelog(Slapi_Entry *cl_entry, void *cb_data)
     case LDAP_REQ_ADD:
         slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_ADD\n", uniqueid);
         /* nsuniqueid cannot exist, just add reference */
-        cb->cb_updates[index].upd_chgtype = LDAP_REQ_ADD;
-        cb->cb_updates[index].upd_uuid = uniqueid;
-        cb->cb_updates[index].upd_euuid = entryuuid;
+        sync_set_update_node(cb, index, LDAP_REQ_ADD, uniqueid, entryuuid);
         break;
     case LDAP_REQ_MODIFY:
         /* check if we have seen this uuid already */
-        prev = sync_find_ref_by_uuid(cb->cb_updates, index, uniqueid);
+        prev = sync_find_ref_by_uuid(cb, uniqueid);
         if (prev == -1) {
             slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODIFY\n", uniqueid);
-            cb->cb_updates[index].upd_chgtype = LDAP_REQ_MODIFY;
-            cb->cb_updates[index].upd_uuid = uniqueid;
-            cb->cb_updates[index].upd_euuid = entryuuid;
+            sync_set_update_node(cb, index, LDAP_REQ_MODIFY, uniqueid, entryuuid);
         } else {
             /* was add or mod, keep it */
             slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODIFY (already queued)\n", uniqueid);
@@ -654,14 +862,12 @@ sync_read_entry_from_changelog(Slapi_Entry *cl_entry, void *cb_data)
             /* scope didn't change */
             new_scope = old_scope;
         }
-        prev = sync_find_ref_by_uuid(cb->cb_updates, index, uniqueid);
+        prev = sync_find_ref_by_uuid(cb, uniqueid);
         if (old_scope && new_scope) {
             /* nothing changed, it's just a MOD */
             if (prev == -1) {
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODRDN\n", uniqueid);
-                cb->cb_updates[index].upd_chgtype = LDAP_REQ_MODIFY;
-                cb->cb_updates[index].upd_uuid = uniqueid;
-                cb->cb_updates[index].upd_euuid = entryuuid;
+                sync_set_update_node(cb, index, LDAP_REQ_MODIFY, uniqueid, entryuuid);
             } else {
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODRDN (already queued)\n", uniqueid);
                 cb->cb_updates[index].upd_uuid = NULL;
@@ -674,9 +880,7 @@ sync_read_entry_from_changelog(Slapi_Entry *cl_entry, void *cb_data)
             /* it was moved out of scope, handle as DEL */
             if (prev == -1) {
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODRDN -> LDAP_REQ_DELETE\n", uniqueid);
-                cb->cb_updates[index].upd_chgtype = LDAP_REQ_DELETE;
-                cb->cb_updates[index].upd_uuid = uniqueid;
-                cb->cb_updates[index].upd_euuid = entryuuid;
+                sync_set_update_node(cb, index, LDAP_REQ_DELETE, uniqueid, entryuuid);
                 cb->cb_updates[index].upd_e = sync_deleted_entry_from_changelog(cl_entry);
             } else {
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODRDN -> LDAP_REQ_DELETE (already queued)\n", uniqueid);
@@ -688,9 +892,7 @@ sync_read_entry_from_changelog(Slapi_Entry *cl_entry, void *cb_data)
         } else if (new_scope) {
             /* moved into scope, handle as ADD */
             slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODRDN -> LDAP_REQ_ADD\n", uniqueid);
-            cb->cb_updates[index].upd_chgtype = LDAP_REQ_ADD;
-            cb->cb_updates[index].upd_uuid = uniqueid;
-            cb->cb_updates[index].upd_euuid = entryuuid;
+            sync_set_update_node(cb, index, LDAP_REQ_ADD, uniqueid, entryuuid);
         } else {
             /* nothing to do */
             slapi_ch_free_string(&uniqueid);
@@ -701,21 +903,19 @@ sync_read_entry_from_changelog(Slapi_Entry *cl_entry, void *cb_data)
     }
     case LDAP_REQ_DELETE:
         /* check if we have seen this uuid already */
-        prev = sync_find_ref_by_uuid(cb->cb_updates, index, uniqueid);
+        prev = sync_find_ref_by_uuid(cb, uniqueid);
         if (prev == -1) {
             slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_DELETE\n", uniqueid);
-            cb->cb_updates[index].upd_chgtype = LDAP_REQ_DELETE;
-            cb->cb_updates[index].upd_uuid = uniqueid;
-            cb->cb_updates[index].upd_euuid = entryuuid;
+            sync_set_update_node(cb, index, LDAP_REQ_DELETE, uniqueid, entryuuid);
             cb->cb_updates[index].upd_e = sync_deleted_entry_from_changelog(cl_entry);
         } else {
             /* if it was added since last cookie state, we
              * can ignore it */
             if (cb->cb_updates[prev].upd_chgtype == LDAP_REQ_ADD) {
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_DELETE -> NO-OP\n", uniqueid);
+                PL_HashTableRemove(cb->cb_uuid_index, cb->cb_updates[prev].upd_uuid);
                 slapi_ch_free_string(&(cb->cb_updates[prev].upd_uuid));
-                cb->cb_updates[prev].upd_uuid = NULL;
-                cb->cb_updates[prev].upd_euuid = NULL;
+                slapi_ch_free_string(&(cb->cb_updates[prev].upd_euuid));
                 cb->cb_updates[index].upd_uuid = NULL;
                 cb->cb_updates[index].upd_euuid = NULL;
             } else {
@@ -914,6 +1114,12 @@ sync_register_allow_openldap_compat(PRBool allow)
     allow_openldap_compat = allow;
 }
 
+void
+sync_register_refresh_budget(unsigned long budget)
+{
+    refresh_budget = budget;
+}
+
 int
 sync_register_operation_extension(void)
 {
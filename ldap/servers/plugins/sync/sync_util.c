@@ -8,6 +8,7 @@
 
 #include "sync.h"
 #include "slap.h"  /* for LDAP_TAG_SK_REVERSE */
+#include "retrocl_api.h"
 
 static struct berval *create_syncinfo_value(int type, const char *cookie, struct berval **uuids);
 static char *sync_cookie_get_server_info(Slapi_PBlock *pb);
@@ -111,11 +112,18 @@ sync_entryuuid2uuid(const char *entryuuid)
     return (uuid);
 }
 
-char *
-sync_nsuniqueid2uuid(const char *nsuniqueid)
+/*
+ * Convert a nsuniqueid (xxxxxxxx-xxxxxxxx-xxxxxxxx-xxxxxxxx) to its
+ * 16 bytes binary form
+ * return 0: OK
+ * return -1: the value is not a nsuniqueid
+ */
+int
+sync_nsuniqueid2bin(const char *nsuniqueid, unsigned char *u)
 {
-    char *uuid;
-    char u[17];
+    if (strlen(nsuniqueid) < 35) {
+        return (-1);
+    }
 
     u[0] = slapi_str_to_u8(nsuniqueid);
     u[1] = slapi_str_to_u8(nsuniqueid + 2);
@@ -137,7 +145,16 @@ sync_nsuniqueid2uuid(const char *nsuniqueid)
     u[14] = slapi_str_to_u8(nsuniqueid + 31);
     u[15] = slapi_str_to_u8(nsuniqueid + 33);
 
-    u[16] = '\0';
+    return (0);
+}
+
+char *
+sync_nsuniqueid2uuid(const char *nsuniqueid)
+{
+    char *uuid;
+    char u[17] = {0};
+
+    sync_nsuniqueid2bin(nsuniqueid, (unsigned char *)u);
 
     uuid = slapi_ch_malloc(sizeof(u));
     memcpy(uuid, u, sizeof(u));
@@ -555,13 +572,19 @@ sync_cookie_get_change_number(int lastnr, const char *uniqueid)
     slapi_pblock_get(srch_pb, SLAPI_PLUGIN_INTOP_RESULT, &rv);
     if (rv == LDAP_SUCCESS) {
         slapi_pblock_get(srch_pb, SLAPI_PLUGIN_INTOP_SEARCH_ENTRIES, &entries);
-        if (entries && *entries) {
+        /* the sort is ignored when the compact changelog serves the search,
+         * so do not rely on the last change coming first */
+        for (size_t i = 0; entries && entries[i]; i++) {
             Slapi_Attr *attr;
             Slapi_Value *val;
-            cl_entry = *entries; /* only use teh first one */
+            unsigned long nr;
+            cl_entry = entries[i];
             slapi_entry_attr_find(cl_entry, CL_ATTR_CHANGENUMBER, &attr);
             slapi_attr_first_value(attr, &val);
-            newnr = sync_number2ulong((char *)slapi_value_get_string(val));
+            nr = sync_number2ulong((char *)slapi_value_get_string(val));
+            if (nr != SYNC_INVALID_CHANGENUM && (newnr == SYNC_INVALID_CHANGENUM || nr > newnr)) {
+                newnr = nr;
+            }
         }
 #if DEBUG
         slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_cookie_get_change_number looks for \"%s\"\n",
@@ -595,8 +618,21 @@ sync_cookie_get_change_info(Sync_CallBackData *scbd)
     Slapi_PBlock *seq_pb;
     char *base;
     char *attrname;
+    void **compact_api = NULL;
     int rc;
 
+    /* the compact changelog is not in the backend a seq search reads */
+    if (slapi_apib_get_interface(RetroCLCompact_v1_0_GUID, &compact_api) == 0) {
+        unsigned long last = 0;
+
+        retrocl_api_compact_bounds(compact_api, NULL, &last);
+        if (last) {
+            scbd->changenr = last;
+            scbd->cb_err = 0;
+        }
+        return (0);
+    }
+
     base = slapi_ch_strdup("cn=changelog");
     attrname = slapi_ch_strdup("changenumber");
 
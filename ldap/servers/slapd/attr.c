@@ -315,6 +315,7 @@ slapi_attr_init_locking_optional(Slapi_Attr *a, const char *type, PRBool use_loc
         }
         if (NULL == asi) {
             a->a_type = attr_syntax_normalize_no_lookup(type);
+            a->a_type_handle = 0;
             /*
              * no syntax for this type... return Octet String
              * syntax.  we accomplish this by looking up a well known
@@ -331,6 +332,7 @@ slapi_attr_init_locking_optional(Slapi_Attr *a, const char *type, PRBool use_loc
 
             if (NULL == attroptions) {
                 a->a_type = slapi_ch_strdup(asi->asi_name);
+                a->a_type_handle = asi->asi_handle;
             } else {
                 /*
                  * If the original type includes any attribute options,
@@ -342,6 +344,7 @@ slapi_attr_init_locking_optional(Slapi_Attr *a, const char *type, PRBool use_loc
 
                 normalized_options = attr_syntax_normalize_no_lookup(attroptions);
                 a->a_type = slapi_ch_smprintf("%s%s", asi->asi_name, normalized_options);
+                a->a_type_handle = 0;
                 slapi_ch_free_string(&normalized_options);
             }
         }
@@ -379,6 +382,7 @@ slapi_attr_init_nosyntax(Slapi_Attr *a, const char *type)
 {
 
     a->a_type = slapi_ch_strdup(type);
+    a->a_type_handle = attr_syntax_type_handle(type);
     slapi_valueset_init(&a->a_present_values);
     slapi_valueset_init(&a->a_deleted_values);
     a->a_listtofree = NULL;
@@ -416,6 +420,7 @@ attr_done(Slapi_Attr *a)
 {
     if (a != NULL) {
         slapi_ch_free((void **)&a->a_type);
+        a->a_type_handle = 0;
         csn_free(&a->a_deletioncsn);
         slapi_valueset_done(&a->a_present_values);
         slapi_valueset_done(&a->a_deleted_values);
@@ -795,6 +800,7 @@ slapi_attr_set_type(Slapi_Attr *a, const char *type)
     } else {
         slapi_ch_free_string(&a->a_type);
         a->a_type = slapi_ch_strdup(type);
+        a->a_type_handle = attr_syntax_type_handle(type);
     }
     return rc;
 }
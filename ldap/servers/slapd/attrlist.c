@@ -41,8 +41,14 @@ attrlist_find_or_create_locking_optional(Slapi_Attr **alist, const char *type, S
 {
     int rc = 0; /* found */
     if (*a == NULL) {
+        uint32_t handle = attr_syntax_type_handle(type);
+
         for (*a = alist; **a != NULL; *a = &(**a)->a_next) {
-            if (strcasecmp((**a)->a_type, type) == 0) {
+            if (handle && (**a)->a_type_handle) {
+                if (handle == (**a)->a_type_handle) {
+                    break;
+                }
+            } else if (strcasecmp((**a)->a_type, type) == 0) {
                 break;
             }
         }
@@ -103,13 +109,22 @@ attrlist_merge_valuearray(Slapi_Attr **alist, const char *type, Slapi_Value **va
 
 /*
  * attrlist_find - find and return attribute type in list a
+ *
+ * When the type is a schema name, the attributes with a handle are
+ * compared by handle, the others by name.
  */
 
 Slapi_Attr *
 attrlist_find(Slapi_Attr *a, const char *type)
 {
+    uint32_t handle = attr_syntax_type_handle(type);
+
     for (; a != NULL; a = a->a_next) {
-        if (strcasecmp(a->a_type, type) == 0) {
+        if (handle && a->a_type_handle) {
+            if (handle == a->a_type_handle) {
+                return (a);
+            }
+        } else if (strcasecmp(a->a_type, type) == 0) {
             return (a);
         }
     }
@@ -128,6 +128,146 @@ attr_syntax_unlock_write(void)
     AS_UNLOCK_WRITE(oid2asi_lock);
 }
 
+/*
+ * Interned attribute type names.
+ *
+ * Every name and alias of the schema attribute types gets a small integer
+ * handle. Two names with a handle are equal (ignoring case) if and only
+ * if their handles are equal, so the handles cached in Slapi_Attr and in
+ * the filters turn the type compares of the hot paths into integer
+ * compares. 0 is the handle of the names that are not interned: unknown
+ * types and types with options, for which the callers keep the string
+ * compares.
+ *
+ * The names are never removed, so a handle stays valid across schema
+ * reloads. The lookups don't take any lock: the table is open addressed
+ * and only grows, a slot is published by storing its handle last, and a
+ * full table is replaced by a copy twice as large. The replaced tables
+ * are kept for the readers still walking them.
+ */
+#define ATTR_INTERN_MIN_SLOTS 4096
+
+typedef struct attr_intern_slot
+{
+    char *ais_name;
+    uint32_t ais_hash;
+    uint32_t ais_handle;
+} attr_intern_slot;
+
+typedef struct attr_intern_table
+{
+    uint32_t ait_mask;
+    uint32_t ait_used;
+    struct attr_intern_table *ait_old;
+    attr_intern_slot ait_slots[];
+} attr_intern_table;
+
+static attr_intern_table *attr_intern = NULL;
+static pthread_mutex_t attr_intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t attr_intern_last = 0;
+
+/* Schema names are keystrings: fold the ascii case only, like strcasecmp */
+static uint32_t
+attr_intern_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    for (; *name; name++) {
+        unsigned char c = (unsigned char)*name;
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+/* Slot of a name, or the free slot where it goes, with attr_intern_lock held */
+static attr_intern_slot *
+attr_intern_find(attr_intern_table *t, const char *name, uint32_t hash)
+{
+    for (uint32_t i = hash & t->ait_mask;; i = (i + 1) & t->ait_mask) {
+        attr_intern_slot *slot = &t->ait_slots[i];
+
+        if (0 == __atomic_load_n(&slot->ais_handle, __ATOMIC_ACQUIRE) ||
+            (slot->ais_hash == hash && strcasecmp(slot->ais_name, name) == 0)) {
+            return slot;
+        }
+    }
+}
+
+/*
+ * Return the handle of an attribute type name, or 0 if it is not the
+ * name or an alias of a schema attribute type.
+ */
+uint32_t
+attr_syntax_type_handle(const char *type)
+{
+    attr_intern_table *t = __atomic_load_n(&attr_intern, __ATOMIC_ACQUIRE);
+    uint32_t hash;
+
+    if (NULL == t || NULL == type) {
+        return 0;
+    }
+    /*
+     * The handle of a slot is loaded once: the name and the hash are only
+     * read after a handle was seen, and that handle is the one returned.
+     */
+    hash = attr_intern_hash(type);
+    for (uint32_t i = hash & t->ait_mask;; i = (i + 1) & t->ait_mask) {
+        attr_intern_slot *slot = &t->ait_slots[i];
+        uint32_t handle = __atomic_load_n(&slot->ais_handle, __ATOMIC_ACQUIRE);
+
+        if (0 == handle) {
+            return 0;
+        }
+        if (slot->ais_hash == hash && strcasecmp(slot->ais_name, type) == 0) {
+            return handle;
+        }
+    }
+}
+
+static uint32_t
+attr_syntax_intern_name(const char *name)
+{
+    attr_intern_table *t;
+    attr_intern_slot *slot;
+    uint32_t hash = attr_intern_hash(name);
+    uint32_t handle;
+
+    pthread_mutex_lock(&attr_intern_lock);
+    t = attr_intern;
+    if (NULL == t || (t->ait_used + 1) * 2 > t->ait_mask + 1) {
+        /* keep the table at most half full */
+        uint32_t nslots = t ? (t->ait_mask + 1) * 2 : ATTR_INTERN_MIN_SLOTS;
+        attr_intern_table *bigger = (attr_intern_table *)slapi_ch_calloc(1,
+            sizeof(attr_intern_table) + nslots * sizeof(attr_intern_slot));
+
+        bigger->ait_mask = nslots - 1;
+        bigger->ait_old = t;
+        for (uint32_t i = 0; t && i <= t->ait_mask; i++) {
+            if (t->ait_slots[i].ais_handle) {
+                slot = attr_intern_find(bigger, t->ait_slots[i].ais_name, t->ait_slots[i].ais_hash);
+                *slot = t->ait_slots[i];
+                bigger->ait_used++;
+            }
+        }
+        __atomic_store_n(&attr_intern, bigger, __ATOMIC_RELEASE);
+        t = bigger;
+    }
+    slot = attr_intern_find(t, name, hash);
+    if (0 == slot->ais_handle) {
+        slot->ais_name = slapi_ch_strdup(name);
+        slot->ais_hash = hash;
+        t->ait_used++;
+        __atomic_store_n(&slot->ais_handle, ++attr_intern_last, __ATOMIC_RELEASE);
+    }
+    handle = slot->ais_handle;
+    pthread_mutex_unlock(&attr_intern_lock);
+
+    return handle;
+}
+
 void
 attr_syntax_free(struct asyntaxinfo *a)
 {
@@ -415,6 +555,11 @@ attr_syntax_add_by_name(struct asyntaxinfo *a, PRUint32 schema_flags, int lock)
     if (0 != attr_syntax_init())
         return;
 
+    a->asi_handle = attr_syntax_intern_name(a->asi_name);
+    for (size_t i = 0; a->asi_aliases && a->asi_aliases[i]; i++) {
+        attr_syntax_intern_name(a->asi_aliases[i]);
+    }
+
     if (schema_flags & DSE_SCHEMA_LOCKED) {
         /* insert the attr into the temp global linked list */
         attr_syntax_insert_tmp(a);
@@ -804,6 +949,7 @@ attr_syntax_dup(struct asyntaxinfo *a)
 
     newas->asi_aliases = cool_charray_dup(a->asi_aliases);
     newas->asi_name = slapi_ch_strdup(a->asi_name);
+    newas->asi_handle = a->asi_handle;
     newas->asi_desc = slapi_ch_strdup(a->asi_desc);
     newas->asi_superior = slapi_ch_strdup(a->asi_superior);
     newas->asi_mr_equality = slapi_ch_strdup(a->asi_mr_equality);
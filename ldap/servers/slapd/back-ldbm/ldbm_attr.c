@@ -1216,8 +1216,7 @@ grok_and_rewrite_filter(Slapi_Filter *f)
         find_our_friends(f->f_type, &has, &num);
         if (has || num) {
             /* we rewrite this search to (objectclass=*) */
-            slapi_ch_free((void **)&(f->f_type));
-            f->f_type = slapi_ch_strdup("objectclass");
+            slapi_filter_changetype(f, "objectclass");
             return 0;
         } /* We already weeded out the special search we use use in the console */
         break;
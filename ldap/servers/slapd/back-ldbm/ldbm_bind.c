@@ -84,7 +84,16 @@ ldbm_back_bind(Slapi_PBlock *pb)
         }
         bvals = attr_get_present_values(attr);
         slapi_value_init_berval(&cv, cred);
-        if (slapi_pw_find_sv(bvals, &cv) != 0) {
+        rc = pw_verify_cached_find_sv(slapi_entry_get_sdn_const(e->ep_entry), bvals, &cv);
+        if (rc == PW_HASH_POOL_BUSY) {
+            /* not a failed attempt: do not count it for the lockout */
+            slapi_send_ldap_result(pb, LDAP_BUSY, NULL, "Too many password verifications in progress", 0, NULL);
+            CACHE_RETURN(&inst->inst_cache, &e);
+            value_done(&cv);
+            rc = SLAPI_BIND_FAIL;
+            goto bail;
+        }
+        if (rc != 0) {
             slapi_pblock_set(pb, SLAPI_PB_RESULT_TEXT, "Invalid credentials");
             slapi_send_ldap_result(pb, LDAP_INVALID_CREDENTIALS, NULL, NULL, 0, NULL);
             CACHE_RETURN(&inst->inst_cache, &e);
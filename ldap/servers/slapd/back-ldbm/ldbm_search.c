@@ -199,100 +199,6 @@ ldbm_back_search_cleanup(Slapi_PBlock *pb,
     return function_result;
 }
 
-static int
-ldbm_search_compile_filter(Slapi_Filter *f, void *arg __attribute__((unused)))
-{
-    int rc = SLAPI_FILTER_SCAN_CONTINUE;
-    if (f->f_choice == LDAP_FILTER_SUBSTRINGS) {
-        char pat[BUFSIZ];
-        char *p, *end, *bigpat = NULL;
-        size_t size = 0;
-        Slapi_Regex *re = NULL;
-        char *re_result = NULL;
-        int i = 0;
-
-        PR_ASSERT(NULL == f->f_un.f_un_sub.sf_private);
-        /*
-         * construct a regular expression corresponding to the filter
-         */
-        pat[0] = '\0';
-        p = pat;
-        end = pat + sizeof(pat) - 2; /* leave room for null */
-
-        if (f->f_sub_initial != NULL) {
-            size = strlen(f->f_sub_initial) + 1; /* add 1 for "^" */
-        }
-
-        while (f->f_sub_any && f->f_sub_any[i]) {
-            size += strlen(f->f_sub_any[i++]) + 2; /* add 2 for ".*" */
-        }
-
-        if (f->f_sub_final != NULL) {
-            size += strlen(f->f_sub_final) + 3; /* add 3 for ".*" and "$" */
-        }
-
-        size *= 2; /* doubled in case all filter chars need escaping (regex special chars) */
-        size++;    /* add 1 for null */
-
-        if (p + size > end) {
-            bigpat = slapi_ch_malloc(size);
-            p = bigpat;
-        }
-        if (f->f_sub_initial != NULL) {
-            *p++ = '^';
-            p = filter_strcpy_special_ext(p, f->f_sub_initial, FILTER_STRCPY_ESCAPE_RECHARS);
-        }
-        for (i = 0; f->f_sub_any && f->f_sub_any[i]; i++) {
-            /* ".*" + value */
-            *p++ = '.';
-            *p++ = '*';
-            p = filter_strcpy_special_ext(p, f->f_sub_any[i], FILTER_STRCPY_ESCAPE_RECHARS);
-        }
-        if (f->f_sub_final != NULL) {
-            /* ".*" + value */
-            *p++ = '.';
-            *p++ = '*';
-            p = filter_strcpy_special_ext(p, f->f_sub_final, FILTER_STRCPY_ESCAPE_RECHARS);
-            strcat(p, "$");
-        }
-
-        /* compile the regex */
-        p = bigpat ? bigpat : pat;
-        re = slapi_re_comp(p, &re_result);
-        if (NULL == re) {
-            slapi_log_err(SLAPI_LOG_ERR, "ldbm_search_compile_filter", "re_comp (%s) failed (%s): %s\n",
-                          pat, p, re_result ? re_result : "unknown");
-            slapi_ch_free_string(&re_result);
-            rc = SLAPI_FILTER_SCAN_ERROR;
-        } else {
-            char ebuf[BUFSIZ];
-            slapi_log_err(SLAPI_LOG_TRACE, "ldbm_search_compile_filter", "re_comp (%s)\n",
-                          escape_string(p, ebuf));
-            f->f_un.f_un_sub.sf_private = (void *)re;
-        }
-    } else if (f->f_choice == LDAP_FILTER_EQUALITY) {
-        /* store the flags in the ava_private - should be ok - points
-           to itself - no dangling references */
-        f->f_un.f_un_ava.ava_private = &f->f_flags;
-    }
-    return rc;
-}
-
-static int
-ldbm_search_free_compiled_filter(Slapi_Filter *f, void *arg __attribute__((unused)))
-{
-    int rc = SLAPI_FILTER_SCAN_CONTINUE;
-    if ((f->f_choice == LDAP_FILTER_SUBSTRINGS) &&
-        (f->f_un.f_un_sub.sf_private)) {
-        slapi_re_free((Slapi_Regex *)f->f_un.f_un_sub.sf_private);
-        f->f_un.f_un_sub.sf_private = NULL;
-    } else if (f->f_choice == LDAP_FILTER_EQUALITY) {
-        /* clear the flags in the ava_private */
-        f->f_un.f_un_ava.ava_private = NULL;
-    }
-    return rc;
-}
-
 /*
  * Return values from ldbm_back_search are:
  *
@@ -907,6 +813,15 @@ ldbm_back_search(Slapi_PBlock *pb)
     sr->sr_candidates = candidates;
     sr->sr_virtuallistview = virtual_list_view;
 
+    /*
+     * The candidates are acl checked one after the other for the same
+     * client, let the acl plugin share its decisions between the ones
+     * with the same parent and objectclasses.
+     */
+    if (scope != LDAP_SCOPE_BASE) {
+        operation_set_flag(operation, OP_FLAG_ACL_BATCH);
+    }
+
     /* Set the estimated search result count for simple paged results */
     if (sr->sr_candidates && !ALLIDS(sr->sr_candidates)) {
         estimate = IDL_NIDS(sr->sr_candidates);
@@ -950,16 +865,14 @@ ldbm_back_search(Slapi_PBlock *pb)
 
         /* step 1 - normalize all of the values used in the search filter */
         slapi_filter_normalize(sr->sr_norm_filter, PR_TRUE /* normalize values too */);
-        /* step 2 - pre-compile the substr regex and the equality flags */
-        rc = slapi_filter_apply(sr->sr_norm_filter, ldbm_search_compile_filter,
-                                NULL, &filt_errs);
+        /* step 2 - pre-compile the substr regex, the equality flags and the syntax functions */
+        rc = filter_compile(sr->sr_norm_filter, &filt_errs);
 
         if (rc == SLAPI_FILTER_SCAN_NOMORE && filter_intent) {
             slapi_filter_free(sr->sr_norm_filter_intent, 1);
             sr->sr_norm_filter_intent = slapi_filter_dup(filter_intent);
             slapi_filter_normalize(sr->sr_norm_filter_intent, PR_TRUE /* normalize values too */);
-            rc = slapi_filter_apply(sr->sr_norm_filter_intent, ldbm_search_compile_filter,
-                                    NULL, &filt_errs);
+            rc = filter_compile(sr->sr_norm_filter_intent, &filt_errs);
         }
 
         if (rc != SLAPI_FILTER_SCAN_NOMORE) {
@@ -1938,15 +1851,14 @@ delete_search_result_set(Slapi_PBlock *pb, back_search_result_set **sr)
     if (NULL != (*sr)->sr_candidates) {
         idl_free(&((*sr)->sr_candidates));
     }
-    rc = slapi_filter_apply((*sr)->sr_norm_filter, ldbm_search_free_compiled_filter,
-                            NULL, &filt_errs);
+    rc = filter_free_compiled((*sr)->sr_norm_filter, &filt_errs);
     if (rc != SLAPI_FILTER_SCAN_NOMORE) {
         slapi_log_err(SLAPI_LOG_ERR, "delete_search_result_set",
                       "Could not free the pre-compiled regexes in the search filter - error %d %d\n",
                       rc, filt_errs);
     }
 
-    rc = slapi_filter_apply((*sr)->sr_norm_filter_intent, ldbm_search_free_compiled_filter, NULL, &filt_errs);
+    rc = filter_free_compiled((*sr)->sr_norm_filter_intent, &filt_errs);
     if (rc != SLAPI_FILTER_SCAN_NOMORE) {
         slapi_log_err(SLAPI_LOG_ERR, "delete_search_result_set",
                       "Could not free the pre-compiled regexes in the intent search filter - error %d %d\n",
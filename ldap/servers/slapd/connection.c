@@ -31,6 +31,7 @@ typedef Connection work_q_item;
 static void connection_threadmain(void *arg);
 static void connection_add_operation(Connection *conn, Operation *op);
 static void connection_free_private_buffer(Connection *conn);
+static void connection_repl_apply_free(Connection *conn);
 static void op_copy_identity(Connection *conn, Operation *op);
 static void connection_set_ssl_ssf(Connection *conn);
 static int is_ber_too_big(const Connection *conn, ber_len_t ber_len);
@@ -231,6 +232,8 @@ connection_cleanup(Connection *conn)
 
     /* free the connection socket buffer */
     connection_free_private_buffer(conn);
+    /* and the replicated operations scheduler, if any */
+    connection_repl_apply_free(conn);
     /* even if !config_get_enable_nunc_stans, it is ok to set to 0 here */
     conn->c_ns_close_jobs = 0;
 }
@@ -800,6 +803,7 @@ struct Conn_private
     size_t c_buffer_bytes;            /* number of bytes currently stored in the buffer */
     size_t c_buffer_offset;           /* offset to the location of new data in the buffer */
     int use_buffer;                   /* if true, use the buffer - if false, ber_get_next reads directly from socket */
+    struct conn_repl_apply *c_repl_apply; /* scheduler of the replicated operations applied concurrently */
 };
 
 /* Copy up to bytes_to_read bytes from b into return_buffer.
@@ -1033,6 +1037,272 @@ _ber_get_len(BerElement *ber, ber_len_t *lenp)
     return lber->ber_tag;
 }
 
+/*
+ * Consumer side scheduler for the updates received on a replication session.
+ *
+ * Historically a replication connection is not made readable again before the
+ * current operation completes, so that the updates are applied strictly in the
+ * order they are received off the wire.  When nsslapd-repl-apply-concurrency
+ * is greater than 1, an ADD or MODIFY whose target is independent from the
+ * updates still in progress is admitted to run concurrently and the
+ * connection is handed back to the poll loop right away, so the next update
+ * can be read and dispatched by another worker thread.
+ *
+ * Two updates are dependent if they target the same entry, or if one targets
+ * the parent of the other.  Any other operation (delete, modrdn, extended
+ * operations such as the end of the replication session, ...) is a barrier:
+ * it is only admitted once every update in progress has completed, and it is
+ * applied serially.  As the next update is not read until the current one has
+ * been admitted, dependent updates are always applied in CSN order.
+ *
+ * The replication plugin requires the CSNs of a session to enter the RUV
+ * pending list in the order they were sent (csnplInsert rejects a CSN older
+ * than the last inserted one).  Concurrent updates thus take turns, in
+ * admission order, for that single step (see slapi_repl_apply_csn_turn_wait),
+ * while the rest of the operation, including the commit, runs in parallel.
+ */
+typedef struct conn_repl_apply_op
+{
+    Operation *op;
+    Slapi_DN sdn;       /* target of an ADD/MODIFY */
+    const char *pndn;   /* parent of the target, points into sdn */
+    int barrier;        /* must be applied alone */
+    int csn_registered; /* its CSN reached the RUV pending list */
+    struct conn_repl_apply_op *next;
+} conn_repl_apply_op;
+
+typedef struct conn_repl_apply
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    conn_repl_apply_op *inflight; /* updates in progress, in admission order */
+    int32_t inflight_count;
+    uint64_t concurrent_ops; /* updates admitted to run concurrently */
+    uint64_t waited_ops;     /* updates that had to wait for a dependency */
+} conn_repl_apply;
+
+static void
+connection_repl_apply_free(Connection *conn)
+{
+    conn_repl_apply *ra;
+
+    if (NULL == conn->c_private || NULL == (ra = conn->c_private->c_repl_apply)) {
+        return;
+    }
+    /* Every operation released its slot before the connection got cleaned up */
+    PR_ASSERT(NULL == ra->inflight);
+    if (ra->concurrent_ops) {
+        slapi_log_err(SLAPI_LOG_REPL, "connection_repl_apply_free",
+                      "conn=%" PRIu64 " applied %" PRIu64 " updates concurrently, %" PRIu64 " waited for a dependency\n",
+                      conn->c_connid, ra->concurrent_ops, ra->waited_ops);
+    }
+    pthread_cond_destroy(&ra->cv);
+    pthread_mutex_destroy(&ra->lock);
+    slapi_ch_free((void **)&conn->c_private->c_repl_apply);
+}
+
+/*
+ * Decode the target DN of an ADD or MODIFY request without consuming the
+ * BerElement of the operation: the element is copied and the DN is read
+ * in place.
+ */
+static int
+connection_repl_apply_peek_target(Operation *op, Slapi_DN *sdn)
+{
+    OLBerElement ber_copy = *((OLBerElement *)op->o_ber);
+    struct berval rawdn = {0};
+    char *dn;
+
+    if (ber_scanf((BerElement *)&ber_copy, "{m", &rawdn) == LBER_ERROR || rawdn.bv_len == 0) {
+        return -1;
+    }
+    dn = slapi_ch_malloc(rawdn.bv_len + 1);
+    memcpy(dn, rawdn.bv_val, rawdn.bv_len);
+    dn[rawdn.bv_len] = '\0';
+    slapi_sdn_init_dn_passin(sdn, dn);
+    if (NULL == slapi_sdn_get_ndn(sdn)) {
+        slapi_sdn_done(sdn);
+        return -1;
+    }
+    return 0;
+}
+
+static int
+connection_repl_apply_depends(const conn_repl_apply_op *a, const conn_repl_apply_op *b)
+{
+    const char *andn;
+    const char *bndn;
+
+    if (a->barrier || b->barrier) {
+        return 1;
+    }
+    andn = slapi_sdn_get_ndn(&a->sdn);
+    bndn = slapi_sdn_get_ndn(&b->sdn);
+    return (strcmp(andn, bndn) == 0) ||
+           (a->pndn && strcmp(a->pndn, bndn) == 0) ||
+           (b->pndn && strcmp(b->pndn, andn) == 0);
+}
+
+/*
+ * Called by the thread that read the operation off the replication
+ * connection, before the connection is made readable again.  Blocks until
+ * the operation no longer depends on the updates in progress.
+ * Returns the scheduler slot that must be released with
+ * connection_repl_apply_release once the operation completed.
+ */
+static conn_repl_apply_op *
+connection_repl_apply_admit(Connection *conn, Operation *op, int32_t concurrency)
+{
+    conn_repl_apply *ra;
+    conn_repl_apply_op *item;
+    conn_repl_apply_op *it;
+    conn_repl_apply_op **tail;
+    int waited = 0;
+
+    pthread_mutex_lock(&(conn->c_mutex));
+    if (NULL == (ra = conn->c_private->c_repl_apply)) {
+        ra = (conn_repl_apply *)slapi_ch_calloc(1, sizeof(conn_repl_apply));
+        pthread_mutex_init(&ra->lock, NULL);
+        pthread_cond_init(&ra->cv, NULL);
+        conn->c_private->c_repl_apply = ra;
+    }
+    pthread_mutex_unlock(&(conn->c_mutex));
+
+    item = (conn_repl_apply_op *)slapi_ch_calloc(1, sizeof(conn_repl_apply_op));
+    item->op = op;
+    if ((op->o_tag == LDAP_REQ_ADD || op->o_tag == LDAP_REQ_MODIFY) &&
+        connection_repl_apply_peek_target(op, &item->sdn) == 0) {
+        item->pndn = slapi_dn_find_parent(slapi_sdn_get_ndn(&item->sdn));
+    } else {
+        item->barrier = 1;
+    }
+
+    pthread_mutex_lock(&ra->lock);
+    while (1) {
+        int blocked = 0;
+        if (item->barrier) {
+            blocked = (ra->inflight != NULL);
+        } else if (ra->inflight_count >= concurrency) {
+            blocked = 1;
+        } else {
+            for (it = ra->inflight; it && !blocked; it = it->next) {
+                blocked = connection_repl_apply_depends(item, it);
+            }
+        }
+        if (!blocked) {
+            break;
+        }
+        waited = 1;
+        pthread_cond_wait(&ra->cv, &ra->lock);
+    }
+    for (tail = &ra->inflight; *tail; tail = &(*tail)->next)
+        ;
+    *tail = item;
+    ra->inflight_count++;
+    if (!item->barrier) {
+        ra->concurrent_ops++;
+        if (waited) {
+            ra->waited_ops++;
+        }
+    }
+    pthread_mutex_unlock(&ra->lock);
+
+    return item;
+}
+
+static void
+connection_repl_apply_release(Connection *conn, conn_repl_apply_op **item)
+{
+    conn_repl_apply *ra = conn->c_private->c_repl_apply;
+    conn_repl_apply_op **prev;
+
+    if (NULL == *item) {
+        return;
+    }
+    pthread_mutex_lock(&ra->lock);
+    for (prev = &ra->inflight; *prev; prev = &(*prev)->next) {
+        if (*prev == *item) {
+            *prev = (*item)->next;
+            ra->inflight_count--;
+            break;
+        }
+    }
+    pthread_cond_broadcast(&ra->cv);
+    pthread_mutex_unlock(&ra->lock);
+
+    if (!(*item)->barrier) {
+        slapi_sdn_done(&(*item)->sdn);
+    }
+    slapi_ch_free((void **)item);
+}
+
+static conn_repl_apply_op *
+connection_repl_apply_find_nolock(conn_repl_apply *ra, Operation *op)
+{
+    conn_repl_apply_op *it;
+
+    for (it = ra->inflight; it && it->op != op; it = it->next)
+        ;
+    return it;
+}
+
+/*
+ * Wait until the CSN of every update admitted before this one reached the
+ * RUV pending list.  No-op for operations that are not scheduled.
+ */
+void
+slapi_repl_apply_csn_turn_wait(Slapi_PBlock *pb)
+{
+    Connection *conn = NULL;
+    Operation *op = NULL;
+    conn_repl_apply *ra;
+    conn_repl_apply_op *item;
+    conn_repl_apply_op *it;
+
+    slapi_pblock_get(pb, SLAPI_CONNECTION, &conn);
+    slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    if (NULL == conn || NULL == op || NULL == conn->c_private ||
+        NULL == (ra = conn->c_private->c_repl_apply)) {
+        return;
+    }
+    pthread_mutex_lock(&ra->lock);
+    if ((item = connection_repl_apply_find_nolock(ra, op))) {
+        for (it = ra->inflight; it != item;) {
+            if (it->csn_registered) {
+                it = it->next;
+            } else {
+                pthread_cond_wait(&ra->cv, &ra->lock);
+                /* the list may have changed while we waited */
+                it = ra->inflight;
+            }
+        }
+    }
+    pthread_mutex_unlock(&ra->lock);
+}
+
+/* Let the next update register its CSN */
+void
+slapi_repl_apply_csn_turn_done(Slapi_PBlock *pb)
+{
+    Connection *conn = NULL;
+    Operation *op = NULL;
+    conn_repl_apply *ra;
+    conn_repl_apply_op *item;
+
+    slapi_pblock_get(pb, SLAPI_CONNECTION, &conn);
+    slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    if (NULL == conn || NULL == op || NULL == conn->c_private ||
+        NULL == (ra = conn->c_private->c_repl_apply)) {
+        return;
+    }
+    pthread_mutex_lock(&ra->lock);
+    if ((item = connection_repl_apply_find_nolock(ra, op))) {
+        item->csn_registered = 1;
+        pthread_cond_broadcast(&ra->cv);
+    }
+    pthread_mutex_unlock(&ra->lock);
+}
+
 /*
  * Utility function called by  connection_read_operation(). This is a
  * small wrapper on top of libldap's ber_get_next_buffer_ext().
@@ -1444,6 +1714,9 @@ connection_enter_leave_turbo(Connection *conn, int current_turbo_flag, int *new_
     if (pagedresults_in_use_nolock(conn)) {
         /* PAGED_RESULTS does not need turbo mode */
         new_mode = 0;
+    } else if (conn->c_isreplication_session && config_get_repl_apply_concurrency() > 1) {
+        /* the replicated updates are dispatched to several threads */
+        new_mode = 0;
     } else if (conn->c_private->operation_rate == 0) {
         /* The connection is ranked by the passed activities. If some other
          * connection have more activity, increase rank by one. The highest
@@ -1508,6 +1781,9 @@ connection_threadmain(void *arg)
     int ret = 0;
     int more_data = 0;
     int replication_connection = 0; /* If this connection is from a replication supplier, we want to ensure that operation processing is serialized */
+    int32_t repl_apply_concurrency = 0;
+    int repl_apply_concurrent = 0;  /* ... unless the scheduler admitted the update to run concurrently */
+    conn_repl_apply_op *repl_apply_item = NULL;
     int doshutdown = 0;
     int maxthreads = 0;
     long bypasspollcnt = 0;
@@ -1728,7 +2004,14 @@ connection_threadmain(void *arg)
          * they are received off the wire.
          */
         replication_connection = conn->c_isreplication_session;
-        if ((tag != LDAP_REQ_UNBIND) && !thread_turbo_flag && !replication_connection) {
+        repl_apply_concurrent = 0;
+        if (replication_connection && (ret == CONN_FOUND_WORK_TO_DO) && (tag != LDAP_REQ_UNBIND) &&
+            ((repl_apply_concurrency = config_get_repl_apply_concurrency()) > 1)) {
+            repl_apply_item = connection_repl_apply_admit(conn, op, repl_apply_concurrency);
+            /* In turbo mode this thread keeps reading the connection, the updates stay serialized */
+            repl_apply_concurrent = !repl_apply_item->barrier && !thread_turbo_flag;
+        }
+        if ((tag != LDAP_REQ_UNBIND) && !thread_turbo_flag && (!replication_connection || repl_apply_concurrent)) {
             if (!more_data) {
                 conn->c_flags &= ~CONN_FLAG_MAX_THREADS;
                 pthread_mutex_lock(&(conn->c_mutex));
@@ -1805,6 +2088,7 @@ connection_threadmain(void *arg)
         connection_dispatch_operation(conn, op, pb);
 
     done:
+        connection_repl_apply_release(conn, &repl_apply_item);
         if (doshutdown) {
             pthread_mutex_lock(&(conn->c_mutex));
             connection_remove_operation_ext(pb, conn, op);
@@ -1862,7 +2146,11 @@ connection_threadmain(void *arg)
                           "repl_conn_bef %d, repl_conn_now %d\n",
                           conn->c_connid, more_data, thread_turbo_flag,
                           replication_connection, conn->c_isreplication_session);
-            if (!replication_connection &&  conn->c_isreplication_session) {
+            if (repl_apply_concurrent) {
+                /* the connection was handed back when the update was admitted,
+                 * another thread is now in charge of reading it */
+                more_data = 0;
+            } else if (!replication_connection &&  conn->c_isreplication_session) {
                 /* it a connection that was just flagged as replication connection */
                 more_data = 0;
             } else {
@@ -1877,7 +2165,7 @@ connection_threadmain(void *arg)
                      * Don't release the connection now.
                      * But note down what to do.
                      */
-                    if (replication_connection || (1 == is_timedout)) {
+                    if ((replication_connection && !repl_apply_concurrent) || (1 == is_timedout)) {
                         connection_make_readable_nolock(conn);
                         need_wakeup = 1;
                     }
@@ -974,6 +974,7 @@ slapd_daemon(daemon_ports_t *ports)
     }
 
     init_ct_list_threads();
+    pw_hash_pool_init();
     init_op_threads();
 
     /* Start the SNMP collator if counters are enabled. */
@@ -1134,6 +1135,7 @@ slapd_daemon(daemon_ports_t *ports)
 
     op_thread_cleanup();
     ct_thread_cleanup();
+    pw_hash_pool_stop();
     housekeeping_stop(); /* Run this after op_thread_cleanup() logged sth */
     disk_monitoring_stop();
 
@@ -29,6 +29,7 @@
 #include <sys/socket.h>
 #include "slap.h"
 #include "pratom.h"
+#include "pw_verify.h"
 
 /* Forward declarations */
 static int delete_internal_pb(Slapi_PBlock *pb);
@@ -345,6 +346,8 @@ op_shared_delete(Slapi_PBlock *pb)
                 if (operation_is_flag_set(operation, OP_FLAG_ACTION_LOG_AUDIT))
                     write_audit_log_entry(pb); /* Record the operation in the audit log */
 
+                pw_verify_cache_invalidate(sdn);
+
                 slapi_pblock_get(pb, SLAPI_ENTRY_PRE_OP, &ecopy);
                 do_ps_service(ecopy, NULL, LDAP_CHANGETYPE_DELETE, 0);
             } else {
@@ -78,6 +78,13 @@ struct ndn_cache {
  * to round the ht size up!
  */
 #define NDN_ENTRY_AVG_SIZE 168
+/*
+ * The cache is split in shards by the hash of the dn. The inclusions of the
+ * readers are only applied by the writer of a shard, so with one cache all
+ * the threads funnel through a single writer (and its evictions). Must be a
+ * power of two.
+ */
+#define NDN_CACHE_SHARDS 16
 /*
  * After how many operations do we sync our per-thread stats.
  */
@@ -2864,7 +2871,23 @@ slapi_sdn_get_size(const Slapi_DN *sdn)
  */
 static int32_t ndn_enabled = 0;
 static int32_t ndn_import_task_count = 0;
-static ARCacheChar *cache = NULL;
+static ARCacheChar *cache[NDN_CACHE_SHARDS] = {0};
+static uint64_t ndn_max_size = 0;
+/* What the included dns really weight, to report the cache size in bytes */
+static Slapi_Counter *ndn_included = NULL;
+static Slapi_Counter *ndn_included_bytes = NULL;
+
+/* FNV-1a, only to pick a shard: the cache hashes the key on its own */
+static inline ARCacheChar *
+ndn_cache_shard(const char *dn)
+{
+    uint32_t hash = 2166136261U;
+
+    for (const unsigned char *p = (const unsigned char *)dn; *p; p++) {
+        hash = (hash ^ *p) * 16777619U;
+    }
+    return cache[(hash ^ (hash >> 16)) & (NDN_CACHE_SHARDS - 1)];
+}
 
 int32_t
 ndn_cache_init()
@@ -2883,14 +2906,28 @@ ndn_cache_init()
     if (max_size < NDN_CACHE_MINIMUM_CAPACITY) {
         max_size = NDN_CACHE_MINIMUM_CAPACITY;
     }
-    uintptr_t max_estimate = max_size / NDN_ENTRY_AVG_SIZE;
+    ndn_max_size = max_size;
+    uintptr_t max_estimate = max_size / NDN_ENTRY_AVG_SIZE / NDN_CACHE_SHARDS;
     /*
      * Since we currently only do one op per read, we set 0 because there
      * is no value in having the read thread cache.
      */
     uintptr_t max_thread_read = 0;
-    /* Setup the main cache which all other caches will inherit. */
-    cache = cache_char_create(max_estimate, max_thread_read);
+    /* Setup the shards which all the threads share. */
+    for (size_t i = 0; i < NDN_CACHE_SHARDS; i++) {
+        cache[i] = cache_char_create(max_estimate, max_thread_read);
+        if (cache[i] == NULL) {
+            slapi_log_err(SLAPI_LOG_ERR, "ndn_cache_init", "Unable to create the normalized dn cache\n");
+            while (i-- > 0) {
+                cache_char_free(cache[i]);
+                cache[i] = NULL;
+            }
+            ndn_enabled = 0;
+            return 0;
+        }
+    }
+    ndn_included = slapi_counter_new();
+    ndn_included_bytes = slapi_counter_new();
 
     return 0;
 }
@@ -2913,7 +2950,12 @@ ndn_cache_destroy()
     if (ndn_enabled == 0) {
         return;
     }
-    cache_char_free(cache);
+    for (size_t i = 0; i < NDN_CACHE_SHARDS; i++) {
+        cache_char_free(cache[i]);
+        cache[i] = NULL;
+    }
+    slapi_counter_destroy(&ndn_included);
+    slapi_counter_destroy(&ndn_included_bytes);
 }
 
 int
@@ -2940,7 +2982,7 @@ ndn_cache_lookup(char *dn, size_t dn_len, char **ndn, char **udn, int32_t *rc)
     }
 
     /* Look for it */
-    ARCacheCharRead *read_txn = cache_char_read_begin(cache);
+    ARCacheCharRead *read_txn = cache_char_read_begin(ndn_cache_shard(dn));
     PR_ASSERT(read_txn);
 
     const char *cache_ndn = cache_char_read_get(read_txn, dn);
@@ -2976,10 +3018,13 @@ ndn_cache_add(char *dn, size_t dn_len, char *ndn, size_t ndn_len)
         *(ndn + ndn_len) = '\0';
     }
 
-    ARCacheCharRead *read_txn = cache_char_read_begin(cache);
+    ARCacheCharRead *read_txn = cache_char_read_begin(ndn_cache_shard(dn));
     PR_ASSERT(read_txn);
     cache_char_read_include(read_txn, dn, ndn);
     cache_char_read_complete(read_txn);
+    slapi_counter_increment(ndn_included);
+    /* the key and the value CStrings: their nul, their pointer and length */
+    slapi_counter_add(ndn_included_bytes, dn_len + ndn_len + 2 + 4 * sizeof(void *));
     /*
      * We need to free dn - in the original ndn cache, the dn is added to the
      * hashmap, but in the rust one, it's cloned to a cstring, so we no longer
@@ -2997,38 +3042,54 @@ ndn_cache_get_stats(uint64_t *hits, uint64_t *tries, uint64_t *size, uint64_t *m
      * getting the real byte size is expensive in some cases (that are beyond this
      * project). Additionally, due to the concurrent nature of this, the size is
      * not really accurate to begin with anyway, but you know, this is a best
-     * effort for stats for the user to see.
+     * effort for stats for the user to see. The size is the count of the shards
+     * times the average weight of the dns we really included.
      */
-    uint64_t reader_hits;
-    uint64_t reader_includes;
-    uint64_t write_hits;
-    uint64_t write_inc_or_mod;
-    uint64_t freq;
-    uint64_t recent;
-    uint64_t freq_evicts;
-    uint64_t recent_evicts;
-    uint64_t p_weight;
-    cache_char_stats(cache, 
-        &reader_hits,
-        &reader_includes,
-        &write_hits,
-        &write_inc_or_mod,
-        max_size,
-        &freq,
-        &recent,
-        &freq_evicts,
-        &recent_evicts,
-        &p_weight,
-        slots
-    );
-    /* ARCache stores by key count not size, so we recombine with the avg entry size */
-    *max_size = *max_size * NDN_ENTRY_AVG_SIZE;
-    *thread_size = 0;
-    *evicts = freq_evicts + recent_evicts;
-    *hits = write_hits + reader_hits;
-    *tries = *hits + reader_includes + write_inc_or_mod;
-    *size = (freq + recent) * NDN_ENTRY_AVG_SIZE;
-    *count = (freq + recent);
+    uint64_t included;
+    uint64_t avg_size = NDN_ENTRY_AVG_SIZE;
+
+    *hits = *tries = *size = *max_size = *thread_size = *evicts = *slots = *count = 0;
+    if (ndn_enabled == 0) {
+        return;
+    }
+    for (size_t i = 0; i < NDN_CACHE_SHARDS; i++) {
+        uint64_t reader_hits;
+        uint64_t reader_includes;
+        uint64_t write_hits;
+        uint64_t write_inc_or_mod;
+        uint64_t shared_max;
+        uint64_t freq;
+        uint64_t recent;
+        uint64_t freq_evicts;
+        uint64_t recent_evicts;
+        uint64_t p_weight;
+        uint64_t all_seen_keys;
+
+        cache_char_stats(cache[i],
+            &reader_hits,
+            &reader_includes,
+            &write_hits,
+            &write_inc_or_mod,
+            &shared_max,
+            &freq,
+            &recent,
+            &freq_evicts,
+            &recent_evicts,
+            &p_weight,
+            &all_seen_keys
+        );
+        *evicts += freq_evicts + recent_evicts;
+        *hits += write_hits + reader_hits;
+        *tries += write_hits + reader_hits + reader_includes + write_inc_or_mod;
+        *count += freq + recent;
+        *slots += all_seen_keys;
+    }
+    included = slapi_counter_get_value(ndn_included);
+    if (included > 0) {
+        avg_size = slapi_counter_get_value(ndn_included_bytes) / included;
+    }
+    *max_size = ndn_max_size;
+    *size = *count * avg_size;
 }
 
 /* Common ancestor sdn is allocated.
@@ -2282,6 +2282,12 @@ slapi_entrycache_vattrcache_watermark_invalidate()
     }
 }
 
+int32_t
+slapi_entrycache_vattrcache_watermark_get()
+{
+    return slapi_atomic_load_32(&g_virtual_watermark, __ATOMIC_ACQUIRE);
+}
+
 /* The following functions control the virtual attribute cache
  * stored in each entry (e_virtual_attrs). Access to that cache
  * requires holding a lock (e_virtual_lock)
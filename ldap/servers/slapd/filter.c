@@ -671,6 +671,32 @@ parsing_error:;
 }
 
 
+/*
+ * Cache the interned handle of the attribute type of a filter component,
+ * to be compared with the a_type_handle of the entry attributes.
+ */
+void
+filter_compute_type_handle(struct slapi_filter *f)
+{
+    switch (f->f_choice) {
+    case LDAP_FILTER_EQUALITY:
+    case LDAP_FILTER_GE:
+    case LDAP_FILTER_LE:
+    case LDAP_FILTER_APPROX:
+        f->f_type_handle = attr_syntax_type_handle(f->f_avtype);
+        break;
+    case LDAP_FILTER_SUBSTRINGS:
+        f->f_type_handle = attr_syntax_type_handle(f->f_sub_type);
+        break;
+    case LDAP_FILTER_PRESENT:
+        f->f_type_handle = attr_syntax_type_handle(f->f_type);
+        break;
+    default:
+        f->f_type_handle = 0;
+        break;
+    }
+}
+
 Slapi_Filter *
 slapi_filter_dup(Slapi_Filter *f)
 {
@@ -691,6 +717,7 @@ slapi_filter_dup(Slapi_Filter *f)
 
     out->f_choice = f->f_choice;
     out->f_hash = f->f_hash;
+    out->f_type_handle = f->f_type_handle;
     out->f_flags = f->f_flags;
 
     slapi_log_err(SLAPI_LOG_FILTER, "slapi_filter_dup", "type 0x%lX\n", f->f_choice);
@@ -758,6 +785,7 @@ slapi_filter_free(struct slapi_filter *f, int recurse)
     }
 
     slapi_log_err(SLAPI_LOG_FILTER, "slapi_filter_free", "type 0x%lX\n", f->f_choice);
+    plugin_syntax_filter_compiled_free(&f->f_compiled);
     switch (f->f_choice) {
     case LDAP_FILTER_EQUALITY:
     case LDAP_FILTER_GE:
@@ -1046,6 +1074,7 @@ filter_normalize_ava(struct slapi_filter *f, PRBool norm_values)
     tmp = ava->ava_type;
     ava->ava_type = slapi_attr_syntax_normalize(tmp);
     slapi_ch_free((void **)&tmp);
+    filter_compute_type_handle(f);
     f->f_flags |= SLAPI_FILTER_NORMALIZED_TYPE;
     if (norm_values) {
         char *newval = NULL;
@@ -1075,6 +1104,7 @@ filter_normalize_subfilt(struct slapi_filter *f, PRBool norm_values)
     char *tmp = sf->sf_type;
     sf->sf_type = slapi_attr_syntax_normalize(tmp);
     slapi_ch_free((void **)&tmp);
+    filter_compute_type_handle(f);
     f->f_flags |= SLAPI_FILTER_NORMALIZED_TYPE;
     if (norm_values) {
         char *newval = NULL;
@@ -1151,6 +1181,7 @@ filter_normalize_ext(struct slapi_filter *f, PRBool norm_values)
         tmp = f->f_type;
         f->f_type = slapi_attr_syntax_normalize(tmp);
         slapi_ch_free((void **)&tmp);
+        filter_compute_type_handle(f);
         f->f_flags |= SLAPI_FILTER_NORMALIZED_TYPE;
         break;
     case LDAP_FILTER_EXTENDED:
@@ -1732,6 +1763,139 @@ slapi_filter_optimise(Slapi_Filter *f)
     }
 }
 
+static int
+filter_compile_component(Slapi_Filter *f, void *arg __attribute__((unused)))
+{
+    int rc = SLAPI_FILTER_SCAN_CONTINUE;
+    if (f->f_choice == LDAP_FILTER_SUBSTRINGS) {
+        char pat[BUFSIZ];
+        char *p, *end, *bigpat = NULL;
+        size_t size = 0;
+        Slapi_Regex *re = NULL;
+        char *re_result = NULL;
+        int i = 0;
+
+        PR_ASSERT(NULL == f->f_un.f_un_sub.sf_private);
+        /*
+         * construct a regular expression corresponding to the filter
+         */
+        pat[0] = '\0';
+        p = pat;
+        end = pat + sizeof(pat) - 2; /* leave room for null */
+
+        if (f->f_sub_initial != NULL) {
+            size = strlen(f->f_sub_initial) + 1; /* add 1 for "^" */
+        }
+
+        while (f->f_sub_any && f->f_sub_any[i]) {
+            size += strlen(f->f_sub_any[i++]) + 2; /* add 2 for ".*" */
+        }
+
+        if (f->f_sub_final != NULL) {
+            size += strlen(f->f_sub_final) + 3; /* add 3 for ".*" and "$" */
+        }
+
+        size *= 2; /* doubled in case all filter chars need escaping (regex special chars) */
+        size++;    /* add 1 for null */
+
+        if (p + size > end) {
+            bigpat = slapi_ch_malloc(size);
+            p = bigpat;
+        }
+        if (f->f_sub_initial != NULL) {
+            *p++ = '^';
+            p = filter_strcpy_special_ext(p, f->f_sub_initial, FILTER_STRCPY_ESCAPE_RECHARS);
+        }
+        for (i = 0; f->f_sub_any && f->f_sub_any[i]; i++) {
+            /* ".*" + value */
+            *p++ = '.';
+            *p++ = '*';
+            p = filter_strcpy_special_ext(p, f->f_sub_any[i], FILTER_STRCPY_ESCAPE_RECHARS);
+        }
+        if (f->f_sub_final != NULL) {
+            /* ".*" + value */
+            *p++ = '.';
+            *p++ = '*';
+            p = filter_strcpy_special_ext(p, f->f_sub_final, FILTER_STRCPY_ESCAPE_RECHARS);
+            strcat(p, "$");
+        }
+
+        /* compile the regex */
+        p = bigpat ? bigpat : pat;
+        re = slapi_re_comp(p, &re_result);
+        if (NULL == re) {
+            slapi_log_err(SLAPI_LOG_ERR, "filter_compile", "re_comp (%s) failed (%s): %s\n",
+                          pat, p, re_result ? re_result : "unknown");
+            slapi_ch_free_string(&re_result);
+            rc = SLAPI_FILTER_SCAN_ERROR;
+        } else {
+            char ebuf[BUFSIZ];
+            slapi_log_err(SLAPI_LOG_TRACE, "filter_compile", "re_comp (%s)\n",
+                          escape_string(p, ebuf));
+            f->f_un.f_un_sub.sf_private = (void *)re;
+        }
+        slapi_ch_free_string(&bigpat);
+    } else if (f->f_choice == LDAP_FILTER_EQUALITY) {
+        /* store the flags in the ava_private - should be ok - points
+           to itself - no dangling references */
+        f->f_un.f_un_ava.ava_private = &f->f_flags;
+    }
+
+    switch (f->f_choice) {
+    case LDAP_FILTER_EQUALITY:
+    case LDAP_FILTER_GE:
+    case LDAP_FILTER_LE:
+    case LDAP_FILTER_APPROX:
+    case LDAP_FILTER_SUBSTRINGS:
+        if (rc == SLAPI_FILTER_SCAN_CONTINUE) {
+            f->f_compiled = plugin_syntax_filter_compile(f);
+        }
+        break;
+    default:
+        break;
+    }
+    return rc;
+}
+
+static int
+filter_free_compiled_component(Slapi_Filter *f, void *arg __attribute__((unused)))
+{
+    if ((f->f_choice == LDAP_FILTER_SUBSTRINGS) &&
+        (f->f_un.f_un_sub.sf_private)) {
+        slapi_re_free((Slapi_Regex *)f->f_un.f_un_sub.sf_private);
+        f->f_un.f_un_sub.sf_private = NULL;
+    } else if (f->f_choice == LDAP_FILTER_EQUALITY) {
+        /* clear the flags in the ava_private */
+        f->f_un.f_un_ava.ava_private = NULL;
+    }
+    plugin_syntax_filter_compiled_free(&f->f_compiled);
+    return SLAPI_FILTER_SCAN_CONTINUE;
+}
+
+/* filter_compile
+ * ---------------
+ * prepares a normalized filter to be tested against all the candidate
+ * entries of a search, once rather than for every entry:
+ * * the regular expressions of the substring components are compiled
+ * * the equality components are flagged as normalized
+ * * the syntax or matching rule filter functions of the components are
+ *   resolved for their attribute types, with the pblock to call them
+ *
+ * A compiled filter must be tested by one thread at a time, and released
+ * with filter_free_compiled(). Returns like slapi_filter_apply().
+ */
+int
+filter_compile(Slapi_Filter *f, int *error_code)
+{
+    return slapi_filter_apply(f, filter_compile_component, NULL, error_code);
+}
+
+int
+filter_free_compiled(Slapi_Filter *f, int *error_code)
+{
+    return slapi_filter_apply(f, filter_free_compiled_component, NULL, error_code);
+}
+
 
 /* slapi_filter_changetype
  * ------------------------
@@ -1769,6 +1933,7 @@ slapi_filter_changetype(Slapi_Filter *f, const char *newtype)
 
     slapi_ch_free_string(target);
     *target = slapi_ch_strdup(newtype);
+    filter_compute_type_handle(f);
 
 bail:
     return (!target);
@@ -150,6 +150,9 @@ filter_compute_hash(struct slapi_filter *f)
     struct berval *inval[2], **outval;
     Slapi_Attr sattr;
 
+    /* every new filter component goes through here */
+    filter_compute_type_handle(f);
+
     if (!hash_filters)
         return;
 
@@ -112,8 +112,8 @@ slapi_filter_test_ext_internal(
     switch (f->f_choice) {
     case LDAP_FILTER_EQUALITY:
         slapi_log_err(SLAPI_LOG_FILTER, "slapi_filter_test_ext_internal", "EQUALITY\n");
-        rc = test_ava_filter(pb, e, e->e_attrs, &f->f_ava, LDAP_FILTER_EQUALITY,
-                             verify_access, only_check_access, access_check_done);
+        rc = test_ava_filter_ext(pb, e, e->e_attrs, &f->f_ava, f->f_type_handle, f->f_compiled,
+                                 LDAP_FILTER_EQUALITY, verify_access, only_check_access, access_check_done);
         break;
 
     case LDAP_FILTER_SUBSTRINGS:
@@ -123,14 +123,14 @@ slapi_filter_test_ext_internal(
 
     case LDAP_FILTER_GE:
         slapi_log_err(SLAPI_LOG_FILTER, "slapi_filter_test_ext_internal", "GE\n");
-        rc = test_ava_filter(pb, e, e->e_attrs, &f->f_ava, LDAP_FILTER_GE,
-                             verify_access, only_check_access, access_check_done);
+        rc = test_ava_filter_ext(pb, e, e->e_attrs, &f->f_ava, f->f_type_handle, f->f_compiled,
+                                 LDAP_FILTER_GE, verify_access, only_check_access, access_check_done);
         break;
 
     case LDAP_FILTER_LE:
         slapi_log_err(SLAPI_LOG_FILTER, "slapi_filter_test_ext_internal", "LE\n");
-        rc = test_ava_filter(pb, e, e->e_attrs, &f->f_ava, LDAP_FILTER_LE,
-                             verify_access, only_check_access, access_check_done);
+        rc = test_ava_filter_ext(pb, e, e->e_attrs, &f->f_ava, f->f_type_handle, f->f_compiled,
+                                 LDAP_FILTER_LE, verify_access, only_check_access, access_check_done);
         break;
 
     case LDAP_FILTER_PRESENT:
@@ -140,8 +140,8 @@ slapi_filter_test_ext_internal(
 
     case LDAP_FILTER_APPROX:
         slapi_log_err(SLAPI_LOG_FILTER, "slapi_filter_test_ext_internal", "APPROX\n");
-        rc = test_ava_filter(pb, e, e->e_attrs, &f->f_ava, LDAP_FILTER_APPROX,
-                             verify_access, only_check_access, access_check_done);
+        rc = test_ava_filter_ext(pb, e, e->e_attrs, &f->f_ava, f->f_type_handle, f->f_compiled,
+                                 LDAP_FILTER_APPROX, verify_access, only_check_access, access_check_done);
         break;
 
     case LDAP_FILTER_EXTENDED:
@@ -240,6 +240,20 @@ slapi_filter_test_ext(
 }
 
 
+/*
+ * Same as slapi_attr_type_cmp(type, a->a_type, SLAPI_TYPE_CMP_SUBTYPE).
+ * When both types are interned they have no options, and the subtype
+ * compare is just the compare of the handles.
+ */
+static inline int
+filter_type_cmp_subtype(const char *type, uint32_t type_handle, Slapi_Attr *a)
+{
+    if (type_handle && a->a_type_handle) {
+        return type_handle != a->a_type_handle;
+    }
+    return slapi_attr_type_cmp(type, a->a_type, SLAPI_TYPE_CMP_SUBTYPE);
+}
+
 int
 test_ava_filter(
     Slapi_PBlock *pb,
@@ -250,6 +264,27 @@ test_ava_filter(
     int verify_access,
     int only_check_access,
     int *access_check_done)
+{
+    return test_ava_filter_ext(pb, e, a, ava, attr_syntax_type_handle(ava->ava_type), NULL, ftype,
+                               verify_access, only_check_access, access_check_done);
+}
+
+/*
+ * test_ava_filter with the interned handle of the ava type (0 if none)
+ * and the compiled filter component (NULL if none)
+ */
+int
+test_ava_filter_ext(
+    Slapi_PBlock *pb,
+    Slapi_Entry *e,
+    Slapi_Attr *a,
+    struct ava *ava,
+    uint32_t type_handle,
+    filter_compiled *fc,
+    int ftype,
+    int verify_access,
+    int only_check_access,
+    int *access_check_done)
 {
     int rc;
 
@@ -263,8 +298,8 @@ test_ava_filter(
         if (!only_check_access) {
             rc = -1;
             for (; a != NULL; a = a->a_next) {
-                if (slapi_attr_type_cmp(ava->ava_type, a->a_type, SLAPI_TYPE_CMP_SUBTYPE) == 0) {
-                    rc = plugin_call_syntax_filter_ava(a, ftype, ava);
+                if (filter_type_cmp_subtype(ava->ava_type, type_handle, a) == 0) {
+                    rc = plugin_call_syntax_filter_ava_compiled(fc, a, ftype, ava);
                     if (rc == 0) {
                         break;
                     }
@@ -295,8 +330,8 @@ test_ava_filter(
 
         rc = -1;
         for (; a != NULL; a = a->a_next) {
-            if (slapi_attr_type_cmp(ava->ava_type, a->a_type, SLAPI_TYPE_CMP_SUBTYPE) == 0) {
-                rc = plugin_call_syntax_filter_ava(a, ftype, ava);
+            if (filter_type_cmp_subtype(ava->ava_type, type_handle, a) == 0) {
+                rc = plugin_call_syntax_filter_ava_compiled(fc, a, ftype, ava);
                 if (rc == 0) {
                     break;
                 }
@@ -641,11 +676,11 @@ test_substring_filter(
         if (!only_check_access) {
             rc = -1;
             for (a = e->e_attrs; a != NULL; a = a->a_next) {
-                if (slapi_attr_type_cmp(f->f_sub_type, a->a_type, SLAPI_TYPE_CMP_SUBTYPE) == 0) {
+                if (filter_type_cmp_subtype(f->f_sub_type, f->f_type_handle, a) == 0) {
                     /* covscan false positive: "plugin_call_syntax_filter_sub" frees "pb->pb_op". */
                     /* coverity[deref_arg] */
                     /* coverity[double_free] */
-                    rc = plugin_call_syntax_filter_sub(pb, a, &f->f_sub);
+                    rc = plugin_call_syntax_filter_sub_compiled(pb, f->f_compiled, a, &f->f_sub);
                     if (rc == 0) {
                         break;
                     }
@@ -675,11 +710,11 @@ test_substring_filter(
 
         rc = -1;
         for (a = e->e_attrs; a != NULL; a = a->a_next) {
-            if (slapi_attr_type_cmp(f->f_sub_type, a->a_type, SLAPI_TYPE_CMP_SUBTYPE) == 0) {
+            if (filter_type_cmp_subtype(f->f_sub_type, f->f_type_handle, a) == 0) {
                 /* covscan false positive: "plugin_call_syntax_filter_sub" frees "pb->pb_op". */
                 /* coverity[deref_arg] */
                 /* coverity[double_free] */
-                rc = plugin_call_syntax_filter_sub(pb, a, &f->f_sub);
+                rc = plugin_call_syntax_filter_sub_compiled(pb, f->f_compiled, a, &f->f_sub);
                 if (rc == 0 || rc == LDAP_TIMELIMIT_EXCEEDED) {
                     break;
                 }
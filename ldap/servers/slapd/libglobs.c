@@ -1227,6 +1227,26 @@ static struct config_get_and_set
      NULL, 0,
      (void **)&global_slapdFrontendConfig.maxsimplepaged_per_conn,
      CONFIG_INT, (ConfigGetFunc)config_get_maxsimplepaged_per_conn, SLAPD_DEFAULT_MAXSIMPLEPAGED_PER_CONN_STR, NULL},
+    {CONFIG_PWHASH_THREADS_ATTRIBUTE, config_set_pwhash_threads,
+     NULL, 0,
+     (void **)&global_slapdFrontendConfig.pwhash_threads,
+     CONFIG_INT, (ConfigGetFunc)config_get_pwhash_threads, SLAPD_DEFAULT_PWHASH_THREADS_STR, NULL},
+    {CONFIG_PWHASH_QUEUE_MAX_ATTRIBUTE, config_set_pwhash_queue_max,
+     NULL, 0,
+     (void **)&global_slapdFrontendConfig.pwhash_queue_max,
+     CONFIG_INT, (ConfigGetFunc)config_get_pwhash_queue_max, SLAPD_DEFAULT_PWHASH_QUEUE_MAX_STR, NULL},
+    {CONFIG_PWVERIFY_CACHE_TTL_ATTRIBUTE, config_set_pwverify_cache_ttl,
+     NULL, 0,
+     (void **)&global_slapdFrontendConfig.pwverify_cache_ttl,
+     CONFIG_INT, (ConfigGetFunc)config_get_pwverify_cache_ttl, SLAPD_DEFAULT_PWVERIFY_CACHE_TTL_STR, NULL},
+    {CONFIG_PWVERIFY_CACHE_MAX_ENTRIES_ATTRIBUTE, config_set_pwverify_cache_max_entries,
+     NULL, 0,
+     (void **)&global_slapdFrontendConfig.pwverify_cache_max_entries,
+     CONFIG_INT, (ConfigGetFunc)config_get_pwverify_cache_max_entries, SLAPD_DEFAULT_PWVERIFY_CACHE_MAX_ENTRIES_STR, NULL},
+    {CONFIG_PSEARCH_SENDER_THREADS_ATTRIBUTE, config_set_psearch_sender_threads,
+     NULL, 0,
+     (void **)&global_slapdFrontendConfig.psearch_sender_threads,
+     CONFIG_INT, (ConfigGetFunc)config_get_psearch_sender_threads, SLAPD_DEFAULT_PSEARCH_SENDER_THREADS_STR, NULL},
     {CONFIG_ENABLE_NUNC_STANS, config_set_enable_nunc_stans,
      NULL, 0,
      (void **)&global_slapdFrontendConfig.enable_nunc_stans,
@@ -1410,6 +1430,10 @@ static struct config_get_and_set
      NULL, 0,
      (void **)&global_slapdFrontendConfig.return_orig_dn,
      CONFIG_ON_OFF, (ConfigGetFunc)config_get_return_orig_dn, &init_return_orig_dn, NULL},
+    {CONFIG_REPL_APPLY_CONCURRENCY, config_set_repl_apply_concurrency,
+     NULL, 0,
+     (void **)&global_slapdFrontendConfig.repl_apply_concurrency, CONFIG_INT,
+     (ConfigGetFunc)config_get_repl_apply_concurrency, SLAPD_DEFAULT_REPL_APPLY_CONCURRENCY_STR, NULL},
     /* End config */
     };
 
@@ -1943,6 +1967,11 @@ FrontendConfig_init(void)
     init_cn_uses_dn_syntax_in_dns = cfg->cn_uses_dn_syntax_in_dns = LDAP_OFF;
     init_global_backend_local = LDAP_OFF;
     cfg->maxsimplepaged_per_conn = SLAPD_DEFAULT_MAXSIMPLEPAGED_PER_CONN;
+    cfg->pwhash_threads = SLAPD_DEFAULT_PWHASH_THREADS;
+    cfg->pwhash_queue_max = SLAPD_DEFAULT_PWHASH_QUEUE_MAX;
+    cfg->pwverify_cache_ttl = SLAPD_DEFAULT_PWVERIFY_CACHE_TTL;
+    cfg->pwverify_cache_max_entries = SLAPD_DEFAULT_PWVERIFY_CACHE_MAX_ENTRIES;
+    cfg->psearch_sender_threads = SLAPD_DEFAULT_PSEARCH_SENDER_THREADS;
     cfg->maxbersize = SLAPD_DEFAULT_MAXBERSIZE;
     cfg->logging_backend = slapi_ch_strdup(SLAPD_INIT_LOGGING_BACKEND_INTERNAL);
     cfg->rootdn = slapi_ch_strdup(SLAPD_DEFAULT_DIRECTORY_MANAGER);
@@ -1979,6 +2008,7 @@ FrontendConfig_init(void)
 
     cfg->tcp_fin_timeout = SLAPD_DEFAULT_TCP_FIN_TIMEOUT;
     cfg->tcp_keepalive_time = SLAPD_DEFAULT_TCP_KEEPALIVE_TIME;
+    cfg->repl_apply_concurrency = SLAPD_DEFAULT_REPL_APPLY_CONCURRENCY;
 
     /* Done, unlock!  */
     CFG_UNLOCK_WRITE(cfg);
@@ -8672,6 +8702,39 @@ config_get_tcp_keepalive_time()
     return retVal;
 }
 
+int32_t
+config_set_repl_apply_concurrency(const char *attrname, char *value, char *errorbuf, int apply)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    long concurrency;
+    char *endp;
+
+    if (config_value_is_null(attrname, value, errorbuf, 0)) {
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    errno = 0;
+    concurrency = strtol(value, &endp, 10);
+    if (*endp != '\0' || errno == ERANGE || concurrency < 1 || concurrency > 65535) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "%s: invalid value \"%s\", the number of replicated updates applied concurrently must range from 1 to 65535",
+                              attrname, value);
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    if (apply) {
+        slapi_atomic_store_32(&(slapdFrontendConfig->repl_apply_concurrency), concurrency, __ATOMIC_RELEASE);
+    }
+    return LDAP_SUCCESS;
+}
+
+int32_t
+config_get_repl_apply_concurrency()
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    return slapi_atomic_load_32(&(slapdFrontendConfig->repl_apply_concurrency), __ATOMIC_ACQUIRE);
+}
+
 /*
  * This function is intended to be used from the dse code modify callback.  It
  * is "optimized" for that case because it takes a berval** of values, which is
@@ -9213,6 +9276,188 @@ config_get_maxsimplepaged_per_conn()
     return retVal;
 }
 
+/*
+ * 0 keeps the password verifications on the worker threads, -1 uses as
+ * many threads as hardware threads. Only read at startup.
+ */
+int
+config_set_pwhash_threads(const char *attrname, char *value, char *errorbuf, int apply)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    long threads;
+    char *endp;
+
+    if (config_value_is_null(attrname, value, errorbuf, 0)) {
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    errno = 0;
+    threads = strtol(value, &endp, 10);
+    if (*endp != '\0' || errno == ERANGE || threads < -1 || threads > 1024) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "(%s) value (%s) is invalid, must range from -1 to 1024\n", attrname, value);
+        return LDAP_OPERATIONS_ERROR;
+    }
+    if (threads == -1) {
+        threads = util_get_hardware_threads();
+    }
+
+    if (apply) {
+        CFG_LOCK_WRITE(slapdFrontendConfig);
+        slapdFrontendConfig->pwhash_threads = threads;
+        CFG_UNLOCK_WRITE(slapdFrontendConfig);
+    }
+    return LDAP_SUCCESS;
+}
+
+int
+config_get_pwhash_threads()
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    int retVal;
+
+    CFG_LOCK_READ(slapdFrontendConfig);
+    retVal = slapdFrontendConfig->pwhash_threads;
+    CFG_UNLOCK_READ(slapdFrontendConfig);
+    return retVal;
+}
+
+/* 0 only limits the queue by the number of worker threads */
+int
+config_set_pwhash_queue_max(const char *attrname, char *value, char *errorbuf, int apply)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    long size;
+    char *endp;
+
+    if (config_value_is_null(attrname, value, errorbuf, 0)) {
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    errno = 0;
+    size = strtol(value, &endp, 10);
+    if (*endp != '\0' || errno == ERANGE || size < 0 || size > INT_MAX) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE, "(%s) value (%s) is invalid\n", attrname, value);
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    if (apply) {
+        slapi_atomic_store_32((int32_t *)&(slapdFrontendConfig->pwhash_queue_max), size, __ATOMIC_RELEASE);
+    }
+    return LDAP_SUCCESS;
+}
+
+int
+config_get_pwhash_queue_max()
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+
+    return slapi_atomic_load_32((int32_t *)&(slapdFrontendConfig->pwhash_queue_max), __ATOMIC_ACQUIRE);
+}
+
+/* 0 disables the bind verification cache */
+int
+config_set_pwverify_cache_ttl(const char *attrname, char *value, char *errorbuf, int apply)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    long ttl;
+    char *endp;
+
+    if (config_value_is_null(attrname, value, errorbuf, 0)) {
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    errno = 0;
+    ttl = strtol(value, &endp, 10);
+    if (*endp != '\0' || errno == ERANGE || ttl < 0 || ttl > 86400) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "(%s) value (%s) is invalid, must range from 0 to 86400\n", attrname, value);
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    if (apply) {
+        slapi_atomic_store_32((int32_t *)&(slapdFrontendConfig->pwverify_cache_ttl), ttl, __ATOMIC_RELEASE);
+    }
+    return LDAP_SUCCESS;
+}
+
+int
+config_get_pwverify_cache_ttl()
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+
+    return slapi_atomic_load_32((int32_t *)&(slapdFrontendConfig->pwverify_cache_ttl), __ATOMIC_ACQUIRE);
+}
+
+int
+config_set_pwverify_cache_max_entries(const char *attrname, char *value, char *errorbuf, int apply)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    long size;
+    char *endp;
+
+    if (config_value_is_null(attrname, value, errorbuf, 0)) {
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    errno = 0;
+    size = strtol(value, &endp, 10);
+    if (*endp != '\0' || errno == ERANGE || size < 0 || size > INT_MAX) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE, "(%s) value (%s) is invalid\n", attrname, value);
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    if (apply) {
+        slapi_atomic_store_32((int32_t *)&(slapdFrontendConfig->pwverify_cache_max_entries), size, __ATOMIC_RELEASE);
+    }
+    return LDAP_SUCCESS;
+}
+
+int
+config_get_pwverify_cache_max_entries()
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+
+    return slapi_atomic_load_32((int32_t *)&(slapdFrontendConfig->pwverify_cache_max_entries), __ATOMIC_ACQUIRE);
+}
+
+/*
+ * The sender threads are started with the persistent searches: a higher
+ * value starts more of them, the ones running are kept when it is lowered.
+ */
+int
+config_set_psearch_sender_threads(const char *attrname, char *value, char *errorbuf, int apply)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    long threads;
+    char *endp;
+
+    if (config_value_is_null(attrname, value, errorbuf, 0)) {
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    errno = 0;
+    threads = strtol(value, &endp, 10);
+    if (*endp != '\0' || errno == ERANGE || threads < 1 || threads > 1024) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "(%s) value (%s) is invalid, must range from 1 to 1024\n", attrname, value);
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    if (apply) {
+        slapi_atomic_store_32((int32_t *)&(slapdFrontendConfig->psearch_sender_threads), threads, __ATOMIC_RELEASE);
+    }
+    return LDAP_SUCCESS;
+}
+
+int
+config_get_psearch_sender_threads()
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+
+    return slapi_atomic_load_32((int32_t *)&(slapdFrontendConfig->psearch_sender_threads), __ATOMIC_ACQUIRE);
+}
+
 int32_t
 config_set_extract_pem(const char *attrname, char *value, char *errorbuf, int apply)
 {
@@ -36,6 +36,7 @@
 #include <sys/socket.h>
 #include "slap.h"
 #include "pratom.h"
+#include "pw_verify.h"
 #if defined(irix) || defined(aix)
 #include <time.h>
 #endif
@@ -1035,6 +1036,10 @@ op_shared_modify(Slapi_PBlock *pb, int pw_change, char *old_pw)
                     update_pw_info(pb, old_pw);
                 }
 
+                /* password, retry count, lock: forget the bind verification */
+                slapi_pblock_get(pb, SLAPI_MODIFY_TARGET_SDN, &sdn);
+                pw_verify_cache_invalidate(sdn);
+
                 slapi_pblock_get(pb, SLAPI_ENTRY_POST_OP, &pse);
                 do_ps_service(pse, NULL, LDAP_CHANGETYPE_MODIFY, 0);
             } else {
@@ -29,6 +29,7 @@
 #include <sys/socket.h>
 #include "slap.h"
 #include "pratom.h"
+#include "pw_verify.h"
 
 /* Forward declarations */
 static int rename_internal_pb(Slapi_PBlock *pb);
@@ -636,6 +637,9 @@ op_shared_rename(Slapi_PBlock *pb, int passin_args)
 
                 slapi_pblock_get(pb, SLAPI_ENTRY_POST_OP, &pse);
                 slapi_pblock_get(pb, SLAPI_ENTRY_PRE_OP, &ecopy);
+                if (ecopy) {
+                    pw_verify_cache_invalidate(slapi_entry_get_sdn_const(ecopy));
+                }
                 /* GGOODREPL persistent search system needs the changenumber, oops. */
                 do_ps_service(pse, ecopy, LDAP_CHANGETYPE_MODDN, 0);
             } else {
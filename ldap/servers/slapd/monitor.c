@@ -30,6 +30,7 @@
 #include <sys/socket.h>
 #include "slap.h"
 #include "fe.h"
+#include "pw_verify.h"
 
 int32_t
 monitor_info(Slapi_PBlock *pb __attribute__((unused)),
@@ -116,6 +117,9 @@ monitor_info(Slapi_PBlock *pb __attribute__((unused)),
 
     slapi_ch_free((void **)&cookie);
 
+    pw_hash_pool_monitor(e);
+    pw_verify_cache_monitor(e);
+
     *returncode = LDAP_SUCCESS;
     return SLAPI_DSE_CALLBACK_OK;
 }
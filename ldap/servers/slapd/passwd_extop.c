@@ -61,6 +61,7 @@ Slapi_PluginDesc passwdopdesc = {"passwd_modify_plugin", VENDOR, DS_PACKAGE_VERS
  * return 0, if the userpassword attribute contains the given pwd value
  * return -1, if userPassword attribute is absent for given Entry
  * return LDAP_INVALID_CREDENTIALS,if userPassword attribute and given pwd don't match
+ * return LDAP_BUSY, if too many password verifications are waiting
  */
 static int
 passwd_check_pwd(Slapi_Entry *targetEntry, const char *pwd)
@@ -76,7 +77,10 @@ passwd_check_pwd(Slapi_Entry *targetEntry, const char *pwd)
 
     if ((rc = slapi_entry_attr_find(targetEntry, SLAPI_USERPWD_ATTR, &attr)) == 0) { /* we have found the userPassword attribute and it has some value */
         bvals = attr_get_present_values(attr);
-        if (slapi_pw_find_sv(bvals, &cv) != 0) {
+        rc = pw_verify_find_sv(bvals, &cv);
+        if (rc == PW_HASH_POOL_BUSY) {
+            rc = LDAP_BUSY;
+        } else if (rc != 0) {
             rc = LDAP_INVALID_CREDENTIALS;
         }
     }
@@ -777,7 +781,7 @@ parse_req_done:
         ret = passwd_check_pwd(targetEntry, oldPasswd);
         if (ret) {
             /* No, then we fail this operation */
-            errMesg = "Invalid oldPasswd value.\n";
+            errMesg = (ret == LDAP_BUSY) ? "Too many password verifications in progress.\n" : "Invalid oldPasswd value.\n";
             rc = ret;
             goto free_and_return;
         }
@@ -77,6 +77,61 @@ plugin_call_syntax_get_compare_fn(
     return (0);
 }
 
+/*
+ * Pick the function testing an ava against the values of the attribute,
+ * and the plugin to call it with: the matching rule plugin if there is
+ * one, the syntax plugin otherwise. *ava_fn is NULL if there is none.
+ * Returns LDAP_PROTOCOL_ERROR for an ordering the attribute does not
+ * define, or an unknown filter type.
+ */
+static int
+plugin_syntax_filter_ava_fn(const Slapi_Attr *a, int ftype, struct slapdplugin **plugin, IFP *ava_fn)
+{
+    *plugin = a->a_plugin;
+    *ava_fn = NULL;
+
+    switch (ftype) {
+    case LDAP_FILTER_GE:
+    case LDAP_FILTER_LE:
+        if ((a->a_mr_ord_plugin == NULL) &&
+            ((a->a_plugin->plg_syntax_flags &
+              SLAPI_PLUGIN_SYNTAX_FLAG_ORDERING) == 0)) {
+            slapi_log_err(SLAPI_LOG_FILTER, "plugin_call_syntax_filter_ava",
+                          "<= attr (%s) has no ordering matching rule, and syntax does not define a compare function\n",
+                          a->a_type);
+            return LDAP_PROTOCOL_ERROR;
+        }
+        /* if the attribute has an ordering matching rule plugin, use that,
+           otherwise, just use the syntax plugin */
+        if (a->a_mr_ord_plugin != NULL) {
+            *plugin = a->a_mr_ord_plugin;
+            *ava_fn = a->a_mr_ord_plugin->plg_mr_filter_ava;
+        } else {
+            *plugin = a->a_plugin;
+            *ava_fn = a->a_plugin->plg_syntax_filter_ava;
+        }
+    /* FALLTHROUGH */
+    case LDAP_FILTER_EQUALITY:
+    case LDAP_FILTER_APPROX:
+        if (NULL == *ava_fn) {
+            /* if we have an equality matching rule plugin, use that,
+               otherwise, just use the syntax plugin */
+            if (a->a_mr_eq_plugin) {
+                *plugin = a->a_mr_eq_plugin;
+                *ava_fn = a->a_mr_eq_plugin->plg_mr_filter_ava;
+            } else {
+                *plugin = a->a_plugin;
+                *ava_fn = a->a_plugin->plg_syntax_filter_ava;
+            }
+        }
+        return 0;
+    default:
+        slapi_log_err(SLAPI_LOG_ERR, "plugin_call_syntax_filter_ava",
+                      "Unknown filter type %d\n", ftype);
+        return LDAP_PROTOCOL_ERROR;
+    }
+}
+
 int
 plugin_call_syntax_filter_ava(
     const Slapi_Attr *a,
@@ -96,6 +151,7 @@ plugin_call_syntax_filter_ava_sv(
 {
     int rc;
     IFP ava_fn = NULL;
+    struct slapdplugin *pi = NULL;
 
     slapi_log_err(SLAPI_LOG_FILTER,
                   "plugin_call_syntax_filter_ava_sv", "=> %s=%s\n", ava->ava_type,
@@ -114,8 +170,15 @@ plugin_call_syntax_filter_ava_sv(
         return (LDAP_PROTOCOL_ERROR); /* syntax unkonwn */
     }
 
+    rc = plugin_syntax_filter_ava_fn(a, ftype, &pi, &ava_fn);
+    if (rc != 0) {
+        slapi_log_err(SLAPI_LOG_FILTER,
+                      "plugin_call_syntax_filter_ava", "<= %d\n", rc);
+        return (rc);
+    }
+
     Slapi_PBlock *pipb = slapi_pblock_new();
-    slapi_pblock_set(pipb, SLAPI_PLUGIN, (void *)a->a_plugin);
+    slapi_pblock_set(pipb, SLAPI_PLUGIN, (void *)pi);
     if (ava->ava_private) {
         int filter_normalized = 0;
         int f_flags = 0;
@@ -125,64 +188,21 @@ plugin_call_syntax_filter_ava_sv(
     }
 
     rc = -1; /* does not match by default */
-    switch (ftype) {
-    case LDAP_FILTER_GE:
-    case LDAP_FILTER_LE:
-        if ((a->a_mr_ord_plugin == NULL) &&
-            ((a->a_plugin->plg_syntax_flags &
-              SLAPI_PLUGIN_SYNTAX_FLAG_ORDERING) == 0)) {
-            slapi_log_err(SLAPI_LOG_FILTER, "plugin_call_syntax_filter_ava",
-                          "<= attr (%s) has no ordering matching rule, and syntax does not define a compare function\n",
-                          a->a_type);
-            rc = LDAP_PROTOCOL_ERROR;
-            break;
-        }
-        /* if the attribute has an ordering matching rule plugin, use that,
-           otherwise, just use the syntax plugin */
-        if (a->a_mr_ord_plugin != NULL) {
-            slapi_pblock_set(pipb, SLAPI_PLUGIN, (void *)a->a_mr_ord_plugin);
-            ava_fn = a->a_mr_ord_plugin->plg_mr_filter_ava;
+    if (ava_fn != NULL) {
+        /* JCM - Maybe the plugin should use the attr value iterator too... */
+        Slapi_Value **va;
+        if (useDeletedValues) {
+            va = valueset_get_valuearray(&a->a_deleted_values);
         } else {
-            slapi_pblock_set(pipb, SLAPI_PLUGIN, (void *)a->a_plugin);
-            ava_fn = a->a_plugin->plg_syntax_filter_ava;
+            va = valueset_get_valuearray(&a->a_present_values);
         }
-    /* FALLTHROUGH */
-    case LDAP_FILTER_EQUALITY:
-    case LDAP_FILTER_APPROX:
-        if (NULL == ava_fn) {
-            /* if we have an equality matching rule plugin, use that,
-               otherwise, just use the syntax plugin */
-            if (a->a_mr_eq_plugin) {
-                slapi_pblock_set(pipb, SLAPI_PLUGIN, (void *)a->a_mr_eq_plugin);
-                ava_fn = a->a_mr_eq_plugin->plg_mr_filter_ava;
-            } else {
-                slapi_pblock_set(pipb, SLAPI_PLUGIN, (void *)a->a_plugin);
-                ava_fn = a->a_plugin->plg_syntax_filter_ava;
-            }
-        }
-
-        if (ava_fn != NULL) {
-            /* JCM - Maybe the plugin should use the attr value iterator too... */
-            Slapi_Value **va;
-            if (useDeletedValues) {
-                va = valueset_get_valuearray(&a->a_deleted_values);
-            } else {
-                va = valueset_get_valuearray(&a->a_present_values);
-            }
-            if (va != NULL) {
-                rc = (*ava_fn)(pipb, &ava->ava_value, va, ftype, retVal);
-            }
-        } else {
-            slapi_log_err(SLAPI_LOG_FILTER,
-                          "plugin_call_syntax_filter_ava", "attr (%s) has no ava filter function\n",
-                          a->a_type);
+        if (va != NULL) {
+            rc = (*ava_fn)(pipb, &ava->ava_value, va, ftype, retVal);
         }
-        break;
-    default:
-        slapi_log_err(SLAPI_LOG_ERR, "plugin_call_syntax_filter_ava",
-                      "Unknown filter type %d\n", ftype);
-        rc = LDAP_PROTOCOL_ERROR;
-        break;
+    } else {
+        slapi_log_err(SLAPI_LOG_FILTER,
+                      "plugin_call_syntax_filter_ava", "attr (%s) has no ava filter function\n",
+                      a->a_type);
     }
 
     slapi_log_err(SLAPI_LOG_FILTER,
@@ -263,6 +283,131 @@ plugin_call_syntax_filter_sub_sv(
     return (rc);
 }
 
+/*
+ * Resolve the filter function of an ava or substring filter component
+ * for the attributes of its type, with the pblock to call it with.
+ * Returns NULL if there is none: the tests of the component then go
+ * through plugin_call_syntax_filter_ava/_sub.
+ */
+filter_compiled *
+plugin_syntax_filter_compile(struct slapi_filter *f)
+{
+    filter_compiled *fc = NULL;
+    struct slapdplugin *pi = NULL;
+    IFP fn = NULL;
+    Slapi_Attr sattr = {0};
+
+    if (f->f_choice == LDAP_FILTER_SUBSTRINGS) {
+        slapi_attr_init(&sattr, f->f_sub_type);
+    } else {
+        slapi_attr_init(&sattr, f->f_avtype);
+    }
+    if (sattr.a_plugin == NULL) {
+        /* could be lazy plugin initialization, get it now */
+        slapi_attr_init_syntax(&sattr);
+    }
+
+    if (sattr.a_plugin == NULL) {
+        fn = NULL;
+    } else if (f->f_choice == LDAP_FILTER_SUBSTRINGS) {
+        if (sattr.a_mr_sub_plugin) {
+            pi = sattr.a_mr_sub_plugin;
+            fn = sattr.a_mr_sub_plugin->plg_mr_filter_sub;
+        } else {
+            pi = sattr.a_plugin;
+            fn = sattr.a_plugin->plg_syntax_filter_sub;
+        }
+    } else if (plugin_syntax_filter_ava_fn(&sattr, f->f_choice, &pi, &fn) != 0) {
+        fn = NULL;
+    }
+
+    if (fn != NULL) {
+        fc = (filter_compiled *)slapi_ch_calloc(1, sizeof(filter_compiled));
+        fc->fc_plugin = sattr.a_plugin;
+        fc->fc_mr_eq_plugin = sattr.a_mr_eq_plugin;
+        fc->fc_mr_ord_plugin = sattr.a_mr_ord_plugin;
+        fc->fc_mr_sub_plugin = sattr.a_mr_sub_plugin;
+        fc->fc_fn = fn;
+        fc->fc_pb = slapi_pblock_new();
+        slapi_pblock_set(fc->fc_pb, SLAPI_PLUGIN, (void *)pi);
+        if (f->f_choice == LDAP_FILTER_SUBSTRINGS) {
+            slapi_pblock_set(fc->fc_pb, SLAPI_PLUGIN_SYNTAX_FILTER_DATA, &f->f_sub);
+        } else if (f->f_ava.ava_private) {
+            int filter_normalized = *(int *)f->f_ava.ava_private | SLAPI_FILTER_NORMALIZED_VALUE;
+            slapi_pblock_set(fc->fc_pb, SLAPI_PLUGIN_SYNTAX_FILTER_NORMALIZED, &filter_normalized);
+        }
+    }
+    attr_done(&sattr);
+
+    return fc;
+}
+
+void
+plugin_syntax_filter_compiled_free(filter_compiled **fc)
+{
+    if (fc && *fc) {
+        slapi_pblock_destroy((*fc)->fc_pb);
+        slapi_ch_free((void **)fc);
+    }
+}
+
+/* The attribute would pick the same function: it has the same plugins */
+static int
+plugin_syntax_filter_compiled_for(const filter_compiled *fc, const Slapi_Attr *a)
+{
+    return a->a_plugin == fc->fc_plugin &&
+           a->a_mr_eq_plugin == fc->fc_mr_eq_plugin &&
+           a->a_mr_ord_plugin == fc->fc_mr_ord_plugin &&
+           a->a_mr_sub_plugin == fc->fc_mr_sub_plugin;
+}
+
+/*
+ * Same as plugin_call_syntax_filter_ava, with the function of the
+ * compiled filter component fc when it applies to the attribute.
+ */
+int
+plugin_call_syntax_filter_ava_compiled(filter_compiled *fc, const Slapi_Attr *a, int ftype, struct ava *ava)
+{
+    Slapi_Value **va;
+
+    if (NULL == fc || !plugin_syntax_filter_compiled_for(fc, a)) {
+        return plugin_call_syntax_filter_ava(a, ftype, ava);
+    }
+    va = valueset_get_valuearray(&a->a_present_values);
+    if (va == NULL) {
+        return (-1);
+    }
+    return (*fc->fc_fn)(fc->fc_pb, &ava->ava_value, va, ftype, NULL);
+}
+
+/*
+ * Same as plugin_call_syntax_filter_sub, with the function of the
+ * compiled filter component fc when it applies to the attribute.
+ */
+int
+plugin_call_syntax_filter_sub_compiled(Slapi_PBlock *pb, filter_compiled *fc, Slapi_Attr *a, struct subfilt *fsub)
+{
+    int filter_normalized = 0;
+    Operation *op = NULL;
+    int rc;
+
+    if (NULL == fc || !plugin_syntax_filter_compiled_for(fc, a)) {
+        return plugin_call_syntax_filter_sub(pb, a, fsub);
+    }
+    if (pb) {
+        slapi_pblock_get(pb, SLAPI_PLUGIN_SYNTAX_FILTER_NORMALIZED, &filter_normalized);
+        /* to pass SLAPI_SEARCH_TIMELIMIT & SLAPI_OPINITATED_TIME */
+        slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    }
+    slapi_pblock_set(fc->fc_pb, SLAPI_PLUGIN_SYNTAX_FILTER_NORMALIZED, &filter_normalized);
+    slapi_pblock_set(fc->fc_pb, SLAPI_OPERATION, op);
+    rc = (*fc->fc_fn)(fc->fc_pb, fsub->sf_initial, fsub->sf_any, fsub->sf_final,
+                      valueset_get_valuearray(&a->a_present_values));
+    /* Operation is owned by our caller */
+    slapi_pblock_set(fc->fc_pb, SLAPI_OPERATION, NULL);
+    return (rc);
+}
+
 /* Checks if the DN string is valid according to the Distinguished Name
  * syntax.  Setting override to 1 will force syntax checking to be performed,
  * even if syntax checking is disabled in the config.  Setting override to 0
@@ -96,6 +96,7 @@ int attr_syntax_create(const char *attr_oid, char *const *attr_names, const char
 void attr_syntax_free(struct asyntaxinfo *a);
 int attr_syntax_add(struct asyntaxinfo *asip, PRUint32 schema_flags);
 char *attr_syntax_normalize_no_lookup(const char *s);
+uint32_t attr_syntax_type_handle(const char *type);
 char *attr_syntax_normalize_no_lookup_ext(char *s, int flags);
 void attr_syntax_enumerate_attrs(AttrEnumFunc aef, void *arg, PRBool writelock);
 void attr_syntax_all_clear_flag(unsigned long flag);
@@ -413,6 +414,11 @@ int32_t config_set_maxdescriptors(const char *attrname, char *value, char *error
 int config_set_localuser(const char *attrname, char *value, char *errorbuf, int apply);
 
 int config_set_maxsimplepaged_per_conn(const char *attrname, char *value, char *errorbuf, int apply);
+int config_set_pwhash_threads(const char *attrname, char *value, char *errorbuf, int apply);
+int config_set_pwhash_queue_max(const char *attrname, char *value, char *errorbuf, int apply);
+int config_set_pwverify_cache_ttl(const char *attrname, char *value, char *errorbuf, int apply);
+int config_set_pwverify_cache_max_entries(const char *attrname, char *value, char *errorbuf, int apply);
+int config_set_psearch_sender_threads(const char *attrname, char *value, char *errorbuf, int apply);
 
 int log_external_libs_debug_set_log_fn(void);
 int log_set_backend(const char *attrname, char *value, int logtype, char *errorbuf, int apply);
@@ -616,6 +622,11 @@ int config_get_malloc_mmap_threshold(void);
 #endif
 
 int config_get_maxsimplepaged_per_conn(void);
+int config_get_pwhash_threads(void);
+int config_get_pwhash_queue_max(void);
+int config_get_pwverify_cache_ttl(void);
+int config_get_pwverify_cache_max_entries(void);
+int config_get_psearch_sender_threads(void);
 int config_get_extract_pem(void);
 
 int32_t config_get_enable_upgrade_hash(void);
@@ -636,6 +647,8 @@ int config_set_tcp_fin_timeout(const char *attrname, char *value, char *errorbuf
 int config_get_tcp_fin_timeout(void);
 int config_set_tcp_keepalive_time(const char *attrname, char *value, char *errorbuf, int apply);
 int config_get_tcp_keepalive_time(void);
+int32_t config_set_repl_apply_concurrency(const char *attrname, char *value, char *errorbuf, int apply);
+int32_t config_get_repl_apply_concurrency(void);
 
 int is_abspath(const char *);
 char *rel2abspath(char *);
@@ -711,6 +724,9 @@ void init_features(void);
 int get_filter(Connection *conn, BerElement *ber, int scope, struct slapi_filter **filt, char **fstr);
 void filter_print(struct slapi_filter *f);
 void filter_normalize(struct slapi_filter *f);
+void filter_compute_type_handle(struct slapi_filter *f);
+int filter_compile(struct slapi_filter *f, int *error_code);
+int filter_free_compiled(struct slapi_filter *f, int *error_code);
 
 
 /*
@@ -726,6 +742,7 @@ void set_hash_filters(int i);
 char *filter_strcpy_special(char *d, char *s);
 #define FILTER_STRCPY_ESCAPE_RECHARS 0x01
 char *filter_strcpy_special_ext(char *d, char *s, int flags);
+int test_ava_filter_ext(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Attr *a, struct ava *ava, uint32_t type_handle, filter_compiled *fc, int ftype, int verify_access, int only_check_access, int *access_check_done);
 
 
 /*
@@ -1009,6 +1026,10 @@ int plugin_call_syntax_filter_ava(const Slapi_Attr *a, int ftype, struct ava *av
 int plugin_call_syntax_filter_ava_sv(const Slapi_Attr *a, int ftype, struct ava *ava, Slapi_Value **retVal, int useDeletedValues);
 int plugin_call_syntax_filter_sub(Slapi_PBlock *pb, Slapi_Attr *a, struct subfilt *fsub);
 int plugin_call_syntax_filter_sub_sv(Slapi_PBlock *pb, Slapi_Attr *a, struct subfilt *fsub);
+filter_compiled *plugin_syntax_filter_compile(struct slapi_filter *f);
+void plugin_syntax_filter_compiled_free(filter_compiled **fc);
+int plugin_call_syntax_filter_ava_compiled(filter_compiled *fc, const Slapi_Attr *a, int ftype, struct ava *ava);
+int plugin_call_syntax_filter_sub_compiled(Slapi_PBlock *pb, filter_compiled *fc, Slapi_Attr *a, struct subfilt *fsub);
 int plugin_call_syntax_get_compare_fn(void *vpi, value_compare_fn_type *compare_fn);
 struct slapdplugin *plugin_syntax_find(const char *nameoroid);
 void plugin_syntax_enumerate(SyntaxEnumFunc sef, void *arg);
@@ -1044,6 +1065,14 @@ void add_password_attrs(Slapi_PBlock *pb, Operation *op, Slapi_Entry *e);
 
 int add_shadow_ext_password_attrs(Slapi_PBlock *pb, Slapi_Entry **e);
 
+/*
+ * pw_hashpool.c
+ */
+void pw_hash_pool_init(void);
+void pw_hash_pool_stop(void);
+int pw_hash_pool_cmp(struct pw_scheme *pwsp, const char *clear, char *encoded, int offload);
+void pw_hash_pool_monitor(Slapi_Entry *e);
+
 /*
  * pw_retry.c
  */
@@ -25,17 +25,27 @@
 #include "slap.h"
 #include "fe.h"
 
+/*
+ * A change matched by at least one persistent search.
+ * The entry and the "Entry Modify Notification" control
+ * are built once and shared by the queues of all the
+ * persistent searches the change is dispatched to.
+ */
+typedef struct _ps_change
+{
+    Slapi_Entry *pc_entry;
+    LDAPControl *pc_ctrl;
+    uint64_t pc_refcnt;
+} PSChange;
+
 /*
  * A structure used to create a linked list
- * of entries being sent by a particular persistent
- * search result thread.
- * The ctrl is an "Entry Modify Notification" control
- * which we may send back with entries.
+ * of changes being sent by a particular persistent
+ * search.
  */
 typedef struct _ps_entry_queue_node
 {
-    Slapi_Entry *pe_entry;
-    LDAPControl *pe_ctrls[2];
+    PSChange *pe_change;
     struct _ps_entry_queue_node *pe_next;
 } PSEQNode;
 
@@ -52,9 +62,31 @@ typedef struct _psearch
     time_t ps_lasttime;
     ber_int_t ps_changetypes;
     int ps_send_entchg_controls;
+    int ps_conn_acq_flag;           /* 0 if we hold a reference on the connection */
+    int ps_scheduled;               /* on the ready list or being served, protected by pl_cvarlock */
+    int ps_wakeup;                  /* scheduled again while being served, protected by pl_cvarlock */
+    struct _psgroup *ps_group;      /* subscription this search belongs to */
+    struct _psearch *ps_group_next; /* next member of the subscription */
+    struct _psearch *ps_ready_next; /* next search on the ready list */
     struct _psearch *ps_next;
 } PSearch;
 
+/*
+ * The persistent searches sharing the same base, scope and filter.
+ * The scope and the filter are evaluated once per group for each
+ * change, only the access control check is done per search.
+ */
+typedef struct _psgroup
+{
+    char *pg_key;
+    Slapi_DN *pg_base;
+    int pg_scope;
+    Slapi_Filter *pg_filter;
+    ber_int_t pg_changetypes; /* union of the members changetypes */
+    PSearch *pg_members;
+    struct _psgroup *pg_next;
+} PSGroup;
+
 /*
  * A list of outstanding persistent searches.
  */
@@ -62,8 +94,13 @@ typedef struct _psearch_list
 {
     Slapi_RWLock *pl_rwlock;     /* R/W lock struct to serialize access */
     PSearch *pl_head;            /* Head of list */
-    pthread_mutex_t pl_cvarlock; /* Lock for cvar */
-    pthread_cond_t pl_cvar;      /* ps threads sleep on this */
+    PSGroup *pl_groups;          /* Subscriptions, protected by pl_rwlock */
+    pthread_mutex_t pl_cvarlock; /* Lock for cvar and the ready list */
+    pthread_cond_t pl_cvar;      /* sender threads sleep on this */
+    PSearch *pl_ready_head;      /* searches waiting for a sender thread */
+    PSearch *pl_ready_tail;
+    int pl_senders;              /* number of running sender threads */
+    int pl_stopping;
 } PSearch_List;
 
 /*
@@ -74,6 +111,21 @@ typedef struct _psearch_list
 #define PSL_LOCK_WRITE() slapi_rwlock_wrlock(psearch_list->pl_rwlock)
 #define PSL_UNLOCK_WRITE() slapi_rwlock_unlock(psearch_list->pl_rwlock)
 
+/*
+ * The persistent searches are served by a small pool of sender
+ * threads (nsslapd-psearch-sender-threads). A sender sends at most
+ * PS_SEND_BATCH entries to a search before moving to the next one
+ * waiting on the ready list. A client that does not read its results
+ * is not waited for more than PS_SEND_WAIT milliseconds: its entries
+ * stay queued and the search goes back to the end of the ready list.
+ */
+#define PS_SEND_BATCH 64
+#define PS_SEND_WAIT 100
+
+/* Result of ps_send_results() */
+#define PS_SEND_IDLE 0 /* the queue is empty */
+#define PS_SEND_MORE 1 /* entries remain in the queue */
+#define PS_SEND_DONE 2 /* the persistent search is over */
 
 /*
  * Convenience macro for checking if the Persistent Search subsystem has
@@ -85,10 +137,18 @@ typedef struct _psearch_list
 static PSearch_List *psearch_list = NULL;
 
 /* Forward declarations */
-static void ps_send_results(void *arg);
+static void ps_sender(void *arg);
+static int ps_start_senders(void);
+static int ps_send_results(PSearch *ps);
+static int ps_conn_writable(Connection *conn);
+static void ps_release(PSearch *ps);
+static void ps_schedule(PSearch *ps);
 static PSearch *psearch_alloc(void);
 static void ps_add_ps(PSearch *ps);
 static void ps_remove(PSearch *dps);
+static void ps_group_add(PSearch *ps);
+static void ps_group_remove(PSearch *ps);
+static void ps_change_release(PSChange *pc);
 static void pe_ch_free(PSEQNode **pe);
 static int create_entrychange_control(ber_int_t chgtype, ber_int_t chgnum, const char *prevdn, LDAPControl **ctrlp);
 
@@ -124,6 +184,8 @@ ps_init_psearch_system()
             exit(1);
         }
         psearch_list->pl_head = NULL;
+        psearch_list->pl_groups = NULL;
+        psearch_list->pl_ready_head = psearch_list->pl_ready_tail = NULL;
     }
 }
 
@@ -131,6 +193,7 @@ ps_init_psearch_system()
 /*
  * Close all outstanding persistent searches.
  * To be used when the server is shutting down.
+ * The sender threads release the searches and exit.
  */
 void
 ps_stop_psearch_system()
@@ -144,21 +207,39 @@ ps_stop_psearch_system()
         }
         PSL_UNLOCK_WRITE();
         ps_wakeup_all();
+
+        pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+        psearch_list->pl_stopping = 1;
+        pthread_cond_broadcast(&(psearch_list->pl_cvar));
+        pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
     }
 }
 
 /*
  * Add the given pblock to the list of outstanding persistent searches.
- * Then, start a thread to send the results to the client as they
- * are dispatched by add, modify, and modrdn operations.
+ * The results are then sent to the client by the sender threads as
+ * they are dispatched by add, modify, and modrdn operations.
  */
 void
 ps_add(Slapi_PBlock *pb, ber_int_t changetypes, int send_entchg_controls)
 {
     PSearch *ps;
-    PRThread *ps_tid;
+    Connection *pb_conn = NULL;
+    Operation *pb_op = NULL;
 
     if (PS_IS_INITIALIZED() && NULL != pb) {
+        slapi_pblock_get(pb, SLAPI_CONNECTION, &pb_conn);
+        slapi_pblock_get(pb, SLAPI_OPERATION, &pb_op);
+        if (pb_conn == NULL) {
+            slapi_log_err(SLAPI_LOG_ERR, "ps_add", "pb_conn is NULL\n");
+            return;
+        }
+
+        /* Make sure there are threads to send the results */
+        if (ps_start_senders() == 0) {
+            return; /* Error is logged by ps_start_senders */
+        }
+
         /* Create the new node */
         ps = psearch_alloc();
         if (!ps) {
@@ -168,39 +249,62 @@ ps_add(Slapi_PBlock *pb, ber_int_t changetypes, int send_entchg_controls)
         ps->ps_changetypes = changetypes;
         ps->ps_send_entchg_controls = send_entchg_controls;
 
+        /* need to acquire a reference to this connection so that it will not
+           be released or cleaned up out from under us */
+        pthread_mutex_lock(&(pb_conn->c_mutex));
+        ps->ps_conn_acq_flag = connection_acquire_nolock(pb_conn);
+        pthread_mutex_unlock(&(pb_conn->c_mutex));
+
         /* Add it to the head of the list of persistent searches */
         ps_add_ps(ps);
 
-        /* Start a thread to send the results */
-        ps_tid = PR_CreateThread(PR_USER_THREAD, ps_send_results,
-                                 (void *)ps, PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
-                                 PR_UNJOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+        if (ps->ps_conn_acq_flag) {
+            slapi_log_err(SLAPI_LOG_CONNS, "ps_add",
+                          "conn=%" PRIu64 " op=%d Could not acquire the connection - psearch aborted\n",
+                          pb_conn->c_connid, pb_op ? pb_op->o_opid : -1);
+            /* let a sender release it */
+            ps_schedule(ps);
+        }
+    }
+}
+
+
+/*
+ * Start the sender threads that are not running yet.
+ * Returns the number of running sender threads.
+ */
+static int
+ps_start_senders(void)
+{
+    int max_senders = config_get_psearch_sender_threads();
+    int senders;
+
+    pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+    while (psearch_list->pl_senders < max_senders && !psearch_list->pl_stopping) {
+        PRThread *ps_tid = PR_CreateThread(PR_USER_THREAD, ps_sender,
+                                           NULL, PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                           PR_UNJOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
 
-        /* Checking if the thread is succesfully created and
-         * if the thread is not created succesfully.... we send
-         * error messages to the Log file
-         */
         if (NULL == ps_tid) {
             int prerr;
             prerr = PR_GetError();
-            slapi_log_err(SLAPI_LOG_ERR, "ps_add", "PR_CreateThread()failed in the "
-                                                   "ps_add function: " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+            slapi_log_err(SLAPI_LOG_ERR, "ps_start_senders", "PR_CreateThread()failed in the "
+                                                             "ps_start_senders function: " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
                           prerr, slapd_pr_strerror(prerr));
-
-            /* Now remove the ps from the list so call the function ps_remove */
-            ps_remove(ps);
-            PR_DestroyLock(ps->ps_lock);
-            ps->ps_lock = NULL;
-            slapi_ch_free((void **)&ps->ps_pblock);
-            slapi_ch_free((void **)&ps);
+            break;
         }
+        psearch_list->pl_senders++;
     }
+    senders = psearch_list->pl_stopping ? 0 : psearch_list->pl_senders;
+    pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+
+    return senders;
 }
 
 
 /*
  * Remove the given PSearch from the list of outstanding persistent
- * searches and delete its resources.
+ * searches and from its subscription.
  */
 static void
 ps_remove(PSearch *dps)
@@ -224,10 +328,121 @@ ps_remove(PSearch *dps)
                 }
             }
         }
+        ps_group_remove(dps);
         PSL_UNLOCK_WRITE();
     }
 }
 
+/*
+ * Add the persistent search to the subscription with the same
+ * base, scope and filter, creating it if needed.
+ * Called with the list write locked.
+ */
+static void
+ps_group_add(PSearch *ps)
+{
+    PSGroup *pg;
+    Slapi_DN *base = NULL;
+    Slapi_Filter *f = NULL;
+    char *origbase = NULL;
+    char *fstr = NULL;
+    char *key;
+    int scope = 0;
+
+    slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_FILTER, &f);
+    slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_STRFILTER, &fstr);
+    slapi_pblock_get(ps->ps_pblock, SLAPI_ORIGINAL_TARGET_DN, &origbase);
+    slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_TARGET_SDN, &base);
+    slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_SCOPE, &scope);
+    if (NULL == base) {
+        base = slapi_sdn_new_dn_byref(origbase);
+        slapi_pblock_set(ps->ps_pblock, SLAPI_SEARCH_TARGET_SDN, base);
+    }
+
+    if (fstr) {
+        key = slapi_ch_smprintf("%d:%s:%s", scope, slapi_sdn_get_ndn(base), fstr);
+    } else {
+        /* no string filter to compare, the search gets its own group */
+        key = slapi_ch_smprintf("%d:%s:%p", scope, slapi_sdn_get_ndn(base), ps);
+    }
+    for (pg = psearch_list->pl_groups; NULL != pg; pg = pg->pg_next) {
+        if (strcmp(pg->pg_key, key) == 0) {
+            break;
+        }
+    }
+    if (NULL == pg) {
+        pg = (PSGroup *)slapi_ch_calloc(1, sizeof(PSGroup));
+        pg->pg_key = key;
+        pg->pg_base = slapi_sdn_dup(base);
+        pg->pg_scope = scope;
+        pg->pg_filter = slapi_filter_dup(f);
+        pg->pg_next = psearch_list->pl_groups;
+        psearch_list->pl_groups = pg;
+    } else {
+        slapi_ch_free_string(&key);
+    }
+    pg->pg_changetypes |= ps->ps_changetypes;
+    ps->ps_group_next = pg->pg_members;
+    pg->pg_members = ps;
+    ps->ps_group = pg;
+}
+
+/*
+ * Remove the persistent search from its subscription,
+ * freeing the subscription when it was the last member.
+ * Called with the list write locked.
+ */
+static void
+ps_group_remove(PSearch *ps)
+{
+    PSGroup *pg = ps->ps_group;
+    PSGroup **pgp;
+    PSearch **psp;
+
+    if (NULL == pg) {
+        return;
+    }
+    pg->pg_changetypes = 0;
+    for (psp = &pg->pg_members; NULL != *psp;) {
+        if (*psp == ps) {
+            *psp = ps->ps_group_next;
+        } else {
+            pg->pg_changetypes |= (*psp)->ps_changetypes;
+            psp = &(*psp)->ps_group_next;
+        }
+    }
+    ps->ps_group = NULL;
+    ps->ps_group_next = NULL;
+
+    if (NULL == pg->pg_members) {
+        for (pgp = &psearch_list->pl_groups; NULL != *pgp; pgp = &(*pgp)->pg_next) {
+            if (*pgp == pg) {
+                *pgp = pg->pg_next;
+                break;
+            }
+        }
+        slapi_ch_free_string(&pg->pg_key);
+        slapi_sdn_free(&pg->pg_base);
+        slapi_filter_free(pg->pg_filter, 1);
+        slapi_ch_free((void **)&pg);
+    }
+}
+
+/*
+ * Drop a reference on a shared change, freeing it with the last one.
+ */
+static void
+ps_change_release(PSChange *pc)
+{
+    if (pc != NULL && slapi_atomic_decr_64(&(pc->pc_refcnt), __ATOMIC_ACQ_REL) == 0) {
+        slapi_entry_free(pc->pc_entry);
+        if (pc->pc_ctrl != NULL) {
+            ldap_control_free(pc->pc_ctrl);
+        }
+        slapi_ch_free((void **)&pc);
+    }
+}
+
 /*
  * Free a persistent search node (and everything it holds).
  */
@@ -235,145 +450,258 @@ static void
 pe_ch_free(PSEQNode **pe)
 {
     if (pe != NULL && *pe != NULL) {
-        if ((*pe)->pe_entry != NULL) {
-            slapi_entry_free((*pe)->pe_entry);
-            (*pe)->pe_entry = NULL;
+        ps_change_release((*pe)->pe_change);
+        (*pe)->pe_change = NULL;
+        slapi_ch_free((void **)pe);
+    }
+}
+
+
+/*
+ * Put the persistent search on the ready list and wake
+ * up a sender thread. A search already scheduled is only
+ * flagged, so that it is looked at again once served.
+ */
+static void
+ps_schedule(PSearch *ps)
+{
+    pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+    if (ps->ps_scheduled) {
+        ps->ps_wakeup = 1;
+    } else {
+        ps->ps_scheduled = 1;
+        ps->ps_ready_next = NULL;
+        if (NULL == psearch_list->pl_ready_tail) {
+            psearch_list->pl_ready_head = ps;
+        } else {
+            psearch_list->pl_ready_tail->ps_ready_next = ps;
         }
+        psearch_list->pl_ready_tail = ps;
+        pthread_cond_signal(&(psearch_list->pl_cvar));
+    }
+    pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+}
 
-        if ((*pe)->pe_ctrls[0] != NULL) {
-            ldap_control_free((*pe)->pe_ctrls[0]);
-            (*pe)->pe_ctrls[0] = NULL;
+
+/*
+ * Thread routine of the sender threads. Serve the
+ * persistent searches from the ready list, one at a
+ * time for a given search so the entries are sent
+ * in order. The thread exits when the system is
+ * stopping and no search is left to serve.
+ */
+static void
+ps_sender(void *arg __attribute__((unused)))
+{
+    PSearch *ps;
+    int rc;
+
+    g_incr_active_threadcnt();
+
+    pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+    for (;;) {
+        while (NULL == psearch_list->pl_ready_head && !psearch_list->pl_stopping) {
+            pthread_cond_wait(&(psearch_list->pl_cvar), &(psearch_list->pl_cvarlock));
+        }
+        ps = psearch_list->pl_ready_head;
+        if (NULL == ps) {
+            /* stopping, and every search was released */
+            break;
         }
+        psearch_list->pl_ready_head = ps->ps_ready_next;
+        if (NULL == psearch_list->pl_ready_head) {
+            psearch_list->pl_ready_tail = NULL;
+        }
+        ps->ps_ready_next = NULL;
+        ps->ps_wakeup = 0;
 
-        slapi_ch_free((void **)pe);
+        /*
+         * Send the results.  Since send_ldap_search_entry can block for
+         * up to 30 minutes, we relinquish all locks before calling it.
+         */
+        pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+        rc = ps_send_results(ps);
+        if (rc == PS_SEND_DONE) {
+            ps_release(ps);
+            pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+            continue;
+        }
+        pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+
+        if (rc == PS_SEND_MORE || ps->ps_wakeup) {
+            /* back to the end of the ready list */
+            ps->ps_wakeup = 0;
+            if (NULL == psearch_list->pl_ready_tail) {
+                psearch_list->pl_ready_head = ps;
+            } else {
+                psearch_list->pl_ready_tail->ps_ready_next = ps;
+            }
+            psearch_list->pl_ready_tail = ps;
+        } else {
+            ps->ps_scheduled = 0;
+        }
     }
+    psearch_list->pl_senders--;
+    pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+
+    g_decr_active_threadcnt();
 }
 
 
 /*
- * Thread routine for sending search results to a client
- * which is persistently waiting for them.
+ * Send the queued entries to the client which is
+ * persistently waiting for them.
  *
- * This routine will terminate when either (a) the ps_complete
+ * Returns PS_SEND_DONE when either (a) the ps_complete
  * flag is set, or (b) the associated operation is abandoned.
- * In any case, the thread won't notice until it wakes from
- * sleeping on the ps_list condition variable, so it needs
- * to be awakened.
+ * Otherwise at most PS_SEND_BATCH entries are sent, and
+ * PS_SEND_MORE is returned if entries remain in the queue.
  */
-static void
-ps_send_results(void *arg)
+static int
+ps_send_results(PSearch *ps)
 {
-    PSearch *ps = (PSearch *)arg;
-    PSEQNode *peq, *peqnext;
-    struct slapi_filter *filter = 0;
-    char *base = NULL;
-    Slapi_DN *sdn = NULL;
-    char *fstr = NULL;
-    char **pbattrs = NULL;
-    int conn_acq_flag = 0;
-    Slapi_Connection *conn = NULL;
+    PSEQNode *peq;
     Connection *pb_conn = NULL;
     Operation *pb_op = NULL;
+    int sent;
 
-    g_incr_active_threadcnt();
+    if (ps->ps_conn_acq_flag) {
+        /* the connection could not be acquired in ps_add */
+        return PS_SEND_DONE;
+    }
 
     slapi_pblock_get(ps->ps_pblock, SLAPI_CONNECTION, &pb_conn);
     slapi_pblock_get(ps->ps_pblock, SLAPI_OPERATION, &pb_op);
 
-    if (pb_conn == NULL) {
-        slapi_log_err(SLAPI_LOG_ERR, "ps_send_results", "pb_conn is NULL\n");
-        return;
-    }
-
-    /* need to acquire a reference to this connection so that it will not
-       be released or cleaned up out from under us */
-    pthread_mutex_lock(&(pb_conn->c_mutex));
-    conn_acq_flag = connection_acquire_nolock(pb_conn);
-    pthread_mutex_unlock(&(pb_conn->c_mutex));
-
-    if (conn_acq_flag) {
-        slapi_log_err(SLAPI_LOG_CONNS, "ps_send_results",
-                      "conn=%" PRIu64 " op=%d Could not acquire the connection - psearch aborted\n",
-                      pb_conn->c_connid, pb_op ? pb_op->o_opid : -1);
-    }
+    for (sent = 0;; sent++) {
+        int attrsonly;
+        char **attrs;
+        LDAPControl *ctrls[2] = {NULL, NULL};
+        LDAPControl **ectrls = NULL;
+        Slapi_Entry *ec;
+        Slapi_Filter *f = NULL;
 
-    pthread_mutex_lock(&(psearch_list->pl_cvarlock));
-
-    while ((conn_acq_flag == 0) && slapi_atomic_load_64(&(ps->ps_complete), __ATOMIC_ACQUIRE) == 0) {
+        if (slapi_atomic_load_64(&(ps->ps_complete), __ATOMIC_ACQUIRE)) {
+            return PS_SEND_DONE;
+        }
         /* Check for an abandoned operation */
         if (pb_op == NULL || slapi_op_abandoned(ps->ps_pblock)) {
             slapi_log_err(SLAPI_LOG_CONNS, "ps_send_results",
                           "conn=%" PRIu64 " op=%d The operation has been abandoned\n",
                           pb_conn->c_connid, pb_op ? pb_op->o_opid : -1);
-            break;
+            return PS_SEND_DONE;
         }
-        if (NULL == ps->ps_eq_head) {
-            /* Nothing to do */
-            pthread_cond_wait(&(psearch_list->pl_cvar), &(psearch_list->pl_cvarlock));
-        } else {
-            /* dequeue the item */
-            int attrsonly;
-            char **attrs;
-            LDAPControl **ectrls;
-            Slapi_Entry *ec;
-            Slapi_Filter *f = NULL;
 
-            PR_Lock(ps->ps_lock);
+        /* dequeue the item */
+        PR_Lock(ps->ps_lock);
+        peq = ps->ps_eq_head;
+        if (NULL == peq) {
+            PR_Unlock(ps->ps_lock);
+            return PS_SEND_IDLE;
+        }
+        if (sent == PS_SEND_BATCH) {
+            /* let the other searches have their turn */
+            PR_Unlock(ps->ps_lock);
+            return PS_SEND_MORE;
+        }
+        PR_Unlock(ps->ps_lock);
 
-            peq = ps->ps_eq_head;
-            ps->ps_eq_head = peq->pe_next;
-            if (NULL == ps->ps_eq_head) {
-                ps->ps_eq_tail = NULL;
-            }
+        /* Only this thread dequeues, the entry stays at the head */
+        if (!ps_conn_writable(pb_conn)) {
+            slapi_log_err(SLAPI_LOG_CONNS, "ps_send_results",
+                          "conn=%" PRIu64 " op=%d The client is not reading, deferring its results\n",
+                          pb_conn->c_connid, pb_op->o_opid);
+            return PS_SEND_MORE;
+        }
 
-            PR_Unlock(ps->ps_lock);
+        PR_Lock(ps->ps_lock);
+        ps->ps_eq_head = peq->pe_next;
+        if (NULL == ps->ps_eq_head) {
+            ps->ps_eq_tail = NULL;
+        }
+        PR_Unlock(ps->ps_lock);
+
+        /* Get all the information we need to send the result */
+        ec = peq->pe_change->pc_entry;
+        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_ATTRS, &attrs);
+        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_ATTRSONLY, &attrsonly);
+        if (ps->ps_send_entchg_controls && peq->pe_change->pc_ctrl != NULL) {
+            ctrls[0] = peq->pe_change->pc_ctrl;
+            ectrls = ctrls;
+        }
 
-            /* Get all the information we need to send the result */
-            ec = peq->pe_entry;
-            slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_ATTRS, &attrs);
-            slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_ATTRSONLY, &attrsonly);
-            if (!ps->ps_send_entchg_controls || peq->pe_ctrls[0] == NULL) {
-                ectrls = NULL;
-            } else {
-                ectrls = peq->pe_ctrls;
-            }
+        /*
+         * The entry is in the right scope and matches the filter
+         * but we need to redo the filter test here to check access
+         * controls. See the comments at the slapi_filter_test()
+         * call in ps_service_persistent_searches().
+        */
+        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_FILTER, &f);
 
-            /*
-             * Send the result.  Since send_ldap_search_entry can block for
-             * up to 30 minutes, we relinquish all locks before calling it.
-             */
-            pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
-
-            /*
-             * The entry is in the right scope and matches the filter
-             * but we need to redo the filter test here to check access
-             * controls. See the comments at the slapi_filter_test()
-             * call in ps_service_persistent_searches().
-            */
-            slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_FILTER, &f);
-
-            /* See if the entry meets the filter and ACL criteria */
-            if (slapi_vattr_filter_test(ps->ps_pblock, ec, f,
-                                        1 /* verify_access */) == 0) {
-                int rc = 0;
-                slapi_pblock_set(ps->ps_pblock, SLAPI_SEARCH_RESULT_ENTRY, ec);
-                rc = send_ldap_search_entry(ps->ps_pblock, ec,
-                                            ectrls, attrs, attrsonly);
-                if (rc) {
-                    slapi_log_err(SLAPI_LOG_CONNS, "ps_send_results",
-                                  "conn=%" PRIu64 " op=%d Error %d sending entry %s with op status %d\n",
-                                  pb_conn->c_connid, pb_op ? pb_op->o_opid: -1,
-                                  rc, slapi_entry_get_dn_const(ec), pb_op ? pb_op->o_status : -1);
-                }
+        /* See if the entry meets the filter and ACL criteria */
+        if (slapi_vattr_filter_test(ps->ps_pblock, ec, f,
+                                    1 /* verify_access */) == 0) {
+            int rc = 0;
+            slapi_pblock_set(ps->ps_pblock, SLAPI_SEARCH_RESULT_ENTRY, ec);
+            rc = send_ldap_search_entry(ps->ps_pblock, ec,
+                                        ectrls, attrs, attrsonly);
+            if (rc) {
+                slapi_log_err(SLAPI_LOG_CONNS, "ps_send_results",
+                              "conn=%" PRIu64 " op=%d Error %d sending entry %s with op status %d\n",
+                              pb_conn->c_connid, pb_op->o_opid,
+                              rc, slapi_entry_get_dn_const(ec), pb_op->o_status);
             }
+        }
+        slapi_pblock_set(ps->ps_pblock, SLAPI_SEARCH_RESULT_ENTRY, NULL);
 
-            pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+        /* Deallocate our wrapper for this entry */
+        pe_ch_free(&peq);
+    }
+}
 
-            /* Deallocate our wrapper for this entry */
-            pe_ch_free(&peq);
-        }
+
+/*
+ * Wait at most PS_SEND_WAIT milliseconds for the connection to accept
+ * more data, so that a client which does not read its results does not
+ * hold a sender thread. An error is left to the send to report.
+ */
+static int
+ps_conn_writable(Connection *conn)
+{
+    PRPollDesc pr_pd;
+
+    if (NULL == conn->c_prfd) {
+        return 1;
     }
-    pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+    pr_pd.fd = conn->c_prfd;
+    pr_pd.in_flags = PR_POLL_WRITE;
+    pr_pd.out_flags = 0;
+    return PR_Poll(&pr_pd, 1, PR_MillisecondsToInterval(PS_SEND_WAIT)) != 0;
+}
+
+
+/*
+ * The persistent search is over: remove it from the list,
+ * release its operation and connection, and free it.
+ * Called by the sender thread serving it.
+ */
+static void
+ps_release(PSearch *ps)
+{
+    PSEQNode *peq, *peqnext;
+    struct slapi_filter *filter = 0;
+    char *base = NULL;
+    Slapi_DN *sdn = NULL;
+    char *fstr = NULL;
+    char **pbattrs = NULL;
+    Slapi_Connection *conn = NULL;
+    Connection *pb_conn = NULL;
+    Operation *pb_op = NULL;
+
+    slapi_pblock_get(ps->ps_pblock, SLAPI_CONNECTION, &pb_conn);
+    slapi_pblock_get(ps->ps_pblock, SLAPI_OPERATION, &pb_op);
+
+    /* once removed, no change can be dispatched to it anymore */
     ps_remove(ps);
 
     /* indicate the end of search */
@@ -408,14 +736,14 @@ ps_send_results(void *arg)
     /* Clean up the connection structure */
     pthread_mutex_lock(&(conn->c_mutex));
 
-    slapi_log_err(SLAPI_LOG_CONNS, "ps_send_results",
+    slapi_log_err(SLAPI_LOG_CONNS, "ps_release",
                   "conn=%" PRIu64 " op=%d Releasing the connection and operation\n",
                   conn->c_connid, pb_op ? pb_op->o_opid : -1);
     /* Delete this op from the connection's list */
     connection_remove_operation_ext(ps->ps_pblock, conn, pb_op);
 
     /* Decrement the connection refcnt */
-    if (conn_acq_flag == 0) { /* we acquired it, so release it */
+    if (ps->ps_conn_acq_flag == 0) { /* we acquired it, so release it */
         connection_release_nolock(conn);
     }
     pthread_mutex_unlock(&(conn->c_mutex));
@@ -430,7 +758,6 @@ ps_send_results(void *arg)
         pe_ch_free(&peq);
     }
     slapi_ch_free((void **)&ps);
-    g_decr_active_threadcnt();
 }
 
 
@@ -461,7 +788,8 @@ psearch_alloc(void)
 
 /*
  * Add the given persistent search to the
- * head of the list of persistent searches.
+ * head of the list of persistent searches
+ * and to its subscription.
  */
 static void
 ps_add_ps(PSearch *ps)
@@ -470,33 +798,40 @@ ps_add_ps(PSearch *ps)
         PSL_LOCK_WRITE();
         ps->ps_next = psearch_list->pl_head;
         psearch_list->pl_head = ps;
+        ps_group_add(ps);
         PSL_UNLOCK_WRITE();
     }
 }
 
 
 /*
- * Wake up all threads sleeping on
- * the psearch_list condition variable.
+ * Schedule all the persistent searches, so that the
+ * sender threads notice the abandoned or completed ones.
  */
 void
 ps_wakeup_all()
 {
+    PSearch *ps;
+
     if (PS_IS_INITIALIZED()) {
-        pthread_mutex_lock(&(psearch_list->pl_cvarlock));
-        pthread_cond_broadcast(&(psearch_list->pl_cvar));
-        pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+        PSL_LOCK_READ();
+        for (ps = psearch_list->pl_head; NULL != ps; ps = ps->ps_next) {
+            ps_schedule(ps);
+        }
+        PSL_UNLOCK_READ();
     }
 }
 
 
 /*
  * Check if there are any persistent searches.  If so,
- * the check to see if the chgtype is one of those the
- * client is interested in.  If so, then check to see if
- * the entry matches any of the filters the searches.
- * If so, then enqueue the entry on that persistent search's
- * ps_entryqueue and signal it to wake up and send the entry.
+ * for each subscription (base, scope and filter shared
+ * by a set of persistent searches) check if the entry
+ * is in scope and matches the filter.  If so, then
+ * enqueue the entry on the queue of the searches of
+ * the subscription interested in the chgtype, and
+ * schedule them to be served by the sender threads.
+ * The entry and the control are shared by all queues.
  *
  * Note that if eprev is NULL we assume that the entry's DN
  * was not changed by the op. that called this function.  If
@@ -506,9 +841,10 @@ ps_wakeup_all()
 void
 ps_service_persistent_searches(Slapi_Entry *e, Slapi_Entry *eprev, ber_int_t chgtype, ber_int_t chgnum)
 {
-    LDAPControl *ctrl = NULL;
+    PSChange *pc = NULL;
+    PSGroup *pg = NULL;
     PSearch *ps = NULL;
-    PSEQNode *pe = NULL;
+    int ctrl_done = 0;
     int matched = 0;
     const char *edn;
 
@@ -526,83 +862,81 @@ ps_service_persistent_searches(Slapi_Entry *e, Slapi_Entry *eprev, ber_int_t chg
     PSL_LOCK_READ();
     edn = slapi_entry_get_dn_const(e);
 
-    for (ps = psearch_list ? psearch_list->pl_head : NULL; NULL != ps; ps = ps->ps_next) {
-        char *origbase = NULL;
-        Slapi_DN *base = NULL;
-        Slapi_Filter *f;
-        int scope;
-        Connection *pb_conn = NULL;
-        Operation *pb_op = NULL;
-
-        slapi_pblock_get(ps->ps_pblock, SLAPI_OPERATION, &pb_op);
-        slapi_pblock_get(ps->ps_pblock, SLAPI_CONNECTION, &pb_conn);
-
-        /* Skip the node that doesn't meet the changetype,
-         * or is unable to use the change in ps_send_results()
-         */
-        if ((ps->ps_changetypes & chgtype) == 0 || pb_op == NULL ||
-            slapi_op_abandoned(ps->ps_pblock)) {
+    for (pg = psearch_list->pl_groups; NULL != pg; pg = pg->pg_next) {
+        /* Skip the subscription if none of its searches wants the changetype */
+        if ((pg->pg_changetypes & chgtype) == 0) {
             continue;
         }
 
-        slapi_log_err(SLAPI_LOG_CONNS, "ps_service_persistent_searches",
-                      "conn=%" PRIu64 " op=%d entry %s with chgtype %d "
-                      "matches the ps changetype %d\n",
-                      pb_conn ? pb_conn->c_connid : -1,
-                      pb_op->o_opid,
-                      edn, chgtype, ps->ps_changetypes);
-
-        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_FILTER, &f);
-        slapi_pblock_get(ps->ps_pblock, SLAPI_ORIGINAL_TARGET_DN, &origbase);
-        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_TARGET_SDN, &base);
-        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_SCOPE, &scope);
-        if (NULL == base) {
-            base = slapi_sdn_new_dn_byref(origbase);
-            slapi_pblock_set(ps->ps_pblock, SLAPI_SEARCH_TARGET_SDN, base);
-        }
-
         /*
          * See if the entry meets the scope and filter criteria.
          * We cannot do the acl check here as this thread
-         * would then potentially clash with the ps_send_results()
+         * would then potentially clash with the sender
          * thread on the aclpb in ps->ps_pblock.
          * By avoiding the acl check in this thread, and leaving all the acl
-         * checking to the ps_send_results() thread we avoid
+         * checking to the ps_send_results() of each search we avoid
          * the ps_pblock contention problem.
          * The lesson here is "Do not give multiple threads arbitary access
          * to the same pblock" this kind of muti-threaded access
          * to the same pblock must be done carefully--there is currently no
          * generic satisfactory way to do this.
         */
-        if (slapi_sdn_scope_test(slapi_entry_get_sdn_const(e), base, scope) &&
-            slapi_vattr_filter_test(ps->ps_pblock, e, f, 0 /* verify_access */) == 0) {
+        if (!slapi_sdn_scope_test(slapi_entry_get_sdn_const(e), pg->pg_base, pg->pg_scope) ||
+            slapi_vattr_filter_test(pg->pg_members->ps_pblock, e, pg->pg_filter, 0 /* verify_access */) != 0) {
+            continue;
+        }
+
+        for (ps = pg->pg_members; NULL != ps; ps = ps->ps_group_next) {
+            Connection *pb_conn = NULL;
+            Operation *pb_op = NULL;
+            PSEQNode *pe;
             PSEQNode *pOldtail;
 
-            /* The scope and the filter match - enqueue it */
+            slapi_pblock_get(ps->ps_pblock, SLAPI_OPERATION, &pb_op);
+            slapi_pblock_get(ps->ps_pblock, SLAPI_CONNECTION, &pb_conn);
+
+            /* Skip the node that doesn't meet the changetype,
+             * or is unable to use the change in ps_send_results()
+             */
+            if ((ps->ps_changetypes & chgtype) == 0 || pb_op == NULL ||
+                slapi_op_abandoned(ps->ps_pblock)) {
+                continue;
+            }
+
+            slapi_log_err(SLAPI_LOG_CONNS, "ps_service_persistent_searches",
+                          "conn=%" PRIu64 " op=%d entry %s with chgtype %d "
+                          "matches the ps changetype %d\n",
+                          pb_conn ? pb_conn->c_connid : -1,
+                          pb_op->o_opid,
+                          edn, chgtype, ps->ps_changetypes);
 
+            /* The scope and the filter match - enqueue it */
             matched++;
-            pe = (PSEQNode *)slapi_ch_calloc(1, sizeof(PSEQNode));
-            pe->pe_entry = slapi_entry_dup(e);
-            if (ps->ps_send_entchg_controls) {
-                /* create_entrychange_control() is more
-                 * expensive than slapi_dup_control()
+            if (pc == NULL) {
+                /* our own reference, dropped once dispatched */
+                pc = (PSChange *)slapi_ch_calloc(1, sizeof(PSChange));
+                pc->pc_entry = slapi_entry_dup(e);
+                pc->pc_refcnt = 1;
+            }
+            if (ps->ps_send_entchg_controls && !ctrl_done) {
+                int rc;
+                /* Only the searches asking for the control read it,
+                 * it is set before being queued to the first of them
                  */
-                if (ctrl == NULL) {
-                    int rc;
-                    rc = create_entrychange_control(chgtype, chgnum,
-                                                    eprev ? slapi_entry_get_dn_const(eprev) : NULL,
-                                                    &ctrl);
-                    if (rc != LDAP_SUCCESS) {
-                        slapi_log_err(SLAPI_LOG_ERR, "ps_service_persistent_searches",
-                                      "Unable to create EntryChangeNotification control for"
-                                      " entry \"%s\" -- control won't be sent.\n",
-                                      slapi_entry_get_dn_const(e));
-                    }
-                }
-                if (ctrl) {
-                    pe->pe_ctrls[0] = slapi_dup_control(ctrl);
+                ctrl_done = 1;
+                rc = create_entrychange_control(chgtype, chgnum,
+                                                eprev ? slapi_entry_get_dn_const(eprev) : NULL,
+                                                &pc->pc_ctrl);
+                if (rc != LDAP_SUCCESS) {
+                    slapi_log_err(SLAPI_LOG_ERR, "ps_service_persistent_searches",
+                                  "Unable to create EntryChangeNotification control for"
+                                  " entry \"%s\" -- control won't be sent.\n",
+                                  edn);
                 }
             }
+            pe = (PSEQNode *)slapi_ch_calloc(1, sizeof(PSEQNode));
+            slapi_atomic_incr_64(&(pc->pc_refcnt), __ATOMIC_RELAXED);
+            pe->pe_change = pc;
 
             /* Put it on the end of the list for this pers search */
             PR_Lock(ps->ps_lock);
@@ -614,6 +948,9 @@ ps_service_persistent_searches(Slapi_Entry *e, Slapi_Entry *eprev, ber_int_t chg
                 pOldtail->pe_next = ps->ps_eq_tail;
             }
             PR_Unlock(ps->ps_lock);
+
+            /* Turn it loose */
+            ps_schedule(ps);
         }
     }
 
@@ -621,9 +958,7 @@ ps_service_persistent_searches(Slapi_Entry *e, Slapi_Entry *eprev, ber_int_t chg
 
     /* Were there any matches? */
     if (matched) {
-        ldap_control_free(ctrl);
-        /* Turn 'em loose */
-        ps_wakeup_all();
+        ps_change_release(pc);
         slapi_log_err(SLAPI_LOG_TRACE, "ps_service_persistent_searches", "Enqueued entry "
                       "\"%s\" on %d persistent search lists\n",
                       slapi_entry_get_dn_const(e), matched);
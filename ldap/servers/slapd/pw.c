@@ -156,26 +156,31 @@ slapi_pw_find(
  * returns 0 if password "v" is found in "vals"; non-zero otherwise
  */
 
-int
-slapi_pw_find_sv(
-    Slapi_Value **vals,
-    const Slapi_Value *v)
+static int
+pw_find_sv_ext(Slapi_Value **vals, const Slapi_Value *v, int offload)
 {
     struct pw_scheme *pwsp;
     char *valpwd;
+    int rc;
     int i;
 
     slapi_log_err(SLAPI_LOG_TRACE, "slapi_pw_find_sv", "=> \"%s\"\n", slapi_value_get_string(v));
 
     for (i = 0; vals && vals[i]; i++) {
         pwsp = pw_val2scheme((char *)slapi_value_get_string(vals[i]), &valpwd, 1);
-        if (pwsp != NULL &&
-            (*(pwsp->pws_cmp))((char *)slapi_value_get_string(v), valpwd) == 0) {
-            slapi_log_err(SLAPI_LOG_TRACE, "slapi_pw_find_sv",
-                          "<= Matched \"%s\" using scheme \"%s\"\n",
-                          valpwd, pwsp->pws_name);
-            free_pw_scheme(pwsp);
-            return (0); /* found it */
+        if (pwsp != NULL) {
+            rc = pw_hash_pool_cmp(pwsp, slapi_value_get_string(v), valpwd, offload);
+            if (rc == 0) {
+                slapi_log_err(SLAPI_LOG_TRACE, "slapi_pw_find_sv",
+                              "<= Matched \"%s\" using scheme \"%s\"\n",
+                              valpwd, pwsp->pws_name);
+                free_pw_scheme(pwsp);
+                return (0); /* found it */
+            }
+            if (rc == PW_HASH_POOL_BUSY) {
+                free_pw_scheme(pwsp);
+                return (PW_HASH_POOL_BUSY);
+            }
         }
         free_pw_scheme(pwsp);
     }
@@ -185,6 +190,25 @@ slapi_pw_find_sv(
     return (1); /* no match */
 }
 
+int
+slapi_pw_find_sv(
+    Slapi_Value **vals,
+    const Slapi_Value *v)
+{
+    return pw_find_sv_ext(vals, v, 0);
+}
+
+/*
+ * Same as slapi_pw_find_sv, but the comparisons go through the password
+ * hashing pool: the caller must handle PW_HASH_POOL_BUSY when too many
+ * verifications are already waiting.
+ */
+int
+pw_verify_find_sv(Slapi_Value **vals, const Slapi_Value *v)
+{
+    return pw_find_sv_ext(vals, v, 1);
+}
+
 /* Checks if the specified value is encoded.
    Returns 1 if it is and 0 otherwise
  */
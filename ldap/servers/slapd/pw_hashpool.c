@@ -0,0 +1,314 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/*
+ * Password verification pool.
+ *
+ * The slow password storage schemes (PBKDF2, crypt sha256/sha512, ...)
+ * spend several milliseconds of cpu per verification. During a login
+ * storm every worker thread ends up hashing, and searches wait behind
+ * them. When nsslapd-pwhash-threads is set, binds and password modify
+ * extended operations hand their verifications to a dedicated set of
+ * threads instead:
+ *    - the cpu spent hashing is bounded by the number of pool threads,
+ *      the other workers keep the rest of the machine for other operations
+ *    - no more than nsslapd-pwhash-queue-max verifications wait for a
+ *      pool thread. Past that the bind is refused with LDAP_BUSY right away
+ *      rather than holding a worker thread (admission control). The limit
+ *      is lowered so that the verifications in progress or waiting never
+ *      hold more than half of the worker threads.
+ *
+ * The time spent per storage scheme is kept in log2 histograms, published
+ * in cn=monitor with the queue depth and the refused verifications.
+ */
+
+#include "slap.h"
+
+#define PW_HASH_HIST_BUCKETS 24 /* microseconds, log2: the last one is >= 8s */
+#define PW_HASH_MAX_SCHEMES  32
+
+typedef struct pw_hash_stats
+{
+    char *phs_name;
+    uint64_t phs_count;
+    uint64_t phs_total_us;
+    uint64_t phs_buckets[PW_HASH_HIST_BUCKETS];
+} pw_hash_stats;
+
+typedef struct pw_hash_job
+{
+    struct pw_scheme *phj_scheme;
+    const char *phj_clear;
+    char *phj_encoded;
+    int phj_result;
+    int phj_done;
+    pthread_cond_t phj_cv;
+    struct pw_hash_job *phj_next;
+} pw_hash_job;
+
+static pthread_mutex_t pw_hash_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pw_hash_cv = PTHREAD_COND_INITIALIZER;
+static pw_hash_job *pw_hash_head = NULL;
+static pw_hash_job *pw_hash_tail = NULL;
+static int32_t pw_hash_queued = 0;
+static int32_t pw_hash_queued_max = 0;
+static uint64_t pw_hash_rejected = 0;
+static int pw_hash_shutdown = 0;
+static int pw_hash_nthreads = 0;
+static PRThread **pw_hash_threads = NULL;
+
+static pthread_mutex_t pw_hash_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pw_hash_stats pw_hash_schemes[PW_HASH_MAX_SCHEMES];
+static int pw_hash_nschemes = 0;
+
+static void
+pw_hash_record(const char *name, struct timespec *start)
+{
+    struct timespec end;
+    uint64_t elapsed_us;
+    size_t bucket = 0;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed_us = (uint64_t)(end.tv_sec - start->tv_sec) * 1000000 +
+                 (end.tv_nsec - start->tv_nsec) / 1000;
+    while (bucket < PW_HASH_HIST_BUCKETS - 1 && (elapsed_us >> (bucket + 1))) {
+        bucket++;
+    }
+
+    pthread_mutex_lock(&pw_hash_stats_lock);
+    for (i = 0; i < pw_hash_nschemes; i++) {
+        if (strcasecmp(pw_hash_schemes[i].phs_name, name) == 0) {
+            break;
+        }
+    }
+    if (i == pw_hash_nschemes && i < PW_HASH_MAX_SCHEMES) {
+        pw_hash_schemes[i].phs_name = slapi_ch_strdup(name);
+        pw_hash_nschemes++;
+    }
+    if (i < pw_hash_nschemes) {
+        pw_hash_schemes[i].phs_count++;
+        pw_hash_schemes[i].phs_total_us += elapsed_us;
+        pw_hash_schemes[i].phs_buckets[bucket]++;
+    }
+    pthread_mutex_unlock(&pw_hash_stats_lock);
+}
+
+static int
+pw_hash_cmp_inline(struct pw_scheme *pwsp, const char *clear, char *encoded)
+{
+    struct timespec start;
+    int rc;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rc = (*(pwsp->pws_cmp))((char *)clear, encoded);
+    pw_hash_record(pwsp->pws_name, &start);
+    return rc;
+}
+
+static void
+pw_hash_thread(void *arg __attribute__((unused)))
+{
+    pw_hash_job *job;
+
+    pthread_mutex_lock(&pw_hash_lock);
+    while (1) {
+        while (NULL == pw_hash_head && !pw_hash_shutdown) {
+            pthread_cond_wait(&pw_hash_cv, &pw_hash_lock);
+        }
+        if (NULL == pw_hash_head) {
+            break;
+        }
+        job = pw_hash_head;
+        if (NULL == (pw_hash_head = job->phj_next)) {
+            pw_hash_tail = NULL;
+        }
+        pw_hash_queued--;
+        pthread_mutex_unlock(&pw_hash_lock);
+
+        job->phj_result = pw_hash_cmp_inline(job->phj_scheme, job->phj_clear, job->phj_encoded);
+
+        pthread_mutex_lock(&pw_hash_lock);
+        job->phj_done = 1;
+        pthread_cond_signal(&job->phj_cv);
+    }
+    pthread_mutex_unlock(&pw_hash_lock);
+}
+
+void
+pw_hash_pool_init(void)
+{
+    int threads = config_get_pwhash_threads();
+
+    if (threads <= 0) {
+        return;
+    }
+    pw_hash_threads = (PRThread **)slapi_ch_calloc(threads, sizeof(PRThread *));
+    for (int i = 0; i < threads; i++) {
+        pw_hash_threads[i] = PR_CreateThread(PR_USER_THREAD, pw_hash_thread, NULL,
+                                             PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                             PR_JOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+        if (NULL == pw_hash_threads[i]) {
+            int prerr = PR_GetError();
+            slapi_log_err(SLAPI_LOG_ERR, "pw_hash_pool_init",
+                          "PR_CreateThread failed, " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+                          prerr, slapd_pr_strerror(prerr));
+            break;
+        }
+        pw_hash_nthreads++;
+    }
+    slapi_log_err(SLAPI_LOG_INFO, "pw_hash_pool_init",
+                  "Verifying the passwords with %d threads\n", pw_hash_nthreads);
+}
+
+/* Called once the worker threads are gone */
+void
+pw_hash_pool_stop(void)
+{
+    pthread_mutex_lock(&pw_hash_lock);
+    pw_hash_shutdown = 1;
+    pthread_cond_broadcast(&pw_hash_cv);
+    pthread_mutex_unlock(&pw_hash_lock);
+
+    for (int i = 0; i < pw_hash_nthreads; i++) {
+        PR_JoinThread(pw_hash_threads[i]);
+    }
+    slapi_ch_free((void **)&pw_hash_threads);
+    pw_hash_nthreads = 0;
+}
+
+/*
+ * Number of verifications allowed to wait for a pool thread, with
+ * pw_hash_lock held. Each of them holds a worker thread, like the ones in
+ * progress: together they are kept under half of the worker threads, else
+ * the searches would still wait behind the binds during a login storm.
+ */
+static int
+pw_hash_queue_limit(void)
+{
+    int queue_max = config_get_pwhash_queue_max();
+    int limit = config_get_threadnumber() / 2 - pw_hash_nthreads;
+
+    if (limit < 1) {
+        limit = 1;
+    }
+    if (queue_max > 0 && queue_max < limit) {
+        limit = queue_max;
+    }
+    return limit;
+}
+
+/*
+ * Compare a clear password with an encoded one, in the pool if there
+ * is one and offload is set. Returns the result of the scheme compare
+ * function (0 if they match) or PW_HASH_POOL_BUSY when too many
+ * verifications are waiting.
+ */
+int
+pw_hash_pool_cmp(struct pw_scheme *pwsp, const char *clear, char *encoded, int offload)
+{
+    pw_hash_job job = {0};
+    int queue_max;
+
+    if (!offload || 0 == pw_hash_nthreads) {
+        return pw_hash_cmp_inline(pwsp, clear, encoded);
+    }
+
+    pthread_mutex_lock(&pw_hash_lock);
+    if (pw_hash_shutdown) {
+        pthread_mutex_unlock(&pw_hash_lock);
+        return pw_hash_cmp_inline(pwsp, clear, encoded);
+    }
+    queue_max = pw_hash_queue_limit();
+    if (pw_hash_queued >= queue_max) {
+        pw_hash_rejected++;
+        pthread_mutex_unlock(&pw_hash_lock);
+        slapi_log_err(SLAPI_LOG_TRACE, "pw_hash_pool_cmp",
+                      "%d password verifications waiting, refusing a new one\n", queue_max);
+        return PW_HASH_POOL_BUSY;
+    }
+
+    job.phj_scheme = pwsp;
+    job.phj_clear = clear;
+    job.phj_encoded = encoded;
+    pthread_cond_init(&job.phj_cv, NULL);
+    if (pw_hash_tail) {
+        pw_hash_tail->phj_next = &job;
+    } else {
+        pw_hash_head = &job;
+    }
+    pw_hash_tail = &job;
+    if (++pw_hash_queued > pw_hash_queued_max) {
+        pw_hash_queued_max = pw_hash_queued;
+    }
+    pthread_cond_signal(&pw_hash_cv);
+    while (!job.phj_done) {
+        pthread_cond_wait(&job.phj_cv, &pw_hash_lock);
+    }
+    pthread_mutex_unlock(&pw_hash_lock);
+    pthread_cond_destroy(&job.phj_cv);
+
+    return job.phj_result;
+}
+
+/* Upper bound, in microseconds, of the bucket holding that permille */
+static uint64_t
+pw_hash_percentile(pw_hash_stats *stats, uint32_t permille)
+{
+    uint64_t target = (stats->phs_count * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < PW_HASH_HIST_BUCKETS; i++) {
+        seen += stats->phs_buckets[i];
+        if (seen >= target) {
+            return ((uint64_t)2 << i) - 1;
+        }
+    }
+    return 0;
+}
+
+/* Add the pool state and the per scheme timings to the cn=monitor entry */
+void
+pw_hash_pool_monitor(Slapi_Entry *e)
+{
+    char buf[BUFSIZ];
+    struct berval val;
+    struct berval *vals[2];
+
+    vals[0] = &val;
+    vals[1] = NULL;
+    val.bv_val = buf;
+
+    pthread_mutex_lock(&pw_hash_lock);
+    val.bv_len = snprintf(buf, sizeof(buf),
+                          "threads=\"%d\" queued=\"%d\" maxqueued=\"%d\" refused=\"%" PRIu64 "\"",
+                          pw_hash_nthreads, pw_hash_queued, pw_hash_queued_max, pw_hash_rejected);
+    pthread_mutex_unlock(&pw_hash_lock);
+    attrlist_replace(&e->e_attrs, "pwhashpool", vals);
+
+    attrlist_delete(&e->e_attrs, "pwhashscheme");
+    pthread_mutex_lock(&pw_hash_stats_lock);
+    for (int i = 0; i < pw_hash_nschemes; i++) {
+        pw_hash_stats *stats = &pw_hash_schemes[i];
+
+        val.bv_len = snprintf(buf, sizeof(buf),
+                              "scheme=\"%s\" count=\"%" PRIu64 "\" mean_us=\"%" PRIu64 "\" "
+                              "p50_us=\"%" PRIu64 "\" p90_us=\"%" PRIu64 "\" p99_us=\"%" PRIu64 "\"",
+                              stats->phs_name, stats->phs_count,
+                              stats->phs_count ? stats->phs_total_us / stats->phs_count : 0,
+                              pw_hash_percentile(stats, 500),
+                              pw_hash_percentile(stats, 900),
+                              pw_hash_percentile(stats, 990));
+        attrlist_merge(&e->e_attrs, "pwhashscheme", vals);
+    }
+    pthread_mutex_unlock(&pw_hash_stats_lock);
+}
@@ -25,6 +25,7 @@
 #endif
 #include "slap.h"
 #include "fe.h"
+#include <sechash.h>
 #include <rust-nsslapd-private.h>
 
 
@@ -181,3 +182,261 @@ pw_validate_be_dn(Slapi_PBlock *pb, Slapi_Entry **referral)
 
     return SLAPI_BIND_SUCCESS;
 }
+
+/*
+ * Bind verification cache.
+ *
+ * Applications binding again and again with the same credentials pay the
+ * full cost of the storage scheme (several ms for PBKDF2) every time. When
+ * nsslapd-pwverify-cache-ttl is set, a successful verification is
+ * remembered for that many seconds as an HMAC-SHA256, keyed by a random
+ * secret, of the bind dn, the clear password and the stored userPassword
+ * values (with their CSN). The clear password itself is never kept.
+ *
+ * A stored value change gives another digest, and any modify, delete or
+ * rename of the entry drops its slot: password changes and lockout state
+ * changes are all modifies of the entry. The change also bumps the
+ * generation of the dn, which spreads the dns over PVC_GENERATIONS
+ * counters, so a verification that started before it is not recorded.
+ * The account lock itself is still checked by the bind before the backend
+ * is called.
+ *
+ * There is one slot per dn, kept in insertion order, which is also the
+ * expiration order. At most nsslapd-pwverify-cache-max-entries slots are
+ * kept, the oldest ones are evicted first.
+ */
+
+#define PVC_GENERATIONS 1024 /* power of two */
+#define PVC_HMAC_BLOCK 64    /* SHA-256 block size */
+
+typedef struct pw_verify_cache_node
+{
+    char *pvc_ndn;
+    unsigned char pvc_digest[SHA256_LENGTH];
+    time_t pvc_expire;
+    struct pw_verify_cache_node *pvc_prev;
+    struct pw_verify_cache_node *pvc_next;
+} pw_verify_cache_node;
+
+static pthread_mutex_t pvc_lock = PTHREAD_MUTEX_INITIALIZER;
+static PLHashTable *pvc_table = NULL;
+static pw_verify_cache_node *pvc_head = NULL; /* oldest */
+static pw_verify_cache_node *pvc_tail = NULL;
+static int32_t pvc_count = 0;
+static uint64_t pvc_generations[PVC_GENERATIONS];
+static uint64_t pvc_hits = 0;
+static uint64_t pvc_misses = 0;
+static uint64_t pvc_evictions = 0;
+static unsigned char pvc_secret[SHA256_LENGTH];
+static int pvc_secret_set = 0;
+
+/* Generation of the dn, the caller holds pvc_lock */
+static uint64_t *
+pw_verify_cache_generation(const char *ndn)
+{
+    return &pvc_generations[PL_HashString(ndn) & (PVC_GENERATIONS - 1)];
+}
+
+/* HMAC-SHA256 (RFC 2104) of the verification, keyed by pvc_secret */
+static int
+pw_verify_cache_digest(const char *ndn, Slapi_Value **vals, const Slapi_Value *cred, unsigned char *digest)
+{
+    HASHContext *ctx;
+    unsigned char pad[PVC_HMAC_BLOCK];
+    unsigned char inner[SHA256_LENGTH];
+    unsigned int len = 0;
+    char csnstr[CSN_STRSIZE];
+
+    if ((ctx = HASH_Create(HASH_AlgSHA256)) == NULL) {
+        return -1;
+    }
+    memset(pad, 0x36, sizeof(pad));
+    for (size_t i = 0; i < sizeof(pvc_secret); i++) {
+        pad[i] ^= pvc_secret[i];
+    }
+    HASH_Begin(ctx);
+    HASH_Update(ctx, pad, sizeof(pad));
+    HASH_Update(ctx, (const unsigned char *)ndn, strlen(ndn) + 1);
+    HASH_Update(ctx, (const unsigned char *)slapi_value_get_string(cred), slapi_value_get_length(cred));
+    for (size_t i = 0; vals && vals[i]; i++) {
+        const CSN *csn = value_get_csn(vals[i], CSN_TYPE_VALUE_UPDATED);
+
+        /* the lengths keep the boundaries between the fields */
+        len = slapi_value_get_length(vals[i]);
+        HASH_Update(ctx, (const unsigned char *)&len, sizeof(len));
+        HASH_Update(ctx, (const unsigned char *)slapi_value_get_string(vals[i]), len);
+        if (csn) {
+            csn_as_string(csn, PR_FALSE, csnstr);
+            HASH_Update(ctx, (const unsigned char *)csnstr, strlen(csnstr) + 1);
+        }
+    }
+    HASH_End(ctx, inner, &len, SHA256_LENGTH);
+
+    memset(pad, 0x5c, sizeof(pad));
+    for (size_t i = 0; i < sizeof(pvc_secret); i++) {
+        pad[i] ^= pvc_secret[i];
+    }
+    HASH_Begin(ctx);
+    HASH_Update(ctx, pad, sizeof(pad));
+    HASH_Update(ctx, inner, sizeof(inner));
+    HASH_End(ctx, digest, &len, SHA256_LENGTH);
+    HASH_Destroy(ctx);
+    memset(pad, 0, sizeof(pad));
+    return 0;
+}
+
+/* The caller holds pvc_lock */
+static void
+pw_verify_cache_unlink(pw_verify_cache_node *node)
+{
+    PL_HashTableRemove(pvc_table, node->pvc_ndn);
+    if (node->pvc_prev) {
+        node->pvc_prev->pvc_next = node->pvc_next;
+    } else {
+        pvc_head = node->pvc_next;
+    }
+    if (node->pvc_next) {
+        node->pvc_next->pvc_prev = node->pvc_prev;
+    } else {
+        pvc_tail = node->pvc_prev;
+    }
+    pvc_count--;
+    slapi_ch_free_string(&node->pvc_ndn);
+    slapi_ch_free((void **)&node);
+}
+
+static void
+pw_verify_cache_insert(const char *ndn, unsigned char *digest, time_t expire, uint64_t generation)
+{
+    int32_t max_entries = config_get_pwverify_cache_max_entries();
+    time_t now = slapi_current_rel_time_t();
+    pw_verify_cache_node *node;
+
+    pthread_mutex_lock(&pvc_lock);
+    if (generation != *pw_verify_cache_generation(ndn) || max_entries <= 0) {
+        /* the entry changed during the verification */
+        pthread_mutex_unlock(&pvc_lock);
+        return;
+    }
+    if (NULL == pvc_table) {
+        pvc_table = PL_NewHashTable(0, PL_HashString, PL_CompareStrings, PL_CompareValues, NULL, NULL);
+    }
+    if ((node = PL_HashTableLookup(pvc_table, ndn)) != NULL) {
+        pw_verify_cache_unlink(node);
+    }
+    while (pvc_head && (pvc_head->pvc_expire <= now || pvc_count >= max_entries)) {
+        if (pvc_head->pvc_expire > now) {
+            pvc_evictions++;
+        }
+        pw_verify_cache_unlink(pvc_head);
+    }
+
+    node = (pw_verify_cache_node *)slapi_ch_calloc(1, sizeof(pw_verify_cache_node));
+    node->pvc_ndn = slapi_ch_strdup(ndn);
+    memcpy(node->pvc_digest, digest, SHA256_LENGTH);
+    node->pvc_expire = expire;
+    node->pvc_prev = pvc_tail;
+    if (pvc_tail) {
+        pvc_tail->pvc_next = node;
+    } else {
+        pvc_head = node;
+    }
+    pvc_tail = node;
+    pvc_count++;
+    PL_HashTableAdd(pvc_table, node->pvc_ndn, node);
+    pthread_mutex_unlock(&pvc_lock);
+}
+
+/*
+ * Verify a simple bind password against the userPassword values of the
+ * entry sdn, reusing a recent successful verification when possible.
+ * Same results as pw_verify_find_sv.
+ */
+int
+pw_verify_cached_find_sv(const Slapi_DN *sdn, Slapi_Value **vals, const Slapi_Value *cred)
+{
+    int32_t ttl = config_get_pwverify_cache_ttl();
+    const char *ndn = slapi_sdn_get_ndn(sdn);
+    unsigned char digest[SHA256_LENGTH];
+    pw_verify_cache_node *node;
+    uint64_t generation;
+    time_t now;
+    int rc;
+
+    if (ttl <= 0 || NULL == ndn) {
+        return pw_verify_find_sv(vals, cred);
+    }
+
+    pthread_mutex_lock(&pvc_lock);
+    if (!pvc_secret_set) {
+        slapi_rand_array(pvc_secret, sizeof(pvc_secret));
+        pvc_secret_set = 1;
+    }
+    pthread_mutex_unlock(&pvc_lock);
+    if (pw_verify_cache_digest(ndn, vals, cred, digest) != 0) {
+        return pw_verify_find_sv(vals, cred);
+    }
+
+    now = slapi_current_rel_time_t();
+    pthread_mutex_lock(&pvc_lock);
+    if (pvc_table && (node = PL_HashTableLookup(pvc_table, ndn)) != NULL) {
+        if (node->pvc_expire <= now) {
+            pw_verify_cache_unlink(node);
+        } else if (slapi_ct_memcmp(node->pvc_digest, digest, SHA256_LENGTH) == 0) {
+            pvc_hits++;
+            pthread_mutex_unlock(&pvc_lock);
+            return 0;
+        }
+    }
+    pvc_misses++;
+    generation = *pw_verify_cache_generation(ndn);
+    pthread_mutex_unlock(&pvc_lock);
+
+    rc = pw_verify_find_sv(vals, cred);
+    if (rc == 0) {
+        pw_verify_cache_insert(ndn, digest, now + ttl, generation);
+    }
+    return rc;
+}
+
+/* The entry changed, was deleted or renamed: forget its verification */
+void
+pw_verify_cache_invalidate(const Slapi_DN *sdn)
+{
+    pw_verify_cache_node *node;
+
+    if (NULL == sdn || NULL == slapi_sdn_get_ndn(sdn)) {
+        return;
+    }
+    if (NULL == pvc_table && config_get_pwverify_cache_ttl() <= 0) {
+        /* never enabled */
+        return;
+    }
+    pthread_mutex_lock(&pvc_lock);
+    (*pw_verify_cache_generation(slapi_sdn_get_ndn(sdn)))++;
+    if (pvc_table) {
+        if ((node = PL_HashTableLookup(pvc_table, slapi_sdn_get_ndn(sdn))) != NULL) {
+            pw_verify_cache_unlink(node);
+        }
+    }
+    pthread_mutex_unlock(&pvc_lock);
+}
+
+void
+pw_verify_cache_monitor(Slapi_Entry *e)
+{
+    char buf[BUFSIZ];
+    struct berval val;
+    struct berval *vals[2];
+
+    vals[0] = &val;
+    vals[1] = NULL;
+    val.bv_val = buf;
+
+    pthread_mutex_lock(&pvc_lock);
+    val.bv_len = snprintf(buf, sizeof(buf),
+                          "entries=\"%d\" hits=\"%" PRIu64 "\" misses=\"%" PRIu64 "\" evictions=\"%" PRIu64 "\"",
+                          pvc_count, pvc_hits, pvc_misses, pvc_evictions);
+    pthread_mutex_unlock(&pvc_lock);
+    attrlist_replace(&e->e_attrs, "pwverifycache", vals);
+}
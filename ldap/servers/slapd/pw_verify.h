@@ -13,5 +13,7 @@ int pw_verify_root_dn(const char *dn, const Slapi_Value *cred);
 int pw_verify_be_dn(Slapi_PBlock *pb, Slapi_Entry **referral);
 int pw_validate_be_dn(Slapi_PBlock *pb, Slapi_Entry **referral);
 int32_t pw_verify_token_dn(Slapi_PBlock *pb);
+void pw_verify_cache_invalidate(const Slapi_DN *sdn);
+void pw_verify_cache_monitor(Slapi_Entry *e);
 
 #endif /* _SLAPD_PW_VERIFY_H_ */
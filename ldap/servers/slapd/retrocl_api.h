@@ -0,0 +1,34 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+#ifndef _RETROCL_API_H_
+#define _RETROCL_API_H_
+
+/* mechanics */
+
+/* sets the first and last change numbers of the compact store, 0 if it is empty */
+typedef void (*api_retrocl_compact_get_bounds)(unsigned long *first, unsigned long *last);
+
+/* API ID for slapi_apib_get_interface, published while the retro changelog
+ * is kept in the compact store (nsslapd-changelog-storage: compact) */
+
+#define RetroCLCompact_v1_0_GUID "7c2f5d0e-3b8a-4e61-9d47-a05e1c6b93f2"
+
+/* API */
+
+/* the api broker reserves api[0] for its use */
+
+#define retrocl_api_compact_bounds(api, first, last) \
+    ((api_retrocl_compact_get_bounds *)(api))[1](first, last)
+
+#endif /*_RETROCL_API_H_*/
@@ -279,6 +279,16 @@ typedef void (*VFPV)(); /* takes undefined arguments */
 #define SLAPD_DEFAULT_MAXBERSIZE_STR "2097152"
 #define SLAPD_DEFAULT_MAXSIMPLEPAGED_PER_CONN (-1)
 #define SLAPD_DEFAULT_MAXSIMPLEPAGED_PER_CONN_STR "-1"
+#define SLAPD_DEFAULT_PWHASH_THREADS 0 /* password verifications done by the worker */
+#define SLAPD_DEFAULT_PWHASH_THREADS_STR "0"
+#define SLAPD_DEFAULT_PWHASH_QUEUE_MAX 256
+#define SLAPD_DEFAULT_PWHASH_QUEUE_MAX_STR "256"
+#define SLAPD_DEFAULT_PWVERIFY_CACHE_TTL 0 /* successful binds are not remembered */
+#define SLAPD_DEFAULT_PWVERIFY_CACHE_TTL_STR "0"
+#define SLAPD_DEFAULT_PWVERIFY_CACHE_MAX_ENTRIES 10000
+#define SLAPD_DEFAULT_PWVERIFY_CACHE_MAX_ENTRIES_STR "10000"
+#define SLAPD_DEFAULT_PSEARCH_SENDER_THREADS 4
+#define SLAPD_DEFAULT_PSEARCH_SENDER_THREADS_STR "4"
 #define SLAPD_DEFAULT_CONNTABLESIZE 65536 /* connection table size */
 #define SLAPD_DEFAULT_NUM_LISTENERS 1 /* connection table lists */
 #define SLAPD_DEFAULT_LDAPSSOTOKEN_TTL 3600
@@ -431,6 +441,9 @@ typedef void (*VFPV)(); /* takes undefined arguments */
 #define SLAPD_DEFAULT_TCP_KEEPALIVE_TIME 300
 #define SLAPD_DEFAULT_TCP_KEEPALIVE_TIME_STR "300"
 
+#define SLAPD_DEFAULT_REPL_APPLY_CONCURRENCY 1 /* replicated updates applied serially */
+#define SLAPD_DEFAULT_REPL_APPLY_CONCURRENCY_STR "1"
+
 #define MIN_THREADS 16
 #define MAX_THREADS 512
 
@@ -508,6 +521,20 @@ struct subfilt
 
 #include "filter.h" /* mr_filter_t */
 
+/*
+ * The syntax filter function of a filter component, resolved once for a
+ * search instead of for every candidate entry (see filter_compile)
+ */
+typedef struct filter_compiled
+{
+    struct slapdplugin *fc_plugin;        /* the attribute plugins it was */
+    struct slapdplugin *fc_mr_eq_plugin;  /* resolved for */
+    struct slapdplugin *fc_mr_ord_plugin;
+    struct slapdplugin *fc_mr_sub_plugin;
+    IFP fc_fn;                            /* filter_ava or filter_sub function */
+    Slapi_PBlock *fc_pb;                  /* to call fc_fn with */
+} filter_compiled;
+
 /*
  * represents a search filter
  */
@@ -516,6 +543,8 @@ struct slapi_filter
     int f_flags;
     unsigned long f_choice; /* values taken from ldap.h */
     PRUint32 f_hash;        /* for quick comparisons */
+    uint32_t f_type_handle; /* interned attribute type, 0 if none */
+    filter_compiled *f_compiled; /* see filter_compile, NULL if none */
     void *assigned_decoder;
 
     union
@@ -641,6 +670,7 @@ struct slapi_attr
     struct slapdplugin *a_mr_eq_plugin;  /* for the attribute EQUALITY matching rule, if any */
     struct slapdplugin *a_mr_ord_plugin; /* for the attribute ORDERING matching rule, if any */
     struct slapdplugin *a_mr_sub_plugin; /* for the attribute SUBSTRING matching rule, if any */
+    uint32_t a_type_handle;              /* interned a_type, 0 if none (see attr_syntax_type_handle) */
 };
 
 typedef struct oid_item
@@ -664,6 +694,7 @@ typedef struct asyntaxinfo
 {
     char *asi_oid;                         /* OID */
     char *asi_name;                        /* normalized name */
+    uint32_t asi_handle;                   /* interned asi_name */
     char **asi_aliases;                    /* alternative names */
     char *asi_desc;                        /* textual description */
     char *asi_superior;                    /* derived from */
@@ -2353,6 +2384,11 @@ typedef struct _slapdEntryPoints
 #define CONFIG_CN_USES_DN_SYNTAX_IN_DNS "nsslapd-cn-uses-dn-syntax-in-dns"
 
 #define CONFIG_MAXSIMPLEPAGED_PER_CONN_ATTRIBUTE "nsslapd-maxsimplepaged-per-conn"
+#define CONFIG_PWHASH_THREADS_ATTRIBUTE "nsslapd-pwhash-threads"
+#define CONFIG_PWHASH_QUEUE_MAX_ATTRIBUTE "nsslapd-pwhash-queue-max"
+#define CONFIG_PWVERIFY_CACHE_TTL_ATTRIBUTE "nsslapd-pwverify-cache-ttl"
+#define CONFIG_PWVERIFY_CACHE_MAX_ENTRIES_ATTRIBUTE "nsslapd-pwverify-cache-max-entries"
+#define CONFIG_PSEARCH_SENDER_THREADS_ATTRIBUTE "nsslapd-psearch-sender-threads"
 #define CONFIG_LOGGING_BACKEND "nsslapd-logging-backend"
 
 #define CONFIG_EXTRACT_PEM "nsslapd-extract-pemfiles"
@@ -2376,6 +2412,7 @@ typedef struct _slapdEntryPoints
 
 #define CONFIG_TCP_FIN_TIMEOUT       "nsslapd-tcp-fin-timeout"
 #define CONFIG_TCP_KEEPALIVE_TIME    "nsslapd-tcp-keepalive-time"
+#define CONFIG_REPL_APPLY_CONCURRENCY "nsslapd-repl-apply-concurrency"
 
 /*
  * Define the backlog number for use in listen() call.
@@ -2675,6 +2712,11 @@ typedef struct _slapdFrontendConfig
     slapi_onoff_t cn_uses_dn_syntax_in_dns; /* indicates the cn value in dns has dn syntax */
     slapi_onoff_t global_backend_lock;
     slapi_int_t maxsimplepaged_per_conn; /* max simple paged results reqs handled per connection */
+    slapi_int_t pwhash_threads;          /* password verification threads, read at startup */
+    slapi_int_t pwhash_queue_max;        /* max password verifications waiting for a thread */
+    slapi_int_t pwverify_cache_ttl;      /* seconds a successful bind verification is reused */
+    slapi_int_t pwverify_cache_max_entries; /* max bind verifications remembered */
+    slapi_int_t psearch_sender_threads;     /* threads sending the persistent search results */
     slapi_onoff_t enable_nunc_stans; /* Despite the removal of NS, we have to leave the value in
                                       * case someone was setting it.
                                       */
@@ -2704,6 +2746,7 @@ typedef struct _slapdFrontendConfig
     slapi_int_t tcp_keepalive_time;
     slapi_onoff_t return_orig_dn;
     char *auditlog_display_attrs;
+    slapi_int_t repl_apply_concurrency; /* replicated updates of a session applied concurrently */
 } slapdFrontendConfig_t;
 
 /* possible values for slapdFrontendConfig_t.schemareplace */
@@ -2335,6 +2335,17 @@ int slapi_entry_apply_mod_extension(Slapi_Entry *e, const LDAPMod *mod, int modc
  */
 void slapi_entrycache_vattrcache_watermark_invalidate(void);
 
+/**
+ * Get the current global virtual attribute cache watermark.
+ *
+ * A plugin keeping its own cache of computed values can record the watermark
+ * and compare it later: it changes whenever all the entries are invalidated
+ * in the virtual attribute cache.
+ *
+ * \return The current watermark.
+ */
+int32_t slapi_entrycache_vattrcache_watermark_get(void);
+
 
 /*
  * Slapi_DN routines
@@ -441,6 +441,8 @@ void slapi_filter_optimise(Slapi_Filter *f);
                                                   * bind rather than a normal password change */
 #define OP_FLAG_SUBENTRIES_FALSE 0x04000000      /* Normal entries are visible and subentries are not */
 #define OP_FLAG_SUBENTRIES_TRUE 0x08000000       /* Subentries are visible and normal entries are not */
+#define OP_FLAG_ACL_BATCH 0x10000000             /* The backend is returning a set of search candidates,
+                                                  * acl decisions may be shared between them */
 
 /* reverse search states */
 #define REV_STARTED 1
@@ -825,6 +827,10 @@ int slapi_stop_bulk_import(Slapi_PBlock *pb);
 /* allows plugins to close inbound connection */
 void slapi_disconnect_server(Slapi_Connection *conn);
 
+/* serialize the CSN registration of replicated updates applied concurrently (connection.c) */
+void slapi_repl_apply_csn_turn_wait(Slapi_PBlock *pb);
+void slapi_repl_apply_csn_turn_done(Slapi_PBlock *pb);
+
 /* functions to look up instance names by suffixes (backend_manager.c) */
 int slapi_lookup_instance_name_by_suffixes(char **included,
                                            char **excluded,
@@ -848,6 +854,11 @@ int pw_rever_decode(char *cipher, char **plain, const char *attr_name);
 
 int32_t update_pw_encoding(Slapi_PBlock *orig_pb, Slapi_Entry *e, Slapi_DN *sdn, char *cleartextpassword);
 
+/* the password hashing pool has too many verifications waiting */
+#define PW_HASH_POOL_BUSY -2
+int pw_verify_find_sv(Slapi_Value **vals, const Slapi_Value *v);
+int pw_verify_cached_find_sv(const Slapi_DN *sdn, Slapi_Value **vals, const Slapi_Value *cred);
+
 
 /* config routines */
 
@@ -718,12 +718,13 @@ vattr_test_filter(Slapi_PBlock *pb,
 
         if (filter_type == FILTER_TYPE_AVA) {
 
-            rc = test_ava_filter(NULL /* pb not needed */,
-                                 e, e->e_attrs, &f->f_ava,
-                                 f->f_choice,
-                                 0 /* no access check */,
-                                 0 /* do test filter */,
-                                 &acl_test_done);
+            rc = test_ava_filter_ext(NULL /* pb not needed */,
+                                     e, e->e_attrs, &f->f_ava,
+                                     f->f_type_handle, f->f_compiled,
+                                     f->f_choice,
+                                     0 /* no access check */,
+                                     0 /* do test filter */,
+                                     &acl_test_done);
 
         } else if (filter_type == FILTER_TYPE_SUBSTRING) {
 
@@ -134,6 +134,27 @@ class Agreement(DSLdapObject):
         self._log.debug('get_agmt_maxcsn - did not find matching agmt maxcsn from RUV')
         return None
 
+    def get_update_latency(self):
+        """Get the replication lag statistics of the updates acknowledged
+        by the consumer since the server started
+        :returns: A dict with the sample count, the update rate, and the
+                  'lag_ms' and 'ack_us' distributions (mean, percentiles, max)
+        """
+        latency = self.get_attr_val_utf8('nsds5replicaUpdateLatencyJSON')
+        if latency is None:
+            return None
+        return json.loads(latency)
+
+    def get_flow_control_state(self):
+        """Get the state of the incremental update flow control
+        :returns: A dict with the mode, the current and maximum window, the
+                  phase, and the round trip times (us) driving the window
+        """
+        state = self.get_attr_val_utf8('nsds5replicaFlowControlStateJSON')
+        if state is None:
+            return None
+        return json.loads(state)
+
     def get_consumer_maxcsn(self, binddn=None, bindpw=None):
         """Attempt to get the consumer's maxcsn from its database RUV entry
         :param binddn: Specifies a specific bind DN to use when contacting the remote consumer
@@ -155,7 +155,7 @@ def fixup(inst, basedn, log, args):
     log.info('Attempting to add task entry... This will fail if Automembership plug-in is not enabled.')
     if not plugin.status():
         log.error("'%s' is disabled. Rebuild membership task can't be executed" % plugin.rdn)
-    fixup_task = plugin.fixup(args.DN, args.filter)
+    fixup_task = plugin.fixup(args.DN, args.filter, threads=args.threads, batchsize=args.batch_size)
     if args.wait:
         log.info(f'Waiting for fixup task "{fixup_task.dn}" to complete.  You can safely exit by pressing Control C ...')
         fixup_task.wait(timeout=None)
@@ -263,6 +263,10 @@ def create_parser(subparsers):
     fixup.add_argument('-f', '--filter', required=True, help='Sets the LDAP filter for entries to fix up')
     fixup.add_argument('-s', '--scope', required=True, choices=['sub', 'base', 'one'], type=str.lower,
                        help='Sets the LDAP search scope for entries to fix up')
+    fixup.add_argument('--threads', type=int,
+                       help='Number of threads updating the groups (default 1)')
+    fixup.add_argument('--batch-size', type=int,
+                       help='Number of members added to or deleted from a group per modify (default 1000)')
     fixup.add_argument('--wait', action='store_true',
                        help="Wait for the task to finish, this could take a long time")
 
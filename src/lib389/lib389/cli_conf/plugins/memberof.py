@@ -19,6 +19,7 @@ arg_to_attr = {
     'groupattr': 'memberOfGroupAttr',
     'allbackends': 'memberOfAllBackends',
     'skipnested': 'memberOfSkipNested',
+    'graph': 'memberOfGraph',
     'scope': 'memberOfEntryScope',
     'exclude': 'memberOfEntryScopeExcludeSubtree',
     'autoaddoc': 'memberOfAutoAddOC',
@@ -77,7 +78,8 @@ def do_fixup(inst, basedn, log, args):
     if not plugin.status():
         log.error("'%s' is disabled. Fix up task can't be executed" % plugin.rdn)
         return
-    fixup_task = plugin.fixup(args.DN, args.filter)
+    fixup_task = plugin.fixup(args.DN, args.filter, threads=args.threads,
+                              batchsize=args.batch_size, resume=not args.no_resume)
     if args.wait:
         log.info(f'Waiting for fixup task "{fixup_task.dn}" to complete.  You can safely exit by pressing Control C ...')
         fixup_task.wait(timeout=None)
@@ -106,6 +108,9 @@ def _add_parser_args(parser):
                              'all available suffixes (memberOfAllBackends)')
     parser.add_argument('--skipnested', choices=['on', 'off'], type=str.lower,
                         help='Specifies whether to skip nested groups or not (memberOfSkipNested)')
+    parser.add_argument('--graph', choices=['on', 'off'], type=str.lower,
+                        help='Specifies whether to keep the group memberships in memory to '
+                             'compute nested groups without internal searches (memberOfGraph)')
     parser.add_argument('--scope', nargs='+', help='Specifies backends or multiple-nested suffixes '
                                                    'for the MemberOf plug-in to work on (memberOfEntryScope)')
     parser.add_argument('--exclude', nargs='+', help='Specifies backends or multiple-nested suffixes '
@@ -152,6 +157,12 @@ def create_parser(subparsers):
                        help='Filter for entries to fix up.\n If omitted, all entries with objectclass '
                             'inetuser/inetadmin/nsmemberof under the specified base will have '
                             'their memberOf attribute regenerated.')
+    fixup.add_argument('--threads', type=int,
+                       help='Number of threads computing the memberOf values (default 1)')
+    fixup.add_argument('--batch-size', type=int,
+                       help='Number of entries updated per transaction and between checkpoints (default 1000)')
+    fixup.add_argument('--no-resume', action='store_true',
+                       help="Start from the beginning even if an identical task was interrupted")
     fixup.add_argument('--wait', action='store_true',
                        help="Wait for the task to finish, this could take a long time")
 
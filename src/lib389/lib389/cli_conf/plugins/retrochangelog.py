@@ -16,6 +16,8 @@ arg_to_attr = {
     'trim_interval': 'nsslapd-changelog-trim-interval',
     'exclude_suffix': 'nsslapd-exclude-suffix',
     'exclude_attrs': 'nsslapd-exclude-attrs',
+    'storage': 'nsslapd-changelog-storage',
+    'sync_interval': 'nsslapd-changelog-compact-sync-interval',
 }
 
 def retrochangelog_edit(inst, basedn, log, args):
@@ -55,6 +57,12 @@ def _add_parser_args(parser):
     parser.add_argument('--exclude-attrs', nargs='*',
                         help='Specifies the attributes which will be excluded from the scope of the plugin '
                             '(nsslapd-exclude-attrs)')
+    parser.add_argument('--storage', choices=['entry', 'compact'], type=str.lower,
+                        help='Stores the changes as entries of the changelog database, or appends them to '
+                             'compact segment files (nsslapd-changelog-storage)')
+    parser.add_argument('--sync-interval',
+                        help='Sets how often, in milliseconds, the compact changelog is flushed to disk '
+                             '(nsslapd-changelog-compact-sync-interval)')
 
 
 def create_parser(subparsers):
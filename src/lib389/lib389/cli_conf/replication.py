@@ -62,6 +62,7 @@ arg_to_attr = {
         'session_pause_time': 'nsds5replicaSessionPauseTime',
         'flow_control_window': 'nsds5replicaflowcontrolwindow',
         'flow_control_pause': 'nsds5replicaflowcontrolpause',
+        'flow_control_adaptive': 'nsds5replicaflowcontroladaptive',
         # Additional Winsync Agmt attrs
         'win_subtree': 'nsds7windowsreplicasubtree',
         'ds_subtree': 'nsds7directoryreplicasubtree',
@@ -1464,6 +1465,7 @@ def create_parser(subparsers):
     agmt_add_parser.add_argument('--session-pause-time', help="Sets the amount of time in seconds a supplier should wait between update sessions.")
     agmt_add_parser.add_argument('--flow-control-window', help="Sets the maximum number of entries and updates sent by a supplier, which are not acknowledged by the consumer.")
     agmt_add_parser.add_argument('--flow-control-pause', help="Sets the time in milliseconds to pause after reaching the number of entries and updates set in \"--flow-control-window\"")
+    agmt_add_parser.add_argument('--flow-control-adaptive', choices=['on', 'off'], help="Adapts the number of updates sent without acknowledgment to the measured round trip time, \"--flow-control-window\" becomes the upper bound")
     agmt_add_parser.add_argument('--bootstrap-bind-dn', help="Sets an optional bind DN the agreement can use to bootstrap initialization when bind groups are being used")
     agmt_add_parser.add_argument('--bootstrap-bind-passwd', help="Sets the bootstrap credentials for the bind DN")
     agmt_add_parser.add_argument('--bootstrap-conn-protocol', help="Sets the replication bootstrap connection protocol: LDAP, LDAPS, or StartTLS")
@@ -1496,6 +1498,7 @@ def create_parser(subparsers):
     agmt_set_parser.add_argument('--session-pause-time', help="Sets the amount of time in seconds a supplier should wait between update sessions.")
     agmt_set_parser.add_argument('--flow-control-window', help="Sets the maximum number of entries and updates sent by a supplier, which are not acknowledged by the consumer.")
     agmt_set_parser.add_argument('--flow-control-pause', help="Sets the time in milliseconds to pause after reaching the number of entries and updates set in \"--flow-control-window\"")
+    agmt_set_parser.add_argument('--flow-control-adaptive', choices=['on', 'off'], help="Adapts the number of updates sent without acknowledgment to the measured round trip time, \"--flow-control-window\" becomes the upper bound")
     agmt_set_parser.add_argument('--bootstrap-bind-dn', help="Sets an optional bind DN the agreement can use to bootstrap initialization when bind groups are being used")
     agmt_set_parser.add_argument('--bootstrap-bind-passwd', help="sets the bootstrap credentials for the bind DN")
     agmt_set_parser.add_argument('--bootstrap-conn-protocol', help="Sets the replication bootstrap connection protocol: LDAP, LDAPS, or StartTLS")
@@ -745,6 +745,29 @@ class RolesPlugin(Plugin):
     def __init__(self, instance, dn="cn=Roles Plugin,cn=plugins,cn=config"):
         super(RolesPlugin, self).__init__(instance, dn)
 
+    def enable_membership_index(self):
+        """Set nsRoleMembershipIndex to on"""
+
+        self.set('nsRoleMembershipIndex', 'on')
+
+    def disable_membership_index(self):
+        """Set nsRoleMembershipIndex to off"""
+
+        self.set('nsRoleMembershipIndex', 'off')
+
+    def get_index_stats(self):
+        """Get the statistics of the role membership index
+        :returns: A dict with the hits and misses counters, and the number
+                  of entries in the index
+        """
+        stats = self.get_attrs_vals_utf8(['nsRoleIndexHits', 'nsRoleIndexMisses',
+                                          'nsRoleIndexEntries'])
+        return {
+            'hits': int(stats['nsRoleIndexHits'][0]),
+            'misses': int(stats['nsRoleIndexMisses'][0]),
+            'entries': int(stats['nsRoleIndexEntries'][0]),
+        }
+
 
 class MemberOfPlugin(Plugin):
     """An instance of MemberOf plugin entry
@@ -907,6 +930,21 @@ class MemberOfPlugin(Plugin):
 
         self.set('memberofskipnested', 'off')
 
+    def get_graph(self):
+        """Get memberofgraph attribute"""
+
+        return self.get_attr_val_utf8_l('memberofgraph')
+
+    def enable_graph(self):
+        """Set memberofgraph to on"""
+
+        self.set('memberofgraph', 'on')
+
+    def disable_graph(self):
+        """Set memberofgraph to off"""
+
+        self.set('memberofgraph', 'off')
+
     def get_autoaddoc(self):
         """Get memberofautoaddoc attribute"""
 
@@ -992,13 +1030,19 @@ class MemberOfPlugin(Plugin):
 
         return self.remove_all('nsslapd-pluginConfigArea')
 
-    def fixup(self, basedn, _filter=None):
+    def fixup(self, basedn, _filter=None, threads=None, batchsize=None, resume=True):
         """Create a memberOf task
 
         :param basedn: Basedn to fix up
         :type basedn: str
         :param _filter: a filter for entries to fix up
         :type _filter: str
+        :param threads: number of threads computing the memberOf values
+        :type threads: int
+        :param batchsize: number of entries updated per transaction
+        :type batchsize: int
+        :param resume: resume from the checkpoint of an interrupted identical task
+        :type resume: bool
 
         :returns: an instance of Task(DSLdapObject)
         """
@@ -1007,6 +1051,12 @@ class MemberOfPlugin(Plugin):
         task_properties = {'basedn': basedn}
         if _filter is not None:
             task_properties['filter'] = _filter
+        if threads is not None:
+            task_properties['threads'] = str(threads)
+        if batchsize is not None:
+            task_properties['batchsize'] = str(batchsize)
+        if not resume:
+            task_properties['resume'] = 'no'
         try:
             task.create(properties=task_properties)
         except ldap.NO_SUCH_OBJECT:
@@ -1014,6 +1064,20 @@ class MemberOfPlugin(Plugin):
 
         return task
 
+    def check_graph(self, repair=False):
+        """Create a memberOf graph check task
+
+        :param repair: rebuild the graph if it differs from the database
+        :type repair: bool
+
+        :returns: an instance of Task(DSLdapObject)
+        """
+
+        task = tasks.MemberOfGraphCheckTask(self._instance)
+        task.create(properties={'repair': 'yes' if repair else 'no'})
+
+        return task
+
 
 class MemberOfSharedConfig(DSLdapObject):
     """An instance of MemberOf config entry
@@ -1076,6 +1140,23 @@ class ClassOfServicePlugin(Plugin):
     def __init__(self, instance, dn="cn=Class of Service,cn=plugins,cn=config"):
         super(ClassOfServicePlugin, self).__init__(instance, dn)
 
+    def get_cache_stats(self):
+        """Get the statistics of the specifier resolution cache
+        :returns: A dict with the hits, misses, full rebuilds and incremental
+                  updates counters, and the number of specifier values in the
+                  current cache
+        """
+        stats = self.get_attrs_vals_utf8(['cosResolveHits', 'cosResolveMisses',
+                                          'cosCacheRebuilds', 'cosCacheUpdates',
+                                          'cosResolvedSpecifiers'])
+        return {
+            'hits': int(stats['cosResolveHits'][0]),
+            'misses': int(stats['cosResolveMisses'][0]),
+            'rebuilds': int(stats['cosCacheRebuilds'][0]),
+            'updates': int(stats['cosCacheUpdates'][0]),
+            'resolved': int(stats['cosResolvedSpecifiers'][0]),
+        }
+
 
 class ViewsPlugin(Plugin):
     """An instance of Views plugin entry
@@ -1141,13 +1222,17 @@ class AutoMembershipPlugin(Plugin):
     def __init__(self, instance, dn="cn=Auto Membership Plugin,cn=plugins,cn=config"):
         super(AutoMembershipPlugin, self).__init__(instance, dn)
 
-    def fixup(self, basedn, _filter=None):
+    def fixup(self, basedn, _filter=None, threads=None, batchsize=None):
         """Create an automember rebuild membership task
 
         :param basedn: Basedn to fix up
         :type basedn: str
         :param _filter: a filter for entries to fix up
         :type _filter: str
+        :param threads: number of threads updating the groups
+        :type threads: int
+        :param batchsize: number of members added to or deleted from a group per modify
+        :type batchsize: int
 
         :returns: an instance of Task(DSLdapObject)
         """
@@ -1156,6 +1241,10 @@ class AutoMembershipPlugin(Plugin):
         task_properties = {'basedn': basedn}
         if _filter is not None:
             task_properties['filter'] = _filter
+        if threads is not None:
+            task_properties['threads'] = str(threads)
+        if batchsize is not None:
+            task_properties['batchsize'] = str(batchsize)
         task.create(properties=task_properties)
 
         return task
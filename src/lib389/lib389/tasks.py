@@ -198,6 +198,20 @@ class MemberOfFixupTask(Task):
         self._must_attributes.extend(['basedn'])
 
 
+class MemberOfGraphCheckTask(Task):
+    """A single instance of memberOf graph check task entry
+
+    :param instance: An instance
+    :type instance: lib389.DirSrv
+    """
+
+    def __init__(self, instance, dn=None):
+        self.cn = 'memberOf_graph_check_' + Task._get_task_date()
+        dn = "cn=" + self.cn + "," + DN_MBO_GRAPH_TASK
+
+        super(MemberOfGraphCheckTask, self).__init__(instance, dn)
+
+
 class USNTombstoneCleanupTask(Task):
     """A single instance of USN tombstone cleanup task entry
 
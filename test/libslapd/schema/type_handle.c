@@ -0,0 +1,88 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "../../test_slapd.h"
+
+#include <slap.h>
+#include <proto-slap.h>
+#include <string.h>
+
+static struct asyntaxinfo *
+attr_syntax_add_with_alias(char *name, char *alias, char *oid)
+{
+    char *names[3] = {name, alias, NULL};
+    struct asyntaxinfo *asi = NULL;
+
+    attr_syntax_create(oid, names, "testing attribute type",
+                       NULL, NULL, NULL, NULL, NULL,
+                       DIRSTRING_SYNTAX_OID, SLAPI_SYNTAXLENGTH_NONE,
+                       SLAPI_ATTR_FLAG_STD_ATTR | SLAPI_ATTR_FLAG_OPATTR, &asi);
+    assert_true(attr_syntax_add(asi, 0) == 0);
+
+    return asi;
+}
+
+void
+test_libslapd_schema_type_handle(void **state __attribute__((unused)))
+{
+    attr_syntax_write_lock();
+    struct asyntaxinfo *h = attr_syntax_add_with_alias("test_h", "test_h_alias", "1.1.0.0.0.0.3");
+    struct asyntaxinfo *i = attr_syntax_add_with_alias("test_i", "test_i_alias", "1.1.0.0.0.0.4");
+    attr_syntax_unlock_write();
+
+    /* One handle per name, whatever its case */
+    uint32_t handle = attr_syntax_type_handle("test_h");
+    assert_int_not_equal(handle, 0);
+    assert_int_equal(handle, h->asi_handle);
+    assert_int_equal(handle, attr_syntax_type_handle("TEST_H"));
+    assert_int_not_equal(attr_syntax_type_handle("test_h_alias"), 0);
+    assert_int_not_equal(attr_syntax_type_handle("test_h_alias"), handle);
+    assert_int_not_equal(attr_syntax_type_handle("test_i"), handle);
+    assert_int_equal(attr_syntax_type_handle("test_h;lang-fr"), 0);
+    assert_int_equal(attr_syntax_type_handle("not_a_schema_type"), 0);
+    assert_int_equal(attr_syntax_type_handle(NULL), 0);
+
+    /* The attributes carry the handle of their type */
+    Slapi_Attr *alist = NULL;
+    Slapi_Attr **a = NULL;
+    attrlist_find_or_create(&alist, "Test_H", &a);
+    assert_int_equal((*a)->a_type_handle, handle);
+    a = NULL;
+    attrlist_find_or_create(&alist, "test_i;lang-fr", &a);
+    assert_int_equal((*a)->a_type_handle, 0);
+    a = NULL;
+    attrlist_find_or_create(&alist, "not_a_schema_type", &a);
+    assert_int_equal((*a)->a_type_handle, 0);
+
+    assert_non_null(attrlist_find(alist, "test_h"));
+    assert_non_null(attrlist_find(alist, "TEST_I;LANG-FR"));
+    assert_non_null(attrlist_find(alist, "NOT_a_schema_type"));
+    assert_null(attrlist_find(alist, "test_i"));
+    assert_null(attrlist_find(alist, "test_i_alias"));
+    attrlist_free(alist);
+
+    /* And so do the filters, across the type changes */
+    char fstr[] = "(|(test_h=a)(test_h;lang-fr=*)(test_i_alias=*b*))";
+    Slapi_Filter *f = slapi_str2filter(fstr);
+    assert_non_null(f);
+    Slapi_Filter *fx = f->f_list;
+    assert_int_equal(fx->f_type_handle, handle);
+    assert_int_equal(fx->f_next->f_type_handle, 0);
+    assert_int_equal(fx->f_next->f_next->f_type_handle, attr_syntax_type_handle("test_i_alias"));
+    slapi_filter_changetype(fx, "test_i");
+    assert_int_equal(fx->f_type_handle, i->asi_handle);
+    Slapi_Filter *dup = slapi_filter_dup(f);
+    assert_int_equal(dup->f_list->f_type_handle, i->asi_handle);
+    slapi_filter_free(dup, 1);
+    slapi_filter_free(f, 1);
+
+    attr_syntax_write_lock();
+    attr_syntax_delete(h, 0);
+    attr_syntax_delete(i, 0);
+    attr_syntax_unlock_write();
+}
@@ -78,3 +78,51 @@ test_plugin_pwdstorage_pbkdf2_rounds(void **state __attribute__((unused)))
     assert_true(pbkdf2_sha256_calculate_iterations(2500000) == 20000);
 #endif
 }
+
+void
+test_plugin_pwdstorage_pbkdf2_lanes(void **state __attribute__((unused)))
+{
+#if (NSS_VMAJOR * 100 + NSS_VMINOR) > 328
+    /* RFC 7914 section 11 test vectors of PBKDF2-HMAC-SHA-256 */
+    const unsigned char kat_1[32] = {
+        0x12, 0x0f, 0xb6, 0xcf, 0xfc, 0xf8, 0xb3, 0x2c, 0x43, 0xe7, 0x22, 0x52, 0x56, 0xc4, 0xf8, 0x37,
+        0xa8, 0x65, 0x48, 0xc9, 0x2c, 0xcc, 0x35, 0x48, 0x08, 0x05, 0x98, 0x7c, 0xb7, 0x0b, 0xe1, 0x7b};
+    const unsigned char kat_4096[32] = {
+        0xc5, 0xe4, 0x78, 0xd5, 0x92, 0x88, 0xc8, 0x41, 0xaa, 0x53, 0x0d, 0xb6, 0x84, 0x5c, 0x4c, 0x8d,
+        0x96, 0x28, 0x93, 0xa0, 0x01, 0xce, 0x4e, 0x11, 0xa4, 0x96, 0x38, 0x73, 0xaa, 0x98, 0x13, 0x4a};
+    const char *passwords[] = {"p", "password", "Eequee9mutheuchiehe4",
+                               "0123456789012345678901234567890123456789012345678901234567890123",
+                               "0123456789012345678901234567890123456789012345678901234567890123456789"};
+    const uint32_t rounds[] = {1, 2, 1000};
+    unsigned char salt_data[64];
+    char lanes_hash[256];
+    char nss_hash[256];
+    SECItem pwd;
+    SECItem salt;
+
+    pwd.data = (unsigned char *)"password";
+    pwd.len = 8;
+    salt.data = (unsigned char *)"salt";
+    salt.len = 4;
+    assert_true(pbkdf2_sha256_hash_lanes(lanes_hash, 32, &pwd, &salt, 1) == SECSuccess);
+    assert_memory_equal(lanes_hash, kat_1, 32);
+    assert_true(pbkdf2_sha256_hash_lanes(lanes_hash, 32, &pwd, &salt, 4096) == SECSuccess);
+    assert_memory_equal(lanes_hash, kat_4096, 32);
+
+    /* The full size hash of the scheme matches the NSS one, short and long keys */
+    for (size_t i = 0; i < sizeof(salt_data); i++) {
+        salt_data[i] = (unsigned char)(i * 7 + 3);
+    }
+    salt.data = salt_data;
+    salt.len = sizeof(salt_data);
+    for (size_t p = 0; p < sizeof(passwords) / sizeof(passwords[0]); p++) {
+        for (size_t r = 0; r < sizeof(rounds) / sizeof(rounds[0]); r++) {
+            pwd.data = (unsigned char *)passwords[p];
+            pwd.len = strlen(passwords[p]);
+            assert_true(pbkdf2_sha256_hash_lanes(lanes_hash, sizeof(lanes_hash), &pwd, &salt, rounds[r]) == SECSuccess);
+            assert_true(pbkdf2_sha256_hash(nss_hash, sizeof(nss_hash), &pwd, &salt, rounds[r]) == SECSuccess);
+            assert_memory_equal(lanes_hash, nss_hash, sizeof(lanes_hash));
+        }
+    }
+#endif
+}
@@ -0,0 +1,267 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "../../test_slapd.h"
+
+#include <pthread.h>
+#include <time.h>
+#include <csnpl.h>
+
+#define CSNPL_TEST_THREADS 8
+#define CSNPL_TEST_OPS 20000
+#define CSNPL_TEST_TIME 1700000000
+
+static CSN *
+test_csn(uint64_t n)
+{
+    CSN *csn = csn_new();
+    csn_set_replicaid(csn, 1);
+    csn_set_time(csn, CSNPL_TEST_TIME + n / 50000);
+    csn_set_seqnum(csn, n % 50000);
+    return csn;
+}
+
+void
+test_plugin_replication_csnpl_rollup(void **state __attribute__((unused)))
+{
+    CSNPL *csnpl = csnplNew();
+    CSN *csns[300];
+    CSN *max_csn;
+    CSN *first_csn;
+    CSN *min_csn;
+    PRBool committed = PR_TRUE;
+    size_t i;
+
+    assert_non_null(csnpl);
+    for (i = 0; i < 300; i++) {
+        csns[i] = test_csn(i);
+    }
+
+    assert_int_equal(csnplInsert(csnpl, csns[0], NULL), 0);
+    assert_int_equal(csnplInsert(csnpl, csns[1], NULL), 0);
+    assert_int_equal(csnplInsert(csnpl, csns[2], NULL), 0);
+    /* seen already */
+    assert_int_equal(csnplInsert(csnpl, csns[1], NULL), 1);
+
+    /* The head is pending, nothing to roll up */
+    assert_int_equal(csnplCommit(csnpl, csns[1]), 0);
+    assert_false(csnplRollUpReady(csnpl));
+    assert_null(csnplRollUp(csnpl, &first_csn));
+    min_csn = csnplGetMinCSN(csnpl, &committed);
+    assert_true(csn_is_equal(min_csn, csns[0]));
+    assert_false(committed);
+    csn_free(&min_csn);
+
+    /* Cancelling the head lets the committed csn through */
+    assert_int_equal(csnplRemove(csnpl, csns[0]), 0);
+    assert_int_equal(csnplRemove(csnpl, csns[0]), -1);
+    assert_true(csnplRollUpReady(csnpl));
+    max_csn = csnplRollUp(csnpl, &first_csn);
+    assert_true(csn_is_equal(max_csn, csns[1]));
+    assert_ptr_equal(max_csn, first_csn);
+    csn_free(&max_csn);
+
+    /* A cancelled csn can be inserted again */
+    assert_int_equal(csnplRemove(csnpl, csns[2]), 0);
+    assert_int_equal(csnplInsert(csnpl, csns[2], NULL), 0);
+    assert_int_equal(csnplCommit(csnpl, csns[2]), 0);
+    max_csn = csnplRollUp(csnpl, &first_csn);
+    assert_true(csn_is_equal(max_csn, csns[2]));
+    csn_free(&max_csn);
+    assert_null(csnplGetMinCSN(csnpl, NULL));
+
+    /* Over several segments, committed in reverse order */
+    for (i = 3; i < 300; i++) {
+        assert_int_equal(csnplInsert(csnpl, csns[i], NULL), 0);
+    }
+    for (i = 299; i > 3; i--) {
+        assert_int_equal(csnplCommit(csnpl, csns[i]), 0);
+        assert_false(csnplRollUpReady(csnpl));
+    }
+    assert_int_equal(csnplCommit(csnpl, csns[3]), 0);
+    max_csn = csnplRollUp(csnpl, &first_csn);
+    assert_true(csn_is_equal(max_csn, csns[299]));
+    assert_true(csn_is_equal(first_csn, csns[3]));
+    csn_free(&max_csn);
+    csn_free(&first_csn);
+    assert_null(csnplGetMinCSN(csnpl, NULL));
+
+    csnplFree(&csnpl);
+    for (i = 0; i < 300; i++) {
+        csn_free(&csns[i]);
+    }
+}
+
+/*
+ * A trim moves the insertions back to a segment that is followed by other
+ * segments.  Once that segment is rolled up, the next insertions go on in
+ * the following one.
+ */
+void
+test_plugin_replication_csnpl_trim_rollup(void **state __attribute__((unused)))
+{
+    CSNPL *csnpl = csnplNew();
+    CSN *csns[300];
+    CSN *max_csn;
+    CSN *first_csn;
+    size_t i;
+
+    assert_non_null(csnpl);
+    for (i = 0; i < 300; i++) {
+        csns[i] = test_csn(i);
+    }
+
+    /* Fill two segments and cancel the end of the list */
+    for (i = 0; i < 256; i++) {
+        assert_int_equal(csnplInsert(csnpl, csns[i], NULL), 0);
+    }
+    for (i = 100; i < 256; i++) {
+        assert_int_equal(csnplRemove(csnpl, csns[i]), 0);
+    }
+    /* Inserted again, the cancelled csns are trimmed back into the first segment */
+    assert_int_equal(csnplInsert(csnpl, csns[100], NULL), 0);
+    for (i = 101; i < 128; i++) {
+        assert_int_equal(csnplInsert(csnpl, csns[i], NULL), 0);
+    }
+
+    /* Roll up the whole first segment */
+    for (i = 0; i < 128; i++) {
+        assert_int_equal(csnplCommit(csnpl, csns[i]), 0);
+    }
+    max_csn = csnplRollUp(csnpl, &first_csn);
+    assert_true(csn_is_equal(max_csn, csns[127]));
+    assert_true(csn_is_equal(first_csn, csns[0]));
+    csn_free(&max_csn);
+    csn_free(&first_csn);
+
+    /* The insertions go on after the released segment */
+    for (i = 128; i < 300; i++) {
+        assert_int_equal(csnplInsert(csnpl, csns[i], NULL), 0);
+        assert_int_equal(csnplCommit(csnpl, csns[i]), 0);
+    }
+    max_csn = csnplRollUp(csnpl, &first_csn);
+    assert_true(csn_is_equal(max_csn, csns[299]));
+    assert_true(csn_is_equal(first_csn, csns[128]));
+    csn_free(&max_csn);
+    csn_free(&first_csn);
+    assert_null(csnplGetMinCSN(csnpl, NULL));
+
+    csnplFree(&csnpl);
+    for (i = 0; i < 300; i++) {
+        csn_free(&csns[i]);
+    }
+}
+
+struct csnpl_test_ctx
+{
+    CSNPL *csnpl;
+    pthread_mutex_t gen_lock; /* the csn generator, csns are inserted in order */
+    uint64_t next;
+    pthread_mutex_t ruv_lock; /* stands for the RUV write lock */
+    CSN *max_csn;             /* largest csn rolled up */
+    uint64_t rollups;
+    int failed;
+};
+
+static void *
+csnpl_test_worker(void *arg)
+{
+    struct csnpl_test_ctx *ctx = (struct csnpl_test_ctx *)arg;
+    size_t i;
+
+    for (i = 0; i < CSNPL_TEST_OPS; i++) {
+        CSN *csn;
+        uint64_t n;
+
+        pthread_mutex_lock(&ctx->gen_lock);
+        n = ctx->next++;
+        csn = test_csn(n);
+        if (csnplInsert(ctx->csnpl, csn, NULL) != 0) {
+            ctx->failed = 1;
+        }
+        pthread_mutex_unlock(&ctx->gen_lock);
+
+        if (n % 16 == 0) {
+            if (csnplRemove(ctx->csnpl, csn) != 0) {
+                ctx->failed = 1;
+            }
+        } else if (csnplCommit(ctx->csnpl, csn) != 0) {
+            ctx->failed = 1;
+        }
+        if (csnplRollUpReady(ctx->csnpl)) {
+            CSN *first_csn = NULL;
+            CSN *max_csn;
+
+            pthread_mutex_lock(&ctx->ruv_lock);
+            max_csn = csnplRollUp(ctx->csnpl, &first_csn);
+            if (max_csn) {
+                /* the watermark only moves forward */
+                if ((ctx->max_csn && csn_compare(first_csn, ctx->max_csn) <= 0) ||
+                    csn_compare(first_csn, max_csn) > 0) {
+                    ctx->failed = 1;
+                }
+                if (first_csn != max_csn) {
+                    csn_free(&first_csn);
+                }
+                csn_free(&ctx->max_csn);
+                ctx->max_csn = max_csn;
+                ctx->rollups++;
+            }
+            pthread_mutex_unlock(&ctx->ruv_lock);
+        }
+        csn_free(&csn);
+    }
+    return NULL;
+}
+
+void
+test_plugin_replication_csnpl_concurrent(void **state __attribute__((unused)))
+{
+    struct csnpl_test_ctx ctx = {0};
+    pthread_t threads[CSNPL_TEST_THREADS];
+    struct timespec start, end;
+    uint64_t last = CSNPL_TEST_THREADS * CSNPL_TEST_OPS - 1;
+    CSN *last_csn;
+    double elapsed;
+    size_t i;
+
+    ctx.csnpl = csnplNew();
+    assert_non_null(ctx.csnpl);
+    pthread_mutex_init(&ctx.gen_lock, NULL);
+    pthread_mutex_init(&ctx.ruv_lock, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < CSNPL_TEST_THREADS; i++) {
+        assert_int_equal(pthread_create(&threads[i], NULL, csnpl_test_worker, &ctx), 0);
+    }
+    for (i = 0; i < CSNPL_TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    print_message("csnpl: %d threads, %d operations in %.3fs (%.0f ops/s), %" PRIu64 " roll ups\n",
+                  CSNPL_TEST_THREADS, CSNPL_TEST_THREADS * CSNPL_TEST_OPS, elapsed,
+                  CSNPL_TEST_THREADS * CSNPL_TEST_OPS / elapsed, ctx.rollups);
+
+    assert_false(ctx.failed);
+    /* Every csn was committed or cancelled, the list must be fully rolled up */
+    assert_null(csnplGetMinCSN(ctx.csnpl, NULL));
+    assert_false(csnplRollUpReady(ctx.csnpl));
+    if (last % 16 == 0) {
+        last--;
+    }
+    last_csn = test_csn(last);
+    assert_non_null(ctx.max_csn);
+    assert_true(csn_is_equal(ctx.max_csn, last_csn));
+
+    csn_free(&last_csn);
+    csn_free(&ctx.max_csn);
+    csnplFree(&ctx.csnpl);
+    pthread_mutex_destroy(&ctx.gen_lock);
+    pthread_mutex_destroy(&ctx.ruv_lock);
+}
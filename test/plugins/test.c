@@ -26,6 +26,12 @@ run_plugin_tests(void)
         cmocka_unit_test_setup_teardown(test_plugin_pwdstorage_pbkdf2_rounds,
                                         test_plugin_pwdstorage_nss_setup,
                                         test_plugin_pwdstorage_nss_stop),
+        cmocka_unit_test_setup_teardown(test_plugin_pwdstorage_pbkdf2_lanes,
+                                        test_plugin_pwdstorage_nss_setup,
+                                        test_plugin_pwdstorage_nss_stop),
+        cmocka_unit_test(test_plugin_replication_csnpl_rollup),
+        cmocka_unit_test(test_plugin_replication_csnpl_trim_rollup),
+        cmocka_unit_test(test_plugin_replication_csnpl_concurrent),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -41,6 +41,7 @@ void test_libslapd_pblock_v3c_target_uniqueid(void **state);
 
 /* libslapd-schema-filter-validate */
 void test_libslapd_schema_filter_validate_simple(void **state);
+void test_libslapd_schema_type_handle(void **state);
 
 /* libslapd-operation-v3_compat */
 void test_libslapd_operation_v3c_target_spec(void **state);
@@ -66,3 +67,10 @@ int test_plugin_pwdstorage_nss_stop(void **state);
 
 void test_plugin_pwdstorage_pbkdf2_auth(void **state);
 void test_plugin_pwdstorage_pbkdf2_rounds(void **state);
+void test_plugin_pwdstorage_pbkdf2_lanes(void **state);
+
+/* plugin-replication-csnpl */
+
+void test_plugin_replication_csnpl_rollup(void **state);
+void test_plugin_replication_csnpl_trim_rollup(void **state);
+void test_plugin_replication_csnpl_concurrent(void **state);